@@ -0,0 +1,220 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "bench_utils.h"
+#include "lsp/client.h"
+#include "utils/allocstats.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTest>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// The allocations of the whole process are counted, by replacing the global operator new
+#ifdef KNUT_ALLOC_STATS
+// Already replaced by Utils::AllocStats
+static qint64 allocationCount()
+{
+    return Utils::AllocStats::processCounts().allocations;
+}
+#else
+static std::atomic<qint64> processAllocations = 0;
+
+static qint64 allocationCount()
+{
+    return processAllocations;
+}
+
+void *operator new(std::size_t size)
+{
+    ++processAllocations;
+    if (void *pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+// Reports the number of allocations per iteration of the benchmark, as a message of the benchmark
+class AllocationCounter
+{
+public:
+    AllocationCounter()
+        : m_start(allocationCount())
+    {
+    }
+    ~AllocationCounter()
+    {
+        const auto count = allocationCount() - m_start;
+        qInfo("allocations: %lld per iteration", m_iterations ? count / m_iterations : count);
+    }
+    void next() { ++m_iterations; }
+
+private:
+    const qint64 m_start;
+    qint64 m_iterations = 0;
+};
+
+static const std::string DocumentUri = Lsp::Client::toUri(QDir::tempPath() + "/main.cpp");
+
+class BenchLsp : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Starts a client on the mock server, with a document opened
+    std::unique_ptr<Lsp::Client> startClient(const QStringList &arguments)
+    {
+        auto client = std::make_unique<Lsp::Client>("cpp", MOCK_LSP_SERVER, arguments);
+        if (!client->initialize(QDir::tempPath()))
+            return {};
+        Lsp::DidOpenTextDocumentParams params;
+        params.textDocument = {DocumentUri, "cpp", m_version, "int main() {}"};
+        client->didOpen(std::move(params));
+        return client;
+    }
+
+    // Invalidates the results cached by the client, so the next request is sent to the server
+    void changeDocument(Lsp::Client &client)
+    {
+        Lsp::DidChangeTextDocumentParams params;
+        params.textDocument.uri = DocumentUri;
+        params.textDocument.version = ++m_version;
+        params.contentChanges.push_back(Lsp::TextDocumentContentChangeEventFull {"int main() {}"});
+        client.didChange(std::move(params));
+    }
+
+    static Lsp::DocumentSymbolParams documentSymbolParams()
+    {
+        Lsp::DocumentSymbolParams params;
+        params.textDocument.uri = DocumentUri;
+        return params;
+    }
+
+private slots:
+    void initTestCase() { QVERIFY(QFileInfo::exists(MOCK_LSP_SERVER)); }
+
+    void documentSymbol_data()
+    {
+        QTest::addColumn<int>("symbols");
+        for (const int symbols : {100, 1000, 10000})
+            QTest::newRow(QByteArray::number(symbols)) << symbols;
+    }
+    void documentSymbol()
+    {
+        QFETCH(int, symbols);
+        auto client = startClient({"--symbols", QString::number(symbols)});
+        QVERIFY(client);
+
+        Bench::PeakMemory memory;
+        AllocationCounter allocations;
+        QBENCHMARK {
+            changeDocument(*client);
+            QVERIFY(client->documentSymbol(documentSymbolParams()).has_value());
+            allocations.next();
+        }
+        client->shutdown();
+    }
+
+    void references_data()
+    {
+        QTest::addColumn<int>("references");
+        for (const int references : {100, 1000, 10000})
+            QTest::newRow(QByteArray::number(references)) << references;
+    }
+    void references()
+    {
+        QFETCH(int, references);
+        auto client = startClient({"--references", QString::number(references)});
+        QVERIFY(client);
+
+        Bench::PeakMemory memory;
+        AllocationCounter allocations;
+        QBENCHMARK {
+            changeDocument(*client);
+            Lsp::ReferenceParams params;
+            params.textDocument.uri = DocumentUri;
+            params.context.includeDeclaration = true;
+            QVERIFY(client->references(std::move(params)).has_value());
+            allocations.next();
+        }
+        client->shutdown();
+    }
+
+    // Each change is answered by a burst of notifications, the hover response comes after the last one
+    void notifications_data()
+    {
+        QTest::addColumn<int>("notifications");
+        for (const int notifications : {100, 1000, 10000})
+            QTest::newRow(QByteArray::number(notifications)) << notifications;
+    }
+    void notifications()
+    {
+        QFETCH(int, notifications);
+        auto client = startClient({"--notifications", QString::number(notifications)});
+        QVERIFY(client);
+
+        AllocationCounter allocations;
+        QBENCHMARK {
+            changeDocument(*client);
+            Lsp::HoverParams params;
+            params.textDocument.uri = DocumentUri;
+            QVERIFY(client->hover(std::move(params)).has_value());
+            allocations.next();
+        }
+        client->shutdown();
+    }
+
+    // Latency of small requests, the result is the median, with the 95th and 99th percentiles in a message
+    void latency()
+    {
+        auto client = startClient({"--symbols", "10"});
+        QVERIFY(client);
+
+        constexpr int Count = 1000;
+        std::vector<qint64> latencies;
+        latencies.reserve(Count);
+        for (int i = 0; i < Count; ++i) {
+            changeDocument(*client);
+            QElapsedTimer timer;
+            timer.start();
+            QVERIFY(client->documentSymbol(documentSymbolParams()).has_value());
+            latencies.push_back(timer.nsecsElapsed());
+        }
+        client->shutdown();
+
+        std::ranges::sort(latencies);
+        auto percentile = [&latencies](int value) {
+            return latencies[latencies.size() * value / 100];
+        };
+        qInfo("latency: p95 %lld us, p99 %lld us", percentile(95) / 1000, percentile(99) / 1000);
+        QTest::setBenchmarkResult(static_cast<qreal>(percentile(50)), QTest::WalltimeNanoseconds);
+    }
+
+private:
+    int m_version = 1;
+};
+
+QTEST_MAIN(BenchLsp)
+#include "bench_lsp.moc"
@@ -0,0 +1,108 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "bench_utils.h"
+#include "core/cppdocument.h"
+#include "core/knutcore.h"
+#include "core/project.h"
+#include "projectgenerator.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+#include <memory>
+
+// Each module has 100 files, 3 for the module, 2 per class and 1 ui file: the default is a 1,000 files project,
+// KNUT_BENCH_PROJECT_MODULES=100 is used for the 10,000 files scale run
+static ProjectGen::ProjectOptions projectOptions()
+{
+    bool ok = false;
+    const int modules = qEnvironmentVariableIntValue("KNUT_BENCH_PROJECT_MODULES", &ok);
+    return {.modules = ok && modules > 0 ? modules : 10, .dialogs = 48, .controls = 10, .strings = 20, .uiFiles = 1};
+}
+
+class BenchProject : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        Q_INIT_RESOURCE(core);
+        QVERIFY(m_dir.isValid());
+        QVERIFY(ProjectGen::generateProject(m_dir.path(), m_options));
+        qInfo("Generated project: %d files", ProjectGen::fileCount(m_options));
+
+        // The root can only be set once, all the benchmarks share the same project
+        m_core = std::make_unique<Core::KnutCore>();
+        Core::Project::instance()->setRoot(m_dir.path());
+    }
+
+    void cleanupTestCase() { m_core.reset(); }
+
+    void allFiles()
+    {
+        auto project = Core::Project::instance();
+        QBENCHMARK {
+            QCOMPARE(project->allFiles().size(), qsizetype(ProjectGen::fileCount(m_options)));
+        }
+    }
+
+    void allFilesWithExtension()
+    {
+        auto project = Core::Project::instance();
+        QBENCHMARK {
+            QCOMPARE(project->allFilesWithExtension("cpp").size(), qsizetype(m_options.modules * m_options.dialogs));
+        }
+    }
+
+    void correspondingHeaderSource()
+    {
+        const auto className = ProjectGen::generatedClassName(m_options.modules - 1, m_options.dialogs - 1);
+        auto document = qobject_cast<Core::CppDocument *>(
+            Core::Project::instance()->open(QString("module%1/%2.cpp").arg(m_options.modules - 1).arg(className)));
+        QVERIFY(document);
+
+        QBENCHMARK {
+            QVERIFY(document->correspondingHeaderSource().endsWith(className + ".h"));
+        }
+    }
+
+    // Opens all the sources of a module, the documents opened are kept by the project
+    void openModule()
+    {
+        auto project = Core::Project::instance();
+        Bench::PeakMemory memory;
+        int module = 0;
+        QBENCHMARK {
+            for (int dialog = 0; dialog < m_options.dialogs; ++dialog) {
+                const auto className = ProjectGen::generatedClassName(module % m_options.modules, dialog);
+                QVERIFY(project->get(QString("module%1/%2.cpp").arg(module % m_options.modules).arg(className)));
+            }
+            ++module;
+        }
+    }
+
+    void findSymbols()
+    {
+        auto project = Core::Project::instance();
+        const auto className = ProjectGen::generatedClassName(0, 0);
+        QBENCHMARK {
+            QVERIFY(!project->findSymbols(className).isEmpty());
+        }
+    }
+
+private:
+    const ProjectGen::ProjectOptions m_options = projectOptions();
+    QTemporaryDir m_dir;
+    std::unique_ptr<Core::KnutCore> m_core;
+};
+
+QTEST_MAIN(BenchProject)
+#include "bench_project.moc"
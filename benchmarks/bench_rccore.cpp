@@ -0,0 +1,136 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "bench_utils.h"
+#include "rccore/rcfile.h"
+#include "rcgenerator.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <utility>
+
+using namespace RcCore;
+
+// Generated RC files, from a small project to a large multi-language one
+static const std::pair<const char *, Bench::RcGeneratorOptions> Sizes[] = {
+    {"small", {.dialogs = 10, .controls = 10, .languages = 1, .strings = 100, .toolBars = 2, .toolBarButtons = 10}},
+    {"medium", {.dialogs = 100, .controls = 20, .languages = 4, .strings = 1000, .toolBars = 5, .toolBarButtons = 20}},
+    {"large", {.dialogs = 500, .controls = 30, .languages = 8, .strings = 5000, .toolBars = 10, .toolBarButtons = 40}},
+};
+
+class BenchRcCore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+        for (const auto &[name, options] : Sizes) {
+            const auto dir = m_dir.filePath(name);
+            QVERIFY(!Bench::generateRcFile(dir, name, options).isEmpty());
+        }
+    }
+
+    // Each stage is measured separately, on the first language
+    void parse_data() { addSizeRows(); }
+    void parse()
+    {
+        QFETCH(QString, fileName);
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            QVERIFY(RcCore::parse(fileName).isValid);
+        }
+    }
+
+    void convertDialog_data() { addSizeRows(); }
+    void convertDialog()
+    {
+        QFETCH(QString, fileName);
+        const auto rcFile = RcCore::parse(fileName);
+        const auto data = rcFile.data.value(Bench::generatedLanguage(0));
+        QVERIFY(!data.dialogs.isEmpty());
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            for (const auto &dialog : data.dialogs)
+                RcCore::convertDialog(data, dialog);
+        }
+    }
+
+    void convertAssets_data() { addSizeRows(); }
+    void convertAssets()
+    {
+        QFETCH(QString, fileName);
+        const auto rcFile = RcCore::parse(fileName);
+        const auto data = rcFile.data.value(Bench::generatedLanguage(0));
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            QVERIFY(!RcCore::convertAssets(data).isEmpty());
+        }
+    }
+
+    // The images written are removed after each iteration, otherwise they are up to date and skipped
+    // (the toolbar bitmaps are split and converted to PNG)
+    void writeAssetsToImage_data() { addSizeRows(); }
+    void writeAssetsToImage()
+    {
+        QFETCH(QString, fileName);
+        const auto rcFile = RcCore::parse(fileName);
+        const auto assets = RcCore::convertAssets(rcFile.data.value(Bench::generatedLanguage(0)));
+        QVERIFY(!assets.isEmpty());
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            QVERIFY(RcCore::writeAssetsToImage(assets).isEmpty());
+            for (const auto &asset : assets) {
+                if (!asset.isSame())
+                    QFile::remove(asset.fileName);
+            }
+        }
+    }
+
+    void writeDialogToUi_data() { addSizeRows(); }
+    void writeDialogToUi()
+    {
+        QFETCH(QString, fileName);
+        const auto rcFile = RcCore::parse(fileName);
+        const auto data = rcFile.data.value(Bench::generatedLanguage(0));
+        QList<Widget> widgets;
+        for (const auto &dialog : data.dialogs)
+            widgets.push_back(RcCore::convertDialog(data, dialog));
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            for (const auto &widget : widgets) {
+                QBuffer buffer;
+                buffer.open(QIODevice::WriteOnly);
+                RcCore::writeDialogToUi(widget, &buffer);
+            }
+        }
+    }
+
+private:
+    void addSizeRows()
+    {
+        QTest::addColumn<QString>("fileName");
+        for (const auto &[name, options] : Sizes)
+            QTest::newRow(name) << QString("%1/%2/%2.rc").arg(m_dir.path(), name);
+    }
+
+    QTemporaryDir m_dir;
+};
+
+QTEST_MAIN(BenchRcCore)
+#include "bench_rccore.moc"
@@ -0,0 +1,207 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "bench_utils.h"
+#include "core/mark.h"
+#include "core/rangemark.h"
+#include "core/textdocument.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <utility>
+#include <vector>
+
+// Number of lines in the generated texts, the benchmarks are run for each size
+static constexpr int Sizes[] = {1000, 10000, 100000};
+
+// Generates `lineCount` lines, each one with 2 occurrences of "foo"
+static QString generateText(int lineCount)
+{
+    QString text;
+    for (int i = 0; i < lineCount; ++i)
+        text += QString("    int foo%1 = compute(value, %1); // foo\n").arg(i);
+    return text;
+}
+
+static void addSizeRows()
+{
+    QTest::addColumn<int>("size");
+    for (const int size : Sizes)
+        QTest::newRow(QByteArray::number(size)) << size;
+}
+
+class BenchTextDocument : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        Q_INIT_RESOURCE(core);
+        QVERIFY(m_dir.isValid());
+    }
+
+    // The text is replaced back and forth, so each iteration has the same number of occurrences
+    void replaceAll_data() { addSizeRows(); }
+    void replaceAll()
+    {
+        QFETCH(int, size);
+        Core::TextDocument document;
+        document.setText(generateText(size));
+        QString before = "foo";
+        QString after = "bar";
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            QCOMPARE(document.replaceAll(before, after), size * 2);
+            std::swap(before, after);
+        }
+    }
+
+    void replaceAllRegexp_data() { addSizeRows(); }
+    void replaceAllRegexp()
+    {
+        QFETCH(int, size);
+        Core::TextDocument document;
+        document.setText(generateText(size));
+        const std::pair<QString, QString> replacements[] = {{"foo(\\d+)", "bar\\1"}, {"bar(\\d+)", "foo\\1"}};
+        int iteration = 0;
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            const auto &[regexp, after] = replacements[iteration++ % 2];
+            QCOMPARE(document.replaceAllRegexp(regexp, after), size);
+        }
+    }
+
+    // Inserts text at the start of each line, from the end of the document, the text is reset for each iteration
+    void insertAtPosition_data() { addSizeRows(); }
+    void insertAtPosition()
+    {
+        QFETCH(int, size);
+        const auto text = generateText(size);
+        std::vector<int> lineStarts = {0};
+        for (qsizetype i = text.indexOf('\n'); i != -1 && i + 1 < text.size(); i = text.indexOf('\n', i + 1))
+            lineStarts.push_back(static_cast<int>(i + 1));
+        Core::TextDocument document;
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            document.setText(text);
+            for (auto it = lineStarts.crbegin(); it != lineStarts.crend(); ++it)
+                document.insertAtPosition("// ", *it);
+        }
+    }
+
+    // Replaces all the occurrences with `marks` live marks and range marks, spread in a 10000 lines document
+    void marks_data()
+    {
+        QTest::addColumn<int>("marks");
+        for (const int marks : {0, 100, 1000, 10000})
+            QTest::newRow(QByteArray::number(marks)) << marks;
+    }
+    void marks()
+    {
+        QFETCH(int, marks);
+        constexpr int LineCount = 10000;
+        Core::TextDocument document;
+        document.setText(generateText(LineCount));
+        const int length = static_cast<int>(document.text().size());
+
+        std::vector<Core::Mark> liveMarks;
+        std::vector<Core::RangeMark> liveRangeMarks;
+        for (int i = 0; i < marks; ++i) {
+            const int position = static_cast<int>(static_cast<qint64>(length) * i / marks);
+            liveMarks.push_back(document.createMark(position));
+            liveRangeMarks.push_back(document.createRangeMark(position, std::min(position + 20, length)));
+        }
+        QString before = "foo";
+        QString after = "quux";
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            QCOMPARE(document.replaceAll(before, after), LineCount * 2);
+            std::swap(before, after);
+        }
+        for (const auto &mark : liveMarks)
+            QVERIFY(mark.isValid());
+    }
+
+    // 1000 lookups spread in the document
+    void lineAtPosition_data() { addSizeRows(); }
+    void lineAtPosition()
+    {
+        QFETCH(int, size);
+        Core::TextDocument document;
+        document.setText(generateText(size));
+        const int length = static_cast<int>(document.text().size());
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i)
+                document.lineAtPosition(static_cast<int>(static_cast<qint64>(length) * i / 1000));
+        }
+    }
+
+    void load_data() { addFileRows(); }
+    void load()
+    {
+        QFETCH(QString, fileName);
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            Core::TextDocument document;
+            QVERIFY(document.load(fileName));
+            // The text is only read when used
+            QVERIFY(!document.text().isEmpty());
+        }
+    }
+
+    void save_data() { addFileRows(); }
+    void save()
+    {
+        QFETCH(QString, fileName);
+        Core::TextDocument document;
+        QVERIFY(document.load(fileName));
+        document.text();
+        const auto savedFileName = fileName + ".saved";
+
+        Bench::PeakMemory memory;
+        QBENCHMARK {
+            QVERIFY(document.saveAs(savedFileName));
+        }
+    }
+
+private:
+    // Files with LF line endings, and with CRLF line endings and a BOM
+    void addFileRows()
+    {
+        QTest::addColumn<QString>("fileName");
+        for (const int size : Sizes) {
+            const auto text = generateText(size);
+            for (const auto crlfBom : {false, true}) {
+                const QString name = QString("%1_%2.txt").arg(crlfBom ? "crlf_bom" : "lf").arg(size);
+                QFile file(m_dir.filePath(name));
+                QVERIFY(file.open(QIODevice::WriteOnly));
+                if (crlfBom)
+                    file.write("\xEF\xBB\xBF" + QString(text).replace("\n", "\r\n").toUtf8());
+                else
+                    file.write(text.toUtf8());
+                QTest::newRow(qPrintable(name)) << file.fileName();
+            }
+        }
+    }
+
+    QTemporaryDir m_dir;
+};
+
+QTEST_MAIN(BenchTextDocument)
+#include "bench_textdocument.moc"
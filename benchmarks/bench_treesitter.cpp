@@ -0,0 +1,179 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/cppdocument.h"
+#include "core/cppdocument_p.h"
+#include "core/knutcore.h"
+#include "core/project.h"
+#include "treesitter/languages.h"
+#include "treesitter/parser.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/tree.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <memory>
+
+// Number of functions in the generated sources, the benchmarks are run for each size
+static constexpr int Sizes[] = {100, 1000, 10000};
+
+// Generates a MFC-like source file with `functionCount` method definitions, calls and message map entries
+static QString generateSource(int functionCount)
+{
+    QString source = "#include <QString>\n#include \"mydialog.h\"\n\nBEGIN_MESSAGE_MAP(MyDialog, CDialog)\n";
+    for (int i = 0; i < functionCount; i += 10)
+        source += QString("    ON_BN_CLICKED(IDC_BUTTON%1, &MyDialog::OnButton%1)\n").arg(i);
+    source += "END_MESSAGE_MAP()\n\n";
+
+    for (int i = 0; i < functionCount; ++i) {
+        source += QString(R"EOF(// Computes the value %1
+int MyDialog::method%1(int value, const QString &text)
+{
+    if (value > %1)
+        return compute(value, text.size() /* size */);
+    return helper%1(value);
+}
+
+)EOF")
+                      .arg(i);
+    }
+    return source;
+}
+
+static void addSizeRows()
+{
+    QTest::addColumn<int>("size");
+    for (const int size : Sizes)
+        QTest::newRow(QByteArray::number(size)) << size;
+}
+
+class BenchTreeSitter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        Q_INIT_RESOURCE(core);
+        QVERIFY(m_dir.isValid());
+        for (const int size : Sizes) {
+            QFile file(fileName(size));
+            QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Text));
+            file.write(generateSource(size).toUtf8());
+        }
+        m_core = std::make_unique<Core::KnutCore>();
+        Core::Project::instance()->setRoot(m_dir.path());
+    }
+
+    void cleanupTestCase() { m_core.reset(); }
+
+    void parseString_data() { addSizeRows(); }
+    void parseString()
+    {
+        QFETCH(int, size);
+        const auto source = generateSource(size);
+        treesitter::Parser parser(tree_sitter_cpp());
+
+        QBENCHMARK {
+            QVERIFY(parser.parseString(source).has_value());
+        }
+    }
+
+    void queryMethodDefinition_data() { addSizeRows(); }
+    void queryMethodDefinition()
+    {
+        QFETCH(int, size);
+        auto document = openDocument(size);
+        QVERIFY(document);
+
+        QBENCHMARK {
+            QCOMPARE(document->queryMethodDefinition("MyDialog", "method1").size(), 1);
+        }
+    }
+
+    void queryFunctionCall_data() { addSizeRows(); }
+    void queryFunctionCall()
+    {
+        QFETCH(int, size);
+        auto document = openDocument(size);
+        QVERIFY(document);
+
+        QBENCHMARK {
+            QCOMPARE(document->queryFunctionCall("compute").size(), size);
+        }
+    }
+
+    void findInclude_data() { addSizeRows(); }
+    void findInclude()
+    {
+        QFETCH(int, size);
+        auto document = openDocument(size);
+        QVERIFY(document);
+
+        QBENCHMARK {
+            QCOMPARE(document->query(Core::Queries::findInclude).size(), 2);
+        }
+    }
+
+    void predicates_data()
+    {
+        QTest::addColumn<int>("size");
+        QTest::addColumn<QString>("query");
+
+        const std::pair<const char *, const char *> queries[] = {
+            {"eq", R"EOF(((identifier) @name (#eq? @name "helper1")))EOF"},
+            {"eq_except",
+             R"EOF(((parameter_declaration) @param (#eq_except? "const QString &" @param "identifier")))EOF"},
+            {"like", R"EOF(((parameter_declaration) @param (#like? "const QString &text" @param)))EOF"},
+            {"like_except",
+             R"EOF(((parameter_declaration) @param (#like_except? "const QString&" @param "identifier")))EOF"},
+            {"match", R"EOF(((identifier) @name (#match? "^method[0-9]+$" @name)))EOF"},
+            {"in_message_map",
+             R"EOF(((call_expression (argument_list . (_) . (_) .) @args) @call (#in_message_map? @call @args)))EOF"},
+            {"not_is", R"EOF((function_definition type: (_) @type (#not_is? @type primitive_type)))EOF"},
+            {"exclude", R"EOF((argument_list [(_) @arguments ","]* (#exclude! @arguments comment)))EOF"},
+        };
+        for (const auto &[name, query] : queries) {
+            for (const int size : Sizes)
+                QTest::addRow("%s:%d", name, size) << size << QString(query);
+        }
+    }
+    void predicates()
+    {
+        QFETCH(int, size);
+        QFETCH(QString, query);
+        const auto source = generateSource(size);
+        treesitter::Parser parser(tree_sitter_cpp());
+        const auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        const auto treesitterQuery = std::make_shared<treesitter::Query>(tree_sitter_cpp(), query);
+
+        QBENCHMARK {
+            treesitter::QueryCursor cursor;
+            cursor.execute(treesitterQuery, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            QVERIFY(!cursor.allRemainingMatches().isEmpty());
+        }
+    }
+
+private:
+    QString fileName(int size) const { return m_dir.filePath(QString("source%1.cpp").arg(size)); }
+    Core::CppDocument *openDocument(int size) const
+    {
+        return qobject_cast<Core::CppDocument *>(Core::Project::instance()->open(fileName(size)));
+    }
+
+    QTemporaryDir m_dir;
+    std::unique_ptr<Core::KnutCore> m_core;
+};
+
+QTEST_MAIN(BenchTreeSitter)
+#include "bench_treesitter.moc"
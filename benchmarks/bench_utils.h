@@ -0,0 +1,78 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "utils/allocstats.h"
+
+#include <QtGlobal>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+// windows.h must be included first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace Bench {
+
+// Peak resident memory of the process, in kilobytes
+inline qint64 peakMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return static_cast<qint64>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(Q_OS_MACOS)
+    // In bytes on macOS
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/**
+ * @brief Reports the growth of the peak memory of the process during its lifetime
+ * The report is a message of the benchmark, so it's part of the QtTest output. As the peak of the process can only
+ * grow, rows should go from the smallest to the largest input.
+ * In a KNUT_ALLOC_STATS build, the allocations of the process and of each traced region are reported too.
+ */
+class PeakMemory
+{
+public:
+    PeakMemory()
+        : m_start(peakMemory())
+        , m_allocations(Utils::AllocStats::processCounts())
+    {
+        Utils::AllocStats::reset();
+    }
+    ~PeakMemory()
+    {
+        const auto peak = peakMemory();
+        qInfo("peak memory: +%lld KB (%lld KB)", peak - m_start, peak);
+        if (Utils::AllocStats::isEnabled()) {
+            const auto allocations = Utils::AllocStats::processCounts();
+            qInfo("allocations: %lld (%lld bytes)\n%s", allocations.allocations - m_allocations.allocations,
+                  allocations.bytes - m_allocations.bytes, qPrintable(Utils::AllocStats::report()));
+        }
+    }
+
+private:
+    const qint64 m_start;
+    const Utils::AllocStats::Counts m_allocations;
+};
+
+} // namespace Bench
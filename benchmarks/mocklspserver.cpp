@@ -0,0 +1,280 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+/**
+ * Mock LSP server, used by the LSP benchmarks instead of clangd.
+ *
+ * It answers the requests sent by Lsp::Client with generated results of a configurable size, and sends a burst of
+ * `textDocument/publishDiagnostics` notifications each time a document is opened or changed. With `--trace`, the
+ * latencies and the server notifications of a trace saved by knut (see Lsp::MessageTrace) are replayed.
+ */
+
+#include "lsp/messagetrace.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(Q_OS_WIN)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using json = nlohmann::json;
+using namespace std::chrono_literals;
+
+struct Options
+{
+    int symbols = 1000;
+    int references = 1000;
+    int notifications = 0;
+    std::chrono::microseconds interval {0};
+    std::chrono::microseconds latency {0};
+};
+
+// Latencies and server notifications recorded in a trace
+struct Replay
+{
+    std::unordered_map<std::string, std::vector<uint32_t>> latencies;
+    std::unordered_map<std::string, size_t> nextLatency;
+    // Notifications sent once initialized, with the time since the previous one
+    struct Notification
+    {
+        std::string method;
+        uint32_t size;
+        std::chrono::microseconds delay;
+    };
+    std::vector<Notification> notifications;
+};
+
+static std::optional<std::string> readMessage()
+{
+    size_t length = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            break;
+        constexpr std::string_view ContentLength = "Content-Length:";
+        if (line.starts_with(ContentLength))
+            length = std::stoul(line.substr(ContentLength.size()));
+    }
+    if (!std::cin || length == 0)
+        return {};
+    std::string content(length, '\0');
+    if (!std::cin.read(content.data(), static_cast<std::streamsize>(length)))
+        return {};
+    return content;
+}
+
+static void writeMessage(const std::string &content)
+{
+    std::cout << "Content-Length: " << content.size() << "\r\n\r\n" << content;
+    std::cout.flush();
+}
+
+static json range(int line)
+{
+    return {{"start", {{"line", line}, {"character", 4}}}, {"end", {{"line", line}, {"character", 20}}}};
+}
+
+// Classes of 10 methods each, as clangd returns them
+static json documentSymbols(int count)
+{
+    auto classes = json::array();
+    for (int i = 0; i < count; i += 10) {
+        auto methods = json::array();
+        for (int j = i + 1; j < std::min(i + 10, count); ++j) {
+            methods.push_back({{"name", "method" + std::to_string(j)},
+                               {"detail", "void (int, const std::string &)"},
+                               {"kind", 6},
+                               {"range", range(j)},
+                               {"selectionRange", range(j)}});
+        }
+        classes.push_back({{"name", "Class" + std::to_string(i)},
+                           {"kind", 5},
+                           {"range", range(i)},
+                           {"selectionRange", range(i)},
+                           {"children", std::move(methods)}});
+    }
+    return classes;
+}
+
+static json locations(const std::string &uri, int count)
+{
+    auto result = json::array();
+    for (int i = 0; i < count; ++i)
+        result.push_back({{"uri", uri}, {"range", range(i)}});
+    return result;
+}
+
+static json initializeResult()
+{
+    return {{"capabilities",
+             {{"textDocumentSync", 1},
+              {"documentSymbolProvider", true},
+              {"referencesProvider", true},
+              {"hoverProvider", true},
+              {"declarationProvider", true}}},
+            {"serverInfo", {{"name", "knut-mock-lsp"}}}};
+}
+
+static std::optional<Replay> loadReplay(const QString &fileName)
+{
+    const auto records = Lsp::MessageTrace::load(fileName);
+    if (!records)
+        return {};
+
+    Replay replay;
+    int64_t previous = -1;
+    for (const auto &record : *records) {
+        if (record.type == Lsp::MessageTrace::Type::ReceiveResponse && record.method[0] != '\0') {
+            replay.latencies[record.method].push_back(record.latency);
+        } else if (record.type == Lsp::MessageTrace::Type::ReceiveNotification) {
+            const auto delay = previous == -1 ? 0 : record.timestamp - previous;
+            replay.notifications.push_back({record.method, record.size, std::chrono::microseconds(delay)});
+            previous = record.timestamp;
+        }
+    }
+    return replay;
+}
+
+static std::chrono::microseconds latency(const Options &options, std::optional<Replay> &replay,
+                                         const std::string &method)
+{
+    if (!replay)
+        return options.latency;
+    auto it = replay->latencies.find(method);
+    if (it == replay->latencies.end())
+        return options.latency;
+    auto &next = replay->nextLatency[method];
+    const auto latency = it->second[next++ % it->second.size()];
+    return std::chrono::microseconds(latency);
+}
+
+static void sendDiagnostics(const Options &options, const std::string &uri)
+{
+    for (int i = 0; i < options.notifications; ++i) {
+        if (i > 0 && options.interval > 0us)
+            std::this_thread::sleep_for(options.interval);
+        const json diagnostic = {{"range", range(i)}, {"severity", 2}, {"message", "unused variable"}};
+        const json notification = {{"jsonrpc", "2.0"},
+                                   {"method", "textDocument/publishDiagnostics"},
+                                   {"params", {{"uri", uri}, {"diagnostics", {diagnostic}}}}};
+        writeMessage(notification.dump());
+    }
+}
+
+// The recorded notifications keep their method, their content is padded to the recorded size
+static void replayNotifications(const Replay &replay)
+{
+    for (const auto &notification : replay.notifications) {
+        std::this_thread::sleep_for(notification.delay);
+        json message = {{"jsonrpc", "2.0"}, {"method", notification.method}, {"params", {{"padding", ""}}}};
+        const auto size = message.dump().size();
+        if (notification.size > size)
+            message["params"]["padding"] = std::string(notification.size - size, 'x');
+        writeMessage(message.dump());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mock LSP server, for the knut LSP benchmarks.");
+    parser.addHelpOption();
+    parser.addOptions({{"symbols", "Number of symbols in the documentSymbol responses.", "count", "1000"},
+                       {"references", "Number of locations in the references responses.", "count", "1000"},
+                       {"notifications", "Notifications sent when a document is opened or changed.", "count", "0"},
+                       {"interval", "Time between the notifications, in microseconds.", "us", "0"},
+                       {"latency", "Time before answering a request, in microseconds.", "us", "0"},
+                       {"trace", "Replays the latencies and notifications of a knut LSP trace.", "file"}});
+    parser.process(app);
+
+    Options options;
+    options.symbols = parser.value("symbols").toInt();
+    options.references = parser.value("references").toInt();
+    options.notifications = parser.value("notifications").toInt();
+    options.interval = std::chrono::microseconds(parser.value("interval").toLongLong());
+    options.latency = std::chrono::microseconds(parser.value("latency").toLongLong());
+    std::optional<Replay> replay;
+    if (parser.isSet("trace")) {
+        replay = loadReplay(parser.value("trace"));
+        if (!replay) {
+            std::cerr << "knut-mock-lsp: can't read the trace " << parser.value("trace").toStdString() << "\n";
+            return 1;
+        }
+    }
+
+#if defined(Q_OS_WIN)
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    std::ios::sync_with_stdio(false);
+
+    // The largest results are only serialized once
+    const auto symbolsResult = documentSymbols(options.symbols).dump();
+
+    while (auto content = readMessage()) {
+        const auto message = json::parse(*content, nullptr, false);
+        if (message.is_discarded() || !message.contains("method"))
+            continue;
+        const auto method = message["method"].get<std::string>();
+        const auto uri = message.contains("params") && message["params"].contains("textDocument")
+            ? message["params"]["textDocument"]["uri"].get<std::string>()
+            : std::string();
+
+        // Notifications
+        if (!message.contains("id")) {
+            if (method == "exit")
+                return 0;
+            if (method == "initialized" && replay)
+                replayNotifications(*replay);
+            if (method == "textDocument/didOpen" || method == "textDocument/didChange")
+                sendDiagnostics(options, uri);
+            continue;
+        }
+
+        // Requests
+        if (const auto delay = latency(options, replay, method); delay > 0us)
+            std::this_thread::sleep_for(delay);
+        const auto id = message["id"].dump();
+        std::string result;
+        if (method == "initialize")
+            result = initializeResult().dump();
+        else if (method == "shutdown")
+            result = "null";
+        else if (method == "textDocument/documentSymbol")
+            result = symbolsResult;
+        else if (method == "textDocument/references")
+            result = locations(uri, options.references).dump();
+        else if (method == "textDocument/hover")
+            result = R"({"contents": {"kind": "plaintext", "value": "int value"}})";
+
+        if (result.empty()) {
+            writeMessage(R"({"jsonrpc": "2.0", "id": )" + id
+                         + R"(, "error": {"code": -32601, "message": "Method not found"}})");
+        } else {
+            writeMessage(R"({"jsonrpc": "2.0", "id": )" + id + R"(, "result": )" + result + "}");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "rcgenerator.h"
+
+#include <QColor>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QTextStream>
+#include <algorithm>
+#include <array>
+
+namespace Bench {
+
+static constexpr std::array<std::pair<const char *, const char *>, 8> Languages = {{
+    {"LANG_ENGLISH", "SUBLANG_ENGLISH_US"},
+    {"LANG_FRENCH", "SUBLANG_FRENCH"},
+    {"LANG_GERMAN", "SUBLANG_GERMAN"},
+    {"LANG_SPANISH", "SUBLANG_SPANISH_MODERN"},
+    {"LANG_ITALIAN", "SUBLANG_ITALIAN"},
+    {"LANG_JAPANESE", "SUBLANG_DEFAULT"},
+    {"LANG_KOREAN", "SUBLANG_DEFAULT"},
+    {"LANG_CHINESE", "SUBLANG_CHINESE_SIMPLIFIED"},
+}};
+
+static constexpr int ButtonWidth = 16;
+static constexpr int ButtonHeight = 15;
+
+namespace {
+
+// Ids of the generated resources, in the order they are defined in resource.h
+class Ids
+{
+public:
+    QString add(const QString &id)
+    {
+        m_defines += QString("#define %1 %2\n").arg(id).arg(m_next++);
+        return id;
+    }
+    const QString &defines() const { return m_defines; }
+
+private:
+    QString m_defines;
+    int m_next = 1000;
+};
+
+}
+
+static QString dialogId(int dialog)
+{
+    return QString("IDD_DIALOG%1").arg(dialog);
+}
+
+static QString controlId(int dialog, int control)
+{
+    return QString("IDC_CONTROL%1_%2").arg(dialog).arg(control);
+}
+
+static QString stringId(int string)
+{
+    return QString("IDS_STRING%1").arg(string);
+}
+
+static QString toolBarId(int toolBar)
+{
+    return QString("IDR_TOOLBAR%1").arg(toolBar);
+}
+
+static QString commandId(int toolBar, int button)
+{
+    return QString("ID_COMMAND%1_%2").arg(toolBar).arg(button);
+}
+
+// One control of each kind, laid out on 2 columns
+static QString controlLine(int dialog, int control)
+{
+    const int x = 7 + (control % 2) * 150;
+    const int y = 7 + (control / 2) * 18;
+    const auto id = controlId(dialog, control);
+    switch (control % 5) {
+    case 0:
+        return QString("    LTEXT           \"Label %1\",%2,%3,%4,60,8\n").arg(control).arg(id).arg(x).arg(y);
+    case 1:
+        return QString("    EDITTEXT        %1,%2,%3,100,14,ES_AUTOHSCROLL\n").arg(id).arg(x).arg(y);
+    case 2:
+        return QString("    PUSHBUTTON      \"Button %1\",%2,%3,%4,50,14\n").arg(control).arg(id).arg(x).arg(y);
+    case 3:
+        return QString("    CONTROL         \"Check %1\",%2,\"Button\",BS_AUTOCHECKBOX | WS_TABSTOP,%3,%4,80,10\n")
+            .arg(control)
+            .arg(id)
+            .arg(x)
+            .arg(y);
+    default:
+        return QString("    COMBOBOX        %1,%2,%3,100,30,CBS_DROPDOWN | WS_VSCROLL | WS_TABSTOP\n")
+            .arg(id)
+            .arg(x)
+            .arg(y);
+    }
+}
+
+// A strip of buttons, each one with its own color on a magenta (transparent) background
+static bool writeToolBarBitmap(const QString &fileName, int buttons)
+{
+    QImage image(ButtonWidth * buttons, ButtonHeight, QImage::Format_RGB32);
+    image.fill(Qt::magenta);
+    for (int button = 0; button < buttons; ++button) {
+        const QColor color = QColor::fromHsv((button * 37) % 360, 200, 200);
+        for (int x = 2; x < ButtonWidth - 2; ++x) {
+            for (int y = 2; y < ButtonHeight - 2; ++y)
+                image.setPixelColor(button * ButtonWidth + x, y, color);
+        }
+    }
+    return image.save(fileName, "BMP");
+}
+
+static bool writeFile(const QString &fileName, const QString &content)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    file.write(content.toUtf8());
+    return true;
+}
+
+QString generatedLanguage(int index)
+{
+    const auto &[language, subLanguage] = Languages.at(index % Languages.size());
+    return QString("%1;%2").arg(language, subLanguage);
+}
+
+QString generateRcFile(const QString &dir, const QString &name, const RcGeneratorOptions &options)
+{
+    if (!QDir(dir).mkpath("res"))
+        return {};
+
+    Ids ids;
+    for (int dialog = 0; dialog < options.dialogs; ++dialog) {
+        ids.add(dialogId(dialog));
+        for (int control = 0; control < options.controls; ++control)
+            ids.add(controlId(dialog, control));
+    }
+    for (int string = 0; string < options.strings; ++string)
+        ids.add(stringId(string));
+    for (int toolBar = 0; toolBar < options.toolBars; ++toolBar) {
+        ids.add(toolBarId(toolBar));
+        for (int button = 0; button < options.toolBarButtons; ++button)
+            ids.add(commandId(toolBar, button));
+        if (!writeToolBarBitmap(QString("%1/res/toolbar%2.bmp").arg(dir).arg(toolBar), options.toolBarButtons))
+            return {};
+    }
+    if (!writeFile(dir + "/resource.h", "// Generated resource ids\n//\n" + ids.defines()))
+        return {};
+
+    QString rc;
+    QTextStream stream(&rc);
+    stream << "#include \"resource.h\"\n\n";
+    for (int language = 0; language < std::min<int>(options.languages, Languages.size()); ++language) {
+        const auto &[languageName, subLanguageName] = Languages.at(language);
+        stream << "LANGUAGE " << languageName << ", " << subLanguageName << "\n\n";
+
+        for (int toolBar = 0; toolBar < options.toolBars; ++toolBar) {
+            stream << toolBarId(toolBar) << " BITMAP \"res\\\\toolbar" << toolBar << ".bmp\"\n";
+            stream << toolBarId(toolBar) << " TOOLBAR " << ButtonWidth << ", " << ButtonHeight << "\nBEGIN\n";
+            for (int button = 0; button < options.toolBarButtons; ++button) {
+                if (button > 0 && button % 4 == 0)
+                    stream << "    SEPARATOR\n";
+                stream << "    BUTTON      " << commandId(toolBar, button) << "\n";
+            }
+            stream << "END\n\n";
+        }
+
+        for (int dialog = 0; dialog < options.dialogs; ++dialog) {
+            const int height = 30 + ((options.controls + 1) / 2) * 18;
+            stream << dialogId(dialog) << " DIALOGEX 0, 0, 320, " << height << "\n"
+                   << "STYLE DS_SETFONT | DS_MODALFRAME | DS_FIXEDSYS | WS_POPUP | WS_CAPTION | WS_SYSMENU\n"
+                   << "CAPTION \"Dialog " << dialog << " (" << languageName << ")\"\n"
+                   << "FONT 8, \"MS Shell Dlg\", 400, 0, 0x1\nBEGIN\n";
+            for (int control = 0; control < options.controls; ++control)
+                stream << controlLine(dialog, control);
+            stream << "    DEFPUSHBUTTON   \"OK\",IDOK,263," << height - 21 << ",50,14\nEND\n\n";
+        }
+
+        stream << "STRINGTABLE\nBEGIN\n";
+        for (int string = 0; string < options.strings; ++string)
+            stream << "    " << stringId(string) << " \"String " << string << " in " << languageName << "\"\n";
+        stream << "END\n\n";
+    }
+    stream.flush();
+
+    const auto fileName = QString("%1/%2.rc").arg(dir, name);
+    if (!writeFile(fileName, rc))
+        return {};
+    return fileName;
+}
+
+} // namespace Bench
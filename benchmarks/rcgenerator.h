@@ -0,0 +1,40 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+
+namespace Bench {
+
+/**
+ * @brief Sizes of a generated RC file
+ * Each language has all the dialogs, strings and toolbars. The toolbar bitmaps are shared by all the languages.
+ */
+struct RcGeneratorOptions
+{
+    int dialogs = 10;
+    int controls = 10;
+    int languages = 1;
+    int strings = 100;
+    int toolBars = 2;
+    int toolBarButtons = 10;
+};
+
+/**
+ * @brief Generates a `<name>.rc` and `resource.h` pair in `dir`, with the toolbar bitmaps in `dir/res`
+ * Returns the name of the RC file, or an empty string if a file can't be written.
+ */
+QString generateRcFile(const QString &dir, const QString &name, const RcGeneratorOptions &options);
+
+// Data key of the n-th language of the generated files, as in RcFile::data
+QString generatedLanguage(int index);
+
+} // namespace Bench
@@ -0,0 +1,48 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/knutcore.h"
+#include "core/version.h"
+
+#include <QGuiApplication>
+
+namespace {
+
+// Same command line as knut, without the options of the user interface
+class KnutCli : public Core::KnutCore
+{
+public:
+    KnutCli()
+        : Core::KnutCore(InternalTag {})
+    {
+    }
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // No widget is ever created. The text layout still needs the fonts of a platform: the offscreen one doesn't need a
+    // display, and is much faster to start than a desktop one.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    QGuiApplication::setOrganizationName("KDAB");
+    QGuiApplication::setApplicationName("knut");
+    QGuiApplication::setApplicationVersion(core::knut_version());
+
+    Q_INIT_RESOURCE(core);
+
+    KnutCli knut;
+    knut.process(app.arguments());
+
+    return app.exec();
+}
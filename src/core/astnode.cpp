@@ -11,22 +11,26 @@
 #include "astnode.h"
 #include "codedocument.h"
 #include "codedocument_p.h"
-#include "treesitter/node.h"
-
-#include <QPlainTextEdit>
+#include "utils/log.h"
 
 namespace Core {
 
 AstNode::AstNode(const treesitter::Node &node, CodeDocument *parent)
-    : m_mark(parent, node.startPosition(), node.endPosition())
-    , m_type(node.type())
 {
+    if (node.isNull() || !parent)
+        return;
+    m_document = parent;
+    m_node = node;
+    m_treeRevision = parent->m_treeSitterHelper->treeRevision();
+    m_type = node.rawType();
+    m_start = static_cast<int>(node.startPosition());
+    m_end = static_cast<int>(node.endPosition());
 }
 
 AstNode AstNode::parentNode() const
 {
     if (auto n = node())
-        return AstNode(n->parent(), document());
+        return AstNode(n->parent(), m_document);
     return {};
 }
 
@@ -34,9 +38,8 @@ Core::AstNodeList AstNode::childrenNodes() const
 {
     QList<AstNode> children;
     if (auto n = node()) {
-        const auto childNodes = n->children();
-        for (const auto &node : childNodes) {
-            children.append(AstNode(node, document()));
+        for (const auto &node : n->childRange()) {
+            children.append(AstNode(node, m_document));
         }
     }
     return children;
@@ -44,45 +47,64 @@ Core::AstNodeList AstNode::childrenNodes() const
 
 bool AstNode::isValid() const
 {
-    return m_mark.isValid();
+    if (!m_node || !m_document)
+        return false;
+    // The changes of a transaction only reach the syntax tree once propagated
+    m_document->flushTransaction();
+    return m_document->m_treeSitterHelper->treeRevision() == m_treeRevision;
 }
 
-std::optional<treesitter::Node> AstNode::node() const
+// Creates the RangeMark on demand: most nodes visited by a script are never edited
+RangeMark AstNode::mark() const
 {
     if (!isValid()) {
         spdlog::warn("AstNode is invalid");
-        return std::nullopt;
+        return {};
     }
-
-    if (auto doc = document()) {
-        return doc->m_treeSitterHelper->syntaxTree()->rootNode().descendantForRange(startPos(), endPos());
-    }
-    return std::nullopt;
+    return m_document->createRangeMark(m_start, m_end);
 }
 
-CodeDocument *AstNode::document() const
+std::optional<treesitter::Node> AstNode::node() const
 {
-    return qobject_cast<CodeDocument *>(m_mark.document());
+    if (!isValid()) {
+        spdlog::warn("AstNode is invalid");
+        return std::nullopt;
+    }
+    return m_node;
 }
 
 QString AstNode::type() const
 {
-    return m_type;
+    return QString::fromLatin1(m_type);
 }
 
 QString AstNode::text() const
 {
-    return m_mark.text();
+    if (!isValid())
+        return {};
+    return m_document->plainText().sliced(m_start, m_end - m_start);
 }
 
 int AstNode::startPos() const
 {
-    return m_mark.start();
+    return m_start;
 }
 
 int AstNode::endPos() const
 {
-    return m_mark.end();
+    return m_end;
+}
+
+// Built from the tree and the id of the node, like treesitter::Node equality, and the revision of the tree: addresses
+// are reused by the trees of later revisions
+QString AstNode::key() const
+{
+    if (!m_node)
+        return {};
+    return QStringLiteral("%1:%2:%3")
+        .arg(m_treeRevision)
+        .arg(reinterpret_cast<quintptr>(m_node->m_node.tree), 0, 16)
+        .arg(reinterpret_cast<quintptr>(m_node->m_node.id), 0, 16);
 }
 
 }
@@ -11,12 +11,11 @@
 #pragma once
 
 #include "rangemark.h"
+#include "treesitter/node.h"
 
 #include <QObject>
-
-namespace treesitter {
-class Node;
-}
+#include <QPointer>
+#include <optional>
 
 class TestCodeDocument;
 
@@ -24,6 +23,8 @@ namespace Core {
 
 class CodeDocument;
 
+// Handle on a node of the syntax tree of a document, for the tree revision it was created for: it becomes invalid
+// once the document is changed. Use mark() to get a range following the edits.
 class AstNode
 {
     Q_GADGET
@@ -32,16 +33,20 @@ class AstNode
     Q_PROPERTY(QString text READ text CONSTANT)
     Q_PROPERTY(int startPos READ startPos CONSTANT)
     Q_PROPERTY(int endPos READ endPos CONSTANT)
+    Q_PROPERTY(QString key READ key CONSTANT)
 
 public:
     Q_INVOKABLE Core::AstNode parentNode() const;
     Q_INVOKABLE QList<Core::AstNode> childrenNodes() const;
     Q_INVOKABLE bool isValid() const;
+    Q_INVOKABLE Core::RangeMark mark() const;
 
     QString type() const;
     QString text() const;
     int startPos() const;
     int endPos() const;
+    // Same string for the same node of the same tree revision, to use AstNode in a JavaScript Set or Map
+    QString key() const;
 
     AstNode() = default;
 
@@ -49,11 +54,16 @@ private:
     explicit AstNode(const treesitter::Node &node, CodeDocument *parent);
 
     std::optional<treesitter::Node> node() const;
-    CodeDocument *document() const;
 
 private:
-    RangeMark m_mark;
-    QString m_type;
+    QPointer<CodeDocument> m_document;
+    // Only used while the syntax tree is still at m_treeRevision, it's deleted or edited afterward
+    std::optional<treesitter::Node> m_node;
+    int m_treeRevision = -1;
+    // Owned by the tree-sitter language, valid for the whole process
+    const char *m_type = nullptr;
+    int m_start = -1;
+    int m_end = -1;
 
     friend class CodeDocument;
 };
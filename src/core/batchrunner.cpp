@@ -0,0 +1,262 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "batchrunner.h"
+#include "utils/log.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace Core {
+
+BatchRunner::BatchRunner(QStringList arguments, QStringList files, int jobs, QObject *parent)
+    : QObject(parent)
+    , m_arguments(std::move(arguments))
+    , m_files(std::move(files))
+    , m_jobs(std::max(jobs, 1))
+    , m_results(m_files.size())
+{
+}
+
+BatchRunner::~BatchRunner() = default;
+
+QStringList BatchRunner::readFileList(const QStringList &values)
+{
+    QStringList files;
+    for (const auto &value : values) {
+        if (!value.startsWith('@')) {
+            files.push_back(value);
+            continue;
+        }
+
+        QFile file(value.mid(1));
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            spdlog::error("BatchRunner::readFileList - can't open file list {}", file.fileName());
+            continue;
+        }
+        QTextStream stream(&file);
+        while (!stream.atEnd()) {
+            const auto line = stream.readLine().trimmed();
+            if (!line.isEmpty())
+                files.push_back(line);
+        }
+    }
+    return files;
+}
+
+QStringList BatchRunner::shardFiles(const QStringList &files, int index, int count)
+{
+    Q_ASSERT(count > 0 && index >= 0 && index < count);
+
+    // Largest files first, each one going to the smallest shard: the order of the files with the same size is fixed by
+    // their names, so all the machines get the same shards
+    std::vector<qint64> sizes(files.size());
+    for (qsizetype i = 0; i < files.size(); ++i)
+        sizes[i] = QFileInfo(files.at(i)).size();
+    std::vector<qsizetype> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order, [&](qsizetype lhs, qsizetype rhs) {
+        if (sizes[lhs] != sizes[rhs])
+            return sizes[lhs] > sizes[rhs];
+        return files.at(lhs) < files.at(rhs);
+    });
+
+    std::vector<qint64> shardSizes(count);
+    std::vector<char> inShard(files.size());
+    for (const auto i : order) {
+        const auto shard = std::ranges::min_element(shardSizes) - shardSizes.begin();
+        // Empty files still cost a process
+        shardSizes[shard] += std::max<qint64>(sizes[i], 1);
+        inShard[i] = shard == index;
+    }
+
+    QStringList result;
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        if (inShard[i])
+            result.push_back(files.at(i));
+    }
+    return result;
+}
+
+void BatchRunner::start()
+{
+    if (m_files.isEmpty()) {
+        spdlog::warn("BatchRunner::start - no files to run the script on");
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                emit finished(0);
+            },
+            Qt::QueuedConnection);
+        return;
+    }
+
+    if (!m_patchFile.isEmpty()) {
+        m_patchDir = std::make_unique<QTemporaryDir>();
+        if (!m_patchDir->isValid()) {
+            spdlog::error("BatchRunner::start - can't create a temporary directory for the patches");
+            QMetaObject::invokeMethod(
+                this,
+                [this]() {
+                    emit finished(1);
+                },
+                Qt::QueuedConnection);
+            return;
+        }
+    }
+
+    while (m_running < m_jobs && m_nextJob < m_results.size())
+        startNextJob();
+}
+
+void BatchRunner::setNdjsonOutput(bool ndjson)
+{
+    m_ndjsonOutput = ndjson;
+}
+
+void BatchRunner::setPatchFile(const QString &fileName)
+{
+    m_patchFile = fileName;
+}
+
+void BatchRunner::setRetries(int retries)
+{
+    m_retries = std::max(retries, 0);
+}
+
+void BatchRunner::startNextJob()
+{
+    startJob(m_nextJob++);
+}
+
+QString BatchRunner::jobPatchFile(size_t index) const
+{
+    return m_patchDir->filePath(QString::number(index) + ".patch");
+}
+
+void BatchRunner::startJob(size_t index)
+{
+    auto &job = m_results[index];
+    ++job.attempts;
+
+    job.process = new QProcess(this);
+    job.process->setProcessChannelMode(m_ndjsonOutput ? QProcess::SeparateChannels : QProcess::MergedChannels);
+    connect(job.process, &QProcess::readyReadStandardOutput, this, [this, index]() {
+        m_results[index].output += m_results[index].process->readAllStandardOutput();
+    });
+    connect(job.process, &QProcess::readyReadStandardError, this, [this, index]() {
+        m_results[index].errorOutput += m_results[index].process->readAllStandardError();
+    });
+    connect(job.process, &QProcess::finished, this, [this, index](int exitCode, QProcess::ExitStatus status) {
+        jobFinished(index, status == QProcess::NormalExit ? exitCode : -1);
+    });
+    connect(job.process, &QProcess::errorOccurred, this, [this, index](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            jobFinished(index, -1);
+    });
+
+    QStringList arguments {"--input", QFileInfo(m_files.at(index)).absoluteFilePath()};
+    if (m_patchDir)
+        arguments.append({"--dry-run", "--diff", jobPatchFile(index)});
+
+    ++m_running;
+    job.process->start(QCoreApplication::applicationFilePath(), arguments + m_arguments);
+}
+
+void BatchRunner::jobFinished(size_t index, int exitCode)
+{
+    auto &job = m_results[index];
+    if (job.done)
+        return;
+
+    job.process->disconnect(this);
+    job.process->deleteLater();
+    --m_running;
+
+    // A crash is most likely not the fault of the script, the output of the failed attempt is dropped
+    if (exitCode == -1 && job.attempts <= m_retries) {
+        spdlog::warn("BatchRunner::jobFinished - {} crashed, running it again", m_files.at(index));
+        job.process = nullptr;
+        job.output.clear();
+        job.errorOutput.clear();
+        startJob(index);
+        return;
+    }
+
+    job.output += job.process->readAllStandardOutput();
+    job.errorOutput += job.process->readAllStandardError();
+    job.process = nullptr;
+    job.done = true;
+    job.exitCode = exitCode;
+
+    flushOutput();
+
+    if (m_nextJob < m_results.size()) {
+        startNextJob();
+    } else if (m_running == 0) {
+        writePatch();
+        (m_ndjsonOutput ? std::cerr : std::cout)
+            << "==> " << m_results.size() << " files, " << m_failed << " failed" << std::endl;
+        emit finished(m_exitCode);
+    }
+}
+
+void BatchRunner::writePatch()
+{
+    if (m_patchFile.isEmpty())
+        return;
+
+    QSaveFile file(m_patchFile);
+    if (!file.open(QIODevice::WriteOnly) || file.write(m_patch) != m_patch.size() || !file.commit()) {
+        spdlog::error("BatchRunner::writePatch - can't write the patch {}: {}", m_patchFile, file.errorString());
+        if (m_exitCode == 0)
+            m_exitCode = 1;
+    }
+}
+
+void BatchRunner::flushOutput()
+{
+    while (m_nextOutput < m_results.size() && m_results[m_nextOutput].done) {
+        auto &job = m_results[m_nextOutput];
+        auto &log = m_ndjsonOutput ? std::cerr : std::cout;
+        log << "==> " << m_files.at(m_nextOutput).toStdString() << " (exit code " << job.exitCode << ")\n";
+        log.write(job.errorOutput.constData(), job.errorOutput.size());
+        log.flush();
+        std::cout.write(job.output.constData(), job.output.size());
+        std::cout.flush();
+        job.output.clear();
+        job.errorOutput.clear();
+
+        if (m_patchDir) {
+            QFile patch(jobPatchFile(m_nextOutput));
+            if (patch.open(QIODevice::ReadOnly))
+                m_patch += patch.readAll();
+            patch.close();
+            patch.remove();
+        }
+
+        if (job.exitCode != 0) {
+            ++m_failed;
+            if (m_exitCode == 0)
+                m_exitCode = job.exitCode;
+        }
+        ++m_nextOutput;
+    }
+}
+
+} // namespace Core
@@ -0,0 +1,99 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+class QProcess;
+class QTemporaryDir;
+
+namespace Core {
+
+/**
+ * \brief Runs a script on a list of files, using multiple knut processes
+ *
+ * Each file is handled by its own knut process, started with the `--input` option, so every run gets its own
+ * project and script engine. At most `jobs` processes are running at the same time.
+ *
+ * The output of each process is printed once it's done, in the order of the files, so the result doesn't depend on
+ * the scheduling. The exit code is the one of the first file that failed, in the same order, or 0.
+ *
+ * Large runs can be split between several machines with shardFiles, each one running the same command on its own
+ * shard: the outputs and patches of the shards only need to be concatenated in the shard order.
+ */
+class BatchRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    BatchRunner(QStringList arguments, QStringList files, int jobs, QObject *parent = nullptr);
+    ~BatchRunner() override;
+
+    void start();
+    // The standard output of the processes, the records of Utils.emitRecord, is forwarded as it is, everything else
+    // goes to the standard error
+    void setNdjsonOutput(bool ndjson);
+    // Runs the processes with --dry-run, their patches are merged in the order of the files and written to fileName
+    void setPatchFile(const QString &fileName);
+    // Number of times a process that crashed, or failed to start, is run again
+    void setRetries(int retries);
+
+    // Reads the list of files: `@file` is a file containing one file name per line
+    static QStringList readFileList(const QStringList &values);
+    // Splits the files in `count` shards of about the same total size, and returns the files of the shard `index`, in
+    // the same order. The shards only depend on the list of files and their sizes.
+    static QStringList shardFiles(const QStringList &files, int index, int count);
+
+signals:
+    void finished(int exitCode);
+
+private:
+    struct Job
+    {
+        QProcess *process = nullptr;
+        bool done = false;
+        int exitCode = 0;
+        int attempts = 0;
+        QByteArray output;
+        QByteArray errorOutput;
+    };
+
+    void startNextJob();
+    void startJob(size_t index);
+    void jobFinished(size_t index, int exitCode);
+    void flushOutput();
+    QString jobPatchFile(size_t index) const;
+    void writePatch();
+
+    const QStringList m_arguments;
+    const QStringList m_files;
+    const int m_jobs;
+    bool m_ndjsonOutput = false;
+    int m_retries = 0;
+
+    // Patches of the processes in a dry run, merged in m_patch
+    QString m_patchFile;
+    std::unique_ptr<QTemporaryDir> m_patchDir;
+    QByteArray m_patch;
+
+    std::vector<Job> m_results;
+    size_t m_nextJob = 0;
+    size_t m_nextOutput = 0;
+    int m_running = 0;
+    int m_failed = 0;
+    int m_exitCode = 0;
+};
+
+} // namespace Core
@@ -0,0 +1,252 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "benchrunner.h"
+#include "utils/log.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace Core {
+
+static constexpr char ReportFileName[] = "bench_report.json";
+static constexpr char ProjectDirName[] = "project";
+
+bool BenchRunner::copyDirectory(const QString &from, const QString &to)
+{
+    const QDir fromDir(from);
+    const QDir toDir(to);
+    if (!toDir.mkpath("."))
+        return false;
+
+    QDirIterator it(fromDir.absolutePath(), QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const auto fileInfo = it.fileInfo();
+        const QString path = toDir.filePath(fromDir.relativeFilePath(fileInfo.absoluteFilePath()));
+        if (fileInfo.isDir()) {
+            if (!toDir.mkpath(path))
+                return false;
+        } else if (fileInfo.isFile()) {
+            if (!QFile::copy(fileInfo.absoluteFilePath(), path))
+                return false;
+        }
+    }
+    return true;
+}
+
+static json toJson(const BenchRunner::Statistics &statistics)
+{
+    return {{"min", statistics.min}, {"median", statistics.median}, {"p95", statistics.p95}};
+}
+
+static BenchRunner::Statistics fromJson(const json &value)
+{
+    return {value.at("min").get<qint64>(), value.at("median").get<qint64>(), value.at("p95").get<qint64>()};
+}
+
+static std::string toMilliseconds(qint64 nanoseconds)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.2f ms", nanoseconds / 1e6);
+    return buffer;
+}
+
+BenchRunner::BenchRunner(Options options, QObject *parent)
+    : QObject(parent)
+    , m_options(std::move(options))
+{
+}
+
+BenchRunner::~BenchRunner() = default;
+
+BenchRunner::Statistics BenchRunner::statistics(std::vector<qint64> values)
+{
+    if (values.empty())
+        return {};
+
+    std::sort(values.begin(), values.end());
+    const auto size = values.size();
+    const qint64 median = size % 2 ? values[size / 2] : (values[size / 2 - 1] + values[size / 2]) / 2;
+    // Nearest rank percentile
+    const auto p95Rank = static_cast<size_t>(std::ceil(0.95 * size));
+    return {values.front(), median, values[std::max<size_t>(p95Rank, 1) - 1]};
+}
+
+bool BenchRunner::isRegression(const Result &result, const Result &baseline)
+{
+    return result.scriptTime.median > baseline.scriptTime.median * (1 + RegressionThreshold);
+}
+
+std::optional<BenchRunner::Result> BenchRunner::loadResult(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        spdlog::error("BenchRunner::loadResult - can't open {}", fileName);
+        return {};
+    }
+
+    const auto value = json::parse(file.readAll().toStdString(), nullptr, false);
+    try {
+        return Result {fromJson(value.at("scriptTime")), fromJson(value.at("apiTime")),
+                       fromJson(value.at("engineTime"))};
+    } catch (const json::exception &) {
+        spdlog::error("BenchRunner::loadResult - invalid result file {}", fileName);
+        return {};
+    }
+}
+
+bool BenchRunner::saveResult(const Result &result, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        spdlog::error("BenchRunner::saveResult - can't write {}", fileName);
+        return false;
+    }
+
+    const json value = {{"scriptTime", toJson(result.scriptTime)},
+                        {"apiTime", toJson(result.apiTime)},
+                        {"engineTime", toJson(result.engineTime)}};
+    file.write(QByteArray::fromStdString(value.dump(4)));
+    return true;
+}
+
+void BenchRunner::start()
+{
+    m_directory = std::make_unique<QTemporaryDir>();
+    if (!m_directory->isValid()) {
+        spdlog::error("BenchRunner::start - can't create a temporary directory");
+        emit finished(1);
+        return;
+    }
+    startNextRun();
+}
+
+void BenchRunner::startNextRun()
+{
+    QStringList arguments {"--run", QFileInfo(m_options.script).absoluteFilePath(), "--bench-report",
+                           m_directory->filePath(ReportFileName)};
+
+    // Each run gets a pristine copy of the project, as the previous run may have changed it
+    if (!m_options.project.isEmpty()) {
+        const QString projectPath = m_directory->filePath(ProjectDirName);
+        QDir(projectPath).removeRecursively();
+        if (!copyDirectory(m_options.project, projectPath)) {
+            spdlog::error("BenchRunner::startNextRun - can't copy the project {}", m_options.project);
+            emit finished(1);
+            return;
+        }
+        arguments.append(projectPath);
+    }
+    QFile::remove(m_directory->filePath(ReportFileName));
+
+    m_process = new QProcess(this);
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(m_process, &QProcess::finished, this, [this](int exitCode, QProcess::ExitStatus status) {
+        runFinished(status == QProcess::NormalExit ? exitCode : -1);
+    });
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            runFinished(-1);
+    });
+    m_process->start(QCoreApplication::applicationFilePath(), arguments);
+}
+
+void BenchRunner::runFinished(int exitCode)
+{
+    if (!m_process)
+        return;
+
+    // The output of the script is only shown if the run fails
+    const QByteArray output = m_process->readAll();
+    m_process->deleteLater();
+    m_process = nullptr;
+
+    json report;
+    QFile file(m_directory->filePath(ReportFileName));
+    if (exitCode == 0 && file.open(QIODevice::ReadOnly))
+        report = json::parse(file.readAll().toStdString(), nullptr, false);
+    if (exitCode != 0 || !report.is_object() || !report.contains("scriptTime") || !report.contains("apiTime")) {
+        std::cout.write(output.constData(), output.size());
+        std::cout << "==> run " << m_run + 1 << " failed (exit code " << exitCode << ")" << std::endl;
+        emit finished(exitCode != 0 ? exitCode : 1);
+        return;
+    }
+
+    if (m_run >= m_options.warmup) {
+        m_scriptTimes.push_back(report["scriptTime"].get<qint64>());
+        m_apiTimes.push_back(report["apiTime"].get<qint64>());
+    }
+
+    if (++m_run < m_options.warmup + m_options.repeat)
+        startNextRun();
+    else
+        finish();
+}
+
+void BenchRunner::finish()
+{
+    std::vector<qint64> engineTimes(m_scriptTimes.size());
+    std::transform(m_scriptTimes.cbegin(), m_scriptTimes.cend(), m_apiTimes.cbegin(), engineTimes.begin(),
+                   std::minus<>());
+    const Result result {statistics(m_scriptTimes), statistics(m_apiTimes), statistics(std::move(engineTimes))};
+
+    std::cout << "==> " << QFileInfo(m_options.script).fileName().toStdString() << ", " << m_options.repeat
+              << " runs (" << m_options.warmup << " warmup)\n";
+    auto printRow = [](const char *name, const std::string &min, const std::string &median, const std::string &p95) {
+        char buffer[128];
+        std::snprintf(buffer, sizeof(buffer), "%-8s %14s %14s %14s\n", name, min.c_str(), median.c_str(), p95.c_str());
+        std::cout << buffer;
+    };
+    auto printStatistics = [printRow](const char *name, const Statistics &statistics) {
+        printRow(name, toMilliseconds(statistics.min), toMilliseconds(statistics.median),
+                 toMilliseconds(statistics.p95));
+    };
+    printRow("", "min", "median", "p95");
+    printStatistics("script", result.scriptTime);
+    printStatistics("api", result.apiTime);
+    printStatistics("engine", result.engineTime);
+
+    int exitCode = 0;
+    if (!m_options.baseline.isEmpty()) {
+        const auto baseline = loadResult(m_options.baseline);
+        if (!baseline) {
+            exitCode = 1;
+        } else if (isRegression(result, *baseline)) {
+            std::cout << "==> regression: median " << toMilliseconds(result.scriptTime.median) << ", baseline "
+                      << toMilliseconds(baseline->scriptTime.median) << "\n";
+            exitCode = 1;
+        } else {
+            std::cout << "==> no regression: median " << toMilliseconds(result.scriptTime.median) << ", baseline "
+                      << toMilliseconds(baseline->scriptTime.median) << "\n";
+        }
+    }
+    if (!m_options.saveBaseline.isEmpty() && !saveResult(result, m_options.saveBaseline))
+        exitCode = 1;
+
+    std::cout.flush();
+    emit finished(exitCode);
+}
+
+} // namespace Core
@@ -0,0 +1,97 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <optional>
+#include <vector>
+
+class QProcess;
+class QTemporaryDir;
+
+namespace Core {
+
+/**
+ * \brief Runs a script several times, and reports its timings
+ *
+ * Each run is done by its own knut process, started with the `--bench-report` option, on a fresh copy of the project,
+ * so every run starts from the same files. The first `warmup` runs are not counted.
+ *
+ * The time of each run is split between the time spent in the script API calls, and the rest, spent in the engine.
+ * The median time can be compared to a baseline saved by a previous run, the exit code is 1 if it's slower.
+ */
+class BenchRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        QString script;
+        QString project;
+        int repeat = 10;
+        int warmup = 1;
+        QString baseline;
+        QString saveBaseline;
+    };
+
+    // Times are in nanoseconds
+    struct Statistics
+    {
+        qint64 min = 0;
+        qint64 median = 0;
+        qint64 p95 = 0;
+    };
+
+    struct Result
+    {
+        Statistics scriptTime;
+        Statistics apiTime;
+        Statistics engineTime;
+    };
+
+    // A run slower than the baseline by more than this ratio is a regression
+    static constexpr double RegressionThreshold = 0.1;
+
+    explicit BenchRunner(Options options, QObject *parent = nullptr);
+    ~BenchRunner() override;
+
+    void start();
+
+    static Statistics statistics(std::vector<qint64> values);
+    // Returns true if the median script time is slower than the one of the baseline, by more than the threshold
+    static bool isRegression(const Result &result, const Result &baseline);
+
+    static std::optional<Result> loadResult(const QString &fileName);
+    static bool saveResult(const Result &result, const QString &fileName);
+
+    // Copies the directory recursively, the directory `to` is created if needed
+    static bool copyDirectory(const QString &from, const QString &to);
+
+signals:
+    void finished(int exitCode);
+
+private:
+    void startNextRun();
+    void runFinished(int exitCode);
+    void finish();
+
+    const Options m_options;
+    std::unique_ptr<QTemporaryDir> m_directory;
+    QProcess *m_process = nullptr;
+    int m_run = 0;
+    std::vector<qint64> m_scriptTimes;
+    std::vector<qint64> m_apiTimes;
+};
+
+} // namespace Core
@@ -0,0 +1,70 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "builtinqueries.h"
+#include "codedocument_p.h"
+#include "cppdocument_p.h"
+#include "symbolindex.h"
+#include "treesitter/parser.h"
+#include "treesitter/query.h"
+#include "utils/log.h"
+#include "utils/taskscheduler.h"
+
+namespace Core {
+
+const std::vector<BuiltinQueries::Entry> &BuiltinQueries::all()
+{
+    static const std::vector<Entry> queries = {
+        {"findInclude", Document::Type::Cpp, {Queries::findInclude}},
+        {"findPragma", Document::Type::Cpp, {Queries::findPragma}},
+        {"findHeaderGuard", Document::Type::Cpp, {Queries::findHeaderGuard}},
+        {"classDefinition", Document::Type::Cpp, {Queries::classDefinition}},
+        {"mfcDoDataExchange", Document::Type::Cpp, {Queries::mfcDoDataExchange}},
+        {"mfcDDXCalls", Document::Type::Cpp, {Queries::mfcDDXCalls}},
+        {"mfcDDVCalls", Document::Type::Cpp, {Queries::mfcDDVCalls}},
+        {"mfcMessageMap", Document::Type::Cpp, {Queries::mfcMessageMap(false)}},
+        {"mfcClassMessageMap", Document::Type::Cpp, {Queries::mfcMessageMap(true)}},
+        {"symbols", Document::Type::Cpp, TreeSitterHelper::symbolQueries()},
+        {"symbolIndex", Document::Type::Cpp, {SymbolIndex::symbolsQuery()}},
+    };
+    return queries;
+}
+
+QStringList BuiltinQueries::compile()
+{
+    QStringList errors;
+    for (const auto &entry : all()) {
+        const auto *language = treesitter::Parser::getLanguage(entry.type);
+        try {
+            // Compiled the same way as their users do, so they use the same entries of the cache
+            if (entry.queries.size() == 1) {
+                treesitter::QueryCache::instance().get(language, entry.queries.first());
+            } else {
+                const treesitter::MultiQuery multiQuery(language, entry.queries);
+            }
+        } catch (treesitter::Query::Error &error) {
+            errors.push_back(QString("%1: %2 at %3").arg(entry.name, error.description).arg(error.utf8_offset));
+        }
+    }
+    return errors;
+}
+
+void BuiltinQueries::prewarm()
+{
+    Utils::TaskScheduler::start(
+        []() {
+            const auto errors = compile();
+            for (const auto &error : errors)
+                spdlog::error("BuiltinQueries::prewarm - invalid query {}", error);
+        },
+        Utils::TaskScheduler::Background);
+}
+
+} // namespace Core
@@ -0,0 +1,48 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "document.h"
+
+#include <QStringList>
+#include <vector>
+
+namespace Core {
+
+/**
+ * \brief Registry of the tree-sitter queries run by knut itself
+ *
+ * The queries exposed by the script API, and used internally, are all listed here with their language. They are
+ * checked by the `knut-check-queries` tool at build time, so a broken query fails the build instead of a script, and
+ * compiled in the QueryCache in the background on startup, so their first use doesn't pay for the compilation.
+ *
+ * A new builtin query must be added to the list in builtinqueries.cpp.
+ */
+class BuiltinQueries
+{
+public:
+    struct Entry
+    {
+        const char *name;
+        Document::Type type;
+        // Several queries are run together, as one treesitter::MultiQuery
+        QStringList queries;
+    };
+
+    static const std::vector<Entry> &all();
+
+    // Compiles all the queries in the QueryCache, and returns the errors, empty if all of them are valid
+    static QStringList compile();
+    // Compiles all the queries in a background task
+    static void prewarm();
+};
+
+} // namespace Core
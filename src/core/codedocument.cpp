@@ -15,6 +15,7 @@
 #include "lsp_utils.h"
 #include "project.h"
 #include "querymatch.h"
+#include "queryresultcache.h"
 #include "rangemark.h"
 #include "symbol.h"
 #include "textlocation.h"
@@ -57,7 +58,6 @@ CodeDocument::CodeDocument(Type type, QObject *parent)
     : TextDocument(type, parent)
     , m_treeSitterHelper(std::make_unique<TreeSitterHelper>(this))
 {
-    connect(textEdit()->document(), &QTextDocument::contentsChange, this, &CodeDocument::changeContent);
 }
 
 void CodeDocument::setLspClient(Lsp::Client *client)
@@ -70,6 +70,26 @@ bool CodeDocument::hasLspClient() const
     return m_lspClient != nullptr;
 }
 
+MemoryUsage CodeDocument::memoryUsage() const
+{
+    auto usage = TextDocument::memoryUsage();
+    m_treeSitterHelper->addMemoryUsage(usage);
+
+    // Text last sent to the LSP server, and the changes not sent yet
+    qint64 lspSize = memorySize(m_lspText)
+        + static_cast<qint64>(m_lspChanges.capacity() * sizeof(Lsp::TextDocumentContentChangeEvent));
+    for (const auto &change : m_lspChanges) {
+        std::visit(
+            [&lspSize](const auto &event) {
+                lspSize += static_cast<qint64>(event.text.capacity());
+            },
+            change);
+    }
+    lspSize += static_cast<qint64>(m_lspSymbols.size() * sizeof(Symbol));
+    usage.add("lsp", lspSize);
+    return usage;
+}
+
 /**
  * Returns the symbol the cursor is in, or an empty symbol otherwise
  * The function is used to filter out the symbol
@@ -79,14 +99,25 @@ bool CodeDocument::hasLspClient() const
  */
 Symbol *CodeDocument::currentSymbol(const std::function<bool(const Symbol &)> &filterFunc) const
 {
-    const int pos = textEdit()->textCursor().position();
+    return symbolContaining(textCursor().position(), filterFunc);
+}
 
-    const auto symbolList = symbols();
-    for (auto symbol : symbolList | std::views::reverse) {
-        if (symbol->range().contains(pos) && (!filterFunc || filterFunc(*symbol)))
-            return symbol;
-    }
-    return {};
+/**
+ * Returns the innermost symbol containing pos and accepted by filterFunc, or nullptr.
+ *
+ * Without reparse, the symbols already known are used without reparsing the document: the ones in the declarations
+ * changed since the last parse are missing. It's meant for the GUI, e.g. on each cursor move.
+ */
+Symbol *CodeDocument::symbolContaining(int pos, const std::function<bool(const Symbol &)> &filterFunc,
+                                       bool reparse) const
+{
+    // Only the symbols containing the position are created, not all the symbols of the document
+    const auto &index = m_treeSitterHelper->symbolRangeIndex(reparse);
+    auto accept = [&](int i) {
+        return !filterFunc || filterFunc(*m_treeSitterHelper->symbolAt(i));
+    };
+    const int i = index.ranges.findLast(pos, accept);
+    return i == -1 ? nullptr : m_treeSitterHelper->symbolAt(i);
 }
 
 /**
@@ -136,11 +167,87 @@ void CodeDocument::deleteSymbol(const Symbol &symbol)
  *
  * Note that the returned `Symbol` pointers are only valid until the document they
  * originate from is deconstructed.
+ *
+ * The symbols are found by parsing the document, and returned immediately. If a language server is used, the symbols
+ * it finds are requested in the background: once they have arrived, the ones the parser didn't find are added to the
+ * list, until the document changes.
  */
 Core::SymbolList CodeDocument::symbols() const
 {
     LOG("CodeDocument::symbols");
-    return m_treeSitterHelper->symbols();
+    auto symbols = m_treeSitterHelper->symbols();
+    requestLspSymbols();
+    if (m_lspSymbolsRevision == textRevision())
+        symbols.append(m_lspSymbols);
+    return symbols;
+}
+
+// Never waits for the server, only one request is sent for each revision of the text
+void CodeDocument::requestLspSymbols() const
+{
+    const int revision = textRevision();
+    if (m_lspSymbolsRevision == revision || m_lspSymbolsRequestRevision == revision)
+        return;
+    if (!m_lspClient || m_lspClient->state() != Lsp::Client::Initialized || !m_lspOpened)
+        return;
+
+    sendLspChanges();
+    Lsp::DocumentSymbolParams params;
+    params.textDocument.uri = toUri();
+    m_lspSymbolsRequest.cancel();
+    m_lspSymbolsRequest = m_lspClient->documentSymbolAsync(std::move(params));
+    m_lspSymbolsRequestRevision = revision;
+
+    // The LSP symbols are a cache, like the tree-sitter ones
+    QPointer<CodeDocument> safeThis(const_cast<CodeDocument *>(this));
+    m_lspSymbolsRequest.then(m_lspClient.data(), [safeThis, revision](const auto &result) {
+        if (safeThis && result && safeThis->textRevision() == revision)
+            safeThis->setLspSymbols(*result, revision);
+    });
+}
+
+void CodeDocument::setLspSymbols(const Lsp::TextDocumentDocumentSymbolRequest::Result &result, int revision)
+{
+    // A symbol already found by tree-sitter has the same unqualified name, and surrounds the LSP selection range
+    const auto &entries = m_treeSitterHelper->symbolEntries();
+    auto addSymbol = [&](const QString &name, Lsp::SymbolKind kind, const Lsp::Range &range,
+                         const Lsp::Range &selectionRange) {
+        const auto textSelectionRange = Utils::lspToRange(*this, selectionRange);
+        const auto shortName = name.section("::", -1);
+        if (std::ranges::any_of(entries, [&](const SymbolEntry &entry) {
+                return entry.range.contains(textSelectionRange) && entry.name.section("::", -1) == shortName;
+            }))
+            return;
+        auto symbol = new Symbol(this, QueryMatch(), static_cast<Symbol::Kind>(kind));
+        symbol->m_name = name;
+        symbol->m_range = Utils::lspToRange(*this, range);
+        symbol->m_selectionRange = textSelectionRange;
+        m_lspSymbols.append(symbol);
+    };
+
+    m_lspSymbols.clear();
+    if (const auto *documentSymbols = std::get_if<std::vector<Lsp::DocumentSymbol>>(&result)) {
+        // Names are qualified with the surrounding symbols, like the tree-sitter ones
+        std::function<void(const std::vector<Lsp::DocumentSymbol> &, const QString &)> addSymbols =
+            [&](const std::vector<Lsp::DocumentSymbol> &symbols, const QString &scope) {
+                for (const auto &symbol : symbols) {
+                    const auto name = scope + QString::fromStdString(symbol.name);
+                    addSymbol(name, symbol.kind, symbol.range, symbol.selectionRange);
+                    if (symbol.children)
+                        addSymbols(*symbol.children, name + "::");
+                }
+            };
+        addSymbols(*documentSymbols, {});
+    } else if (const auto *informations = std::get_if<std::vector<Lsp::SymbolInformation>>(&result)) {
+        for (const auto &information : *informations) {
+            auto name = QString::fromStdString(information.name);
+            if (information.containerName && !information.containerName->empty())
+                name = QString::fromStdString(*information.containerName) + "::" + name;
+            addSymbol(name, information.kind, information.location.range, information.location.range);
+        }
+    }
+    m_lspSymbolsRevision = revision;
+    emit symbolsChanged();
 }
 
 struct RegexpTransform
@@ -166,17 +273,8 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Transforms, patterns);
  */
 const Core::Symbol *CodeDocument::symbolUnderCursor() const
 {
-    const auto containsCursor = [this](const Core::Symbol *symbol) {
-        return symbol->selectionRange().contains(textEdit()->textCursor().position());
-    };
-
-    const auto symbols = this->symbols();
-    const auto symbolIter = kdalgorithms::find_if(symbols, containsCursor);
-    if (symbolIter) {
-        return *symbolIter;
-    }
-
-    return nullptr;
+    const int i = m_treeSitterHelper->symbolRangeIndex().selectionRanges.findFirst(textCursor().position());
+    return i == -1 ? nullptr : m_treeSitterHelper->symbolAt(i);
 }
 
 /*!
@@ -187,7 +285,7 @@ const Core::Symbol *CodeDocument::symbolUnderCursor() const
  */
 QString CodeDocument::hover() const
 {
-    return hover(textEdit()->textCursor().position());
+    return hover(textCursor().position());
 }
 
 QString CodeDocument::hover(int position, std::function<void(const QString &)> asyncCallback /*  = {} */) const
@@ -240,11 +338,15 @@ std::pair<QString, std::optional<TextRange>> CodeDocument::hoverWithRange(
     };
 
     if (asyncCallback) {
-        client()->hover(std::move(params),
-                        [convertResult, asyncCallback = std::move(asyncCallback)](const auto result) {
-                            auto hoverText = convertResult(result);
-                            asyncCallback(hoverText.first, hoverText.second);
-                        });
+        // Only the latest hover is of interest, the previous one can be dropped if it's still in flight
+        m_hoverRequest.cancel();
+        m_hoverRequest = client()->hoverAsync(std::move(params));
+        m_hoverRequest.then(client(), [convertResult, asyncCallback = std::move(asyncCallback)](const auto &result) {
+            if (!result)
+                return;
+            auto hoverText = convertResult(result.value());
+            asyncCallback(hoverText.first, hoverText.second);
+        });
     } else {
         auto result = client()->hover(std::move(params));
         if (result) {
@@ -299,23 +401,32 @@ Core::TextLocationList CodeDocument::references(int position) const
 Document *CodeDocument::followSymbol()
 {
     LOG("CodeDocument::followSymbol");
-    if (!checkClient())
-        return {};
-
     // Set the cursor position to the beginning of any selected text.
     // That way, calling followSymbol twice in a row causes Clangd
     // to switch between declaration and definition.
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
+    if (!client())
+        LOG_RETURN("document", followSymbolWithoutLsp(cursor.selectionStart()));
+    if (!checkClient())
+        return {};
+
     LOG_RETURN("document", followSymbol(cursor.selectionStart()));
 }
 
+Document *CodeDocument::followSymbolWithoutLsp(int pos)
+{
+    Q_UNUSED(pos);
+    checkClient();
+    return nullptr;
+}
+
 // At least with clangd, the "declaration" LSP call acts like followSymbol, it will:
 // - Go to the declaration, if the symbol under cursor is a use
 // - Go to the declaration, if the symbol under cursor is a definition
 // - Go to the definition, if the symbol under cursor is a declaration
 Document *CodeDocument::followSymbol(int pos)
 {
-    auto cursor = textEdit()->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(pos);
 
     Lsp::DeclarationParams params;
@@ -377,20 +488,21 @@ Document *CodeDocument::switchDeclarationDefinition()
     if (!checkClient())
         return {};
 
-    auto cursor = textEdit()->textCursor();
-    auto symbolList = symbols();
+    const int pos = textCursor().position();
+    const auto &entries = m_treeSitterHelper->symbolEntries();
 
-    auto currentFunction = kdalgorithms::find_if(symbolList, [&cursor](const auto &symbol) {
-        auto isInRange = symbol->range().start <= cursor.position() && cursor.position() <= symbol->range().end;
-        return isInRange && symbol->isFunction();
+    auto currentFunction = std::ranges::find_if(entries, [pos](const SymbolEntry &entry) {
+        auto isInRange = entry.range.start <= pos && pos <= entry.range.end;
+        return isInRange
+            && (entry.kind == Symbol::Method || entry.kind == Symbol::Function || entry.kind == Symbol::Constructor);
     });
 
-    if (!currentFunction) {
+    if (currentFunction == entries.end()) {
         spdlog::info("CodeDocument::switchDeclarationDefinition: Cursor is currently not within a function!");
         return nullptr;
     }
 
-    LOG_RETURN("document", followSymbol((*currentFunction)->selectionRange().start));
+    LOG_RETURN("document", followSymbol(currentFunction->selectionRange.start));
 }
 
 /*!
@@ -426,24 +538,39 @@ Symbol *CodeDocument::findSymbol(const QString &name, int options) const
 {
     LOG("CodeDocument::findSymbol", LOG_ARG("text", name), options);
 
-    auto symbols = this->symbols();
-    const auto regexp =
-        (options & FindRegexp) ? ::Utils::createRegularExpression(name, options) : QRegularExpression {};
-    auto byName = [name, options, regexp](Symbol *symbol) {
-        if (options & FindWholeWords)
-            return symbol->name().compare(name,
-                                          (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive)
-                == 0;
-        else if (options & FindRegexp)
-            return regexp.match(symbol->name()).hasMatch();
-        else
-            return symbol->name().endsWith(name,
-                                           (options & FindCaseSensitively) ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    // The first symbol matching is returned, the index gives the first entry of each name
+    const auto &index = m_treeSitterHelper->symbolNameIndex();
+    const bool caseSensitive = options & FindCaseSensitively;
+    const QString foldedName = caseSensitive ? QString() : name.toCaseFolded();
+    int first = -1;
+    auto addMatch = [&first](int entryIndex) {
+        if (first == -1 || entryIndex < first)
+            first = entryIndex;
     };
-    auto it = std::ranges::find_if(symbols, byName);
-    if (it != symbols.end())
-        return *it;
-    return nullptr;
+
+    if (options & FindWholeWords) {
+        const auto &names = caseSensitive ? index.byName : index.byFoldedName;
+        first = names.value(caseSensitive ? name : foldedName, -1);
+    } else if (options & FindRegexp) {
+        // Each distinct name is only matched once
+        const auto regexp = ::Utils::createRegularExpression(name, options);
+        for (auto it = index.byName.cbegin(); it != index.byName.cend(); ++it) {
+            if (regexp.match(it.key()).hasMatch())
+                addMatch(it.value());
+        }
+    } else {
+        // The names ending with name, a case-sensitive match is checked on the range of the case-insensitive ones
+        QString reversedName = caseSensitive ? name.toCaseFolded() : foldedName;
+        std::reverse(reversedName.begin(), reversedName.end());
+        const auto &entries = m_treeSitterHelper->symbolEntries();
+        auto it =
+            std::ranges::lower_bound(index.suffixes, reversedName, {}, &SymbolNameIndex::Suffix::reversedFoldedName);
+        for (; it != index.suffixes.end() && it->reversedFoldedName.startsWith(reversedName); ++it) {
+            if (!caseSensitive || entries[it->index].name.endsWith(name))
+                addMatch(it->index);
+        }
+    }
+    return first == -1 ? nullptr : m_treeSitterHelper->symbolAt(first);
 }
 
 void CodeDocument::didOpen()
@@ -451,13 +578,44 @@ void CodeDocument::didOpen()
     if (!m_lspClient)
         return;
 
+    // The document is opened once the server is initialized, with the text it has at that time
+    if (m_lspClient->state() == Lsp::Client::Initializing) {
+        if (!m_lspOpenConnection) {
+            m_lspOpenConnection = connect(m_lspClient, &Lsp::Client::stateChanged, this, [this](auto state) {
+                disconnect(m_lspOpenConnection);
+                if (state == Lsp::Client::Initialized)
+                    didOpen();
+            });
+        }
+        return;
+    }
+    if (m_lspClient->state() != Lsp::Client::Initialized)
+        return;
+
+    // The client may close the document on the server if too many are opened, and open it again when needed
+    QPointer<CodeDocument> safeThis(this);
+    m_lspClient->didOpen(lspOpenParams(), [safeThis]() -> std::optional<Lsp::DidOpenTextDocumentParams> {
+        if (!safeThis)
+            return {};
+        return safeThis->lspOpenParams();
+    });
+}
+
+Lsp::DidOpenTextDocumentParams CodeDocument::lspOpenParams()
+{
     Lsp::DidOpenTextDocumentParams params;
     params.textDocument.uri = toUri();
     params.textDocument.version = revision();
-    params.textDocument.text = textEdit()->toPlainText().toStdString();
+    params.textDocument.text = plainText().toStdString();
     params.textDocument.languageId = m_lspClient->languageId();
 
-    m_lspClient->didOpen(std::move(params));
+    // Changes made before are part of the text sent here
+    m_lspOpened = true;
+    m_lspChanges.clear();
+    m_lspFullChange = false;
+    if (m_lspClient->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental))
+        m_lspText = plainText();
+    return params;
 }
 
 void CodeDocument::didClose()
@@ -465,6 +623,14 @@ void CodeDocument::didClose()
     if (!m_lspClient)
         return;
 
+    disconnect(m_lspOpenConnection);
+    if (!m_lspOpened)
+        return;
+    m_lspOpened = false;
+    m_lspChanges.clear();
+    m_lspFullChange = false;
+    m_lspText.clear();
+
     Lsp::DidCloseTextDocumentParams params;
     params.textDocument.uri = toUri();
 
@@ -481,7 +647,8 @@ std::string CodeDocument::toUri() const
     return QUrl::fromLocalFile(fileName()).toString().toStdString();
 }
 
-std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query)
+std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                                       const treesitter::QueryParameters &parameters)
 {
     const auto &tree = m_treeSitterHelper->syntaxTree();
     if (!tree || !query) {
@@ -490,13 +657,19 @@ std::optional<treesitter::QueryCursor> CodeDocument::createQueryCursor(const std
 
     treesitter::QueryCursor cursor;
     cursor.setProgressCallback(ScriptDialogItem::updateProgress);
-    cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text()));
+    cursor.execute(query, tree->rootNode(), m_treeSitterHelper->makePredicates(parameters));
     return cursor;
 }
 
-Core::QueryMatch CodeDocument::queryFirst(const std::shared_ptr<treesitter::Query> &query)
+std::shared_ptr<const treesitter::TreeSnapshot> CodeDocument::syntaxSnapshot()
+{
+    return m_treeSitterHelper->snapshot();
+}
+
+Core::QueryMatch CodeDocument::queryFirst(const std::shared_ptr<treesitter::Query> &query,
+                                          const treesitter::QueryParameters &parameters)
 {
-    auto cursor = createQueryCursor(query);
+    auto cursor = createQueryCursor(query, parameters);
     if (!cursor.has_value()) {
         return {};
     }
@@ -509,9 +682,10 @@ Core::QueryMatch CodeDocument::queryFirst(const std::shared_ptr<treesitter::Quer
     }
 }
 
-Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query> &query)
+Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query> &query,
+                                         const treesitter::QueryParameters &parameters)
 {
-    auto cursor = createQueryCursor(query);
+    auto cursor = createQueryCursor(query, parameters);
     if (!cursor.has_value()) {
         return {};
     }
@@ -530,13 +704,41 @@ Core::QueryMatchList CodeDocument::query(const std::shared_ptr<treesitter::Query
  * The query is using [Tree-sitter
  * queries](https://tree-sitter.github.io/tree-sitter/using-parsers#pattern-matching-with-queries).
  *
+ * When the document is not parsed yet, the matches are looked for in the project cache first, keyed by the text of
+ * the document and the query: a file that didn't change since the last run is then not parsed at all.
+ *
  * Also see: [Tree-sitter in Knut](../../getting-started/treesitter.md)
  */
 Core::QueryMatchList CodeDocument::query(const QString &query)
 {
     LOG("CodeDocument::query", LOG_ARG("query", query));
 
-    return this->query(m_treeSitterHelper->constructQuery(query));
+    const auto tsQuery = m_treeSitterHelper->constructQuery(query);
+    // Once parsed, running the query on the syntax tree is cheaper than hashing the text
+    const auto cache = QueryResultCache::projectCache();
+    if (!tsQuery || !cache.isEnabled() || m_treeSitterHelper->parseState() != TreeSitterHelper::ParseState::NotParsed)
+        return this->query(tsQuery);
+
+    const auto key = QueryResultCache::key(plainText(), type(), query);
+    if (const auto cached = cache.load(key)) {
+        return kdalgorithms::transformed<Core::QueryMatchList>(*cached, [&](const QueryResultCache::Match &match) {
+            return QueryMatch(*this, tsQuery, match);
+        });
+    }
+
+    auto cursor = createQueryCursor(tsQuery);
+    if (!cursor.has_value())
+        return {};
+    const auto matches = cursor->allRemainingMatches();
+    cache.save(key, kdalgorithms::transformed<QueryResultCache::MatchList>(matches, &QueryResultCache::toMatch));
+    return kdalgorithms::transformed<Core::QueryMatchList>(matches, [this](const treesitter::QueryMatch &match) {
+        return QueryMatch(*this, match);
+    });
+}
+
+Core::QueryMatchList CodeDocument::query(const QString &query, const treesitter::QueryParameters &parameters)
+{
+    return this->query(m_treeSitterHelper->constructQuery(query), parameters);
 }
 
 /*!
@@ -559,42 +761,169 @@ Core::QueryMatch CodeDocument::queryFirst(const QString &query)
     return this->queryFirst(m_treeSitterHelper->constructQuery(query));
 }
 
+Core::QueryMatch CodeDocument::queryFirst(const QString &query, const treesitter::QueryParameters &parameters)
+{
+    return this->queryFirst(m_treeSitterHelper->constructQuery(query), parameters);
+}
+
+/*!
+ * \qmlmethod object CodeDocument::queryMany(object queries)
+ * Runs several Tree-sitter queries in a single walk of the syntax tree, and returns the matches of each one.
+ *
+ * `queries` maps a name to a query, the result maps the same names to the list of matches of each query. The queries
+ * are compiled together, so running them this way is faster than calling `query` for each one:
+ *
+ * ```js
+ * let result = document.queryMany({
+ *     classes: "(class_specifier name: (_) @name)",
+ *     enums: "(enum_specifier name: (_) @name)"
+ * })
+ * for (let match of result.classes)
+ *     Message.log(match.get("name").text)
+ * ```
+ *
+ * \sa CodeDocument::query
+ */
+QVariantMap CodeDocument::queryMany(const QVariantMap &queries)
+{
+    LOG("CodeDocument::queryMany", LOG_ARG("queries", queries));
+
+    const auto &tree = m_treeSitterHelper->syntaxTree();
+    if (!tree)
+        return {};
+
+    QStringList texts;
+    for (const auto &query : queries)
+        texts.push_back(query.toString());
+    const auto matches = m_treeSitterHelper->queryManyInNodes({tree->rootNode()}, texts);
+
+    QVariantMap result;
+    int index = 0;
+    for (auto it = queries.cbegin(); it != queries.cend(); ++it, ++index) {
+        QVariantList list;
+        list.reserve(matches[index].size());
+        for (const auto &match : matches[index])
+            list.push_back(QVariant::fromValue(match));
+        result[it.key()] = list;
+    }
+    return result;
+}
+
+/*!
+ * \qmlmethod ArrayBuffer CodeDocument::queryRanges(string query, string captureName)
+ * Runs the given Tree-sitter `query` and returns the ranges of its `captureName` capture, packed in an `ArrayBuffer`.
+ *
+ * Each capture found is a pair of 32-bit integers, its start and end positions. No `QueryMatch` is created, so it's a
+ * lot faster than `query` when only the positions are needed, e.g. to count or bucket the matches:
+ *
+ * ```js
+ * let ranges = new Int32Array(document.queryRanges("(call_expression function: (_) @function)", "function"))
+ * for (let i = 0; i < ranges.length; i += 2)
+ *     Message.log(ranges[i] + " - " + ranges[i + 1])
+ * ```
+ *
+ * A quantified capture gives one pair for each node captured. The result is empty if the query has no such capture.
+ */
+QByteArray CodeDocument::queryRanges(const QString &query, const QString &captureName)
+{
+    LOG("CodeDocument::queryRanges", LOG_ARG("query", query), LOG_ARG("captureName", captureName));
+
+    const auto tsQuery = m_treeSitterHelper->constructQuery(query);
+    if (!tsQuery)
+        return {};
+    const int id = tsQuery->captureIndex(captureName);
+    if (id == -1) {
+        spdlog::warn("CodeDocument::queryRanges: No capture {} in the query", captureName);
+        return {};
+    }
+    auto cursor = createQueryCursor(tsQuery);
+    if (!cursor)
+        return {};
+
+    std::vector<qint32> ranges;
+    while (auto match = cursor->nextMatch()) {
+        for (const auto &capture : match->captures()) {
+            if (static_cast<int>(capture.id) != id)
+                continue;
+            ranges.push_back(static_cast<qint32>(capture.node.startPosition()));
+            ranges.push_back(static_cast<qint32>(capture.node.endPosition()));
+        }
+    }
+    return QByteArray(reinterpret_cast<const char *>(ranges.data()),
+                      static_cast<qsizetype>(ranges.size() * sizeof(qint32)));
+}
+
+/*!
+ * \qmlmethod QueryIterator CodeDocument::queryIterator(string query)
+ * Runs the given Tree-sitter `query` and returns an iterator over its matches.
+ *
+ * Matches are only searched for when calling `QueryIterator::next`, which avoids computing all of them when only the
+ * first few are needed. The iterator is invalidated as soon as the document changes.
+ *
+ * \sa CodeDocument::query
+ */
+Core::QueryIterator *CodeDocument::queryIterator(const QString &query)
+{
+    LOG("CodeDocument::queryIterator", LOG_ARG("query", query));
+
+    // No parent: the iterator is owned by the caller, the JavaScript engine when called from a script
+    return new QueryIterator(this, createQueryCursor(m_treeSitterHelper->constructQuery(query)));
+}
+
 /**
  * \qmlmethod array<QueryMatch> CodeDocument::queryInRange(RangeMark range, string query)
  *
  * Searches for the given `query`, but only in the provided `range`.
  *
+ * If the document is larger than the `/treesitter/rangeParseThreshold` setting (in characters, 0 to disable) and not
+ * parsed yet, only the top-level declarations around the range are parsed, instead of the whole document. Matches
+ * needing the rest of the document, like a class declared elsewhere, are then not found.
+ *
  * \sa CodeDocument::query
  */
 Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, const QString &query)
 {
     LOG("CodeDocument::queryInRange", LOG_ARG("range", range), LOG_ARG("query", query));
 
+    return queryInRange(range, query, {});
+}
+
+Core::QueryMatchList CodeDocument::queryInRange(const Core::RangeMark &range, const QString &query,
+                                                const treesitter::QueryParameters &parameters)
+{
     if (!range.isValid()) {
         spdlog::warn("CodeDocument::queryInRange: Range is not valid");
         return {};
     }
 
-    const auto nodes = m_treeSitterHelper->nodesInRange(range);
-
-    if (nodes.isEmpty()) {
-        spdlog::warn("CodeDocument::queryInRange: No nodes in range");
-        return {};
-    }
-    spdlog::debug("CodeDocument::queryInRange: Found {} nodes in range", nodes.size());
-
     auto tsQuery = m_treeSitterHelper->constructQuery(query);
     if (!tsQuery)
         return {};
+    // A large document not parsed yet only parses the declarations around the range
+    const treesitter::Tree *tree = m_treeSitterHelper->rangeSyntaxTree(range.toTextRange());
+    const bool isRangeTree = tree != nullptr;
+    if (!tree) {
+        const auto &syntaxTree = m_treeSitterHelper->syntaxTree();
+        if (!syntaxTree)
+            return {};
+        tree = &syntaxTree.value();
+    }
+
+    // The query runs on the outermost nodes inside the range, so the whole pattern of a match is in the range, not only
+    // its captures. The byte range keeps the cursor from walking outside of it.
+    const auto nodes = TreeSitterHelper::nodesInRange(*tree, range);
+    spdlog::debug("CodeDocument::queryInRange: Found {} nodes in range", nodes.size());
 
     treesitter::QueryCursor cursor;
+    cursor.setByteRange(static_cast<uint32_t>(range.start()) * sizeof(QChar),
+                        static_cast<uint32_t>(range.end()) * sizeof(QChar));
     Core::QueryMatchList matches;
     for (const treesitter::Node &node : nodes) {
-        cursor.execute(tsQuery, node, std::make_unique<treesitter::Predicates>(text()));
-        matches.append(kdalgorithms::transformed<QList<QueryMatch>>(cursor.allRemainingMatches(),
-                                                                    [this](const treesitter::QueryMatch &match) {
-                                                                        return QueryMatch(*this, match);
-                                                                    }));
+        cursor.execute(tsQuery, node,
+                       isRangeTree ? m_treeSitterHelper->makeRangePredicates(parameters)
+                                   : m_treeSitterHelper->makePredicates(parameters));
+        while (auto match = cursor.nextMatch())
+            matches.emplace_back(*this, *match);
     }
     return matches;
 }
@@ -606,79 +935,106 @@ int CodeDocument::revision() const
 
 bool CodeDocument::checkClient() const
 {
-    Q_ASSERT(textEdit());
+    Q_ASSERT(textDocument());
     if (!client()) {
         spdlog::error("CodeDocument {} has no LSP client - API not available", fileName());
         return false;
     }
+    // The server may still be starting in the background, the document is opened once it's initialized
+    if (!client()->waitForInitialized()) {
+        spdlog::error("CodeDocument {} - LSP server not initialized - API not available", fileName());
+        return false;
+    }
+    // The server needs to know the current text before answering any request
+    const_cast<CodeDocument *>(this)->flushTransaction();
+    sendLspChanges();
     return true;
 }
 
 void CodeDocument::changeContentLsp(int position, int charsRemoved, int charsAdded)
 {
-    Q_UNUSED(position)
-    Q_UNUSED(charsRemoved)
-    Q_UNUSED(charsAdded)
-
-    // TODO: Keep copy of previous string around, so we can find the oldEndPosition.
-    // const auto document = textEdit()->document();
-    // const auto startblock = document->findBlock(position);
-    // spdlog::warn("start point: {}, {}", startblock.blockNumber(), position - startblock.position());
-
-    // const auto newEndPosition = position + charsAdded;
-    // const auto newEndBlock = document->findBlock(newEndPosition);
-    // spdlog::warn("new end point: {}, {}", newEndBlock.blockNumber(), newEndPosition - newEndBlock.position());
-
-    // const auto plain = document->toPlainText();
-    // spdlog::warn("added: {}", plain.sliced(position, charsAdded));
+    // The whole text is sent when opening the document
+    if (!m_lspClient || !m_lspOpened)
+        return;
 
-    if (!checkClient()) {
+    if (client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental)) {
+        // Once the whole text has to be sent, there's no need to track the changes anymore
+        if (!m_lspFullChange) {
+            // QTextDocument reports changes of the whole document (e.g. setPlainText) including the final paragraph
+            // separator, which isn't part of the text. Those can't be mapped to a range, so send the whole text.
+            const int newSize = textDocument()->characterCount() - 1;
+            if (position < 0 || position + charsRemoved > m_lspText.size() || position + charsAdded > newSize
+                || m_lspText.size() - charsRemoved + charsAdded != newSize) {
+                m_lspFullChange = true;
+                m_lspChanges.clear();
+            } else {
+                // The start position is before the change, so the same in the old and new text
+                Lsp::TextDocumentContentChangeEventPartial event;
+                event.range.start = Utils::lspFromPos(*this, position);
+                const auto removedText = QStringView(m_lspText).sliced(position, charsRemoved);
+                const auto lines = removedText.count(u'\n');
+                event.range.end.line = event.range.start.line + static_cast<unsigned int>(lines);
+                event.range.end.character = lines == 0
+                    ? event.range.start.character + static_cast<unsigned int>(charsRemoved)
+                    : static_cast<unsigned int>(removedText.size() - removedText.lastIndexOf(u'\n') - 1);
+
+                const auto addedText = plainTextInRange(textDocument(), position, position + charsAdded);
+                event.text = addedText.toStdString();
+                m_lspText.replace(position, charsRemoved, addedText);
+                m_lspChanges.emplace_back(std::move(event));
+            }
+        }
+        if (m_lspFullChange)
+            m_lspText = plainText();
+    } else if (client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Full)) {
+        m_lspFullChange = true;
+    } else {
+        spdlog::error("LSP server does not support Document changes!");
         return;
     }
 
-    if (client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Full)
-        || client()->canSendDocumentChanges(Lsp::TextDocumentSyncKind::Incremental)) {
-        // TODO: We currently always send the entire document to the Language server, even
-        // if it supports incremental changes.
-        // Change this, so we also send incremental updates.
-        //
-        // This currently isn't implemented, as changeContent only gets called *after*
-        // the change has happened, but the LSP server needs the locations from *before* the change
-        // has happened, which can no longer be queried.
-
-        Lsp::VersionedTextDocumentIdentifier document;
-        document.version = ++m_revision;
-        document.uri = toUri();
-
-        std::vector<Lsp::TextDocumentContentChangeEvent> events;
-
-        // Set text
-        Lsp::TextDocumentContentChangeEventFull event {};
-        event.text = text().toStdString();
+    if (!m_lspChangesScheduled) {
+        m_lspChangesScheduled = true;
+        QMetaObject::invokeMethod(
+            this,
+            [this]() {
+                sendLspChanges();
+            },
+            Qt::QueuedConnection);
+    }
+}
 
-        events.emplace_back(std::move(event));
+void CodeDocument::sendLspChanges() const
+{
+    m_lspChangesScheduled = false;
+    if (!m_lspClient || (m_lspChanges.empty() && !m_lspFullChange))
+        return;
 
-        Lsp::DidChangeTextDocumentParams params;
-        params.textDocument = document;
-        params.contentChanges = events;
+    Lsp::VersionedTextDocumentIdentifier document;
+    document.version = ++m_revision;
+    document.uri = toUri();
 
-        client()->didChange(std::move(params));
+    Lsp::DidChangeTextDocumentParams params;
+    params.textDocument = document;
+    if (m_lspFullChange) {
+        Lsp::TextDocumentContentChangeEventFull event;
+        event.text = plainText().toStdString();
+        params.contentChanges.emplace_back(std::move(event));
     } else {
-        spdlog::error("LSP server does not support Document changes!");
+        params.contentChanges = std::move(m_lspChanges);
     }
+    m_lspChanges.clear();
+    m_lspFullChange = false;
+
+    m_lspClient->didChange(std::move(params));
 }
 
 void CodeDocument::changeContentTreeSitter(int position, int charsRemoved, int charsAdded)
 {
-    Q_UNUSED(position)
-    Q_UNUSED(charsRemoved)
-    Q_UNUSED(charsAdded)
-
     // Note: This invalidates all existing treesitter::Node instances of this tree!
     // Only use treesitter nodes as long as you're certain the document isn't edited!
-    // TODO: If we keep the old string around, we could implement incremental parsing here.
-    // If TreeSitter parsing ever becomes a performance bottleneck, this would be where to fix it.
-    m_treeSitterHelper->clear();
+    // The tree itself is kept and edited, so the next query only reparses the changed parts.
+    m_treeSitterHelper->edit(position, charsRemoved, charsAdded);
 }
 
 void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
@@ -698,8 +1054,10 @@ void CodeDocument::changeContent(int position, int charsRemoved, int charsAdded)
 
 AstNode CodeDocument::astNodeAt(int pos)
 {
-    const auto root = m_treeSitterHelper->syntaxTree()->rootNode();
-    if (const auto node = root.descendantForRange(pos, pos); !node.isNull()) {
+    const auto &tree = m_treeSitterHelper->syntaxTree();
+    if (!tree)
+        return {};
+    if (const auto node = tree->rootNode().descendantForRange(pos, pos); !node.isNull()) {
         return AstNode(node, this);
     }
     return {};
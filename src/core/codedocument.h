@@ -12,6 +12,7 @@
 
 #include "astnode.h"
 #include "lsp/client.h"
+#include "queryiterator.h"
 #include "querymatch.h"
 #include "symbol.h"
 #include "textdocument.h"
@@ -28,6 +29,7 @@ struct Range;
 
 namespace treesitter {
 class Query;
+class TreeSnapshot;
 }
 
 namespace Core {
@@ -54,18 +56,38 @@ public:
     Q_INVOKABLE Core::QueryMatchList query(const QString &query);
     Q_INVOKABLE Core::QueryMatch queryFirst(const QString &query);
     Q_INVOKABLE Core::QueryMatchList queryInRange(const Core::RangeMark &range, const QString &query);
+    Q_INVOKABLE Core::QueryIterator *queryIterator(const QString &query);
+    Q_INVOKABLE QVariantMap queryMany(const QVariantMap &queries);
+    Q_INVOKABLE QByteArray queryRanges(const QString &query, const QString &captureName);
 
     // This overload exists for improved performance. It's not user-facing API.
     //
     // It turns out that constructing Query instances is relatively expensive.
     // Therefore it's better to construct them once and reuse them.
     // So allow this for outside users.
-    QList<Core::QueryMatch> query(const std::shared_ptr<treesitter::Query> &query);
-    Core::QueryMatch queryFirst(const std::shared_ptr<treesitter::Query> &query);
+    QList<Core::QueryMatch> query(const std::shared_ptr<treesitter::Query> &query,
+                                  const treesitter::QueryParameters &parameters = {});
+    Core::QueryMatch queryFirst(const std::shared_ptr<treesitter::Query> &query,
+                                const treesitter::QueryParameters &parameters = {});
+
+    // Parameterized queries, the `"$name"` string arguments of the predicates are bound to `parameters`.
+    // The query text doesn't depend on the values, so it's compiled only once for all of them.
+    QList<Core::QueryMatch> query(const QString &query, const treesitter::QueryParameters &parameters);
+    Core::QueryMatch queryFirst(const QString &query, const treesitter::QueryParameters &parameters);
+    QList<Core::QueryMatch> queryInRange(const Core::RangeMark &range, const QString &query,
+                                         const treesitter::QueryParameters &parameters);
+
+    // Read-only copy of the syntax tree, to run queries on another thread while the document may change.
+    // Not user-facing API either, a snapshot must only be used by one thread at a time.
+    std::shared_ptr<const treesitter::TreeSnapshot> syntaxSnapshot();
 
     bool hasLspClient() const;
 
+    MemoryUsage memoryUsage() const override;
+
     Symbol *currentSymbol(const std::function<bool(const Symbol &)> &filterFunc) const;
+    Symbol *symbolContaining(int pos, const std::function<bool(const Symbol &)> &filterFunc = {},
+                             bool reparse = true) const;
     void deleteSymbol(const Symbol &symbol);
 
     // As per KUT-163, KNUT-164 and KNUT-165, these are no longer public API.
@@ -82,6 +104,13 @@ public:
 public slots:
     void selectSymbol(const QString &name, int options = NoFindFlags);
 
+signals:
+    // The symbols found by the LSP server have arrived, see symbols()
+    void symbolsChanged();
+    // The syntax tree has been reparsed incrementally, `ranges` are the parts of the text whose syntax changed.
+    // Emitted when the tree is accessed, slots must not change the document.
+    void syntaxChanged(const QList<Core::TextRange> &ranges);
+
 protected:
     explicit CodeDocument(Type type, QObject *parent = nullptr);
 
@@ -93,6 +122,9 @@ protected:
 
     int revision() const;
 
+    // Called by followSymbol when there is no LSP client, the default implementation logs an error.
+    virtual Document *followSymbolWithoutLsp(int pos);
+
     std::pair<QString, std::optional<TextRange>>
     hoverWithRange(int position,
                    std::function<void(const QString &, std::optional<TextRange>)> asyncCallback = {}) const;
@@ -101,21 +133,44 @@ private:
     bool checkClient() const;
     Document *followSymbol(int pos);
 
-    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query);
+    std::optional<treesitter::QueryCursor> createQueryCursor(const std::shared_ptr<treesitter::Query> &query,
+                                                             const treesitter::QueryParameters &parameters = {});
 
-    void changeContent(int position, int charsRemoved, int charsAdded);
+    void changeContent(int position, int charsRemoved, int charsAdded) override;
     void changeContentLsp(int position, int charsRemoved, int charsAdded);
+    void sendLspChanges() const;
+    // Returns the text to open the document on the LSP server, changes are tracked from there
+    Lsp::DidOpenTextDocumentParams lspOpenParams();
     void changeContentTreeSitter(int position, int charsRemoved, int charsAdded);
+    void requestLspSymbols() const;
+    void setLspSymbols(const Lsp::TextDocumentDocumentSymbolRequest::Result &result, int revision);
 
     // Language Server
     QPointer<Lsp::Client> m_lspClient;
-    int m_revision = 0;
+    mutable int m_revision = 0;
+    bool m_lspOpened = false;
+    // Pending didOpen, while the LSP server is still initializing in the background
+    QMetaObject::Connection m_lspOpenConnection;
+    // Text known by the LSP server, only kept for incremental changes: they are based on the text before the change
+    QString m_lspText;
+    // Changes are batched and sent all at once, either once back to the event loop or before the next request
+    mutable std::vector<Lsp::TextDocumentContentChangeEvent> m_lspChanges;
+    mutable bool m_lspFullChange = false;
+    mutable bool m_lspChangesScheduled = false;
+    // Last asynchronous hover request, cancelled when a new one is sent
+    mutable Lsp::RequestFuture<Lsp::TextDocumentHoverRequest> m_hoverRequest;
+    // Symbols found by the LSP server but not by tree-sitter, for the text revision m_lspSymbolsRevision
+    QList<Symbol *> m_lspSymbols;
+    int m_lspSymbolsRevision = -1;
+    mutable Lsp::RequestFuture<Lsp::TextDocumentDocumentSymbolRequest> m_lspSymbolsRequest;
+    mutable int m_lspSymbolsRequestRevision = -1;
 
     // TreeSitter
     friend TreeSitterHelper;
     std::unique_ptr<TreeSitterHelper> m_treeSitterHelper;
 
     friend class AstNode;
+    friend class Project;
 };
 
 } // namespace Core
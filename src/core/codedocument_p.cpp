@@ -10,13 +10,34 @@
 
 #include "codedocument_p.h"
 #include "codedocument.h"
+#include "settings.h"
 #include "treesitter/languages.h"
+#include "treesitter/predicates.h"
+#include "utils/cancellation.h"
 #include "utils/log.h"
+#include "utils/trace.h"
 
+#include <QPlainTextEdit>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <algorithm>
+#include <climits>
 #include <kdalgorithms.h>
 
 namespace Core {
 
+QString plainTextInRange(QTextDocument *document, int from, int to)
+{
+    QTextCursor cursor(document);
+    cursor.setPosition(from);
+    cursor.setPosition(to, QTextCursor::KeepAnchor);
+    auto text = cursor.selectedText();
+    text.replace(QChar::ParagraphSeparator, u'\n');
+    text.replace(QChar::LineSeparator, u'\n');
+    text.replace(QChar::Nbsp, u' ');
+    return text;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // TreeSitterHelper
 ///////////////////////////////////////////////////////////////////////////////
@@ -27,39 +48,387 @@ TreeSitterHelper::TreeSitterHelper(CodeDocument *document)
 
 void TreeSitterHelper::clear()
 {
+    dropInterruptedParse();
+    m_rangeTree.reset();
     m_tree = {};
+    ++m_treeRevision;
+    m_source.clear();
+    m_predicateCaches.reset();
+    m_flags &= ~NeedsReparse;
+    clearSymbols();
+}
+
+void TreeSitterHelper::addMemoryUsage(MemoryUsage &usage) const
+{
+    // Estimate of a tree-sitter subtree: its heap data, and its pointer in the children of its parent
+    constexpr qint64 NodeSize = 80;
+
+    usage.add("syntax tree", m_tree ? static_cast<qint64>(m_tree->nodeCount()) * NodeSize : 0);
+    usage.add("syntax tree source", memorySize(m_source));
+    if (m_rangeTree)
+        usage.add("range syntax tree", static_cast<qint64>(m_rangeTree->tree.nodeCount()) * NodeSize);
+
+    qint64 symbolsSize = static_cast<qint64>(m_symbols.capacity() * sizeof(SymbolEntry));
+    for (const auto &entry : m_symbols) {
+        symbolsSize += entry.match.memorySize();
+        if (entry.symbol)
+            symbolsSize += sizeof(Symbol);
+    }
+    for (const auto &name : m_symbolNames)
+        symbolsSize += memorySize(name);
+    // The exact names are shared with the entries, the folded ones usually are too
+    symbolsSize += static_cast<qint64>((m_symbolNameIndex.byName.size() + m_symbolNameIndex.byFoldedName.size())
+                                       * (sizeof(QString) + sizeof(int)));
+    for (const auto &suffix : m_symbolNameIndex.suffixes)
+        symbolsSize += memorySize(suffix.reversedFoldedName) + sizeof(suffix.index);
+    symbolsSize += m_symbolRangeIndex.ranges.memorySize() + m_symbolRangeIndex.selectionRanges.memorySize();
+    usage.add("symbols", symbolsSize);
+}
+
+void TreeSitterHelper::clearSymbols()
+{
     m_symbols.clear();
+    m_symbolNames.clear();
+    m_dirtySymbolRange.reset();
     m_flags &= ~HasSymbols;
+    ++m_symbolsRevision;
+}
+
+// Sets the parent of each symbol, the symbols must be sorted with the surrounding symbols first
+static void linkSymbolParents(std::vector<SymbolEntry> &entries)
+{
+    std::vector<int> surrounding;
+    for (int i = 0; i < static_cast<int>(entries.size()); ++i) {
+        auto &entry = entries[i];
+        while (!surrounding.empty() && !entries[surrounding.back()].range.contains(entry.range))
+            surrounding.pop_back();
+        entry.parent = surrounding.empty() ? -1 : surrounding.back();
+        surrounding.push_back(i);
+    }
 }
 
-treesitter::Parser &TreeSitterHelper::parser()
+// Drops the symbols touched by the change, and moves the ones after it.
+// The whole top-level declarations touched are dropped, as their structure may have changed (e.g. a class split in
+// two), and the range they covered is marked as dirty, so symbols() only extracts the symbols again in this range.
+void TreeSitterHelper::editSymbols(int position, int charsRemoved, int charsAdded)
 {
-    if (!m_parser) {
-        m_parser = treesitter::Parser(treesitter::Parser::getLanguage(m_document->type()));
+    if (!(m_flags & HasSymbols))
+        return;
+
+    auto intersects = [](const TextRange &range, int start, int end) {
+        return range.start <= end && range.end >= start;
+    };
+
+    int dirtyStart = position;
+    int dirtyEnd = position + charsRemoved;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto &entry : m_symbols) {
+            const auto &range = entry.range;
+            if (intersects(range, dirtyStart, dirtyEnd)
+                && (range.start < dirtyStart || range.end > dirtyEnd)) {
+                dirtyStart = std::min(dirtyStart, range.start);
+                dirtyEnd = std::max(dirtyEnd, range.end);
+                changed = true;
+            }
+        }
     }
+    std::erase_if(m_symbols, [&](const SymbolEntry &entry) {
+        return intersects(entry.range, dirtyStart, dirtyEnd);
+    });
+    ++m_symbolsRevision;
 
-    // Regarding const-ness:
-    // The TreeSitter parser can't change anything about the documents contents.
-    // Therefore it is okay to be returned by non-const reference, even in a const function.
-    return const_cast<treesitter::Parser &>(*m_parser);
+    // Positions after the change are moved, positions inside the removed text go to the end of the added text
+    const int delta = charsAdded - charsRemoved;
+    auto movePosition = [position, charsAdded, delta](int pos) {
+        return pos <= position ? pos : std::max(pos + delta, position + charsAdded);
+    };
+    auto moveRange = [&movePosition](TextRange &range) {
+        range.start = movePosition(range.start);
+        range.end = movePosition(range.end);
+    };
+    for (auto &entry : m_symbols) {
+        moveRange(entry.range);
+        moveRange(entry.selectionRange);
+        // Symbols already given to the user are kept up to date too
+        if (entry.symbol) {
+            entry.symbol->m_range = entry.range;
+            entry.symbol->m_selectionRange = entry.selectionRange;
+        }
+    }
+    linkSymbolParents(m_symbols);
+
+    TextRange dirtyRange {.start = dirtyStart, .end = movePosition(dirtyEnd)};
+    if (m_dirtySymbolRange) {
+        moveRange(*m_dirtySymbolRange);
+        dirtyRange.start = std::min(dirtyRange.start, m_dirtySymbolRange->start);
+        dirtyRange.end = std::max(dirtyRange.end, m_dirtySymbolRange->end);
+    }
+    m_dirtySymbolRange = dirtyRange;
 }
 
-std::optional<treesitter::Tree> &TreeSitterHelper::syntaxTree()
+// Returns the tree-sitter point for the given position in text.
+// As we parse the text as UTF-16, the column of the point is in bytes, not characters.
+static treesitter::Point pointAt(QStringView text, int position)
 {
+    const auto lineStart = text.left(position).lastIndexOf(u'\n') + 1;
+    const auto row = text.left(position).count(u'\n');
+    return treesitter::Point {.row = static_cast<uint32_t>(row),
+                              .column = static_cast<uint32_t>((position - lineStart) * sizeof(QChar))};
+}
+
+static treesitter::Point pointAfter(const treesitter::Point &start, QStringView text)
+{
+    const auto lines = text.count(u'\n');
+    if (lines == 0) {
+        return treesitter::Point {.row = start.row,
+                                  .column = start.column + static_cast<uint32_t>(text.size() * sizeof(QChar))};
+    }
+
+    const auto lastLineLength = text.size() - text.lastIndexOf(u'\n') - 1;
+    return treesitter::Point {.row = start.row + static_cast<uint32_t>(lines),
+                              .column = static_cast<uint32_t>(lastLineLength * sizeof(QChar))};
+}
+
+void TreeSitterHelper::edit(int position, int charsRemoved, int charsAdded)
+{
+    m_rangeTree.reset();
+
+    // Nothing parsed yet, the next access will parse the whole document anyway.
     if (!m_tree) {
-        m_tree = parser().parseString(m_document->text());
-        if (!m_tree) {
-            spdlog::warn("CodeDocument::syntaxTree: Failed to parse document {}!", m_document->fileName());
+        dropInterruptedParse();
+        clearSymbols();
+        return;
+    }
+
+    // QTextDocument reports changes of the whole document (e.g. setPlainText) including the final paragraph
+    // separator, which isn't part of the text. Those can't be mapped to an edit, so reparse from scratch.
+    auto *textDocument = m_document->textDocument();
+    const int newSize = textDocument->characterCount() - 1;
+    if (position < 0 || position + charsRemoved > m_source.size() || position + charsAdded > newSize
+        || m_source.size() - charsRemoved + charsAdded != newSize) {
+        clear();
+        return;
+    }
+
+    // Same text as CodeDocument::text, so m_source stays in sync with it
+    const auto addedText = plainTextInRange(textDocument, position, position + charsAdded);
+
+    const auto startPoint = pointAt(m_source, position);
+    const auto removedText = QStringView(m_source).sliced(position, charsRemoved);
+
+    TSInputEdit edit;
+    edit.start_byte = static_cast<uint32_t>(position * sizeof(QChar));
+    edit.old_end_byte = static_cast<uint32_t>((position + charsRemoved) * sizeof(QChar));
+    edit.new_end_byte = static_cast<uint32_t>((position + charsAdded) * sizeof(QChar));
+    edit.start_point = startPoint;
+    edit.old_end_point = pointAfter(startPoint, removedText);
+    edit.new_end_point = pointAfter(startPoint, addedText);
+    m_tree->edit(edit);
+    ++m_treeRevision;
+
+    m_source.replace(position, charsRemoved, addedText);
+    m_flags |= NeedsReparse;
+    m_predicateCaches.reset();
+
+    editSymbols(position, charsRemoved, charsAdded);
+}
+
+int TreeSitterHelper::treeRevision() const
+{
+    return m_treeRevision;
+}
+
+const TSLanguage *TreeSitterHelper::language() const
+{
+    return treesitter::Parser::getLanguage(m_document->type());
+}
+
+TreeSitterHelper::ParseState TreeSitterHelper::parseState() const
+{
+    return m_parseState;
+}
+
+void TreeSitterHelper::dropInterruptedParse()
+{
+    if (m_interruptedParser) {
+        treesitter::ParserPool::release(std::move(*m_interruptedParser));
+        m_interruptedParser.reset();
+    }
+}
+
+// Parses the text, stopping after the parse timeout or if the script is aborted (see Utils::Cancellation).
+// The parser of an interrupted full parse is kept, so the next parse of the same text continues where it stopped.
+std::optional<treesitter::Tree> TreeSitterHelper::parse(const QString &text, const treesitter::Tree *oldTree)
+{
+    if (oldTree)
+        dropInterruptedParse();
+    auto parser = m_interruptedParser ? std::move(*m_interruptedParser) : treesitter::ParserPool::acquire(language());
+    m_interruptedParser.reset();
+
+    const std::chrono::milliseconds timeout(Settings::instance()->snapshot().parseTimeout);
+    parser.setTimeout(timeout);
+
+    auto tree = parser.parseString(text, oldTree);
+    const bool interrupted = !tree && (timeout.count() > 0 || Utils::Cancellation::isCanceled());
+
+    if (tree) {
+        m_parseState = ParseState::Parsed;
+    } else if (interrupted) {
+        m_parseState = ParseState::Interrupted;
+        spdlog::warn("CodeDocument::syntaxTree: Parsing of {} was interrupted, it continues on the next access",
+                     m_document->fileName());
+        if (!oldTree) {
+            m_interruptedParser = std::move(parser);
+            return tree;
         }
+    } else {
+        m_parseState = ParseState::Failed;
+        spdlog::warn("CodeDocument::syntaxTree: Failed to parse document {}!", m_document->fileName());
+    }
+    treesitter::ParserPool::release(std::move(parser));
+    return tree;
+}
+
+std::optional<treesitter::Tree> &TreeSitterHelper::syntaxTree()
+{
+    TRACE("TreeSitterHelper::syntaxTree", m_document->fileName());
+    // Changes of a transaction are only known once propagated
+    m_document->flushTransaction();
+    if (m_tree && (m_flags & NeedsReparse)) {
+        m_flags &= ~NeedsReparse;
+        auto text = m_document->plainText();
+        // The edits should always keep the text in sync, but better be safe than sorry: reusing an old tree that
+        // doesn't match the text would produce a broken tree.
+        if (text == m_source) {
+            auto tree = parse(text, &m_tree.value());
+            QList<TextRange> changedRanges;
+            if (tree) {
+                for (const auto &[start, end] : m_tree->changedRanges(*tree))
+                    changedRanges.push_back({static_cast<int>(start), static_cast<int>(end)});
+            }
+            m_tree = std::move(tree);
+            ++m_treeRevision;
+            if (!m_tree) {
+                m_source.clear();
+                clearSymbols();
+            }
+            if (!changedRanges.isEmpty())
+                emit m_document->syntaxChanged(changedRanges);
+            return m_tree;
+        }
+        spdlog::debug("CodeDocument::syntaxTree: Syntax tree out of sync with {}, parsing again",
+                      m_document->fileName());
+        m_tree = {};
+        ++m_treeRevision;
+        clearSymbols();
+    }
+
+    if (!m_tree) {
+        m_rangeTree.reset();
+        m_source = m_document->plainText();
+        m_tree = parse(m_source);
+        ++m_treeRevision;
+        if (!m_tree)
+            m_source.clear();
     }
     return m_tree;
 }
 
+// Extends the range to the top-level declarations around it, found from the lines starting at column 0: the start
+// goes back to the last of these lines before the range not starting with a brace, the end goes to the first one after
+// the range, and includes it if it closes a block.
+static TextRange rangeContext(QStringView text, const TextRange &range)
+{
+    auto isTopLevelLine = [&text](qsizetype lineStart) {
+        return lineStart < text.size() && !text[lineStart].isSpace();
+    };
+
+    qsizetype start = text.left(range.start).lastIndexOf(u'\n') + 1;
+    while (start > 0 && (!isTopLevelLine(start) || text[start] == u'}' || text[start] == u'{'))
+        start = text.left(start - 1).lastIndexOf(u'\n') + 1;
+
+    qsizetype end = text.size();
+    for (auto lineEnd = text.indexOf(u'\n', range.end); lineEnd != -1; lineEnd = text.indexOf(u'\n', lineEnd + 1)) {
+        const auto next = lineEnd + 1;
+        if (!isTopLevelLine(next))
+            continue;
+        if (text[next] == u'}') {
+            const auto closeEnd = text.indexOf(u'\n', next);
+            end = closeEnd == -1 ? text.size() : closeEnd + 1;
+        } else {
+            end = next;
+        }
+        break;
+    }
+    return {static_cast<int>(start), static_cast<int>(end)};
+}
+
+const treesitter::Tree *TreeSitterHelper::rangeSyntaxTree(const TextRange &range)
+{
+    m_document->flushTransaction();
+    const int threshold = Settings::instance()->snapshot().rangeParseThreshold;
+    if (m_tree || threshold <= 0 || m_document->textDocument()->characterCount() - 1 < threshold)
+        return nullptr;
+    if (m_rangeTree && m_rangeTree->range.contains(range))
+        return &m_rangeTree->tree;
+
+    TRACE("TreeSitterHelper::rangeSyntaxTree", m_document->fileName());
+    auto source = m_document->plainText();
+    const auto context = rangeContext(source, range);
+    const auto startPoint = pointAt(source, context.start);
+    const treesitter::Range includedRange {
+        .startPoint = startPoint,
+        .endPoint = pointAfter(startPoint, QStringView(source).sliced(context.start, context.length())),
+        .startByte = static_cast<uint32_t>(context.start * sizeof(QChar)),
+        .endByte = static_cast<uint32_t>(context.end * sizeof(QChar))};
+
+    treesitter::PooledParser parser(language());
+    parser->setIncludedRanges({includedRange});
+    auto tree = parser->parseString(source);
+    if (!tree) {
+        spdlog::warn("CodeDocument::rangeSyntaxTree: Failed to parse {} in {}", context.toString(),
+                     m_document->fileName());
+        return nullptr;
+    }
+    m_rangeTree.emplace(context, std::move(source), std::move(*tree));
+    return &m_rangeTree->tree;
+}
+
+std::unique_ptr<treesitter::Predicates> TreeSitterHelper::makeRangePredicates(treesitter::QueryParameters parameters)
+{
+    Q_ASSERT(m_rangeTree);
+    return std::make_unique<treesitter::Predicates>(m_rangeTree->source,
+                                                    std::make_shared<treesitter::PredicateCaches>(),
+                                                    std::move(parameters));
+}
+
+void TreeSitterHelper::setSyntaxTree(treesitter::Tree tree, const QString &source)
+{
+    if (m_tree || source != m_document->plainText())
+        return;
+    dropInterruptedParse();
+    m_rangeTree.reset();
+    m_source = source;
+    m_tree = std::move(tree);
+    m_parseState = ParseState::Parsed;
+    ++m_treeRevision;
+}
+
+std::shared_ptr<const treesitter::TreeSnapshot> TreeSitterHelper::snapshot()
+{
+    const auto &tree = syntaxTree();
+    if (!tree)
+        return {};
+    return std::make_shared<const treesitter::TreeSnapshot>(*tree, m_source);
+}
+
 std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QString &query)
 {
     std::shared_ptr<treesitter::Query> tsQuery;
     try {
-        tsQuery = std::make_shared<treesitter::Query>(parser().language(), query);
+        tsQuery = treesitter::QueryCache::instance().get(language(), query);
     } catch (treesitter::Query::Error &error) {
         spdlog::error("CodeDocument::constructQuery: Failed to parse query `{}` error: {} at: {}", query,
                       error.description, error.utf8_offset);
@@ -68,24 +437,31 @@ std::shared_ptr<treesitter::Query> TreeSitterHelper::constructQuery(const QStrin
     return tsQuery;
 }
 
+std::unique_ptr<treesitter::Predicates> TreeSitterHelper::makePredicates(treesitter::QueryParameters parameters)
+{
+    if (!m_predicateCaches)
+        m_predicateCaches = std::make_shared<treesitter::PredicateCaches>();
+    return std::make_unique<treesitter::Predicates>(m_source, m_predicateCaches, std::move(parameters));
+}
+
+// Moves the cursor to the next node in a depth-first walk, skipping the children of the current node
+static bool gotoNextNode(treesitter::TreeCursor &cursor)
+{
+    while (!cursor.gotoNextSibling()) {
+        if (!cursor.gotoParent())
+            return false;
+    }
+    return true;
+}
+
 // `nodesInRange` returns only the outermost nodes that fit entirely in the given range.
 // The subsequent children of these outermost nodes are *not* returned, even though
 // they are also technically in the range!
 // This is used by queryInRange to find on which nodes to run the query on.
-QList<treesitter::Node> TreeSitterHelper::nodesInRange(const RangeMark &range)
+QList<treesitter::Node> TreeSitterHelper::nodesInRange(const treesitter::Tree &tree, const RangeMark &range)
 {
     enum RangeComparison { Overlaps, Contains, Disjoint };
 
-    const auto &tree = syntaxTree();
-
-    if (!tree) {
-        return {};
-    }
-
-    QList<treesitter::Node> nodesToVisit;
-    QList<treesitter::Node> nodesInRange;
-    nodesToVisit.emplace_back(tree->rootNode());
-
     auto compareToRange = [&range](const treesitter::Node &node) {
         if (range.contains(node.startPosition()) && range.contains(node.endPosition() - 1))
             return RangeComparison::Contains;
@@ -95,49 +471,66 @@ QList<treesitter::Node> TreeSitterHelper::nodesInRange(const RangeMark &range)
         return RangeComparison::Disjoint;
     };
 
-    // Note: This could be improved performance-wise using the first_child_for_byte
-    // functions on either TSNode, or TSTreeCursor.
-    // However, these functions aren't currently wrapped and would make the search a bit more complex.
-    while (!nodesToVisit.isEmpty()) {
-        auto node = nodesToVisit.takeLast();
+    treesitter::TreeCursor cursor(tree.rootNode());
+
+    QList<treesitter::Node> nodesInRange;
+    while (true) {
+        const auto node = cursor.currentNode();
         switch (compareToRange(node)) {
         case RangeComparison::Contains:
             nodesInRange.emplace_back(node);
             break;
         case RangeComparison::Overlaps:
-            nodesToVisit.append(node.children());
+            // Children ending before the range can't be in it, go directly to the first one ending after its start
+            if (cursor.gotoFirstChildForPosition(static_cast<uint32_t>(range.start())))
+                continue;
             break;
         default:
+            // Siblings are sorted: once a node starts after the range, so do the following ones
+            if (static_cast<int>(node.startPosition()) > range.end() && !cursor.gotoParent())
+                return nodesInRange;
             break;
         }
+        if (!gotoNextNode(cursor))
+            break;
     }
 
     return nodesInRange;
 }
 
-void TreeSitterHelper::assignSymbolContexts()
+// Prefixes the names with the names of the surrounding symbols, and turns functions inside a class into methods.
+void TreeSitterHelper::assignSymbolContexts(std::vector<SymbolEntry> &entries)
 {
-    auto contextForSymbol = [this](Symbol *symbol) {
-        auto surroundsSymbol = [&symbol](const Symbol *otherSymbol) {
-            return symbol != otherSymbol && otherSymbol->range().contains(symbol->range());
-        };
-        auto surroundingSymbols = kdalgorithms::filtered(m_symbols, surroundsSymbol);
-
-        kdalgorithms::sort_by(
-            surroundingSymbols,
-            [](const auto &symbol) {
-                return symbol->range().length();
-            },
-            kdalgorithms::descending);
-        return surroundingSymbols;
-    };
+    linkSymbolParents(entries);
 
-    for (const auto &symbol : m_symbols | std::views::reverse) {
-        symbol->assignContext(contextForSymbol(symbol));
+    // Parents come first, so their names are already qualified
+    for (auto &entry : entries) {
+        if (entry.parent == -1) {
+            entry.name = *m_symbolNames.insert(entry.name);
+            continue;
+        }
+        entry.name = *m_symbolNames.insert(entries[entry.parent].name + "::" + entry.name);
+        if (entry.kind != Symbol::Kind::Function)
+            continue;
+        for (int parent = entry.parent; parent != -1; parent = entries[parent].parent) {
+            if (entries[parent].kind == Symbol::Kind::Class) {
+                entry.kind = Symbol::Kind::Method;
+                break;
+            }
+        }
     }
 }
 
-QList<Core::Symbol *> TreeSitterHelper::functionSymbols() const
+SymbolEntry TreeSitterHelper::makeSymbolEntry(const QueryMatch &match, Symbol::Kind kind) const
+{
+    return SymbolEntry {.name = match.get("name").text(),
+                        .kind = kind,
+                        .range = match.get("range").toTextRange(),
+                        .selectionRange = match.get("selectionRange").toTextRange(),
+                        .match = match};
+}
+
+static QString functionSymbolsQuery()
 {
     auto functionDeclarator = R"EOF(
             (function_declarator
@@ -165,7 +558,7 @@ QList<Core::Symbol *> TreeSitterHelper::functionSymbols() const
                                  .arg(functionDeclarator);
 
     // TODO: Add support for pointers & references
-    auto functions = m_document->query(QString(R"EOF(
+    return QString(R"EOF(
                         [; Free functions
                         (function_definition
                           type: (_)? @return
@@ -185,29 +578,28 @@ QList<Core::Symbol *> TreeSitterHelper::functionSymbols() const
                           declarator: %2) @range
 
                         ])EOF")
-                                           .arg(functionDeclarator, pointerDeclarator));
-
-    auto function_to_symbol = [this](const QueryMatch &match) {
-        auto kind = Symbol::Kind::Function;
-        if (!match.get("return").isValid()) {
-            // No return type, this is a Constructor/Destructor
-            // Clangd also assigned the Constructor kind to Destructors, so we'll do the same
-            kind = Symbol::Kind::Constructor;
-        } else if (match.get("name").text().contains("::")) {
-            // This is a bit of a guesstimate, but if the function name contains "::", it's likely a method.
-            // It may also be a member of a namespace, but this information isn't really available unless we try
-            // to resolve the original declaration.
-            kind = Symbol::Kind::Method;
-        }
-        return Symbol::makeSymbol(m_document, match, kind);
-    };
+        .arg(functionDeclarator, pointerDeclarator);
+}
 
-    return kdalgorithms::transformed<QList<Symbol *>>(functions, function_to_symbol);
+static Symbol::Kind functionSymbolKind(const QueryMatch &match)
+{
+    if (!match.get("return").isValid()) {
+        // No return type, this is a Constructor/Destructor
+        // Clangd also assigned the Constructor kind to Destructors, so we'll do the same
+        return Symbol::Kind::Constructor;
+    }
+    if (match.get("name").text().contains("::")) {
+        // This is a bit of a guesstimate, but if the function name contains "::", it's likely a method.
+        // It may also be a member of a namespace, but this information isn't really available unless we try
+        // to resolve the original declaration.
+        return Symbol::Kind::Method;
+    }
+    return Symbol::Kind::Function;
 }
 
-QList<Core::Symbol *> TreeSitterHelper::classSymbols() const
+static QString classSymbolsQuery()
 {
-    auto classesAndStructs = m_document->query(QString(R"EOF(
+    return R"EOF(
             (class_specifier
               name: (_) @name @selectionRange
               body: (field_declaration_list)) @range
@@ -215,18 +607,13 @@ QList<Core::Symbol *> TreeSitterHelper::classSymbols() const
             (struct_specifier
               name: (_) @name @selectionRange
               body: (field_declaration_list)) @range
-    )EOF"));
-    auto class_to_symbol = [this](const QueryMatch &match) {
-        return Symbol::makeSymbol(m_document, match, Symbol::Kind::Class);
-    };
-
-    return kdalgorithms::transformed<QList<Symbol *>>(classesAndStructs, class_to_symbol);
+    )EOF";
 }
 
-QList<Core::Symbol *> TreeSitterHelper::memberSymbols() const
+static QString memberSymbolsQuery()
 {
     auto fieldIdentifier = "(field_identifier) @name @selectionRange";
-    auto members = m_document->query(QString(R"EOF(
+    return QString(R"EOF(
                                         (field_declaration
                                           type: (_) @type
                                           declarator: [
@@ -237,55 +624,278 @@ QList<Core::Symbol *> TreeSitterHelper::memberSymbols() const
                                           ; We need to filter out functions, they are already captured
                                           ; by the functionSymbols query
                                           (#not_is? @decl_type function_declarator)) @range)EOF")
-                                         .arg(fieldIdentifier));
-
-    auto member_to_symbol = [this](const QueryMatch &match) {
-        return Symbol::makeSymbol(m_document, match, Symbol::Kind::Field);
-    };
-
-    return kdalgorithms::transformed<QList<Symbol *>>(members, member_to_symbol);
+        .arg(fieldIdentifier);
 }
 
-QList<Core::Symbol *> TreeSitterHelper::enumSymbols() const
+static QString enumSymbolsQuery()
 {
-    auto enums = m_document->query(R"EOF(
+    return R"EOF(
         (enum_specifier
           name: (_) @name @selectionRange) @range
-    )EOF");
-    auto enum_to_symbol = [this](const QueryMatch &match) {
-        return Symbol::makeSymbol(m_document, match, Symbol::Kind::Enum);
-    };
-    auto result = kdalgorithms::transformed<QList<Symbol *>>(enums, enum_to_symbol);
+    )EOF";
+}
 
-    auto enumerators = m_document->query(R"EOF(
+static QString enumeratorSymbolsQuery()
+{
+    return R"EOF(
         (enumerator
           name: (_) @name @selectionRange
           value: (_)? @value) @range
-    )EOF");
-    result.append(kdalgorithms::transformed<QList<Symbol *>>(enumerators, enum_to_symbol));
+    )EOF";
+}
 
-    return result;
+std::vector<QueryMatchList> TreeSitterHelper::queryManyInNodes(const QList<treesitter::Node> &nodes,
+                                                               const QStringList &queries)
+{
+    std::optional<treesitter::MultiQuery> multiQuery;
+    try {
+        multiQuery.emplace(language(), queries);
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("CodeDocument::queryMany: Failed to parse query, error: {} at: {}", error.description,
+                      error.utf8_offset);
+        return std::vector<QueryMatchList>(queries.size());
+    }
+
+    std::vector<QueryMatchList> matches(queries.size());
+    treesitter::QueryCursor cursor;
+    for (const auto &node : nodes) {
+        cursor.execute(multiQuery->query(), node, makePredicates());
+        while (auto match = cursor.nextMatch()) {
+            const int index = multiQuery->queryIndex(match->patternIndex());
+            if (index >= 0)
+                matches[index].append(QueryMatch(*m_document, *match));
+        }
+    }
+    return matches;
+}
+
+// Returns the top-level declarations intersecting the range, that is the declarations not inside another one.
+// Namespaces, extern "C" blocks and preprocessor conditions (e.g. include guards) are not declarations: the search
+// goes through them.
+QList<treesitter::Node> TreeSitterHelper::topLevelNodes(const TextRange &range)
+{
+    static const QStringList containerTypes = {
+        "translation_unit", "namespace_definition", "declaration_list", "linkage_specification",
+        "preproc_if",       "preproc_ifdef",        "preproc_else",     "preproc_elif",
+    };
+
+    const auto &tree = syntaxTree();
+    if (!tree)
+        return {};
+
+    const treesitter::NodeTypes containers(language(), containerTypes);
+    QList<treesitter::Node> nodes;
+    treesitter::TreeCursor cursor(tree->rootNode());
+    while (true) {
+        const auto node = cursor.currentNode();
+        const bool intersects = static_cast<int>(node.startPosition()) <= range.end
+            && static_cast<int>(node.endPosition()) >= range.start;
+        if (intersects && node.isNamed()) {
+            if (!containers.contains(node))
+                nodes.append(node);
+            else if (cursor.gotoFirstChild())
+                continue;
+        }
+        if (!gotoNextNode(cursor))
+            break;
+    }
+    return nodes;
 }
 
-const QList<Core::Symbol *> &TreeSitterHelper::symbols()
+// Surrounding symbols first, so a class comes before a member starting at the same position
+static bool symbolEntryLessThan(const SymbolEntry &left, const SymbolEntry &right)
 {
-    if (m_flags & HasSymbols)
+    if (left.range.start != right.range.start)
+        return left.range.start < right.range.start;
+    return left.range.end > right.range.end;
+}
+
+const QStringList &TreeSitterHelper::symbolQueries()
+{
+    static const QStringList queries = {classSymbolsQuery(), functionSymbolsQuery(), memberSymbolsQuery(),
+                                        enumSymbolsQuery(), enumeratorSymbolsQuery()};
+    return queries;
+}
+
+std::vector<SymbolEntry> TreeSitterHelper::extractSymbols(const QList<treesitter::Node> &nodes)
+{
+    // All the symbols are extracted in one walk of the tree, the entries are still added query by query, so entries
+    // with the same range keep the same order, see symbolQueries
+    enum { Classes, Functions, Members, Enums, Enumerators };
+    const auto matches = queryManyInNodes(nodes, symbolQueries());
+
+    std::vector<SymbolEntry> entries;
+    for (const auto &match : matches[Classes])
+        entries.push_back(makeSymbolEntry(match, Symbol::Kind::Class));
+    for (const auto &match : matches[Functions])
+        entries.push_back(makeSymbolEntry(match, functionSymbolKind(match)));
+    for (const auto &match : matches[Members])
+        entries.push_back(makeSymbolEntry(match, Symbol::Kind::Field));
+    for (const auto &match : matches[Enums])
+        entries.push_back(makeSymbolEntry(match, Symbol::Kind::Enum));
+    for (const auto &match : matches[Enumerators])
+        entries.push_back(makeSymbolEntry(match, Symbol::Kind::Enum));
+
+    std::ranges::stable_sort(entries, symbolEntryLessThan);
+    assignSymbolContexts(entries);
+    return entries;
+}
+
+const std::vector<SymbolEntry> &TreeSitterHelper::symbolEntries()
+{
+    // Reparse first, as it may drop all the symbols if the tree is parsed from scratch
+    const auto &tree = syntaxTree();
+
+    if (m_flags & HasSymbols) {
+        if (!m_dirtySymbolRange)
+            return m_symbols;
+
+        // Only extract the symbols of the declarations changed since the last call, the others are still valid
+        const auto nodes = topLevelNodes(*m_dirtySymbolRange);
+        m_dirtySymbolRange.reset();
+        if (nodes.isEmpty())
+            return m_symbols;
+
+        TextRange range {.start = static_cast<int>(nodes.first().startPosition()),
+                         .end = static_cast<int>(nodes.first().endPosition())};
+        for (const auto &node : nodes) {
+            range.start = std::min(range.start, static_cast<int>(node.startPosition()));
+            range.end = std::max(range.end, static_cast<int>(node.endPosition()));
+        }
+        std::erase_if(m_symbols, [&range](const SymbolEntry &entry) {
+            return entry.range.start < range.end && entry.range.end > range.start;
+        });
+        auto entries = extractSymbols(nodes);
+        m_symbols.insert(m_symbols.end(), std::make_move_iterator(entries.begin()),
+                         std::make_move_iterator(entries.end()));
+        std::ranges::stable_sort(m_symbols, symbolEntryLessThan);
+        linkSymbolParents(m_symbols);
+        ++m_symbolsRevision;
         return m_symbols;
+    }
 
     m_flags |= HasSymbols;
+    ++m_symbolsRevision;
+    m_dirtySymbolRange.reset();
+    m_symbolNames.clear();
+    m_symbols = tree ? extractSymbols({tree->rootNode()}) : std::vector<SymbolEntry> {};
+    return m_symbols;
+}
+
+Symbol *TreeSitterHelper::symbolAt(int index)
+{
+    auto &entry = m_symbols.at(index);
+    if (!entry.symbol) {
+        entry.symbol = Symbol::makeSymbol(m_document, entry.match, entry.kind);
+        entry.symbol->m_name = entry.name;
+        entry.symbol->m_range = entry.range;
+        entry.symbol->m_selectionRange = entry.selectionRange;
+    }
+    return entry.symbol;
+}
 
-    m_symbols = classSymbols();
-    m_symbols.append(functionSymbols());
-    m_symbols.append(memberSymbols());
-    m_symbols.append(enumSymbols());
+SymbolRangeTree::SymbolRangeTree(const std::vector<TextRange> &ranges)
+    : m_count(static_cast<int>(ranges.size()))
+{
+    m_leafCount = 1;
+    while (m_leafCount < m_count)
+        m_leafCount *= 2;
+    // Node i has the children 2i and 2i + 1, node 0 is unused. The empty leaves contain no position.
+    m_nodes.assign(2 * m_leafCount, TextRange {.start = INT_MAX, .end = INT_MIN});
+    std::ranges::copy(ranges, m_nodes.begin() + m_leafCount);
+    for (int i = m_leafCount - 1; i > 0; --i) {
+        const auto &left = m_nodes[2 * i];
+        const auto &right = m_nodes[2 * i + 1];
+        m_nodes[i] = {.start = std::min(left.start, right.start), .end = std::max(left.end, right.end)};
+    }
+}
 
-    kdalgorithms::sort_by(m_symbols, [](const auto &symbol) {
-        return symbol->range().start;
-    });
+int SymbolRangeTree::findFirst(int pos, const std::function<bool(int)> &accept) const
+{
+    return m_count ? find(1, pos, false, accept) : -1;
+}
 
-    assignSymbolContexts();
+int SymbolRangeTree::findLast(int pos, const std::function<bool(int)> &accept) const
+{
+    return m_count ? find(1, pos, true, accept) : -1;
+}
 
-    return m_symbols;
+qint64 SymbolRangeTree::memorySize() const
+{
+    return static_cast<qint64>(m_nodes.capacity() * sizeof(TextRange));
+}
+
+int SymbolRangeTree::find(int node, int pos, bool last, const std::function<bool(int)> &accept) const
+{
+    if (!m_nodes[node].contains(pos))
+        return -1;
+    if (node >= m_leafCount) {
+        const int index = node - m_leafCount;
+        return !accept || accept(index) ? index : -1;
+    }
+    const int first = last ? 2 * node + 1 : 2 * node;
+    const int second = last ? 2 * node : 2 * node + 1;
+    if (const int index = find(first, pos, last, accept); index != -1)
+        return index;
+    return find(second, pos, last, accept);
+}
+
+int TreeSitterHelper::symbolsRevision() const
+{
+    return m_symbolsRevision;
+}
+
+const SymbolNameIndex &TreeSitterHelper::symbolNameIndex()
+{
+    const auto &entries = symbolEntries();
+    if (m_symbolNameIndex.revision == m_symbolsRevision)
+        return m_symbolNameIndex;
+
+    SymbolNameIndex index {.revision = m_symbolsRevision};
+    index.byName.reserve(entries.size());
+    for (int i = 0; i < static_cast<int>(entries.size()); ++i) {
+        const auto &name = entries[i].name;
+        if (index.byName.contains(name))
+            continue;
+        index.byName.insert(name, i);
+        auto foldedName = name.toCaseFolded();
+        index.byFoldedName.tryEmplace(foldedName, i);
+        std::reverse(foldedName.begin(), foldedName.end());
+        index.suffixes.push_back({std::move(foldedName), i});
+    }
+    std::ranges::sort(index.suffixes, {}, &SymbolNameIndex::Suffix::reversedFoldedName);
+    m_symbolNameIndex = std::move(index);
+    return m_symbolNameIndex;
+}
+
+const SymbolRangeIndex &TreeSitterHelper::symbolRangeIndex(bool update)
+{
+    const auto &entries = update ? symbolEntries() : m_symbols;
+    if (m_symbolRangeIndex.revision == m_symbolsRevision)
+        return m_symbolRangeIndex;
+
+    std::vector<TextRange> ranges;
+    std::vector<TextRange> selectionRanges;
+    ranges.reserve(entries.size());
+    selectionRanges.reserve(entries.size());
+    for (const auto &entry : entries) {
+        ranges.push_back(entry.range);
+        selectionRanges.push_back(entry.selectionRange);
+    }
+    m_symbolRangeIndex = {.revision = m_symbolsRevision,
+                          .ranges = SymbolRangeTree(ranges),
+                          .selectionRanges = SymbolRangeTree(selectionRanges)};
+    return m_symbolRangeIndex;
+}
+
+QList<Core::Symbol *> TreeSitterHelper::symbols()
+{
+    const auto &entries = symbolEntries();
+    QList<Symbol *> result;
+    result.reserve(entries.size());
+    for (int i = 0; i < static_cast<int>(entries.size()); ++i)
+        result.append(symbolAt(i));
+    return result;
 }
 
 } // namespace Core
@@ -10,50 +10,201 @@
 
 #pragma once
 
+#include "memoryusage.h"
 #include "rangemark.h"
 #include "symbol.h"
 #include "treesitter/node.h"
 #include "treesitter/parser.h"
+#include "treesitter/predicates.h"
 #include "treesitter/query.h"
 #include "treesitter/tree.h"
 
+#include <QHash>
 #include <QList>
+#include <QSet>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+class QTextDocument;
 
 namespace Core {
 
 class CodeDocument;
 
+// Returns the text between from and to, with the same replacements as QTextDocument::toPlainText.
+QString plainTextInRange(QTextDocument *document, int from, int to);
+
+// Compact description of a symbol of the document, the Symbol QObject is only created when it's needed (e.g. when
+// returned to a script).
+struct SymbolEntry
+{
+    // Fully qualified name, shared with the other symbols of the same name
+    QString name;
+    Symbol::Kind kind;
+    TextRange range;
+    TextRange selectionRange;
+    // Index of the innermost symbol surrounding this one, -1 for a top-level symbol
+    int parent = -1;
+    QueryMatch match;
+    Symbol *symbol = nullptr;
+};
+
+// Lookup tables of the symbol names, each name is mapped to the index of its first entry
+struct SymbolNameIndex
+{
+    // Revision of the symbol entries the index is built from
+    int revision = -1;
+    QHash<QString, int> byName;
+    QHash<QString, int> byFoldedName;
+    // Each distinct name, case folded and reversed, sorted: the names ending with a text are a range of it
+    struct Suffix
+    {
+        QString reversedFoldedName;
+        int index;
+    };
+    std::vector<Suffix> suffixes;
+};
+
+// Segment tree over ranges, in their order: each node has the smallest start and the largest end of its ranges, so the
+// search for the ranges containing a position skips the subtrees that can't contain it.
+class SymbolRangeTree
+{
+public:
+    SymbolRangeTree() = default;
+    explicit SymbolRangeTree(const std::vector<TextRange> &ranges);
+
+    // Returns the index of the first or the last range containing pos and accepted, -1 if there's none
+    int findFirst(int pos, const std::function<bool(int)> &accept = {}) const;
+    int findLast(int pos, const std::function<bool(int)> &accept = {}) const;
+
+    qint64 memorySize() const;
+
+private:
+    int find(int node, int pos, bool last, const std::function<bool(int)> &accept) const;
+
+    // Number of leaves, a power of two, the leaves are the last nodes
+    int m_leafCount = 0;
+    int m_count = 0;
+    std::vector<TextRange> m_nodes;
+};
+
+// Lookup trees of the ranges and the selection ranges of the symbol entries
+struct SymbolRangeIndex
+{
+    // Revision of the symbol entries the index is built from
+    int revision = -1;
+    SymbolRangeTree ranges;
+    SymbolRangeTree selectionRanges;
+};
+
 class TreeSitterHelper
 {
 public:
+    enum class ParseState {
+        NotParsed,
+        Parsed,
+        // Stopped by the parse timeout or an abort, the next call to syntaxTree() continues parsing
+        Interrupted,
+        Failed,
+    };
+
     explicit TreeSitterHelper(CodeDocument *document);
 
     void clear();
+    // Updates the syntax tree after a change in the document, the next call to syntaxTree() will then reparse
+    // the document incrementally.
+    void edit(int position, int charsRemoved, int charsAdded);
 
-    treesitter::Parser &parser();
+    const TSLanguage *language() const;
     std::optional<treesitter::Tree> &syntaxTree();
+    // Uses a tree parsed ahead from the text of the document (see DocumentPrefetcher), if there's no tree yet.
+    // It's ignored if source isn't the text of the document.
+    void setSyntaxTree(treesitter::Tree tree, const QString &source);
+    // Incremented each time the syntax tree is edited or replaced, its nodes are only valid for one revision
+    int treeRevision() const;
+    ParseState parseState() const;
+    // Returns a tree of the declarations around range only, when the document is large (see
+    // Settings::RangeParseThreshold) and not parsed yet: queries inside range don't need a parse of the whole text.
+    // The tree is kept for the next queries in the same part of the text, until the document changes.
+    // Returns nullptr if the whole document should be parsed instead.
+    const treesitter::Tree *rangeSyntaxTree(const TextRange &range);
+    // Predicates on the tree of rangeSyntaxTree
+    std::unique_ptr<treesitter::Predicates> makeRangePredicates(treesitter::QueryParameters parameters = {});
+    // Returns a copy of the current syntax tree and its text, which can be used on another thread
+    std::shared_ptr<const treesitter::TreeSnapshot> snapshot();
 
     std::shared_ptr<treesitter::Query> constructQuery(const QString &query);
-    QList<treesitter::Node> nodesInRange(const RangeMark &range);
-
-    const QList<Core::Symbol *> &symbols();
+    static QList<treesitter::Node> nodesInRange(const treesitter::Tree &tree, const RangeMark &range);
+    // Predicates on the current syntax tree, sharing their caches until the next change
+    std::unique_ptr<treesitter::Predicates> makePredicates(treesitter::QueryParameters parameters = {});
+    // Runs all the queries in a single pass over each node, the matches are returned for each query
+    std::vector<QueryMatchList> queryManyInNodes(const QList<treesitter::Node> &nodes, const QStringList &queries);
+    // Queries extracting the symbols, run together by symbolEntries
+    static const QStringList &symbolQueries();
+
+    // Symbols are cached, and only extracted again for the declarations changed since the last call.
+    // The entries are sorted by range start, a symbol always comes after the symbols surrounding it.
+    const std::vector<SymbolEntry> &symbolEntries();
+    // Returns the Symbol for the entry at index, creating it if needed. It's owned by the document.
+    Core::Symbol *symbolAt(int index);
+    QList<Core::Symbol *> symbols();
+    // Incremented each time the symbol entries change
+    int symbolsRevision() const;
+    // Index of the names of symbolEntries(), only built again when the symbols have changed
+    const SymbolNameIndex &symbolNameIndex();
+    // Index of the ranges of the symbols. Without update, the symbols aren't extracted again and the document isn't
+    // reparsed: the ones in the declarations changed since the last extraction are missing, the others have been
+    // moved by the changes.
+    const SymbolRangeIndex &symbolRangeIndex(bool update = true);
+
+    // Adds the syntax tree and the symbols to the memory usage of the document
+    void addMemoryUsage(MemoryUsage &usage) const;
 
 private:
-    void assignSymbolContexts();
+    std::optional<treesitter::Tree> parse(const QString &text, const treesitter::Tree *oldTree = nullptr);
+    void dropInterruptedParse();
 
-    QList<Core::Symbol *> functionSymbols() const;
-    QList<Core::Symbol *> classSymbols() const;
-    QList<Core::Symbol *> memberSymbols() const;
-    QList<Core::Symbol *> enumSymbols() const;
+    void assignSymbolContexts(std::vector<SymbolEntry> &entries);
+
+    QList<treesitter::Node> topLevelNodes(const TextRange &range);
+    std::vector<SymbolEntry> extractSymbols(const QList<treesitter::Node> &nodes);
+    SymbolEntry makeSymbolEntry(const QueryMatch &match, Symbol::Kind kind) const;
+
+    void clearSymbols();
+    void editSymbols(int position, int charsRemoved, int charsAdded);
 
     enum Flags {
         HasSymbols = 0x01,
+        NeedsReparse = 0x02,
     };
 
     CodeDocument *const m_document;
-    std::optional<treesitter::Parser> m_parser;
     std::optional<treesitter::Tree> m_tree;
-    QList<Core::Symbol *> m_symbols;
+    int m_treeRevision = 0;
+    // Text the syntax tree is based on, kept in sync with the document by edit().
+    QString m_source;
+    ParseState m_parseState = ParseState::NotParsed;
+    // Parser of an interrupted parse of the whole text, kept to resume it
+    std::optional<treesitter::Parser> m_interruptedParser;
+    // Tree of the text around a range only, see rangeSyntaxTree
+    struct RangeTree
+    {
+        TextRange range;
+        QString source;
+        treesitter::Tree tree;
+    };
+    std::optional<RangeTree> m_rangeTree;
+    // Data computed by the predicates (e.g. the message map), valid until the syntax tree changes
+    std::shared_ptr<treesitter::PredicateCaches> m_predicateCaches;
+    std::vector<SymbolEntry> m_symbols;
+    // Pool of the symbol names, most names are found several times (declaration and definition, overloads...)
+    QSet<QString> m_symbolNames;
+    // Range of the symbols to extract again, as the document changed there
+    std::optional<TextRange> m_dirtySymbolRange;
+    int m_symbolsRevision = 0;
+    SymbolNameIndex m_symbolNameIndex;
+    SymbolRangeIndex m_symbolRangeIndex;
     int m_flags = 0;
 };
 
@@ -14,11 +14,12 @@
 #include "logger.h"
 #include "project.h"
 #include "settings.h"
+#include "treesitter/parser.h"
+#include "treesitter/tree.h"
 #include "utils.h"
 #include "utils/log.h"
 
 #include <QFileInfo>
-#include <QHash>
 #include <QPlainTextEdit>
 #include <QRegularExpression>
 #include <QTextBlock>
@@ -26,6 +27,9 @@
 #include <QVariantMap>
 #include <algorithm>
 #include <kdalgorithms.h>
+#include <map>
+#include <ranges>
+#include <string_view>
 
 namespace Core {
 
@@ -45,6 +49,21 @@ namespace Core {
 CppDocument::CppDocument(QObject *parent)
     : CodeDocument(Type::Cpp, parent)
 {
+    connect(textDocument(), &QTextDocument::contentsChange, this, [this](int from, int charsRemoved, int charsAdded) {
+        Q_UNUSED(charsRemoved)
+        if (!m_includeHelper)
+            return;
+        if (m_includeHelper->isAffectedBy(from)) {
+            m_includeHelper.reset();
+            return;
+        }
+        // A change after the last include can still add a new one
+        QTextCursor cursor(textDocument());
+        cursor.setPosition(from);
+        cursor.setPosition(std::min(from + charsAdded, textDocument()->characterCount() - 1), QTextCursor::KeepAnchor);
+        if (cursor.selectedText().contains("include"))
+            m_includeHelper.reset();
+    });
 }
 
 CppDocument::~CppDocument() = default;
@@ -77,7 +96,7 @@ void CppDocument::commentSelection()
 {
     LOG("CppDocument::commentSelection");
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
 
     const int cursorPos = cursor.position();
@@ -145,13 +164,12 @@ void CppDocument::commentSelection()
     }
 
     cursor.endEditBlock();
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 static QStringList matchingSuffixes(bool header)
 {
-    static const auto mimeTypes =
-        Settings::instance()->value<std::map<std::string, Document::Type>>(Settings::MimeTypes);
+    const auto &mimeTypes = Settings::instance()->snapshot().mimeTypes;
 
     QStringList suffixes;
     for (const auto &it : mimeTypes) {
@@ -190,11 +208,6 @@ static int commonFilePathLength(const QString &s1, const QString &s2)
 QString CppDocument::correspondingHeaderSource() const
 {
     LOG("CppDocument::correspondingHeaderSource");
-    static QHash<QString, QString> cache;
-
-    QString cacheData = cache.value(fileName());
-    if (!cacheData.isEmpty())
-        return cacheData;
 
     const bool header = isHeader();
     const QStringList suffixes = matchingSuffixes(header);
@@ -202,31 +215,28 @@ QString CppDocument::correspondingHeaderSource() const
     const QFileInfo fi(fileName());
     const QStringList candidates = candidateFileNames(fi.completeBaseName(), suffixes);
 
-    // Search in the current directory
+    // Files of the project with the same base name and a matching suffix, from the project index
+    const QStringList fullPathNames =
+        kdalgorithms::filtered(Project::instance()->indexedFilesWithBaseName(fi.completeBaseName()),
+                               [&suffixes](const QString &path) {
+                                   return suffixes.contains(QFileInfo(path).suffix(), Qt::CaseInsensitive);
+                               });
+
+    // Search in the current directory, the file system is only used for files outside of the project
+    const QString &root = Project::instance()->root();
+    const bool inProject = !root.isEmpty() && fileName().startsWith(root + '/');
     for (const auto &candidate : candidates) {
         const QString testFileName = fi.absolutePath() + '/' + candidate;
-        if (QFile::exists(testFileName)) {
-            cache[fileName()] = testFileName;
-            cache[testFileName] = fileName();
+        if (inProject ? fullPathNames.contains(testFileName) : QFile::exists(testFileName)) {
             spdlog::debug("CppDocument::correspondingHeaderSource {} => {}", fileName(), testFileName);
             LOG_RETURN("path", testFileName);
         }
     }
 
-    // Search in the whole project, and find the possible files
-    QStringList fullPathNames = Project::instance()->allFilesWithExtensions(suffixes, Project::FullPath);
-    auto notCandidate = [&candidates](const QString &path) {
-        auto notInPath = [&path](const QString &candidate) {
-            return !path.endsWith(candidate, Qt::CaseInsensitive);
-        };
-        return kdalgorithms::all_of(candidates, notInPath);
-    };
-    kdalgorithms::erase_if(fullPathNames, notCandidate);
-
     // Find the file having the most common path with fileName
     QString bestFileName;
     int compareValue = 0;
-    for (const auto &path : std::as_const(fullPathNames)) {
+    for (const auto &path : fullPathNames) {
         int value = commonFilePathLength(path, fileName());
         if (value > compareValue) {
             compareValue = value;
@@ -235,8 +245,6 @@ QString CppDocument::correspondingHeaderSource() const
     }
 
     if (!bestFileName.isEmpty()) {
-        cache[fileName()] = bestFileName;
-        cache[bestFileName] = fileName();
         spdlog::debug("CppDocument::correspondingHeaderSource {} => {}", fileName(), bestFileName);
         LOG_RETURN("path", bestFileName);
     }
@@ -259,6 +267,28 @@ CppDocument *CppDocument::openHeaderSource()
     return nullptr;
 }
 
+static QString queryKey(const QStringList &parts)
+{
+    return parts.join(QChar::Null);
+}
+
+// Returns the result of `compute` for `key`, computed at most once per revision of the document. Only the query
+// itself is memoized: callers log and warn outside of `compute`, so it's done on every call.
+Core::QueryMatchList CppDocument::memoizedQuery(const QString &key, const std::function<QueryMatchList()> &compute)
+{
+    if (m_queryMemoRevision != textRevision()) {
+        m_queryMemo.clear();
+        m_queryMemoRevision = textRevision();
+    }
+
+    if (auto it = m_queryMemo.find(key); it != m_queryMemo.end())
+        return it->second;
+    // compute may be reentrant (queryMember uses queryClassDefinition), so don't keep an iterator over it
+    auto matches = compute();
+    m_queryMemo.insert_or_assign(key, matches);
+    return matches;
+}
+
 /*!
  * \qmlmethod QueryMatch CppDocument::queryClassDefinition(string className)
  *
@@ -274,23 +304,10 @@ Core::QueryMatch CppDocument::queryClassDefinition(const QString &className)
 {
     LOG("CppDocument::queryClassDefinition", LOG_ARG("className", className));
 
-    // clang-format off
-    const auto classDefinitionQuery = QString(R"EOF(
-        ; query classes or structs
-        [(class_specifier
-            name: (_) @name (#like? @name "%1")
-            (base_class_clause
-                [(type_identifier) @base _]*)?
-            body: (_) @body)
-        (struct_specifier
-            name: (_) @name (#like? @name "%1")
-            (base_class_clause
-                [(type_identifier) @base _]*)?
-            body: (_) @body)]
-    )EOF").arg(className);
-    // clang-format on
-
-    auto matches = query(classDefinitionQuery);
+    // The class name is bound when the query is executed, so the query is only compiled once
+    const auto matches = memoizedQuery(queryKey({"queryClassDefinition", className}), [&]() {
+        return query(Queries::classDefinition, {{"className", className}});
+    });
     if (matches.isEmpty()) {
         spdlog::warn("CppDocument::queryClassDefinition: No class named `{}` found in `{}`", className, fileName());
         return {};
@@ -327,16 +344,16 @@ Core::QueryMatchList CppDocument::queryMethodDefinition(const QString &scope, co
     // Clang-format gets confused by the raw strings
     // clang-format off
     auto identifier = QString(R"EOF(
-            (identifier) @name (#eq? @name "%1")
-        )EOF").arg(functionName);
+            (identifier) @name (#eq? @name "$functionName")
+        )EOF");
 
     if (!scope.isEmpty()) {
         identifier = QString(R"EOF(
             (qualified_identifier
-                scope: (_) @scope (#like? @scope "%1")
-                %2
+                scope: (_) @scope (#like? @scope "$scope")
+                %1
             )
-        )EOF").arg(scope, identifier);
+        )EOF").arg(identifier);
     }
 
     const auto queryFunctionName = QString(R"EOF(
@@ -361,21 +378,25 @@ Core::QueryMatchList CppDocument::queryMethodDefinition(const QString &scope, co
     )EOF").arg(queryFunctionName);
     //clang-format on
 
-    return query(queryString);
+    return memoizedQuery(queryKey({"queryMethodDefinition", scope, functionName}), [&]() {
+        return query(queryString, {{"scope", scope}, {"functionName", functionName}});
+    });
 }
 
 QList<QueryMatch> CppDocument::internalQueryFunctionCall(const QString& functionName, const QString& argumentsQuery)
 {
     const auto queryString = QString(R"EOF(
                 (call_expression
-                    function: (_) @name (#eq? @name "%1")
+                    function: (_) @name (#eq? @name "$functionName")
                     arguments: (argument_list
-                            %2
+                            %1
                         ) @argument-list
                 ) @call
-    )EOF").arg(functionName, argumentsQuery);
+    )EOF").arg(argumentsQuery);
 
-    return query(queryString);
+    return memoizedQuery(queryKey({"queryFunctionCall", functionName, argumentsQuery}), [&]() {
+        return query(queryString, {{"functionName", functionName}});
+    });
 }
 
 /*!
@@ -464,7 +485,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
         return false;
     }
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(symbol->range().end);
     cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor);
     if (cursor.selectedText() != "}") {
@@ -480,7 +501,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     const QString strTab = tab();
     if (insertAt == StartOfMethod) {
         // Goto the start of the block
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         cursor.setPosition(gotoBlockStart());
         // Move forward one character
         cursor.movePosition(QTextCursor::NextCharacter);
@@ -504,7 +525,7 @@ bool CppDocument::insertCodeInMethod(const QString &methodName, QString code, Po
     cursor.insertText(code);
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     return true;
 }
@@ -547,7 +568,7 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
     qualifierList.pop_front();
 
     // Check if the declaration already exists
-    QTextDocument *doc = textEdit()->document();
+    QTextDocument *doc = textDocument();
     QTextCursor cursor(doc);
     cursor = doc->find(result, cursor, QTextDocument::FindWholeWords);
     if (!cursor.isNull()) {
@@ -559,21 +580,21 @@ bool CppDocument::insertForwardDeclaration(const QString &forwardDeclaration)
         result = QString("namespace %1 {\n%2\n}").arg(qualifier, result);
 
     int pos = -1;
-    if (const auto inc = query(Queries::findInclude); !inc.isEmpty()) {
+    if (const auto inc = queryInPreamble(Queries::findInclude); !inc.isEmpty()) {
         const auto def = inc.last().get("path");
         pos = def.end();
-    } else if (const auto pragma = query(Queries::findPragma); !pragma.isEmpty()) {
+    } else if (const auto pragma = queryInPreamble(Queries::findPragma); !pragma.isEmpty()) {
         const auto def = pragma.at(0).get("value");
         pos = def.end();
-    } else if (const auto guard = query(Queries::findHeaderGuard); !guard.isEmpty()) {
+    } else if (const auto guard = queryInPreamble(Queries::findHeaderGuard); !guard.isEmpty()) {
         const auto def = guard.at(0).get("value");
         pos = def.end();
     }
 
     if (pos != -1) {
-        auto cur = textEdit()->textCursor();
+        auto cur = textCursor();
         cur.setPosition(pos);
-        textEdit()->setTextCursor(cur);
+        setTextCursor(cur);
         cur.beginEditBlock();
         cur.movePosition(QTextCursor::EndOfLine, QTextCursor::MoveAnchor);
         cur.insertText("\n\n" + result);
@@ -620,57 +641,11 @@ DataExchange CppDocument::mfcExtractDDX(const QString &className)
  */
 MessageMap CppDocument::mfcExtractMessageMap(const QString &className /* = ""*/)
 {
-    auto checkClassName = className.isEmpty() ? "" : QString("(#eq? @class \"%1\")").arg(className);
-
-    // clang-format off
-    const auto messageMapQueryString = QString(R"EOF(
-        ; Search for BEGIN_MESSAGE_MAP
-        (expression_statement
-            (call_expression
-                function: (identifier) @begin_ident
-                (#eq? @begin_ident "BEGIN_MESSAGE_MAP")
-                arguments: (argument_list
-                        (identifier) @class
-                        %1 ; If a class name is given, check if the captured class name matches
-                        (identifier) @superclass)) @begin)
-
-        ; Followed by one or more entries
-        [
-        (expression_statement
-            (call_expression
-                function: (identifier) @message-name
-                arguments: (argument_list
-                    [(_)* @parameter ","]*
-                    (#exclude! @parameter comment))
-        ))@message
-        (_)
-        ]*
-
-        ; Ending with END_MESSAGE_MAP
-        (expression_statement
-            (call_expression
-                function: (identifier) @end_ident
-                (#eq? @end_ident "END_MESSAGE_MAP")) @end)
-    )EOF").arg(checkClassName);
-    // clang-format on
-
-    // clang-format off
-    // Assumption: the MESSAGE_MAP is either top-level or in a namespace
-    // Parenthesis (around %1) are used to make sure nodes are siblings
-    const auto queryString = QString(R"EOF(
-        (translation_unit
-            [
-                (namespace_definition (_ ( %1 ) ) )
-                ( %1 )
-            ]
-        )
-    )EOF").arg(messageMapQueryString);
-    // clang-format on
-
     // We assume there is at most one MessageMap per file.
     // This allows us to return immediately after the message map is found.
     // As the MessageMap query is quite complicated, this can significantly improve performance.
-    auto match = queryFirst(queryString);
+    auto match = className.isEmpty() ? queryFirst(Queries::mfcMessageMap(false))
+                                     : queryFirst(Queries::mfcMessageMap(true), {{"className", className}});
     if (match.isEmpty()) {
         spdlog::warn("CppDocument::mfcExtractMessageMap: No message map found in `{}`", fileName());
         return {};
@@ -705,9 +680,9 @@ Core::QueryMatchList CppDocument::queryMethodDeclaration(const QString &classNam
     // clang-format off
     auto queryFunctionName = QString(R"EOF(
         (function_declarator
-            declarator:(field_identifier) @name (#eq? @name "%1")
+            declarator:(field_identifier) @name (#eq? @name "$functionName")
         )
-    )EOF").arg(functionName);
+    )EOF");
     // handle Type, Type *, Type &, Type *&, Type &* and Type **
     auto queryString = QString(R"EOF(
         (field_declaration
@@ -721,7 +696,9 @@ Core::QueryMatchList CppDocument::queryMethodDeclaration(const QString &classNam
     )EOF").arg(queryFunctionName);
     // clang-format on
 
-    auto matches = classQuery.queryIn("body", queryString);
+    auto matches = memoizedQuery(queryKey({"queryMethodDeclaration", className, functionName}), [&]() {
+        return classQuery.queryIn("body", queryString, {{"functionName", functionName}});
+    });
     if (matches.isEmpty()) {
         spdlog::warn("CppDocument::queryMethodDeclaration: No method named `{}` found in `{}`", functionName,
                      fileName());
@@ -759,12 +736,14 @@ Core::QueryMatch CppDocument::queryMember(const QString &className, const QStrin
                 declarator: (_ %1 )
                 declarator: %1
             ]
-            (#eq? @name "%2")
+            (#eq? @name "$memberName")
         ) @member
-    )EOF").arg(queryMemberName, memberName);
+    )EOF").arg(queryMemberName);
     // clang-format on
 
-    auto matches = classQuery.queryIn("body", queryString);
+    const auto matches = memoizedQuery(queryKey({"queryMember", className, memberName}), [&]() {
+        return classQuery.queryIn("body", queryString, {{"memberName", memberName}});
+    });
     if (matches.isEmpty()) {
         spdlog::warn("CppDocument::queryMember: No member named `{}` found in `{}`", memberName, fileName());
         return {};
@@ -786,12 +765,12 @@ int CppDocument::gotoBlockStart(int count)
 {
     LOG_AND_MERGE("CppDocument::gotoBlockStart", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -805,12 +784,12 @@ int CppDocument::gotoBlockEnd(int count)
 {
     LOG_AND_MERGE("CppDocument::gotoBlockEnd", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
     }
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return cursor.position();
 }
 
@@ -824,7 +803,7 @@ int CppDocument::selectBlockStart(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockStart", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::max(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
@@ -835,7 +814,7 @@ int CppDocument::selectBlockStart(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockStartPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockStartPos;
 }
 
@@ -849,7 +828,7 @@ int CppDocument::selectBlockEnd(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockEnd", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     const int selectionStart = std::min(cursor.selectionStart(), cursor.selectionEnd());
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
@@ -860,7 +839,7 @@ int CppDocument::selectBlockEnd(int count)
     cursor.setPosition(selectionStart, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -874,7 +853,7 @@ int CppDocument::selectBlockUp(int count)
 {
     LOG_AND_MERGE("CppDocument::selectBlockUp", count);
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     while (count != 0) {
         cursor.setPosition(moveBlock(cursor.position(), QTextCursor::NextCharacter));
         --count;
@@ -884,7 +863,7 @@ int CppDocument::selectBlockUp(int count)
     cursor.setPosition(blockStartPos, QTextCursor::MoveAnchor);
     cursor.setPosition(blockEndPos, QTextCursor::KeepAnchor);
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return blockEndPos;
 }
 
@@ -898,11 +877,110 @@ int CppDocument::moveBlock(int startPos, QTextCursor::MoveOperation direction)
 {
     Q_ASSERT(direction == QTextCursor::NextCharacter || direction == QTextCursor::PreviousCharacter);
 
-    QTextDocument *doc = textEdit()->document();
+    if (const auto pos = moveBlockInTree(startPos, direction))
+        return *pos;
+    return moveBlockByCharacters(startPos, direction);
+}
+
+namespace {
+// Brackets of a block, by position of the opening and closing characters
+struct BracketPair
+{
+    uint32_t open;
+    uint32_t close;
+};
+}
+
+static bool isOpeningBracket(std::string_view type)
+{
+    return type == "(" || type == "{" || type == "[";
+}
+
+static bool isClosingBracket(std::string_view type)
+{
+    return type == ")" || type == "}" || type == "]";
+}
+
+// Returns the pairs of brackets amongst the children of `node`, brackets in comments or strings are not tokens
+static std::vector<BracketPair> bracketPairs(const treesitter::Node &node)
+{
+    std::vector<BracketPair> pairs;
+    std::vector<std::pair<char, uint32_t>> openings;
+    for (const auto &child : node.childRange()) {
+        const std::string_view type = child.rawType();
+        if (isOpeningBracket(type)) {
+            openings.emplace_back(type.front(), child.startPosition());
+        } else if (isClosingBracket(type)) {
+            const char opening = type == ")" ? '(' : (type == "}" ? '{' : '[');
+            if (!openings.empty() && openings.back().first == opening) {
+                pairs.push_back({.open = openings.back().second, .close = child.startPosition()});
+                openings.pop_back();
+            }
+        }
+    }
+    return pairs;
+}
+
+/**
+ * \brief Same as moveBlockByCharacters, using the brackets of the syntax tree
+ * \return position of the start or end of the block, or nothing if the tree has errors around the position
+ */
+std::optional<int> CppDocument::moveBlockInTree(int startPos, QTextCursor::MoveOperation direction)
+{
+    const auto snapshot = syntaxSnapshot();
+    if (!snapshot)
+        return {};
+    const auto root = snapshot->rootNode();
+    const bool forward = direction == QTextCursor::NextCharacter;
+    const auto pos = static_cast<uint32_t>(startPos);
+
+    // If the character next to the cursor is a bracket, go inside its block
+    if (forward ? startPos < snapshot->source().size() : startPos > 0) {
+        const uint32_t adjacent = forward ? pos : pos - 1;
+        const auto token = root.descendantForRange(adjacent, adjacent + 1);
+        const std::string_view type = token.rawType();
+        if (token.startPosition() == adjacent && (forward ? isOpeningBracket(type) : isClosingBracket(type))) {
+            const auto parent = token.parent();
+            if (parent.isNull() || parent.hasError())
+                return {};
+            for (const auto &pair : bracketPairs(parent)) {
+                if (forward ? pair.open == adjacent : pair.close == adjacent)
+                    return static_cast<int>(forward ? pair.close + 1 : pair.open);
+            }
+            return {};
+        }
+    }
+
+    // Otherwise find the innermost block containing the cursor, the deepest node having brackets around it
+    for (auto node = root.descendantForRange(pos, pos); !node.isNull(); node = node.parent()) {
+        if (node.hasError())
+            return {};
+        std::optional<BracketPair> innermost;
+        for (const auto &pair : bracketPairs(node)) {
+            if (pair.open < pos && pos <= pair.close && (!innermost || pair.open > innermost->open))
+                innermost = pair;
+        }
+        if (innermost)
+            return static_cast<int>(forward ? innermost->close + 1 : innermost->open);
+    }
+    return startPos;
+}
+
+/**
+ * \brief Internal method to move to the start or end of a block, counting the brackets character by character
+ * \param startPos current cursor position
+ * \param direction the iteration
+ * \return position of the start or end of the block
+ */
+int CppDocument::moveBlockByCharacters(int startPos, QTextCursor::MoveOperation direction)
+{
+    Q_ASSERT(direction == QTextCursor::NextCharacter || direction == QTextCursor::PreviousCharacter);
+
+    QTextDocument *doc = textDocument();
     Q_ASSERT(doc);
 
     const int inc = direction == QTextCursor::NextCharacter ? 1 : -1;
-    const int lastPos = direction == QTextCursor::NextCharacter ? textEdit()->document()->characterCount() - 1 : 0;
+    const int lastPos = direction == QTextCursor::NextCharacter ? textDocument()->characterCount() - 1 : 0;
     if (startPos == lastPos)
         return startPos;
     int pos = startPos + inc;
@@ -968,10 +1046,9 @@ void CppDocument::toggleSection()
     auto sectionSettings = Settings::instance()->value<ToggleSectionSettings>(Settings::ToggleSection);
     const auto endifString = QStringLiteral("#endif // ") + sectionSettings.tag;
     const auto ifdefString = QStringLiteral("#ifdef ") + sectionSettings.tag;
-    const auto elseString = QStringLiteral("#else // ") + sectionSettings.tag;
     const auto newLine = QStringLiteral("\n");
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     if (cursor.hasSelection()) {
         // If there's a selection, just add #ifdef/#endif
         cursor.beginEditBlock();
@@ -985,7 +1062,7 @@ void CppDocument::toggleSection()
         cursor.insertText(ifdefString + newLine);
         // Move after the #endif
         cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         gotoLine(line + 3);
 
     } else {
@@ -1000,55 +1077,107 @@ void CppDocument::toggleSection()
         auto cursorPos = cursor.position();
 
         cursor.beginEditBlock();
-        // Start from the end
-        cursor.setPosition(symbol->range().end);
-        cursor.movePosition(QTextCursor::StartOfLine);
-        cursor.movePosition(QTextCursor::Up, QTextCursor::KeepAnchor);
-
-        if (cursor.selectedText().startsWith(endifString)) {
-            // The function is already commented out, remove the comments
-            int start = textEdit()->document()->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
-            if (start > symbol->range().start)
-                cursor.setPosition(start, QTextCursor::KeepAnchor);
-            cursor.removeSelectedText();
-            cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
-            cursor.movePosition(QTextCursor::Down);
-            cursor.movePosition(QTextCursor::StartOfLine);
-            cursor.movePosition(QTextCursor::Down, QTextCursor::KeepAnchor);
-            cursor.removeSelectedText();
-            cursorPos -= ifdefString.length() + 1;
-        } else {
-            // Comment out the function with #if/#def, make sure to return something if needed
-            cursor.setPosition(symbol->range().end);
-            cursor.movePosition(QTextCursor::PreviousCharacter);
-
-            QString text = elseString + newLine;
-            if (!sectionSettings.debug.isEmpty())
-                text += tab() + sectionSettings.debug.arg(symbol->name()) + ";\n";
-            const QString returnType = symbol->toFunction()->returnType();
-            auto it = sectionSettings.return_values.find(returnType.toStdString());
-            if (it != sectionSettings.return_values.end())
-                text += tab() + QString("return %1;\n").arg(QString::fromStdString(it->second));
-            else if (returnType.isEmpty() || returnType == "void")
-                text += tab() + "return;\n";
-            else if (returnType.endsWith('*'))
-                text += tab() + "return nullptr;\n";
-            else
-                text += tab() + "return {};\n";
-            text += endifString + newLine;
-            cursor.insertText(text);
-
-            cursor.setPosition(moveBlock(cursor.position(), QTextCursor::PreviousCharacter));
-            cursor.movePosition(QTextCursor::NextCharacter);
-            cursor.insertText(newLine + ifdefString);
-            cursorPos += ifdefString.length() + 1;
-        }
+        cursorPos += toggleFunctionSection(cursor, *symbol, sectionSettings);
         cursor.endEditBlock();
-        textEdit()->setTextCursor(cursor);
+        setTextCursor(cursor);
         setPosition(cursorPos);
     }
 }
 
+/*!
+ * \qmlmethod CppDocument::toggleSections(array<string> functions)
+ * Comments out or uncomments all the functions named in `functions`, as `toggleSection` does for the function the
+ * cursor is in. If `functions` is empty, all the functions of the document are toggled.
+ *
+ * The settings and the symbols are only read once, and all the functions are changed in one edit, undone at once.
+ * \sa CppDocument::toggleSection
+ */
+void CppDocument::toggleSections(const QStringList &functions)
+{
+    LOG("CppDocument::toggleSections", functions);
+
+    const auto sectionSettings = Settings::instance()->value<ToggleSectionSettings>(Settings::ToggleSection);
+
+    auto isToggled = [&functions](const Symbol *symbol) {
+        return symbol->isFunction() && (functions.isEmpty() || functions.contains(symbol->name()));
+    };
+    auto symbols = kdalgorithms::filtered(this->symbols(), isToggled);
+    if (symbols.isEmpty())
+        return;
+
+    // Toggle from the end of the document, so the ranges of the functions before are still valid
+    auto rangeStart = [](const Symbol *symbol) {
+        return symbol->range().start;
+    };
+    std::ranges::sort(symbols, std::ranges::greater {}, rangeStart);
+    const auto duplicates = std::ranges::unique(symbols, {}, rangeStart);
+    symbols.erase(duplicates.begin(), duplicates.end());
+
+    // The position is adjusted by Qt for all the changes done by another cursor
+    const QTextCursor position = textCursor();
+    QTextCursor cursor = textCursor();
+    cursor.beginEditBlock();
+    for (auto *symbol : std::as_const(symbols))
+        toggleFunctionSection(cursor, *symbol, sectionSettings);
+    cursor.endEditBlock();
+    setPosition(position.position());
+}
+
+// Comments out or uncomments the function, and returns the number of characters added (or removed) before its body
+int CppDocument::toggleFunctionSection(QTextCursor &cursor, Symbol &symbol,
+                                       const ToggleSectionSettings &sectionSettings)
+{
+    const auto endifString = QStringLiteral("#endif // ") + sectionSettings.tag;
+    const auto ifdefString = QStringLiteral("#ifdef ") + sectionSettings.tag;
+    const auto elseString = QStringLiteral("#else // ") + sectionSettings.tag;
+    const auto newLine = QStringLiteral("\n");
+
+    // Start from the end
+    cursor.setPosition(symbol.range().end);
+    cursor.movePosition(QTextCursor::StartOfLine);
+    cursor.movePosition(QTextCursor::Up, QTextCursor::KeepAnchor);
+
+    if (cursor.selectedText().startsWith(endifString)) {
+        // The function is already commented out, remove the comments
+        int start = textDocument()->find(elseString, cursor, QTextDocument::FindBackward).selectionStart();
+        if (start > symbol.range().start)
+            cursor.setPosition(start, QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+        // Inside the edit block, the syntax tree doesn't know about the changes yet
+        cursor.setPosition(moveBlockByCharacters(cursor.position(), QTextCursor::PreviousCharacter));
+        cursor.movePosition(QTextCursor::Down);
+        cursor.movePosition(QTextCursor::StartOfLine);
+        cursor.movePosition(QTextCursor::Down, QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+        return -(ifdefString.length() + 1);
+    } else {
+        // Comment out the function with #if/#def, make sure to return something if needed
+        cursor.setPosition(symbol.range().end);
+        cursor.movePosition(QTextCursor::PreviousCharacter);
+
+        QString text = elseString + newLine;
+        if (!sectionSettings.debug.isEmpty())
+            text += tab() + sectionSettings.debug.arg(symbol.name()) + ";\n";
+        const QString returnType = symbol.toFunction()->returnType();
+        auto it = sectionSettings.return_values.find(returnType.toStdString());
+        if (it != sectionSettings.return_values.end())
+            text += tab() + QString("return %1;\n").arg(QString::fromStdString(it->second));
+        else if (returnType.isEmpty() || returnType == "void")
+            text += tab() + "return;\n";
+        else if (returnType.endsWith('*'))
+            text += tab() + "return nullptr;\n";
+        else
+            text += tab() + "return {};\n";
+        text += endifString + newLine;
+        cursor.insertText(text);
+
+        cursor.setPosition(moveBlockByCharacters(cursor.position(), QTextCursor::PreviousCharacter));
+        cursor.movePosition(QTextCursor::NextCharacter);
+        cursor.insertText(newLine + ifdefString);
+        return ifdefString.length() + 1;
+    }
+}
+
 /*!
  * \qmlmethod CppDocument::insertInclude(string include, bool newGroup = false)
  * Inserts a new include line in the file. If the include is already in, do nothing (and returns true).
@@ -1063,8 +1192,7 @@ bool CppDocument::insertInclude(const QString &include, bool newGroup)
 {
     LOG("CppDocument::insertInclude", LOG_ARG("text", include), newGroup);
 
-    IncludeHelper includeHelper(this);
-    auto includePos = includeHelper.includePositionForInsertion(include, newGroup);
+    auto includePos = includeHelper().includePositionForInsertion(include, newGroup);
     if (!includePos) {
         spdlog::error(R"(CppDocument::insertInclude - the include '{}' is malformed, should be '<foo.h>' or '"foo.h"')",
                       include);
@@ -1081,6 +1209,138 @@ bool CppDocument::insertInclude(const QString &include, bool newGroup)
     return true;
 }
 
+/*!
+ * \qmlmethod CppDocument::insertIncludes(array<string> includes, bool newGroup = false)
+ * Inserts new include lines in the file, as one edit. Includes already in the file are skipped.
+ *
+ * Each include is inserted like with `insertInclude`, the positions are all computed from the includes of the file
+ * before the change. If `newGroup` is true, the includes are inserted together at the end, in a new group.
+ *
+ * Returns false, without changing the file, if one of the includes is malformed.
+ * \sa CppDocument::insertInclude
+ */
+bool CppDocument::insertIncludes(const QStringList &includes, bool newGroup)
+{
+    LOG("CppDocument::insertIncludes", includes, newGroup);
+
+    // Text to insert for each line, ordered by line
+    std::map<int, QString> linesText;
+    QStringList uniqueIncludes = includes;
+    uniqueIncludes.removeDuplicates();
+    for (const auto &include : std::as_const(uniqueIncludes)) {
+        const auto includePos = includeHelper().includePositionForInsertion(include, newGroup);
+        if (!includePos) {
+            spdlog::error(
+                R"(CppDocument::insertIncludes - the include '{}' is malformed, should be '<foo.h>' or '"foo.h"')",
+                include);
+            return false;
+        }
+        if (includePos->alreadyExists())
+            continue;
+
+        auto &text = linesText[includePos->line];
+        if (text.isEmpty() && includePos->newGroup)
+            text = "\n";
+        text += "#include " + include + '\n';
+    }
+    if (linesText.empty())
+        return true;
+
+    // Insert from the end, so the lines computed before the change are still valid
+    QTextCursor cursor = textCursor();
+    cursor.beginEditBlock();
+    for (const auto &[line, text] : linesText | std::views::reverse) {
+        const int blockNumber = qMin(line, textDocument()->blockCount()) - 1;
+        cursor.setPosition(textDocument()->findBlockByNumber(blockNumber).position());
+        cursor.insertText(text);
+    }
+    cursor.endEditBlock();
+    return true;
+}
+
+// Without clangd, the symbol under the cursor is found by name in the project symbol index. Like clangd, it goes from a
+// declaration to the definition, otherwise to the declaration.
+Document *CppDocument::followSymbolWithoutLsp(int pos)
+{
+    auto node = astNodeAt(pos);
+    if (!node.isValid() || !node.type().endsWith("identifier"))
+        return nullptr;
+    // Use the qualified name if the identifier is the last part of it, e.g. `bar` in `Foo::bar`
+    auto parent = node.parentNode();
+    while (parent.isValid() && parent.type() == "qualified_identifier" && parent.endPos() == node.endPos()) {
+        node = parent;
+        parent = node.parentNode();
+    }
+
+    auto symbols = Project::instance()->findSymbols(node.text());
+    const auto isUnderCursor = [this, pos](const IndexedSymbol &symbol) {
+        return symbol.fileName == fileName() && symbol.selectionRange.contains(pos);
+    };
+    const auto current = std::ranges::find_if(symbols, isUnderCursor);
+    const bool toDefinition = current != symbols.end() && !current->isDefinition;
+    symbols.removeIf(isUnderCursor);
+    if (symbols.isEmpty())
+        return nullptr;
+
+    const auto target = std::ranges::find_if(symbols, [toDefinition](const IndexedSymbol &symbol) {
+        return symbol.isDefinition == toDefinition;
+    });
+    const IndexedSymbol symbol = target != symbols.end() ? *target : symbols.first();
+    auto *document = Project::instance()->open(symbol.fileName);
+    if (auto *codeDocument = qobject_cast<CodeDocument *>(document))
+        codeDocument->selectRange(symbol.selectionRange);
+    return document;
+}
+
+// Returns the position of the first node of `node` which isn't a preprocessor directive or a comment, going through
+// the preprocessor conditions (e.g. a header guard)
+static std::optional<uint32_t> firstDeclarationIn(const treesitter::Node &node)
+{
+    static const auto *language = treesitter::Parser::getLanguage(Document::Type::Cpp);
+    static const treesitter::NodeTypes conditionTypes(
+        language, {"preproc_if", "preproc_ifdef", "preproc_else", "preproc_elif", "preproc_elifdef"});
+    static const treesitter::NodeTypes commentType(language, {"comment"});
+    const bool isCondition = conditionTypes.contains(node);
+    for (const auto &child : node.childRange()) {
+        if (!child.isNamed() || commentType.contains(child))
+            continue;
+        if (conditionTypes.contains(child)) {
+            if (const auto position = firstDeclarationIn(child))
+                return position;
+            continue;
+        }
+        if (std::string_view(child.rawType()).starts_with("preproc_"))
+            continue;
+        if (isCondition && kdalgorithms::value_in(node.fieldNameForChild(child), {"name", "condition"}))
+            continue;
+        return child.startPosition();
+    }
+    return {};
+}
+
+/**
+ * \brief Runs the query only on the preamble of the document: the includes, pragmas and header guard
+ *
+ * The preamble ends with the first top-level declaration which isn't a preprocessor directive, the query cursor stops
+ * there instead of walking the whole document.
+ */
+Core::QueryMatchList CppDocument::queryInPreamble(const QString &query)
+{
+    const auto snapshot = syntaxSnapshot();
+    if (!snapshot)
+        return {};
+    const auto root = snapshot->rootNode();
+    const auto end = firstDeclarationIn(root).value_or(root.endPosition());
+    return queryInRange(createRangeMark(0, static_cast<int>(end)), query, {});
+}
+
+IncludeHelper &CppDocument::includeHelper()
+{
+    if (!m_includeHelper)
+        m_includeHelper = std::make_unique<IncludeHelper>(this);
+    return *m_includeHelper;
+}
+
 CppDocument::MemberOrMethodAdditionResult
 CppDocument::addMemberOrMethod(const QString &memberInfo, const QString &className, AccessSpecifier specifier)
 {
@@ -1212,9 +1472,9 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 
     QString indent = "\n\n";
 
-    auto lastBracePos = textEdit()->toPlainText().lastIndexOf('}');
+    auto lastBracePos = plainText().lastIndexOf('}');
 
-    QTextCursor cursor = textEdit()->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
 
     cursor.setPosition(lastBracePos + 1);
@@ -1222,11 +1482,11 @@ bool CppDocument::addMethodDefinition(const QString &method, const QString &clas
 
     // Add the method definition
     cursor.insertText(indent + methodDef);
-    auto methodStartPos = textEdit()->toPlainText().lastIndexOf('{');
+    auto methodStartPos = plainText().lastIndexOf('{');
     cursor.setPosition(methodStartPos + 1); // move to position after opening brace
     cursor.endEditBlock();
 
-    textEdit()->setTextCursor(cursor);
+    setTextCursor(cursor);
     return true;
 }
 
@@ -1308,8 +1568,7 @@ bool CppDocument::removeInclude(const QString &include)
 {
     LOG("CppDocument::removeInclude", LOG_ARG("text", include));
 
-    IncludeHelper includeHelper(this);
-    auto line = includeHelper.includePositionForRemoval(include);
+    auto line = includeHelper().includePositionForRemoval(include);
     if (!line) {
         spdlog::error(R"(CppDocument::removeInclude - the include '{}' is malformed, should be '<foo.h>' or '"foo.h"')",
                       include);
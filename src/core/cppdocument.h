@@ -14,12 +14,20 @@
 #include "dataexchange.h"
 #include "messagemap.h"
 
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
 #ifndef Q_MOC_RUN
 #define API_EXECUTOR
 #endif
 
 namespace Core {
 
+class IncludeHelper;
+struct ToggleSectionSettings;
+
 class CppDocument : public CodeDocument
 {
     Q_OBJECT
@@ -76,6 +84,7 @@ public slots:
     int selectBlockUp(int count = 1);
 
     void toggleSection();
+    void toggleSections(const QStringList &functions = {});
 
     API_EXECUTOR bool addMember(const QString &member, const QString &className,
                                 Core::CppDocument::AccessSpecifier specifier);
@@ -85,6 +94,7 @@ public slots:
     bool addMethod(const QString &declaration, const QString &className, Core::CppDocument::AccessSpecifier specifier,
                    const QString &body = "");
     API_EXECUTOR bool insertInclude(const QString &include, bool newGroup = false);
+    API_EXECUTOR bool insertIncludes(const QStringList &includes, bool newGroup = false);
     API_EXECUTOR bool removeInclude(const QString &include);
     void deleteMethod();
     API_EXECUTOR void deleteMethod(const QString &method, const QString &signature);
@@ -92,8 +102,12 @@ public slots:
 
     bool changeBaseClass(const QString &className, const QString &newClassBaseName);
 
+protected:
+    Document *followSymbolWithoutLsp(int pos) override;
+
 private:
     QList<Core::QueryMatch> internalQueryFunctionCall(const QString &functionName, const QString &argumentsQuery);
+    Core::QueryMatchList memoizedQuery(const QString &key, const std::function<Core::QueryMatchList()> &compute);
 
     enum class MemberOrMethodAdditionResult { Success, ClassNotFound };
     MemberOrMethodAdditionResult addMemberOrMethod(const QString &memberInfo, const QString &className,
@@ -102,6 +116,9 @@ private:
     void deleteMethodLocal(const QString &methodName, const QString &signature = "");
 
     int moveBlock(int startPos, QTextCursor::MoveOperation direction);
+    std::optional<int> moveBlockInTree(int startPos, QTextCursor::MoveOperation direction);
+    int moveBlockByCharacters(int startPos, QTextCursor::MoveOperation direction);
+    int toggleFunctionSection(QTextCursor &cursor, Symbol &symbol, const ToggleSectionSettings &sectionSettings);
 
     bool addSpecifierSection(const QString &memberInfoText, const QString &className,
                              Core::CppDocument::AccessSpecifier specifier);
@@ -111,7 +128,15 @@ private:
                                const QString &newClassBaseName);
     void changeBaseClassForwardInclude(const QString &originalClassBaseName, const QString &newClassBaseName);
 
+    IncludeHelper &includeHelper();
+    Core::QueryMatchList queryInPreamble(const QString &query);
+
     friend class IncludeHelper;
+    // Includes of the document, kept until a change may affect them
+    std::unique_ptr<IncludeHelper> m_includeHelper;
+    // Results of the query* methods, valid for the TextDocument revision they were computed for
+    std::unordered_map<QString, Core::QueryMatchList> m_queryMemo;
+    int m_queryMemoRevision = -1;
 };
 
 } // namespace Core
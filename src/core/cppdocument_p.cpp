@@ -21,7 +21,6 @@ bool IncludeHelper::Include::operator==(const Include &other) const
 IncludeHelper::IncludeHelper(CppDocument *document)
     : m_document(document)
 {
-    computeIncludes();
 }
 
 static QStringView getCommonPrefix(const QString &s1, const QString &s2)
@@ -97,16 +96,29 @@ IncludeHelper::IncludeGroups::const_iterator IncludeHelper::findBestIncludeGroup
     return bestIt;
 }
 
-IncludeHelper::IncludePosition IncludeHelper::findBestFirstIncludeLine() const
+bool IncludeHelper::isAffectedBy(int position) const
+{
+    // Without includes, the first include line depends on the header guard or pragma, which may be anywhere
+    return !m_isComputed || m_includes.empty() || position <= m_preambleEnd;
+}
+
+IncludeHelper::IncludePosition IncludeHelper::findBestFirstIncludeLine()
+{
+    if (!m_firstIncludeLine)
+        m_firstIncludeLine = findFirstIncludeLine();
+    return *m_firstIncludeLine;
+}
+
+IncludeHelper::IncludePosition IncludeHelper::findFirstIncludeLine() const
 {
     if (!m_document->isHeader())
         return IncludePosition {1, false};
 
     // Find `#pragma once`
-    auto result = m_document->query(Queries::findPragma);
+    auto result = m_document->queryInPreamble(Queries::findPragma);
     if (result.isEmpty()) {
         // Find `#ifndef / #define`
-        result = m_document->query(Queries::findHeaderGuard);
+        result = m_document->queryInPreamble(Queries::findHeaderGuard);
         if (result.isEmpty())
             return IncludePosition {1, false};
     }
@@ -123,6 +135,11 @@ IncludeHelper::IncludePosition IncludeHelper::findBestFirstIncludeLine() const
 
 void IncludeHelper::computeIncludes()
 {
+    if (m_isComputed)
+        return;
+    m_isComputed = true;
+
+    // All the includes, not only the preamble ones: they may be removed wherever they are
     const auto results = m_document->query(Queries::findInclude);
 
     // Extract all includes
@@ -133,6 +150,7 @@ void IncludeHelper::computeIncludes()
         int line; // 1-based
         int col;
         m_document->convertPosition(includePath.end(), &line, &col);
+        m_preambleEnd = std::max(m_preambleEnd, includePath.end());
 
         auto include = includeForText(includePath.text());
         include.line = line;
@@ -160,4 +178,57 @@ void IncludeHelper::computeIncludes()
         processGroup(group);
 }
 
+//=============================================================================
+// Queries
+//=============================================================================
+QString Queries::mfcMessageMap(bool checkClassName)
+{
+    const QString classNamePredicate = checkClassName ? R"((#eq? @class "$className"))" : "";
+
+    // clang-format off
+    const auto messageMapQueryString = QString(R"EOF(
+        ; Search for BEGIN_MESSAGE_MAP
+        (expression_statement
+            (call_expression
+                function: (identifier) @begin_ident
+                (#eq? @begin_ident "BEGIN_MESSAGE_MAP")
+                arguments: (argument_list
+                        (identifier) @class
+                        %1 ; If a class name is given, check if the captured class name matches
+                        (identifier) @superclass)) @begin)
+
+        ; Followed by one or more entries
+        [
+        (expression_statement
+            (call_expression
+                function: (identifier) @message-name
+                arguments: (argument_list
+                    [(_)* @parameter ","]*
+                    (#exclude! @parameter comment))
+        ))@message
+        (_)
+        ]*
+
+        ; Ending with END_MESSAGE_MAP
+        (expression_statement
+            (call_expression
+                function: (identifier) @end_ident
+                (#eq? @end_ident "END_MESSAGE_MAP")) @end)
+    )EOF").arg(classNamePredicate);
+    // clang-format on
+
+    // clang-format off
+    // Assumption: the MESSAGE_MAP is either top-level or in a namespace
+    // Parenthesis (around %1) are used to make sure nodes are siblings
+    return QString(R"EOF(
+        (translation_unit
+            [
+                (namespace_definition (_ ( %1 ) ) )
+                ( %1 )
+            ]
+        )
+    )EOF").arg(messageMapQueryString);
+    // clang-format on
+}
+
 }
@@ -54,6 +54,59 @@ namespace Queries {
             )
         )
     )EOF";
+
+    // Classes or structs named $className, the parameter is bound when the query is run
+    constexpr char classDefinition[] = R"EOF(
+        ; query classes or structs
+        [(class_specifier
+            name: (_) @name (#like? @name "$className")
+            (base_class_clause
+                [(type_identifier) @base _]*)?
+            body: (_) @body)
+        (struct_specifier
+            name: (_) @name (#like? @name "$className")
+            (base_class_clause
+                [(type_identifier) @base _]*)?
+            body: (_) @body)]
+    )EOF";
+
+    // MFC DoDataExchange method definitions, with the class name in @scope
+    constexpr char mfcDoDataExchange[] = R"EOF(
+        (function_definition
+            declarator: (function_declarator
+                declarator: (qualified_identifier
+                    scope: (_) @scope
+                    name: (identifier) @name (#eq? @name "DoDataExchange")))
+            body: (compound_statement) @body
+        ) @definition
+    )EOF";
+
+    // DDX_ and DDV_ calls, run inside the body of a DoDataExchange method
+    constexpr char mfcDDXCalls[] = R"EOF(
+        (expression_statement
+            (call_expression
+                function: (identifier) @ddx-function(#match? "^DDX_" @ddx-function)
+                arguments: (argument_list
+                    (_)* "," ; The CDataExchange* pDX argument
+                    (_)* @ddx-idc ","
+                    (_)* @ddx-member
+                    (#exclude! @ddx-idc @ddx-member comment)))) @ddx
+    )EOF";
+
+    constexpr char mfcDDVCalls[] = R"EOF(
+        (expression_statement
+            (call_expression
+                function: (identifier) @ddv-function(#match? "^DDV_" @ddv-function)
+                arguments: (argument_list
+                    (_)* ","
+                    (_)* @ddv-member ","
+                    ((_) ","?)* @ddv-arguments
+                    (#exclude! @ddv-arguments @ddv-member comment)))) @ddv
+    )EOF";
+
+    // MFC message map, from BEGIN_MESSAGE_MAP to END_MESSAGE_MAP, only for the class `$className` if checkClassName is
+    // true. The class name is a parameter, so the query is compiled once for all the classes.
+    QString mfcMessageMap(bool checkClassName);
 };
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ToggleSectionSettings, tag, debug, return_values);
@@ -81,6 +134,12 @@ public:
      */
     std::optional<int> includePositionForRemoval(const QString &text);
 
+    /**
+     * Returns true if a change at `position` may change the includes or their lines.
+     * The includes are computed once, and stay valid as long as the document is only changed after the last include.
+     */
+    bool isAffectedBy(int position) const;
+
 private:
     struct Include
     {
@@ -122,7 +181,8 @@ private:
     /**
      * Find best line for include if there are no includes
      */
-    IncludePosition findBestFirstIncludeLine() const;
+    IncludePosition findBestFirstIncludeLine();
+    IncludePosition findFirstIncludeLine() const;
 
     /**
      * Compute all includes and include groups in the file
@@ -130,8 +190,12 @@ private:
     void computeIncludes();
 
     CppDocument *const m_document;
+    bool m_isComputed = false;
     Includes m_includes;
     IncludeGroups m_includeGroups;
+    // Position of the end of the last include, anything before may change the includes
+    int m_preambleEnd = -1;
+    std::optional<IncludePosition> m_firstIncludeLine;
 };
 
 } // namespace Core
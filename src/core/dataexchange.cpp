@@ -9,6 +9,7 @@
 */
 
 #include "dataexchange.h"
+#include "cppdocument_p.h"
 #include "querymatch.h"
 
 #include <kdalgorithms.h>
@@ -60,16 +61,7 @@ static DataExchangeEntry fromDDX(const QueryMatch &ddxCall)
 
 static QList<DataExchangeEntry> queryDDXCalls(const QueryMatch &ddxFunction)
 {
-    const auto ddxCalls = ddxFunction.queryIn("body", R"EOF(
-                (expression_statement
-                    (call_expression
-                        function: (identifier) @ddx-function(#match? "^DDX_" @ddx-function)
-                        arguments: (argument_list
-                            (_)* "," ; The CDataExchange* pDX argument
-                            (_)* @ddx-idc ","
-                            (_)* @ddx-member
-                            (#exclude! @ddx-idc @ddx-member comment)))) @ddx
-    )EOF");
+    const auto ddxCalls = ddxFunction.queryIn("body", Queries::mfcDDXCalls);
 
     return kdalgorithms::transformed(ddxCalls, fromDDX);
 }
@@ -85,16 +77,7 @@ static DataValidationEntry fromDDV(const QueryMatch &ddvCall)
 
 static QList<DataValidationEntry> queryDDVCalls(const QueryMatch &ddxFunction)
 {
-    const auto ddvCalls = ddxFunction.queryIn("body", R"EOF(
-                (expression_statement
-                    (call_expression
-                        function: (identifier) @ddv-function(#match? "^DDV_" @ddv-function)
-                        arguments: (argument_list
-                            (_)* ","
-                            (_)* @ddv-member ","
-                            ((_) ","?)* @ddv-arguments
-                            (#exclude! @ddv-arguments @ddv-member comment)))) @ddv
-    )EOF");
+    const auto ddvCalls = ddxFunction.queryIn("body", Queries::mfcDDVCalls);
 
     return kdalgorithms::transformed(ddvCalls, fromDDV);
 }
@@ -126,6 +109,14 @@ DataExchange::DataExchange(QString _className, const QueryMatch &ddxFunction)
 {
     entries = queryDDXCalls(ddxFunction);
     validators = queryDDVCalls(ddxFunction);
+
+    // Backwards, so the first entry of an idc or a member is the one kept
+    for (int i = static_cast<int>(entries.size()) - 1; i >= 0; --i) {
+        m_entryById.insert(entries.at(i).idc, i);
+        m_entryByMember.insert(entries.at(i).member, i);
+    }
+    for (int i = 0; i < validators.size(); ++i)
+        m_validatorsByMember[validators.at(i).member].append(i);
 }
 
 bool DataExchange::isValid() const
@@ -133,6 +124,41 @@ bool DataExchange::isValid() const
     return range.isValid();
 }
 
+/*!
+ * \qmlmethod DataExchangeEntry DataExchange::getForId(string idc)
+ *
+ * Gets the first entry for the control `idc`, or an empty entry if there's none.
+ */
+DataExchangeEntry DataExchange::getForId(const QString &idc) const
+{
+    const auto it = m_entryById.constFind(idc);
+    return it == m_entryById.cend() ? DataExchangeEntry() : entries.at(*it);
+}
+
+/*!
+ * \qmlmethod DataExchangeEntry DataExchange::getForMember(string member)
+ *
+ * Gets the first entry for the `member`, or an empty entry if there's none.
+ */
+DataExchangeEntry DataExchange::getForMember(const QString &member) const
+{
+    const auto it = m_entryByMember.constFind(member);
+    return it == m_entryByMember.cend() ? DataExchangeEntry() : entries.at(*it);
+}
+
+/*!
+ * \qmlmethod list<DataValidationEntry> DataExchange::getValidators(string member)
+ *
+ * Gets all the validators of the `member`.
+ */
+QList<DataValidationEntry> DataExchange::getValidators(const QString &member) const
+{
+    QList<DataValidationEntry> result;
+    for (int index : m_validatorsByMember.value(member))
+        result.append(validators.at(index));
+    return result;
+}
+
 QString DataExchange::toString() const
 {
     return QString("DoDataExchange(%1, %2 entries)").arg(className).arg(entries.size());
@@ -12,6 +12,7 @@
 
 #include "rangemark.h"
 
+#include <QHash>
 #include <QObject>
 
 namespace Core {
@@ -72,12 +73,22 @@ public:
 
     bool isValid() const;
 
+    Q_INVOKABLE Core::DataExchangeEntry getForId(const QString &idc) const;
+    Q_INVOKABLE Core::DataExchangeEntry getForMember(const QString &member) const;
+    Q_INVOKABLE QList<Core::DataValidationEntry> getValidators(const QString &member) const;
+
     Q_INVOKABLE QString toString() const;
 
     QString className;
     QList<DataExchangeEntry> entries;
     QList<DataValidationEntry> validators;
     RangeMark range;
+
+private:
+    // Indexes of the first entry for each idc and member, and of the validators of each member
+    QHash<QString, int> m_entryById;
+    QHash<QString, int> m_entryByMember;
+    QHash<QString, QList<int>> m_validatorsByMember;
 };
 
 } // namespace Core
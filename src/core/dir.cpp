@@ -10,7 +10,9 @@
 
 #include "dir.h"
 #include "logger.h"
+#include "utils/log.h"
 
+#include <QFileInfo>
 #include <QVariant>
 
 namespace Core {
@@ -179,4 +181,26 @@ QDirValueType Dir::create(const QString &path)
     return QDirValueType(path);
 }
 
+/*!
+ * \qmlmethod DirWalker Dir::walk(string path, object options = {})
+ * Returns an iterator over the files and directories in `path` and its subdirectories.
+ *
+ * The `options` are:
+ *
+ * - `nameFilters`: wildcards the file names must match, e.g. `["*.cpp", "*.h"]`, the directories are all returned
+ * - `exclude`: wildcards of the files and directories to skip, an excluded directory isn't walked
+ * - `maxDepth`: depth of the subdirectories walked, 0 only returns the entries of `path`, -1 (default) has no limit
+ *
+ * Contrary to listing directories level by level, the entries are read ahead on a worker thread, and returned as
+ * plain objects, see `DirWalker`.
+ */
+DirWalker *Dir::walk(const QString &path, const QVariantMap &options)
+{
+    LOG("Dir::walk", path, options);
+    if (!QFileInfo(path).isDir())
+        spdlog::warn("Dir::walk - {} is not a directory", path);
+    // No parent: the walker is owned by the caller, the JavaScript engine when called from a script
+    return new DirWalker(path, DirWalker::optionsFromMap(options));
+}
+
 } // namespace Core
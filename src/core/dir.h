@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include "dirwalker.h"
 #include "qdirvaluetype.h"
 
 #include <QDir>
@@ -104,6 +105,8 @@ public slots:
 
     static Core::QDirValueType create(const QString &path);
 
+    static Core::DirWalker *walk(const QString &path, const QVariantMap &options = {});
+
 signals:
     void currentPathChanged(const QString &path);
 
@@ -0,0 +1,210 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "dirwalker.h"
+#include "utils/taskscheduler.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace Core {
+
+/*!
+ * \qmltype DirWalker
+ * \brief Iterates over the files and directories of a directory and its subdirectories.
+ * \inqmlmodule Script
+ * \ingroup Utilities
+ * \sa Dir::walk
+ *
+ * The directories are walked on a worker thread, reading ahead of the script. Each entry is a plain object, so walking
+ * a large tree doesn't create a `FileInfo` for each file:
+ *
+ * ```js
+ * let walker = Dir.walk(Project.root, {nameFilters: ["*.cpp", "*.h"], exclude: [".git", "build*"]});
+ * while (walker.hasNext()) {
+ *     let entry = walker.next();
+ *     if (!entry.isDir && entry.size > 1000000)
+ *         Message.log(entry.path);
+ * }
+ * ```
+ *
+ * Each entry has the properties:
+ *
+ * - `path`: path of the entry, starting with the path walked
+ * - `name`: file name of the entry
+ * - `depth`: 0 for the entries of the directory walked, 1 for the entries of its subdirectories...
+ * - `isDir`, `isSymLink`: type of the entry, the symbolic links to directories are not walked
+ * - `size`: size of a file in bytes
+ * - `lastModified`: date and time of the last modification
+ *
+ * A directory comes before its entries, the entries of a directory are in no particular order.
+ */
+
+// The worker thread stops once that many entries are waiting for the script, and starts again below half of it
+static constexpr size_t ReadAheadSize = 512;
+static constexpr size_t BatchSize = 64;
+static constexpr auto DirFilters = QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System;
+
+struct DirWalker::Entry
+{
+    QString path;
+    QString name;
+    int depth = 0;
+    bool isDir = false;
+    bool isSymLink = false;
+    qint64 size = 0;
+    QDateTime lastModified;
+};
+
+struct DirWalker::State
+{
+    Options options;
+    // Directories being walked, the deepest last: only used by the worker thread
+    struct Level
+    {
+        std::unique_ptr<QDirIterator> iterator;
+        int depth;
+    };
+    std::vector<Level> levels;
+
+    std::mutex mutex;
+    std::condition_variable entriesChanged;
+    std::deque<Entry> entries;
+    bool running = false;
+    bool done = false;
+    bool cancelled = false;
+};
+
+DirWalker::DirWalker(const QString &path, Options options)
+    : m_state(std::make_shared<State>())
+{
+    m_state->options = std::move(options);
+    m_state->levels.push_back({std::make_unique<QDirIterator>(path, DirFilters), 0});
+    std::lock_guard lock(m_state->mutex);
+    readAhead();
+}
+
+DirWalker::~DirWalker()
+{
+    std::lock_guard lock(m_state->mutex);
+    m_state->cancelled = true;
+}
+
+DirWalker::Options DirWalker::optionsFromMap(const QVariantMap &map)
+{
+    return {.nameFilters = map.value("nameFilters").toStringList(),
+            .exclude = map.value("exclude").toStringList(),
+            .maxDepth = map.value("maxDepth", -1).toInt()};
+}
+
+void DirWalker::readAhead()
+{
+    if (m_state->running || m_state->done)
+        return;
+    m_state->running = true;
+    ::Utils::TaskScheduler::start([state = m_state]() {
+        walk(state);
+    });
+}
+
+void DirWalker::walk(const std::shared_ptr<State> &state)
+{
+    const auto &options = state->options;
+    std::vector<Entry> batch;
+    batch.reserve(BatchSize);
+    for (;;) {
+        // The entries are read without locking, and added by batches
+        batch.clear();
+        while (batch.size() < BatchSize && !state->levels.empty()) {
+            auto &level = state->levels.back();
+            if (!level.iterator->hasNext()) {
+                state->levels.pop_back();
+                continue;
+            }
+            level.iterator->next();
+            const auto info = level.iterator->fileInfo();
+            const int depth = level.depth;
+            const auto name = info.fileName();
+            if (QDir::match(options.exclude, name))
+                continue;
+            const bool isDir = info.isDir();
+            if (!isDir && !options.nameFilters.isEmpty() && !QDir::match(options.nameFilters, name))
+                continue;
+
+            batch.push_back({.path = info.filePath(),
+                             .name = name,
+                             .depth = depth,
+                             .isDir = isDir,
+                             .isSymLink = info.isSymLink(),
+                             .size = isDir ? 0 : info.size(),
+                             .lastModified = info.lastModified()});
+            if (isDir && !info.isSymLink() && (options.maxDepth < 0 || depth < options.maxDepth))
+                state->levels.push_back({std::make_unique<QDirIterator>(info.filePath(), DirFilters), depth + 1});
+        }
+
+        std::lock_guard lock(state->mutex);
+        state->entries.insert(state->entries.end(), std::make_move_iterator(batch.begin()),
+                              std::make_move_iterator(batch.end()));
+        state->done = state->levels.empty();
+        state->entriesChanged.notify_all();
+        if (state->done || state->cancelled || state->entries.size() >= ReadAheadSize) {
+            state->running = false;
+            return;
+        }
+    }
+}
+
+/*!
+ * \qmlmethod bool DirWalker::hasNext()
+ * Returns true if there's another entry, waiting for the worker thread to read it if needed.
+ */
+bool DirWalker::hasNext()
+{
+    std::unique_lock lock(m_state->mutex);
+    if (m_state->entries.empty() && !m_state->done) {
+        readAhead();
+        m_state->entriesChanged.wait(lock, [this]() {
+            return !m_state->entries.empty() || m_state->done;
+        });
+    }
+    return !m_state->entries.empty();
+}
+
+/*!
+ * \qmlmethod object DirWalker::next()
+ * Returns the next entry, or an empty object once all the entries have been returned.
+ */
+QVariantMap DirWalker::next()
+{
+    if (!hasNext())
+        return {};
+
+    std::unique_lock lock(m_state->mutex);
+    auto entry = std::move(m_state->entries.front());
+    m_state->entries.pop_front();
+    if (m_state->entries.size() < ReadAheadSize / 2)
+        readAhead();
+    lock.unlock();
+
+    return {{"path", entry.path},
+            {"name", entry.name},
+            {"depth", entry.depth},
+            {"isDir", entry.isDir},
+            {"isSymLink", entry.isSymLink},
+            {"size", entry.size},
+            {"lastModified", entry.lastModified}};
+}
+
+} // namespace Core
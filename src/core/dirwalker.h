@@ -0,0 +1,55 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+#include <memory>
+
+namespace Core {
+
+class DirWalker : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        // Wildcards matched on the file names, the directories are all returned
+        QStringList nameFilters;
+        // Wildcards matched on the file and directory names, an excluded directory isn't walked
+        QStringList exclude;
+        // Depth of the directories walked, 0 only returns the entries of the root, -1 has no limit
+        int maxDepth = -1;
+    };
+
+    DirWalker(const QString &path, Options options);
+    ~DirWalker() override;
+
+    static Options optionsFromMap(const QVariantMap &map);
+
+    Q_INVOKABLE bool hasNext();
+    Q_INVOKABLE QVariantMap next();
+
+private:
+    struct Entry;
+    struct State;
+    // Starts reading ahead on a worker thread, if it's not already running
+    void readAhead();
+    // Walks the directories on a worker thread until enough entries are read ahead
+    static void walk(const std::shared_ptr<State> &state);
+
+    // Shared with the worker thread, which may still run after the walker is destroyed
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace Core
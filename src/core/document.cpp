@@ -9,8 +9,13 @@
 */
 
 #include "document.h"
+#include "dryrun.h"
 #include "logger.h"
+#include "project.h"
+#include "settings.h"
+#include "utils/counters.h"
 #include "utils/log.h"
+#include "utils/trace.h"
 
 #include <QApplication>
 #include <QFileInfo>
@@ -105,6 +110,11 @@ void Document::setErrorString(const QString &error)
 Document::ConflictResolution Document::resolveConflictsOnSave() const
 {
     const QFileInfo fi(m_fileName);
+    // Without the user interface, the changes on disk are kept: they can't be lost by a script
+    if (!Settings::hasWidgets()) {
+        spdlog::warn("Document::save - {} has changed on disk, it's not saved", m_fileName);
+        return KeepDiskChanges;
+    }
     const auto result = QMessageBox::question(
         QApplication::activeWindow(), tr("File changed externally"),
         tr("%1\n\nThe file has unsaved changes inside this editor and has been changed externally.\n"
@@ -129,11 +139,17 @@ bool Document::hasChangedOnDisk() const
     return true;
 }
 
+MemoryUsage Document::memoryUsage() const
+{
+    return {};
+}
+
 void Document::reload()
 {
     doLoad(m_fileName);
     const QFileInfo fi(m_fileName);
     m_lastModified = fi.lastModified();
+    Utils::Counters::add(Utils::Counters::BytesRead, fi.size());
     emit fileUpdated();
 }
 
@@ -145,6 +161,7 @@ void Document::reload()
 bool Document::load(const QString &fileName)
 {
     LOG("Document::load", fileName);
+    TRACE("Document::load", fileName);
     if (fileName.isEmpty()) {
         spdlog::warn("Document::load - fileName is empty");
         return false;
@@ -157,6 +174,7 @@ bool Document::load(const QString &fileName)
     m_fileName = fileName;
     const QFileInfo fi(m_fileName);
     m_lastModified = fi.lastModified();
+    Utils::Counters::add(Utils::Counters::BytesRead, fi.size());
 
     didOpen();
     emit fileNameChanged();
@@ -181,6 +199,7 @@ bool Document::save()
 bool Document::saveAs(const QString &fileName)
 {
     LOG("Document::saveAs", fileName);
+    TRACE("Document::saveAs", fileName);
     if (fileName.isEmpty()) {
         spdlog::error("Document::saveAs - fileName is empty");
         return false;
@@ -199,17 +218,34 @@ bool Document::saveAs(const QString &fileName)
         }
     }
 
-    const bool saveDone = doSave(m_fileName);
+    const bool isNewFile = !DryRun::isEnabled() && !QFileInfo::exists(m_fileName);
+    const bool saveDone = DryRun::isEnabled() ? doDryRunSave(m_fileName) : doSave(m_fileName);
     if (saveDone) {
-        setHasChanged(false);
-        if (isNewName)
-            didOpen();
-        const QFileInfo fi(m_fileName);
-        m_lastModified = fi.lastModified();
+        finishSave(isNewName);
+        if (isNewFile)
+            Project::updateIndexForPath(m_fileName);
     }
     return saveDone;
 }
 
+bool Document::doDryRunSave(const QString &fileName)
+{
+    spdlog::warn("Document::saveAs - {} is not saved in a dry run, only text documents are part of the patch",
+                 fileName);
+    return true;
+}
+
+void Document::finishSave(bool isNewName)
+{
+    setHasChanged(false);
+    if (isNewName)
+        didOpen();
+    const QFileInfo fi(m_fileName);
+    m_lastModified = fi.lastModified();
+    if (!DryRun::isEnabled())
+        Utils::Counters::add(Utils::Counters::BytesWritten, fi.size());
+}
+
 /*!
  * \qmlmethod bool Document::close()
  * Close the current document. If the current document has some changes, save them
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include "memoryusage.h"
 #include "utils/json.h"
 
 #include <QDateTime>
@@ -57,6 +58,9 @@ public:
     bool hasChangedOnDisk() const;
     void reload();
 
+    // Approximate memory used by the document, see Project::memoryReport
+    virtual MemoryUsage memoryUsage() const;
+
 public slots:
     bool load(const QString &fileName);
     bool save();
@@ -73,6 +77,8 @@ signals:
 protected:
     virtual bool doSave(const QString &fileName) = 0;
     virtual bool doLoad(const QString &fileName) = 0;
+    // Save done in a dry run, see DryRun: only text documents record their changes
+    virtual bool doDryRunSave(const QString &fileName);
 
     virtual void didOpen() { }
     virtual void didClose() { }
@@ -81,8 +87,12 @@ protected:
     void setErrorString(const QString &error);
 
 private:
+    // Project saves all the documents at once, with the steps of saveAs
+    friend class Project;
+
     enum ConflictResolution { KeepDiskChanges, OverwriteDiskChanges };
     ConflictResolution resolveConflictsOnSave() const;
+    void finishSave(bool isNewName);
 
     QString m_fileName;
     Type m_type;
@@ -0,0 +1,129 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "documentprefetcher.h"
+#include "settings.h"
+#include "textdocument_p.h"
+#include "treesitter/parser.h"
+#include "utils/counters.h"
+
+#include <QFile>
+#include <QFileInfo>
+
+namespace Core {
+
+DocumentPrefetcher::DocumentPrefetcher(int window)
+    : m_window(window)
+{
+}
+
+DocumentPrefetcher::~DocumentPrefetcher()
+{
+    clear();
+    m_tasks.wait();
+}
+
+// Loads the file as TextDocument::doLoad would, and parses it as CodeDocument would.
+// This is called from a worker thread, so it must not touch any QObject.
+static std::optional<DocumentPrefetcher::File> prefetchFile(const QString &fileName, Document::Type type)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    const auto size = file.size();
+    const uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+    const QByteArray data = mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size)
+                                   : file.readAll();
+
+    DocumentPrefetcher::File result;
+    result.text = Utils::decodeText(data, Settings::instance()->snapshot().fallbackEncoding);
+    result.text.text = toDocumentText(std::move(result.text.text));
+
+    if (type == Document::Type::Cpp || type == Document::Type::Qml) {
+        auto parser = treesitter::ParserPool::acquire(treesitter::Parser::getLanguage(type));
+        result.tree = parser.parseString(result.text.text);
+        treesitter::ParserPool::release(std::move(parser));
+    }
+    return result;
+}
+
+void DocumentPrefetcher::prefetch(const std::vector<std::pair<QString, Document::Type>> &files)
+{
+    std::lock_guard lock(m_mutex);
+    m_queue.insert(m_queue.end(), files.begin(), files.end());
+    startNext();
+}
+
+void DocumentPrefetcher::startNext()
+{
+    while (!m_queue.empty() && static_cast<int>(m_entries.size()) < m_window) {
+        auto [fileName, type] = m_queue.front();
+        m_queue.pop_front();
+        if (m_entries.contains(fileName))
+            continue;
+        const int id = ++m_nextId;
+        m_entries[fileName] = {.id = id};
+
+        m_tasks.start([this, fileName, type, id]() {
+            const QFileInfo info(fileName);
+            const auto size = info.size();
+            const auto lastModified = info.lastModified();
+            auto file = prefetchFile(fileName, type);
+
+            std::lock_guard lock(m_mutex);
+            auto it = m_entries.find(fileName);
+            if (it == m_entries.end() || it->second.id != id)
+                return;
+            it->second = {.done = true, .file = std::move(file), .size = size, .lastModified = lastModified, .id = id};
+            m_fileDone.notify_all();
+        });
+    }
+}
+
+std::optional<DocumentPrefetcher::File> DocumentPrefetcher::take(const QString &fileName)
+{
+    std::unique_lock lock(m_mutex);
+    if (!m_entries.contains(fileName)) {
+        // Not started yet: loading it now is faster than waiting for the files before it
+        std::erase_if(m_queue, [&fileName](const auto &file) {
+            return file.first == fileName;
+        });
+        return {};
+    }
+
+    m_fileDone.wait(lock, [&]() {
+        auto it = m_entries.find(fileName);
+        return it == m_entries.end() || it->second.done;
+    });
+    auto node = m_entries.extract(fileName);
+    startNext();
+    lock.unlock();
+
+    if (node.empty() || !node.mapped().file)
+        return {};
+    // The file may have been written since it was read
+    const QFileInfo info(fileName);
+    if (info.size() != node.mapped().size || info.lastModified() != node.mapped().lastModified)
+        return {};
+
+    Utils::Counters::add(Utils::Counters::DocumentsPrefetched);
+    return std::move(node.mapped().file);
+}
+
+void DocumentPrefetcher::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_queue.clear();
+    // The workers of the entries still being prefetched drop their file once done, so the same file can be queued
+    // again right away
+    m_entries.clear();
+}
+
+} // namespace Core
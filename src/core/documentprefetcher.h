@@ -0,0 +1,80 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "document.h"
+#include "treesitter/tree.h"
+#include "utils/taskscheduler.h"
+#include "utils/textcodec.h"
+
+#include <QDateTime>
+#include <QString>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace Core {
+
+// Reads, decodes and parses files on worker threads, ahead of a script opening them one after the other.
+// Only a bounded window of files is prefetched ahead of the last one taken, so memory stays under control whatever
+// the number of files queued. The documents themselves are still created on the main thread, by Project::get, which
+// takes the prefetched text and syntax tree instead of loading and parsing the file.
+class DocumentPrefetcher
+{
+public:
+    struct File
+    {
+        // Text normalized as in a TextDocument, see toDocumentText
+        Utils::DecodedText text;
+        // Only for the languages with a tree-sitter grammar, parsed from text.text
+        std::optional<treesitter::Tree> tree;
+    };
+
+    explicit DocumentPrefetcher(int window);
+    // Waits for the files being prefetched
+    ~DocumentPrefetcher();
+
+    // Queues the files after the ones already queued, fileNames must be absolute paths
+    void prefetch(const std::vector<std::pair<QString, Document::Type>> &files);
+    // Returns the prefetched file, waiting for it if it's being prefetched, or nothing if it's not prefetched (not
+    // queued, not started yet, or changed on disk since). The next queued file is then prefetched.
+    std::optional<File> take(const QString &fileName);
+    // Drops the queued files and the prefetched ones not taken yet
+    void clear();
+
+private:
+    struct Entry
+    {
+        bool done = false;
+        std::optional<File> file;
+        qint64 size = -1;
+        QDateTime lastModified;
+        // Tells the worker if its entry was dropped by clear(), and maybe queued again since
+        int id = 0;
+    };
+
+    // Must be called with m_mutex locked
+    void startNext();
+
+    const int m_window;
+    Utils::TaskGroup m_tasks {Utils::TaskScheduler::Background};
+    std::mutex m_mutex;
+    std::condition_variable m_fileDone;
+    std::deque<std::pair<QString, Document::Type>> m_queue;
+    // Files being prefetched, or prefetched and not taken yet
+    std::unordered_map<QString, Entry> m_entries;
+    int m_nextId = 0;
+};
+
+} // namespace Core
@@ -0,0 +1,177 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "dryrun.h"
+#include "settings.h"
+#include "textdocument_p.h"
+#include "utils/linediff.h"
+#include "utils/log.h"
+#include "utils/taskscheduler.h"
+#include "utils/textcodec.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <map>
+#include <vector>
+
+namespace Core {
+
+namespace {
+
+struct Change
+{
+    QString text;
+    QString encoding;
+    bool crlf = false;
+};
+
+struct DryRunState
+{
+    bool enabled = false;
+    // Sorted by file name, so the patch is the same whatever the order of the saves
+    std::map<QString, Change> changes;
+};
+
+} // namespace
+
+static DryRunState &state()
+{
+    static DryRunState dryRunState;
+    return dryRunState;
+}
+
+void DryRun::setEnabled(bool enabled)
+{
+    state().enabled = enabled;
+}
+
+bool DryRun::isEnabled()
+{
+    return state().enabled;
+}
+
+void DryRun::addChange(const QString &fileName, QString text, const QString &encoding, bool crlf)
+{
+    state().changes[fileName] = {std::move(text), encoding, crlf};
+}
+
+void DryRun::clear()
+{
+    state().changes.clear();
+}
+
+// Appends the lines of the hunk from the old or the new text, the last line of a text may not have a new line
+static void appendHunkLine(QByteArray &patch, char kind, QStringView line, const QString &encoding, bool crlf)
+{
+    patch.append(kind);
+    const bool hasNewLine = line.endsWith(u'\n');
+    Utils::appendEncodedText(patch, hasNewLine ? line.chopped(1) : line, encoding);
+    patch.append(crlf ? "\r\n" : "\n");
+    if (!hasNewLine)
+        patch.append("\\ No newline at end of file\n");
+}
+
+static QByteArray hunkRange(int start, int count)
+{
+    if (count == 1)
+        return QByteArray::number(start + 1);
+    // An empty range starts at the line before it
+    return QByteArray::number(count == 0 ? start : start + 1) + ',' + QByteArray::number(count);
+}
+
+// Returns the diff of the file on disk with the saved text, empty if they are the same
+static QByteArray fileDiff(const QString &fileName, const QString &path, const Change &change,
+                           const QString &fallbackEncoding)
+{
+    QFile file(fileName);
+    const bool exists = file.exists();
+    Utils::DecodedText original;
+    if (exists) {
+        if (!file.open(QIODevice::ReadOnly)) {
+            spdlog::error("DryRun::patch - can't read file {}: {}", fileName, file.errorString());
+            return {};
+        }
+        original = Utils::decodeText(file.readAll(), fallbackEncoding);
+    }
+    // Compare the texts as they are in the documents, the line endings are only restored in the patch
+    const QString originalText = toDocumentText(std::move(original.text));
+
+    const auto oldLines = Utils::splitLines(originalText);
+    const auto newLines = Utils::splitLines(change.text);
+    const auto hunks = Utils::diffLines(oldLines, newLines);
+    if (hunks.empty() && exists)
+        return {};
+
+    const QByteArray utf8Path = path.toUtf8();
+    QByteArray patch;
+    patch.append("diff --git a/" + utf8Path + " b/" + utf8Path + '\n');
+    if (!exists)
+        patch.append("new file mode 100644\n");
+    patch.append(exists ? "--- a/" + utf8Path + '\n' : QByteArray("--- /dev/null\n"));
+    patch.append("+++ b/" + utf8Path + '\n');
+    for (const auto &hunk : hunks) {
+        patch.append("@@ -" + hunkRange(hunk.oldStart, hunk.oldCount) + " +" + hunkRange(hunk.newStart, hunk.newCount)
+                     + " @@\n");
+        for (const auto &line : hunk.lines) {
+            if (line.kind == Utils::DiffLine::Added)
+                appendHunkLine(patch, line.kind, newLines[line.index], change.encoding, change.crlf);
+            else
+                appendHunkLine(patch, line.kind, oldLines[line.index], original.encoding, original.crlf);
+        }
+    }
+    return patch;
+}
+
+QByteArray DryRun::patch(const QString &rootPath)
+{
+    const auto &changes = state().changes;
+    const QDir root(rootPath);
+    const auto fallbackEncoding = Settings::exists() ? Settings::instance()->snapshot().fallbackEncoding : QString();
+
+    std::vector<std::map<QString, Change>::const_iterator> entries;
+    entries.reserve(changes.size());
+    for (auto it = changes.cbegin(); it != changes.cend(); ++it)
+        entries.push_back(it);
+
+    std::vector<QByteArray> diffs(entries.size());
+    Utils::TaskGroup tasks;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        tasks.start([&, i]() {
+            const auto &[fileName, change] = *entries[i];
+            const QString path = rootPath.isEmpty() ? fileName : root.relativeFilePath(fileName);
+            diffs[i] = fileDiff(fileName, path, change, fallbackEncoding);
+        });
+    }
+    tasks.wait();
+
+    QByteArray result;
+    for (const auto &diff : diffs)
+        result.append(diff);
+    return result;
+}
+
+bool DryRun::writePatch(const QString &patchFileName, const QString &rootPath)
+{
+    QSaveFile file(patchFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::error("DryRun::writePatch - can't write the patch {}: {}", patchFileName, file.errorString());
+        return false;
+    }
+    const QByteArray data = patch(rootPath);
+    if (file.write(data) != data.size() || !file.commit()) {
+        spdlog::error("DryRun::writePatch - can't write the patch {}: {}", patchFileName, file.errorString());
+        return false;
+    }
+    spdlog::info("DryRun::writePatch - {} files saved, patch written to {}", state().changes.size(), patchFileName);
+    return true;
+}
+
+} // namespace Core
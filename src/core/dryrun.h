@@ -0,0 +1,42 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+namespace Core {
+
+/**
+ * \brief Dry run of the scripts, enabled with `knut --run <script> --dry-run`
+ *
+ * Saving a text document doesn't write the file: the saved text is kept in memory, and the changes of all the saved
+ * documents are turned into one unified diff at the end, see patch. The files on disk are only read then, to diff them
+ * with the saved texts, one task per document.
+ *
+ * The changes are recorded from the main thread only.
+ */
+class DryRun
+{
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // Records the text saved as fileName, only the last save of a file is kept
+    static void addChange(const QString &fileName, QString text, const QString &encoding, bool crlf);
+    static void clear();
+
+    // Returns the unified diff of all the saved documents, sorted by file name, with the paths relative to rootPath
+    static QByteArray patch(const QString &rootPath);
+    static bool writePatch(const QString &patchFileName, const QString &rootPath);
+};
+
+} // namespace Core
@@ -10,9 +10,17 @@
 
 #include "file.h"
 #include "logger.h"
+#include "project.h"
+#include "utils/taskscheduler.h"
 
+#include <QCoreApplication>
 #include <QFile>
+#include <QJSEngine>
+#include <QPointer>
 #include <QTextStream>
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace Core {
 
@@ -24,6 +32,10 @@ namespace Core {
  *
  * The `File` singleton implements most of the static methods from `QFile`, check
  * [QFile](https://doc.qt.io/qt-5/qfile.html) documentation.
+ *
+ * The methods ending with `Async`, and `readMany`, run on a thread pool and return a `Promise`, so a script can
+ * process files while others are being read. The promises are resolved from the event loop: a script waiting for
+ * them needs to let the event loop run, in a QML script or with `Utils.sleep` for example.
  */
 
 File::File(QObject *parent)
@@ -39,7 +51,10 @@ File::~File() = default;
 bool File::copy(const QString &fileName, const QString &newName)
 {
     LOG("File::copy", fileName, newName);
-    return QFile::copy(fileName, newName);
+    if (!QFile::copy(fileName, newName))
+        return false;
+    Project::updateIndexForPath(newName);
+    return true;
 }
 
 /*!
@@ -57,7 +72,10 @@ bool File::exists(const QString &fileName)
 bool File::remove(const QString &fileName)
 {
     LOG("File::remove", fileName);
-    return QFile::remove(fileName);
+    if (!QFile::remove(fileName))
+        return false;
+    Project::updateIndexForPath(fileName);
+    return true;
 }
 
 /*!
@@ -66,7 +84,11 @@ bool File::remove(const QString &fileName)
 bool File::rename(const QString &oldName, const QString &newName)
 {
     LOG("File::rename", oldName, newName);
-    return QFile::rename(oldName, newName);
+    if (!QFile::rename(oldName, newName))
+        return false;
+    Project::updateIndexForPath(oldName);
+    Project::updateIndexForPath(newName);
+    return true;
 }
 
 /*!
@@ -75,16 +97,18 @@ bool File::rename(const QString &oldName, const QString &newName)
 bool File::touch(const QString &fileName)
 {
     LOG("File::touch", fileName);
+    const bool isNewFile = !QFile::exists(fileName);
     QFile file(fileName);
-    return file.open(QFile::Append);
+    if (!file.open(QFile::Append))
+        return false;
+    if (isNewFile)
+        Project::updateIndexForPath(fileName);
+    return true;
 }
 
-/*!
- * \qmlmethod string File::readAll(string fileName)
- */
-QString File::readAll(const QString &fileName)
+// Can be called from any thread
+static QString readFile(const QString &fileName)
 {
-    LOG("File::readAll", fileName);
     QFile file(fileName);
     if (file.open(QFile::ReadOnly | QIODevice::Text)) {
         QTextStream stream(&file);
@@ -93,4 +117,141 @@ QString File::readAll(const QString &fileName)
     return {};
 }
 
+QJSValue File::createPromise(int &id)
+{
+    auto engine = qjsEngine(this);
+    Q_ASSERT(engine);
+    if (m_createDeferred.isUndefined()) {
+        m_createDeferred = engine->evaluate(QStringLiteral(
+            "(function() { let deferred = {}; deferred.promise = new Promise(resolve => deferred.resolve = resolve); "
+            "return deferred; })"));
+    }
+
+    const auto deferred = m_createDeferred.call();
+    id = m_nextPromiseId++;
+    m_pendingPromises.insert(id, deferred.property("resolve"));
+    return deferred.property("promise");
+}
+
+void File::resolvePromise(int id, const QVariant &value)
+{
+    auto resolve = m_pendingPromises.take(id);
+    resolve.call({qjsEngine(this)->toScriptValue(value)});
+}
+
+// Runs `work` on the thread pool, the promise returned is resolved with the QVariant returned by `work`
+template <typename Work>
+QJSValue File::runAsync(Work &&work)
+{
+    int id = 0;
+    auto promise = createPromise(id);
+
+    // The QJSValues are only used on the engine thread
+    QPointer<File> self(this);
+    Utils::TaskScheduler::start(
+        [self, id, work = std::forward<Work>(work)]() {
+            QVariant result = work();
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [self, id, result = std::move(result)]() {
+                    if (self)
+                        self->resolvePromise(id, result);
+                },
+                Qt::QueuedConnection);
+        },
+        Utils::TaskScheduler::Script);
+    return promise;
+}
+
+/*!
+ * \qmlmethod string File::readAll(string fileName)
+ */
+QString File::readAll(const QString &fileName)
+{
+    LOG("File::readAll", fileName);
+    return readFile(fileName);
+}
+
+/*!
+ * \qmlmethod Promise<string> File::readAllAsync(string fileName)
+ * Reads the file `fileName` on a worker thread, the promise is resolved with its content.
+ *
+ * ```
+ * File.readAllAsync(fileName).then(text => console.log(text.length))
+ * ```
+ */
+QJSValue File::readAllAsync(const QString &fileName)
+{
+    LOG("File::readAllAsync", fileName);
+    return runAsync([fileName]() {
+        return QVariant(readFile(fileName));
+    });
+}
+
+/*!
+ * \qmlmethod Promise<array<string>> File::readMany(array<string> fileNames)
+ * Reads all the files in `fileNames` in parallel, the promise is resolved with their contents, in the same order.
+ *
+ * As for `readAll`, the content of a file that can't be read is an empty string.
+ */
+QJSValue File::readMany(const QStringList &fileNames)
+{
+    LOG("File::readMany", fileNames);
+
+    int id = 0;
+    auto promise = createPromise(id);
+    if (fileNames.isEmpty()) {
+        resolvePromise(id, QStringList());
+        return promise;
+    }
+
+    // Each worker only writes its own content, the last one to finish sends them all back
+    struct Batch
+    {
+        std::vector<QString> contents;
+        std::atomic<qsizetype> remaining;
+    };
+    auto batch = std::make_shared<Batch>();
+    batch->contents.resize(fileNames.size());
+    batch->remaining = fileNames.size();
+
+    QPointer<File> self(this);
+    for (qsizetype i = 0; i < fileNames.size(); ++i) {
+        Utils::TaskScheduler::start(
+            [self, id, batch, i, fileName = fileNames[i]]() {
+                batch->contents[i] = readFile(fileName);
+                if (--batch->remaining > 0)
+                    return;
+                QMetaObject::invokeMethod(
+                    QCoreApplication::instance(),
+                    [self, id, batch]() {
+                        if (self)
+                            self->resolvePromise(id, QStringList(batch->contents.begin(), batch->contents.end()));
+                    },
+                    Qt::QueuedConnection);
+            },
+            Utils::TaskScheduler::Script);
+    }
+    return promise;
+}
+
+/*!
+ * \qmlmethod Promise<bool> File::copyAsync(string fileName, string newName)
+ * Copies the file `fileName` to `newName` on a worker thread, the promise is resolved with the result of the copy.
+ */
+QJSValue File::copyAsync(const QString &fileName, const QString &newName)
+{
+    LOG("File::copyAsync", fileName, newName);
+    return runAsync([fileName, newName]() {
+        const bool copied = QFile::copy(fileName, newName);
+        // Posted before the promise is resolved, so the index is up-to-date when the script continues
+        if (copied) {
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(), [newName]() { Project::updateIndexForPath(newName); },
+                Qt::QueuedConnection);
+        }
+        return QVariant(copied);
+    });
+}
+
 } // namespace Core
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <QHash>
+#include <QJSValue>
 #include <QObject>
 
 namespace Core {
@@ -22,6 +24,10 @@ public:
     explicit File(QObject *parent = nullptr);
     ~File() override;
 
+    Q_INVOKABLE QJSValue readAllAsync(const QString &fileName);
+    Q_INVOKABLE QJSValue readMany(const QStringList &fileNames);
+    Q_INVOKABLE QJSValue copyAsync(const QString &fileName, const QString &newName);
+
 public slots:
     static bool copy(const QString &fileName, const QString &newName);
     static bool exists(const QString &fileName);
@@ -31,6 +37,18 @@ public slots:
     static bool touch(const QString &fileName);
 
     static QString readAll(const QString &fileName);
+
+private:
+    QJSValue createPromise(int &id);
+    void resolvePromise(int id, const QVariant &value);
+    template <typename Work>
+    QJSValue runAsync(Work &&work);
+
+    // Function returning a {promise, resolve} object, created once per engine
+    QJSValue m_createDeferred;
+    // Resolve functions of the pending promises, by id
+    QHash<int, QJSValue> m_pendingPromises;
+    int m_nextPromiseId = 0;
 };
 
 } // namespace Core
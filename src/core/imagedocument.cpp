@@ -9,6 +9,7 @@
 */
 
 #include "imagedocument.h"
+#include "utils/imagecache.h"
 #include "utils/log.h"
 
 namespace Core {
@@ -23,6 +24,13 @@ QImage ImageDocument::image() const
     return m_image;
 }
 
+MemoryUsage ImageDocument::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.add("image", m_image.sizeInBytes());
+    return usage;
+}
+
 bool ImageDocument::doSave(const QString &fileName)
 {
     Q_UNUSED(fileName)
@@ -32,7 +40,9 @@ bool ImageDocument::doSave(const QString &fileName)
 
 bool ImageDocument::doLoad(const QString &fileName)
 {
-    return m_image.load(fileName);
+    // Shared with the RC asset views and conversions, the image is only decoded once
+    m_image = Utils::ImageCache::instance()->image(fileName);
+    return !m_image.isNull();
 }
 
 } // namespace Core
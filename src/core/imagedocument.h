@@ -25,6 +25,8 @@ public:
 
     QImage image() const;
 
+    MemoryUsage memoryUsage() const override;
+
 protected:
     bool doSave(const QString &fileName) override;
     bool doLoad(const QString &fileName) override;
@@ -0,0 +1,325 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "includeindex.h"
+#include "cppdocument_p.h"
+#include "treesitter/parser.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/utf8source.h"
+#include "utils/cancellation.h"
+#include "utils/log.h"
+#include "utils/taskscheduler.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <ranges>
+#include <unordered_set>
+
+namespace Core {
+
+//=============================================================================
+// Include extraction
+//=============================================================================
+// Parses one file and returns its includes. This is called from a worker thread, so it must not touch any QObject.
+static QStringList extractIncludes(const QByteArray &data, const std::shared_ptr<treesitter::Query> &query)
+{
+    const QString text = QString::fromUtf8(data);
+    // The tree is never edited, so it can be parsed from UTF-8, like in Project::queryAll
+    const auto source = std::make_shared<treesitter::Utf8Source>(text);
+    treesitter::PooledParser parser(treesitter::Parser::getLanguage(Document::Type::Cpp));
+    const auto tree = parser->parseUtf8(source);
+    if (!tree)
+        return {};
+
+    treesitter::QueryCursor cursor;
+    cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text));
+    QStringList includes;
+    while (const auto match = cursor.nextMatch()) {
+        for (const auto &capture : match->captures())
+            includes.push_back(capture.node.textIn(text));
+    }
+    return includes;
+}
+
+// Number of leading characters shared by the two paths, used to find the closest file
+static qsizetype commonPrefixSize(const QString &first, const QString &second)
+{
+    const auto size = std::min(first.size(), second.size());
+    qsizetype i = 0;
+    while (i < size && first[i] == second[i])
+        ++i;
+    return i;
+}
+
+//=============================================================================
+// IncludeIndex
+//=============================================================================
+bool IncludeIndex::update(const QStringList &files)
+{
+    bool changed = false;
+
+    const std::unordered_set<QString> fileSet(files.cbegin(), files.cend());
+    changed |= std::erase_if(m_files, [&fileSet](const auto &item) {
+                   return !fileSet.contains(item.first);
+               }) > 0;
+
+    // Same as SymbolIndex::update: files are only read if their size or modification time changed, and only parsed if
+    // their content changed.
+    struct Job
+    {
+        QString fileName;
+        QByteArray previousHash;
+        FileEntry entry;
+        bool isReadable = false;
+        bool isParsed = false;
+    };
+    std::vector<Job> jobs;
+    for (const auto &fileName : files) {
+        const QFileInfo fi(fileName);
+        const auto size = fi.size();
+        const auto lastModified = fi.lastModified().toMSecsSinceEpoch();
+        const auto it = m_files.find(fileName);
+        if (it != m_files.end() && it->second.size == size && it->second.lastModified == lastModified)
+            continue;
+        jobs.push_back({.fileName = fileName,
+                        .previousHash = it != m_files.end() ? it->second.hash : QByteArray(),
+                        .entry = {.size = size, .lastModified = lastModified}});
+    }
+    if (jobs.empty()) {
+        if (changed)
+            buildLookups();
+        return changed;
+    }
+
+    std::shared_ptr<treesitter::Query> query;
+    try {
+        query = treesitter::QueryCache::instance().get(treesitter::Parser::getLanguage(Document::Type::Cpp),
+                                                       Queries::findInclude);
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("IncludeIndex::update - failed to parse the includes query, error: {} at: {}", error.description,
+                      error.utf8_offset);
+        return changed;
+    }
+
+    Utils::TaskGroup tasks(Utils::TaskScheduler::Background);
+    for (auto &job : jobs) {
+        tasks.start([&job, &query]() {
+            QFile file(job.fileName);
+            if (!file.open(QIODevice::ReadOnly))
+                return;
+            const QByteArray data = file.readAll();
+            job.isReadable = true;
+            job.entry.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+            if (job.entry.hash == job.previousHash)
+                return;
+            job.entry.includes = extractIncludes(data, query);
+            job.isParsed = true;
+        });
+    }
+    tasks.wait();
+    // The queries stop on an abort, the files are indexed on the next update instead
+    if (Utils::Cancellation::isCanceled()) {
+        if (changed)
+            buildLookups();
+        return changed;
+    }
+
+    for (auto &job : jobs) {
+        if (!job.isReadable) {
+            changed |= m_files.erase(job.fileName) > 0;
+        } else if (!job.isParsed) {
+            auto &entry = m_files[job.fileName];
+            entry.size = job.entry.size;
+            entry.lastModified = job.entry.lastModified;
+            changed = true;
+        } else {
+            m_files[job.fileName] = std::move(job.entry);
+            changed = true;
+        }
+    }
+    spdlog::debug("IncludeIndex::update - {} files checked, {} files indexed", jobs.size(),
+                  std::ranges::count_if(jobs, &Job::isParsed));
+
+    buildLookups();
+    return changed;
+}
+
+void IncludeIndex::buildLookups()
+{
+    m_includes.clear();
+    m_includers.clear();
+
+    // Files by name, to resolve the includes without touching the file system
+    std::unordered_map<QString, QStringList> filesByName;
+    for (const auto &fileName : m_files | std::views::keys)
+        filesByName[QFileInfo(fileName).fileName()].push_back(fileName);
+
+    auto resolve = [&](const QString &fileName, const QString &include) -> QString {
+        if (include.size() < 3)
+            return {};
+        const QString path = QDir::cleanPath(include.sliced(1, include.size() - 2));
+        const QString directory = QFileInfo(fileName).absolutePath();
+        if (include.startsWith('"')) {
+            const QString localPath = QDir::cleanPath(directory + '/' + path);
+            if (m_files.contains(localPath))
+                return localPath;
+        }
+
+        const auto it = filesByName.find(QFileInfo(path).fileName());
+        if (it == filesByName.end())
+            return {};
+        const QString suffix = '/' + path;
+        QString result;
+        qsizetype bestPrefix = -1;
+        for (const auto &candidate : it->second) {
+            if (!candidate.endsWith(suffix))
+                continue;
+            const auto prefix = commonPrefixSize(candidate, directory);
+            if (prefix > bestPrefix || (prefix == bestPrefix && candidate < result)) {
+                result = candidate;
+                bestPrefix = prefix;
+            }
+        }
+        return result;
+    };
+
+    for (const auto &[fileName, entry] : m_files) {
+        QStringList includes;
+        for (const auto &include : entry.includes) {
+            const auto includedFile = resolve(fileName, include);
+            if (!includedFile.isEmpty() && includedFile != fileName && !includes.contains(includedFile))
+                includes.push_back(includedFile);
+        }
+        std::ranges::sort(includes);
+        for (const auto &includedFile : std::as_const(includes))
+            m_includers[includedFile].push_back(fileName);
+        if (!includes.isEmpty())
+            m_includes[fileName] = std::move(includes);
+    }
+    for (auto &includers : m_includers | std::views::values)
+        std::ranges::sort(includers);
+}
+
+QStringList IncludeIndex::includes(const QString &fileName) const
+{
+    const auto it = m_includes.find(fileName);
+    return it == m_includes.end() ? QStringList() : it->second;
+}
+
+QStringList IncludeIndex::includers(const QString &fileName, bool transitive) const
+{
+    if (!transitive) {
+        const auto it = m_includers.find(fileName);
+        return it == m_includers.end() ? QStringList() : it->second;
+    }
+
+    // Breadth-first walk of the reversed graph, include cycles are only visited once
+    QStringList result;
+    std::unordered_set<QString> visited = {fileName};
+    QStringList pending = {fileName};
+    while (!pending.isEmpty()) {
+        const auto it = m_includers.find(pending.takeFirst());
+        if (it == m_includers.end())
+            continue;
+        for (const auto &includer : it->second) {
+            if (visited.insert(includer).second) {
+                result.push_back(includer);
+                pending.push_back(includer);
+            }
+        }
+    }
+    std::ranges::sort(result);
+    return result;
+}
+
+int IncludeIndex::fileCount() const
+{
+    return static_cast<int>(m_files.size());
+}
+
+//=============================================================================
+// Serialization
+//=============================================================================
+// Increase IndexVersion when changing the data stored, or the includes query.
+static constexpr quint32 IndexMagic = 0x4b494e43; // KINC
+static constexpr quint32 IndexVersion = 1;
+
+QDataStream &operator<<(QDataStream &stream, const IncludeIndex::FileEntry &entry)
+{
+    return stream << entry.size << entry.lastModified << entry.hash << entry.includes;
+}
+
+QDataStream &operator>>(QDataStream &stream, IncludeIndex::FileEntry &entry)
+{
+    return stream >> entry.size >> entry.lastModified >> entry.hash >> entry.includes;
+}
+
+bool IncludeIndex::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != IndexMagic || version != IndexVersion)
+        return false;
+
+    quint32 count = 0;
+    stream >> count;
+    std::unordered_map<QString, FileEntry> files;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString entryFileName;
+        FileEntry entry;
+        stream >> entryFileName >> entry;
+        files[entryFileName] = std::move(entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        spdlog::warn("IncludeIndex::load - invalid index file {}", fileName);
+        return false;
+    }
+
+    m_files = std::move(files);
+    buildLookups();
+    return true;
+}
+
+bool IncludeIndex::save(const QString &fileName) const
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("IncludeIndex::save - can't write index file {}", fileName);
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << IndexMagic << IndexVersion << static_cast<quint32>(m_files.size());
+    for (const auto &[entryFileName, entry] : m_files)
+        stream << entryFileName << entry;
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        spdlog::warn("IncludeIndex::save - can't write index file {}", fileName);
+        return false;
+    }
+    return true;
+}
+
+} // namespace Core
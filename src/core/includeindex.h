@@ -0,0 +1,66 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <unordered_map>
+
+class QDataStream;
+
+namespace Core {
+
+// Index of the includes of a set of C++ files, forming the include graph of a project.
+// As for the SymbolIndex, files are parsed with Tree-sitter in parallel, only when their content changed, and the index
+// can be saved to and loaded from a binary file. Includes are resolved to the files of the index: `"..."` includes
+// relative to the including file first, then, as for `<...>` includes, to the files ending with the include path,
+// preferring the ones closest to the including file. Includes not found in the files (e.g. system headers) are ignored.
+class IncludeIndex
+{
+public:
+    IncludeIndex() = default;
+
+    // Updates the index to contain exactly `files`, parsing new and changed files in parallel.
+    // Returns true if the index has changed.
+    bool update(const QStringList &files);
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    // Returns the files included by `fileName`, sorted
+    QStringList includes(const QString &fileName) const;
+    // Returns the files including `fileName`, directly or, if `transitive` is true, indirectly, sorted
+    QStringList includers(const QString &fileName, bool transitive = false) const;
+
+    int fileCount() const;
+
+private:
+    struct FileEntry
+    {
+        qint64 size = 0;
+        qint64 lastModified = 0;
+        QByteArray hash;
+        // Includes as written, with their delimiters: `"foo.h"` or `<foo.h>`
+        QStringList includes;
+    };
+    friend QDataStream &operator<<(QDataStream &stream, const FileEntry &entry);
+    friend QDataStream &operator>>(QDataStream &stream, FileEntry &entry);
+
+    void buildLookups();
+
+    std::unordered_map<QString, FileEntry> m_files;
+    // Lookups, rebuilt each time the index changes
+    std::unordered_map<QString, QStringList> m_includes;
+    std::unordered_map<QString, QStringList> m_includers;
+};
+
+} // namespace Core
@@ -9,12 +9,515 @@
 */
 
 #include "jsondocument.h"
+#include "textdocument_p.h"
+#include "utils/log.h"
+
+#include <QHash>
+#include <QJSValue>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <vector>
 
 namespace Core {
 
+/*!
+ * \qmltype JsonDocument
+ * \brief Document object for a JSON file.
+ * \inqmlmodule Script
+ * \ingroup TextDocument
+ * \inherits TextDocument
+ *
+ * The values are read and changed with [JSON pointers](https://www.rfc-editor.org/rfc/rfc6901): `""` is the whole
+ * document, `"/name"` is the member `name` of the root object and `"/items/0"` the first element of its array `items`.
+ * In a member name, a `~` is written `~0` and a `/` is written `~1`.
+ *
+ * ```js
+ * let document = Project.open("package.json");
+ * let version = document.get("/version");
+ * document.set("/dependencies/knut", "^2.0");
+ * ```
+ *
+ * The position of each value is indexed once per change of the document, and `set` only replaces the text of the
+ * value changed: the rest of the document keeps its formatting, and there's no need to serialize it again.
+ */
+
+// Nesting of the values indexed, so that an invalid file can't overflow the stack
+static constexpr int MaxDepth = 512;
+
+namespace {
+
+struct JsonNode
+{
+    enum Kind { Object, Array, Scalar };
+    Kind kind = Scalar;
+    int start = 0;
+    int end = 0;
+    // Objects and arrays only: number of members or elements, and range of the last one, its key included
+    int childCount = 0;
+    int lastChildStart = -1;
+    int lastChildEnd = -1;
+};
+
+// Fills the values of a JSON text and their pointers, checking the syntax along the way
+class JsonIndexer
+{
+public:
+    JsonIndexer(QStringView text, std::vector<JsonNode> &nodes, QHash<QString, int> &nodeByPointer)
+        : m_text(text)
+        , m_nodes(nodes)
+        , m_nodeByPointer(nodeByPointer)
+    {
+    }
+
+    // Returns the position of the first syntax error, or -1 if the text is valid
+    int run()
+    {
+        skipSpaces();
+        if (!parseValue({}, 0))
+            return m_pos;
+        skipSpaces();
+        return m_pos == m_text.size() ? -1 : m_pos;
+    }
+
+private:
+    bool peek(char16_t c) const { return m_pos < m_text.size() && m_text[m_pos] == c; }
+    bool accept(char16_t c)
+    {
+        if (!peek(c))
+            return false;
+        ++m_pos;
+        return true;
+    }
+    bool acceptDigits()
+    {
+        const int start = m_pos;
+        while (m_pos < m_text.size() && m_text[m_pos].isDigit())
+            ++m_pos;
+        return m_pos > start;
+    }
+    void skipSpaces()
+    {
+        while (m_pos < m_text.size()
+               && (m_text[m_pos] == u' ' || m_text[m_pos] == u'\n' || m_text[m_pos] == u'\t' || m_text[m_pos] == u'\r'))
+            ++m_pos;
+    }
+
+    bool parseValue(const QString &pointer, int depth);
+    bool parseObject(int node, const QString &pointer, int depth);
+    bool parseArray(int node, const QString &pointer, int depth);
+    bool parseString(QString *decoded);
+    bool parseLiteral();
+
+    QStringView m_text;
+    std::vector<JsonNode> &m_nodes;
+    QHash<QString, int> &m_nodeByPointer;
+    int m_pos = 0;
+};
+
+} // namespace
+
+struct JsonDocument::Index
+{
+    int revision = -1;
+    // Position of the first syntax error, or -1 if the text is valid
+    int errorPosition = -1;
+    std::vector<JsonNode> nodes;
+    // Index in nodes of each value, by escaped pointer
+    QHash<QString, int> nodeByPointer;
+
+    // Moves the positions from `position` by `delta`, after a change of the text
+    void shift(int position, int delta)
+    {
+        auto move = [&](int &offset) {
+            if (offset >= position)
+                offset += delta;
+        };
+        for (auto &node : nodes) {
+            move(node.start);
+            move(node.end);
+            if (node.lastChildStart != -1) {
+                move(node.lastChildStart);
+                move(node.lastChildEnd);
+            }
+        }
+    }
+};
+
+static QString escapeToken(QString token)
+{
+    return token.replace(u'~', QStringLiteral("~0")).replace(u'/', QStringLiteral("~1"));
+}
+
+static QString unescapeToken(QString token)
+{
+    return token.replace(QStringLiteral("~1"), QStringLiteral("/")).replace(QStringLiteral("~0"), QStringLiteral("~"));
+}
+
+// Decodes the content of a JSON string, already checked by the indexer
+static QString unescapeString(QStringView text)
+{
+    QString result;
+    result.reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        if (text[i] != u'\\' || i + 1 == text.size()) {
+            result += text[i];
+            continue;
+        }
+        const QChar c = text[++i];
+        switch (c.unicode()) {
+        case 'b':
+            result += u'\b';
+            break;
+        case 'f':
+            result += u'\f';
+            break;
+        case 'n':
+            result += u'\n';
+            break;
+        case 'r':
+            result += u'\r';
+            break;
+        case 't':
+            result += u'\t';
+            break;
+        case 'u':
+            if (i + 4 < text.size()) {
+                result += QChar(text.sliced(i + 1, 4).toUShort(nullptr, 16));
+                i += 4;
+            }
+            break;
+        default:
+            result += c;
+        }
+    }
+    return result;
+}
+
+bool JsonIndexer::parseValue(const QString &pointer, int depth)
+{
+    if (m_pos == m_text.size() || depth > MaxDepth)
+        return false;
+
+    const int node = static_cast<int>(m_nodes.size());
+    m_nodes.push_back({.start = m_pos});
+    m_nodeByPointer.insert(pointer, node);
+    bool isValid = false;
+    if (peek(u'{'))
+        isValid = parseObject(node, pointer, depth);
+    else if (peek(u'['))
+        isValid = parseArray(node, pointer, depth);
+    else if (peek(u'"'))
+        isValid = parseString(nullptr);
+    else
+        isValid = parseLiteral();
+    m_nodes[node].end = m_pos;
+    return isValid;
+}
+
+bool JsonIndexer::parseObject(int node, const QString &pointer, int depth)
+{
+    m_nodes[node].kind = JsonNode::Object;
+    ++m_pos;
+    skipSpaces();
+    if (accept(u'}'))
+        return true;
+
+    for (;;) {
+        const int memberStart = m_pos;
+        QString key;
+        if (!peek(u'"') || !parseString(&key))
+            return false;
+        skipSpaces();
+        if (!accept(u':'))
+            return false;
+        skipSpaces();
+        if (!parseValue(pointer + u'/' + escapeToken(std::move(key)), depth + 1))
+            return false;
+
+        auto &object = m_nodes[node];
+        ++object.childCount;
+        object.lastChildStart = memberStart;
+        object.lastChildEnd = m_pos;
+        skipSpaces();
+        if (accept(u'}'))
+            return true;
+        if (!accept(u','))
+            return false;
+        skipSpaces();
+    }
+}
+
+bool JsonIndexer::parseArray(int node, const QString &pointer, int depth)
+{
+    m_nodes[node].kind = JsonNode::Array;
+    ++m_pos;
+    skipSpaces();
+    if (accept(u']'))
+        return true;
+
+    for (;;) {
+        const int elementStart = m_pos;
+        if (!parseValue(pointer + u'/' + QString::number(m_nodes[node].childCount), depth + 1))
+            return false;
+
+        auto &array = m_nodes[node];
+        ++array.childCount;
+        array.lastChildStart = elementStart;
+        array.lastChildEnd = m_pos;
+        skipSpaces();
+        if (accept(u']'))
+            return true;
+        if (!accept(u','))
+            return false;
+        skipSpaces();
+    }
+}
+
+bool JsonIndexer::parseString(QString *decoded)
+{
+    ++m_pos;
+    const int start = m_pos;
+    bool hasEscape = false;
+    while (m_pos < m_text.size()) {
+        const QChar c = m_text[m_pos];
+        if (c == u'"') {
+            if (decoded) {
+                const auto content = m_text.sliced(start, m_pos - start);
+                *decoded = hasEscape ? unescapeString(content) : content.toString();
+            }
+            ++m_pos;
+            return true;
+        }
+        if (c == u'\\') {
+            if (m_pos + 1 == m_text.size() || !QStringView(u"\"\\/bfnrtu").contains(m_text[m_pos + 1]))
+                return false;
+            hasEscape = true;
+            m_pos += 2;
+            continue;
+        }
+        if (c.unicode() < 0x20)
+            return false;
+        ++m_pos;
+    }
+    return false;
+}
+
+bool JsonIndexer::parseLiteral()
+{
+    static constexpr QStringView Literals[] = {u"true", u"false", u"null"};
+    for (const auto literal : Literals) {
+        if (m_text.sliced(m_pos).startsWith(literal)) {
+            m_pos += static_cast<int>(literal.size());
+            return true;
+        }
+    }
+
+    accept(u'-');
+    if (!acceptDigits())
+        return false;
+    if (accept(u'.') && !acceptDigits())
+        return false;
+    if (accept(u'e') || accept(u'E')) {
+        if (!accept(u'+'))
+            accept(u'-');
+        return acceptDigits();
+    }
+    return true;
+}
+
+// Returns the compact JSON text of a value, or an empty string if it can't be converted
+static QString toJsonText(const QVariant &value)
+{
+    const auto jsonValue = value.metaType() == QMetaType::fromType<QJSValue>()
+        ? QJsonValue::fromVariant(value.value<QJSValue>().toVariant())
+        : QJsonValue::fromVariant(value);
+    if (jsonValue.isUndefined())
+        return {};
+    // Wrapped in an array, as QJsonDocument only writes objects and arrays
+    const QByteArray json = QJsonDocument(QJsonArray {jsonValue}).toJson(QJsonDocument::Compact);
+    return QString::fromUtf8(json.sliced(1, json.size() - 2));
+}
+
 JsonDocument::JsonDocument(QObject *parent)
     : TextDocument(Type::Json, parent)
+    , m_index(std::make_unique<Index>())
+{
+}
+
+JsonDocument::~JsonDocument() = default;
+
+// A new value that is an object or an array has values of its own, only a whole new index has them
+static bool isScalarText(QStringView valueText)
+{
+    return !valueText.startsWith(u'{') && !valueText.startsWith(u'[');
+}
+
+const JsonDocument::Index &JsonDocument::index() const
+{
+    if (m_index->revision != textRevision()) {
+        const QString text = plainText();
+        m_index->nodes.clear();
+        m_index->nodeByPointer.clear();
+        m_index->errorPosition = JsonIndexer(text, m_index->nodes, m_index->nodeByPointer).run();
+        m_index->revision = textRevision();
+    }
+    return *m_index;
+}
+
+/*!
+ * \qmlmethod var JsonDocument::get(string pointer)
+ * Returns the value at the JSON `pointer`, or `undefined` if there's none.
+ *
+ * Objects and arrays are returned as JavaScript objects and arrays.
+ */
+QVariant JsonDocument::get(const QString &pointer) const
+{
+    LOG("JsonDocument::get", pointer);
+
+    const auto &index = this->index();
+    if (index.errorPosition != -1) {
+        spdlog::error("JsonDocument::get - invalid JSON in {} at position {}", fileName(), index.errorPosition);
+        return {};
+    }
+    const auto it = index.nodeByPointer.constFind(pointer);
+    if (it == index.nodeByPointer.cend()) {
+        spdlog::error("JsonDocument::get - no value at {}", pointer);
+        return {};
+    }
+
+    const auto &node = index.nodes[*it];
+    const QString text = plainText();
+    QString json;
+    json.reserve(node.end - node.start + 2);
+    json += u'[';
+    json += QStringView(text).sliced(node.start, node.end - node.start);
+    json += u']';
+    QJsonParseError error;
+    const auto document = QJsonDocument::fromJson(json.toUtf8(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        spdlog::error("JsonDocument::get - invalid value at {}: {}", pointer, error.errorString());
+        return {};
+    }
+    return document.array().at(0).toVariant();
+}
+
+/*!
+ * \qmlmethod bool JsonDocument::set(string pointer, var value)
+ * Sets the `value` at the JSON `pointer`, and returns true if it's done.
+ *
+ * An existing value is replaced. Otherwise, the value is added to the object or the array at the parent of `pointer`:
+ * the last token is the new member name of an object, or `-` (or the size of the array) to add an element at the end
+ * of an array. The new member is written after the last one, on its own line with the same indentation if the members
+ * are on separate lines.
+ *
+ * Only the text of the value is changed, written in compact form, the rest of the document is kept as is.
+ */
+bool JsonDocument::set(const QString &pointer, const QVariant &value)
 {
+    LOG("JsonDocument::set", pointer, value);
+
+    const QString valueText = toJsonText(value);
+    if (valueText.isEmpty()) {
+        spdlog::error("JsonDocument::set - can't convert the value at {} to JSON", pointer);
+        return false;
+    }
+    const auto &index = this->index();
+    if (index.errorPosition != -1) {
+        spdlog::error("JsonDocument::set - invalid JSON in {} at position {}", fileName(), index.errorPosition);
+        return false;
+    }
+
+    const auto it = index.nodeByPointer.constFind(pointer);
+    if (it == index.nodeByPointer.cend())
+        return insert(pointer, valueText);
+    const auto &node = index.nodes[*it];
+    if (QStringView(plainText()).sliced(node.start, node.end - node.start) != valueText) {
+        const bool keepIndex = node.kind == JsonNode::Scalar && isScalarText(valueText);
+        replaceText({.start = node.start, .end = node.end, .text = valueText}, keepIndex);
+    }
+    return true;
+}
+
+// Applies the replacement, and moves the values after it in the index instead of indexing the whole text again on
+// the next call: setting many values only costs one pass over the values each. Returns true if the index is kept.
+bool JsonDocument::replaceText(const TextReplacement &replacement, bool keepIndex)
+{
+    const int revision = textRevision();
+    // An insertion moves what comes after it, not the value ending where it's inserted
+    const int position = replacement.start == replacement.end ? replacement.end + 1 : replacement.end;
+    const int delta = static_cast<int>(replacement.text.size()) - (replacement.end - replacement.start);
+    applyReplacements({replacement}, false);
+
+    // Only kept for this change alone, not if other changes are pending or the index was already out of date
+    if (!keepIndex || m_index->revision != revision || textRevision() != revision + 1)
+        return false;
+    m_index->shift(position, delta);
+    m_index->revision = textRevision();
+    return true;
+}
+
+// Adds the value as a new member of an object, or a new element of an array, if the parent of the pointer exists
+bool JsonDocument::insert(const QString &pointer, const QString &valueText)
+{
+    const auto &index = this->index();
+    const auto slash = pointer.lastIndexOf(u'/');
+    const auto parent = slash == -1 ? index.nodeByPointer.cend() : index.nodeByPointer.constFind(pointer.first(slash));
+    if (parent == index.nodeByPointer.cend()) {
+        spdlog::error("JsonDocument::set - no value at {}", pointer);
+        return false;
+    }
+
+    const int nodeIndex = *parent;
+    const auto &node = index.nodes[nodeIndex];
+    const QString token = pointer.sliced(slash + 1);
+    QString newText;
+    if (node.kind == JsonNode::Object)
+        newText = toJsonText(unescapeToken(token)) + QStringLiteral(": ") + valueText;
+    else if (node.kind == JsonNode::Array && (token == u"-" || token == QString::number(node.childCount)))
+        newText = valueText;
+    if (newText.isEmpty()) {
+        spdlog::error("JsonDocument::set - can't add a value at {}", pointer);
+        return false;
+    }
+
+    // The new value is added to the index, after the last member or element of its parent
+    const QString childPointer = node.kind == JsonNode::Array
+        ? pointer.first(slash + 1) + QString::number(node.childCount)
+        : pointer;
+    auto addChild = [&](int childStart, int childEnd) {
+        auto &parentNode = m_index->nodes[nodeIndex];
+        ++parentNode.childCount;
+        parentNode.lastChildStart = childStart;
+        parentNode.lastChildEnd = childEnd;
+        m_index->nodeByPointer.insert(childPointer, static_cast<int>(m_index->nodes.size()));
+        m_index->nodes.push_back({.start = childEnd - static_cast<int>(valueText.size()), .end = childEnd});
+    };
+    const bool keepIndex = isScalarText(valueText);
+
+    // Replaces the spaces between the brackets of an empty object or array
+    if (node.childCount == 0) {
+        const int childStart = node.start + 1;
+        if (replaceText({.start = node.start + 1, .end = node.end - 1, .text = newText}, keepIndex))
+            addChild(childStart, childStart + static_cast<int>(newText.size()));
+        return true;
+    }
+
+    // Written after the last child, on a new line with its indentation if it doesn't start on the bracket line
+    const QString text = plainText();
+    const int lineStart = static_cast<int>(text.lastIndexOf(u'\n', node.lastChildStart)) + 1;
+    QString separator = QStringLiteral(", ");
+    if (lineStart > node.start) {
+        int indentEnd = lineStart;
+        while (indentEnd < node.lastChildStart && (text[indentEnd] == u' ' || text[indentEnd] == u'\t'))
+            ++indentEnd;
+        separator = QStringLiteral(",\n");
+        separator += QStringView(text).sliced(lineStart, indentEnd - lineStart);
+    }
+    const int insertPosition = node.lastChildEnd;
+    const int childStart = insertPosition + static_cast<int>(separator.size());
+    if (replaceText({.start = insertPosition, .end = insertPosition, .text = separator + newText}, keepIndex))
+        addChild(childStart, childStart + static_cast<int>(newText.size()));
+    return true;
 }
 
 } // namespace Core
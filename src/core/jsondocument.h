@@ -12,6 +12,9 @@
 
 #include "textdocument.h"
 
+#include <QVariant>
+#include <memory>
+
 namespace Core {
 
 class JsonDocument : public TextDocument
@@ -20,6 +23,21 @@ class JsonDocument : public TextDocument
 
 public:
     explicit JsonDocument(QObject *parent = nullptr);
+    ~JsonDocument() override;
+
+    Q_INVOKABLE QVariant get(const QString &pointer) const;
+
+public slots:
+    bool set(const QString &pointer, const QVariant &value);
+
+private:
+    struct Index;
+    // Returns the index of the values in the text, built again after each change of the document
+    const Index &index() const;
+    bool insert(const QString &pointer, const QString &valueText);
+    bool replaceText(const TextReplacement &replacement, bool keepIndex);
+
+    mutable std::unique_ptr<Index> m_index;
 };
 
 }
@@ -9,18 +9,43 @@
 */
 
 #include "knutcore.h"
+#include "batchrunner.h"
+#include "benchrunner.h"
+#include "builtinqueries.h"
+#include "dryrun.h"
+#include "lsp/broker.h"
+#include "lsp/requestprofiler.h"
 #include "project.h"
 #include "scriptmanager.h"
+#include "scriptprofiler.h"
+#include "scriptrunner.h"
+#include "startuptrace.h"
+#include "testrunner.h"
 #include "textdocument.h"
+#include "treesitter/query.h"
+#include "utils.h"
+#include "utils/allocstats.h"
+#include "utils/taskscheduler.h"
 
 #include <QAbstractItemModel>
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
 #include <QTimer>
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <nlohmann/json.hpp>
+#include <spdlog/async.h>
 #include <spdlog/cfg/env.h>
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/sinks/base_sink.h>
 #include <spdlog/sinks/rotating_file_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 
 using json = nlohmann::json;
 
@@ -44,12 +69,72 @@ KnutCore::KnutCore(InternalTag, QObject *parent)
     spdlog::cfg::load_env_levels();
 }
 
+// The -j option takes precedence over the settings, which may come from the project
+static void initializeThreadCount(const QCommandLineParser &parser)
+{
+    bool ok = false;
+    int count = parser.value("jobs").toInt(&ok);
+    if (!ok)
+        count = Settings::instance()->value<int>(Settings::ThreadCount);
+    ::Utils::TaskScheduler::setThreadCount(count);
+}
+
 void KnutCore::process(const QStringList &arguments)
 {
     // Parse command line options
     QCommandLineParser parser;
     initParser(parser);
     parser.process(arguments);
+    if (parser.isSet("startup-trace"))
+        StartupTrace::instance().start();
+
+    // Internal mode, used to share a LSP server between knut processes
+    if (parser.isSet("lsp-broker")) {
+        runLspBroker(parser);
+        return;
+    }
+
+    // The records of Utils.emitRecord are the only output on stdout, the logs go to stderr
+    if (parser.isSet("output")) {
+        if (parser.value("output") != "ndjson") {
+            spdlog::error("KnutCore::process - unknown output format {}, only ndjson is supported",
+                          parser.value("output"));
+            exit(1);
+        }
+        spdlog::default_logger()->sinks() = {std::make_shared<spdlog::sinks::stderr_color_sink_mt>()};
+        Utils::setNdjsonOutput(true);
+    }
+
+    // The documents saved by the script are not written, their changes are written as one patch on exit
+    if (parser.isSet("diff") && !parser.isSet("dry-run")) {
+        spdlog::error("KnutCore::process - the --diff option needs --dry-run");
+        exit(1);
+    }
+    if (parser.isSet("dry-run")) {
+        if (!parser.isSet("run") || parser.isSet("transform") || parser.isSet("bench")) {
+            spdlog::error("KnutCore::process - the --dry-run option needs a script to run with --run");
+            exit(1);
+        }
+        const QString patchFileName = parser.value("diff");
+        // The standard output only has the records with --output, or the outputs of all the runs with --files
+        if (patchFileName.isEmpty() && (parser.isSet("output") || parser.isSet("files"))) {
+            spdlog::error("KnutCore::process - the --dry-run option needs a --diff file with --output or --files");
+            exit(1);
+        }
+    }
+    if (parser.isSet("dry-run") && !parser.isSet("files")) {
+        const QString patchFileName = parser.value("diff");
+        DryRun::setEnabled(true);
+        connect(qApp, &QCoreApplication::aboutToQuit, this, [patchFileName]() {
+            const QString rootPath = Project::instance() ? Project::instance()->root() : QString();
+            if (patchFileName.isEmpty()) {
+                const QByteArray patch = DryRun::patch(rootPath);
+                std::cout << std::string_view(patch.constData(), patch.size()) << std::flush;
+            } else {
+                DryRun::writePatch(patchFileName, rootPath);
+            }
+        });
+    }
 
     const bool jsonList = parser.isSet("json-list");
     if (jsonList) {
@@ -78,6 +163,86 @@ void KnutCore::process(const QStringList &arguments)
         exit(0);
     }
 
+    // The report is printed on the error output, so it doesn't mix with the script output
+    if (parser.isSet("profile-queries") && !parser.isSet("files")) {
+        treesitter::QueryProfiler::instance().setEnabled(true);
+        connect(qApp, &QCoreApplication::aboutToQuit, this, []() {
+            std::cerr << treesitter::QueryProfiler::instance().report().toStdString();
+        });
+    }
+    if (parser.isSet("lsp-stats") && !parser.isSet("files")) {
+        connect(qApp, &QCoreApplication::aboutToQuit, this, []() {
+            std::cerr << Lsp::RequestProfiler::instance().report().toStdString();
+        });
+    }
+    if (parser.isSet("memory-report") && !parser.isSet("files")) {
+        connect(qApp, &QCoreApplication::aboutToQuit, this, []() {
+            if (Project::instance())
+                std::cerr << Project::instance()->memoryReportText().toStdString();
+        });
+    }
+    if (parser.isSet("alloc-stats") && !parser.isSet("files")) {
+        connect(qApp, &QCoreApplication::aboutToQuit, this, []() {
+            std::cerr << ::Utils::AllocStats::report().toStdString();
+        });
+    }
+    if (parser.isSet("stats") && !parser.isSet("files")) {
+        connect(qApp, &QCoreApplication::aboutToQuit, this, []() {
+            if (Project::instance())
+                std::cerr << Project::instance()->statsText().toStdString();
+        });
+    }
+    if (parser.isSet("profile") && !parser.isSet("files")) {
+        Core::ScriptProfiler::instance().start();
+        connect(qApp, &QCoreApplication::aboutToQuit, this, [fileName = parser.value("profile")]() {
+            if (!Core::ScriptProfiler::instance().save(fileName))
+                spdlog::error("KnutCore::process - can't write the profile report to {}", fileName);
+        });
+    }
+
+    // Run the script several times, each run in its own knut process
+    if (parser.isSet("bench")) {
+        runBench(parser);
+        return;
+    }
+
+    // Transform the files with a tree-sitter query, in this process and without any script
+    if (parser.isSet("transform")) {
+        runTransform(parser);
+        return;
+    }
+
+    // Compile the scripts of a directory, so their first runs don't have to
+    if (parser.isSet("compile-scripts")) {
+        runCompileScripts(parser);
+        return;
+    }
+
+    // Run all the tests of a directory, each one in its own knut process
+    if (parser.isSet("test") && QFileInfo(parser.value("test")).isDir()) {
+        runTests(parser);
+        return;
+    }
+    if (parser.isSet("junit")) {
+        spdlog::error("KnutCore::process - the --junit option needs a directory of tests with --test");
+        exit(1);
+    }
+
+    if (parser.isSet("shard") && !parser.isSet("files")) {
+        spdlog::error("KnutCore::process - the --shard option needs a list of files with --files");
+        exit(1);
+    }
+
+    // Run the script on all the files, each one in its own knut process
+    if (parser.isSet("files")) {
+        if (!parser.isSet("run")) {
+            spdlog::error("KnutCore::process - the --files option needs a script to run with --run");
+            exit(1);
+        }
+        runBatch(parser);
+        return;
+    }
+
     Settings::Mode mode;
     if (parser.isSet("test"))
         mode = Settings::Mode::Test;
@@ -85,8 +250,14 @@ void KnutCore::process(const QStringList &arguments)
         mode = Settings::Mode::Cli;
     else
         mode = Settings::Mode::Gui;
+    if (mode == Settings::Mode::Gui && !Settings::hasWidgets()) {
+        spdlog::error("KnutCore::process - there's no user interface, run a script with --run or --test");
+        exit(1);
+    }
 
     initialize(mode);
+    if (StartupTrace::instance().isEnabled())
+        finishStartupTrace();
 
     const QStringList positionalArguments = parser.positionalArguments();
     // Set the root directory
@@ -95,11 +266,13 @@ void KnutCore::process(const QStringList &arguments)
         const QDir pathDir(rootDir);
         if (pathDir.exists()) {
             Project::instance()->setRoot(rootDir);
+            StartupTrace::instance().mark("Open project");
         } else {
             spdlog::error("KnutCore::process - Root directory: {}, does not exist. Cannot open a new project!",
                           pathDir.absolutePath());
         }
     }
+    initializeThreadCount(parser);
 
     // Open document on startup
     const QString fileName = parser.value("input");
@@ -117,6 +290,7 @@ void KnutCore::process(const QStringList &arguments)
                 tDoc->gotoLine(nLine, nColumn);
             }
         }
+        StartupTrace::instance().mark("Open input document");
     }
 
     // Run the script passed in parameter, if any
@@ -127,12 +301,21 @@ void KnutCore::process(const QStringList &arguments)
     }
 
     if (!scriptName.isEmpty()) {
-        QTimer::singleShot(0, this, [scriptName]() {
+        // Internal mode, used by --bench: the script and API times are written to the report file
+        const QString benchReport = parser.value("bench-report");
+        auto timer = std::make_shared<QElapsedTimer>();
+        if (!benchReport.isEmpty())
+            Core::ScriptProfiler::instance().start();
+
+        QTimer::singleShot(0, this, [scriptName, timer]() {
+            timer->start();
             ScriptManager::instance()->runScript(scriptName);
         });
         connect(
             ScriptManager::instance(), &ScriptManager::scriptFinished, qApp,
-            [](const QVariant &value) {
+            [benchReport, timer](const QVariant &value) {
+                if (!benchReport.isEmpty())
+                    writeBenchReport(benchReport, timer->nsecsElapsed());
                 qApp->exit(value.toInt());
             },
             Qt::QueuedConnection);
@@ -150,12 +333,250 @@ void KnutCore::initParser(QCommandLineParser &parser) const
     parser.addVersionOption();
 
     parser.addOptions({{{"r", "run"}, "Runs given script <file> then exit.", "file"},
-                       {{"t", "test"}, "Tests given script <file> then exit.", "file"},
+                       {{"t", "test"}, "Tests given script <file>, or the tests of a directory, then exit.", "file"},
                        {{"i", "input"}, "Opens document <file> on startup.", "file"},
                        {{"l", "line"}, "Line in the current file, if any.", "line"},
                        {{"c", "column"}, "Column in the current file, if any.", "column"},
+                       {"files", "Runs the script on each file of <files>, @<file> reads them from a file.", "files"},
+                       {{"j", "jobs"},
+                        "Number of scripts running in parallel with --files or --test <dir>, number of worker threads "
+                        "otherwise.",
+                        "jobs"},
+                       {"junit", "Writes the results of --test <dir> to <file> as a JUnit report.", "file"},
+                       {"transform", "Runs the tree-sitter transformation <file> on --files or the project.", "file"},
+                       {"target", "Text replacing the @from captures with --transform.", "target"},
+                       {"output", "Writes the records of the script to stdout as <format>, only ndjson.", "format"},
+                       {"dry-run", "Doesn't write the documents saved by the script, prints their changes as a patch."},
+                       {"diff", "Writes the patch of --dry-run to <file> instead of stdout.", "file"},
+                       {"shard", "Only runs the files of the shard <index>/<count> with --files.", "shard"},
+                       {"retries", "Number of times a crashed run is started again with --files.", "count", "0"},
+                       {"profile-queries", "Prints statistics about the tree-sitter queries run, on exit."},
+                       {"lsp-stats", "Prints statistics about the LSP requests sent, on exit."},
+                       {"memory-report", "Prints the memory used by the documents, LSP clients and history, on exit."},
+                       {"stats", "Prints the counters of parses, queries, marks, documents and LSP requests, on exit."},
+                       {"alloc-stats", "Prints the allocations of each traced region on exit, needs KNUT_ALLOC_STATS."},
+                       {"profile", "Profiles the script API calls, and writes a trace event report to <file> on exit.",
+                        "file"},
+                       {"bench", "Runs the script <file> several times, and prints its timings.", "file"},
+                       {"repeat", "Number of runs counted with --bench.", "count", "10"},
+                       {"warmup", "Number of runs done before the counted ones with --bench.", "count", "1"},
+                       {"baseline", "Fails if the --bench median time is slower than the one in <file>.", "file"},
+                       {"save-baseline", "Writes the --bench timings to <file>.", "file"},
+                       {"compile-scripts", "Compiles the scripts of <dir> in the script cache, then exit.", "dir"},
+                       {"startup-trace", "Prints the time spent in each phase of the startup."},
                        {"json-list", "Returns the list of all available scripts as a JSON file"},
                        {"json-settings", "Returns the settings as a JSON file"}});
+
+    // Internal options, used when knut starts a LSP broker: knut --lsp-broker <name> -- <program> <arguments>
+    QCommandLineOption brokerOption("lsp-broker", "Shares a LSP server with other knut processes.", "name");
+    brokerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    QCommandLineOption idleTimeoutOption("lsp-idle-timeout", "Stops the LSP broker when unused for <seconds>.",
+                                         "seconds", "600");
+    idleTimeoutOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({brokerOption, idleTimeoutOption});
+
+    // Internal option, used by each run of --bench
+    QCommandLineOption benchReportOption("bench-report", "Writes the script timings to <file> on exit.", "file");
+    benchReportOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOption(benchReportOption);
+}
+
+void KnutCore::runLspBroker(const QCommandLineParser &parser)
+{
+    const QStringList command = parser.positionalArguments();
+    if (command.isEmpty()) {
+        spdlog::error("KnutCore::runLspBroker - no LSP server to run");
+        exit(1);
+    }
+
+    auto broker = new Lsp::Broker(parser.value("lsp-broker"), command.first(), command.mid(1),
+                                  parser.value("lsp-idle-timeout").toInt(), this);
+    // Another broker may already be running for the same server
+    if (!broker->start())
+        exit(0);
+    connect(
+        broker, &Lsp::Broker::finished, qApp,
+        []() {
+            qApp->exit(0);
+        },
+        Qt::QueuedConnection);
+}
+
+void KnutCore::runBatch(const QCommandLineParser &parser)
+{
+    QStringList arguments {"--run", QFileInfo(parser.value("run")).absoluteFilePath()};
+    // Each process prints the profile of its own file
+    if (parser.isSet("profile-queries"))
+        arguments.append("--profile-queries");
+    if (parser.isSet("lsp-stats"))
+        arguments.append("--lsp-stats");
+    if (parser.isSet("memory-report"))
+        arguments.append("--memory-report");
+    if (parser.isSet("stats"))
+        arguments.append("--stats");
+    if (parser.isSet("alloc-stats"))
+        arguments.append("--alloc-stats");
+    if (parser.isSet("output"))
+        arguments.append({"--output", parser.value("output")});
+    arguments.append(parser.positionalArguments());
+
+    bool ok = false;
+    int jobs = parser.value("jobs").toInt(&ok);
+    if (!ok || jobs <= 0)
+        jobs = QThread::idealThreadCount();
+
+    // One shard of the files, the other ones are run by the same command on other machines
+    QStringList files = BatchRunner::readFileList(parser.values("files"));
+    if (parser.isSet("shard")) {
+        const auto shard = parser.value("shard").split('/');
+        bool indexOk = false;
+        bool countOk = false;
+        const int index = shard.size() == 2 ? shard.first().toInt(&indexOk) : 0;
+        const int count = shard.size() == 2 ? shard.last().toInt(&countOk) : 0;
+        if (!indexOk || !countOk || count <= 0 || index <= 0 || index > count) {
+            spdlog::error("KnutCore::runBatch - invalid shard {}, expected <index>/<count>", parser.value("shard"));
+            exit(1);
+        }
+        files = BatchRunner::shardFiles(files, index - 1, count);
+    }
+
+    auto runner = new BatchRunner(arguments, files, jobs, this);
+    runner->setNdjsonOutput(parser.isSet("output"));
+    if (parser.isSet("dry-run"))
+        runner->setPatchFile(parser.value("diff"));
+    runner->setRetries(parser.value("retries").toInt());
+    connect(
+        runner, &BatchRunner::finished, qApp,
+        [](int exitCode) {
+            qApp->exit(exitCode);
+        },
+        Qt::QueuedConnection);
+    QTimer::singleShot(0, runner, &BatchRunner::start);
+}
+
+void KnutCore::runTransform(const QCommandLineParser &parser)
+{
+    initialize(Settings::Mode::Cli);
+
+    const QStringList positionalArguments = parser.positionalArguments();
+    if (!parser.isSet("files") && positionalArguments.isEmpty()) {
+        spdlog::error("KnutCore::runTransform - the --transform option needs --files or a project");
+        exit(1);
+    }
+    if (!parser.isSet("target")) {
+        spdlog::error("KnutCore::runTransform - the --transform option needs a --target");
+        exit(1);
+    }
+    QFile queryFile(parser.value("transform"));
+    if (!queryFile.open(QIODevice::ReadOnly)) {
+        spdlog::error("KnutCore::runTransform - can't read the query file {}", queryFile.fileName());
+        exit(1);
+    }
+    if (!positionalArguments.isEmpty())
+        Project::instance()->setRoot(positionalArguments.first());
+    initializeThreadCount(parser);
+
+    const QStringList files = parser.isSet("files") ? BatchRunner::readFileList(parser.values("files"))
+                                                    : Project::instance()->allFiles(Project::FullPath);
+    QStringList failedFiles;
+    const auto result = Project::instance()->transformFiles(files, QString::fromUtf8(queryFile.readAll()),
+                                                            parser.value("target"), &failedFiles);
+    if (!result)
+        exit(1);
+
+    int replacements = 0;
+    for (auto it = result->cbegin(); it != result->cend(); ++it) {
+        std::cout << it.key().toStdString() << ": " << it.value().toInt() << " replacements\n";
+        replacements += it.value().toInt();
+    }
+    std::cout << replacements << " replacements in " << result->size() << " files";
+    if (!failedFiles.isEmpty())
+        std::cout << ", " << failedFiles.size() << " files failed";
+    std::cout << "\n";
+    exit(failedFiles.isEmpty() ? 0 : 1);
+}
+
+void KnutCore::runTests(const QCommandLineParser &parser)
+{
+    bool ok = false;
+    int jobs = parser.value("jobs").toInt(&ok);
+    if (!ok || jobs <= 0)
+        jobs = QThread::idealThreadCount();
+
+    auto runner = new TestRunner(parser.value("test"), jobs, this);
+    runner->setJUnitFile(parser.value("junit"));
+    connect(
+        runner, &TestRunner::finished, qApp,
+        [](int exitCode) {
+            qApp->exit(exitCode);
+        },
+        Qt::QueuedConnection);
+    QTimer::singleShot(0, runner, &TestRunner::start);
+}
+
+void KnutCore::runBench(const QCommandLineParser &parser)
+{
+    BenchRunner::Options options;
+    options.script = parser.value("bench");
+    if (!parser.positionalArguments().isEmpty())
+        options.project = parser.positionalArguments().first();
+    options.repeat = std::max(parser.value("repeat").toInt(), 1);
+    options.warmup = std::max(parser.value("warmup").toInt(), 0);
+    options.baseline = parser.value("baseline");
+    options.saveBaseline = parser.value("save-baseline");
+
+    auto runner = new BenchRunner(options, this);
+    connect(
+        runner, &BenchRunner::finished, qApp,
+        [](int exitCode) {
+            qApp->exit(exitCode);
+        },
+        Qt::QueuedConnection);
+    QTimer::singleShot(0, runner, &BenchRunner::start);
+}
+
+void KnutCore::runCompileScripts(const QCommandLineParser &parser)
+{
+    initialize(Settings::Mode::Cli);
+
+    const QDir dir(parser.value("compile-scripts"));
+    if (!dir.exists()) {
+        spdlog::error("KnutCore::runCompileScripts - the directory {} doesn't exist", dir.path());
+        exit(1);
+    }
+
+    QStringList scripts;
+    QDirIterator it(dir.absolutePath(), {"*.js", "*.qml"}, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        scripts.push_back(it.next());
+    scripts.sort();
+
+    auto runner = ScriptManager::instance()->m_runner;
+    int failed = 0;
+    for (const auto &script : std::as_const(scripts)) {
+        if (runner->compileScript(script))
+            continue;
+        ++failed;
+        std::cout << dir.relativeFilePath(script).toStdString() << ": failed\n";
+        for (const auto &error : runner->errors())
+            spdlog::error("{}({}): {}", error.url().toLocalFile(), error.line(), error.description());
+    }
+    std::cout << scripts.size() - failed << " scripts compiled";
+    if (failed > 0)
+        std::cout << ", " << failed << " scripts failed";
+    std::cout << "\n";
+    exit(failed == 0 ? 0 : 1);
+}
+
+void KnutCore::writeBenchReport(const QString &fileName, qint64 scriptTime)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        spdlog::error("KnutCore::writeBenchReport - can't write the bench report to {}", fileName);
+        return;
+    }
+    const json report = {{"scriptTime", scriptTime}, {"apiTime", Core::ScriptProfiler::instance().apiTime()}};
+    file.write(QByteArray::fromStdString(report.dump()));
 }
 
 void KnutCore::doParse(const QCommandLineParser &parser) const
@@ -169,27 +590,109 @@ void KnutCore::initialize(Settings::Mode mode)
     // If creating a KnutCore and then processing command line arguments
     if (m_initialized)
         return;
+    auto &trace = StartupTrace::instance();
+    trace.mark("Parse command line");
     new Settings(mode, this);
+    trace.mark("Load settings");
+    ::Utils::TaskScheduler::setThreadCount(Settings::instance()->value<int>(Settings::ThreadCount));
     new Project(this);
-    new ScriptManager(this);
+    trace.mark("Create project");
+    BuiltinQueries::prewarm();
+    // The GUI doesn't wait for the script directories to be read
+    new ScriptManager(mode == Settings::Mode::Gui, this);
+    trace.mark("Create script manager");
     if (Core::Settings::instance()->value<bool>(Core::Settings::SaveLogsToFile))
         initializeMultiSinkLogger();
     m_initialized = true;
 }
 
+void KnutCore::finishStartupTrace()
+{
+    // The startup is done once the event loop runs, and all the scripts are loaded
+    QTimer::singleShot(0, this, []() {
+        StartupTrace::instance().mark("Start event loop");
+        auto printReport = []() {
+            std::cerr << StartupTrace::instance().report().toStdString();
+        };
+        auto scriptManager = ScriptManager::instance();
+        if (!scriptManager->isLoading()) {
+            printReport();
+            return;
+        }
+        connect(
+            scriptManager, &ScriptManager::scriptsLoaded, scriptManager,
+            [printReport]() {
+                StartupTrace::instance().mark("Load scripts (deferred)");
+                printReport();
+            },
+            Qt::SingleShotConnection);
+    });
+}
+
+namespace {
+
+// Sink of the default logger passing the lines to the async logger writing the log file: the lines are only queued, the
+// caller doesn't wait for the file.
+class AsyncFileSink : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+{
+public:
+    explicit AsyncFileSink(std::shared_ptr<spdlog::async_logger> logger)
+        : m_logger(std::move(logger))
+    {
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override
+    {
+        m_logger->log(msg.time, msg.source, msg.level, msg.payload);
+    }
+    void flush_() override { m_logger->flush(); }
+
+private:
+    std::shared_ptr<spdlog::async_logger> m_logger;
+};
+
+} // namespace
+
+constexpr char FileLoggerName[] = "knut_file";
+
+// Thread writing the log file, destroying it writes the lines still queued
+static std::shared_ptr<spdlog::details::thread_pool> &fileLogThread()
+{
+    static std::shared_ptr<spdlog::details::thread_pool> threadPool;
+    return threadPool;
+}
+
 void KnutCore::initializeMultiSinkLogger()
 {
     // Define fileLogger arguments (make it clear)
     constexpr int max_files = 5;
     constexpr bool rotate_on_open = true;
+    // Lines waiting to be written, the oldest ones are dropped when a script logs faster than the file is written
+    constexpr size_t QueueSize = 8192;
+    constexpr auto FlushInterval = std::chrono::seconds(1);
 
-    // Create a default Knut logger that save the logs to file.
-    auto fileSink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+    auto fileSink = std::make_shared<spdlog::sinks::rotating_file_sink_st>(
         Core::Settings::instance()->logFilePath().toStdString(), SIZE_MAX, max_files, rotate_on_open);
-    auto logger = spdlog::default_logger();
-    logger->sinks().push_back(fileSink);
-    // auto flush when "info" or higher message is logged.
-    spdlog::flush_on(spdlog::level::info);
+    fileLogThread() = std::make_shared<spdlog::details::thread_pool>(QueueSize, 1);
+    auto fileLogger = std::make_shared<spdlog::async_logger>(FileLoggerName, fileSink, fileLogThread(),
+                                                             spdlog::async_overflow_policy::overrun_oldest);
+    fileLogger->set_level(spdlog::level::trace);
+    // The errors are written right away, in case they are followed by a crash
+    fileLogger->flush_on(spdlog::level::err);
+    // Registered to be flushed periodically, as flush_every flushes the registered loggers
+    spdlog::register_logger(fileLogger);
+    spdlog::flush_every(FlushInterval);
+
+    auto sink = std::make_shared<AsyncFileSink>(fileLogger);
+    spdlog::default_logger()->sinks().push_back(sink);
+
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [sink]() {
+        std::erase(spdlog::default_logger()->sinks(), sink);
+        spdlog::drop(FileLoggerName);
+        // Waits for the lines still queued to be written
+        fileLogThread().reset();
+    });
 }
 
 } // namespace Core
@@ -40,7 +40,16 @@ protected:
 
 private:
     void initialize(Settings::Mode mode);
+    void runBatch(const QCommandLineParser &parser);
+    void runTransform(const QCommandLineParser &parser);
+    void runBench(const QCommandLineParser &parser);
+    void runCompileScripts(const QCommandLineParser &parser);
+    void runTests(const QCommandLineParser &parser);
+    static void writeBenchReport(const QString &fileName, qint64 scriptTime);
+    void runLspBroker(const QCommandLineParser &parser);
     void initializeMultiSinkLogger();
+    // Prints the startup trace once the startup is done
+    void finishStartupTrace();
 
     bool m_initialized = false;
 };
@@ -9,14 +9,23 @@
 */
 
 #include "logger.h"
+#include "memoryusage.h"
 #include "scriptrunner.h"
 #include "settings.h"
 #include "textdocument_p.h"
 
-#include <QHash>
+#include <QBuffer>
+#include <QDataStream>
+#include <QDir>
+#include <QTemporaryFile>
 
 namespace Core {
 
+// Maximum number of operations merged into one entry, so a long typing session doesn't end up in a single huge entry
+static constexpr int MaxMergeCount = 1000;
+// The entries removed from the journal are only dropped from the file once they are more than half of it
+static constexpr qint64 MinCompactSize = 1024 * 1024;
+
 LoggerObject::LoggerObject()
     : m_firstLogger(m_canLog)
 {
@@ -26,12 +35,8 @@ LoggerObject::~LoggerObject()
 {
     if (m_firstLogger)
         m_canLog = true;
-}
-
-void LoggerObject::log(QString &&string)
-{
-    spdlog::trace(string);
-    m_canLog = false;
+    if (m_profiled)
+        ScriptProfiler::instance().leave();
 }
 
 HistoryModel::HistoryModel(QObject *parent)
@@ -45,10 +50,35 @@ HistoryModel::~HistoryModel()
     LoggerObject::m_model = nullptr;
 }
 
+const HistoryModel *HistoryModel::instance()
+{
+    return LoggerObject::m_model;
+}
+
+qint64 HistoryModel::memorySize() const
+{
+    // The entries written in the journal are on disk, only their position is kept
+    auto size = static_cast<qint64>(m_offsets.size() * sizeof(qint64));
+    if (m_pending) {
+        auto variantSize = [](const QVariant &value) {
+            // Only the strings are counted, the other values are small or shared with the script
+            if (static_cast<QMetaType::Type>(value.typeId()) == QMetaType::QString)
+                return memorySize(value.toString());
+            return qint64(0);
+        };
+        size += static_cast<qint64>(sizeof(PendingEntry) + m_pending->params.size() * sizeof(Arg));
+        size += variantSize(m_pending->returnArg.value);
+        for (const auto &param : m_pending->params)
+            size += variantSize(param.value);
+    }
+    size += memorySize(m_names) + static_cast<qint64>(m_nameIds.size() * (sizeof(QString) + sizeof(int)));
+    return size;
+}
+
 int Core::HistoryModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    return static_cast<int>(m_data.size());
+    return static_cast<int>(m_offsets.size()) + (m_pending ? 1 : 0);
 }
 
 int HistoryModel::columnCount(const QModelIndex &parent) const
@@ -67,6 +97,10 @@ static QString variantToString(const QVariant &variant)
         text.replace('"', R"(\")");
         text.append('"');
         text.prepend('"');
+    } else if (static_cast<QMetaType::Type>(variant.typeId()) == QMetaType::QVariantList
+               || static_cast<QMetaType::Type>(variant.typeId()) == QMetaType::QVariantMap) {
+        // A json array or object is also a valid javascript literal
+        text = QString::fromUtf8(QJsonDocument::fromVariant(variant).toJson(QJsonDocument::Compact));
     } else if (variant.metaType().flags().testAnyFlag(QMetaType::IsEnumeration)) {
         QString className = variant.metaType().metaObject()->className();
         className = className.split("::").last();
@@ -80,19 +114,21 @@ QVariant HistoryModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole) {
+        // Only the visible rows are asked for, so the entries are read from the journal on demand
+        const Record entry = record(index.row());
         switch (index.column()) {
         case NameCol:
-            return m_data.at(index.row()).name;
+            return name(entry.nameId);
         case ParamCol: {
-            const auto &params = m_data.at(index.row()).params;
             QStringList paramStrings;
-            for (const auto &param : params) {
-                QString text = variantToString(param.value);
-                if (!param.name.isEmpty())
-                    text.prepend(QString("%1: ").arg(param.name));
+            paramStrings.reserve(static_cast<qsizetype>(entry.params.size()));
+            for (const auto &value : entry.params) {
+                QString text = value.text;
+                if (!value.isEmpty())
+                    text.prepend(QString("%1: ").arg(name(value.nameId)));
                 paramStrings.push_back(text);
             }
-            const QString returnVariable = m_data.at(index.row()).returnArg.name;
+            const QString &returnVariable = name(entry.returnValue.nameId);
             return paramStrings.join(", ") + (returnVariable.isEmpty() ? "" : (" => " + returnVariable));
         }
         }
@@ -117,7 +153,13 @@ QVariant HistoryModel::headerData(int section, Qt::Orientation orientation, int
 void HistoryModel::clear()
 {
     beginResetModel();
-    m_data.clear();
+    m_offsets.clear();
+    m_pending.reset();
+    m_journal.reset();
+    m_removedEntries = 0;
+    m_cachedRecord.reset();
+    m_names.clear();
+    m_nameIds.clear();
     endResetModel();
 }
 
@@ -127,22 +169,25 @@ QString HistoryModel::createScript(int start, int end)
     const auto tab = settings.insertSpaces ? QString(settings.tabSize, ' ') : QString('\t');
 
     std::tie(start, end) = std::minmax(start, end);
-    Q_ASSERT(start >= 0 && start <= end && end < static_cast<int>(m_data.size()));
+    Q_ASSERT(start >= 0 && start <= end && end < rowCount());
 
     QString scriptText = "// Description of the script\n\nfunction main() {\n";
 
-    QHash<QString, QVariant> returnVariables;
+    // Indexed by name id
+    QHash<int, Value> returnVariables;
+    const int documentId = nameId("document");
 
     for (int row = start; row <= end; ++row) {
-        const auto &data = m_data.at(row);
-        QString apiCall = data.name;
+        const Record entry = record(row);
+        const QString &entryName = name(entry.nameId);
+        QString apiCall = entryName;
         const bool isProperty = ScriptRunner::isProperty(apiCall);
 
         // Check if we need to create the document, and change the API call as it's not a singleton
-        if (data.name.contains("Document::")) {
-            if (!returnVariables.contains("document"))
+        if (entryName.contains("Document::")) {
+            if (!returnVariables.contains(documentId))
                 scriptText += tab + "var document = Project.currentDocument\n";
-            returnVariables["document"] = {};
+            returnVariables[documentId] = {};
             apiCall = "document." + apiCall.mid(apiCall.indexOf("::") + 2);
         } else {
             apiCall.replace("::", ".");
@@ -150,22 +195,24 @@ QString HistoryModel::createScript(int start, int end)
 
         // Set the return value
         QString returnValue;
-        if (!data.returnArg.isEmpty()) {
-            const auto &name = data.returnArg.name;
-            returnValue = (returnVariables.contains(name) ? "" : "var ") + name + " = ";
-            returnVariables[name] = data.returnArg.value;
+        if (!entry.returnValue.isEmpty()) {
+            const int returnId = entry.returnValue.nameId;
+            returnValue = (returnVariables.contains(returnId) ? "" : "var ") + name(returnId) + " = ";
+            returnVariables[returnId] = entry.returnValue;
         }
 
         // Pass the parameters
         QStringList paramStrings;
-        for (const auto &param : data.params) {
-            if (!param.name.isEmpty() && returnVariables.value(param.name) == param.value) {
-                paramStrings.append(param.name);
-                continue;
+        paramStrings.reserve(static_cast<qsizetype>(entry.params.size()));
+        for (const auto &value : entry.params) {
+            if (!value.isEmpty()) {
+                const auto it = returnVariables.constFind(value.nameId);
+                if (it != returnVariables.cend() && it->isSameValue(value)) {
+                    paramStrings.append(name(value.nameId));
+                    continue;
+                }
             }
-
-            QString text = variantToString(param.value);
-            paramStrings.push_back(text);
+            paramStrings.push_back(value.text);
         }
 
         if (isProperty) {
@@ -189,41 +236,221 @@ QString HistoryModel::createScript(const QModelIndex &startIndex, const QModelIn
     return createScript(startIndex.row(), endIndex.row());
 }
 
+void HistoryModel::setMaximumSize(int size)
+{
+    m_maximumSize = std::max(size, 0);
+    if (rowCount() > m_maximumSize)
+        removeOldestData(rowCount() - m_maximumSize);
+}
+
+int HistoryModel::nameId(const QString &name)
+{
+    if (name.isEmpty())
+        return -1;
+    auto it = m_nameIds.constFind(name);
+    if (it == m_nameIds.cend()) {
+        it = m_nameIds.insert(name, static_cast<int>(m_names.size()));
+        m_names.push_back(name);
+    }
+    return *it;
+}
+
+const QString &HistoryModel::name(int nameId) const
+{
+    static const QString emptyName;
+    return nameId == -1 ? emptyName : m_names.at(nameId);
+}
+
+void HistoryModel::removeOldestData(size_t count)
+{
+    beginRemoveRows({}, 0, static_cast<int>(count) - 1);
+    const size_t written = std::min(count, m_offsets.size());
+    m_offsets.erase(m_offsets.begin(), m_offsets.begin() + written);
+    if (count > written)
+        m_pending.reset();
+    m_removedEntries += static_cast<qint64>(count);
+    compactJournal();
+    endRemoveRows();
+}
+
 void HistoryModel::logData(const QString &name)
 {
-    addData(LogData {name, {}, {}}, false);
+    if (m_maximumSize == 0)
+        return;
+    addData(name, {}, false);
 }
 
-void HistoryModel::addData(LogData &&data, bool merge)
+void HistoryModel::addData(const QString &name, std::vector<Arg> params, bool merge)
 {
-    if (!merge || m_data.empty() || m_data.back().name != data.name) {
-        beginInsertRows({}, static_cast<int>(m_data.size()), static_cast<int>(m_data.size()));
-        m_data.push_back(std::move(data));
-        endInsertRows();
+    const int id = nameId(name);
+    if (merge && mergeData(id, params)) {
+        auto lastIndex = index(rowCount() - 1, ParamCol);
+        emit dataChanged(lastIndex, lastIndex);
         return;
     }
 
-    auto &lastData = m_data.back();
-    // Add parameters together
-    for (size_t i = 0; i < data.params.size(); ++i) {
-        const auto &param = data.params[i];
-        auto &lastParam = lastData.params[i];
+    writePendingEntry();
+    if (rowCount() >= m_maximumSize)
+        removeOldestData(rowCount() - m_maximumSize + 1);
+    beginInsertRows({}, rowCount(), rowCount());
+    m_pending = PendingEntry {id, 0, std::move(params), {}};
+    endInsertRows();
+}
+
+bool HistoryModel::mergeData(int nameId, const std::vector<Arg> &params)
+{
+    if (!m_pending)
+        return false;
+    auto &lastEntry = *m_pending;
+    if (lastEntry.nameId != nameId || lastEntry.mergeCount >= MaxMergeCount)
+        return false;
+    Q_ASSERT(lastEntry.params.size() == params.size());
+
+    // Add parameters together, the values are updated in place to avoid copying the whole text for each operation
+    for (size_t i = 0; i < params.size(); ++i) {
+        const auto &param = params[i];
+        auto &lastValue = lastEntry.params[i].value;
         switch (static_cast<QMetaType::Type>(param.value.typeId())) {
         case QMetaType::Int:
-            lastParam.value = lastParam.value.toInt() + param.value.toInt();
+            lastValue = lastValue.toInt() + param.value.toInt();
             break;
         case QMetaType::QString:
-            lastParam.value = lastParam.value.toString() + param.value.toString();
+            static_cast<QString *>(lastValue.data())->append(param.value.toString());
             break;
         case QMetaType::QStringList:
-            lastParam.value = lastParam.value.toStringList() + param.value.toStringList();
+            static_cast<QStringList *>(lastValue.data())->append(param.value.toStringList());
             break;
         default:
             Q_UNREACHABLE();
         }
     }
-    auto lastIndex = index(static_cast<int>(m_data.size()) - 1, ParamCol);
-    emit dataChanged(lastIndex, lastIndex);
+    ++lastEntry.mergeCount;
+    return true;
+}
+
+void HistoryModel::writeValue(QDataStream &stream, const Value &value)
+{
+    stream << qint32(value.nameId) << qint32(value.typeId) << value.text << value.object;
+}
+
+HistoryModel::Value HistoryModel::readValue(QDataStream &stream)
+{
+    qint32 nameId = -1;
+    qint32 typeId = 0;
+    Value value;
+    stream >> nameId >> typeId >> value.text >> value.object;
+    value.nameId = nameId;
+    value.typeId = typeId;
+    return value;
+}
+
+// Converts a logged value to what's needed to show it and create a script
+HistoryModel::Value HistoryModel::toValue(int nameId, const QVariant &variant)
+{
+    Value value {nameId, variant.typeId(), variantToString(variant), 0};
+    if (variant.metaType().flags().testAnyFlag(QMetaType::IsPointer))
+        value.object = reinterpret_cast<quintptr>(*static_cast<void *const *>(variant.constData()));
+    return value;
+}
+
+/**
+ * \brief Returns the journal, created on first use
+ *
+ * The journal is a temporary file, or a buffer in memory if the file can't be created.
+ */
+QIODevice *HistoryModel::journal()
+{
+    if (!m_journal) {
+        auto file = std::make_unique<QTemporaryFile>(QDir::tempPath() + "/knut-history-XXXXXX");
+        if (file->open()) {
+            m_journal = std::move(file);
+        } else {
+            spdlog::warn("HistoryModel::journal - can't create the history journal, keeping it in memory");
+            m_journal = std::make_unique<QBuffer>();
+            m_journal->open(QIODevice::ReadWrite);
+        }
+    }
+    return m_journal.get();
+}
+
+/**
+ * \brief Appends the last entry to the journal
+ *
+ * The history is an append-only binary journal: for each entry its API name id, then the name id, type, text and
+ * object of each parameter and of the return value. Only the position of the entries is kept in memory, so the history
+ * can be recorded during a long session; the rows are read back when shown, or when creating a script.
+ */
+void HistoryModel::writePendingEntry()
+{
+    if (!m_pending)
+        return;
+
+    auto *device = journal();
+    const qint64 offset = device->size();
+    device->seek(offset);
+    QDataStream stream(device);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << qint32(m_pending->nameId) << quint32(m_pending->params.size());
+    for (const auto &param : m_pending->params)
+        writeValue(stream, toValue(param.nameId, param.value));
+    writeValue(stream, toValue(m_pending->returnArg.nameId, m_pending->returnArg.value));
+
+    m_offsets.push_back(offset);
+    m_pending.reset();
+}
+
+// Drops the removed entries from the journal, once most of it is removed
+void HistoryModel::compactJournal()
+{
+    if (!m_journal)
+        return;
+    const qint64 size = m_journal->size();
+    const qint64 start = m_offsets.empty() ? size : m_offsets.front();
+    if (start < MinCompactSize || start < size / 2)
+        return;
+
+    m_journal->seek(start);
+    const QByteArray data = m_journal->readAll();
+    m_journal.reset();
+    m_cachedRecord.reset();
+    auto *device = journal();
+    device->write(data);
+    for (auto &offset : m_offsets)
+        offset -= start;
+}
+
+HistoryModel::Record HistoryModel::record(int row) const
+{
+    Record result;
+    if (m_pending && row == static_cast<int>(m_offsets.size())) {
+        result.nameId = m_pending->nameId;
+        for (const auto &param : m_pending->params)
+            result.params.push_back(toValue(param.nameId, param.value));
+        result.returnValue = toValue(m_pending->returnArg.nameId, m_pending->returnArg.value);
+        return result;
+    }
+
+    // Each row is asked for each column, keep the last one read
+    const qint64 entry = m_removedEntries + row;
+    if (m_cachedRecord && m_cachedRecord->first == entry)
+        return m_cachedRecord->second;
+
+    m_journal->seek(m_offsets.at(row));
+    QDataStream stream(m_journal.get());
+    stream.setVersion(QDataStream::Qt_6_0);
+    qint32 nameId = -1;
+    quint32 paramCount = 0;
+    stream >> nameId >> paramCount;
+    result.nameId = nameId;
+    result.params.reserve(paramCount);
+    for (quint32 i = 0; i < paramCount; ++i)
+        result.params.push_back(readValue(stream));
+    result.returnValue = readValue(stream);
+    if (stream.status() != QDataStream::Ok)
+        spdlog::error("HistoryModel::record - can't read the entry {} of the history journal", row);
+
+    m_cachedRecord = {entry, result};
+    return result;
 }
 
 LoggerDisabler::LoggerDisabler(bool silenceAll)
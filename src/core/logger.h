@@ -11,16 +11,26 @@
 #pragma once
 
 #include "scriptdialogitem.h"
+#include "scriptprofiler.h"
 #include "utils/log.h"
 
 #include <QAbstractItemModel>
 #include <QCoreApplication>
+#include <QHash>
+#include <QJsonDocument>
 #include <QMetaEnum>
 #include <QString>
 #include <QVariantList>
+#include <QVariantMap>
 #include <concepts>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <vector>
 
+class QDataStream;
+class QIODevice;
+
 /**
  * Create a return value, the name will depend on the type returned.
  */
@@ -91,6 +101,9 @@ QString valueToString(const T &data)
         return QString::number(data);
     else if constexpr (std::is_same_v<std::remove_cvref_t<T>, QStringList>)
         return '{' + data.join(", ") + '}';
+    else if constexpr (std::is_same_v<std::remove_cvref_t<T>, QVariantList>
+                       || std::is_same_v<std::remove_cvref_t<T>, QVariantMap>)
+        return QString::fromUtf8(QJsonDocument::fromVariant(data).toJson(QJsonDocument::Compact));
     else if constexpr (std::is_enum_v<T>) {
         const auto metaEnum = QMetaEnum::fromType<T>();
         QString className = QMetaType::fromType<T>().metaObject()->className();
@@ -144,6 +157,13 @@ public:
 
     void clear();
 
+    /**
+     * @brief Set the maximum number of entries kept in the history
+     * When the history is full, the oldest entries are removed first. A size of 0 disables the history.
+     */
+    void setMaximumSize(int size);
+    int maximumSize() const { return m_maximumSize; }
+
     /**
      * @brief Create a script from 2 points in the history
      * The script is created using 2 rows in the history model. It will create a javascript script.
@@ -151,55 +171,106 @@ public:
     QString createScript(int start, int end);
     QString createScript(const QModelIndex &startIndex, const QModelIndex &endIndex);
 
+    // The model logging the API calls, if any: it's only created by the user interface
+    static const HistoryModel *instance();
+    // Approximate memory used by the entries and their parameters
+    qint64 memorySize() const;
+
 private:
     friend class LoggerObject;
 
+    // Names (API names, parameter names and return variables) are interned, -1 is used for no name
     struct Arg
     {
-        QString name;
+        int nameId = -1;
         QVariant value;
-        bool isEmpty() const { return name.isEmpty(); }
+        bool isEmpty() const { return nameId == -1; }
     };
-    struct LogData
+    // The last entry is kept in memory until the next one is logged, as it can still be merged or get a return value
+    struct PendingEntry
     {
-        QString name;
+        int nameId = -1;
+        int mergeCount = 0;
         std::vector<Arg> params;
         Arg returnArg;
     };
+    // A parameter or return value as written in the journal: the text used in the scripts, and for a pointer the
+    // address of the object, as two objects can have the same text
+    struct Value
+    {
+        int nameId = -1;
+        int typeId = 0;
+        QString text;
+        quint64 object = 0;
+        bool isEmpty() const { return nameId == -1; }
+        bool isSameValue(const Value &other) const
+        {
+            return typeId == other.typeId && object == other.object && text == other.text;
+        }
+    };
+    struct Record
+    {
+        int nameId = -1;
+        std::vector<Value> params;
+        Value returnValue;
+    };
 
     void logData(const QString &name);
     template <typename... Ts>
     void logData(const QString &name, bool merge, Ts... params)
     {
-        LogData data;
-        data.name = name;
-        fillLogData(data, params...);
-        addData(std::move(data), merge);
+        if (m_maximumSize == 0)
+            return;
+        std::vector<Arg> args;
+        args.reserve(sizeof...(Ts));
+        (args.push_back(toArg(params)), ...);
+        addData(name, std::move(args), merge);
     }
 
     template <typename T>
     void setReturnValue(QString &&name, const T &value)
     {
-        m_data.back().returnArg.name = std::move(name);
-        m_data.back().returnArg.value = QVariant::fromValue(value);
+        if (!m_pending)
+            return;
+        m_pending->returnArg = {nameId(name), QVariant::fromValue(value)};
     }
 
-    void fillLogData(LogData &) { }
-
-    template <typename T, typename... Ts>
-    void fillLogData(LogData &data, T param, Ts... params)
+    template <typename T>
+    Arg toArg(const T &param)
     {
         if constexpr (std::derived_from<T, LoggerArgBase>)
-            data.params.push_back({param.argName, QVariant::fromValue(param.value)});
+            return {nameId(param.argName), QVariant::fromValue(param.value)};
         else
-            data.params.push_back({"", QVariant::fromValue(param)});
-
-        fillLogData(data, params...);
+            return {-1, QVariant::fromValue(param)};
     }
 
-    void addData(LogData &&data, bool merge);
-
-    std::vector<LogData> m_data;
+    int nameId(const QString &name);
+    const QString &name(int nameId) const;
+
+    // Adds the parameters as a new entry, or merges them into the last entry
+    void addData(const QString &name, std::vector<Arg> params, bool merge);
+    bool mergeData(int nameId, const std::vector<Arg> &params);
+    void removeOldestData(size_t count);
+
+    // Journal of the entries, see writePendingEntry
+    static Value toValue(int nameId, const QVariant &variant);
+    static void writeValue(QDataStream &stream, const Value &value);
+    static Value readValue(QDataStream &stream);
+    QIODevice *journal();
+    void writePendingEntry();
+    void compactJournal();
+    Record record(int row) const;
+
+    // Position in the journal of each entry written, in order
+    std::deque<qint64> m_offsets;
+    std::optional<PendingEntry> m_pending;
+    std::unique_ptr<QIODevice> m_journal;
+    // Number of entries removed since the last clear, so a cached record stays valid when the rows move
+    qint64 m_removedEntries = 0;
+    mutable std::optional<std::pair<qint64, Record>> m_cachedRecord;
+    QStringList m_names;
+    QHash<QString, int> m_nameIds;
+    int m_maximumSize = 10000;
 };
 
 /**
@@ -214,6 +285,7 @@ public:
     explicit LoggerObject(QString name, bool /*unused*/)
         : LoggerObject()
     {
+        profile(name);
         if (!m_canLog)
             return;
 
@@ -227,22 +299,26 @@ public:
 
         if (m_model)
             m_model->logData(name);
-        log(std::move(name));
+        log([&name]() {
+            return name;
+        });
     }
 
     template <typename... Ts>
     explicit LoggerObject(QString name, bool merge, Ts... params)
         : LoggerObject()
     {
+        profile(name);
         if (!m_canLog)
             return;
         if (m_model)
             m_model->logData(name, merge, params...);
 
-        QStringList paramList;
-        (paramList.push_back(valueToString(params)), ...);
-        QString result = name + " - " + paramList.join(", ");
-        log(std::move(result));
+        log([&]() {
+            QStringList paramList;
+            (paramList.push_back(valueToString(params)), ...);
+            return name + " - " + paramList.join(", ");
+        });
     }
 
     ~LoggerObject();
@@ -259,10 +335,28 @@ private:
     friend LoggerDisabler;
 
     LoggerObject();
-    void log(QString &&string);
+
+    // Nested calls are profiled too, even if they are not logged
+    void profile(const QString &name)
+    {
+        if (!ScriptProfiler::isEnabled())
+            return;
+        ScriptProfiler::instance().enter(name);
+        m_profiled = true;
+    }
+
+    // The message is only formatted if it's going to be used by the logger, as it's costly for a long script run
+    template <typename Func>
+    void log(Func formatMessage)
+    {
+        if (spdlog::default_logger_raw()->should_log(spdlog::level::trace))
+            spdlog::trace(formatMessage());
+        m_canLog = false;
+    }
 
     inline static bool m_canLog = true;
     bool m_firstLogger = false;
+    bool m_profiled = false;
 
     inline static HistoryModel *m_model = nullptr;
 };
@@ -11,10 +11,19 @@
 #include "lsp_utils.h"
 #include "codedocument.h"
 #include "project.h"
+#include "settings.h"
 #include "textdocument.h"
+#include "textdocument_p.h"
+#include "utils/log.h"
+#include "utils/taskscheduler.h"
+#include "utils/textcodec.h"
 
+#include <QFile>
 #include <QPlainTextEdit>
 #include <QTextBlock>
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
 
 namespace Core::Utils {
 
@@ -22,7 +31,7 @@ namespace Core::Utils {
 {
     Lsp::Position position;
 
-    auto cursor = textDocument.textEdit()->textCursor();
+    auto cursor = textDocument.textCursor();
     cursor.setPosition(pos, QTextCursor::MoveAnchor);
 
     position.line = cursor.blockNumber();
@@ -32,15 +41,13 @@ namespace Core::Utils {
 
 int lspToPos(const TextDocument &textDocument, const Lsp::Position &pos)
 {
-    auto document = textDocument.textEdit()->document();
+    auto document = textDocument.textDocument();
     // Internally, columns are 0-based, like in LSP
     const int blockNumber = qMin((int)pos.line, document->blockCount() - 1);
     const QTextBlock &block = document->findBlockByNumber(blockNumber);
-    if (block.isValid()) {
-        QTextCursor cursor(block);
-        cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, pos.character);
-        return cursor.position();
-    }
+    // LSP characters are UTF-16 code units, like the positions in the block, the length includes the block separator
+    if (block.isValid())
+        return block.position() + std::min(static_cast<int>(pos.character), block.length() - 1);
     return 0;
 }
 
@@ -49,25 +56,89 @@ TextRange lspToRange(const TextDocument &textDocument, const Lsp::Range &range)
     return {lspToPos(textDocument, range.start), lspToPos(textDocument, range.end)};
 }
 
-TextLocationList lspToTextLocationList(const std::vector<Lsp::Location> &locations)
+// Start of each line of a file, as positions in its TextDocument, from a read of the file
+static std::optional<std::vector<int>> readLineStarts(const QString &fileName, const QString &fallbackEncoding)
 {
-    TextLocationList textLocations;
-    textLocations.reserve(locations.size());
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    const QString text = toDocumentText(::Utils::decodeText(file.readAll(), fallbackEncoding).text);
+    std::vector<int> lineStarts {0};
+    for (qsizetype index = text.indexOf(u'\n'); index != -1; index = text.indexOf(u'\n', index + 1))
+        lineStarts.push_back(static_cast<int>(index + 1));
+    // Extra start after the end of the text, so each line has an end
+    lineStarts.push_back(static_cast<int>(text.size() + 1));
+    return lineStarts;
+}
 
+static int lspToPos(const std::vector<int> &lineStarts, const Lsp::Position &pos)
+{
+    const auto lineCount = static_cast<int>(lineStarts.size()) - 1;
+    const int line = std::clamp(static_cast<int>(pos.line), 0, lineCount - 1);
+    const int lineEnd = lineStarts[line + 1] - 1;
+    return std::min(lineStarts[line] + static_cast<int>(pos.character), lineEnd);
+}
+
+std::vector<std::optional<TextLocation>> lspToTextLocations(const std::vector<Lsp::Location> &locations)
+{
+    // The documents are only opened when accessed: the ranges are computed from the opened documents, or from a read
+    // of the other files, done in parallel
+    std::vector<QString> fileNames;
+    fileNames.reserve(locations.size());
+    std::unordered_map<QString, TextDocument *> openDocuments;
+    std::unordered_map<QString, std::optional<std::vector<int>>> files;
     for (const auto &location : locations) {
         const auto url = QUrl::fromEncoded(QByteArray::fromStdString(location.uri));
-        if (!url.isLocalFile()) {
-            continue;
+        fileNames.push_back(url.isLocalFile() ? url.toLocalFile() : QString());
+        if (!fileNames.back().isEmpty())
+            files.try_emplace(fileNames.back());
+    }
+    for (auto *document : Project::instance()->documents()) {
+        auto textDocument = qobject_cast<TextDocument *>(document);
+        if (textDocument && files.erase(document->fileName()))
+            openDocuments.emplace(document->fileName(), textDocument);
+    }
+
+    const auto fallbackEncoding = Settings::exists() ? Settings::instance()->snapshot().fallbackEncoding : QString();
+    {
+        ::Utils::TaskGroup tasks;
+        for (auto &file : files) {
+            tasks.start([&file, &fallbackEncoding]() {
+                file.second = readLineStarts(file.first, fallbackEncoding);
+            });
         }
-        const auto filepath = url.toLocalFile();
+    }
 
-        if (auto *document = qobject_cast<CodeDocument *>(Project::instance()->get(filepath))) {
-            const auto range = lspToRange(*document, location.range);
+    std::vector<std::optional<TextLocation>> textLocations(locations.size());
+    for (size_t i = 0; i < locations.size(); ++i) {
+        const auto &fileName = fileNames[i];
+        if (fileName.isEmpty())
+            continue;
 
-            textLocations.emplace_back(TextLocation {.document = document, .range = range});
+        const auto &range = locations[i].range;
+        if (auto it = openDocuments.find(fileName); it != openDocuments.end()) {
+            textLocations[i] = TextLocation {.document = LazyCodeDocument(fileName),
+                                             .range = lspToRange(*it->second, range)};
+        } else if (const auto &lineStarts = files.at(fileName)) {
+            textLocations[i] = TextLocation {.document = LazyCodeDocument(fileName),
+                                             .range = {lspToPos(*lineStarts, range.start),
+                                                       lspToPos(*lineStarts, range.end)}};
+        } else {
+            spdlog::warn("Utils::lspToTextLocations - can't read the file {}", fileName);
         }
     }
+    return textLocations;
+}
 
+TextLocationList lspToTextLocationList(const std::vector<Lsp::Location> &locations)
+{
+    TextLocationList textLocations;
+    textLocations.reserve(locations.size());
+    for (auto &location : lspToTextLocations(locations)) {
+        if (location)
+            textLocations.push_back(std::move(*location));
+    }
     return textLocations;
 }
 
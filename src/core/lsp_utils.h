@@ -15,7 +15,9 @@
 #include "textrange.h"
 
 #include <QString>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace Core {
 class TextDocument;
@@ -29,7 +31,10 @@ int lspToPos(const TextDocument &textDocument, const Lsp::Position &pos);
 
 TextRange lspToRange(const TextDocument &textDocument, const Lsp::Range &range);
 
+// The documents of the locations are not opened, see LazyCodeDocument
 TextLocationList lspToTextLocationList(const std::vector<Lsp::Location> &locations);
+// Same, with one location for each LSP location, empty if its file can't be read
+std::vector<std::optional<TextLocation>> lspToTextLocations(const std::vector<Lsp::Location> &locations);
 
 QString removeTypeAliasInformation(const QString &typeInfo);
 
@@ -11,11 +11,11 @@
 #include "mark.h"
 #include "logger.h"
 #include "mark_p.h"
+#include "rangemark_p.h"
 #include "textdocument.h"
 #include "utils/log.h"
+#include "utils/trace.h"
 
-#include <QPlainTextEdit>
-#include <QTextDocument>
 
 namespace Core {
 
@@ -83,22 +83,164 @@ int MarkPrivate::column() const
     return column;
 }
 
-void MarkPrivate::update(int from, int charsRemoved, int charsAdded)
+MarkPrivate::MarkPrivate(TextDocument *editor, int pos)
+    : m_editor(editor)
+    , m_pos(pos)
 {
-    Mark::updateMark(m_pos, from, charsRemoved, charsAdded);
+    Q_ASSERT(editor);
+    m_table = editor->m_markTable.get();
+    m_table->add(this);
 }
 
-MarkPrivate::MarkPrivate(TextDocument *editor, int pos)
-    : QObject(nullptr) // Important to have nullptr here, MarkPrivate is managed by shared_ptrs in Mark, MarkPrivate can
-                       // deal with the editor being deleted.
-    , m_editor(editor)
-    , m_pos(pos)
+MarkPrivate::~MarkPrivate()
+{
+    if (m_table)
+        m_table->remove(this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MarkPositions
+///////////////////////////////////////////////////////////////////////////////
+MarkPositions::MarkPositions(TextDocument *editor, std::vector<int> &&positions)
+    : m_editor(editor)
+    , m_positions(std::move(positions))
 {
     Q_ASSERT(editor);
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &MarkPrivate::update);
+    if (!m_positions.empty())
+        m_last = *std::ranges::max_element(m_positions);
+    m_table = editor->m_markTable.get();
+    m_table->add(this);
+}
+
+MarkPositions::~MarkPositions()
+{
+    if (m_table)
+        m_table->remove(this);
+}
+
+void MarkPositions::update(int from, int charsRemoved, int charsAdded)
+{
+    for (auto &position : m_positions)
+        Mark::updateMark(position, from, charsRemoved, charsAdded);
+    Mark::updateMark(m_last, from, charsRemoved, charsAdded);
+}
+
+void MarkPositions::update(const TextChanges &changes)
+{
+    for (auto &position : m_positions)
+        changes.updateMark(position);
+    changes.updateMark(m_last);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MarkTable
+///////////////////////////////////////////////////////////////////////////////
+MarkTable::~MarkTable()
+{
+    // Marks can outlive their document, they are then invalid
+    m_marks.detach();
+    m_rangeMarks.detach();
+    m_positions.detach();
+}
+
+qint64 MarkTable::memorySize() const
+{
+    auto size = [](const auto &mark) {
+        return static_cast<qint64>(sizeof(mark));
+    };
+    return m_marks.memorySize(size) + m_rangeMarks.memorySize(size)
+        + m_positions.memorySize([](const MarkPositions &positions) {
+               return static_cast<qint64>(sizeof(positions) + positions.m_positions.capacity() * sizeof(int));
+           });
+}
+
+void MarkTable::add(MarkPrivate *mark)
+{
+    m_marks.add(mark);
+}
+
+void MarkTable::remove(MarkPrivate *mark)
+{
+    m_marks.remove(mark);
+}
+
+void MarkTable::add(RangeMarkPrivate *rangeMark)
+{
+    m_rangeMarks.add(rangeMark);
+}
+
+void MarkTable::remove(RangeMarkPrivate *rangeMark)
+{
+    m_rangeMarks.remove(rangeMark);
+}
+
+void MarkTable::add(MarkPositions *positions)
+{
+    m_positions.add(positions);
+}
+
+void MarkTable::remove(MarkPositions *positions)
+{
+    m_positions.remove(positions);
+}
+
+void MarkTable::update(int from, int charsRemoved, int charsAdded)
+{
+    TRACE("MarkTable::update");
+    m_marks.forEachAfter(from, [&](MarkPrivate *mark) {
+        Mark::updateMark(mark->m_pos, from, charsRemoved, charsAdded);
+    });
+    m_rangeMarks.forEachAfter(from, [&](RangeMarkPrivate *rangeMark) {
+        rangeMark->update(from, charsRemoved, charsAdded);
+    });
+    m_positions.forEachAfter(from, [&](MarkPositions *positions) {
+        positions->update(from, charsRemoved, charsAdded);
+    });
+}
+
+void MarkTable::update(const TextChanges &changes)
+{
+    TRACE("MarkTable::update");
+    if (changes.isEmpty())
+        return;
+    m_marks.forEachAfter(changes.from(), [&](MarkPrivate *mark) {
+        changes.updateMark(mark->m_pos);
+    });
+    m_rangeMarks.forEachAfter(changes.from(), [&](RangeMarkPrivate *rangeMark) {
+        rangeMark->update(changes);
+    });
+    m_positions.forEachAfter(changes.from(), [&](MarkPositions *positions) {
+        positions->update(changes);
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TextChanges
+///////////////////////////////////////////////////////////////////////////////
+void TextChanges::add(int from, int charsRemoved, int charsAdded)
+{
+    Q_ASSERT(m_changes.empty() || from >= m_changes.back().from + m_changes.back().charsRemoved);
+    const int delta = m_changes.empty() ? 0 : m_changes.back().delta;
+    m_changes.push_back({.from = from, .charsRemoved = charsRemoved, .delta = delta + charsAdded - charsRemoved});
+}
+
+void TextChanges::updateMark(int &mark) const
+{
+    // Only the last change starting at or before the mark can move it, the other ones are either after it or
+    // before it: they only shift the mark with their delta
+    auto it = std::ranges::upper_bound(m_changes, mark, {}, &Change::from);
+    if (it == m_changes.begin())
+        return;
+    --it;
+    if (mark < it->from + it->charsRemoved)
+        mark = it->from + (it == m_changes.begin() ? 0 : std::prev(it)->delta);
+    else
+        mark += it->delta;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Mark
+///////////////////////////////////////////////////////////////////////////////
 Mark::Mark(TextDocument *editor, int pos)
     : d(std::make_shared<MarkPrivate>(editor, pos))
 {
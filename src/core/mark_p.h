@@ -10,20 +10,49 @@
 
 #pragma once
 
-#include <QObject>
 #include <QPointer>
+#include <algorithm>
+#include <vector>
 
 namespace Core {
 
 class TextDocument;
+class MarkTable;
 
-class MarkPrivate : public QObject
+// Changes applied to the text at once, to update the marks in one pass instead of once per change.
+// The changes are sorted and don't overlap, their positions are in the text before any of them is applied.
+class TextChanges
 {
-    Q_OBJECT
+public:
+    void add(int from, int charsRemoved, int charsAdded);
+
+    bool isEmpty() const { return m_changes.empty(); }
+    // First position affected by the changes
+    int from() const { return m_changes.front().from; }
+
+    // Same as Mark::updateMark, for all the changes
+    void updateMark(int &mark) const;
+
+private:
+    struct Change
+    {
+        int from;
+        int charsRemoved;
+        // Sum of charsAdded - charsRemoved, for this change and all the previous ones
+        int delta;
+    };
+    std::vector<Change> m_changes;
+};
 
+class MarkPrivate
+{
 public:
     // Unfortunately this needs to be public, as otherwise std::make_shared can't access it
     explicit MarkPrivate(TextDocument *editor, int pos);
+    ~MarkPrivate();
+
+    MarkPrivate(const MarkPrivate &) = delete;
+    MarkPrivate &operator=(const MarkPrivate &) = delete;
 
 private:
     bool isValid() const;
@@ -33,11 +62,181 @@ private:
 
     bool checkEditor() const;
 
-    void update(int from, int charsRemoved, int charsAdded);
+    // Position used to sort the marks in the MarkTable
+    int tablePosition() const { return m_pos; }
 
     QPointer<TextDocument> m_editor;
     int m_pos = -1;
+
+    // Set by the MarkTable
+    MarkTable *m_table = nullptr;
+    qsizetype m_tableIndex = -1;
+
     friend class Mark;
+    friend class MarkTable;
+    template <typename T>
+    friend class MarkTableList;
+};
+
+class RangeMarkPrivate;
+
+// Positions tracked by the MarkTable without creating any mark, used when marks may never be needed (e.g. the
+// captures of a QueryMatch). They are updated like marks when the text changes.
+class MarkPositions
+{
+public:
+    explicit MarkPositions(TextDocument *editor, std::vector<int> &&positions);
+    ~MarkPositions();
+
+    MarkPositions(const MarkPositions &) = delete;
+    MarkPositions &operator=(const MarkPositions &) = delete;
+
+    TextDocument *document() const { return m_editor; }
+    int at(qsizetype index) const { return m_positions.at(index); }
+
+private:
+    void update(int from, int charsRemoved, int charsAdded);
+    void update(const TextChanges &changes);
+
+    // Position used to sort the positions in the MarkTable, the last one
+    int tablePosition() const { return m_last; }
+
+    QPointer<TextDocument> m_editor;
+    std::vector<int> m_positions;
+    int m_last = -1;
+
+    // Set by the MarkTable
+    MarkTable *m_table = nullptr;
+    qsizetype m_tableIndex = -1;
+
+    friend class MarkTable;
+    template <typename T>
+    friend class MarkTableList;
+};
+
+// List of marks sorted by position, used by MarkTable.
+// Updating the positions after a change keeps the order, so only the marks at the end of the list, after the change,
+// have to be visited. Removing a mark only clears its slot, the list is compacted once half of it is empty.
+template <typename T>
+class MarkTableList
+{
+public:
+    void add(T *mark)
+    {
+        if (const T *last = lastMark(); last && last->tablePosition() > mark->tablePosition())
+            m_sorted = false;
+        mark->m_tableIndex = static_cast<qsizetype>(m_marks.size());
+        m_marks.push_back(mark);
+    }
+    void remove(T *mark)
+    {
+        m_marks[mark->m_tableIndex] = nullptr;
+        mark->m_tableIndex = -1;
+        if (++m_removedCount > static_cast<qsizetype>(m_marks.size()) / 2)
+            compact();
+    }
+    // Calls function(mark) for each mark whose position is at or after from
+    template <typename Function>
+    void forEachAfter(int from, Function function)
+    {
+        if (!m_sorted)
+            sort();
+        for (auto it = m_marks.rbegin(); it != m_marks.rend(); ++it) {
+            if (!*it)
+                continue;
+            if ((*it)->tablePosition() < from)
+                break;
+            function(*it);
+        }
+    }
+    // Called when the table is destroyed before the marks
+    void detach()
+    {
+        for (auto *mark : m_marks) {
+            if (mark) {
+                mark->m_table = nullptr;
+                mark->m_tableIndex = -1;
+            }
+        }
+        m_marks.clear();
+        m_removedCount = 0;
+    }
+    // Memory used by the list and its marks, markSize returns the size of one mark
+    template <typename Function>
+    qint64 memorySize(Function markSize) const
+    {
+        auto size = static_cast<qint64>(m_marks.capacity() * sizeof(T *));
+        for (const T *mark : m_marks) {
+            if (mark)
+                size += markSize(*mark);
+        }
+        return size;
+    }
+
+private:
+    const T *lastMark() const
+    {
+        for (auto it = m_marks.rbegin(); it != m_marks.rend(); ++it) {
+            if (*it)
+                return *it;
+        }
+        return nullptr;
+    }
+    void compact()
+    {
+        std::erase(m_marks, nullptr);
+        m_removedCount = 0;
+        updateIndexes();
+    }
+    void sort()
+    {
+        compact();
+        std::stable_sort(m_marks.begin(), m_marks.end(), [](const T *left, const T *right) {
+            return left->tablePosition() < right->tablePosition();
+        });
+        updateIndexes();
+        m_sorted = true;
+    }
+    void updateIndexes()
+    {
+        for (qsizetype i = 0; i < static_cast<qsizetype>(m_marks.size()); ++i)
+            m_marks[i]->m_tableIndex = i;
+    }
+
+    std::vector<T *> m_marks;
+    qsizetype m_removedCount = 0;
+    bool m_sorted = true;
+};
+
+// Keeps track of all the Mark and RangeMark of a TextDocument, and updates them in one pass when the text changes,
+// instead of having one connection to QTextDocument::contentsChange per mark.
+class MarkTable
+{
+public:
+    MarkTable() = default;
+    ~MarkTable();
+
+    MarkTable(const MarkTable &) = delete;
+    MarkTable &operator=(const MarkTable &) = delete;
+
+    void add(MarkPrivate *mark);
+    void remove(MarkPrivate *mark);
+    void add(RangeMarkPrivate *rangeMark);
+    void remove(RangeMarkPrivate *rangeMark);
+    void add(MarkPositions *positions);
+    void remove(MarkPositions *positions);
+
+    void update(int from, int charsRemoved, int charsAdded);
+    void update(const TextChanges &changes);
+
+    qint64 memorySize() const;
+
+private:
+    MarkTableList<MarkPrivate> m_marks;
+    // Sorted by the end of the range: a change can't move a range ending before it
+    MarkTableList<RangeMarkPrivate> m_rangeMarks;
+    // Sorted by the last position
+    MarkTableList<MarkPositions> m_positions;
 };
 
 } // namespace Core
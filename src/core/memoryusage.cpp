@@ -0,0 +1,78 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "memoryusage.h"
+
+#include <QTextStream>
+#include <algorithm>
+
+namespace Core {
+
+void MemoryUsage::add(const QString &part, qint64 bytes)
+{
+    auto it = std::ranges::find(m_parts, part, &std::pair<QString, qint64>::first);
+    if (it == m_parts.end())
+        m_parts.emplace_back(part, bytes);
+    else
+        it->second += bytes;
+}
+
+void MemoryUsage::add(const MemoryUsage &other)
+{
+    for (const auto &[part, bytes] : other.m_parts)
+        add(part, bytes);
+}
+
+qint64 MemoryUsage::total() const
+{
+    qint64 total = 0;
+    for (const auto &part : m_parts)
+        total += part.second;
+    return total;
+}
+
+QVariantMap MemoryUsage::toMap() const
+{
+    QVariantMap map;
+    for (const auto &[part, bytes] : m_parts)
+        map[part] = bytes;
+    map["total"] = total();
+    return map;
+}
+
+static QString toKilobytes(qint64 bytes)
+{
+    return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+}
+
+QString MemoryUsage::report(const std::vector<std::pair<QString, MemoryUsage>> &items)
+{
+    std::vector<const std::pair<QString, MemoryUsage> *> sortedItems;
+    qint64 total = 0;
+    for (const auto &item : items) {
+        sortedItems.push_back(&item);
+        total += item.second.total();
+    }
+    std::ranges::stable_sort(sortedItems, [](const auto *left, const auto *right) {
+        return left->second.total() > right->second.total();
+    });
+
+    QString result;
+    QTextStream stream(&result);
+    stream << "Memory usage: " << toKilobytes(total) << "\n";
+    for (const auto *item : sortedItems) {
+        stream << QString("%1  %2\n").arg(toKilobytes(item->second.total()), 12).arg(item->first);
+        for (const auto &[part, bytes] : item->second.parts())
+            stream << QString("%1    %2\n").arg(toKilobytes(bytes), 12).arg(part);
+    }
+    return result;
+}
+
+} // namespace Core
@@ -0,0 +1,67 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <utility>
+#include <vector>
+
+namespace Core {
+
+/**
+ * \brief Approximate memory used by an object, in bytes, for each of its parts
+ *
+ * The sizes are estimates, computed from the number and size of the items kept (text, syntax tree nodes, marks...),
+ * without the allocator overhead. Implicitly shared data is counted by each owner.
+ */
+class MemoryUsage
+{
+public:
+    // Adds bytes to the part, parts are kept in the order they are first added
+    void add(const QString &part, qint64 bytes);
+    void add(const MemoryUsage &other);
+
+    qint64 total() const;
+    const std::vector<std::pair<QString, qint64>> &parts() const { return m_parts; }
+
+    // Map of the parts, with the total in "total"
+    QVariantMap toMap() const;
+
+    // Human readable report of the usage of each item, sorted by total
+    static QString report(const std::vector<std::pair<QString, MemoryUsage>> &items);
+
+private:
+    std::vector<std::pair<QString, qint64>> m_parts;
+};
+
+inline qint64 memorySize(const QString &text)
+{
+    return text.capacity() * static_cast<qint64>(sizeof(QChar));
+}
+
+inline qint64 memorySize(const QStringList &list)
+{
+    qint64 size = list.capacity() * static_cast<qint64>(sizeof(QString));
+    for (const auto &text : list)
+        size += memorySize(text);
+    return size;
+}
+
+// Size of the items of a container, without the data they own
+template <typename Container>
+qint64 containerSize(const Container &container)
+{
+    return static_cast<qint64>(container.size() * sizeof(typename Container::value_type));
+}
+
+} // namespace Core
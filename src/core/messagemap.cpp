@@ -13,8 +13,6 @@
 #include "querymatch.h"
 #include "textdocument.h"
 
-#include <kdalgorithms.h>
-
 namespace Core {
 
 /*!
@@ -75,6 +73,9 @@ MessageMapEntry fromMessage(const QueryMatch &match, const RangeMark &range)
  * \ingroup CppDocument
  *
  * The `MessageMap` object represents the data contained in the MFC MessageMap.
+ *
+ * The entries are indexed when the message map is extracted, so the lookups by name or by id don't go through all the
+ * entries.
  */
 
 /*!
@@ -110,6 +111,11 @@ MessageMap::MessageMap(const QueryMatch &match)
     const auto messages = match.getAll("message");
     for (const auto &message : messages) {
         entries.append(fromMessage(match, message));
+        const auto &entry = entries.last();
+        const int index = static_cast<int>(entries.size()) - 1;
+        m_entriesByName[entry.name].append(index);
+        if (!entry.parameters.isEmpty())
+            m_entriesById[entry.parameters.first().text()].append(index);
     }
 }
 
@@ -126,13 +132,10 @@ bool MessageMap::isValid() const
  */
 MessageMapEntry MessageMap::get(const QString &name) const
 {
-    auto entry = kdalgorithms::find_if(entries, [&name](const auto &e) {
-        return e.name == name;
-    });
-    if (entry) {
-        return *entry;
-    }
-    return {};
+    const auto it = m_entriesByName.constFind(name);
+    if (it == m_entriesByName.cend())
+        return {};
+    return entries.at(it->first());
 }
 
 /*!
@@ -142,9 +145,27 @@ MessageMapEntry MessageMap::get(const QString &name) const
  */
 Core::MessageMapEntryList MessageMap::getAll(const QString &name) const
 {
-    return kdalgorithms::filtered(entries, [&name](const auto &entry) {
-        return entry.name == name;
-    });
+    return entriesAt(m_entriesByName.value(name));
+}
+
+/*!
+ * \qmlmethod list<MessageMapEntry> MessageMap::getAllForId(string id)
+ *
+ * Gets all entries for the control or command `id`, which is their first parameter, like `ON_BN_CLICKED(IDC_OK,
+ * OnOk)`.
+ */
+Core::MessageMapEntryList MessageMap::getAllForId(const QString &id) const
+{
+    return entriesAt(m_entriesById.value(id));
+}
+
+MessageMapEntryList MessageMap::entriesAt(const QList<int> &indexes) const
+{
+    MessageMapEntryList result;
+    result.reserve(indexes.size());
+    for (int index : indexes)
+        result.append(entries.at(index));
+    return result;
 }
 
 QString MessageMap::toString() const
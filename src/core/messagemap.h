@@ -12,6 +12,7 @@
 
 #include "rangemark.h"
 
+#include <QHash>
 #include <QObject>
 
 namespace Core {
@@ -59,6 +60,7 @@ public:
 
     Q_INVOKABLE Core::MessageMapEntry get(const QString &name) const;
     Q_INVOKABLE Core::MessageMapEntryList getAll(const QString &name) const;
+    Q_INVOKABLE Core::MessageMapEntryList getAllForId(const QString &id) const;
 
     Q_INVOKABLE QString toString() const;
 
@@ -66,6 +68,13 @@ public:
     QString superClass;
     QList<MessageMapEntry> entries;
     RangeMark range;
+
+private:
+    MessageMapEntryList entriesAt(const QList<int> &indexes) const;
+
+    // Indexes in entries, by name and by first parameter, in the order of the entries
+    QHash<QString, QList<int>> m_entriesByName;
+    QHash<QString, QList<int>> m_entriesById;
 };
 
 } // namespace core
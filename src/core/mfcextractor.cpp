@@ -0,0 +1,245 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "mfcextractor.h"
+#include "cppdocument_p.h"
+#include "treesitter/parser.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/utf8source.h"
+#include "utils/log.h"
+#include "utils/taskscheduler.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+
+namespace Core {
+
+namespace {
+
+struct MfcQueries
+{
+    std::shared_ptr<treesitter::Query> messageMap;
+    std::shared_ptr<treesitter::Query> doDataExchange;
+    std::shared_ptr<treesitter::Query> ddxCalls;
+    std::shared_ptr<treesitter::Query> ddvCalls;
+};
+
+// Captures of a tree-sitter match, by name
+class MatchCaptures
+{
+public:
+    MatchCaptures(const treesitter::QueryMatch &match, const QString &text)
+        : m_text(text)
+    {
+        const auto query = match.query();
+        for (const auto &capture : match.captures())
+            m_captures.emplace_back(query->captureAt(capture.id).name, capture.node);
+    }
+
+    std::optional<treesitter::Node> get(const QString &name) const
+    {
+        for (const auto &[captureName, node] : m_captures) {
+            if (captureName == name)
+                return node;
+        }
+        return {};
+    }
+    QString text(const QString &name) const
+    {
+        const auto node = get(name);
+        return node ? node->textIn(m_text) : QString();
+    }
+    // Same as QueryMatch::getAllInRange, an empty range returns all the captures
+    std::vector<treesitter::Node> getAll(const QString &name, const TextRange &range = {0, 0}) const
+    {
+        std::vector<treesitter::Node> nodes;
+        for (const auto &[captureName, node] : m_captures) {
+            const bool inRange = range.length() == 0
+                || (static_cast<int>(node.startPosition()) >= range.start
+                    && static_cast<int>(node.endPosition()) <= range.end);
+            if (captureName == name && inRange)
+                nodes.push_back(node);
+        }
+        return nodes;
+    }
+
+private:
+    const QString &m_text;
+    std::vector<std::pair<QString, treesitter::Node>> m_captures;
+};
+
+} // namespace
+
+static TextRange nodeRange(const treesitter::Node &node)
+{
+    return {.start = static_cast<int>(node.startPosition()), .end = static_cast<int>(node.endPosition())};
+}
+
+static std::vector<treesitter::QueryMatch> runQuery(const std::shared_ptr<treesitter::Query> &query,
+                                                    const treesitter::Node &node, const QString &text,
+                                                    bool firstOnly = false)
+{
+    treesitter::QueryCursor cursor;
+    cursor.execute(query, node, std::make_unique<treesitter::Predicates>(text));
+    std::vector<treesitter::QueryMatch> matches;
+    while (auto match = cursor.nextMatch()) {
+        matches.push_back(std::move(match).value());
+        if (firstOnly)
+            break;
+    }
+    return matches;
+}
+
+// Same data as CppDocument::mfcExtractMessageMap, with at most one message map per file
+static std::optional<std::pair<QString, MfcMessageMap>>
+extractMessageMap(const treesitter::Node &root, const QString &text, const MfcQueries &queries)
+{
+    const auto matches = runQuery(queries.messageMap, root, text, true);
+    if (matches.empty())
+        return {};
+
+    const MatchCaptures captures(matches.front(), text);
+    const auto begin = captures.get("begin");
+    const auto end = captures.get("end");
+    if (!begin || !end)
+        return {};
+
+    MfcMessageMap messageMap {.superClass = captures.text("superclass"),
+                              .range = {.start = static_cast<int>(begin->startPosition()),
+                                        .end = static_cast<int>(end->endPosition())}};
+    for (const auto &message : captures.getAll("message")) {
+        const auto range = nodeRange(message);
+        MfcMessageMapEntry entry {.range = range};
+        if (const auto names = captures.getAll("message-name", range); !names.empty())
+            entry.name = names.front().textIn(text);
+        for (const auto &parameter : captures.getAll("parameter", range))
+            entry.parameters.push_back(parameter.textIn(text));
+        messageMap.entries.push_back(std::move(entry));
+    }
+    return std::make_pair(captures.text("class"), std::move(messageMap));
+}
+
+// Same data as CppDocument::mfcExtractDDX, for all the DoDataExchange methods of the file
+static std::vector<std::pair<QString, MfcDataExchange>>
+extractDataExchanges(const treesitter::Node &root, const QString &text, const MfcQueries &queries)
+{
+    std::vector<std::pair<QString, MfcDataExchange>> result;
+    for (const auto &function : runQuery(queries.doDataExchange, root, text)) {
+        const MatchCaptures captures(function, text);
+        const auto body = captures.get("body");
+        const auto definition = captures.get("definition");
+        if (!body || !definition)
+            continue;
+
+        MfcDataExchange dataExchange {.range = nodeRange(*definition)};
+        for (const auto &call : runQuery(queries.ddxCalls, *body, text)) {
+            const MatchCaptures ddx(call, text);
+            dataExchange.entries.push_back(DataExchangeEntry {.function = ddx.text("ddx-function"),
+                                                              .idc = ddx.text("ddx-idc"),
+                                                              .member = ddx.text("ddx-member")});
+        }
+        for (const auto &call : runQuery(queries.ddvCalls, *body, text)) {
+            const MatchCaptures ddv(call, text);
+            DataValidationEntry entry {.function = ddv.text("ddv-function"), .member = ddv.text("ddv-member")};
+            for (const auto &argument : ddv.getAll("ddv-arguments"))
+                entry.arguments.push_back(argument.textIn(text));
+            dataExchange.validators.push_back(std::move(entry));
+        }
+        result.emplace_back(captures.text("scope"), std::move(dataExchange));
+    }
+    return result;
+}
+
+// Parses one file and extracts its MFC data. This is called from a worker thread, so it must not touch any QObject.
+static std::vector<MfcClassData> extractFile(const QString &fileName, const MfcQueries &queries)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    // Same text as what the TextDocument would load, so positions are valid once the file is opened
+    QTextStream stream(&file);
+    QString text = stream.readAll();
+    text.replace("\r\n", "\n");
+
+    // Quick check before parsing, most files of a project don't have any MFC data
+    if (!text.contains("BEGIN_MESSAGE_MAP") && !text.contains("DoDataExchange"))
+        return {};
+
+    const auto source = std::make_shared<treesitter::Utf8Source>(text);
+    treesitter::PooledParser parser(treesitter::Parser::getLanguage(Document::Type::Cpp));
+    const auto tree = parser->parseUtf8(source);
+    if (!tree)
+        return {};
+    const auto root = tree->rootNode();
+
+    std::vector<MfcClassData> result;
+    auto classData = [&](const QString &className) -> MfcClassData & {
+        auto it = std::ranges::find(result, className, &MfcClassData::className);
+        if (it != result.end())
+            return *it;
+        return result.emplace_back(MfcClassData {.className = className, .fileName = fileName});
+    };
+    if (auto messageMap = extractMessageMap(root, text, queries))
+        classData(messageMap->first).messageMap = std::move(messageMap->second);
+    for (auto &[className, dataExchange] : extractDataExchanges(root, text, queries))
+        classData(className).dataExchange = std::move(dataExchange);
+    return result;
+}
+
+MfcClassDataMap extractMfcData(const QStringList &files)
+{
+    MfcQueries queries;
+    try {
+        auto *language = treesitter::Parser::getLanguage(Document::Type::Cpp);
+        auto &cache = treesitter::QueryCache::instance();
+        queries = {.messageMap = cache.get(language, Queries::mfcMessageMap(false)),
+                   .doDataExchange = cache.get(language, Queries::mfcDoDataExchange),
+                   .ddxCalls = cache.get(language, Queries::mfcDDXCalls),
+                   .ddvCalls = cache.get(language, Queries::mfcDDVCalls)};
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("extractMfcData - failed to parse a MFC query, error: {} at: {}", error.description,
+                      error.utf8_offset);
+        return {};
+    }
+
+    std::vector<std::vector<MfcClassData>> results(files.size());
+    Utils::TaskGroup tasks;
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        tasks.start([&, i]() {
+            results[i] = extractFile(files.at(i), queries);
+        });
+    }
+    tasks.wait();
+
+    // A class may have its message map and DDX in different files, but each of them should be unique
+    MfcClassDataMap classes;
+    for (auto &fileClasses : results) {
+        for (auto &data : fileClasses) {
+            auto [it, inserted] = classes.try_emplace(data.className, data);
+            if (inserted)
+                continue;
+            auto &existing = it->second;
+            if (data.messageMap && existing.messageMap)
+                spdlog::warn("extractMfcData - multiple message maps for class {}", data.className);
+            else if (data.messageMap)
+                existing.messageMap = std::move(data.messageMap);
+            if (data.dataExchange && existing.dataExchange)
+                spdlog::warn("extractMfcData - multiple DoDataExchange methods for class {}", data.className);
+            else if (data.dataExchange)
+                existing.dataExchange = std::move(data.dataExchange);
+        }
+    }
+    return classes;
+}
+
+} // namespace Core
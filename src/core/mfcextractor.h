@@ -0,0 +1,70 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "dataexchange.h"
+#include "textrange.h"
+#include "utils/json.h"
+
+#include <QString>
+#include <QStringList>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace Core {
+
+// MFC data extracted from files without opening them as documents, unlike MessageMap and DataExchange the data is
+// not attached to a document: ranges are the positions in the file at the time of the extraction.
+struct MfcMessageMapEntry
+{
+    QString name;
+    QStringList parameters;
+    TextRange range;
+};
+
+struct MfcMessageMap
+{
+    QString superClass;
+    std::vector<MfcMessageMapEntry> entries;
+    TextRange range;
+};
+
+struct MfcDataExchange
+{
+    std::vector<DataExchangeEntry> entries;
+    std::vector<DataValidationEntry> validators;
+    TextRange range;
+};
+
+struct MfcClassData
+{
+    QString className;
+    QString fileName;
+    std::optional<MfcMessageMap> messageMap;
+    std::optional<MfcDataExchange> dataExchange;
+};
+
+using MfcClassDataMap = std::map<QString, MfcClassData>;
+
+// Extracts the message maps and DDX of all the classes in `files`. Files are processed in parallel, each file is
+// parsed once for both the message map and the DDX queries.
+MfcClassDataMap extractMfcData(const QStringList &files);
+
+JSONIFY(TextRange, start, end);
+JSONIFY(DataExchangeEntry, function, idc, member);
+JSONIFY(DataValidationEntry, function, member, arguments);
+JSONIFY(MfcMessageMapEntry, name, parameters, range);
+JSONIFY(MfcMessageMap, superClass, entries, range);
+JSONIFY(MfcDataExchange, entries, validators, range);
+JSONIFY(MfcClassData, className, fileName, messageMap, dataExchange);
+
+} // namespace Core
@@ -0,0 +1,480 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "pipeline.h"
+#include "dryrun.h"
+#include "project_p.h"
+#include "projectquerymatch.h"
+#include "textdocument.h"
+#include "textdocument_p.h"
+#include "treesitter/parser.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/utf8source.h"
+#include "utils/log.h"
+#include "utils/taskscheduler.h"
+
+#include <QJSEngine>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace Core {
+
+/*!
+ * \qmltype Pipeline
+ * \brief Runs the stages of a migration on a list of files concurrently.
+ * \inqmlmodule Script
+ * \ingroup Utilities
+ * \sa Project::pipeline
+ *
+ * A pipeline reads the files, parses and queries them on worker threads, calls the `map` functions on the script
+ * thread, then computes their new text and writes them on worker threads again. Each stage works on the next files
+ * while the following stage takes care of the previous ones:
+ *
+ * ```js
+ * let saved = Project.pipeline(Project.allFilesWithExtension("cpp", Project.FullPath))
+ *     .query("(call_expression function: (identifier) @name (#eq? @name \"oldFunction\")) @call")
+ *     .map(item => item.matches.map(match => {
+ *         let range = match.get("name").range;
+ *         return {start: range.start, end: range.end, text: "newFunction"};
+ *     }))
+ *     .apply()
+ *     .save();
+ * ```
+ *
+ * The stages are, in that order:
+ *
+ * - `parse()`: parses the files with Tree-sitter, only the C++ and QML files go through
+ * - `query(query)`: runs a Tree-sitter query on the files, implies `parse()`
+ * - `map(function)`: calls `function` on each file, see below
+ * - `apply()`: computes the new text of the files from the result of the last `map` function
+ * - `save()`: writes the files changed, and runs the pipeline
+ *
+ * The `map` functions are called with an object with the properties `fileName`, `text`, `matches` (the
+ * `ProjectQueryMatch` of the query, if any) and `value` (the result of the previous `map` function, if any). A file is
+ * dropped from the pipeline if a function returns `undefined`, `null` or `false`. Before `apply()`, the last function
+ * returns either the new text of the file, or a list of edits `{start, end, text}` in the text given.
+ *
+ * Each stage only takes a bounded number of files ahead of the next one, so memory stays under control whatever the
+ * number of files, and the script doesn't wait for the files to be read. Files opened in the project are read and
+ * changed through their document instead, and are not saved.
+ */
+
+struct Pipeline::Item
+{
+    qsizetype index = 0;
+    Utils::DecodedText fileText;
+    // Query of the language of the file, only set if it's queried
+    std::shared_ptr<treesitter::Query> query;
+    ProjectQueryMatchList matches;
+    // Result of the last map function
+    QVariant value;
+    QString newText;
+    int editCount = 0;
+    bool fromDocument = false;
+    bool dropped = false;
+};
+
+struct Pipeline::State
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<bool> prepared;
+    // Items prepared and not taken yet, in the order they are done: only used if the results are not ordered
+    std::deque<qsizetype> preparedOrder;
+    int writing = 0;
+};
+
+Pipeline::Pipeline(std::vector<Input> inputs, Options options)
+    : m_inputs(std::move(inputs))
+    , m_options(options)
+{
+}
+
+Pipeline::~Pipeline() = default;
+
+Pipeline::Options Pipeline::optionsFromMap(const QVariantMap &map)
+{
+    return {.ordered = map.value("ordered", true).toBool(), .window = map.value("window", 0).toInt()};
+}
+
+bool Pipeline::checkStage(const char *function, bool isValid, const char *error) const
+{
+    if (m_hasRun)
+        spdlog::error("{} - the pipeline has already run", function);
+    else if (!isValid)
+        spdlog::error("{} - {}", function, error);
+    return !m_hasRun && isValid;
+}
+
+/*!
+ * \qmlmethod Pipeline Pipeline::parse()
+ * Parses the files with Tree-sitter on the worker threads. The files that aren't C++ or QML are dropped.
+ */
+Pipeline *Pipeline::parse()
+{
+    LOG("Pipeline::parse");
+    if (checkStage("Pipeline::parse", m_maps.empty(), "the files must be parsed before the map functions"))
+        m_parse = true;
+    return this;
+}
+
+/*!
+ * \qmlmethod Pipeline Pipeline::query(string query)
+ * Runs the Tree-sitter `query` on the files on the worker threads, the matches are given to the `map` functions.
+ */
+Pipeline *Pipeline::query(const QString &query)
+{
+    LOG("Pipeline::query", query);
+    if (checkStage("Pipeline::query", m_maps.empty(), "the files must be queried before the map functions")) {
+        m_parse = true;
+        m_query = query;
+    }
+    return this;
+}
+
+/*!
+ * \qmlmethod Pipeline Pipeline::map(function function)
+ * Calls `function` on each file on the script thread, in the order of the files if the results are ordered.
+ */
+Pipeline *Pipeline::map(const QJSValue &function)
+{
+    LOG("Pipeline::map");
+    if (checkStage("Pipeline::map", function.isCallable(), "the map stage needs a function")
+        && checkStage("Pipeline::map", !m_apply, "the map functions must come before apply"))
+        m_maps.push_back(function);
+    return this;
+}
+
+/*!
+ * \qmlmethod Pipeline Pipeline::apply()
+ * Computes the new text of each file on the worker threads, from the result of the last `map` function.
+ */
+Pipeline *Pipeline::apply()
+{
+    LOG("Pipeline::apply");
+    if (checkStage("Pipeline::apply", !m_maps.empty(), "apply needs a map function giving the changes"))
+        m_apply = true;
+    return this;
+}
+
+static QVariantList matchesVariant(const ProjectQueryMatchList &matches)
+{
+    QVariantList result;
+    result.reserve(matches.size());
+    for (const auto &match : matches)
+        result.append(QVariant::fromValue(match));
+    return result;
+}
+
+void Pipeline::prepare(Item &item) const
+{
+    const auto &input = m_inputs[item.index];
+    if (!item.fromDocument) {
+        auto fileText = readFileText(input.fileName);
+        if (!fileText) {
+            spdlog::error("Pipeline::run - can't read file {}", input.fileName);
+            item.dropped = true;
+            return;
+        }
+        item.fileText = std::move(*fileText);
+    }
+    if (!m_parse)
+        return;
+
+    // The tree is never edited, so it can be parsed from UTF-8, like Project::queryAll does
+    const auto &text = item.fileText.text;
+    treesitter::PooledParser parser(treesitter::Parser::getLanguage(input.type));
+    const auto tree = parser->parseUtf8(std::make_shared<treesitter::Utf8Source>(text));
+    if (!tree) {
+        spdlog::error("Pipeline::run - can't parse file {}", input.fileName);
+        item.dropped = true;
+        return;
+    }
+    if (!item.query)
+        return;
+
+    treesitter::QueryCursor cursor;
+    cursor.execute(item.query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text));
+    for (const auto &match : cursor.allRemainingMatches())
+        item.matches.push_back(ProjectQueryMatch(input.fileName, text, match));
+}
+
+bool Pipeline::callMaps(Item &item)
+{
+    if (m_maps.empty())
+        return true;
+    auto *engine = qjsEngine(this);
+    if (!engine) {
+        spdlog::error("Pipeline::run - the map functions can only be called from a script");
+        return false;
+    }
+
+    const auto &fileName = m_inputs[item.index].fileName;
+    QVariantMap object {{"fileName", fileName}, {"text", item.fileText.text}};
+    if (!m_query.isEmpty())
+        object.insert("matches", matchesVariant(item.matches));
+    auto argument = engine->toScriptValue(object);
+    QJSValue value;
+    for (const auto &function : m_maps) {
+        value = function.call({argument});
+        if (value.isError()) {
+            spdlog::error("Pipeline::run - {}: {}", fileName, value.toString());
+            return false;
+        }
+        if (value.isUndefined() || value.isNull() || (value.isBool() && !value.toBool())) {
+            item.dropped = true;
+            return true;
+        }
+        argument.setProperty("value", value);
+    }
+    item.value = value.toVariant();
+    return true;
+}
+
+void Pipeline::write(Item &item) const
+{
+    const auto &input = m_inputs[item.index];
+    const QString &text = item.fileText.text;
+    if (item.value.metaType() == QMetaType::fromType<QString>()) {
+        item.newText = item.value.toString();
+        item.editCount = 1;
+    } else if (item.value.metaType() == QMetaType::fromType<QVariantList>()) {
+        std::vector<TextReplacement> replacements;
+        for (const auto &edit : item.value.toList()) {
+            const auto map = edit.toMap();
+            replacements.push_back({.start = map.value("start", -1).toInt(),
+                                    .end = map.value("end", -1).toInt(),
+                                    .text = map.value("text").toString()});
+        }
+        std::ranges::sort(replacements, {}, &TextReplacement::start);
+        int position = 0;
+        for (const auto &replacement : replacements) {
+            if (replacement.start < position || replacement.end < replacement.start || replacement.end > text.size()) {
+                spdlog::error("Pipeline::apply - {}: invalid or overlapping edit from {} to {}", input.fileName,
+                              replacement.start, replacement.end);
+                item.dropped = true;
+                return;
+            }
+            item.newText.append(QStringView(text).sliced(position, replacement.start - position));
+            item.newText.append(replacement.text);
+            position = replacement.end;
+        }
+        item.newText.append(QStringView(text).sliced(position));
+        item.editCount = static_cast<int>(replacements.size());
+    } else {
+        spdlog::error("Pipeline::apply - {}: the map function must return the new text or a list of edits",
+                      input.fileName);
+        item.dropped = true;
+        return;
+    }
+
+    if (item.newText == text) {
+        item.editCount = 0;
+        return;
+    }
+    if (item.fromDocument) {
+        // Only called on the script thread for the documents
+        if (input.document)
+            input.document->setText(item.newText);
+        else
+            item.dropped = true;
+    } else if (m_save && !DryRun::isEnabled()
+               && !writeFileText(input.fileName, item.fileText, item.newText, "Pipeline::save")) {
+        item.dropped = true;
+    }
+}
+
+/*!
+ * \qmlmethod array<object> Pipeline::run()
+ * Runs the pipeline, and returns an object for each file that went through all the stages.
+ *
+ * Each object has the property `fileName`, and depending on the stages:
+ *
+ * - `matches`: the matches of the query in the file
+ * - `value`: the result of the last `map` function, without `apply()`
+ * - `edits`: the number of edits made, with `apply()`
+ * - `text`: the new text of the file, with `apply()` but without `save()`, if it's not opened as a document
+ *
+ * The objects are in the order of the files, unless the `ordered` option of the pipeline is false. A pipeline can only
+ * run once. If a `map` function throws an exception, the pipeline stops and returns the files done so far.
+ */
+QVariantList Pipeline::run()
+{
+    LOG("Pipeline::run");
+    if (!checkStage("Pipeline::run", true, ""))
+        return {};
+    m_hasRun = true;
+
+    // Queries are compiled once per language, and shared by all the workers
+    std::unordered_map<Document::Type, std::shared_ptr<treesitter::Query>> queries;
+    std::vector<Item> items(m_inputs.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        auto &item = items[i];
+        const auto &input = m_inputs[i];
+        item.index = static_cast<qsizetype>(i);
+        if (m_parse && input.type != Document::Type::Cpp && input.type != Document::Type::Qml) {
+            item.dropped = true;
+            continue;
+        }
+        if (!m_query.isEmpty() && !queries.contains(input.type)) {
+            try {
+                queries[input.type] =
+                    treesitter::QueryCache::instance().get(treesitter::Parser::getLanguage(input.type), m_query);
+            } catch (treesitter::Query::Error &error) {
+                spdlog::error("Pipeline::query - failed to parse query `{}` error: {} at: {}", m_query,
+                              error.description, error.utf8_offset);
+                return {};
+            }
+        }
+        if (!m_query.isEmpty())
+            item.query = queries.at(input.type);
+        // Documents can only be used on this thread, their text is shared with the workers
+        if (input.document) {
+            item.fileText.text = input.document->plainText();
+            item.fromDocument = true;
+        }
+    }
+
+    const qsizetype count = static_cast<qsizetype>(items.size());
+    const int window = m_options.window > 0 ? m_options.window : 2 * Utils::TaskScheduler::threadCount();
+    State state;
+    state.prepared.resize(items.size(), false);
+    Utils::TaskGroup prepareTasks;
+    Utils::TaskGroup writeTasks;
+
+    std::vector<qsizetype> order;
+    order.reserve(count);
+    qsizetype started = 0;
+    while (static_cast<qsizetype>(order.size()) < count) {
+        // The workers only prepare a window of files ahead of the script
+        for (; started < count && started - static_cast<qsizetype>(order.size()) < window; ++started) {
+            prepareTasks.start([this, &items, &state, index = started]() {
+                if (!items[index].dropped)
+                    prepare(items[index]);
+                std::lock_guard lock(state.mutex);
+                state.prepared[index] = true;
+                if (!m_options.ordered)
+                    state.preparedOrder.push_back(index);
+                state.changed.notify_all();
+            });
+        }
+
+        qsizetype index;
+        {
+            std::unique_lock lock(state.mutex);
+            const auto next = static_cast<qsizetype>(order.size());
+            state.changed.wait(lock, [&]() {
+                return m_options.ordered ? state.prepared[next] : !state.preparedOrder.empty();
+            });
+            if (m_options.ordered) {
+                index = next;
+            } else {
+                index = state.preparedOrder.front();
+                state.preparedOrder.pop_front();
+            }
+        }
+        order.push_back(index);
+
+        auto &item = items[index];
+        if (item.dropped)
+            continue;
+        if (!callMaps(item)) {
+            order.pop_back();
+            prepareTasks.cancel();
+            break;
+        }
+        if (item.dropped || !m_apply) {
+            item.fileText = {};
+            continue;
+        }
+        if (item.fromDocument) {
+            write(item);
+            continue;
+        }
+        {
+            std::unique_lock lock(state.mutex);
+            state.changed.wait(lock, [&]() {
+                return state.writing < window;
+            });
+            ++state.writing;
+        }
+        writeTasks.start([this, &items, &state, index]() {
+            auto &item = items[index];
+            write(item);
+            item.fileText.text.clear();
+            // The new text is still needed without save, or for the patch of a dry run
+            if (m_save && !DryRun::isEnabled())
+                item.newText.clear();
+            std::lock_guard lock(state.mutex);
+            --state.writing;
+            state.changed.notify_all();
+        });
+    }
+    prepareTasks.wait();
+    writeTasks.wait();
+
+    // Not on the workers, the changes of a dry run can only be added from one thread
+    if (m_save && DryRun::isEnabled()) {
+        for (const auto index : order) {
+            auto &item = items[index];
+            if (!item.dropped && !item.fromDocument && item.editCount)
+                DryRun::addChange(m_inputs[index].fileName, std::move(item.newText), item.fileText.encoding,
+                                  item.fileText.crlf);
+        }
+    }
+
+    QVariantList results;
+    for (const auto index : order) {
+        const auto &item = items[index];
+        if (item.dropped)
+            continue;
+        QVariantMap result {{"fileName", m_inputs[index].fileName}};
+        if (!m_query.isEmpty())
+            result.insert("matches", matchesVariant(item.matches));
+        if (!m_maps.empty() && !m_apply)
+            result.insert("value", item.value);
+        if (m_apply)
+            result.insert("edits", item.editCount);
+        if (m_apply && !m_save && !item.fromDocument)
+            result.insert("text", item.newText);
+        results.append(result);
+    }
+    return results;
+}
+
+/*!
+ * \qmlmethod object Pipeline::save()
+ * Writes the files changed by `apply()`, runs the pipeline, and returns a map of the files changed with the number of
+ * edits made in each one.
+ *
+ * The files are written atomically on the worker threads, keeping their line endings and encoding. In dry-run mode,
+ * the changes are added to the patch instead.
+ */
+QVariantMap Pipeline::save()
+{
+    LOG("Pipeline::save");
+    if (!checkStage("Pipeline::save", m_apply, "save needs apply to change the files"))
+        return {};
+    m_save = true;
+
+    QVariantMap result;
+    for (const auto &value : run()) {
+        const auto map = value.toMap();
+        if (const int edits = map.value("edits").toInt())
+            result.insert(map.value("fileName").toString(), edits);
+    }
+    return result;
+}
+
+} // namespace Core
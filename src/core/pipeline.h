@@ -0,0 +1,84 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "document.h"
+
+#include <QJSValue>
+#include <QObject>
+#include <QPointer>
+#include <QVariantList>
+#include <QVariantMap>
+#include <memory>
+#include <vector>
+
+namespace Core {
+
+class TextDocument;
+
+class Pipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Input
+    {
+        // Absolute path
+        QString fileName;
+        Document::Type type = Document::Type::Text;
+        // Set if the file is opened in the project, it's then read and changed through its document
+        QPointer<TextDocument> document;
+    };
+
+    struct Options
+    {
+        // Results in the order of the files, otherwise in the order they are done
+        bool ordered = true;
+        // Files in each stage at most, waiting for the next stage to take them, 0 for twice the thread count
+        int window = 0;
+    };
+
+    Pipeline(std::vector<Input> inputs, Options options);
+    ~Pipeline() override;
+
+    static Options optionsFromMap(const QVariantMap &map);
+
+    Q_INVOKABLE Core::Pipeline *parse();
+    Q_INVOKABLE Core::Pipeline *query(const QString &query);
+    Q_INVOKABLE Core::Pipeline *map(const QJSValue &function);
+    Q_INVOKABLE Core::Pipeline *apply();
+
+    Q_INVOKABLE QVariantList run();
+    Q_INVOKABLE QVariantMap save();
+
+private:
+    struct Item;
+    struct State;
+    // Reads the file, and parses and queries it if needed: called on a worker thread
+    void prepare(Item &item) const;
+    // Calls the map functions on the thread of the script, returns false if one of them failed
+    bool callMaps(Item &item);
+    // Computes the new text of the file from the result of the map functions, and writes it if needed: called on a
+    // worker thread, unless the file is opened as a document
+    void write(Item &item) const;
+    bool checkStage(const char *function, bool isValid, const char *error) const;
+
+    std::vector<Input> m_inputs;
+    Options m_options;
+    bool m_parse = false;
+    QString m_query;
+    std::vector<QJSValue> m_maps;
+    bool m_apply = false;
+    bool m_save = false;
+    bool m_hasRun = false;
+};
+
+} // namespace Core
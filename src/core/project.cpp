@@ -9,28 +9,56 @@
 */
 
 #include "project.h"
+#include "codedocument_p.h"
 #include "cppdocument.h"
+#include "documentprefetcher.h"
+#include "dryrun.h"
 #include "imagedocument.h"
 #include "jsondocument.h"
 #include "logger.h"
+#include "mfcextractor.h"
 #include "lsp/client.h"
+#include "lsp/requestprofiler.h"
 #include "project_p.h"
 #include "qmldocument.h"
 #include "qttsdocument.h"
 #include "qtuidocument.h"
+#include "queryresultcache.h"
 #include "rcdocument.h"
 #include "settings.h"
 #include "slintdocument.h"
 #include "textdocument.h"
+#include "textdocument_p.h"
+#include "treesitter/parser.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/transformation.h"
+#include "treesitter/utf8source.h"
+#include "utils/cancellation.h"
+#include "utils/counters.h"
 #include "utils/log.h"
+#include "utils/taskscheduler.h"
+#include "utils/textcodec.h"
+#include "utils/trace.h"
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QJsonDocument>
 #include <QMetaEnum>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QThread>
+#include <QtQml/private/qqmldata_p.h>
 #include <algorithm>
+#include <array>
 #include <kdalgorithms.h>
 #include <map>
+#include <ranges>
 #include <unordered_set>
 
 namespace Core {
@@ -68,10 +96,16 @@ Project::~Project()
 {
     m_instance = nullptr;
 
+    // Waits for the files still being read
+    m_prefetcher.reset();
+    m_diskCheckTasks.wait();
     closeAll();
 
-    for (auto client : m_lspClients | std::views::values)
-        client->shutdown();
+    // All the servers exit in parallel in the background, a server still initializing is terminated
+    for (auto client : m_lspClients | std::views::values) {
+        if (client->state() == Lsp::Client::Initialized)
+            client->shutdownAsync();
+    }
 }
 
 Project *Project::instance()
@@ -101,13 +135,233 @@ bool Project::setRoot(const QString &newRoot)
 
     m_root = dir.absolutePath();
     Settings::instance()->loadProjectSettings(m_root);
+
+    m_fileWatcher = new QFileSystemWatcher(this);
+    connect(m_fileWatcher, &QFileSystemWatcher::directoryChanged, this, &Project::updateDirectoryInIndex);
+    // Editing an ignore file in place doesn't change its directory
+    connect(m_fileWatcher, &QFileSystemWatcher::fileChanged, this, [this](const QString &file) {
+        updateDirectoryInIndex(QFileInfo(file).absolutePath());
+    });
+    indexDirectory(m_root);
+
     for (auto client : m_lspClients | std::views::values)
         client->openProject(m_root);
+    startClients();
 
     emit rootChanged();
     return true;
 }
 
+static QString relativeToRoot(const QString &root, const QString &path)
+{
+    return path.size() > root.size() ? path.mid(root.size() + 1) : QString();
+}
+
+// Lists the files and subdirectories directly in `path`, except the ignored ones.
+static void scanDirectory(const QString &path, const QString &relativePath, const Utils::IgnoreMatcher &ignoreMatcher,
+                          QStringList &files, QStringList &directories)
+{
+    const QString prefix = relativePath.isEmpty() ? QString() : relativePath + '/';
+    QDirIterator it(path, QDir::AllEntries | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const auto fi = it.fileInfo();
+        // Ignored directories are never scanned, however large they are
+        if (ignoreMatcher.isIgnored(QString(prefix + it.fileName()), fi.isDir()))
+            continue;
+        if (fi.isFile())
+            files.push_back(fi.absoluteFilePath());
+        // Same as QDirIterator::Subdirectories, symbolic links to directories are not followed
+        else if (fi.isDir() && !fi.isSymLink())
+            directories.push_back(fi.absoluteFilePath());
+    }
+}
+
+constexpr std::array IgnoreFileNames = {".gitignore", ".knutignore"};
+
+// Reads the patterns of the ignore files (`.gitignore` and `.knutignore`) in `path`, with the `/project/exclude`
+// setting for the root, and watches the ignore files. Returns true if they changed.
+bool Project::updateIgnorePatterns(const QString &path)
+{
+    QStringList patterns;
+    if (path == m_root)
+        patterns = DEFAULT_VALUE(QStringList, ProjectExclude);
+    const auto watchedFiles = m_fileWatcher->files();
+    for (const auto &name : IgnoreFileNames) {
+        const QString fileName = path + '/' + name;
+        patterns.append(Utils::IgnoreMatcher::readPatterns(fileName));
+        // A file replaced by a new one is not watched anymore, it's watched again from the directory change
+        if (QFileInfo::exists(fileName) && !watchedFiles.contains(fileName))
+            m_fileWatcher->addPath(fileName);
+    }
+    return m_ignoreMatcher.setPatterns(relativeToRoot(m_root, path), patterns);
+}
+
+// Adds the directory `path` and all its subdirectories to the file index.
+void Project::indexDirectory(const QString &path)
+{
+    updateIgnorePatterns(path);
+    QStringList files;
+    QStringList directories;
+    scanDirectory(path, relativeToRoot(m_root, path), m_ignoreMatcher, files, directories);
+    m_directoryFiles[path] = std::move(files);
+    m_fileWatcher->addPath(path);
+
+    for (const auto &directory : std::as_const(directories))
+        indexDirectory(directory);
+
+    m_allFiles.reset();
+    m_filesBySuffix.clear();
+    m_filesByBaseName.reset();
+    m_symbolIndexUpToDate = false;
+    m_includeIndexUpToDate = false;
+}
+
+// Removes the directory `path` and all its subdirectories from the file index.
+void Project::removeDirectoryFromIndex(const QString &path)
+{
+    const QString prefix = path + '/';
+    for (auto it = m_directoryFiles.begin(); it != m_directoryFiles.end();) {
+        if (it->first == path || it->first.startsWith(prefix)) {
+            m_fileWatcher->removePath(it->first);
+            for (const auto &name : IgnoreFileNames)
+                m_fileWatcher->removePath(it->first + '/' + name);
+            it = m_directoryFiles.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_ignoreMatcher.removePatterns(relativeToRoot(m_root, path));
+
+    m_allFiles.reset();
+    m_filesBySuffix.clear();
+    m_filesByBaseName.reset();
+    m_symbolIndexUpToDate = false;
+    m_includeIndexUpToDate = false;
+}
+
+void Project::updateDirectoryInIndex(const QString &path)
+{
+    if (!QFileInfo(path).isDir()) {
+        removeDirectoryFromIndex(path);
+        return;
+    }
+
+    // A change in the ignore files may change what's ignored in all the subdirectories
+    if (updateIgnorePatterns(path)) {
+        removeDirectoryFromIndex(path);
+        indexDirectory(path);
+        return;
+    }
+
+    // Only the direct content of the directory is scanned again, new subdirectories are indexed recursively.
+    QStringList files;
+    QStringList directories;
+    scanDirectory(path, relativeToRoot(m_root, path), m_ignoreMatcher, files, directories);
+
+    // Remove the subdirectories that don't exist anymore
+    const QString prefix = path + '/';
+    QStringList removedDirectories;
+    for (const auto &[directory, _] : m_directoryFiles) {
+        if (directory.startsWith(prefix) && !directory.mid(prefix.size()).contains('/')
+            && !directories.contains(directory))
+            removedDirectories.push_back(directory);
+    }
+    for (const auto &directory : std::as_const(removedDirectories))
+        removeDirectoryFromIndex(directory);
+
+    for (const auto &directory : std::as_const(directories)) {
+        if (!m_directoryFiles.contains(directory))
+            indexDirectory(directory);
+    }
+
+    m_directoryFiles[path] = std::move(files);
+    m_allFiles.reset();
+    m_filesBySuffix.clear();
+    m_filesByBaseName.reset();
+    m_symbolIndexUpToDate = false;
+    m_includeIndexUpToDate = false;
+}
+
+void Project::updateIndexForPath(const QString &path)
+{
+    if (!m_instance || m_instance->m_root.isEmpty())
+        return;
+
+    const QString &root = m_instance->m_root;
+    QString directory = QFileInfo(path).absolutePath();
+    if (directory != root && !directory.startsWith(root + '/'))
+        return;
+    // New directories (mkpath) are indexed from their first indexed ancestor, removed ones (rmpath) from the first one
+    // still existing
+    while (directory != root && (!m_instance->m_directoryFiles.contains(directory) || !QFileInfo(directory).isDir()))
+        directory = QFileInfo(directory).absolutePath();
+    m_instance->updateDirectoryInIndex(directory);
+}
+
+/**
+ * \brief Returns all the files of the project, sorted, using absolute paths
+ *
+ * The list is built from the file index on the first call and kept until the index changes, so it's cheap to call
+ * again, and callers can check with `QStringList::isSharedWith` that the index hasn't changed.
+ */
+const QStringList &Project::indexedFiles() const
+{
+    if (!m_allFiles) {
+        QStringList files;
+        for (const auto &directoryFiles : m_directoryFiles | std::views::values)
+            files.append(directoryFiles);
+        std::ranges::sort(files);
+        m_allFiles = std::move(files);
+    }
+    return *m_allFiles;
+}
+
+// Returns all the files with the given suffix, case-insensitive, sorted.
+const QStringList &Project::indexedFilesWithSuffix(const QString &suffix) const
+{
+    const auto key = suffix.toLower();
+    auto it = m_filesBySuffix.find(key);
+    if (it == m_filesBySuffix.end()) {
+        const auto files = kdalgorithms::filtered(indexedFiles(), [&key](const QString &file) {
+            return QFileInfo(file).suffix().toLower() == key;
+        });
+        it = m_filesBySuffix.emplace(key, files).first;
+    }
+    return it->second;
+}
+
+/**
+ * \brief Returns the files of the project with the given complete base name, compared case insensitively
+ *
+ * The files are sorted and use absolute paths. The lookup is done in a map of all the files by base name, built on the
+ * first call and kept until the index changes.
+ */
+const QStringList &Project::indexedFilesWithBaseName(const QString &baseName) const
+{
+    if (!m_filesByBaseName) {
+        std::unordered_map<QString, QStringList> filesByBaseName;
+        for (const auto &file : indexedFiles())
+            filesByBaseName[QFileInfo(file).completeBaseName().toLower()].push_back(file);
+        m_filesByBaseName = std::move(filesByBaseName);
+    }
+
+    static const QStringList empty;
+    auto it = m_filesByBaseName->find(baseName.toLower());
+    return it == m_filesByBaseName->end() ? empty : it->second;
+}
+
+QStringList Project::toPathType(const QStringList &files, PathType type) const
+{
+    if (type == FullPath)
+        return files;
+
+    const QDir dir(m_root);
+    return kdalgorithms::transformed(files, [&dir](const QString &file) {
+        return dir.relativeFilePath(file);
+    });
+}
+
 /*!
  * \qmlmethod array<string> Project::allFiles(PathType type = RelativeToRoot)
  * Returns all files in the current project.
@@ -115,6 +369,10 @@ bool Project::setRoot(const QString &newRoot)
  *
  * - `Project.FullPath`
  * - `Project.RelativeToRoot`
+ *
+ * The files ignored by the `.gitignore` and `.knutignore` files, or by the `/project/exclude` setting, are not part of
+ * the project. The files created, removed or renamed by the script (`Document.saveAs`, `File` and `Dir` methods) are
+ * taken into account right away.
  */
 QStringList Project::allFiles(PathType type) const
 {
@@ -123,17 +381,7 @@ QStringList Project::allFiles(PathType type) const
 
     LOG("Project::allFiles", type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile())
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
-    }
-    std::ranges::sort(result);
-    return result;
+    return toPathType(indexedFiles(), type);
 }
 
 /*!
@@ -151,17 +399,11 @@ QStringList Project::allFilesWithExtension(const QString &extension, PathType ty
 
     LOG("Project::allFilesWithExtension", extension, type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
-    QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile() && fi.suffix() == extension)
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
-    }
-    std::ranges::sort(result);
-    return result;
+    // The index is case-insensitive, but this method is case-sensitive
+    const auto files = kdalgorithms::filtered(indexedFilesWithSuffix(extension), [&extension](const QString &file) {
+        return QFileInfo(file).suffix() == extension;
+    });
+    return toPathType(files, type);
 }
 
 /*!
@@ -179,31 +421,835 @@ QStringList Project::allFilesWithExtensions(const QStringList &extensions, PathT
 
     LOG("Project::allFilesWithExtensions", extensions, type);
 
-    QDir dir(m_root);
-    QDirIterator it(m_root, QDirIterator::Subdirectories);
     QStringList result;
-    while (it.hasNext()) {
-        it.next();
-        auto fi = it.fileInfo();
-        if (fi.isFile() && extensions.contains(fi.suffix(), Qt::CaseInsensitive))
-            result.push_back(type == FullPath ? fi.absoluteFilePath() : dir.relativeFilePath(fi.absoluteFilePath()));
+    std::unordered_set<QString> suffixes;
+    for (const auto &extension : extensions) {
+        if (suffixes.insert(extension.toLower()).second)
+            result.append(indexedFilesWithSuffix(extension));
     }
     std::ranges::sort(result);
-    return result;
+    return toPathType(result, type);
 }
 
-static Document *createDocument(const QString &suffix)
+static Document::Type documentType(const QString &suffix)
 {
-    static const auto mimeTypes =
-        Settings::instance()->value<std::map<std::string, Document::Type>>(Settings::MimeTypes);
+    const auto &mimeTypes = Settings::instance()->snapshot().mimeTypes;
 
     auto it = mimeTypes.find(suffix.toStdString());
     if (it == mimeTypes.end()) {
         // No mime found, so, just open it as text
-        return new TextDocument();
+        return Document::Type::Text;
+    }
+    return it->second;
+}
+
+std::optional<Utils::DecodedText> readFileText(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    const QByteArray data = file.readAll();
+    file.close();
+
+    auto result = Utils::decodeText(data, Settings::instance()->snapshot().fallbackEncoding);
+    result.text.replace("\r\n", "\n");
+    return result;
+}
+
+bool writeFileText(const QString &fileName, const Utils::DecodedText &fileText, QString newText, const char *function)
+{
+    if (fileText.crlf)
+        newText.replace('\n', "\r\n");
+
+    QSaveFile saveFile(fileName);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        spdlog::error("{} - can't write file {}", function, fileName);
+        return false;
     }
+    if (fileText.utf8Bom)
+        saveFile.write("\xef\xbb\xbf", 3);
+    QByteArray data;
+    Utils::appendEncodedText(data, newText, fileText.encoding);
+    saveFile.write(data);
+    if (!saveFile.commit()) {
+        spdlog::error("{} - can't write file {}", function, fileName);
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+    // New text of a file changed by a worker during a dry run. DryRun is only used from the main thread, so the change
+    // is added by the caller once the workers are done.
+    struct DryRunChange
+    {
+        QString text;
+        QString encoding;
+        bool crlf = false;
+    };
+
+}
+
+// Writes the file, or keeps the change in dryRunChange for a dry run
+static bool writeChangedFile(const QString &fileName, const Utils::DecodedText &fileText, QString newText,
+                             const char *function, std::optional<DryRunChange> &dryRunChange)
+{
+    if (DryRun::isEnabled()) {
+        dryRunChange = DryRunChange {std::move(newText), fileText.encoding, fileText.crlf};
+        return true;
+    }
+    return writeFileText(fileName, fileText, std::move(newText), function);
+}
+
+static void addDryRunChange(const QString &fileName, std::optional<DryRunChange> &dryRunChange)
+{
+    if (dryRunChange)
+        DryRun::addChange(fileName, std::move(dryRunChange->text), dryRunChange->encoding, dryRunChange->crlf);
+}
+
+// Parses and queries one file, without creating a document for it, unless its matches are in the cache.
+// This is called from a worker thread, so it must not touch any QObject.
+static ProjectQueryMatchList queryFile(const QString &fileName, Document::Type type,
+                                       const std::shared_ptr<treesitter::Query> &query, const QueryResultCache &cache)
+{
+    // Same text as what the TextDocument would load, so positions are valid once the file is opened
+    auto fileText = readFileText(fileName);
+    if (!fileText)
+        return {};
+    const QString text = std::move(fileText->text);
+
+    QByteArray key;
+    if (cache.isEnabled()) {
+        key = QueryResultCache::key(text, type, query->text());
+        if (const auto cached = cache.load(key)) {
+            return kdalgorithms::transformed<ProjectQueryMatchList>(*cached, [&](const QueryResultCache::Match &match) {
+                return ProjectQueryMatch(fileName, text, *query, match);
+            });
+        }
+    }
+
+    // The tree is never edited, so it can be parsed from UTF-8: half the input size of UTF-16 for ASCII sources
+    treesitter::PooledParser parser(treesitter::Parser::getLanguage(type));
+    const auto tree = parser->parseUtf8(std::make_shared<treesitter::Utf8Source>(text));
+    if (!tree)
+        return {};
+
+    treesitter::QueryCursor cursor;
+    cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text));
+    const auto matches = cursor.allRemainingMatches();
+    if (cache.isEnabled())
+        cache.save(key, kdalgorithms::transformed<QueryResultCache::MatchList>(matches, &QueryResultCache::toMatch));
+    return kdalgorithms::transformed<ProjectQueryMatchList>(matches, [&](const treesitter::QueryMatch &match) {
+        return ProjectQueryMatch(fileName, text, match);
+    });
+}
+
+/*!
+ * \qmlmethod array<ProjectQueryMatch> Project::queryAll(array<string> extensions, string query)
+ * Runs the Tree-sitter `query` on all files with an extension from `extensions`, and returns the list of matches.
+ *
+ * Files are parsed and queried in parallel, without opening them as documents, which makes it a lot faster than
+ * calling `CodeDocument::query` on each file. Only files handled by Tree-sitter (C++ and QML) are queried.
+ *
+ * The matches of each file are stored in the project cache, keyed by the content of the file and the query: running
+ * the same query again only parses the files changed since.
+ *
+ * Matches are returned sorted by file name, and in the order of the file for the same file.
+ * \sa CodeDocument::query
+ */
+ProjectQueryMatchList Project::queryAll(const QStringList &extensions, const QString &query)
+{
+    if (m_root.isEmpty())
+        return {};
+
+    LOG("Project::queryAll", extensions, LOG_ARG("query", query));
+
+    const auto files = allFilesWithExtensions(extensions, FullPath);
+
+    // Queries are compiled once per language, and shared by all the workers
+    std::unordered_map<Document::Type, std::shared_ptr<treesitter::Query>> queries;
+    std::vector<std::pair<QString, Document::Type>> jobs;
+    for (const auto &fileName : files) {
+        const auto type = documentType(QFileInfo(fileName).suffix());
+        if (type != Document::Type::Cpp && type != Document::Type::Qml)
+            continue;
+        if (!queries.contains(type)) {
+            try {
+                queries[type] = treesitter::QueryCache::instance().get(treesitter::Parser::getLanguage(type), query);
+            } catch (treesitter::Query::Error &error) {
+                spdlog::error("Project::queryAll: Failed to parse query `{}` error: {} at: {}", query,
+                              error.description, error.utf8_offset);
+                return {};
+            }
+        }
+        jobs.emplace_back(fileName, type);
+    }
+
+    const auto cache = QueryResultCache::projectCache();
+    std::vector<ProjectQueryMatchList> results(jobs.size());
+    Utils::TaskGroup tasks;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        tasks.start([&, i]() {
+            const auto &[fileName, type] = jobs[i];
+            results[i] = queryFile(fileName, type, queries.at(type), cache);
+        });
+    }
+    tasks.wait();
+
+    ProjectQueryMatchList result;
+    for (auto &matches : results)
+        result.append(std::move(matches));
+    return result;
+}
+
+// Replaces all the occurrences in one file, without creating a document for it, and writes it if it has changed.
+// Returns the number of replacements.
+static int replaceInFile(const QString &fileName, const QString &before, const QString &after, int options,
+                         std::optional<DryRunChange> &dryRunChange)
+{
+    const auto fileText = readFileText(fileName);
+    if (!fileText)
+        return 0;
+    const auto &text = fileText->text;
+
+    const auto replacements = findReplacements(text, before, after, options);
+    if (replacements.empty())
+        return 0;
+
+    QString newText;
+    int position = 0;
+    for (const auto &replacement : replacements) {
+        newText.append(QStringView(text).sliced(position, replacement.start - position));
+        newText.append(replacement.text);
+        position = replacement.end;
+    }
+    newText.append(QStringView(text).sliced(position));
+
+    if (!writeChangedFile(fileName, *fileText, std::move(newText), "Project::replaceAllInFiles", dryRunChange))
+        return 0;
+    return static_cast<int>(replacements.size());
+}
+
+// clang-format off
+/*!
+ * \qmlmethod object Project::replaceAllInFiles(array<string> extensions, string before, string after, int options = TextDocument.NoFindFlags)
+ * Replaces all occurrences of the string `before` with `after` in all files with an extension from `extensions`. See
+ * the options from `TextDocument::replaceAll`, with `TextDocument.FindRegexp` the captures can be used in `after`.
+ *
+ * Files are processed in parallel, without opening them as documents. Only the files with an occurrence are written,
+ * atomically, keeping their line endings and UTF-8 BOM. Files already opened in the project are changed through their
+ * document instead, and are not saved. With `--dry-run`, the files are not written, their changes are part of the
+ * patch.
+ *
+ * Returns an object mapping the full path of each changed file to its number of replacements.
+ * \sa TextDocument::replaceAll
+ */
+// clang-format on
+QVariantMap Project::replaceAllInFiles(const QStringList &extensions, const QString &before, const QString &after,
+                                       int options)
+{
+    if (m_root.isEmpty())
+        return {};
+
+    LOG("Project::replaceAllInFiles", extensions, LOG_ARG("text", before), after, options);
+
+    if ((options & TextDocument::FindRegexp) && !QRegularExpression(before).isValid()) {
+        spdlog::error("Project::replaceAllInFiles - invalid regexp `{}`", before);
+        return {};
+    }
+
+    QVariantMap result;
+    QStringList files;
+    for (const auto &fileName : allFilesWithExtensions(extensions, FullPath)) {
+        auto findIt = std::ranges::find_if(m_documents, [&fileName](auto document) {
+            return document->fileName() == fileName;
+        });
+        if (findIt == m_documents.end()) {
+            files.push_back(fileName);
+        } else if (auto textDocument = qobject_cast<TextDocument *>(*findIt)) {
+            if (const int count = textDocument->replaceAll(before, after, options))
+                result[fileName] = count;
+        }
+    }
+
+    std::vector<int> counts(files.size());
+    std::vector<std::optional<DryRunChange>> dryRunChanges(files.size());
+    Utils::TaskGroup tasks;
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        tasks.start([&, i]() {
+            counts[i] = replaceInFile(files.at(i), before, after, options, dryRunChanges[i]);
+        });
+    }
+    tasks.wait();
+
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        addDryRunChange(files.at(i), dryRunChanges[i]);
+        if (counts[i]) {
+            result[files.at(i)] = counts[i];
+            m_symbolIndexUpToDate = false;
+            m_includeIndexUpToDate = false;
+        }
+    }
+    return result;
+}
+
+// Transforms one file, without creating a document for it, and writes it if it has changed.
+// Returns the number of replacements, or -1 if the transformation failed.
+static int transformFile(const QString &fileName, Document::Type type, const std::shared_ptr<treesitter::Query> &query,
+                         const QString &target, std::optional<DryRunChange> &dryRunChange)
+{
+    const auto fileText = readFileText(fileName);
+    if (!fileText) {
+        spdlog::error("Project::transformAll - can't read file {}", fileName);
+        return -1;
+    }
+
+    try {
+        // The parser is given back to the pool once the transformation is done, for the next file of the worker
+        treesitter::Transformation transformation(
+            fileText->text, treesitter::ParserPool::acquire(treesitter::Parser::getLanguage(type)), query, target);
+        auto newText = transformation.run();
+        if (newText == fileText->text)
+            return transformation.replacementsMade();
+        if (!writeChangedFile(fileName, *fileText, std::move(newText), "Project::transformAll", dryRunChange))
+            return -1;
+        return transformation.replacementsMade();
+    } catch (treesitter::Transformation::Error &error) {
+        spdlog::error("Project::transformAll - {}: {}", fileName, error.description);
+        return -1;
+    }
+}
+
+// Transforms a document opened in the project, only the changed ranges are replaced so the marks stay valid
+static int transformDocument(TextDocument *document, Document::Type type,
+                             const std::shared_ptr<treesitter::Query> &query, const QString &target)
+{
+    try {
+        treesitter::Transformation transformation(
+            document->plainText(), treesitter::ParserPool::acquire(treesitter::Parser::getLanguage(type)), query,
+            target);
+        const auto newText = transformation.run();
+        const auto &changes = transformation.changes();
+        document->beginTransaction();
+        for (auto it = changes.crbegin(); it != changes.crend(); ++it) {
+            document->replace(it->sourceStart, it->sourceEnd,
+                              newText.sliced(it->resultStart, it->resultEnd - it->resultStart));
+        }
+        document->commit();
+        return transformation.replacementsMade();
+    } catch (treesitter::Transformation::Error &error) {
+        spdlog::error("Project::transformAll - {}: {}", document->fileName(), error.description);
+        return -1;
+    }
+}
+
+/*!
+ * \qmlmethod object Project::transformAll(array<string> extensions, string query, string target)
+ * Runs a Tree-sitter transformation on all files with an extension from `extensions`: each `@from` capture of the
+ * `query` is replaced by the `target`, where `@capture` is replaced by the text of that capture. This is the same
+ * transformation as the one of the Tree-sitter inspector.
+ *
+ * Files are processed in parallel, without opening them as documents. Only the files that changed are written,
+ * atomically, keeping their line endings and UTF-8 BOM. Files already opened in the project are changed through their
+ * document instead, and are not saved. Only files handled by Tree-sitter (C++ and QML) are transformed. With
+ * `--dry-run`, the files are not written, their changes are part of the patch.
+ *
+ * Returns an object mapping the full path of each file with a match to its number of replacements. The errors are
+ * logged, and the files that failed are not changed.
+ * \sa Project::queryAll
+ */
+QVariantMap Project::transformAll(const QStringList &extensions, const QString &query, const QString &target)
+{
+    if (m_root.isEmpty())
+        return {};
+
+    LOG("Project::transformAll", extensions, LOG_ARG("query", query), target);
+
+    return transformFiles(allFilesWithExtensions(extensions, FullPath), query, target).value_or(QVariantMap());
+}
+
+std::optional<QVariantMap> Project::transformFiles(const QStringList &files, const QString &query,
+                                                   const QString &target, QStringList *failedFiles)
+{
+    TRACE("Project::transformFiles");
+
+    // Queries are compiled once per language, and shared by all the workers
+    std::unordered_map<Document::Type, std::shared_ptr<treesitter::Query>> queries;
+    std::vector<std::pair<QString, Document::Type>> jobs;
+    QVariantMap result;
+    auto addResult = [&](const QString &fileName, int count) {
+        if (count < 0) {
+            if (failedFiles)
+                failedFiles->push_back(fileName);
+        } else if (count > 0) {
+            result[fileName] = count;
+            m_symbolIndexUpToDate = false;
+            m_includeIndexUpToDate = false;
+        }
+    };
+
+    for (const auto &file : files) {
+        const auto fileName = QFileInfo(file).absoluteFilePath();
+        const auto type = documentType(QFileInfo(fileName).suffix());
+        if (type != Document::Type::Cpp && type != Document::Type::Qml)
+            continue;
+        if (!queries.contains(type)) {
+            try {
+                queries[type] = treesitter::QueryCache::instance().get(treesitter::Parser::getLanguage(type), query);
+            } catch (treesitter::Query::Error &error) {
+                spdlog::error("Project::transformAll: Failed to parse query `{}` error: {} at: {}", query,
+                              error.description, error.utf8_offset);
+                return {};
+            }
+        }
+
+        auto findIt = std::ranges::find_if(m_documents, [&fileName](auto document) {
+            return document->fileName() == fileName;
+        });
+        if (findIt == m_documents.end())
+            jobs.emplace_back(fileName, type);
+        else if (auto textDocument = qobject_cast<TextDocument *>(*findIt))
+            addResult(fileName, transformDocument(textDocument, type, queries.at(type), target));
+    }
+
+    std::vector<int> counts(jobs.size());
+    std::vector<std::optional<DryRunChange>> dryRunChanges(jobs.size());
+    Utils::TaskGroup tasks;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        tasks.start([&, i]() {
+            const auto &[fileName, type] = jobs[i];
+            counts[i] = transformFile(fileName, type, queries.at(type), target, dryRunChanges[i]);
+        });
+    }
+    tasks.wait();
+
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        addDryRunChange(jobs[i].first, dryRunChanges[i]);
+        addResult(jobs[i].first, counts[i]);
+    }
+    return result;
+}
+
+/*!
+ * \qmlmethod Pipeline Project::pipeline(array<string> fileNames, object options = {})
+ * Returns a pipeline running the stages of a migration on the files `fileNames` concurrently, see `Pipeline`.
+ *
+ * The `options` are:
+ *
+ * - `ordered`: if true (the default), the `map` functions and the results come in the order of `fileNames`,
+ * otherwise in the order the files are ready
+ * - `window`: the number of files each stage can take ahead of the next one, twice the number of threads by default
+ *
+ * Files already opened in the project are read and changed through their document.
+ */
+Pipeline *Project::pipeline(const QStringList &fileNames, const QVariantMap &options)
+{
+    LOG("Project::pipeline", fileNames, options);
+
+    std::vector<Pipeline::Input> inputs;
+    inputs.reserve(fileNames.size());
+    for (const auto &file : fileNames) {
+        const auto fileName = absoluteFileName(file);
+        auto findIt = std::ranges::find_if(m_documents, [&fileName](auto document) {
+            return document->fileName() == fileName;
+        });
+        inputs.push_back({.fileName = fileName,
+                          .type = documentType(QFileInfo(fileName).suffix()),
+                          .document = findIt == m_documents.end() ? nullptr : qobject_cast<TextDocument *>(*findIt)});
+    }
+    // No parent, the pipeline belongs to the script engine
+    return new Pipeline(std::move(inputs), Pipeline::optionsFromMap(options));
+}
 
-    switch (it->second) {
+/*!
+ * \qmlmethod object Project::mfcExtractAll(array<string> extensions)
+ * Extracts the MFC message maps and DDX of all the classes in the files with an extension from `extensions`.
+ *
+ * Files are parsed in parallel, once for both the message map and the DDX, without opening them as documents. The
+ * data is the same as the one returned by `CppDocument::mfcExtractMessageMap` and `CppDocument::mfcExtractDDX`, but
+ * as plain objects ready to be serialized with `JSON.stringify`: ranges are the positions in the file.
+ *
+ * Returns an object mapping each class name to an object with the following properties:
+ *
+ * - `className`, `fileName`: the name of the class, and the full path of the file the data was found in
+ * - `messageMap`: if there is one, an object with `superClass`, `range` and `entries`, each entry having a `name`,
+ *   its `parameters` as a list of strings and a `range`
+ * - `dataExchange`: if there is one, an object with `range`, `entries` (each with `function`, `idc` and `member`) and
+ *   `validators` (each with `function`, `member` and `arguments`)
+ * \sa CppDocument::mfcExtractMessageMap, CppDocument::mfcExtractDDX
+ */
+QVariantMap Project::mfcExtractAll(const QStringList &extensions)
+{
+    if (m_root.isEmpty())
+        return {};
+
+    LOG("Project::mfcExtractAll", extensions);
+
+    auto isCpp = [](const QString &fileName) {
+        return documentType(QFileInfo(fileName).suffix()) == Document::Type::Cpp;
+    };
+    const auto files = kdalgorithms::filtered(allFilesWithExtensions(extensions, FullPath), isCpp);
+
+    QVariantMap result;
+    for (const auto &[className, data] : extractMfcData(files)) {
+        const auto json = QByteArray::fromStdString(nlohmann::json(data).dump());
+        result[className] = QJsonDocument::fromJson(json).toVariant();
+    }
+    return result;
+}
+
+const SymbolIndex &Project::symbolIndex()
+{
+    if (m_symbolIndexUpToDate)
+        return m_symbolIndex;
+
+    const auto cachePath = Settings::instance()->cachePath();
+    const QString indexFileName = cachePath.isEmpty() ? QString() : cachePath + "/symbols.index";
+    if (!m_symbolIndexLoaded && !indexFileName.isEmpty())
+        m_symbolIndex.load(indexFileName);
+    m_symbolIndexLoaded = true;
+
+    const auto files = kdalgorithms::filtered(indexedFiles(), [](const QString &fileName) {
+        return documentType(QFileInfo(fileName).suffix()) == Document::Type::Cpp;
+    });
+    if (m_symbolIndex.update(files) && !indexFileName.isEmpty())
+        m_symbolIndex.save(indexFileName);
+    m_symbolIndexUpToDate = !Utils::Cancellation::isCanceled();
+    return m_symbolIndex;
+}
+
+/*!
+ * \qmlmethod array<IndexedSymbol> Project::findSymbols(string name)
+ * Returns all the C++ symbols named `name` in the project: classes, methods, functions, members, enums and macros.
+ *
+ * The `name` may be qualified, like `Foo::bar`, the scope given can be partial: `Bar::foo` also finds `Foo::Bar::foo`.
+ * Functions and methods can have multiple symbols, one for each declaration and one for the definition.
+ *
+ * The symbols come from a project-wide index, built with Tree-sitter without opening the files as documents. It is
+ * built on the first call, in parallel, and stored in the project cache: only files changed since are parsed again.
+ * The index is based on the files on disk, changes not saved yet in an opened document are not taken into account.
+ * \sa Project::findDerivedClasses
+ */
+IndexedSymbolList Project::findSymbols(const QString &name)
+{
+    if (m_root.isEmpty())
+        return {};
+    LOG("Project::findSymbols", name);
+    return symbolIndex().find(name);
+}
+
+/*!
+ * \qmlmethod array<IndexedSymbol> Project::findDerivedClasses(string className, bool recursive = false)
+ * Returns all the classes of the project deriving from `className`.
+ *
+ * If `recursive` is true, also returns the classes deriving indirectly from `className`. Classes are matched by name,
+ * without namespaces or template arguments. See `findSymbols` for details on the index used.
+ * \sa Project::findSymbols
+ */
+IndexedSymbolList Project::findDerivedClasses(const QString &className, bool recursive)
+{
+    if (m_root.isEmpty())
+        return {};
+    LOG("Project::findDerivedClasses", className, recursive);
+    return symbolIndex().derivedClasses(className, recursive);
+}
+
+const IncludeIndex &Project::includeIndex()
+{
+    if (m_includeIndexUpToDate)
+        return m_includeIndex;
+
+    const auto cachePath = Settings::instance()->cachePath();
+    const QString indexFileName = cachePath.isEmpty() ? QString() : cachePath + "/includes.index";
+    if (!m_includeIndexLoaded && !indexFileName.isEmpty())
+        m_includeIndex.load(indexFileName);
+    m_includeIndexLoaded = true;
+
+    const auto files = kdalgorithms::filtered(indexedFiles(), [](const QString &fileName) {
+        return documentType(QFileInfo(fileName).suffix()) == Document::Type::Cpp;
+    });
+    if (m_includeIndex.update(files) && !indexFileName.isEmpty())
+        m_includeIndex.save(indexFileName);
+    m_includeIndexUpToDate = !Utils::Cancellation::isCanceled();
+    return m_includeIndex;
+}
+
+/*!
+ * \qmlmethod WorkspaceSymbolIterator Project::workspaceSymbols(string query)
+ * Returns an iterator over the symbols of the project matching `query`, found by the LSP servers. The servers match
+ * the query approximately, `MWin` finds `MainWindow`.
+ *
+ * Unlike `findSymbols`, the symbols come from the index of the servers, for all the languages with a server. The
+ * first symbols are returned while the servers are still searching, see
+ * [WorkspaceSymbolIterator](workspacesymboliterator.md).
+ */
+WorkspaceSymbolIterator *Project::workspaceSymbols(const QString &query)
+{
+    LOG("Project::workspaceSymbols", query);
+
+    auto clients = lspClients();
+    // No document opened yet, the servers are started on demand
+    if (clients.empty()) {
+        if (auto client = getClient(Document::Type::Cpp, m_root))
+            clients.push_back(client);
+    }
+    // Owned by the script engine
+    return new WorkspaceSymbolIterator(query, clients);
+}
+
+std::vector<Lsp::Client *> Project::lspClients() const
+{
+    std::vector<Lsp::Client *> clients;
+    for (const auto &[_, client] : m_lspClients) {
+        const auto state = client->state();
+        if (state == Lsp::Client::Initializing || state == Lsp::Client::Initialized)
+            clients.push_back(client);
+    }
+    return clients;
+}
+
+/*!
+ * \qmlmethod array<string> Project::includes(string fileName, PathType type = RelativeToRoot)
+ * Returns the files of the project included by the C++ file `fileName`. If `fileName` is relative, the root path is
+ * used as the base.
+ *
+ * The includes come from an index of the C++ files of the project, built in parallel on the first call, and only
+ * updated for the files changed since. Like the symbol index, it's stored in the cache directory. `"..."` includes
+ * are searched next to the including file first, then all includes are searched in the project files, the closest
+ * ones to the including file first. Includes not found in the project, like system headers, are ignored.
+ *
+ * `type` defines the type of path returned, see `allFiles`.
+ * \sa Project::includers
+ */
+QStringList Project::includes(const QString &fileName, PathType type)
+{
+    if (m_root.isEmpty())
+        return {};
+    LOG("Project::includes", fileName, type);
+    return toPathType(includeIndex().includes(absoluteFileName(fileName)), type);
+}
+
+/*!
+ * \qmlmethod array<string> Project::includers(string fileName, bool transitive = false, PathType type = RelativeToRoot)
+ * Returns the files of the project including `fileName`.
+ *
+ * If `transitive` is true, also returns the files including it indirectly, for example all the files depending on a
+ * precompiled header:
+ *
+ * ```js
+ * let dependents = Project.includers("stdafx.h", true)
+ * ```
+ *
+ * See `includes` for details on the index used, and `allFiles` for `type`.
+ * \sa Project::includes
+ */
+QStringList Project::includers(const QString &fileName, bool transitive, PathType type)
+{
+    if (m_root.isEmpty())
+        return {};
+    LOG("Project::includers", fileName, transitive, type);
+    return toPathType(includeIndex().includers(absoluteFileName(fileName), transitive), type);
+}
+
+/*!
+ * \qmlmethod string Project::fileHash(string fileName)
+ * Returns a hash of the content of the file `fileName` on disk, or an empty string if the file can't be read.
+ *
+ * If `fileName` is relative, the root path is used as the base. The hash is only computed again when the file changes,
+ * it can be used as the `inputsHash` of `Utils.cache`.
+ * \sa Utils::cache
+ */
+QString Project::fileHash(const QString &fileName) const
+{
+    LOG("Project::fileHash", fileName);
+
+    const QFileInfo fi(QDir(m_root).absoluteFilePath(fileName));
+    const auto filePath = fi.absoluteFilePath();
+    auto &fileHash = m_fileHashes[filePath];
+    if (!fileHash.hash.isEmpty() && fileHash.lastModified == fi.lastModified() && fileHash.size == fi.size())
+        return fileHash.hash;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_fileHashes.erase(filePath);
+        return {};
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    fileHash = {fi.lastModified(), fi.size(), QString::fromLatin1(hash.result().toHex())};
+    return fileHash.hash;
+}
+
+/*!
+ * \qmlmethod object Project::memoryReport()
+ * Returns an estimate of the memory used by the project, in bytes:
+ *
+ * - `documents`: for each opened document, the memory used by each of its parts (text buffer, `QTextDocument`, undo
+ * stack, marks, syntax tree, symbols, RC data...) and its `total`,
+ * - `lsp`: the message buffers and caches of each LSP client,
+ * - `history`: the API calls kept in the history panel,
+ * - `project`: the index of the project files,
+ * - `total`: the memory used by all of the above.
+ *
+ * The sizes are computed from the data kept, without the allocator overhead: it helps finding what uses most of the
+ * memory, not measuring the memory of the process.
+ */
+QVariantMap Project::memoryReport() const
+{
+    LOG("Project::memoryReport");
+
+    qint64 total = 0;
+    QVariantMap documents;
+    for (const auto *document : m_documents) {
+        const auto usage = document->memoryUsage();
+        documents[document->fileName()] = usage.toMap();
+        total += usage.total();
+    }
+    const auto lspUsage = lspMemoryUsage();
+    const auto indexUsage = indexMemoryUsage();
+    const qint64 historySize = HistoryModel::instance() ? HistoryModel::instance()->memorySize() : 0;
+    total += lspUsage.total() + indexUsage.total() + historySize;
+
+    return {{"documents", documents},
+            {"lsp", lspUsage.toMap()},
+            {"history", historySize},
+            {"project", indexUsage.toMap()},
+            {"total", total}};
+}
+
+QString Project::memoryReportText() const
+{
+    std::vector<std::pair<QString, MemoryUsage>> items;
+    for (const auto *document : m_documents)
+        items.emplace_back(QDir(m_root).relativeFilePath(document->fileName()), document->memoryUsage());
+    items.emplace_back("LSP clients", lspMemoryUsage());
+    MemoryUsage historyUsage;
+    if (HistoryModel::instance())
+        historyUsage.add("entries", HistoryModel::instance()->memorySize());
+    items.emplace_back("History", historyUsage);
+    items.emplace_back("Project", indexMemoryUsage());
+    return MemoryUsage::report(items);
+}
+
+/*!
+ * \qmlmethod object Project::stats()
+ * Returns the counters of the work done since knut started:
+ *
+ * - `fullParses`, `incrementalParses`: syntax trees parsed from scratch, or reusing the previous tree after an edit,
+ * - `queriesExecuted`: tree-sitter queries run,
+ * - `matchesProduced`, `matchesFiltered`: query matches found, and the ones rejected by a predicate,
+ * - `rangeMarksAlive`: RangeMarks currently alive,
+ * - `documentsOpened`, `documentsOpen`: documents opened, and the ones currently open,
+ * - `documentsPrefetched`: documents opened from the files read ahead by `prefetch` or `openAll`,
+ * - `bytesRead`, `bytesWritten`: size of the files loaded and saved,
+ * - `queryCacheHits`, `queryCacheMisses`: query results found or not in the project cache,
+ * - `lspRequests`: number of requests sent to the LSP servers, for each method.
+ *
+ * It helps checking that a script doesn't trigger a reparse for each change:
+ *
+ * ```js
+ * let parses = Project.stats().fullParses
+ * // ...
+ * Message.log("Full parses: " + (Project.stats().fullParses - parses))
+ * ```
+ */
+QVariantMap Project::stats() const
+{
+    LOG("Project::stats");
+
+    QVariantMap result;
+    for (int i = 0; i < Utils::Counters::CounterCount; ++i) {
+        const auto counter = static_cast<Utils::Counters::Counter>(i);
+        result[Utils::Counters::name(counter)] = Utils::Counters::value(counter);
+    }
+    result["documentsOpen"] = m_documents.size();
+    QVariantMap lspRequests;
+    for (const auto &statistics : Lsp::RequestProfiler::instance().statistics())
+        lspRequests[QString::fromStdString(statistics.method)] = statistics.count;
+    result["lspRequests"] = lspRequests;
+    return result;
+}
+
+/*!
+ * \qmlmethod bool Project::waitForLspIndex(int timeout = -1)
+ * Waits for the LSP servers started for the project to finish their work in progress, like building their index, at
+ * most `timeout` milliseconds. A negative `timeout` uses the `/lsp/index_timeout` setting, in seconds. Returns true if
+ * all the servers are ready.
+ *
+ * The servers report their work with progress notifications, so there's no need to guess how long to wait. Finding
+ * the references of a symbol also waits for the index, for the time of the setting, if the
+ * `/lsp/references_wait_for_index` setting is true.
+ */
+bool Project::waitForLspIndex(int timeout)
+{
+    LOG("Project::waitForLspIndex", timeout);
+
+    if (timeout < 0)
+        timeout = Settings::instance()->snapshot().lspIndexTimeout * 1000;
+    QElapsedTimer time;
+    time.start();
+    bool ready = true;
+    for (const auto &[_, client] : m_lspClients) {
+        const auto state = client->state();
+        if (state != Lsp::Client::Initializing && state != Lsp::Client::Initialized)
+            continue;
+        ready = client->waitForIndexReady(std::max<int>(0, timeout - static_cast<int>(time.elapsed()))) && ready;
+    }
+    return ready;
+}
+
+QString Project::statsText() const
+{
+    const auto values = stats();
+    QString text = "Counters:\n";
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        if (it.key() != "lspRequests")
+            text += QString("  %1 %2\n").arg(it.key(), -20).arg(it.value().toLongLong(), 12);
+    }
+    const auto lspRequests = values.value("lspRequests").toMap();
+    if (!lspRequests.isEmpty()) {
+        text += "LSP requests:\n";
+        for (auto it = lspRequests.cbegin(); it != lspRequests.cend(); ++it)
+            text += QString("  %1 %2\n").arg(it.key(), -40).arg(it.value().toInt(), 8);
+    }
+    return text;
+}
+
+MemoryUsage Project::lspMemoryUsage() const
+{
+    MemoryUsage usage;
+    for (const auto &[key, client] : m_lspClients)
+        usage.add(QString("%1 %2").arg(QString::fromStdString(client->languageId()), key.second), client->bufferSize());
+    return usage;
+}
+
+MemoryUsage Project::indexMemoryUsage() const
+{
+    // The caches share their strings with the index of each directory
+    qint64 size = 0;
+    for (const auto &[directory, files] : m_directoryFiles)
+        size += memorySize(directory) + memorySize(files);
+    auto cacheSize = [](const QStringList &files) {
+        return static_cast<qint64>(files.capacity() * sizeof(QString));
+    };
+    qint64 cachesSize = m_allFiles ? cacheSize(*m_allFiles) : 0;
+    for (const auto &files : m_filesBySuffix | std::views::values)
+        cachesSize += cacheSize(files);
+    if (m_filesByBaseName) {
+        for (const auto &files : *m_filesByBaseName | std::views::values)
+            cachesSize += cacheSize(files);
+    }
+
+    MemoryUsage usage;
+    usage.add("file index", size);
+    usage.add("file index caches", cachesSize);
+    return usage;
+}
+
+static Document *createDocument(const QString &suffix)
+{
+    switch (documentType(suffix)) {
     case Document::Type::Cpp:
         return new CppDocument();
     case Document::Type::Text:
@@ -229,27 +1275,100 @@ static Document *createDocument(const QString &suffix)
     return nullptr;
 }
 
-Lsp::Client *Project::getClient(Document::Type type)
+static const std::vector<LspServer> &lspServers()
+{
+    return Settings::instance()->snapshot().lspServers;
+}
+
+Lsp::Client *Project::createClient(const LspServer &server, const QString &root)
+{
+    QString language(QMetaEnum::fromType<Document::Type>().key(static_cast<int>(server.type)));
+    auto client = new Lsp::Client(language.toLower().toStdString(), server.program, server.arguments, this);
+    const auto &settings = Settings::instance()->snapshot();
+    if (settings.lspBroker)
+        client->useBroker(root, settings.lspBrokerIdleTimeout);
+    client->setMaxOpenDocuments(settings.lspMaxOpenDocuments);
+    // Opt-in: waiting for the index would make the references of existing scripts block for a long time
+    client->setIndexTimeout(settings.lspReferencesWaitForIndex ? settings.lspIndexTimeout * 1000 : 0);
+    return client;
+}
+
+// Starts all the LSP servers in the background, so they are ready once the first document is opened.
+// Not done for the tests, which only need a server for a few documents.
+void Project::startClients()
+{
+    if (!Settings::instance()->hasLsp() || Settings::instance()->isTesting())
+        return;
+
+    // With shards, the server for the project root is only started if a document outside the shards needs it
+    QStringList roots;
+    for (const auto &shard : Settings::instance()->snapshot().lspShards)
+        roots.push_back(QDir(m_root).absoluteFilePath(shard));
+    if (roots.isEmpty())
+        roots.push_back(m_root);
+
+    for (const auto &server : lspServers()) {
+        for (const auto &root : std::as_const(roots)) {
+            if (m_lspClients.contains({server.type, root}))
+                continue;
+            auto client = createClient(server, root);
+            client->initializeAsync(root);
+            m_lspClients[{server.type, root}] = client;
+        }
+        updateShards(server.type);
+    }
+}
+
+// Returns the root of the LSP server for a file: the deepest shard directory containing the file, if any, or the
+// project root. Sharding large workspaces between several servers shares the indexing and the requests between them.
+QString Project::lspRoot(const QString &fileName) const
+{
+    QString root;
+    for (const auto &shard : Settings::instance()->snapshot().lspShards) {
+        const QString path = QDir(m_root).absoluteFilePath(shard);
+        if (fileName.startsWith(path + '/') && path.size() > root.size())
+            root = path;
+    }
+    return root.isEmpty() ? m_root : root;
+}
+
+// Lets each server of a language know the other ones, for the workspace-wide requests
+void Project::updateShards(Document::Type type)
+{
+    std::vector<Lsp::Client *> clients;
+    for (const auto &[key, client] : m_lspClients) {
+        if (key.first == type)
+            clients.push_back(client);
+    }
+    if (clients.size() < 2)
+        return;
+    for (auto client : clients)
+        client->setShards(clients);
+}
+
+Lsp::Client *Project::getClient(Document::Type type, const QString &fileName)
 {
     // Check if we use LSP
     if (!Settings::instance()->hasLsp())
         return nullptr;
 
-    static auto lspServers = Settings::instance()->value<std::vector<LspServer>>(Settings::LspServers);
-
-    auto cit = m_lspClients.find(type);
-    if (cit != m_lspClients.end())
-        return cit->second;
+    // The client may still be initializing in the background, the documents wait for it
+    const QString root = lspRoot(fileName);
+    auto cit = m_lspClients.find({type, root});
+    if (cit != m_lspClients.end()) {
+        const auto state = cit->second->state();
+        return (state == Lsp::Client::Initializing || state == Lsp::Client::Initialized) ? cit->second : nullptr;
+    }
 
-    auto sit = kdalgorithms::find_if(lspServers, [type](const LspServer &server) {
+    auto sit = kdalgorithms::find_if(lspServers(), [type](const LspServer &server) {
         return server.type == type;
     });
     if (!sit)
         return nullptr;
-    QString language(QMetaEnum::fromType<Document::Type>().key(static_cast<int>(type)));
-    auto client = new Lsp::Client(language.toLower().toStdString(), sit->program, sit->arguments, this);
-    if (client->initialize(m_root)) {
-        m_lspClients[type] = client;
+    auto client = createClient(*sit, root);
+    if (client->initialize(root)) {
+        m_lspClients[{type, root}] = client;
+        updateShards(type);
         return client;
     }
     return nullptr;
@@ -260,13 +1379,18 @@ const QList<Document *> &Project::documents() const
     return m_documents;
 }
 
-Document *Project::getDocument(QString fileName, bool moveToBack)
+QString Project::absoluteFileName(const QString &fileName) const
 {
-    QFileInfo fi(fileName);
+    const QFileInfo fi(fileName);
     if (!fi.exists() && fi.isRelative())
-        fileName = m_root + '/' + fileName;
-    else
-        fileName = fi.absoluteFilePath();
+        return m_root + '/' + fileName;
+    return fi.absoluteFilePath();
+}
+
+Document *Project::getDocument(QString fileName, bool moveToBack)
+{
+    const QFileInfo fi(fileName);
+    fileName = absoluteFileName(fileName);
 
     auto findIt = std::ranges::find_if(m_documents, [fileName](auto document) {
         return document->fileName() == fileName;
@@ -282,19 +1406,87 @@ Document *Project::getDocument(QString fileName, bool moveToBack)
         doc = createDocument(fi.suffix());
         if (doc) {
             if (auto codeDocument = qobject_cast<CodeDocument *>(doc))
-                codeDocument->setLspClient(getClient(doc->type()));
+                codeDocument->setLspClient(getClient(doc->type(), fileName));
+            if (auto textDocument = qobject_cast<TextDocument *>(doc)) {
+                const auto journal = DEFAULT_VALUE(UndoJournalSettings, UndoJournal);
+                if (journal.enabled)
+                    textDocument->enableUndoJournal(journal.maxSteps, journal.maxSize);
+            }
             doc->setParent(this);
+            // Use the text and syntax tree read ahead by prefetch, if any
+            std::optional<DocumentPrefetcher::File> prefetched;
+            if (m_prefetcher && qobject_cast<TextDocument *>(doc))
+                prefetched = m_prefetcher->take(fileName);
+            QString prefetchedText;
+            if (prefetched) {
+                prefetchedText = prefetched->text.text;
+                qobject_cast<TextDocument *>(doc)->m_prefetchedText =
+                    std::make_unique<Utils::DecodedText>(std::move(prefetched->text));
+            }
             doc->load(fileName);
+            if (prefetched && prefetched->tree) {
+                if (auto codeDocument = qobject_cast<CodeDocument *>(doc))
+                    codeDocument->m_treeSitterHelper->setSyntaxTree(std::move(*prefetched->tree), prefetchedText);
+            }
+            if (doc->type() == Document::Type::Cpp) {
+                connect(doc, &Document::hasChangedChanged, this, [this]() {
+                    m_symbolIndexUpToDate = false;
+                    m_includeIndexUpToDate = false;
+                });
+            }
             m_documents.push_back(doc);
+            Utils::Counters::add(Utils::Counters::DocumentsOpened);
+            m_lastUse[doc] = ++m_useCounter;
+            evictDocuments(doc);
             emit documentsChanged();
         } else {
             spdlog::error("Project::open {} - unknown document type", fi.suffix());
             return nullptr;
         }
     }
+    m_lastUse[doc] = ++m_useCounter;
+    if (moveToBack)
+        m_openedDocuments.insert(doc);
     return doc;
 }
 
+// Returns true if a script may still hold the document: its JS object is only released by the garbage collector,
+// once nothing references it anymore
+static bool isUsedByScript(const Document *document)
+{
+    const auto *data = QQmlData::get(document);
+    return data && (!data->jsWrapper.isNullOrUndefined() || data->hasTaintedV4Object);
+}
+
+// Close the least recently used documents, until there are no more than MaxOpenDocuments documents.
+// The current document, the ones opened with open(), the ones still held by a script and `keep` are never closed.
+// Changed documents are saved when closed, and will be loaded again by the next call to get().
+void Project::evictDocuments(const Document *keep)
+{
+    const auto maxDocuments = Settings::instance()->snapshot().maxOpenDocuments;
+    if (maxDocuments <= 0 || m_documents.size() <= maxDocuments)
+        return;
+
+    QList<Document *> candidates;
+    for (auto document : std::as_const(m_documents)) {
+        if (document != keep && document != m_current && !m_openedDocuments.contains(document)
+            && !isUsedByScript(document))
+            candidates.push_back(document);
+    }
+    std::ranges::sort(candidates, {}, [this](const Document *document) {
+        return m_lastUse[document];
+    });
+
+    const auto count = std::min<qsizetype>(m_documents.size() - maxDocuments, candidates.size());
+    for (auto document : std::as_const(candidates).first(count)) {
+        spdlog::debug("Project::evictDocuments - closing {}", document->fileName());
+        m_documents.removeOne(document);
+        m_lastUse.erase(document);
+        document->close();
+        document->deleteLater();
+    }
+}
+
 /*!
  * \qmlmethod Document Project::get(string fileName)
  * Get the document for the given `fileName`. If the document is not opened yet, open it. If the document already
@@ -302,6 +1494,11 @@ Document *Project::getDocument(QString fileName, bool moveToBack)
  * the base.
  *
  * *Note:* this command does not change the current document.
+ *
+ * If the `/project/max_open_documents` setting is set, the least recently used documents are closed (and saved if
+ * changed) when there are too many of them, and loaded again by the next call to `get`. Only the documents the scripts
+ * don't reference anymore are closed, once garbage collected, so a document kept in a variable stays valid. Documents
+ * opened with `open` are never closed automatically.
  */
 Document *Project::get(const QString &fileName)
 {
@@ -328,6 +1525,73 @@ Document *Project::open(const QString &fileName)
     LOG_RETURN("document", m_current);
 }
 
+/*!
+ * \qmlmethod Project::prefetch(array<string> fileNames)
+ * Reads the files in the background, so they are ready when opened later with `get` or `open`. If a fileName is
+ * relative, use the root path as the base.
+ *
+ * The files are read, decoded and parsed on worker threads, while the script works on the previous documents. Only a
+ * few files are read ahead of the last one opened, so memory doesn't grow with the number of files. Opening the files
+ * in the same order is the most efficient; a file not read yet is loaded as usual. Files changed on disk since they
+ * were read are loaded again.
+ *
+ * ```js
+ * let files = Project.allFilesWithExtension("cpp")
+ * Project.prefetch(files)
+ * for (const fileName of files) {
+ *     let document = Project.get(fileName)
+ *     // ...
+ * }
+ * ```
+ */
+void Project::prefetch(const QStringList &fileNames)
+{
+    LOG("Project::prefetch", fileNames);
+
+    if (!m_prefetcher)
+        m_prefetcher = std::make_unique<DocumentPrefetcher>(std::max(8, 2 * QThread::idealThreadCount()));
+
+    std::vector<std::pair<QString, Document::Type>> files;
+    files.reserve(fileNames.size());
+    for (const auto &fileName : fileNames) {
+        const auto absolutePath = absoluteFileName(fileName);
+        // Other documents don't load their file as a text
+        const auto type = documentType(QFileInfo(absolutePath).suffix());
+        if (type == Document::Type::Rc || type == Document::Type::QtUi || type == Document::Type::Image
+            || type == Document::Type::QtTs)
+            continue;
+        // Already open, get() won't load it
+        if (std::ranges::any_of(m_documents, [&absolutePath](const Document *document) {
+                return document->fileName() == absolutePath;
+            }))
+            continue;
+        files.emplace_back(absolutePath, type);
+    }
+    m_prefetcher->prefetch(files);
+}
+
+/*!
+ * \qmlmethod array<Document> Project::openAll(array<string> fileNames)
+ * Gets the documents for all the given `fileNames`, as `get` does. The files are read and parsed on worker threads
+ * (see `prefetch`), while the documents are created in order.
+ *
+ * *Note:* if the `/project/max_open_documents` setting is set, only the last documents are still open once done.
+ * Calling `prefetch` then `get` for each file in turn is better suited for a large number of files.
+ */
+QList<Document *> Project::openAll(const QStringList &fileNames)
+{
+    LOG("Project::openAll", fileNames);
+
+    prefetch(fileNames);
+    QList<Document *> documents;
+    documents.reserve(fileNames.size());
+    for (const auto &fileName : fileNames) {
+        if (auto document = getDocument(fileName))
+            documents.push_back(document);
+    }
+    return documents;
+}
+
 /*!
  * \qmlmethod Project::closeAll()
  * Close all documents. If the document has some changes, save the changes.
@@ -335,6 +1599,8 @@ Document *Project::open(const QString &fileName)
 void Project::closeAll()
 {
     LOG("Project::closeAll");
+    if (m_prefetcher)
+        m_prefetcher->clear();
     for (auto d : std::as_const(m_documents))
         d->close();
 }
@@ -351,11 +1617,166 @@ Core::Document *Project::currentDocument() const
 void Project::saveAllDocuments()
 {
     LOG("Project::saveAllDocuments");
+    TRACE("Project::saveAllDocuments");
 
+    // Text documents are written in parallel, once the conflicts with the files on disk are resolved. Other documents
+    // are saved one by one, as their data may not be safe to read from another thread. A dry run only records them.
+    QList<TextDocument *> textDocuments;
     for (auto d : std::as_const(m_documents)) {
-        if (d->hasChanged()) {
+        if (!d->hasChanged())
+            continue;
+        auto textDocument = qobject_cast<TextDocument *>(d);
+        if (!textDocument || DryRun::isEnabled()) {
             d->save();
+            continue;
         }
+        if (d->hasChangedOnDisk() && d->resolveConflictsOnSave() == Document::KeepDiskChanges)
+            continue;
+        textDocuments.push_back(textDocument);
+    }
+
+    std::vector<QString> errors(textDocuments.size());
+    std::vector<char> results(textDocuments.size());
+    Utils::TaskGroup tasks;
+    for (qsizetype i = 0; i < textDocuments.size(); ++i) {
+        tasks.start([&, i]() {
+            const auto document = textDocuments.at(i);
+            results[i] = document->writeFile(document->fileName(), errors[i]);
+        });
+    }
+    tasks.wait();
+
+    for (qsizetype i = 0; i < textDocuments.size(); ++i) {
+        auto document = textDocuments.at(i);
+        if (results[i]) {
+            document->finishSave(false);
+        } else {
+            document->setErrorString(errors[i]);
+            spdlog::error("Can't save file {}: {}", document->fileName(), errors[i]);
+        }
+    }
+}
+
+// State of a document sent to the workers of checkDocumentsOnDisk, and the result of the check
+struct Project::DiskCheck
+{
+    QString fileName;
+    QDateTime lastModified;
+    bool isText = false;
+    bool hasChanged = false;
+    // Text of a loaded document without changes, to compute the changes of the reload
+    QString text;
+    int revision = -1;
+
+    bool changedOnDisk = false;
+    std::optional<Utils::DecodedText> decoded;
+    std::vector<TextReplacement> replacements;
+
+    // Same test as Document::hasChangedOnDisk, then reads the file as TextDocument::doLoad would if the document can
+    // be reloaded. This is called from a worker thread, so it must not touch any QObject.
+    void run(const QString &fallbackEncoding)
+    {
+        const QFileInfo fi(fileName);
+        if (!fi.exists() || fi.lastModified() == lastModified)
+            return;
+        changedOnDisk = true;
+        if (!isText || hasChanged)
+            return;
+
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+        decoded = Utils::decodeText(file.readAll(), fallbackEncoding);
+        decoded->text = toDocumentText(std::move(decoded->text));
+        if (revision != -1)
+            replacements = diffReplacements(text, decoded->text);
+    }
+};
+
+void Project::checkDocumentsOnDisk()
+{
+    if (m_checkingDocuments) {
+        m_checkDocumentsAgain = true;
+        return;
+    }
+
+    auto checks = std::make_shared<std::vector<DiskCheck>>();
+    for (auto document : std::as_const(m_documents)) {
+        if (document->fileName().isEmpty())
+            continue;
+        DiskCheck check {.fileName = document->fileName(),
+                         .lastModified = document->m_lastModified,
+                         .hasChanged = document->hasChanged()};
+        if (auto textDocument = qobject_cast<TextDocument *>(document)) {
+            check.isText = true;
+            if (textDocument->m_isLoaded && !check.hasChanged) {
+                check.text = textDocument->plainText();
+                check.revision = textDocument->m_textRevision;
+            }
+        }
+        checks->push_back(std::move(check));
+    }
+    if (checks->empty())
+        return;
+
+    m_checkingDocuments = true;
+    const auto fallbackEncoding = Settings::instance()->snapshot().fallbackEncoding;
+    m_diskCheckTasks.start([this, checks, fallbackEncoding]() {
+        // The files are checked in batches, so thousands of documents don't make thousands of tasks
+        static constexpr size_t BatchSize = 64;
+        Utils::TaskGroup tasks(Utils::TaskScheduler::Background);
+        for (size_t start = 0; start < checks->size(); start += BatchSize) {
+            tasks.start([checks, start, &fallbackEncoding]() {
+                const auto end = std::min(start + BatchSize, checks->size());
+                for (auto i = start; i < end; ++i)
+                    (*checks)[i].run(fallbackEncoding);
+            });
+        }
+        tasks.wait();
+        QMetaObject::invokeMethod(
+            this,
+            [this, checks]() {
+                reloadCheckedDocuments(*checks);
+            },
+            Qt::QueuedConnection);
+    });
+}
+
+void Project::reloadCheckedDocuments(std::vector<DiskCheck> &checks)
+{
+    m_checkingDocuments = false;
+
+    QList<Document *> conflicts;
+    for (auto &check : checks) {
+        if (!check.changedOnDisk)
+            continue;
+        auto it = std::ranges::find(m_documents, check.fileName, &Document::fileName);
+        // Closed, saved or reloaded since the check started, the next check will see it if needed
+        if (it == m_documents.end() || (*it)->m_lastModified != check.lastModified)
+            continue;
+
+        auto document = *it;
+        if (document->hasChanged()) {
+            conflicts.push_back(document);
+            continue;
+        }
+        auto textDocument = qobject_cast<TextDocument *>(document);
+        if (textDocument && check.decoded) {
+            textDocument->m_prefetchedText = std::make_unique<Utils::DecodedText>(std::move(*check.decoded));
+            // The changes are only valid for the text they were computed from
+            if (check.revision == textDocument->m_textRevision && textDocument->m_isLoaded) {
+                textDocument->m_reloadReplacements =
+                    std::make_unique<std::vector<TextReplacement>>(std::move(check.replacements));
+            }
+        }
+        document->reload();
+    }
+
+    if (!conflicts.isEmpty())
+        emit documentsChangedOnDisk(conflicts);
+    if (m_checkDocumentsAgain) {
+        m_checkDocumentsAgain = false;
+        checkDocumentsOnDisk();
     }
 }
 
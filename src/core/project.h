@@ -11,9 +11,25 @@
 #pragma once
 
 #include "document.h"
+#include "includeindex.h"
+#include "pipeline.h"
+#include "projectquerymatch.h"
+#include "symbolindex.h"
+#include "utils/ignorematcher.h"
+#include "utils/taskscheduler.h"
+#include "workspacesymboliterator.h"
 
 #include <QObject>
+#include <QVariantMap>
+#include <map>
+#include <memory>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class QFileSystemWatcher;
 
 namespace Lsp {
 class Client;
@@ -21,6 +37,9 @@ class Client;
 
 namespace Core {
 
+class DocumentPrefetcher;
+struct LspServer;
+
 class Project : public QObject
 {
     Q_OBJECT
@@ -47,6 +66,8 @@ public:
     Core::Document *currentDocument() const;
 
     const QList<Document *> &documents() const;
+    const QStringList &indexedFiles() const;
+    const QStringList &indexedFilesWithBaseName(const QString &baseName) const;
 
     Q_INVOKABLE QStringList allFiles(Core::Project::PathType type = RelativeToRoot) const;
     Q_INVOKABLE QStringList allFilesWithExtension(const QString &extension,
@@ -54,9 +75,52 @@ public:
     Q_INVOKABLE QStringList allFilesWithExtensions(const QStringList &extensions,
                                                    Core::Project::PathType type = RelativeToRoot);
 
+    Q_INVOKABLE Core::ProjectQueryMatchList queryAll(const QStringList &extensions, const QString &query);
+    Q_INVOKABLE QVariantMap replaceAllInFiles(const QStringList &extensions, const QString &before,
+                                              const QString &after, int options = 0);
+    Q_INVOKABLE QVariantMap transformAll(const QStringList &extensions, const QString &query, const QString &target);
+    Q_INVOKABLE Core::Pipeline *pipeline(const QStringList &fileNames, const QVariantMap &options = {});
+    // Same as transformAll on a list of files, used by the `--transform` option. Returns nothing if the query is
+    // invalid, the files that can't be transformed are added to failedFiles.
+    std::optional<QVariantMap> transformFiles(const QStringList &files, const QString &query, const QString &target,
+                                              QStringList *failedFiles = nullptr);
+
+    Q_INVOKABLE QVariantMap mfcExtractAll(const QStringList &extensions);
+
+    Q_INVOKABLE Core::IndexedSymbolList findSymbols(const QString &name);
+    Q_INVOKABLE Core::IndexedSymbolList findDerivedClasses(const QString &className, bool recursive = false);
+    Q_INVOKABLE Core::WorkspaceSymbolIterator *workspaceSymbols(const QString &query);
+    // LSP clients started for the project, all languages and shards
+    std::vector<Lsp::Client *> lspClients() const;
+
+    Q_INVOKABLE QStringList includes(const QString &fileName, Core::Project::PathType type = RelativeToRoot);
+    Q_INVOKABLE QStringList includers(const QString &fileName, bool transitive = false,
+                                      Core::Project::PathType type = RelativeToRoot);
+
+    Q_INVOKABLE QString fileHash(const QString &fileName) const;
+
+    Q_INVOKABLE QVariantMap memoryReport() const;
+    // Human readable version of memoryReport, printed on exit with the `--memory-report` option
+    QString memoryReportText() const;
+    Q_INVOKABLE QVariantMap stats() const;
+    // Human readable version of stats, printed on exit with the `--stats` option
+    QString statsText() const;
+    Q_INVOKABLE bool waitForLspIndex(int timeout = -1);
+
+    // Checks on worker threads which documents have changed on disk, and reloads them in the background. The documents
+    // with unsaved changes are not reloaded, documentsChangedOnDisk is emitted with them instead. A call made while a
+    // check is running is merged in one more check, done once the current one is finished.
+    void checkDocumentsOnDisk();
+
+    // Updates the file index for a file or directory created, removed or renamed by Knut itself. The watcher only
+    // reports the change from the event loop, too late for a script listing the files right after.
+    static void updateIndexForPath(const QString &path);
+
 public slots:
     Core::Document *get(const QString &fileName);
     Core::Document *open(const QString &fileName);
+    void prefetch(const QStringList &fileNames);
+    QList<Core::Document *> openAll(const QStringList &fileNames);
     void closeAll();
     void saveAllDocuments();
     Core::Document *openPrevious(int index = 1);
@@ -65,13 +129,33 @@ signals:
     void rootChanged();
     void currentDocumentChanged(Core::Document *document);
     void documentsChanged();
+    void documentsChangedOnDisk(const QList<Core::Document *> &documents);
 
 private:
     friend class KnutCore;
     explicit Project(QObject *parent = nullptr);
 
+    QString absoluteFileName(const QString &fileName) const;
     Core::Document *getDocument(QString fileName, bool moveToBack = false);
-    Lsp::Client *getClient(Document::Type type);
+    Lsp::Client *getClient(Document::Type type, const QString &fileName);
+    Lsp::Client *createClient(const LspServer &server, const QString &root);
+    void startClients();
+    QString lspRoot(const QString &fileName) const;
+    void updateShards(Document::Type type);
+    void evictDocuments(const Document *keep);
+
+    bool updateIgnorePatterns(const QString &path);
+    void indexDirectory(const QString &path);
+    void removeDirectoryFromIndex(const QString &path);
+    void updateDirectoryInIndex(const QString &path);
+    const QStringList &indexedFilesWithSuffix(const QString &suffix) const;
+    QStringList toPathType(const QStringList &files, PathType type) const;
+    const SymbolIndex &symbolIndex();
+    const IncludeIndex &includeIndex();
+    MemoryUsage lspMemoryUsage() const;
+    MemoryUsage indexMemoryUsage() const;
+    struct DiskCheck;
+    void reloadCheckedDocuments(std::vector<DiskCheck> &checks);
 
 private:
     inline static Project *m_instance = nullptr;
@@ -79,7 +163,51 @@ private:
     QString m_root;
     QList<Document *> m_documents;
     Core::Document *m_current = nullptr;
-    std::unordered_map<Core::Document::Type, Lsp::Client *> m_lspClients;
+    // One LSP server per language and per shard directory (the project root if there are no shards), see lspRoot
+    std::map<std::pair<Core::Document::Type, QString>, Lsp::Client *> m_lspClients;
+
+    // Least-recently-used tracking, used to evict documents when there are more than MaxOpenDocuments.
+    // Documents opened with open() may be displayed in the GUI, and are never evicted.
+    std::unordered_map<const Document *, quint64> m_lastUse;
+    std::unordered_set<const Document *> m_openedDocuments;
+    quint64 m_useCounter = 0;
+    // Files read and parsed ahead on worker threads, see prefetch
+    std::unique_ptr<DocumentPrefetcher> m_prefetcher;
+
+    // Index of all the files in the project, built once in setRoot and kept up-to-date with the watcher.
+    // Files are stored per directory, using absolute paths.
+    QFileSystemWatcher *m_fileWatcher = nullptr;
+    std::map<QString, QStringList> m_directoryFiles;
+    // Files and directories excluded from the index, see updateIgnorePatterns
+    Utils::IgnoreMatcher m_ignoreMatcher;
+    // Lazily computed views on the index, sorted, reset each time the index is changed
+    mutable std::optional<QStringList> m_allFiles;
+    mutable std::unordered_map<QString, QStringList> m_filesBySuffix;
+    mutable std::optional<std::unordered_map<QString, QStringList>> m_filesByBaseName;
+
+    // Index of the C++ symbols of the project, loaded from the cache and updated lazily when a query is made.
+    // It is marked out-of-date when the file index changes, or when a document is changed or saved.
+    SymbolIndex m_symbolIndex;
+    bool m_symbolIndexLoaded = false;
+    bool m_symbolIndexUpToDate = false;
+    // Same for the include graph of the C++ files
+    IncludeIndex m_includeIndex;
+    bool m_includeIndexLoaded = false;
+    bool m_includeIndexUpToDate = false;
+
+    // Content hashes of the files, only computed again when the modification time or size change
+    struct FileHash
+    {
+        QDateTime lastModified;
+        qint64 size = 0;
+        QString hash;
+    };
+    mutable std::unordered_map<QString, FileHash> m_fileHashes;
+
+    // Check of the documents changed on disk, see checkDocumentsOnDisk
+    Utils::TaskGroup m_diskCheckTasks {Utils::TaskScheduler::Background};
+    bool m_checkingDocuments = false;
+    bool m_checkDocumentsAgain = false;
 };
 
 } // namespace Core
@@ -12,15 +12,25 @@
 
 #include "document.h"
 #include "utils/json.h"
+#include "utils/textcodec.h"
+
+#include <optional>
 
 namespace Core {
 
+// Text of a file as a TextDocument would load it, with its format to write it back the same way it would be saved.
+// Both are called from worker threads, so they must not touch any QObject.
+std::optional<Utils::DecodedText> readFileText(const QString &fileName);
+bool writeFileText(const QString &fileName, const Utils::DecodedText &fileText, QString newText, const char *function);
+
 //! Store settings relative to a LSP server
 struct LspServer
 {
     Document::Type type;
     QString program;
     QStringList arguments;
+
+    bool operator==(const LspServer &other) const = default;
 };
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LspServer, type, program, arguments);
@@ -0,0 +1,139 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "projectquerymatch.h"
+
+#include <kdalgorithms.h>
+#include <treesitter/query.h>
+
+namespace Core {
+
+/*!
+ * \qmltype ProjectQueryCapture
+ * \brief Defines a capture made by a project-wide query.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa ProjectQueryMatch
+ */
+
+/*!
+ * \qmlproperty string ProjectQueryCapture::name
+ * Name of the capture inside the query.
+ */
+/*!
+ * \qmlproperty string ProjectQueryCapture::text
+ * Text of the capture in the file.
+ */
+/*!
+ * \qmlproperty TextRange ProjectQueryCapture::range
+ * This read-only property contains the range of the capture in the file.
+ */
+
+QString ProjectQueryCapture::toString() const
+{
+    return QString("ProjectQueryCapture{'%1', %2}").arg(name, range.toString());
+}
+
+/*!
+ * \qmltype ProjectQueryMatch
+ * \brief Contains all captures for a query match in a project file.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa Project::queryAll
+ *
+ * Unlike a [QueryMatch](querymatch.md), a ProjectQueryMatch is not attached to an opened document: captures only
+ * store the text and range of the match at the time the query was run.
+ */
+
+/*!
+ * \qmlproperty string ProjectQueryMatch::fileName
+ * Absolute path of the file the match was found in.
+ */
+/*!
+ * \qmlproperty array<ProjectQueryCapture> ProjectQueryMatch::captures
+ * List of all the captures of the match.
+ */
+/*!
+ * \qmlproperty bool ProjectQueryMatch::isEmpty
+ * Return true if the `ProjectQueryMatch` is empty.
+ */
+
+ProjectQueryMatch::ProjectQueryMatch(const QString &fileName, const QString &source,
+                                     const treesitter::QueryMatch &match)
+    : m_fileName(fileName)
+{
+    const auto captures = match.captures();
+    for (const auto &capture : captures) {
+        const auto &node = capture.node;
+        const auto start = static_cast<int>(node.startPosition());
+        const auto end = static_cast<int>(node.endPosition());
+        m_captures.emplace_back(ProjectQueryCapture {.name = match.query()->captureAt(capture.id).name,
+                                                     .text = node.textIn(source),
+                                                     .range = TextRange {.start = start, .end = end}});
+    }
+}
+
+ProjectQueryMatch::ProjectQueryMatch(const QString &fileName, const QString &source, const treesitter::Query &query,
+                                     const QueryResultCache::Match &match)
+    : m_fileName(fileName)
+{
+    for (const auto &capture : match) {
+        m_captures.emplace_back(ProjectQueryCapture {.name = query.captureAt(capture.id).name,
+                                                     .text = source.sliced(capture.start, capture.end - capture.start),
+                                                     .range = TextRange {.start = capture.start, .end = capture.end}});
+    }
+}
+
+const QString &ProjectQueryMatch::fileName() const
+{
+    return m_fileName;
+}
+
+const QList<ProjectQueryCapture> &ProjectQueryMatch::captures() const
+{
+    return m_captures;
+}
+
+bool ProjectQueryMatch::isEmpty() const
+{
+    return m_captures.isEmpty();
+}
+
+/*!
+ * \qmlmethod ProjectQueryCapture ProjectQueryMatch::get(string name)
+ * Returns the first capture with the given `name`.
+ */
+ProjectQueryCapture ProjectQueryMatch::get(const QString &name) const
+{
+    auto result = kdalgorithms::find_if(m_captures, [&name](const ProjectQueryCapture &capture) {
+        return capture.name == name;
+    });
+    if (result)
+        return *result;
+    return {};
+}
+
+/*!
+ * \qmlmethod array<ProjectQueryCapture> ProjectQueryMatch::getAll(string name)
+ * Returns all captures with the given `name`.
+ */
+QList<ProjectQueryCapture> ProjectQueryMatch::getAll(const QString &name) const
+{
+    return kdalgorithms::filtered(m_captures, [&name](const ProjectQueryCapture &capture) {
+        return capture.name == name;
+    });
+}
+
+QString ProjectQueryMatch::toString() const
+{
+    return QString("ProjectQueryMatch{'%1', %2}").arg(m_fileName).arg(m_captures.size());
+}
+
+} // namespace Core
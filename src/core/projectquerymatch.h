@@ -0,0 +1,76 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "queryresultcache.h"
+#include "textrange.h"
+
+#include <QObject>
+
+namespace treesitter {
+class Query;
+class QueryMatch;
+}
+
+namespace Core {
+
+struct ProjectQueryCapture
+{
+    Q_GADGET
+
+    Q_PROPERTY(QString name MEMBER name CONSTANT)
+    Q_PROPERTY(QString text MEMBER text CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+
+public:
+    Q_INVOKABLE QString toString() const;
+
+    QString name;
+    QString text;
+    Core::TextRange range;
+};
+
+class ProjectQueryMatch
+{
+    Q_GADGET
+
+    Q_PROPERTY(QString fileName READ fileName CONSTANT FINAL)
+    Q_PROPERTY(QList<Core::ProjectQueryCapture> captures READ captures CONSTANT FINAL)
+    Q_PROPERTY(bool isEmpty READ isEmpty CONSTANT FINAL)
+
+public:
+    // Default constructor is required for Q_DECLARE_METATYPE
+    ProjectQueryMatch() = default;
+    ProjectQueryMatch(const QString &fileName, const QString &source, const treesitter::QueryMatch &match);
+    // Match read back from the QueryResultCache, `query` gives the names of the captures
+    ProjectQueryMatch(const QString &fileName, const QString &source, const treesitter::Query &query,
+                      const QueryResultCache::Match &match);
+
+    const QString &fileName() const;
+    const QList<ProjectQueryCapture> &captures() const;
+    bool isEmpty() const;
+
+    Q_INVOKABLE Core::ProjectQueryCapture get(const QString &name) const;
+    Q_INVOKABLE QList<Core::ProjectQueryCapture> getAll(const QString &name) const;
+
+    Q_INVOKABLE QString toString() const;
+
+private:
+    QString m_fileName;
+    QList<ProjectQueryCapture> m_captures;
+};
+
+using ProjectQueryMatchList = QList<Core::ProjectQueryMatch>;
+
+} // namespace Core
+
+Q_DECLARE_METATYPE(Core::ProjectQueryCapture)
+Q_DECLARE_METATYPE(Core::ProjectQueryMatch)
@@ -9,6 +9,7 @@
 */
 
 #include "qdirvaluetype.h"
+#include "project.h"
 
 namespace Core {
 
@@ -213,7 +214,10 @@ QStringList QDirValueType::entryList(const QStringList &nameFilters, int filters
  */
 bool QDirValueType::mkdir(const QString &dirName) const
 {
-    return m_dirValue.mkdir(dirName);
+    if (!m_dirValue.mkdir(dirName))
+        return false;
+    Project::updateIndexForPath(m_dirValue.absoluteFilePath(dirName));
+    return true;
 }
 
 /*!
@@ -221,7 +225,10 @@ bool QDirValueType::mkdir(const QString &dirName) const
  */
 bool QDirValueType::rmdir(const QString &dirName) const
 {
-    return m_dirValue.rmdir(dirName);
+    if (!m_dirValue.rmdir(dirName))
+        return false;
+    Project::updateIndexForPath(m_dirValue.absoluteFilePath(dirName));
+    return true;
 }
 
 /*!
@@ -229,7 +236,10 @@ bool QDirValueType::rmdir(const QString &dirName) const
  */
 bool QDirValueType::mkpath(const QString &dirPath) const
 {
-    return m_dirValue.mkpath(dirPath);
+    if (!m_dirValue.mkpath(dirPath))
+        return false;
+    Project::updateIndexForPath(m_dirValue.absoluteFilePath(dirPath));
+    return true;
 }
 
 /*!
@@ -237,7 +247,10 @@ bool QDirValueType::mkpath(const QString &dirPath) const
  */
 bool QDirValueType::rmpath(const QString &dirPath) const
 {
-    return m_dirValue.rmpath(dirPath);
+    if (!m_dirValue.rmpath(dirPath))
+        return false;
+    Project::updateIndexForPath(m_dirValue.absoluteFilePath(dirPath));
+    return true;
 }
 
 /*!
@@ -245,7 +258,10 @@ bool QDirValueType::rmpath(const QString &dirPath) const
  */
 bool QDirValueType::removeRecursively()
 {
-    return m_dirValue.removeRecursively();
+    if (!m_dirValue.removeRecursively())
+        return false;
+    Project::updateIndexForPath(m_dirValue.absolutePath());
+    return true;
 }
 
 /*!
@@ -261,7 +277,10 @@ bool QDirValueType::makeAbsolute()
  */
 bool QDirValueType::remove(const QString &fileName)
 {
-    return m_dirValue.remove(fileName);
+    if (!m_dirValue.remove(fileName))
+        return false;
+    Project::updateIndexForPath(m_dirValue.absoluteFilePath(fileName));
+    return true;
 }
 
 /*!
@@ -269,7 +288,11 @@ bool QDirValueType::remove(const QString &fileName)
  */
 bool QDirValueType::rename(const QString &oldName, const QString &newName)
 {
-    return m_dirValue.rename(oldName, newName);
+    if (!m_dirValue.rename(oldName, newName))
+        return false;
+    Project::updateIndexForPath(m_dirValue.absoluteFilePath(oldName));
+    Project::updateIndexForPath(m_dirValue.absoluteFilePath(newName));
+    return true;
 }
 
 /*!
@@ -9,13 +9,376 @@
 */
 
 #include "qmldocument.h"
+#include "rangemark.h"
+#include "treesitter/node.h"
+#include "treesitter/tree.h"
+#include "utils/log.h"
+
+#include <QHash>
+#include <optional>
+#include <vector>
 
 namespace Core {
 
+/*!
+ * \qmltype QmlDocument
+ * \brief Document object for a QML file.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \inherits CodeDocument
+ *
+ * The objects of the document are found by their `id`, and their members by name, without running a query:
+ *
+ * ```js
+ * let document = Project.open("main.qml");
+ * for (let handler of document.handlers("okButton"))
+ *     Message.log(handler + ": " + document.memberValue("okButton", handler).text);
+ * document.memberValue("okButton", "text").replace('qsTr("Ok")');
+ * ```
+ *
+ * An empty `id` is the root object of the document. The members of an object are:
+ *
+ * - its properties, declared with `property`
+ * - its bindings, like `width: 100` or `anchors.fill: parent`
+ * - its signal handlers, like `onClicked: close()` or `Component.onCompleted: init()`
+ *
+ * The objects and their members are indexed in one pass over the syntax tree, once per change of the document.
+ */
+
+namespace {
+
+struct QmlMember
+{
+    enum Kind { Property, Binding, Handler };
+    Kind kind = Binding;
+    QString name;
+    int start = 0;
+    int end = 0;
+    // -1 for a property declared without a value
+    int valueStart = -1;
+    int valueEnd = -1;
+};
+
+struct QmlObject
+{
+    QString type;
+    int start = 0;
+    int end = 0;
+    std::vector<QmlMember> members;
+    QHash<QString, int> memberByName;
+
+    QStringList names(QmlMember::Kind kind) const
+    {
+        QStringList result;
+        for (const auto &member : members) {
+            if (member.kind == kind)
+                result.append(member.name);
+        }
+        return result;
+    }
+
+    const QmlMember *member(const QString &name) const
+    {
+        const auto it = memberByName.constFind(name);
+        return it == memberByName.cend() ? nullptr : &members[*it];
+    }
+};
+
+// Fills the objects of a QML syntax tree, only walking the QML part of the tree: scripts can't contain objects
+class QmlIndexer
+{
+public:
+    QmlIndexer(const treesitter::TreeSnapshot &tree, std::vector<QmlObject> &objects,
+               QHash<QString, int> &objectById, QStringList &ids)
+        : m_tree(tree)
+        , m_objects(objects)
+        , m_objectById(objectById)
+        , m_ids(ids)
+    {
+        const auto *language = tree.rootNode().language();
+        m_objectTypes = treesitter::NodeTypes(language, {"ui_object_definition", "ui_object_definition_binding"});
+        m_propertyTypes = treesitter::NodeTypes(language, {"ui_property"});
+        m_bindingTypes = treesitter::NodeTypes(language, {"ui_binding"});
+        m_annotatedTypes = treesitter::NodeTypes(language, {"ui_annotated_object_member"});
+        m_containerTypes = treesitter::NodeTypes(language, {"ui_object_array", "ui_inline_component"});
+    }
+
+    void run() { visit(m_tree.rootNode()); }
+
+private:
+    void visit(const treesitter::Node &node);
+    void addObject(const treesitter::Node &node);
+    void addMember(int object, const treesitter::Node &node);
+
+    const treesitter::TreeSnapshot &m_tree;
+    std::vector<QmlObject> &m_objects;
+    QHash<QString, int> &m_objectById;
+    QStringList &m_ids;
+
+    treesitter::NodeTypes m_objectTypes;
+    treesitter::NodeTypes m_propertyTypes;
+    treesitter::NodeTypes m_bindingTypes;
+    treesitter::NodeTypes m_annotatedTypes;
+    treesitter::NodeTypes m_containerTypes;
+};
+
+} // namespace
+
+struct QmlDocument::Index
+{
+    int revision = -1;
+    std::vector<QmlObject> objects;
+    // Index in objects by id, the root object is also there with an empty id
+    QHash<QString, int> objectById;
+    // In the order of the document
+    QStringList ids;
+
+    // Returns the object with the id, or nullptr after logging an error
+    const QmlObject *object(const QString &id, const char *function) const
+    {
+        const auto it = objectById.constFind(id);
+        if (it == objectById.cend()) {
+            spdlog::error("{} - no object with the id '{}'", function, id);
+            return nullptr;
+        }
+        return &objects[*it];
+    }
+};
+
+// Returns the child of the node in the field, if there's one
+static std::optional<treesitter::Node> fieldChild(const treesitter::Node &node, const char *field)
+{
+    treesitter::TreeCursor cursor(node);
+    if (!cursor.gotoFirstChild())
+        return {};
+    do {
+        if (const char *name = cursor.currentFieldName(); name && qstrcmp(name, field) == 0)
+            return cursor.currentNode();
+    } while (cursor.gotoNextSibling());
+    return {};
+}
+
+// A signal handler is named on<Signal>, possibly for an attached object like Component.onCompleted
+static bool isHandlerName(QStringView name)
+{
+    const auto signal = name.sliced(name.lastIndexOf(u'.') + 1);
+    return signal.size() > 2 && signal.startsWith(u"on") && signal[2].isUpper();
+}
+
+void QmlIndexer::visit(const treesitter::Node &node)
+{
+    for (const auto &child : node.namedChildRange()) {
+        if (m_objectTypes.contains(child))
+            addObject(child);
+        else if (m_containerTypes.contains(child))
+            visit(child);
+    }
+}
+
+void QmlIndexer::addObject(const treesitter::Node &node)
+{
+    const int object = static_cast<int>(m_objects.size());
+    const auto typeName = fieldChild(node, "type_name");
+    m_objects.push_back({.type = typeName ? typeName->textIn(m_tree.source()) : QString(),
+                         .start = static_cast<int>(node.startPosition()),
+                         .end = static_cast<int>(node.endPosition())});
+    if (object == 0)
+        m_objectById.insert(QString(), object);
+
+    const auto initializer = fieldChild(node, "initializer");
+    if (!initializer)
+        return;
+    for (const auto &child : initializer->namedChildRange()) {
+        if (!m_annotatedTypes.contains(child)) {
+            addMember(object, child);
+        } else if (const auto definition = fieldChild(child, "definition")) {
+            addMember(object, *definition);
+        }
+    }
+}
+
+void QmlIndexer::addMember(int object, const treesitter::Node &node)
+{
+    if (m_objectTypes.contains(node)) {
+        addObject(node);
+        return;
+    }
+    const bool isProperty = m_propertyTypes.contains(node);
+    if (!isProperty && !m_bindingTypes.contains(node)) {
+        // Functions, signals, enums... aren't indexed, but an inline component has its own objects
+        if (m_containerTypes.contains(node))
+            visit(node);
+        return;
+    }
+    const auto name = fieldChild(node, "name");
+    if (!name)
+        return;
+
+    const auto &source = m_tree.source();
+    const auto value = fieldChild(node, "value");
+    QmlMember member {.name = name->textIn(source),
+                      .start = static_cast<int>(node.startPosition()),
+                      .end = static_cast<int>(node.endPosition())};
+    if (isProperty)
+        member.kind = QmlMember::Property;
+    else if (isHandlerName(member.name))
+        member.kind = QmlMember::Handler;
+    if (value) {
+        member.valueStart = static_cast<int>(value->startPosition());
+        member.valueEnd = static_cast<int>(value->endPosition());
+    }
+
+    if (!isProperty && value && member.name == u"id") {
+        auto id = value->textViewIn(source).trimmed();
+        if (id.endsWith(u';'))
+            id = id.chopped(1).trimmed();
+        // Ids are unique in a document, the first one is kept if they aren't
+        if (!id.isEmpty() && !m_objectById.contains(id.toString())) {
+            m_objectById.insert(id.toString(), object);
+            m_ids.append(id.toString());
+        }
+    }
+
+    auto &qmlObject = m_objects[object];
+    qmlObject.memberByName.insert(member.name, static_cast<int>(qmlObject.members.size()));
+    qmlObject.members.push_back(std::move(member));
+
+    // The value may be an object, or an array of objects
+    if (value && m_objectTypes.contains(*value))
+        addObject(*value);
+    else if (value && m_containerTypes.contains(*value))
+        visit(*value);
+}
+
 QmlDocument::QmlDocument(QObject *parent)
     : CodeDocument(Type::Qml, parent)
+    , m_index(std::make_unique<Index>())
 {
 }
 
 QmlDocument::~QmlDocument() = default;
+
+const QmlDocument::Index &QmlDocument::index()
+{
+    if (m_index->revision == textRevision())
+        return *m_index;
+
+    *m_index = {};
+    m_index->revision = textRevision();
+    if (const auto snapshot = syntaxSnapshot())
+        QmlIndexer(*snapshot, m_index->objects, m_index->objectById, m_index->ids).run();
+    else
+        spdlog::error("QmlDocument - can't parse {}", fileName());
+    return *m_index;
+}
+
+/*!
+ * \qmlmethod array<string> QmlDocument::ids()
+ * Returns the ids of all the objects of the document, in the order of the document.
+ */
+QStringList QmlDocument::ids()
+{
+    LOG("QmlDocument::ids");
+    return index().ids;
+}
+
+/*!
+ * \qmlmethod RangeMark QmlDocument::objectById(string id)
+ * Returns the range of the object definition with the `id`, from its type name to its closing brace.
+ */
+RangeMark QmlDocument::objectById(const QString &id)
+{
+    LOG("QmlDocument::objectById", id);
+    if (const auto *object = index().object(id, "QmlDocument::objectById"))
+        return RangeMark(this, object->start, object->end);
+    return {};
+}
+
+/*!
+ * \qmlmethod string QmlDocument::objectType(string id)
+ * Returns the type name of the object with the `id`, like `Rectangle` or `Controls.Button`.
+ */
+QString QmlDocument::objectType(const QString &id)
+{
+    LOG("QmlDocument::objectType", id);
+    if (const auto *object = index().object(id, "QmlDocument::objectType"))
+        return object->type;
+    return {};
 }
+
+/*!
+ * \qmlmethod array<string> QmlDocument::properties(string id)
+ * Returns the names of the properties declared in the object with the `id`.
+ */
+QStringList QmlDocument::properties(const QString &id)
+{
+    LOG("QmlDocument::properties", id);
+    if (const auto *object = index().object(id, "QmlDocument::properties"))
+        return object->names(QmlMember::Property);
+    return {};
+}
+
+/*!
+ * \qmlmethod array<string> QmlDocument::bindings(string id)
+ * Returns the names of the bindings of the object with the `id`, without its signal handlers.
+ */
+QStringList QmlDocument::bindings(const QString &id)
+{
+    LOG("QmlDocument::bindings", id);
+    if (const auto *object = index().object(id, "QmlDocument::bindings"))
+        return object->names(QmlMember::Binding);
+    return {};
+}
+
+/*!
+ * \qmlmethod array<string> QmlDocument::handlers(string id)
+ * Returns the names of the signal handlers of the object with the `id`.
+ */
+QStringList QmlDocument::handlers(const QString &id)
+{
+    LOG("QmlDocument::handlers", id);
+    if (const auto *object = index().object(id, "QmlDocument::handlers"))
+        return object->names(QmlMember::Handler);
+    return {};
+}
+
+/*!
+ * \qmlmethod RangeMark QmlDocument::member(string id, string name)
+ * Returns the range of the member `name` of the object with the `id`: the whole property declaration, binding or
+ * signal handler.
+ */
+RangeMark QmlDocument::member(const QString &id, const QString &name)
+{
+    LOG("QmlDocument::member", id, name);
+    const auto *object = index().object(id, "QmlDocument::member");
+    if (!object)
+        return {};
+    if (const auto *member = object->member(name))
+        return RangeMark(this, member->start, member->end);
+    spdlog::error("QmlDocument::member - no member '{}' in the object '{}'", name, id);
+    return {};
+}
+
+/*!
+ * \qmlmethod RangeMark QmlDocument::memberValue(string id, string name)
+ * Returns the range of the value of the member `name` of the object with the `id`, after the colon.
+ *
+ * The range is invalid for a property declared without a value.
+ */
+RangeMark QmlDocument::memberValue(const QString &id, const QString &name)
+{
+    LOG("QmlDocument::memberValue", id, name);
+    const auto *object = index().object(id, "QmlDocument::memberValue");
+    if (!object)
+        return {};
+    const auto *member = object->member(name);
+    if (!member) {
+        spdlog::error("QmlDocument::memberValue - no member '{}' in the object '{}'", name, id);
+        return {};
+    }
+    if (member->valueStart == -1)
+        return {};
+    return RangeMark(this, member->valueStart, member->valueEnd);
+}
+
+} // namespace Core
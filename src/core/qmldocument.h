@@ -12,6 +12,8 @@
 
 #include "codedocument.h"
 
+#include <memory>
+
 namespace Core {
 
 class QmlDocument : public CodeDocument
@@ -21,6 +23,23 @@ class QmlDocument : public CodeDocument
 public:
     explicit QmlDocument(QObject *parent = nullptr);
     ~QmlDocument() override;
+
+    Q_INVOKABLE QStringList ids();
+    Q_INVOKABLE Core::RangeMark objectById(const QString &id);
+    Q_INVOKABLE QString objectType(const QString &id);
+
+    Q_INVOKABLE QStringList properties(const QString &id);
+    Q_INVOKABLE QStringList bindings(const QString &id);
+    Q_INVOKABLE QStringList handlers(const QString &id);
+    Q_INVOKABLE Core::RangeMark member(const QString &id, const QString &name);
+    Q_INVOKABLE Core::RangeMark memberValue(const QString &id, const QString &name);
+
+private:
+    struct Index;
+    // Returns the index of the objects and their members, built again once per revision of the document
+    const Index &index();
+
+    std::unique_ptr<Index> m_index;
 };
 
 }
@@ -118,6 +118,19 @@ void QtTsDocument::addMessage(pugi::xml_node contextChild, const QString &contex
     m_messages.push_back(new QtTsMessage(context, messageChild, this));
 }
 
+pugi::xml_node QtTsDocument::contextNode(const QString &context)
+{
+    auto it = m_contexts.constFind(context);
+    if (it != m_contexts.cend())
+        return *it;
+
+    pugi::xml_node contextChild = m_document.child("TS").append_child("context");
+    pugi::xml_node nameChild = contextChild.append_child("name"); // add name
+    nameChild.append_child(pugi::node_pcdata).set_value(context.toLatin1().constData());
+    m_contexts.insert(context, contextChild);
+    return contextChild;
+}
+
 /*!
  * \qmlmethod QtTsDocument::addMessage(string context, string location, string source, string translation)
  * Add a new source text, its translation located in location within the given context.
@@ -132,30 +145,34 @@ void QtTsDocument::addMessage(const QString &context, const QString &fileName, c
     }
 
     initializeXml();
-    auto isContext = [context](const auto &data) {
-        return context == data->context();
-    };
-    auto contextNode = std::ranges::find_if(m_messages, isContext);
-
-    if (contextNode == m_messages.end()) {
-        const auto ts = m_document.select_node("TS");
-        pugi::xml_node contextChild = ts.node().append_child("context");
-
-        pugi::xml_node nameChild = contextChild.append_child("name"); // add name
-        nameChild.append_child(pugi::node_pcdata).set_value(context.toLatin1().constData());
-        addMessage(contextChild, context, fileName, source, translation, comment);
-    } else {
-        const auto contexts = m_document.select_nodes("//context");
-        for (const auto &node : contexts) {
-            Q_ASSERT(!node.node().empty());
-            const QString contextName = QString::fromLatin1(node.node().child("name").text().as_string());
-            if (contextName == context) {
-                addMessage(node.node(), context, fileName, source, translation, comment);
-                break;
-            }
+    addMessage(contextNode(context), context, fileName, source, translation, comment);
+    // m_document.save_file("foo.xml"); // Debug create foo.xml
+    Q_EMIT messagesChanged();
+    Q_EMIT fileUpdated();
+}
+
+/*!
+ * \qmlmethod QtTsDocument::addMessages(array<object> messages)
+ * Add all the `messages` at once, each one being an object with the `context`, `fileName`, `source`, `translation`
+ * and optional `comment` properties. This is faster than calling `addMessage` for each message.
+ */
+void QtTsDocument::addMessages(const QVariantList &messages)
+{
+    LOG("QtTsDocument::addMessages", messages);
+
+    initializeXml();
+    m_messages.reserve(m_messages.size() + messages.size());
+    for (const auto &value : messages) {
+        const auto message = value.toMap();
+        const auto context = message.value("context").toString();
+        const auto fileName = message.value("fileName").toString();
+        const auto source = message.value("source").toString();
+        if (fileName.isEmpty() || source.isEmpty() || context.isEmpty()) {
+            spdlog::error(R"(Location or context or source is empty)");
         }
+        addMessage(contextNode(context), context, fileName, source, message.value("translation").toString(),
+                   message.value("comment").toString());
     }
-    // m_document.save_file("foo.xml"); // Debug create foo.xml
     Q_EMIT messagesChanged();
     Q_EMIT fileUpdated();
 }
@@ -168,6 +185,7 @@ bool QtTsDocument::doSave(const QString &fileName)
 bool QtTsDocument::doLoad(const QString &fileName)
 {
     m_messages.clear();
+    m_contexts.clear();
     pugi::xml_parse_result result =
         m_document.load_file(fileName.toLatin1().constData(), pugi::parse_default | pugi::parse_declaration);
 
@@ -186,6 +204,9 @@ bool QtTsDocument::doLoad(const QString &fileName)
     for (const auto &node : contexts) {
         Q_ASSERT(!node.node().empty());
         const QString contextName = QString::fromLatin1(node.node().child("name").text().as_string());
+        // The first context is used if there are several with the same name
+        if (!m_contexts.contains(contextName))
+            m_contexts.insert(contextName, node.node());
 
         const auto messages = node.node().select_nodes("message");
         for (const auto &message : messages) {
@@ -12,6 +12,8 @@
 
 #include "textdocument.h"
 
+#include <QHash>
+#include <QVariantList>
 #include <pugixml.hpp>
 
 namespace Core {
@@ -68,6 +70,7 @@ public:
     Q_INVOKABLE void setLanguage(const QString &lang);
     Q_INVOKABLE void addMessage(const QString &context, const QString &fileName, const QString &source,
                                 const QString &translation, const QString &comment = QString());
+    Q_INVOKABLE void addMessages(const QVariantList &messages);
 
     QString language() const;
     QString sourceLanguage() const;
@@ -86,10 +89,14 @@ private:
     friend QtTsMessage;
     void addMessage(pugi::xml_node contextChild, const QString &context, const QString &location, const QString &source,
                     const QString &translation, const QString &comment = QString());
+    // Returns the node of the context, creating it if needed
+    pugi::xml_node contextNode(const QString &context);
     void initializeXml();
     pugi::xml_document m_document;
 
     QList<QtTsMessage *> m_messages;
+    // Context nodes by name, so adding a message doesn't need to look for its context
+    QHash<QString, pugi::xml_node> m_contexts;
 };
 
 } // namespace Core
@@ -10,13 +10,13 @@
 
 #include "qtuidocument.h"
 #include "logger.h"
+#include "settings.h"
 #include "utils/log.h"
 #include "utils/qtuiwriter.h"
 
-#include <QFile>
+#include <QBuffer>
 #include <QUiLoader>
 #include <QWidget>
-#include <kdalgorithms.h>
 
 namespace Core {
 
@@ -47,12 +47,7 @@ QtUiWidget *QtUiDocument::findWidget(const QString &name) const
 {
     LOG("QtUiDocument::findWidget", name);
 
-    auto result = kdalgorithms::find_if(m_widgets, [name](QtUiWidget *widget) {
-        return widget->name() == name;
-    });
-    if (!result)
-        return nullptr;
-    return *result;
+    return m_widgetsByName.value(name, nullptr);
 }
 
 /*!
@@ -74,7 +69,8 @@ Core::QtUiWidget *QtUiDocument::addWidget(const QString &className, const QStrin
 
     QtUiWidget *newWidget = new QtUiWidget(node, parent == nullptr, this);
     m_widgets.push_back(newWidget);
-    setHasChanged(true);
+    indexWidget(newWidget);
+    setUiChanged();
     emit widgetsChanged();
     return newWidget;
 }
@@ -99,7 +95,7 @@ void QtUiDocument::addCustomWidget(const QString &className, const QString &base
 
     switch (result) {
     case Utils::QtUiWriter::Success:
-        setHasChanged(true);
+        setUiChanged();
         return;
     case Utils::QtUiWriter::AlreadyExists:
         spdlog::info(R"(QtUiDocument::addCustomWidget - the custom widget '{}' already exists)", className);
@@ -116,20 +112,60 @@ void QtUiDocument::addCustomWidget(const QString &className, const QString &base
 
 /*!
  * \qmlmethod QtUiDocument::preview()
- * Opens a dialog to preview the current ui file.
+ * Opens a dialog to preview the current ui file, including the changes not saved yet.
  */
 void QtUiDocument::preview() const
 {
     LOG("QtUiDocument::preview");
 
-    QUiLoader loader;
-
-    QFile file(fileName());
-    if (file.open(QIODevice::ReadOnly)) {
-        QWidget *widget = loader.load(&file);
+    QString errorString;
+    if (QWidget *widget = createPreview(errorString)) {
         widget->setAttribute(Qt::WA_DeleteOnClose);
         widget->show();
+    } else {
+        spdlog::error("QtUiDocument::preview - can't load the ui file: {}", errorString);
+    }
+}
+
+namespace {
+
+struct ByteArrayWriter : pugi::xml_writer
+{
+    QByteArray data;
+    void write(const void *buffer, size_t size) override { data.append(static_cast<const char *>(buffer), size); }
+};
+
+} // namespace
+
+/**
+ * \brief Creates the widget of the ui, with the changes not saved yet
+ *
+ * The widget is loaded from the xml document in memory, written to a buffer, instead of reading the file again.
+ * Returns nullptr and sets `errorString` if the ui can't be loaded.
+ */
+QWidget *QtUiDocument::createPreview(QString &errorString, QWidget *parent) const
+{
+    if (!Settings::hasWidgets()) {
+        errorString = "no widget can be created without the user interface";
+        return nullptr;
     }
+
+    ByteArrayWriter writer;
+    m_document.save(writer, "");
+    QBuffer buffer(&writer.data);
+    buffer.open(QIODevice::ReadOnly);
+
+    QUiLoader loader;
+    QWidget *widget = loader.load(&buffer, parent);
+    if (!widget)
+        errorString = loader.errorString();
+    return widget;
+}
+
+void QtUiDocument::setUiChanged()
+{
+    setHasChanged(true);
+    emit uiChanged();
 }
 
 bool QtUiDocument::doSave(const QString &fileName)
@@ -140,6 +176,7 @@ bool QtUiDocument::doSave(const QString &fileName)
 bool QtUiDocument::doLoad(const QString &fileName)
 {
     m_widgets.clear();
+    m_widgetsByName.clear();
     pugi::xml_parse_result result =
         m_document.load_file(fileName.toLatin1().constData(), pugi::parse_default | pugi::parse_declaration);
 
@@ -154,6 +191,7 @@ bool QtUiDocument::doLoad(const QString &fileName)
     for (const auto &node : widgets) {
         Q_ASSERT(!node.node().empty());
         m_widgets.push_back(new QtUiWidget(node.node(), isRoot, this));
+        indexWidget(m_widgets.back());
         isRoot = false;
     }
     emit widgetsChanged();
@@ -168,6 +206,19 @@ Utils::QtUiWriter *QtUiDocument::uiWriter()
     return m_writer.get();
 }
 
+void QtUiDocument::indexWidget(QtUiWidget *widget)
+{
+    m_widgetsByName.tryEmplace(widget->name(), widget);
+}
+
+void QtUiDocument::renameWidget(QtUiWidget *widget, const QString &oldName, const QString &newName)
+{
+    const auto it = m_widgetsByName.constFind(oldName);
+    if (it != m_widgetsByName.cend() && it.value() == widget)
+        m_widgetsByName.erase(it);
+    m_widgetsByName.tryEmplace(newName, widget);
+}
+
 /*!
  * \qmltype QtUiWidget
  * \brief Provides access to widget attributes in the ui files.
@@ -205,11 +256,14 @@ void QtUiWidget::setName(const QString &newName)
 {
     LOG("QtUiWidget::setName", newName);
 
-    if (newName == name())
+    const auto oldName = name();
+    if (newName == oldName)
         return;
 
-    qobject_cast<QtUiDocument *>(parent())->uiWriter()->setWidgetName(m_widget, newName, m_isRoot);
-    qobject_cast<QtUiDocument *>(parent())->setHasChanged(true);
+    auto document = qobject_cast<QtUiDocument *>(parent());
+    document->uiWriter()->setWidgetName(m_widget, newName, m_isRoot);
+    document->renameWidget(this, oldName, newName);
+    document->setUiChanged();
     emit nameChanged(newName);
 }
 
@@ -226,7 +280,7 @@ void QtUiWidget::setClassName(const QString &newClassName)
         return;
 
     qobject_cast<QtUiDocument *>(parent())->uiWriter()->setWidgetClassName(m_widget, newClassName);
-    qobject_cast<QtUiDocument *>(parent())->setHasChanged(true);
+    qobject_cast<QtUiDocument *>(parent())->setUiChanged();
     emit classNameChanged(newClassName);
 }
 
@@ -282,7 +336,7 @@ void QtUiWidget::addProperty(const QString &name, const QVariant &value, const Q
 
     switch (result) {
     case Utils::QtUiWriter::Success:
-        qobject_cast<QtUiDocument *>(parent())->setHasChanged(true);
+        qobject_cast<QtUiDocument *>(parent())->setUiChanged();
         return;
     case Utils::QtUiWriter::InvalidProperty:
         spdlog::error(R"(QtUiWidget::addProperty - unknown {} type)", value.typeName());
@@ -293,6 +347,37 @@ void QtUiWidget::addProperty(const QString &name, const QVariant &value, const Q
     }
 }
 
+/*!
+ * \qmlmethod QtUiWidget::setProperties(object properties)
+ * Sets all the `properties` of the widget at once, `properties` is a map from the property name to its value.
+ *
+ * Existing properties with the same name are replaced, the other properties are added. If one of the values has an
+ * unsupported type, the widget is not changed. For example:
+ *
+ * ```
+ * widget.setProperties({ "text": "My text", "checked": true, "geometry": Qt.rect(0, 0, 100, 30) });
+ * ```
+ */
+void QtUiWidget::setProperties(const QVariantMap &properties)
+{
+    LOG("QtUiWidget::setProperties", properties);
+
+    auto document = qobject_cast<QtUiDocument *>(parent());
+    const auto result = document->uiWriter()->setWidgetProperties(m_widget, properties);
+
+    switch (result) {
+    case Utils::QtUiWriter::Success:
+        document->setUiChanged();
+        return;
+    case Utils::QtUiWriter::InvalidProperty:
+        spdlog::error(R"(QtUiWidget::setProperties - unknown property type)");
+        return;
+    case Utils::QtUiWriter::AlreadyExists:
+    case Utils::QtUiWriter::InvalidHeader:
+        Q_UNREACHABLE();
+    }
+}
+
 pugi::xml_node QtUiWidget::xmlNode() const
 {
     return m_widget;
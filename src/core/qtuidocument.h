@@ -12,8 +12,11 @@
 
 #include "document.h"
 
+#include <QVariantMap>
 #include <pugixml.hpp>
 
+class QWidget;
+
 namespace Utils {
 class QtUiWriter;
 }
@@ -41,6 +44,7 @@ public:
     Q_INVOKABLE QVariant getProperty(const QString &name) const;
     Q_INVOKABLE void addProperty(const QString &name, const QVariant &value,
                                  const QHash<QString, QString> &attributes = {});
+    Q_INVOKABLE void setProperties(const QVariantMap &properties);
 
 public slots:
     void setName(const QString &newName);
@@ -76,11 +80,15 @@ public:
     Q_INVOKABLE void addCustomWidget(const QString &className, const QString &baseClassName, const QString &header,
                                      bool isContainer = false);
 
+    QWidget *createPreview(QString &errorString, QWidget *parent = nullptr) const;
+
 public slots:
     void preview() const;
 
 signals:
     void widgetsChanged();
+    // Emitted for each change of the ui done through the API
+    void uiChanged();
 
 protected:
     bool doSave(const QString &fileName) override;
@@ -88,11 +96,16 @@ protected:
 
 private:
     Utils::QtUiWriter *uiWriter();
+    void setUiChanged();
+    void indexWidget(QtUiWidget *widget);
+    void renameWidget(QtUiWidget *widget, const QString &oldName, const QString &newName);
 
     friend QtUiWidget;
     pugi::xml_document m_document;
     std::unique_ptr<Utils::QtUiWriter> m_writer;
     QList<QtUiWidget *> m_widgets;
+    // Widgets by name, the first widget wins if several widgets have the same name
+    QHash<QString, QtUiWidget *> m_widgetsByName;
 };
 
 } // namespace Core
@@ -0,0 +1,115 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "queryiterator.h"
+#include "codedocument.h"
+#include "utils/log.h"
+
+namespace Core {
+
+/*!
+ * \qmltype QueryIterator
+ * \brief Iterates over the matches of a query, one at a time.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa CodeDocument::queryIterator
+ *
+ * Contrary to `CodeDocument::query`, the matches are only searched for when requested, which is faster when only
+ * the first few matches are needed:
+ *
+ * ```js
+ * let it = document.queryIterator("(function_definition) @function");
+ * while (it.hasNext()) {
+ *     let match = it.next();
+ *     if (match.get("function").text.includes("foo"))
+ *         break;
+ * }
+ * ```
+ *
+ * The iterator is invalidated as soon as the document changes: `hasNext` then returns false, and the query needs to
+ * be run again. Matches already returned are kept up to date with the document.
+ */
+
+/*!
+ * \qmlproperty bool QueryIterator::isValid
+ * This read-only property returns true as long as the document hasn't changed since the iterator was created.
+ */
+
+QueryIterator::QueryIterator(CodeDocument *document, std::optional<treesitter::QueryCursor> &&cursor)
+    : m_document(document)
+    , m_cursor(std::move(cursor))
+{
+    if (m_document && m_cursor)
+        connect(m_document, &TextDocument::textChanged, this, &QueryIterator::invalidate);
+    else
+        m_cursor.reset();
+}
+
+QueryIterator::~QueryIterator() = default;
+
+bool QueryIterator::isValid() const
+{
+    return m_cursor.has_value() && m_document;
+}
+
+void QueryIterator::fetchNext()
+{
+    if (m_fetched)
+        return;
+    if (!isValid()) {
+        m_next.reset();
+        return;
+    }
+    m_next = m_cursor->nextMatch();
+    m_fetched = true;
+}
+
+void QueryIterator::invalidate()
+{
+    if (!m_cursor)
+        return;
+    m_cursor.reset();
+    m_next.reset();
+    m_fetched = false;
+    disconnect(m_document, nullptr, this, nullptr);
+    emit invalidated();
+}
+
+/*!
+ * \qmlmethod bool QueryIterator::hasNext()
+ * Returns true if there's another match, false if the query is done or the document has changed.
+ */
+bool QueryIterator::hasNext()
+{
+    fetchNext();
+    return m_next.has_value();
+}
+
+/*!
+ * \qmlmethod QueryMatch QueryIterator::next()
+ * Returns the next match, or an empty match if there are no more matches or the document has changed.
+ */
+Core::QueryMatch QueryIterator::next()
+{
+    if (!isValid()) {
+        spdlog::warn("QueryIterator::next - the iterator is invalid, the document may have changed");
+        return {};
+    }
+
+    fetchNext();
+    m_fetched = false;
+    if (!m_next)
+        return {};
+    auto match = QueryMatch(*m_document, *m_next);
+    m_next.reset();
+    return match;
+}
+
+} // namespace Core
@@ -0,0 +1,54 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "querymatch.h"
+#include "treesitter/query.h"
+
+#include <QObject>
+#include <QPointer>
+#include <optional>
+
+namespace Core {
+
+class CodeDocument;
+
+class QueryIterator : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(bool isValid READ isValid NOTIFY invalidated FINAL)
+
+public:
+    QueryIterator(CodeDocument *document, std::optional<treesitter::QueryCursor> &&cursor);
+    ~QueryIterator() override;
+
+    bool isValid() const;
+
+    Q_INVOKABLE bool hasNext();
+    Q_INVOKABLE Core::QueryMatch next();
+
+signals:
+    void invalidated();
+
+private:
+    // Fetches the next match from the cursor, if not done yet
+    void fetchNext();
+    void invalidate();
+
+    QPointer<CodeDocument> m_document;
+    // The cursor points into the syntax tree of the document, it's released as soon as the document changes
+    std::optional<treesitter::QueryCursor> m_cursor;
+    std::optional<treesitter::QueryMatch> m_next;
+    bool m_fetched = false;
+};
+
+} // namespace Core
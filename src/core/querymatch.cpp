@@ -10,6 +10,7 @@
 
 #include "querymatch.h"
 #include "codedocument.h"
+#include "mark_p.h"
 #include "rangemark.h"
 #include "textdocument.h"
 #include "utils/log.h"
@@ -84,27 +85,101 @@ QString QueryCapture::toString() const
  * Return true if the `QueryMatch` is empty.
  */
 
+struct QueryMatch::Data
+{
+    // Gives the names of the captures, shared by all the matches of the query
+    std::shared_ptr<treesitter::Query> query;
+    // Index in the query of each capture, captures are looked up by index instead of comparing their names
+    std::vector<int> ids;
+    QList<QueryCapture> captures;
+    // Whether the RangeMark of each capture has been created
+    QList<bool> created;
+    // Start and end of each capture
+    std::optional<MarkPositions> positions;
+
+    void addCapture(int id)
+    {
+        ids.push_back(id);
+        // The name is shared with the query, no string is allocated
+        captures.emplace_back(QueryCapture {.name = query->captureNames().at(id), .range = {}});
+    }
+};
+
 QueryMatch::QueryMatch(TextDocument &document, const treesitter::QueryMatch &match)
+    : d(std::make_shared<Data>())
 {
+    d->query = match.query();
     const auto captures = match.captures();
+    std::vector<int> positions;
+    positions.reserve(captures.size() * 2);
+    d->ids.reserve(captures.size());
     for (const auto &capture : captures) {
-        const auto name = match.query()->captureAt(capture.id).name;
+        d->addCapture(static_cast<int>(capture.id));
+        positions.push_back(static_cast<int>(capture.node.startPosition()));
+        positions.push_back(static_cast<int>(capture.node.endPosition()));
+    }
+    d->created.resize(d->captures.size(), false);
+    if (!positions.empty())
+        d->positions.emplace(&document, std::move(positions));
+}
 
-        const auto &node = capture.node;
-        const auto range = document.createRangeMark(node.startPosition(), node.endPosition());
+QueryMatch::QueryMatch(TextDocument &document, const std::shared_ptr<treesitter::Query> &query,
+                       const QueryResultCache::Match &match)
+    : d(std::make_shared<Data>())
+{
+    d->query = query;
+    std::vector<int> positions;
+    positions.reserve(match.size() * 2);
+    d->ids.reserve(match.size());
+    for (const auto &capture : match) {
+        d->addCapture(static_cast<int>(capture.id));
+        positions.push_back(capture.start);
+        positions.push_back(capture.end);
+    }
+    d->created.resize(d->captures.size(), false);
+    if (!positions.empty())
+        d->positions.emplace(&document, std::move(positions));
+}
+
+int QueryMatch::captureId(const QString &name) const
+{
+    return d ? d->query->captureIndex(name) : -1;
+}
 
-        m_captures.emplace_back(QueryCapture {.name = name, .range = range});
+const QueryCapture &QueryMatch::captureAt(qsizetype index) const
+{
+    auto &capture = d->captures[index];
+    if (!d->created.at(index)) {
+        d->created[index] = true;
+        if (auto document = d->positions->document())
+            capture.range = RangeMark(document, d->positions->at(2 * index), d->positions->at(2 * index + 1));
+        if (!d->created.contains(false))
+            d->positions.reset();
     }
+    return capture;
 }
 
 const QList<QueryCapture> &QueryMatch::captures() const
 {
-    return m_captures;
+    static const QList<QueryCapture> empty;
+    if (!d)
+        return empty;
+    for (qsizetype i = 0; i < d->captures.size(); ++i)
+        captureAt(i);
+    return d->captures;
 }
 
 bool QueryMatch::isEmpty() const
 {
-    return m_captures.isEmpty();
+    return !d || d->captures.isEmpty();
+}
+
+qint64 QueryMatch::memorySize() const
+{
+    if (!d)
+        return 0;
+    return static_cast<qint64>(sizeof(Data) + d->ids.capacity() * sizeof(int)
+                               + d->captures.capacity() * sizeof(QueryCapture) + d->created.capacity() * sizeof(bool));
 }
 
 /*!
@@ -114,10 +189,13 @@ bool QueryMatch::isEmpty() const
 Core::RangeMarkList QueryMatch::getAll(const QString &name) const
 {
     Core::RangeMarkList result;
+    const int id = captureId(name);
+    if (id < 0)
+        return result;
 
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            result.emplace_back(capture.range);
+    for (qsizetype i = 0; i < d->captures.size(); ++i) {
+        if (d->ids[i] == id)
+            result.emplace_back(captureAt(i).range);
     }
 
     return result;
@@ -129,13 +207,10 @@ Core::RangeMarkList QueryMatch::getAll(const QString &name) const
  */
 Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto toRange = [](const QueryCapture &capture) {
-        return capture.range;
-    };
-    return kdalgorithms::filtered_transformed(m_captures, toRange, captureMatch);
+    auto captureRanges = getAll(name);
+    return kdalgorithms::filtered(captureRanges, [&range](const RangeMark &captureRange) {
+        return range.contains(captureRange);
+    });
 }
 
 /*!
@@ -156,9 +231,13 @@ Core::RangeMarkList QueryMatch::getAllInRange(const QString &name, const Core::R
  */
 RangeMark QueryMatch::get(const QString &name) const
 {
-    for (const auto &capture : m_captures) {
-        if (capture.name == name)
-            return capture.range;
+    const int id = captureId(name);
+    if (id < 0)
+        return RangeMark();
+
+    for (qsizetype i = 0; i < d->captures.size(); ++i) {
+        if (d->ids[i] == id)
+            return captureAt(i).range;
     }
 
     return RangeMark();
@@ -170,12 +249,14 @@ RangeMark QueryMatch::get(const QString &name) const
  */
 Core::RangeMark QueryMatch::getInRange(const QString &name, const Core::RangeMark &range) const
 {
-    auto captureMatch = [&name, &range](const QueryCapture &capture) {
-        return capture.name == name && range.contains(capture.range);
-    };
-    auto result = kdalgorithms::find_if(m_captures, captureMatch);
-    if (result)
-        return result->range;
+    const int id = captureId(name);
+    if (id < 0)
+        return {};
+
+    for (qsizetype i = 0; i < d->captures.size(); ++i) {
+        if (d->ids[i] == id && range.contains(captureAt(i).range))
+            return captureAt(i).range;
+    }
     return {};
 }
 
@@ -216,6 +297,12 @@ RangeMark QueryMatch::getAllJoined(const QString &name) const
  * \sa CodeDocument::query
  */
 Core::QueryMatchList QueryMatch::queryIn(const QString &capture, const QString &query) const
+{
+    return queryIn(capture, query, {});
+}
+
+Core::QueryMatchList QueryMatch::queryIn(const QString &capture, const QString &query,
+                                         const treesitter::QueryParameters &parameters) const
 {
     Core::QueryMatchList result;
 
@@ -223,7 +310,7 @@ Core::QueryMatchList QueryMatch::queryIn(const QString &capture, const QString &
     for (const auto &range : ranges) {
         auto document = qobject_cast<CodeDocument *>(range.document());
         if (document) {
-            result.append(document->queryInRange(range, query));
+            result.append(document->queryInRange(range, query, parameters));
         } else {
             spdlog::warn("QueryMatch::queryIn: RangeMark is not backed by CodeDocument!");
         }
@@ -234,7 +321,7 @@ Core::QueryMatchList QueryMatch::queryIn(const QString &capture, const QString &
 
 QString QueryMatch::toString() const
 {
-    return QString("QueryMatch{%1}").arg(m_captures.size());
+    return QString("QueryMatch{%1}").arg(d ? d->captures.size() : 0);
 }
 
 } // namespace Core
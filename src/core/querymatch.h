@@ -10,13 +10,12 @@
 
 #pragma once
 
+#include "queryresultcache.h"
 #include "rangemark.h"
+#include "treesitter/query.h"
 
 #include <QObject>
-
-namespace treesitter {
-class QueryMatch;
-}
+#include <memory>
 
 namespace Core {
 
@@ -47,10 +46,16 @@ public:
     // Default constructor is required for Q_DECLARE_METATYPE
     QueryMatch() = default;
     QueryMatch(TextDocument &document, const treesitter::QueryMatch &match);
+    // Match read back from the QueryResultCache, `query` gives the names of the captures
+    QueryMatch(TextDocument &document, const std::shared_ptr<treesitter::Query> &query,
+               const QueryResultCache::Match &match);
 
     const QList<QueryCapture> &captures() const;
     bool isEmpty() const;
 
+    // Memory used by the captures, without creating their RangeMark. Their positions are counted in the document marks.
+    qint64 memorySize() const;
+
     // Access to captures
     Q_INVOKABLE Core::RangeMark get(const QString &name) const;
     Q_INVOKABLE Core::RangeMark getInRange(const QString &name, const Core::RangeMark &range) const;
@@ -71,11 +76,22 @@ public:
     // let matches = function.queryIn("body", ...);
     // ```
     Q_INVOKABLE QList<Core::QueryMatch> queryIn(const QString &capture, const QString &query) const;
+    // Same, binding the `"$name"` parameters of the query, not user-facing API
+    QList<Core::QueryMatch> queryIn(const QString &capture, const QString &query,
+                                    const treesitter::QueryParameters &parameters) const;
 
     Q_INVOKABLE QString toString() const;
 
 private:
-    QList<QueryCapture> m_captures;
+    // Creates the RangeMark of the capture at index, if not done yet
+    const QueryCapture &captureAt(qsizetype index) const;
+    // Index of the capture `name` in the query, resolved with the capture table of the query
+    int captureId(const QString &name) const;
+
+    // Captures are shared between copies, and their RangeMark are only created when accessed: a query can return a lot
+    // of captures that are never used. Until then, their positions are kept up to date by the document.
+    struct Data;
+    std::shared_ptr<Data> d;
 };
 
 using QueryMatchList = QList<Core::QueryMatch>;
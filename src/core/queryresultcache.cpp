@@ -0,0 +1,186 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "queryresultcache.h"
+#include "settings.h"
+#include "treesitter/parser.h"
+#include "treesitter/query.h"
+#include "utils/cancellation.h"
+#include "utils/counters.h"
+#include "utils/log.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMetaEnum>
+#include <QSaveFile>
+
+namespace Core {
+
+// Increase CacheVersion when changing the data stored, or how the matches are computed (e.g. the predicates)
+static constexpr quint32 CacheMagic = 0x4b515243; // KQRC
+static constexpr quint32 CacheVersion = 1;
+
+QueryResultCache QueryResultCache::projectCache()
+{
+    const auto cachePath = Settings::instance()->cachePath();
+    return QueryResultCache(cachePath.isEmpty() ? QString() : cachePath + "/queries");
+}
+
+QueryResultCache::QueryResultCache(QString cacheDir)
+    : m_cacheDir(std::move(cacheDir))
+{
+}
+
+bool QueryResultCache::isEnabled() const
+{
+    return !m_cacheDir.isEmpty();
+}
+
+// Identity of a grammar, computed from its symbols, fields and number of parse states: ts_language_version is the ABI
+// version, it doesn't change with the grammar.
+static QByteArray grammarIdentity(const TSLanguage *language)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(ts_language_version(language)));
+    hash.addData(QByteArray::number(ts_language_state_count(language)));
+    for (TSSymbol symbol = 0; symbol < ts_language_symbol_count(language); ++symbol) {
+        hash.addData(QByteArrayView(ts_language_symbol_name(language, symbol)));
+        hash.addData(QByteArray::number(ts_language_symbol_type(language, symbol)));
+    }
+    // Field ids start at 1
+    for (TSFieldId field = 1; field <= ts_language_field_count(language); ++field)
+        hash.addData(QByteArrayView(ts_language_field_name_for_id(language, field)));
+    return hash.result();
+}
+
+QByteArray QueryResultCache::key(const QString &text, Document::Type type, const QString &query)
+{
+    // The grammar is part of the key, a new grammar may produce a different tree for the same text.
+    // The identities are computed once, the initialization of statics is thread-safe.
+    static const QByteArray cppGrammar = grammarIdentity(treesitter::Parser::getLanguage(Document::Type::Cpp));
+    static const QByteArray qmlGrammar = grammarIdentity(treesitter::Parser::getLanguage(Document::Type::Qml));
+    const QByteArray languageName = QMetaEnum::fromType<Document::Type>().valueToKey(static_cast<int>(type))
+        + (type == Document::Type::Qml ? qmlGrammar : cppGrammar);
+
+    // The text is hashed as it is in memory, converting it to UTF-8 first would cost more than the hash itself
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(text.constData()), text.size() * sizeof(QChar)));
+    const auto textHash = hash.result();
+    const auto queryHash = QCryptographicHash::hash(query.toUtf8(), QCryptographicHash::Sha1);
+
+    hash.reset();
+    hash.addData(textHash);
+    hash.addData(languageName);
+    hash.addData(queryHash);
+    return hash.result().toHex();
+}
+
+QString QueryResultCache::fileName(const QByteArray &key) const
+{
+    // Two levels of directories, a large project has tens of thousands of entries per query. The extension isn't the
+    // one of a project file (`.qrc` is a Qt resource file), so the entries are never listed as sources.
+    const auto name = QString::fromLatin1(key);
+    return QStringLiteral("%1/%2/%3.matches").arg(m_cacheDir, name.left(2), name.mid(2));
+}
+
+std::optional<QueryResultCache::MatchList> QueryResultCache::load(const QByteArray &key) const
+{
+    if (!isEnabled())
+        return {};
+
+    QFile file(fileName(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        Utils::Counters::add(Utils::Counters::QueryCacheMisses);
+        return {};
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray storedKey;
+    quint32 count = 0;
+    stream >> magic >> version >> storedKey >> count;
+    if (magic != CacheMagic || version != CacheVersion || storedKey != key) {
+        Utils::Counters::add(Utils::Counters::QueryCacheMisses);
+        return {};
+    }
+
+    // The counts are checked against the size left in the file before allocating, a corrupted file could ask for
+    // gigabytes. Each match takes at least its capture count, and each capture 3 integers.
+    auto bytesLeft = [&file]() { return static_cast<quint64>(file.size() - file.pos()); };
+    if (count > bytesLeft() / sizeof(quint32))
+        stream.setStatus(QDataStream::ReadCorruptData);
+
+    MatchList matches(stream.status() == QDataStream::Ok ? count : 0);
+    for (auto &match : matches) {
+        quint32 captureCount = 0;
+        stream >> captureCount;
+        if (stream.status() == QDataStream::Ok && captureCount > bytesLeft() / (3 * sizeof(quint32)))
+            stream.setStatus(QDataStream::ReadCorruptData);
+        if (stream.status() != QDataStream::Ok)
+            break;
+        match.resize(captureCount);
+        for (auto &capture : match)
+            stream >> capture.id >> capture.start >> capture.end;
+    }
+    if (stream.status() != QDataStream::Ok) {
+        spdlog::warn("QueryResultCache::load - invalid cache file {}", file.fileName());
+        Utils::Counters::add(Utils::Counters::QueryCacheMisses);
+        return {};
+    }
+    Utils::Counters::add(Utils::Counters::QueryCacheHits);
+    return matches;
+}
+
+void QueryResultCache::save(const QByteArray &key, const MatchList &matches) const
+{
+    // The matches of a query stopped by an abort are incomplete
+    if (!isEnabled() || Utils::Cancellation::isCanceled())
+        return;
+
+    const auto cacheFileName = fileName(key);
+    QDir().mkpath(QFileInfo(cacheFileName).absolutePath());
+    QSaveFile file(cacheFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("QueryResultCache::save - can't write cache file {}", cacheFileName);
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << CacheMagic << CacheVersion << key << static_cast<quint32>(matches.size());
+    for (const auto &match : matches) {
+        stream << static_cast<quint32>(match.size());
+        for (const auto &capture : match)
+            stream << capture.id << capture.start << capture.end;
+    }
+    if (stream.status() != QDataStream::Ok || !file.commit())
+        spdlog::warn("QueryResultCache::save - can't write cache file {}", cacheFileName);
+}
+
+QueryResultCache::Match QueryResultCache::toMatch(const treesitter::QueryMatch &match)
+{
+    const auto captures = match.captures();
+    Match result;
+    result.reserve(captures.size());
+    for (const auto &capture : captures) {
+        result.push_back({.id = capture.id,
+                          .start = static_cast<qint32>(capture.node.startPosition()),
+                          .end = static_cast<qint32>(capture.node.endPosition())});
+    }
+    return result;
+}
+
+} // namespace Core
@@ -0,0 +1,62 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "document.h"
+
+#include <QByteArray>
+#include <QString>
+#include <optional>
+#include <vector>
+
+namespace treesitter {
+class QueryMatch;
+}
+
+namespace Core {
+
+// On-disk cache of the matches of tree-sitter queries, keyed by the content of the text, its language and the query.
+// Any change in the text gives another key, so entries never need to be invalidated: the matches of an unchanged file
+// are read back without parsing it. Only the captures of each match are stored, with their positions in the text.
+//
+// Loading and saving only use local objects, so the cache can be used from worker threads.
+class QueryResultCache
+{
+public:
+    struct Capture
+    {
+        // Index of the capture in the query, and its range in the text (in characters, as TextRange)
+        quint32 id = 0;
+        qint32 start = 0;
+        qint32 end = 0;
+    };
+    using Match = std::vector<Capture>;
+    using MatchList = std::vector<Match>;
+
+    // The cache of the current project, with an empty cacheDir all lookups fail and nothing is stored
+    static QueryResultCache projectCache();
+    explicit QueryResultCache(QString cacheDir);
+
+    bool isEnabled() const;
+
+    static QByteArray key(const QString &text, Document::Type type, const QString &query);
+    std::optional<MatchList> load(const QByteArray &key) const;
+    void save(const QByteArray &key, const MatchList &matches) const;
+
+    static Match toMatch(const treesitter::QueryMatch &match);
+
+private:
+    QString fileName(const QByteArray &key) const;
+
+    QString m_cacheDir;
+};
+
+} // namespace Core
@@ -12,6 +12,7 @@
 #include "mark.h"
 #include "rangemark_p.h"
 #include "textdocument.h"
+#include "utils/counters.h"
 #include "utils/log.h"
 
 #include <QPlainTextEdit>
@@ -60,8 +61,16 @@ RangeMarkPrivate::RangeMarkPrivate(TextDocument *editor, int start, int end)
     Q_ASSERT(editor);
     Q_ASSERT(isValid());
 
-    auto document = editor->textEdit()->document();
-    connect(document, &QTextDocument::contentsChange, this, &RangeMarkPrivate::update);
+    m_table = editor->m_markTable.get();
+    m_table->add(this);
+    Utils::Counters::add(Utils::Counters::RangeMarksAlive);
+}
+
+RangeMarkPrivate::~RangeMarkPrivate()
+{
+    Utils::Counters::add(Utils::Counters::RangeMarksAlive, -1);
+    if (m_table)
+        m_table->remove(this);
 }
 
 bool RangeMarkPrivate::checkEditor() const
@@ -88,6 +97,13 @@ void RangeMarkPrivate::update(int from, int charsRemoved, int charsAdded)
     ensureInvariant();
 }
 
+void RangeMarkPrivate::update(const TextChanges &changes)
+{
+    changes.updateMark(m_start);
+    changes.updateMark(m_end);
+    ensureInvariant();
+}
+
 bool RangeMarkPrivate::isValid() const
 {
     return checkEditor() && m_start >= 0 && m_end >= 0;
@@ -141,8 +157,8 @@ TextRange RangeMark::toTextRange() const
 QString RangeMark::text() const
 {
     // <= here instead of < because m_end is exclusive
-    if (isValid() && end() <= document()->text().size())
-        return document()->text().sliced(start(), end() - start());
+    if (isValid() && end() <= document()->plainText().size())
+        return document()->plainText().sliced(start(), end() - start());
     return {};
 }
 
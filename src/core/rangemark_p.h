@@ -10,20 +10,23 @@
 
 #pragma once
 
-#include <QObject>
 #include <QPointer>
 
 namespace Core {
 
 class TextDocument;
+class TextChanges;
+class MarkTable;
 
-class RangeMarkPrivate : public QObject
+class RangeMarkPrivate
 {
-    Q_OBJECT
-
 public:
     // Unfortunately this needs to be public, as otherwise std::make_shared can't access it
     explicit RangeMarkPrivate(TextDocument *editor, int start, int end);
+    ~RangeMarkPrivate();
+
+    RangeMarkPrivate(const RangeMarkPrivate &) = delete;
+    RangeMarkPrivate &operator=(const RangeMarkPrivate &) = delete;
 
 private:
     void ensureInvariant();
@@ -32,6 +35,10 @@ private:
     bool checkEditor() const;
 
     void update(int from, int charsRemoved, int charsAdded);
+    void update(const TextChanges &changes);
+
+    // Position used to sort the range marks in the MarkTable
+    int tablePosition() const { return m_end; }
 
     QPointer<TextDocument> m_editor;
 
@@ -44,8 +51,14 @@ private:
     // Note: m_end is exclusive
     int m_end;
 
+    // Set by the MarkTable
+    MarkTable *m_table = nullptr;
+    qsizetype m_tableIndex = -1;
+
     friend class RangeMark;
-    friend class AstNode;
+    friend class MarkTable;
+    template <typename T>
+    friend class MarkTableList;
 };
 
 } // namespace Core
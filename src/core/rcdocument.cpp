@@ -11,6 +11,7 @@
 #include "rcdocument.h"
 #include "logger.h"
 #include "rccore/rcfile.h"
+#include "settings.h"
 #include "utils/log.h"
 
 #include <QBuffer>
@@ -124,12 +125,8 @@ RcCore::Action RcDocument::action(const QString &id) const
 
     // Make sure the action vector is populated by calling actions
     if (isDataValid() && !actions().isEmpty()) {
-        auto result = kdalgorithms::find_if(m_cacheActions, [id](const auto &data) {
-            return data.id == id;
-        });
-        if (!result)
-            return {};
-        return *result;
+        if (auto result = m_actionIndex.find(m_cacheActions, id))
+            return *result;
     }
     return {};
 }
@@ -210,6 +207,8 @@ RcCore::ToolBar RcDocument::toolBar(const QString &id) const
  * - `RcDocument.UpdateGeometry`: use the scale factor to change the dialog size
  * - `RcDocument.UseIdForPixmap`: use the id as a resource value for the pixmaps in labels
  * - `RcDocument.AllFlags`: combination of all above
+ *
+ * The conversion is done once for the same `id`, `flags` and scale factors, until the language changes.
  */
 RcCore::Widget RcDocument::dialog(const QString &id, int flags, double scaleX, double scaleY) const
 {
@@ -219,9 +218,15 @@ RcCore::Widget RcDocument::dialog(const QString &id, int flags, double scaleX, d
     SET_DEFAULT_VALUE(RcDialogScaleX, scaleX);
     SET_DEFAULT_VALUE(RcDialogScaleY, scaleY);
     if (isDataValid()) {
-        if (auto dialog = data().dialog(id))
-            return RcCore::convertDialog(data(), *dialog, static_cast<RcCore::Widget::ConversionFlags>(flags), scaleX,
-                                         scaleY);
+        const auto key = std::make_tuple(id, flags, scaleX, scaleY, m_language);
+        if (auto it = m_cacheDialogs.find(key); it != m_cacheDialogs.end())
+            return it->second;
+        if (auto dialog = data().dialog(id)) {
+            auto widget = RcCore::convertDialog(data(), *dialog, static_cast<RcCore::Widget::ConversionFlags>(flags),
+                                                scaleX, scaleY);
+            m_cacheDialogs.emplace(key, widget);
+            return widget;
+        }
     }
     return {};
 }
@@ -353,10 +358,9 @@ QStringList RcDocument::ribbonIds() const
 QList<RcCore::String> RcDocument::stringsForLanguage(const QString &language) const
 {
     LOG("RcDocument::stringsForLanguage", language);
-    if (m_rcFile.isValid && m_rcFile.data.contains(language)) {
-        const RcCore::Data data = const_cast<RcCore::RcFile *>(&m_rcFile)->data[language];
-        const auto &strings = data.strings;
-        return strings.values();
+    const auto it = m_rcFile.data.constFind(language);
+    if (m_rcFile.isValid && it != m_rcFile.data.cend()) {
+        return it->strings.values();
     } else {
         return {};
     }
@@ -370,10 +374,9 @@ QString RcDocument::stringForLanguage(const QString &language, const QString &id
 {
     LOG("RcDocument::stringForLanguage", language, id);
 
-    if (m_rcFile.isValid && m_rcFile.data.contains(language)) {
-        const RcCore::Data data = const_cast<RcCore::RcFile *>(&m_rcFile)->data[language];
-        const auto &strings = data.strings;
-        return strings.value(id).text;
+    const auto it = m_rcFile.data.constFind(language);
+    if (m_rcFile.isValid && it != m_rcFile.data.cend()) {
+        return it->strings.value(id).text;
     } else {
         spdlog::warn("RcDocument::stringForLanguage: language {} does not exist in the rc file.", language);
         return {};
@@ -402,28 +405,16 @@ QString RcDocument::string(const QString &id) const
     return {};
 }
 
-std::optional<RcCore::Data::Control> findControlWithId(const RcCore::Data::Dialog *dialog, const QString &id)
-{
-    const auto controls = dialog->controls;
-    auto isSameId = [id](const auto &control) {
-        return control.id == id;
-    };
-    auto result = kdalgorithms::find_if(controls, isSameId);
-    if (!result)
-        return {};
-    return *result;
-}
-
 QString extractStringForDialog(const RcCore::Data::Dialog *dialog, const QString &id)
 {
     if (dialog) {
-        const auto control = findControlWithId(dialog, id);
+        const auto control = dialog->control(id);
         if (!control) {
             spdlog::warn("RcDocument::stringForDialogAndLanguage: control from id {} does not exist in the rc file.",
                          id);
             return {};
         }
-        return control.value().text;
+        return control->text;
     } else {
         spdlog::warn("RcDocument::stringForDialogAndLanguage: id {} does not exist in the rc file.", id);
         return {};
@@ -439,9 +430,9 @@ QString RcDocument::stringForDialogAndLanguage(const QString &language, const QS
 {
     LOG("RcDocument::stringForDialogAndLanguage", language, dialogId, id);
 
-    if (m_rcFile.isValid && m_rcFile.data.contains(language)) {
-        const RcCore::Data data = const_cast<RcCore::RcFile *>(&m_rcFile)->data[language];
-        const auto dialog = data.dialog(dialogId);
+    const auto it = m_rcFile.data.constFind(language);
+    if (m_rcFile.isValid && it != m_rcFile.data.cend()) {
+        const auto dialog = it->dialog(dialogId);
         return extractStringForDialog(dialog, id);
     } else {
         spdlog::warn("RcDocument::stringForDialogAndLanguage: language {} does not exist in the rc file.", language);
@@ -465,8 +456,10 @@ QString RcDocument::stringForDialog(const QString &dialogId, const QString &id)
 
 const RcCore::Data &RcDocument::data() const
 {
-    Q_ASSERT(m_rcFile.data.contains(m_language));
-    return const_cast<RcCore::RcFile *>(&m_rcFile)->data[m_language];
+    // Lookups only, the data must not be detached
+    const auto it = m_rcFile.data.constFind(m_language);
+    Q_ASSERT(it != m_rcFile.data.cend());
+    return *it;
 }
 
 QString RcDocument::language() const
@@ -490,6 +483,7 @@ void RcDocument::setLanguage(const QString &language)
     m_language = language;
     m_cacheAssets.clear();
     m_cacheActions.clear();
+    m_cacheDialogs.clear();
     emit languageChanged();
     emit dataChanged();
 }
@@ -511,6 +505,133 @@ const RcCore::RcFile &RcDocument::file() const
     return m_rcFile;
 }
 
+// Memory owned by each item of the RC data, on top of the size of the item itself
+static qint64 itemSize(const RcCore::Asset &asset);
+static qint64 itemSize(const RcCore::ToolBarItem &item);
+static qint64 itemSize(const RcCore::ToolBar &toolBar);
+static qint64 itemSize(const RcCore::MenuItem &item);
+static qint64 itemSize(const RcCore::Menu &menu);
+static qint64 itemSize(const RcCore::Shortcut &shortcut);
+static qint64 itemSize(const RcCore::Action &action);
+static qint64 itemSize(const RcCore::Widget &widget);
+static qint64 itemSize(const RcCore::Data::Accelerator &accelerator);
+static qint64 itemSize(const RcCore::Data::AcceleratorTable &table);
+static qint64 itemSize(const RcCore::Data::Control &control);
+static qint64 itemSize(const RcCore::Data::Dialog &dialog);
+static qint64 itemSize(const RcCore::Data::DialogData &dialogData);
+
+template <typename T>
+static qint64 listSize(const QList<T> &list)
+{
+    auto size = static_cast<qint64>(list.capacity() * sizeof(T));
+    for (const auto &item : list)
+        size += itemSize(item);
+    return size;
+}
+
+static qint64 itemSize(const RcCore::Asset &asset)
+{
+    return memorySize(asset.id) + memorySize(asset.fileName) + memorySize(asset.originalFileName);
+}
+
+static qint64 itemSize(const RcCore::ToolBarItem &item)
+{
+    return memorySize(item.id);
+}
+
+static qint64 itemSize(const RcCore::ToolBar &toolBar)
+{
+    return memorySize(toolBar.id) + listSize(toolBar.children);
+}
+
+static qint64 itemSize(const RcCore::MenuItem &item)
+{
+    return memorySize(item.id) + memorySize(item.text) + memorySize(item.shortcut) + listSize(item.children);
+}
+
+static qint64 itemSize(const RcCore::Menu &menu)
+{
+    return memorySize(menu.id) + listSize(menu.children);
+}
+
+static qint64 itemSize(const RcCore::Shortcut &shortcut)
+{
+    return memorySize(shortcut.event);
+}
+
+static qint64 itemSize(const RcCore::Action &action)
+{
+    return memorySize(action.id) + memorySize(action.title) + memorySize(action.toolTip)
+        + memorySize(action.statusTip) + memorySize(action.iconPath) + memorySize(action.iconId)
+        + listSize(action.shortcuts);
+}
+
+static qint64 itemSize(const RcCore::Widget &widget)
+{
+    qint64 size = memorySize(widget.id) + memorySize(widget.className) + listSize(widget.children);
+    for (auto it = widget.properties.cbegin(); it != widget.properties.cend(); ++it)
+        size += memorySize(it.key()) + static_cast<qint64>(sizeof(QVariant));
+    return size;
+}
+
+static qint64 itemSize(const RcCore::Data::Accelerator &accelerator)
+{
+    return memorySize(accelerator.id) + memorySize(accelerator.shortcut);
+}
+
+static qint64 itemSize(const RcCore::Data::AcceleratorTable &table)
+{
+    return memorySize(table.id) + listSize(table.accelerators);
+}
+
+static qint64 itemSize(const RcCore::Data::Control &control)
+{
+    return memorySize(control.text) + memorySize(control.id) + memorySize(control.className)
+        + memorySize(control.styles);
+}
+
+static qint64 itemSize(const RcCore::Data::Dialog &dialog)
+{
+    return memorySize(dialog.id) + memorySize(dialog.caption) + memorySize(dialog.menu) + memorySize(dialog.styles)
+        + listSize(dialog.controls);
+}
+
+static qint64 itemSize(const RcCore::Data::DialogData &dialogData)
+{
+    qint64 size = memorySize(dialogData.id);
+    for (auto it = dialogData.values.cbegin(); it != dialogData.values.cend(); ++it)
+        size += static_cast<qint64>(sizeof(QString) + sizeof(QStringList)) + memorySize(it.key())
+            + memorySize(it.value());
+    return size;
+}
+
+MemoryUsage RcDocument::memoryUsage() const
+{
+    MemoryUsage usage;
+    usage.add("rc content", memorySize(m_rcFile.content));
+
+    // The data of all the languages, only the strings differ between most of them
+    for (const auto &data : m_rcFile.data) {
+        qint64 stringsSize = 0;
+        for (auto it = data.strings.cbegin(); it != data.strings.cend(); ++it)
+            stringsSize += static_cast<qint64>(sizeof(QString) + sizeof(RcCore::String)) + memorySize(it.key())
+                + memorySize(it->id) + memorySize(it->text);
+        usage.add("rc strings", stringsSize);
+        usage.add("rc dialogs", listSize(data.dialogs) + listSize(data.dialogDataList));
+        usage.add("rc menus", listSize(data.menus));
+        usage.add("rc toolbars", listSize(data.toolBars));
+        usage.add("rc assets", listSize(data.icons) + listSize(data.assets));
+        usage.add("rc accelerators", listSize(data.acceleratorTables));
+    }
+
+    // Conversions kept to answer the next calls
+    qint64 cacheSize = listSize(m_cacheAssets) + listSize(m_cacheActions);
+    for (const auto &[key, widget] : m_cacheDialogs)
+        cacheSize += static_cast<qint64>(sizeof(key) + sizeof(widget)) + itemSize(widget);
+    usage.add("rc conversion cache", cacheSize);
+    return usage;
+}
+
 QList<RcCore::Menu> RcDocument::menus() const
 {
     if (isDataValid())
@@ -560,6 +681,7 @@ void RcDocument::convertActions(int flags)
     SET_DEFAULT_VALUE(RcAssetFlags, static_cast<ConversionFlags>(flags));
     if (isDataValid()) {
         m_cacheActions = RcCore::convertActions(data(), static_cast<RcCore::Asset::ConversionFlags>(flags));
+        m_actionIndex.build(m_cacheActions);
         emit fileNameChanged();
     }
 }
@@ -578,6 +700,9 @@ void RcDocument::convertActions(int flags)
  * - `RcDocument.Magenta`: rgb(255, 0, 255) is used as a transparent color
  * - `RcDocument.BottomLeftPixel`: the color of the bottom left pixel is used as transparent
  * - `RcDocument.AllColors`: combination of all above
+ *
+ * Each output directory gets a `.knut_assets` manifest of the images written there: an image is only
+ * written again if its source file or the conversion have changed.
  */
 bool RcDocument::writeAssetsToImage(int flags)
 {
@@ -586,8 +711,10 @@ bool RcDocument::writeAssetsToImage(int flags)
     SET_DEFAULT_VALUE(RcAssetColors, static_cast<ConversionFlags>(flags));
     if (m_cacheAssets.isEmpty())
         convertAssets();
-    RcCore::writeAssetsToImage(m_cacheAssets, static_cast<RcCore::Asset::TransparentColors>(flags));
-    return true;
+    const auto errors = RcCore::writeAssetsToImage(m_cacheAssets, static_cast<RcCore::Asset::TransparentColors>(flags));
+    for (const auto &error : errors)
+        spdlog::error("RcDocument::writeAssetsToImage: {}", error);
+    return errors.isEmpty();
 }
 
 /*!
@@ -629,6 +756,33 @@ bool RcDocument::writeDialogToUi(const RcCore::Widget &dialog, const QString &fi
     return false;
 }
 
+/*!
+ * \qmlmethod bool RcDocument::convertAllDialogsToUi(string outputDir, int flags, real scaleX, real scaleY)
+ * \sa RcDocument::dialog
+ * \sa RcDocument::writeDialogToUi
+ * Converts all the dialogs of the current language and writes them as ui files in `outputDir`, one `<id>.ui` file
+ * for each dialog. Returns `true` if no issues.
+ *
+ * The conversion uses the `flags` and scale factors `scaleX` and `scaleY`, see RcDocument::dialog. The dialogs are
+ * converted and written in parallel.
+ */
+bool RcDocument::convertAllDialogsToUi(const QString &outputDir, int flags, double scaleX, double scaleY)
+{
+    LOG("RcDocument::convertAllDialogsToUi", outputDir, flags, scaleX, scaleY);
+
+    SET_DEFAULT_VALUE(RcDialogFlags, static_cast<ConversionFlags>(flags));
+    SET_DEFAULT_VALUE(RcDialogScaleX, scaleX);
+    SET_DEFAULT_VALUE(RcDialogScaleY, scaleY);
+    if (!isDataValid())
+        return false;
+
+    const auto errors = RcCore::writeDialogsToUi(data(), outputDir,
+                                                 static_cast<RcCore::Widget::ConversionFlags>(flags), scaleX, scaleY);
+    for (const auto &error : errors)
+        spdlog::error("RcDocument::convertAllDialogsToUi: {}", error);
+    return errors.isEmpty();
+}
+
 /*!
  * \qmlmethod bool RcDocument::previewDialog(Widget dialog )
  * \sa RcDocument::dialog
@@ -662,6 +816,7 @@ void RcDocument::mergeAllLanguages(const QString &language)
     LOG("RcDocument::mergeAllLanguages", language);
 
     m_rcFile.mergeLanguages(m_rcFile.data.keys(), language);
+    m_cacheDialogs.clear();
     {
         // Even if the newLanguage is set, we want to send the signals unconditionally
         QSignalBlocker sb(this);
@@ -703,6 +858,7 @@ void RcDocument::mergeLanguages()
     // Do all the merges
     for (const auto &[lang, values] : merges)
         m_rcFile.mergeLanguages(values, lang);
+    m_cacheDialogs.clear();
 
     {
         // Even if the newLanguage is set, we want to send the signals unconditionally
@@ -736,7 +892,8 @@ bool RcDocument::doSave(const QString &fileName)
 
 bool RcDocument::doLoad(const QString &fileName)
 {
-    m_rcFile = RcCore::parse(fileName);
+    const auto cachePath = Settings::instance()->cachePath();
+    m_rcFile = cachePath.isEmpty() ? RcCore::parse(fileName) : RcCore::parseCached(fileName, cachePath);
 
     // There should always be one language in a RC file. If not, bail out.
     if (m_rcFile.data.isEmpty())
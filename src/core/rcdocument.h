@@ -14,6 +14,9 @@
 #include "rccore/rcfile.h"
 #include "settings.h"
 
+#include <map>
+#include <tuple>
+
 namespace Core {
 
 class RcDocument : public Document
@@ -103,12 +106,17 @@ public:
 
     const RcCore::RcFile &file() const;
 
+    MemoryUsage memoryUsage() const override;
+
 public slots:
     void convertAssets(int flags = DEFAULT_VALUE(ConversionFlag, RcAssetFlags));
     void convertActions(int flags = DEFAULT_VALUE(ConversionFlags, RcAssetFlags));
     bool writeAssetsToImage(int flags = DEFAULT_VALUE(ConversionFlags, RcAssetColors));
     bool writeAssetsToQrc(const QString &fileName);
     bool writeDialogToUi(const RcCore::Widget &dialog, const QString &fileName);
+    bool convertAllDialogsToUi(const QString &outputDir, int flags = DEFAULT_VALUE(ConversionFlags, RcDialogFlags),
+                               double scaleX = DEFAULT_VALUE(double, RcDialogScaleX),
+                               double scaleY = DEFAULT_VALUE(double, RcDialogScaleY));
     void previewDialog(const RcCore::Widget &dialog) const;
     void mergeAllLanguages(const QString &language = DefaultLanguage);
     void mergeLanguages();
@@ -131,6 +139,9 @@ private:
     QString m_language;
     QList<RcCore::Asset> m_cacheAssets;
     QList<RcCore::Action> m_cacheActions;
+    RcCore::IdIndex m_actionIndex;
+    // Converted dialogs, by dialog id, flags, scale factors and language
+    mutable std::map<std::tuple<QString, int, double, double, QString>, RcCore::Widget> m_cacheDialogs;
 };
 
 NLOHMANN_JSON_SERIALIZE_ENUM(RcDocument::ConversionFlag,
@@ -13,7 +13,9 @@
 #include "scriptprogressdialog.h"
 #include "scriptrunner.h"
 #include "settings.h"
+#include "utils/cancellation.h"
 #include "utils/log.h"
+#include "utils/trace.h"
 
 #include <QAbstractItemModel>
 #include <QCheckBox>
@@ -36,6 +38,43 @@
 
 namespace Core {
 
+// Minimum time between two updates of the progress, in milliseconds: 30 updates per second are enough for the GUI
+static constexpr int ProgressInterval = 33;
+
+namespace {
+
+// Drops the user input for the widgets outside of the progress dialogs, while the script runs
+class ProgressInputFilter : public QObject
+{
+public:
+    bool eventFilter(QObject *watched, QEvent *event) override
+    {
+        switch (event->type()) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::MouseMove:
+        case QEvent::Wheel:
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+        case QEvent::ShortcutOverride:
+        case QEvent::Shortcut:
+        case QEvent::ContextMenu:
+        case QEvent::TouchBegin:
+        case QEvent::TouchUpdate:
+        case QEvent::TouchEnd:
+            break;
+        default:
+            return false;
+        }
+        // The events for the windows are dispatched to their widgets, which are filtered
+        auto widget = qobject_cast<QWidget *>(watched);
+        return widget && !qobject_cast<ScriptProgressDialog *>(widget->window());
+    }
+};
+
+} // namespace
+
 /*!
  * \qmltype ScriptDialog
  * \brief QML Item for writing visual scripts.
@@ -123,8 +162,12 @@ void ScriptDialogItem::done(int code)
     // times. This will cause other slots that are connected to `finished` to be evaluated as well. Therefore we use the
     // additional `scriptFinished` signal for cleanup. This signal is only emitted once all handlers of
     // `QDialog::done` have finished.
+    ++m_running;
     QDialog::done(code);
-    if (!m_stepGenerator.has_value()) {
+    --m_running;
+    const bool aborted = Utils::Cancellation::isCanceled();
+    clearAbort();
+    if (!m_stepGenerator.has_value() || aborted) {
         finishScript();
     }
 }
@@ -179,7 +222,7 @@ void ScriptDialogItem::firstStep(const QString &firstStep)
     showProgressDialog();
     m_currentStep = 0;
     nextStep(firstStep);
-    updateProgress();
+    processProgressEvents();
 }
 
 /**
@@ -189,6 +232,8 @@ void ScriptDialogItem::firstStep(const QString &firstStep)
  *
  * This will update the progress bar and the title of the progress dialog.
  * Make sure that the number of steps is set correctly before calling this method.
+ *
+ * The progress dialog can abort the script while it runs: a long query, parse or LSP request stops right away.
  * \sa startProgress
  */
 void ScriptDialogItem::nextStep(const QString &title)
@@ -229,9 +274,27 @@ void ScriptDialogItem::continueScript()
 void ScriptDialogItem::abortScript()
 {
     spdlog::info("Script aborted.");
+    if (m_running > 0) {
+        // Aborted while the script runs (see processProgressEvents): the long operations stop as soon as possible, and
+        // the javascript code is interrupted. The script is finished once its code returns.
+        Utils::Cancellation::cancel();
+        if (auto engine = qmlEngine(this))
+            engine->setInterrupted(true);
+        return;
+    }
     finishScript();
 }
 
+// Once the script code returns, the next operations are not stopped anymore
+void ScriptDialogItem::clearAbort()
+{
+    if (m_running > 0 || !Utils::Cancellation::isCanceled())
+        return;
+    Utils::Cancellation::reset();
+    if (auto engine = qmlEngine(this))
+        engine->setInterrupted(false);
+}
+
 void ScriptDialogItem::finishScript()
 {
     m_stepGenerator.reset();
@@ -243,7 +306,14 @@ void ScriptDialogItem::runNextStep()
 {
     showProgressDialog();
 
+    ++m_running;
     const auto result = m_stepGenerator->property("next").callWithInstance(m_stepGenerator.value());
+    --m_running;
+    if (Utils::Cancellation::isCanceled()) {
+        clearAbort();
+        finishScript();
+        return;
+    }
     const auto done = result.property("done").toBool();
     m_nextStepTitle = result.property("value").toString();
 
@@ -342,7 +412,7 @@ void ScriptDialogItem::showProgressDialog()
 
     m_progressDialogs.push_back(m_progressDialog);
     m_progressDialog->show();
-    updateProgress();
+    processProgressEvents();
 }
 
 void ScriptDialogItem::cleanupProgressDialog()
@@ -357,9 +427,31 @@ void ScriptDialogItem::cleanupProgressDialog()
 
 void ScriptDialogItem::updateProgress()
 {
+    if (m_progressTimer.isValid() && m_progressTimer.elapsed() < ProgressInterval)
+        return;
+    // Scripts run on the GUI thread: while a script runs from the GUI, the events are processed regularly even without
+    // a progress dialog, so the windows are still painted instead of freezing until the script ends.
+    if (m_progressDialogs.empty() && !(ScriptRunner::isRunning() && Settings::instance()->isGui()))
+        return;
+    processProgressEvents();
+}
+
+void ScriptDialogItem::processProgressEvents()
+{
+    TRACE("ScriptDialogItem::processProgressEvents");
     if (!m_progressDialogs.empty()) {
-        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+        // Only the progress dialogs get the user input, so the script can be aborted while it runs
+        ProgressInputFilter filter;
+        QCoreApplication::instance()->installEventFilter(&filter);
+        QCoreApplication::processEvents();
+    } else if (ScriptRunner::isRunning()) {
+        // Socket notifiers (LSP servers, file watcher) are left for after the script, so the project doesn't change
+        // under it: only painting, timers and posted events are processed
+        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents | QEventLoop::ExcludeSocketNotifiers);
+    } else {
+        return;
     }
+    m_progressTimer.start();
 }
 
 QObject *ScriptDialogItem::data() const
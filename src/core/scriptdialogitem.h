@@ -11,6 +11,7 @@
 #pragma once
 
 #include <QDialog>
+#include <QElapsedTimer>
 #include <QJSValue>
 #include <QQmlListProperty>
 #include <QQmlPropertyMap>
@@ -40,6 +41,8 @@ public:
     // This method is used to redraw the application while a script is running
     // Long-running scripts will otherwise block the GUI, which may look like Knut is hung up.
     // This method should be called in regular intervals to ensure visual progress.
+    // It is called very often (for each query match or API call), so the events are processed at most 30 times
+    // a second.
     static void updateProgress();
 
     bool isInteractive() const;
@@ -65,10 +68,12 @@ signals:
 private:
     void continueScript();
     void abortScript();
+    void clearAbort();
     void finishScript();
     void runNextStep();
     void showProgressDialog();
     void cleanupProgressDialog();
+    static void processProgressEvents();
     void setUiFile(const QString &fileName);
     void createProperties(QWidget *dialogWidget);
     void changeValue(const QString &key, const QVariant &value);
@@ -85,6 +90,8 @@ private:
     ScriptProgressDialog *m_progressDialog = nullptr;
     // Used to track existing progressDialog, in case we need to update the UI
     static inline QList<ScriptProgressDialog *> m_progressDialogs = {};
+    // Time since the events were last processed by updateProgress
+    static inline QElapsedTimer m_progressTimer = {};
 
     int m_stepCount = 0;
     int m_currentStep = 0;
@@ -93,6 +100,9 @@ private:
 
     std::optional<QJSValue> m_stepGenerator;
     bool m_interactive = true;
+    // Nesting level of the script code run by the dialog (the handlers of done, the steps), an abort meanwhile
+    // interrupts it
+    int m_running = 0;
 };
 
 } // namespace Core
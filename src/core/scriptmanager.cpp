@@ -14,25 +14,43 @@
 #include "scriptrunner.h"
 #include "settings.h"
 #include "utils/log.h"
+#include "utils/taskscheduler.h"
 
+#include <QCoreApplication>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QPointer>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
 #include <QTextStream>
 #include <QTimer>
-#include <kdalgorithms.h>
+#include <optional>
 
 namespace Core {
 
-ScriptManager::ScriptManager(QObject *parent)
+// Increase when the content of the cache changes
+constexpr int CacheVersion = 1;
+
+ScriptManager::ScriptManager(bool loadAsynchronously, QObject *parent)
     : QObject(parent)
     , m_watcher(new QFileSystemWatcher(this))
     , m_runner(new ScriptRunner(this))
+    , m_loadAsynchronously(loadAsynchronously)
+    , m_saveCacheTimer(new QTimer(this))
+    , m_persistCache(!Settings::instance()->isTesting())
 {
     m_instance = this;
 
+    // Several directories are usually read in a row, the cache is saved once for all of them
+    m_saveCacheTimer->setSingleShot(true);
+    m_saveCacheTimer->setInterval(0);
+    connect(m_saveCacheTimer, &QTimer::timeout, this, &ScriptManager::saveCache);
+    loadCache();
+
     connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &ScriptManager::updateScriptDirectory);
     connect(Settings::instance(), &Settings::settingsLoaded, this, &ScriptManager::updateDirectories);
     updateDirectories();
@@ -40,6 +58,8 @@ ScriptManager::ScriptManager(QObject *parent)
 
 ScriptManager::~ScriptManager()
 {
+    if (m_saveCacheTimer->isActive())
+        saveCache();
     m_instance = nullptr;
 }
 
@@ -84,6 +104,7 @@ void ScriptManager::runScript(const QString &fileName, bool async, bool log)
     auto endScriptCallback = [this, log, fileName]() {
         if (log)
             spdlog::debug("<== End script {}", fileName);
+        --m_runningScripts;
         emit scriptFinished(m_result);
     };
 
@@ -95,62 +116,102 @@ void ScriptManager::runScript(const QString &fileName, bool async, bool log)
         doRunScript(fileName, endScriptCallback);
 }
 
-void ScriptManager::addScript(const QString &fileName)
+static std::optional<QString> readDescription(const QString &fileName)
 {
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly))
-        return;
+        return {};
 
     QTextStream stream(&file);
     const auto line = stream.readLine();
-    const QString description = line.startsWith("//") ? line.mid(2).simplified() : "";
+    return line.startsWith("//") ? line.mid(2).simplified() : "";
+}
 
-    const QFileInfo fi(fileName);
+static QString directoryOf(const QString &fileName)
+{
+    return fileName.left(fileName.lastIndexOf('/'));
+}
 
-    Script script {fi.fileName(), fileName, description};
+// Can be called from any thread
+// Only the scripts missing from the cache, or changed since, are read. The metadata of all the scripts found are
+// returned in `metadata`.
+ScriptManager::ScriptList ScriptManager::readScripts(const QString &path, const MetadataCache &cache,
+                                                     MetadataCache &metadata)
+{
+    ScriptList scripts;
+    // The modification time and size come with the directory listing on most platforms
+    QDirIterator it(path, {"*.js", "*.qml"}, QDir::Files);
+    while (it.hasNext()) {
+        const QString fileName = it.next();
+        const QFileInfo fi = it.fileInfo();
+        Metadata data {fi.lastModified().toMSecsSinceEpoch(), fi.size(), {}};
+
+        const auto cached = cache.constFind(fileName);
+        if (cached != cache.cend() && cached->lastModified == data.lastModified && cached->size == data.size) {
+            data.description = cached->description;
+        } else if (auto description = readDescription(fileName)) {
+            data.description = std::move(*description);
+        } else {
+            continue;
+        }
+        scripts.push_back({fi.fileName(), fileName, data.description});
+        metadata.insert(fileName, std::move(data));
+    }
+    return scripts;
+}
+
+void ScriptManager::addScript(Script &&script)
+{
     emit aboutToAddScript(script, static_cast<int>(m_scriptList.size()));
     m_scriptList.push_back(std::move(script));
     emit scriptAdded(m_scriptList.back());
 }
 
-static QStringList scriptListFromDir(const QString &path)
+void ScriptManager::addLoadedScripts(const QString &path, ScriptList &&scripts, MetadataCache &&metadata)
 {
-    const QStringList filter {"*.js", "*.qml"};
-    QDirIterator it(path, filter, QDir::Files);
-    QStringList files;
-    files.reserve(filter.count());
-    while (it.hasNext())
-        files << it.next();
-    return files;
+    // The directory may have been removed, or updated by the watcher, while it was read
+    if (m_directories.contains(path)) {
+        QSet<QString> currentFileNames;
+        for (const auto &script : m_scriptList)
+            currentFileNames.insert(script.fileName);
+        for (auto &script : scripts) {
+            if (!currentFileNames.contains(script.fileName))
+                addScript(std::move(script));
+        }
+        updateCache(path, std::move(metadata));
+    }
+
+    if (--m_loadingDirectories == 0)
+        emit scriptsLoaded();
 }
 
 void ScriptManager::updateScriptDirectory(const QString &path)
 {
-    const QStringList filesInDir = scriptListFromDir(path);
+    MetadataCache metadata;
+    ScriptList scripts = readScripts(path, m_cache, metadata);
 
-    // Remove deleted scripts
+    // Remove the scripts deleted, or changed, from the directory
     auto it = m_scriptList.begin();
     while (it != m_scriptList.end()) {
-        const auto &script = *it;
-
-        // Only remove the script if it was actually in the directory that had changes
-        if (script.fileName.startsWith(path) && !filesInDir.contains(script.fileName)) {
-            it = removeScript(it);
-        } else {
-            ++it;
+        if (directoryOf(it->fileName) == path) {
+            const auto data = metadata.constFind(it->fileName);
+            if (data == metadata.cend() || data->description != it->description) {
+                it = removeScript(it);
+                continue;
+            }
         }
+        ++it;
     }
 
-    auto scriptToFileName = [](const auto &script) {
-        return script.fileName;
-    };
-    auto currentFileNames = kdalgorithms::transformed(m_scriptList, scriptToFileName);
-    // Add new scripts
-    for (const auto &fileName : filesInDir) {
-        if (!kdalgorithms::contains(currentFileNames, fileName)) {
-            addScript(fileName);
-        }
+    // Add the new ones
+    QSet<QString> currentFileNames;
+    for (const auto &script : m_scriptList)
+        currentFileNames.insert(script.fileName);
+    for (auto &script : scripts) {
+        if (!currentFileNames.contains(script.fileName))
+            addScript(std::move(script));
     }
+    updateCache(path, std::move(metadata));
 }
 
 void ScriptManager::addScriptsFromPath(const QString &path)
@@ -167,9 +228,31 @@ void ScriptManager::addScriptsFromPath(const QString &path)
     m_directories.append(path);
     m_watcher->addPath(path);
 
-    const QStringList files = scriptListFromDir(path);
-    for (const auto &fileName : files)
-        addScript(fileName);
+    if (m_loadAsynchronously) {
+        ++m_loadingDirectories;
+        QPointer<ScriptManager> manager(this);
+        // The cache is implicitly shared, the worker gets a snapshot of it
+        Utils::TaskScheduler::start(
+            [manager, path, cache = m_cache]() {
+                MetadataCache metadata;
+                ScriptList scripts = readScripts(path, cache, metadata);
+                QMetaObject::invokeMethod(
+                    QCoreApplication::instance(),
+                    [manager, path, scripts = std::move(scripts), metadata = std::move(metadata)]() mutable {
+                        if (manager)
+                            manager->addLoadedScripts(path, std::move(scripts), std::move(metadata));
+                    },
+                    Qt::QueuedConnection);
+            },
+            Utils::TaskScheduler::Background);
+        return;
+    }
+
+    MetadataCache metadata;
+    ScriptList scripts = readScripts(path, m_cache, metadata);
+    for (auto &script : scripts)
+        addScript(std::move(script));
+    updateCache(path, std::move(metadata));
 }
 
 void ScriptManager::removeScriptsFromPath(const QString &path)
@@ -179,10 +262,9 @@ void ScriptManager::removeScriptsFromPath(const QString &path)
     if (m_watcher->directories().contains(path))
         m_watcher->removePath(path);
 
-    const QStringList files = scriptListFromDir(path);
     auto it = m_scriptList.begin();
     while (it != m_scriptList.end()) {
-        if (files.contains(it->fileName)) {
+        if (directoryOf(it->fileName) == path) {
             it = removeScript(it);
         } else {
             ++it;
@@ -190,6 +272,76 @@ void ScriptManager::removeScriptsFromPath(const QString &path)
     }
 }
 
+void ScriptManager::updateCache(const QString &path, MetadataCache &&metadata)
+{
+    bool changed = false;
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        if (directoryOf(it.key()) == path && !metadata.contains(it.key())) {
+            it = m_cache.erase(it);
+            changed = true;
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = metadata.begin(); it != metadata.end(); ++it) {
+        auto &data = m_cache[it.key()];
+        if (data.lastModified != it->lastModified || data.size != it->size || data.description != it->description) {
+            data = std::move(*it);
+            changed = true;
+        }
+    }
+    if (changed)
+        m_saveCacheTimer->start();
+}
+
+static QString cacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/scripts.json";
+}
+
+void ScriptManager::loadCache()
+{
+    if (!m_persistCache)
+        return;
+
+    QFile file(cacheFileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    const auto json = nlohmann::json::parse(file.readAll().constData(), nullptr, false);
+    if (!json.is_object() || json.value("version", 0) != CacheVersion)
+        return;
+
+    for (const auto &[fileName, data] : json.value("scripts", nlohmann::json::object()).items()) {
+        m_cache.insert(QString::fromStdString(fileName),
+                       Metadata {data.value("lastModified", qint64(0)), data.value("size", qint64(0)),
+                                 QString::fromStdString(data.value("description", std::string()))});
+    }
+}
+
+void ScriptManager::saveCache()
+{
+    m_saveCacheTimer->stop();
+    if (!m_persistCache)
+        return;
+
+    auto scripts = nlohmann::json::object();
+    for (auto it = m_cache.cbegin(); it != m_cache.cend(); ++it) {
+        scripts[it.key().toStdString()] = {{"lastModified", it->lastModified},
+                                           {"size", it->size},
+                                           {"description", it->description.toStdString()}};
+    }
+    const nlohmann::json json = {{"version", CacheVersion}, {"scripts", scripts}};
+
+    QDir().mkpath(QFileInfo(cacheFileName()).absolutePath());
+    QSaveFile file(cacheFileName());
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QByteArray::fromStdString(json.dump()));
+        file.commit();
+    }
+    if (file.error() != QFileDevice::NoError)
+        spdlog::warn("ScriptManager::saveCache - can't write {}", cacheFileName());
+}
+
 ScriptManager::ScriptList::iterator ScriptManager::removeScript(const ScriptList::iterator &iterator)
 {
     auto script = *iterator;
@@ -201,6 +353,13 @@ ScriptManager::ScriptList::iterator ScriptManager::removeScript(const ScriptList
 
 void ScriptManager::doRunScript(const QString &fileName, const std::function<void()> &endFunc)
 {
+    // The end function is only called if the script can be run
+    const QFileInfo fi(fileName);
+    if (fi.exists() && fi.isReadable()) {
+        ++m_runningScripts;
+        emit scriptStarted();
+    }
+
     m_result = m_runner->runScript(fileName, endFunc);
     if (m_runner->hasError()) {
         const auto errors = m_runner->errors();
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <QHash>
 #include <QObject>
 #include <QStringList>
 #include <QVariant>
@@ -18,6 +19,7 @@
 
 class QFileSystemWatcher;
 class QAbstractItemModel;
+class QTimer;
 
 namespace Core {
 
@@ -30,6 +32,12 @@ class ScriptRunner;
  *
  * Scripts directory are watched using a QFileSystemWatcher, to update
  * the list of script in case one is added or deleted.
+ *
+ * In the GUI, the script directories are read on a worker thread, so the window can show up without waiting for them:
+ * the scripts are added once read, and scriptsLoaded is emitted when all the directories are done.
+ *
+ * The description of each script is kept in a cache file, with the modification time and size of the script, so the
+ * scripts are only read again when they change.
  */
 class ScriptManager : public QObject
 {
@@ -57,11 +65,18 @@ public:
 
     static QAbstractItemModel *model();
 
+    // Returns true while a script is running, including the asynchronous qml scripts waiting for their end
+    bool isRunning() const { return m_runningScripts > 0; }
+    // Returns true while script directories are read asynchronously
+    bool isLoading() const { return m_loadingDirectories > 0; }
+
 public slots:
     void runScript(const QString &fileName, bool async = true, bool log = true);
 
 signals:
+    void scriptStarted();
     void scriptFinished(const QVariant &result);
+    void scriptsLoaded();
 
     // Added to allow models to call beginInsertRows, etc. correctly
     void aboutToAddScript(const Core::ScriptManager::Script &script, int index);
@@ -73,12 +88,28 @@ signals:
 
 private:
     friend class KnutCore;
-    explicit ScriptManager(QObject *parent = nullptr);
+    explicit ScriptManager(bool loadAsynchronously, QObject *parent = nullptr);
+
+    struct Metadata
+    {
+        qint64 lastModified = 0;
+        qint64 size = 0;
+        QString description;
+    };
+    // Metadata of the script files, by file name
+    using MetadataCache = QHash<QString, Metadata>;
+
+    static ScriptList readScripts(const QString &path, const MetadataCache &cache, MetadataCache &metadata);
 
-    void addScript(const QString &fileName);
+    void addScript(Script &&script);
     void addScriptsFromPath(const QString &path);
+    void addLoadedScripts(const QString &path, ScriptList &&scripts, MetadataCache &&metadata);
     void removeScriptsFromPath(const QString &path);
 
+    void updateCache(const QString &path, MetadataCache &&metadata);
+    void loadCache();
+    void saveCache();
+
     void doRunScript(const QString &fileName, const std::function<void()> &endFunc);
 
     void updateDirectories();
@@ -95,6 +126,13 @@ private:
     ScriptList m_scriptList;
     QStringList m_directories;
     QVariant m_result;
+    int m_runningScripts = 0;
+    const bool m_loadAsynchronously = false;
+    int m_loadingDirectories = 0;
+
+    MetadataCache m_cache;
+    QTimer *const m_saveCacheTimer;
+    const bool m_persistCache = true;
 };
 
 } // namespace Core
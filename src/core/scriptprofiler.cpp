@@ -0,0 +1,166 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "scriptprofiler.h"
+#include "utils/json.h"
+
+#include <QFile>
+#include <QJSEngine>
+#include <QtQml/private/qv4engine_p.h>
+#include <algorithm>
+#include <numeric>
+
+namespace Core {
+
+ScriptProfiler &ScriptProfiler::instance()
+{
+    static ScriptProfiler profiler;
+    return profiler;
+}
+
+void ScriptProfiler::start()
+{
+    m_enabled = true;
+    m_timer.start();
+}
+
+void ScriptProfiler::enter(const QString &name)
+{
+    // Only the outermost call is made by the script
+    const int line = m_stack.empty() ? lineId() : -1;
+    m_stack.push_back({nameId(name), m_timer.nsecsElapsed(), 0, line});
+}
+
+void ScriptProfiler::leave()
+{
+    if (m_stack.empty())
+        return;
+    const auto frame = m_stack.back();
+    m_stack.pop_back();
+
+    const auto duration = m_timer.nsecsElapsed() - frame.start;
+    auto &statistics = m_statistics[frame.nameId];
+    ++statistics.count;
+    statistics.selfTime += duration - frame.childrenTime;
+    // Recursive calls of the same API are only counted once in the total time
+    const bool isRecursive = std::ranges::any_of(m_stack, [&frame](const Frame &parent) {
+        return parent.nameId == frame.nameId;
+    });
+    if (!isRecursive)
+        statistics.totalTime += duration;
+    if (!m_stack.empty())
+        m_stack.back().childrenTime += duration;
+    else
+        m_apiTime += duration;
+
+    if (m_events.size() < MaxEvents)
+        m_events.push_back({frame.nameId, frame.lineId, frame.start, duration});
+}
+
+void ScriptProfiler::setEngine(QJSEngine *engine)
+{
+    m_engine = engine;
+}
+
+int ScriptProfiler::nameId(const QString &name)
+{
+    const auto it = m_nameIds.constFind(name);
+    if (it != m_nameIds.cend())
+        return it.value();
+    const int id = static_cast<int>(m_names.size());
+    m_names.push_back(name);
+    m_nameIds.insert(name, id);
+    m_statistics.emplace_back();
+    return id;
+}
+
+int ScriptProfiler::lineId()
+{
+    if (!m_engine)
+        return -1;
+    const auto stackTrace = m_engine->handle()->stackTrace(1);
+    if (stackTrace.isEmpty())
+        return -1;
+
+    const auto &frame = stackTrace.first();
+    const QString line = QStringLiteral("%1:%2").arg(frame.source).arg(frame.line);
+    auto it = m_lineIds.constFind(line);
+    if (it == m_lineIds.cend()) {
+        it = m_lineIds.insert(line, static_cast<int>(m_lines.size()));
+        m_lines.push_back(line);
+        m_lineCounts.push_back(0);
+    }
+    ++m_lineCounts[it.value()];
+    return it.value();
+}
+
+std::string ScriptProfiler::report() const
+{
+    // Times are in microseconds, as expected by the trace event format
+    auto toMicroseconds = [](qint64 nsecs) {
+        return static_cast<double>(nsecs) / 1000.0;
+    };
+
+    auto traceEvents = nlohmann::json::array();
+    for (const auto &event : m_events) {
+        nlohmann::json traceEvent = {{"name", m_names[event.nameId].toStdString()},
+                                     {"ph", "X"},
+                                     {"ts", toMicroseconds(event.start)},
+                                     {"dur", toMicroseconds(event.duration)},
+                                     {"pid", 1},
+                                     {"tid", 1}};
+        if (event.lineId != -1)
+            traceEvent["args"] = {{"line", m_lines[event.lineId].toStdString()}};
+        traceEvents.push_back(std::move(traceEvent));
+    }
+
+    // Slowest APIs first
+    std::vector<int> apis(m_names.size());
+    std::iota(apis.begin(), apis.end(), 0);
+    std::ranges::sort(apis, std::greater {}, [this](int id) {
+        return m_statistics[id].totalTime;
+    });
+    auto apiStatistics = nlohmann::json::array();
+    for (const int id : apis) {
+        const auto &statistics = m_statistics[id];
+        apiStatistics.push_back({{"name", m_names[id].toStdString()},
+                                 {"count", statistics.count},
+                                 {"totalTime", toMicroseconds(statistics.totalTime)},
+                                 {"selfTime", toMicroseconds(statistics.selfTime)}});
+    }
+
+    // Lines with the most calls first
+    std::vector<int> lines(m_lines.size());
+    std::iota(lines.begin(), lines.end(), 0);
+    std::ranges::sort(lines, std::greater {}, [this](int id) {
+        return m_lineCounts[id];
+    });
+    auto lineStatistics = nlohmann::json::array();
+    for (const int id : lines)
+        lineStatistics.push_back({{"line", m_lines[id].toStdString()}, {"count", m_lineCounts[id]}});
+
+    const nlohmann::json json = {{"traceEvents", std::move(traceEvents)},
+                                 {"displayTimeUnit", "ms"},
+                                 {"truncated", m_events.size() == MaxEvents},
+                                 {"apiTime", toMicroseconds(m_apiTime)},
+                                 {"apis", std::move(apiStatistics)},
+                                 {"lines", std::move(lineStatistics)}};
+    return json.dump();
+}
+
+bool ScriptProfiler::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(QByteArray::fromStdString(report())) != -1;
+}
+
+}
@@ -0,0 +1,103 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+#include <string>
+#include <vector>
+
+class QJSEngine;
+
+namespace Core {
+
+/**
+ * \brief Profiles the script API calls
+ *
+ * Enabled with the `--profile <file>` command line option. Each API call logged with LOG is timed, nested calls
+ * included, and the script line of the outermost call is counted.
+ *
+ * The report is a trace event file, which can be opened as a flame graph in Perfetto, speedscope or chrome://tracing.
+ * Only used from the main thread.
+ */
+class ScriptProfiler
+{
+public:
+    static ScriptProfiler &instance();
+
+    static bool isEnabled() { return m_enabled; }
+    void start();
+
+    // Called by LoggerObject, at the start and end of an API call
+    void enter(const QString &name);
+    void leave();
+
+    // The engine running the script, used to find the script line calling an API
+    void setEngine(QJSEngine *engine);
+
+    // Time spent in the outermost API calls, in nanoseconds: the rest of the script time is spent in the engine
+    qint64 apiTime() const { return m_apiTime; }
+
+    // Trace events, followed by the statistics per API and per script line, as json
+    std::string report() const;
+    bool save(const QString &fileName) const;
+
+private:
+    ScriptProfiler() = default;
+
+    int nameId(const QString &name);
+    int lineId();
+
+    struct Frame
+    {
+        int nameId;
+        qint64 start;
+        qint64 childrenTime = 0;
+        int lineId = -1;
+    };
+    struct Event
+    {
+        int nameId;
+        int lineId;
+        qint64 start;
+        qint64 duration;
+    };
+    struct Statistics
+    {
+        int count = 0;
+        qint64 totalTime = 0;
+        qint64 selfTime = 0;
+    };
+
+    // Only the first events are kept in the trace, the statistics are always updated
+    static constexpr size_t MaxEvents = 1'000'000;
+
+    inline static bool m_enabled = false;
+    QElapsedTimer m_timer;
+    std::vector<Frame> m_stack;
+    std::vector<Event> m_events;
+    qint64 m_apiTime = 0;
+
+    // API names and script lines are stored once, events only refer to them by id
+    QStringList m_names;
+    QHash<QString, int> m_nameIds;
+    std::vector<Statistics> m_statistics;
+    QStringList m_lines;
+    QHash<QString, int> m_lineIds;
+    std::vector<int> m_lineCounts;
+
+    QPointer<QJSEngine> m_engine;
+};
+
+}
@@ -49,7 +49,8 @@ void ScriptProgressDialog::setValue(int progress)
 
 void ScriptProgressDialog::setInteractive(bool interactive)
 {
-    ui->buttonBox->setVisible(interactive);
+    // The script can always be aborted, only interactive scripts wait to continue
+    ui->buttonBox->button(QDialogButtonBox::Yes)->setVisible(interactive);
     setModal(!interactive);
     adjustSize();
 }
@@ -61,5 +62,5 @@ int ScriptProgressDialog::value() const
 
 void ScriptProgressDialog::setReadOnly(bool readOnly)
 {
-    ui->buttonBox->setEnabled(!readOnly);
+    ui->buttonBox->button(QDialogButtonBox::Yes)->setEnabled(!readOnly);
 }
@@ -30,6 +30,7 @@ public:
     void setValue(int progress);
 
     void setInteractive(bool interactive);
+    // While a step runs: the script can't continue, but can still be aborted
     void setReadOnly(bool readOnly);
 
     int value() const;
@@ -9,28 +9,44 @@
 */
 
 #include "scriptrunner.h"
+#include "astnode.h"
 #include "classsymbol.h"
 #include "cppdocument.h"
 #include "dir.h"
+#include "dirwalker.h"
 #include "file.h"
 #include "fileinfo.h"
 #include "functionsymbol.h"
+#include "jsondocument.h"
 #include "mark.h"
 #include "message.h"
+#include "messagemap.h"
+#include "pipeline.h"
 #include "project.h"
+#include "projectquerymatch.h"
+#include "qmldocument.h"
+#include "queryiterator.h"
+#include "querymatch.h"
 #include "qttsdocument.h"
 #include "qtuidocument.h"
+#include "rangemark.h"
 #include "rcdocument.h"
 #include "scriptdialogitem.h"
 #include "scriptitem.h"
+#include "scriptprofiler.h"
 #include "settings.h"
 #include "symbol.h"
+#include "symbolindex.h"
 #include "testutil.h"
 #include "textdocument.h"
+#include "textlocation.h"
 #include "textrange.h"
 #include "userdialog.h"
 #include "utils.h"
+#include "utils/cancellation.h"
 #include "utils/log.h"
+#include "utils/trace.h"
+#include "workspacesymboliterator.h"
 
 #include <QDir>
 #include <QFile>
@@ -40,6 +56,8 @@
 #include <QQuickWindow>
 #include <QtQml/private/qqmlengine_p.h>
 #include <kdalgorithms.h>
+#include <memory>
+#include <mutex>
 
 namespace Core {
 
@@ -56,8 +74,24 @@ void addProperties(QSet<QString> &properties)
     }
 }
 
+template <typename List>
+void registerSequence()
+{
+    qmlRegisterAnonymousSequentialContainer<List>("Script", 1);
+}
+
 ScriptRunner::ScriptRunner(QObject *parent)
     : QObject(parent)
+{
+    // The registrations are global, nested runners and test runs would only register the same types again
+    static std::once_flag registered;
+    std::call_once(registered, &ScriptRunner::registerTypes);
+
+    // The progress dialogs are still updated, and can abort the script, while waiting for an LSP server
+    Utils::Cancellation::setPollCallback(&ScriptDialogItem::updateProgress);
+}
+
+void ScriptRunner::registerTypes()
 {
     // Script objects registrations
     qRegisterMetaType<FunctionArgument>();
@@ -97,13 +131,24 @@ ScriptRunner::ScriptRunner(QObject *parent)
     });
 
     qmlRegisterUncreatableType<Document>("Script", 1, 0, "Document", "Abstract class");
-    qmlRegisterType<ScriptDialogItem>("Script", 1, 0, "ScriptDialog");
+    // A script dialog is a widget, knut-cli can't create it
+    if (Settings::hasWidgets())
+        qmlRegisterType<ScriptDialogItem>("Script", 1, 0, "ScriptDialog");
+    else
+        qmlRegisterTypeNotAvailable("Script", 1, 0, "ScriptDialog", "ScriptDialog needs the user interface of knut");
     qmlRegisterType<ScriptItem>("Script", 1, 0, "Script");
     qmlRegisterType<TextDocument>("Script", 1, 0, "TextDocument");
+    qmlRegisterType<JsonDocument>("Script", 1, 0, "JsonDocument");
     qmlRegisterType<QtUiDocument>("Script", 1, 0, "QtUiDocument");
     qmlRegisterUncreatableType<QtUiWidget>("Script", 1, 0, "QtUiWidget", "Only created by QtUiDocument");
     qmlRegisterType<CppDocument>("Script", 1, 0, "CppDocument");
+    qmlRegisterType<QmlDocument>("Script", 1, 0, "QmlDocument");
     qmlRegisterUncreatableType<Core::Symbol>("Script", 1, 0, "Symbol", "Only created by CodeDocument");
+    qmlRegisterUncreatableType<QueryIterator>("Script", 1, 0, "QueryIterator", "Only created by CodeDocument");
+    qmlRegisterUncreatableType<DirWalker>("Script", 1, 0, "DirWalker", "Only created by Dir");
+    qmlRegisterUncreatableType<WorkspaceSymbolIterator>("Script", 1, 0, "WorkspaceSymbolIterator",
+                                                        "Only created by Project");
+    qmlRegisterUncreatableType<Pipeline>("Script", 1, 0, "Pipeline", "Only created by Project");
     qmlRegisterType<RcDocument>("Script", 1, 0, "RcDocument");
     qmlRegisterType<QtTsDocument>("Script", 1, 0, "QtTsDocument");
     qmlRegisterUncreatableType<QtTsMessage>("Script", 1, 0, "QtTsMessage", "Only created by QtTsDocument");
@@ -137,6 +182,31 @@ ScriptRunner::ScriptRunner(QObject *parent)
     qRegisterMetaType<RcCore::Ribbon>();
     qRegisterMetaType<QList<RcCore::Ribbon>>();
 
+    // Lists are exposed as sequences: the javascript object wraps the list, without copying it, and each element is
+    // only converted when accessed. Otherwise the whole list is converted to a javascript array up front.
+    registerSequence<QList<FunctionArgument>>();
+    registerSequence<AstNodeList>();
+    registerSequence<IndexedSymbolList>();
+    registerSequence<MessageMapEntryList>();
+    registerSequence<ProjectQueryMatchList>();
+    registerSequence<QueryMatchList>();
+    registerSequence<RangeMarkList>();
+    registerSequence<SymbolList>();
+    registerSequence<TextLocationList>();
+    registerSequence<QList<RcCore::Asset>>();
+    registerSequence<QList<RcCore::ToolBarItem>>();
+    registerSequence<QList<RcCore::ToolBar>>();
+    registerSequence<QList<RcCore::Widget>>();
+    registerSequence<QList<RcCore::MenuItem>>();
+    registerSequence<QList<RcCore::Menu>>();
+    registerSequence<QList<RcCore::Shortcut>>();
+    registerSequence<QList<RcCore::Action>>();
+    registerSequence<QList<RcCore::RibbonElement>>();
+    registerSequence<QList<RcCore::RibbonPanel>>();
+    registerSequence<QList<RcCore::RibbonCategory>>();
+    registerSequence<QList<RcCore::RibbonContext>>();
+    registerSequence<QList<RcCore::Ribbon>>();
+
     // Script.Test
     qmlRegisterSingletonType<TestUtil>("Script.Test", 1, 0, "TestUtil", [](QQmlEngine *, QJSEngine *) {
         return new TestUtil();
@@ -167,7 +237,11 @@ ScriptRunner::ScriptRunner(QObject *parent)
     addProperties<QtTsMessage>(m_properties);
 }
 
-ScriptRunner::~ScriptRunner() = default;
+ScriptRunner::~ScriptRunner()
+{
+    for (auto &[path, pooledEngine] : m_enginePool)
+        delete pooledEngine.engine;
+}
 
 QVariant ScriptRunner::runScript(const QString &fileName, const std::function<void()> &endCallback)
 {
@@ -181,17 +255,25 @@ QVariant ScriptRunner::runScript(const QString &fileName, const std::function<vo
     if (fi.exists() && fi.isReadable()) {
         // TODO set the current project directory as the current path before running the script
 
-        // Run the script
-        auto engine = getEngine(fullName);
-        if (endCallback)
-            connect(engine, &QObject::destroyed, this, endCallback);
-
+        // Run the script, it's not stopped by the abort of a previous one
+        if (m_runningScripts == 0)
+            Utils::Cancellation::reset();
+        ++m_runningScripts;
         if (fi.suffix() == "js") {
-            result = runJavascript(fullName, engine);
+            // Javascript runs are synchronous, the engine is put back in the pool once done
+            auto pooledEngine = takePooledEngine(fullName);
+            result = runJavascript(fullName, pooledEngine);
+            releasePooledEngine(fullName, std::move(pooledEngine));
+            if (endCallback)
+                QMetaObject::invokeMethod(this, endCallback, Qt::QueuedConnection);
         } else {
+            auto engine = getEngine(fullName);
+            if (endCallback)
+                connect(engine, &QObject::destroyed, this, endCallback);
             result = runQml(fullName, engine);
+            // engine is deleted in runQml
         }
-        // engine is deleted in runJavascript or runQml
+        --m_runningScripts;
     } else {
         spdlog::error("File {} doesn't exist", fileName);
         return QVariant(ErrorCode);
@@ -200,6 +282,33 @@ QVariant ScriptRunner::runScript(const QString &fileName, const std::function<vo
     return result;
 }
 
+bool ScriptRunner::compileScript(const QString &fileName)
+{
+    TRACE("ScriptRunner::compileScript", fileName);
+    const auto fullName = QFileInfo(fileName).absoluteFilePath();
+    m_hasError = false;
+
+    // Javascript components are kept in the pool, so a run in the same process doesn't compile the script again
+    auto pooledEngine = takePooledEngine(fullName);
+    if (QFileInfo(fullName).suffix() == "js") {
+        auto component = scriptComponent(fullName, pooledEngine);
+        m_hasError = !component->isReady();
+        if (m_hasError) {
+            filterErrors(*component);
+            pooledEngine.scripts.remove(fullName);
+            delete component;
+        }
+    } else {
+        QQmlComponent component(pooledEngine.engine);
+        component.loadUrl(QUrl::fromLocalFile(fullName));
+        m_hasError = !component.isReady();
+        if (m_hasError)
+            filterErrors(component);
+    }
+    releasePooledEngine(fullName, std::move(pooledEngine));
+    return !m_hasError;
+}
+
 bool ScriptRunner::isProperty(const QString &apiCall)
 {
     return m_properties.contains(apiCall);
@@ -231,8 +340,40 @@ QQmlEngine *ScriptRunner::getEngine(const QString &fileName)
     return engine;
 }
 
-QVariant ScriptRunner::runJavascript(const QString &fileName, QQmlEngine *engine)
+ScriptRunner::PooledEngine ScriptRunner::takePooledEngine(const QString &fileName)
 {
+    const QFileInfo fi(fileName);
+    // Nested runs from the same directory won't find an engine, as it's already in use
+    auto node = m_enginePool.extract(fi.absolutePath());
+    if (node.empty())
+        return PooledEngine {.engine = getEngine(fileName)};
+
+    currentScriptPath = fi.absoluteFilePath();
+    return std::move(node.mapped());
+}
+
+void ScriptRunner::releasePooledEngine(const QString &fileName, PooledEngine &&pooledEngine)
+{
+    // Only one idle engine is kept per directory
+    const auto [it, inserted] = m_enginePool.try_emplace(QFileInfo(fileName).absolutePath(), std::move(pooledEngine));
+    if (!inserted)
+        delete pooledEngine.engine;
+}
+
+QQmlComponent *ScriptRunner::scriptComponent(const QString &fileName, PooledEngine &pooledEngine)
+{
+    const auto lastModified = QFileInfo(fileName).lastModified();
+    auto it = pooledEngine.scripts.find(fileName);
+    if (it != pooledEngine.scripts.end()) {
+        if (it->lastModified == lastModified)
+            return it->component;
+        // The script changed since it was compiled, make sure the engine loads it again
+        for (const auto &script : std::as_const(pooledEngine.scripts))
+            delete script.component;
+        pooledEngine.scripts.clear();
+        pooledEngine.engine->clearComponentCache();
+    }
+
     const QString text =
         QStringLiteral(
             "import QtQml\n"
@@ -241,23 +382,38 @@ QVariant ScriptRunner::runJavascript(const QString &fileName, QQmlEngine *engine
             "QtObject { property var _scriptResult; Component.onCompleted : _scriptResult = MyScript.main() }")
             .arg(QUrl::fromLocalFile(fileName).toString());
 
-    QQmlComponent component(engine);
-    component.setData(text.toLatin1(), QUrl::fromLocalFile(fileName));
+    auto component = new QQmlComponent(pooledEngine.engine, pooledEngine.engine);
+    component->setData(text.toLatin1(), QUrl::fromLocalFile(fileName));
+    pooledEngine.scripts.insert(fileName, {lastModified, component});
+    return component;
+}
 
-    auto *result = qobject_cast<QObject *>(component.create());
-    engine->deleteLater();
-    m_hasError = component.isError();
-    if (component.isReady() && !m_hasError)
+QVariant ScriptRunner::runJavascript(const QString &fileName, PooledEngine &pooledEngine)
+{
+    TRACE("ScriptRunner::runJavascript", fileName);
+    auto component = scriptComponent(fileName, pooledEngine);
+    if (ScriptProfiler::isEnabled())
+        ScriptProfiler::instance().setEngine(pooledEngine.engine);
+
+    std::unique_ptr<QObject> result(component->create());
+    m_hasError = component->isError();
+    if (component->isReady() && !m_hasError && result)
         return result->property("_scriptResult");
 
-    filterErrors(component);
+    filterErrors(*component);
+    // Don't keep a broken script, it will be compiled again on the next run
+    pooledEngine.scripts.remove(fileName);
+    component->deleteLater();
     return QVariant(ErrorCode);
 }
 
 QVariant ScriptRunner::runQml(const QString &fileName, QQmlEngine *engine)
 {
+    TRACE("ScriptRunner::runQml", fileName);
     auto component = new QQmlComponent(engine, engine);
     component->loadUrl(QUrl::fromLocalFile(fileName));
+    if (ScriptProfiler::isEnabled())
+        ScriptProfiler::instance().setEngine(engine);
 
     if (component->isReady()) {
         QObject *topLevel = component->create();
@@ -10,12 +10,15 @@
 
 #pragma once
 
+#include <QDateTime>
+#include <QHash>
 #include <QObject>
 #include <QQmlEngine>
 #include <QSet>
 #include <QSharedPointer>
 #include <QString>
 #include <functional>
+#include <unordered_map>
 
 namespace Core {
 
@@ -36,25 +39,51 @@ public:
     // Run a script
     using EndScriptFunc = std::function<void()>;
     QVariant runScript(const QString &fileName, const EndScriptFunc &endCallback = {});
+    // Compiles a script without running it, the engine writes the compiled script to its disk cache
+    bool compileScript(const QString &fileName);
 
     bool hasError() const { return m_hasError; }
     QList<QQmlError> errors() const { return m_errors; }
 
     static bool isProperty(const QString &apiCall);
+    // True while a script is running synchronously, that is until runScript returns
+    static bool isRunning() { return m_runningScripts > 0; }
 
 private:
+    // Engine kept between javascript runs, with the components created for each script
+    struct PooledEngine
+    {
+        QQmlEngine *engine = nullptr;
+        struct Script
+        {
+            QDateTime lastModified;
+            QQmlComponent *component = nullptr;
+        };
+        QHash<QString, Script> scripts;
+    };
+
+    // Registers the types of the Script and Script.Test modules, once for the process
+    static void registerTypes();
+
     QQmlEngine *getEngine(const QString &fileName);
-    QVariant runJavascript(const QString &fileName, QQmlEngine *engine);
+    PooledEngine takePooledEngine(const QString &fileName);
+    void releasePooledEngine(const QString &fileName, PooledEngine &&pooledEngine);
+    QQmlComponent *scriptComponent(const QString &fileName, PooledEngine &pooledEngine);
+    QVariant runJavascript(const QString &fileName, PooledEngine &pooledEngine);
     QVariant runQml(const QString &fileName, QQmlEngine *engine);
     void filterErrors(const QQmlComponent &component);
 
 private:
     friend class ScriptDialogItem;
     inline static QString currentScriptPath;
+    inline static int m_runningScripts = 0;
 
     bool m_hasError = false;
     QList<QQmlError> m_errors;
 
+    // Idle engines, by script directory: the Dir singleton of an engine depends on it
+    std::unordered_map<QString, PooledEngine> m_enginePool;
+
     inline static QSet<QString> m_properties = {};
 };
 
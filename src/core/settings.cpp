@@ -13,6 +13,7 @@
 #include "rcdocument.h"
 #include "scriptmanager.h"
 
+#include <QCoreApplication>
 #include <QDir>
 #include <QFile>
 #include <QStandardPaths>
@@ -78,6 +79,7 @@ Settings::Settings(Mode mode, QObject *parent)
     loadKnutSettings();
     if (!isTesting()) // Only load if not testing
         loadUserSettings();
+    updateSnapshot();
 
     m_saveTimer->callOnTimeout(this, &Settings::saveSettings);
     m_saveTimer->setSingleShot(true);
@@ -94,12 +96,18 @@ Settings *Settings::instance()
     return m_instance;
 }
 
+bool Settings::exists()
+{
+    return m_instance != nullptr;
+}
+
 void Settings::loadUserSettings()
 {
     auto userSettings = loadSettings(userFilePath());
     if (userSettings) {
         m_userSettings = userSettings.value();
         m_settings.merge_patch(m_userSettings);
+        updateSnapshot();
         emit settingsLoaded();
     }
 }
@@ -111,6 +119,7 @@ void Settings::loadProjectSettings(const QString &rootDir)
     if (projectSettings) {
         m_projectSettings = projectSettings.value();
         m_settings.merge_patch(m_projectSettings);
+        updateSnapshot();
         emit settingsLoaded();
     }
 }
@@ -223,6 +232,7 @@ bool Settings::setValue(QString path, const QVariant &value)
         return false;
     }
 
+    updateSnapshot();
     emit settingsChanged(path);
     // Asynchronous save
     m_saveTimer->start();
@@ -249,14 +259,36 @@ QString Settings::logFilePath() const
     return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/knut.log";
 }
 
+// Returns the directory storing caches for the current project, empty if there's no project or for tests
+QString Settings::cachePath() const
+{
+    if (isUser() || isTesting())
+        return {};
+    return m_projectPath + "/.knut/cache";
+}
+
 bool Settings::isTesting() const
 {
     return (m_mode == Mode::Test);
 }
 
+bool Settings::isGui() const
+{
+    return m_mode == Mode::Gui;
+}
+
+bool Settings::hasWidgets()
+{
+    return QCoreApplication::instance() && QCoreApplication::instance()->inherits("QApplication");
+}
+
 bool Settings::hasLsp() const
 {
-    return m_mode == Mode::Test || (m_mode == Mode::Gui && DEFAULT_VALUE(bool, EnableLSP));
+    // Starting a LSP server for each knut run is too slow, unless the server is shared by a broker
+    const auto &settings = snapshot();
+    if (m_mode == Mode::Cli)
+        return settings.lspEnabled && settings.lspBroker;
+    return m_mode == Mode::Test || (m_mode == Mode::Gui && settings.lspEnabled);
 }
 
 void Settings::loadKnutSettings()
@@ -291,6 +323,30 @@ bool Settings::isUser() const
     return m_projectPath.isEmpty();
 }
 
+void Settings::updateSnapshot()
+{
+    auto snapshot = std::make_unique<SettingsSnapshot>();
+    snapshot->mimeTypes = value<std::map<std::string, Document::Type>>(MimeTypes);
+    snapshot->lspServers = value<std::vector<LspServer>>(LspServers);
+    snapshot->lspEnabled = value<bool>(EnableLSP);
+    snapshot->lspBroker = value<bool>(LspBroker);
+    snapshot->lspBrokerIdleTimeout = value<int>(LspBrokerIdleTimeout);
+    snapshot->lspMaxOpenDocuments = value<int>(LspMaxOpenDocuments);
+    snapshot->lspShards = value<QStringList>(LspShards);
+    snapshot->lspIndexTimeout = value<int>(LspIndexTimeout);
+    snapshot->lspReferencesWaitForIndex = value<bool>(LspReferencesWaitForIndex);
+    snapshot->parseTimeout = value<int>(ParseTimeout);
+    snapshot->rangeParseThreshold = value<int>(RangeParseThreshold);
+    snapshot->maxOpenDocuments = value<int>(MaxOpenDocuments);
+    snapshot->fallbackEncoding = value<QString>(FallbackEncoding);
+
+    const auto current = m_snapshot.load(std::memory_order_relaxed);
+    if (current && *current == *snapshot)
+        return;
+    m_snapshot.store(snapshot.get(), std::memory_order_release);
+    m_snapshots.push_back(std::move(snapshot));
+}
+
 void Settings::addScriptPath(const QString &path)
 {
     updatePaths(path, ScriptPaths, true);
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "document.h"
+#include "project_p.h"
 #include "utils/json.h"
 #include "utils/log.h"
 
@@ -18,9 +19,38 @@
 #include <QStringList>
 #include <QTimer>
 #include <QVariant>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace Core {
 
+/**
+ * \brief Typed copy of the settings read on hot paths
+ *
+ * A snapshot is never changed once published: Settings creates a new one each time the settings are loaded or
+ * changed, so it can be read from any thread without locking.
+ */
+struct SettingsSnapshot
+{
+    std::map<std::string, Document::Type> mimeTypes;
+    std::vector<LspServer> lspServers;
+    bool lspEnabled = false;
+    bool lspBroker = false;
+    int lspBrokerIdleTimeout = 0;
+    int lspMaxOpenDocuments = 0;
+    int lspIndexTimeout = 0;
+    bool lspReferencesWaitForIndex = false;
+    QStringList lspShards;
+    int parseTimeout = 0;
+    int rangeParseThreshold = 0;
+    int maxOpenDocuments = 0;
+    QString fallbackEncoding;
+
+    bool operator==(const SettingsSnapshot &other) const = default;
+};
+
 /**
  * \brief Singleton storing all settings for Knut
  *
@@ -42,6 +72,12 @@ public:
     static inline constexpr char EnableLSP[] = "/lsp/enabled";
     static inline constexpr char MimeTypes[] = "/mime_types";
     static inline constexpr char LspServers[] = "/lsp/servers";
+    static inline constexpr char LspBroker[] = "/lsp/broker/enabled";
+    static inline constexpr char LspBrokerIdleTimeout[] = "/lsp/broker/idle_timeout";
+    static inline constexpr char LspMaxOpenDocuments[] = "/lsp/max_open_documents";
+    static inline constexpr char LspShards[] = "/lsp/shards";
+    static inline constexpr char LspIndexTimeout[] = "/lsp/index_timeout";
+    static inline constexpr char LspReferencesWaitForIndex[] = "/lsp/references_wait_for_index";
     static inline constexpr char RcDialogFlags[] = "/rc/dialog_flags";
     static inline constexpr char RcDialogScaleX[] = "/rc/dialog_scalex";
     static inline constexpr char RcDialogScaleY[] = "/rc/dialog_scaley";
@@ -49,14 +85,25 @@ public:
     static inline constexpr char RcAssetColors[] = "/rc/asset_transparent_colors";
     static inline constexpr char RcLanguageMap[] = "/rc/language_map";
     static inline constexpr char SaveLogsToFile[] = "/logs/saveToFile";
+    static inline constexpr char HistorySize[] = "/logs/historySize";
+    static inline constexpr char ParseTimeout[] = "/treesitter/parseTimeout";
+    static inline constexpr char RangeParseThreshold[] = "/treesitter/rangeParseThreshold";
+    static inline constexpr char MaxOpenDocuments[] = "/project/max_open_documents";
+    static inline constexpr char ProjectExclude[] = "/project/exclude";
+    static inline constexpr char MaxViews[] = "/gui/max_views";
     static inline constexpr char ScriptPaths[] = "/script_paths";
+    static inline constexpr char ThreadCount[] = "/thread_count";
     static inline constexpr char Tab[] = "/text_editor/tab";
+    static inline constexpr char UndoJournal[] = "/text_editor/undo_journal";
+    static inline constexpr char FallbackEncoding[] = "/text_editor/fallback_encoding";
     static inline constexpr char ToggleSection[] = "/toggle_section";
 
 public:
     ~Settings() override;
 
     static Settings *instance();
+    // False until KnutCore creates the settings, e.g. in the tests of TextDocument alone
+    static bool exists();
 
     void loadProjectSettings(const QString &rootDir);
 
@@ -65,6 +112,10 @@ public:
 
     [[nodiscard]] std::string dumpJson() const;
 
+    // Returns the current snapshot, can be called from any thread.
+    // The reference stays valid as long as the settings exist, even after a new snapshot is published.
+    const SettingsSnapshot &snapshot() const { return *m_snapshot.load(std::memory_order_acquire); }
+
     template <typename T>
     T value(std::string path) const
     {
@@ -90,6 +141,7 @@ public:
                 m_userSettings[pointer] = value;
             else
                 m_projectSettings[pointer] = value;
+            updateSnapshot();
             emit settingsChanged(QString::fromStdString(path));
         } catch (...) {
             spdlog::error("Settings::setValue {} - error saving", path);
@@ -105,9 +157,13 @@ public:
     QString userFilePath() const;
     QString projectFilePath() const;
     QString logFilePath() const;
+    QString cachePath() const;
 
     bool isTesting() const;
+    bool isGui() const;
     bool hasLsp() const;
+    // False in knut-cli, which has no QApplication: nothing creating a widget (dialogs, previews...) can be used
+    static bool hasWidgets();
 
 public slots:
     bool setValue(QString path, const QVariant &value);
@@ -134,6 +190,7 @@ private:
     void updatePaths(const QString &path, const std::string &json_path, bool add);
     void saveSettings();
     bool isUser() const;
+    void updateSnapshot();
 
     inline static Settings *m_instance = nullptr;
 
@@ -143,6 +200,11 @@ private:
     QString m_projectPath;
     QTimer *m_saveTimer = nullptr;
     Mode m_mode = Mode::Test;
+
+    // Published snapshots are kept alive, so readers on other threads never see a deleted one. Only the snapshots with
+    // a different content are published, there are only a few of them.
+    std::vector<std::unique_ptr<const SettingsSnapshot>> m_snapshots;
+    std::atomic<const SettingsSnapshot *> m_snapshot = nullptr;
 };
 
 } // namespace Core
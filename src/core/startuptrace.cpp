@@ -0,0 +1,44 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "startuptrace.h"
+
+namespace Core {
+
+StartupTrace &StartupTrace::instance()
+{
+    static StartupTrace trace;
+    return trace;
+}
+
+void StartupTrace::start()
+{
+    m_phases.clear();
+    m_timer.start();
+}
+
+void StartupTrace::mark(const QString &phase)
+{
+    if (isEnabled())
+        m_phases.push_back({phase, m_timer.elapsed()});
+}
+
+QString StartupTrace::report() const
+{
+    QString result = QString("Startup trace - %1 ms\n").arg(m_phases.empty() ? 0 : m_phases.back().end);
+    qint64 start = 0;
+    for (const auto &phase : m_phases) {
+        result += QString("%1 ms\t%2\n").arg(phase.end - start, 6).arg(phase.name);
+        start = phase.end;
+    }
+    return result;
+}
+
+}
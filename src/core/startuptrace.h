@@ -0,0 +1,53 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QString>
+#include <vector>
+
+namespace Core {
+
+/**
+ * \brief Times the phases of knut startup
+ *
+ * Enabled with the `--startup-trace` command line option. Each phase is marked when it ends, its duration is the time
+ * since the end of the previous phase. Only used from the main thread.
+ */
+class StartupTrace
+{
+public:
+    static StartupTrace &instance();
+
+    bool isEnabled() const { return m_timer.isValid(); }
+    // Starts the trace, the first phase is counted from here
+    void start();
+
+    // Marks the end of a phase, does nothing if the trace is not enabled
+    void mark(const QString &phase);
+
+    // Human readable report of all phases, in order
+    QString report() const;
+
+private:
+    StartupTrace() = default;
+
+    struct Phase
+    {
+        QString name;
+        qint64 end;
+    };
+
+    QElapsedTimer m_timer;
+    std::vector<Phase> m_phases;
+};
+
+}
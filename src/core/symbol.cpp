@@ -104,20 +104,6 @@ Symbol *Symbol::makeSymbol(QObject *parent, const QueryMatch &match, Kind kind)
     return new Symbol(parent, match, kind);
 }
 
-void Symbol::assignContext(const QList<Symbol *> &contexts)
-{
-    auto names = kdalgorithms::transformed<QStringList>(contexts, &Symbol::name);
-    if (!names.isEmpty()) {
-        m_name = names.join("::") + "::" + m_name;
-    }
-    auto is_class = [](const auto &symbol) {
-        return symbol->kind() == Kind::Class;
-    };
-    if (m_kind == Kind::Function && kdalgorithms::any_of(contexts, is_class)) {
-        m_kind = Kind::Method;
-    }
-}
-
 CodeDocument *Symbol::document() const
 {
     return qobject_cast<CodeDocument *>(parent());
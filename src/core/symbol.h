@@ -99,8 +99,6 @@ public:
     bool operator==(const Symbol &) const;
 
 private:
-    void assignContext(const QList<Symbol *> &contexts);
-
     friend class CodeDocument;
     friend class TreeSitterHelper;
 };
@@ -0,0 +1,561 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "symbolindex.h"
+#include "treesitter/parser.h"
+#include "treesitter/predicates.h"
+#include "treesitter/query.h"
+#include "treesitter/utf8source.h"
+#include "utils/cancellation.h"
+#include "utils/log.h"
+#include "utils/taskscheduler.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <algorithm>
+#include <optional>
+#include <unordered_set>
+
+namespace Core {
+
+/*!
+ * \qmltype IndexedSymbol
+ * \brief Defines a C++ symbol found in the project symbol index.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa Project::findSymbols
+ *
+ * Unlike a [Symbol](symbol.md), an IndexedSymbol is not attached to an opened document: it only stores the file name
+ * and ranges of the symbol at the time the file was indexed.
+ */
+
+/*!
+ * \qmlproperty string IndexedSymbol::name
+ * Name of the symbol, without its scope.
+ */
+/*!
+ * \qmlproperty string IndexedSymbol::scope
+ * Scope of the symbol, that is the enclosing namespaces and classes separated by `::`. It is empty for a global symbol.
+ */
+/*!
+ * \qmlproperty string IndexedSymbol::qualifiedName
+ * Fully qualified name of the symbol, for example `Foo::bar`.
+ */
+/*!
+ * \qmlproperty Symbol::Kind IndexedSymbol::kind
+ * Kind of the symbol: `Symbol.Class`, `Symbol.Method`, `Symbol.Function`, `Symbol.Constructor`, `Symbol.Field`,
+ * `Symbol.Enum`, `Symbol.EnumMember` or `Symbol.Constant` for macros.
+ */
+/*!
+ * \qmlproperty string IndexedSymbol::fileName
+ * Absolute path of the file the symbol is in.
+ */
+/*!
+ * \qmlproperty TextRange IndexedSymbol::range
+ * Range of the whole symbol in the file.
+ */
+/*!
+ * \qmlproperty TextRange IndexedSymbol::selectionRange
+ * Range of the name of the symbol in the file.
+ */
+/*!
+ * \qmlproperty bool IndexedSymbol::isDefinition
+ * True if the symbol is a definition. Only functions and methods have symbols for their declarations too.
+ */
+/*!
+ * \qmlproperty array<string> IndexedSymbol::bases
+ * List of the base classes, as written in the file, for a class.
+ */
+
+QString IndexedSymbol::qualifiedName() const
+{
+    return scope.isEmpty() ? name : scope + "::" + name;
+}
+
+QString IndexedSymbol::toString() const
+{
+    return QString("IndexedSymbol{'%1', %2, '%3', %4}")
+        .arg(qualifiedName())
+        .arg(static_cast<int>(kind))
+        .arg(fileName, range.toString());
+}
+
+//=============================================================================
+// Symbol extraction
+//=============================================================================
+// clang-format off
+static constexpr char SymbolsQuery[] = R"EOF(
+    (class_specifier
+        name: (_) @name
+        (base_class_clause)? @bases
+        body: (field_declaration_list)) @class
+    (struct_specifier
+        name: (_) @name
+        (base_class_clause)? @bases
+        body: (field_declaration_list)) @class
+    (enum_specifier
+        name: (_) @name
+        body: (enumerator_list)) @enum
+    (enumerator
+        name: (_) @name) @enumerator
+    (function_definition
+        declarator: [(function_declarator declarator: (_) @name)
+                     (_ (function_declarator declarator: (_) @name))]) @definition
+    (field_declaration
+        declarator: [(function_declarator declarator: (_) @name)
+                     (_ (function_declarator declarator: (_) @name))]) @declaration
+    (declaration
+        declarator: [(function_declarator declarator: (_) @name)
+                     (_ (function_declarator declarator: (_) @name))]) @declaration
+    (field_declaration
+        declarator: [(field_identifier) @name
+                     (pointer_declarator declarator: (field_identifier) @name)
+                     (reference_declarator (field_identifier) @name)
+                     (array_declarator declarator: (field_identifier) @name)]) @member
+    (preproc_def
+        name: (_) @name) @macro
+    (preproc_function_def
+        name: (_) @name) @macro
+)EOF";
+// clang-format on
+
+// Returns the child of `node` for the field `field`, if any.
+static std::optional<treesitter::Node> fieldChild(const treesitter::Node &node, const char *field)
+{
+    treesitter::TreeCursor cursor(node);
+    if (cursor.gotoFirstChild()) {
+        do {
+            const char *name = cursor.currentFieldName();
+            if (name && qstrcmp(name, field) == 0)
+                return cursor.currentNode();
+        } while (cursor.gotoNextSibling());
+    }
+    return {};
+}
+
+namespace {
+// Node types used to build the symbols, resolved once to the symbols of the C++ grammar
+struct SymbolTypes
+{
+    const TSLanguage *language = treesitter::Parser::getLanguage(Document::Type::Cpp);
+    treesitter::NodeTypes scopedEnumKeywords {language, {"class", "struct"}};
+    treesitter::NodeTypes scopes {language,
+                                  {"namespace_definition", "class_specifier", "struct_specifier", "union_specifier"}};
+    treesitter::NodeTypes enumSpecifier {language, {"enum_specifier"}};
+    treesitter::NodeTypes baseClasses {language, {"type_identifier", "qualified_identifier", "template_type"}};
+    treesitter::NodeTypes fieldDeclarationList {language, {"field_declaration_list"}};
+};
+}
+
+static const SymbolTypes &symbolTypes()
+{
+    static const SymbolTypes types;
+    return types;
+}
+
+static bool isScopedEnum(const treesitter::Node &node)
+{
+    for (const auto &child : node.childRange()) {
+        if (symbolTypes().scopedEnumKeywords.contains(child))
+            return true;
+    }
+    return false;
+}
+
+// Returns the namespaces and classes enclosing `node`, separated by `::`.
+static QString enclosingScope(const treesitter::Node &node, const QString &text)
+{
+    const auto &types = symbolTypes();
+    QStringList scopes;
+    for (auto parent = node.parent(); !parent.isNull(); parent = parent.parent()) {
+        const bool isScope =
+            types.scopes.contains(parent) || (types.enumSpecifier.contains(parent) && isScopedEnum(parent));
+        if (!isScope)
+            continue;
+        if (const auto name = fieldChild(parent, "name"))
+            scopes.prepend(name->textIn(text));
+    }
+    return scopes.join("::");
+}
+
+// Returns the base class name without namespace and template arguments, used to find derived classes.
+static QString simpleClassName(QString name)
+{
+    if (const auto templateStart = name.indexOf('<'); templateStart != -1)
+        name.truncate(templateStart);
+    if (const auto scopeEnd = name.lastIndexOf("::"); scopeEnd != -1)
+        name.remove(0, scopeEnd + 2);
+    return name.trimmed();
+}
+
+static TextRange nodeRange(const treesitter::Node &node)
+{
+    return {.start = static_cast<int>(node.startPosition()), .end = static_cast<int>(node.endPosition())};
+}
+
+static std::optional<IndexedSymbol> toIndexedSymbol(const treesitter::QueryMatch &match, const QString &fileName,
+                                                    const QString &text)
+{
+    const auto query = match.query();
+    std::optional<treesitter::Node> nameNode;
+    std::optional<treesitter::Node> basesNode;
+    std::optional<treesitter::Node> symbolNode;
+    QString kindName;
+    for (const auto &capture : match.captures()) {
+        const auto captureName = query->captureAt(capture.id).name;
+        if (captureName == "name") {
+            nameNode = capture.node;
+        } else if (captureName == "bases") {
+            basesNode = capture.node;
+        } else {
+            symbolNode = capture.node;
+            kindName = captureName;
+        }
+    }
+    if (!nameNode || !symbolNode)
+        return {};
+
+    IndexedSymbol symbol {.name = nameNode->textIn(text),
+                          .scope = enclosingScope(*symbolNode, text),
+                          .fileName = fileName,
+                          .range = nodeRange(*symbolNode),
+                          .selectionRange = nodeRange(*nameNode),
+                          .isDefinition = true};
+
+    // Qualified names (e.g. a method definition `Foo::bar`) are split between the name and the scope
+    bool isQualified = false;
+    if (const auto scopeEnd = symbol.name.lastIndexOf("::"); scopeEnd != -1) {
+        const auto nameScope = symbol.name.left(scopeEnd);
+        symbol.scope = symbol.scope.isEmpty() ? nameScope : symbol.scope + "::" + nameScope;
+        symbol.name.remove(0, scopeEnd + 2);
+        isQualified = true;
+    }
+
+    if (kindName == "class") {
+        symbol.kind = Symbol::Kind::Class;
+        if (basesNode) {
+            for (const auto &base : basesNode->namedChildRange()) {
+                if (symbolTypes().baseClasses.contains(base))
+                    symbol.bases.push_back(base.textIn(text));
+            }
+        }
+    } else if (kindName == "enum") {
+        symbol.kind = Symbol::Kind::Enum;
+    } else if (kindName == "enumerator") {
+        symbol.kind = Symbol::Kind::EnumMember;
+    } else if (kindName == "member") {
+        symbol.kind = Symbol::Kind::Field;
+    } else if (kindName == "macro") {
+        symbol.kind = Symbol::Kind::Constant;
+    } else {
+        // Same heuristic as the document symbols: no return type is a constructor or destructor, and a qualified
+        // name or a declaration inside a class is a method.
+        symbol.isDefinition = kindName == "definition";
+        const bool inClass = symbolTypes().fieldDeclarationList.contains(symbolNode->parent());
+        if (!fieldChild(*symbolNode, "type"))
+            symbol.kind = Symbol::Kind::Constructor;
+        else if (isQualified || inClass)
+            symbol.kind = Symbol::Kind::Method;
+        else
+            symbol.kind = Symbol::Kind::Function;
+    }
+    return symbol;
+}
+
+// Parses one file and extracts its symbols. This is called from a worker thread, so it must not touch any QObject.
+static IndexedSymbolList extractSymbols(const QString &fileName, const QByteArray &data,
+                                        const std::shared_ptr<treesitter::Query> &query)
+{
+    // Same text as what the TextDocument would load, so positions are valid once the file is opened
+    QTextStream stream(data);
+    QString text = stream.readAll();
+    text.replace("\r\n", "\n");
+
+    // The tree is never edited, so it can be parsed from UTF-8, like in Project::queryAll
+    const auto source = std::make_shared<treesitter::Utf8Source>(text);
+    treesitter::PooledParser parser(treesitter::Parser::getLanguage(Document::Type::Cpp));
+    const auto tree = parser->parseUtf8(source);
+    if (!tree)
+        return {};
+
+    treesitter::QueryCursor cursor;
+    cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(text));
+    IndexedSymbolList symbols;
+    while (const auto match = cursor.nextMatch()) {
+        if (auto symbol = toIndexedSymbol(*match, fileName, text))
+            symbols.push_back(std::move(symbol).value());
+    }
+    std::ranges::stable_sort(symbols, {}, [](const IndexedSymbol &symbol) {
+        return symbol.range.start;
+    });
+    return symbols;
+}
+
+//=============================================================================
+// SymbolIndex
+//=============================================================================
+const char *SymbolIndex::symbolsQuery()
+{
+    return SymbolsQuery;
+}
+
+bool SymbolIndex::update(const QStringList &files)
+{
+    bool changed = false;
+
+    const std::unordered_set<QString> fileSet(files.cbegin(), files.cend());
+    changed |= std::erase_if(m_files, [&fileSet](const auto &item) {
+                   return !fileSet.contains(item.first);
+               }) > 0;
+
+    // Files with the same size and modification time are not read again. Others are hashed, and only parsed if
+    // their content has changed: a file touched but not modified keeps its symbols.
+    struct Job
+    {
+        QString fileName;
+        QByteArray previousHash;
+        FileEntry entry;
+        bool isReadable = false;
+        bool isParsed = false;
+    };
+    std::vector<Job> jobs;
+    for (const auto &fileName : files) {
+        const QFileInfo fi(fileName);
+        const auto size = fi.size();
+        const auto lastModified = fi.lastModified().toMSecsSinceEpoch();
+        const auto it = m_files.find(fileName);
+        if (it != m_files.end() && it->second.size == size && it->second.lastModified == lastModified)
+            continue;
+        jobs.push_back({.fileName = fileName,
+                        .previousHash = it != m_files.end() ? it->second.hash : QByteArray(),
+                        .entry = {.size = size, .lastModified = lastModified}});
+    }
+    if (jobs.empty()) {
+        if (changed)
+            buildLookups();
+        return changed;
+    }
+
+    std::shared_ptr<treesitter::Query> query;
+    try {
+        query = treesitter::QueryCache::instance().get(treesitter::Parser::getLanguage(Document::Type::Cpp),
+                                                       symbolsQuery());
+    } catch (treesitter::Query::Error &error) {
+        spdlog::error("SymbolIndex::update - failed to parse the symbols query, error: {} at: {}", error.description,
+                      error.utf8_offset);
+        return changed;
+    }
+
+    Utils::TaskGroup tasks(Utils::TaskScheduler::Background);
+    for (auto &job : jobs) {
+        tasks.start([&job, &query]() {
+            QFile file(job.fileName);
+            if (!file.open(QIODevice::ReadOnly))
+                return;
+            const QByteArray data = file.readAll();
+            job.isReadable = true;
+            job.entry.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+            if (job.entry.hash == job.previousHash)
+                return;
+            job.entry.symbols = extractSymbols(job.fileName, data, query);
+            job.isParsed = true;
+        });
+    }
+    tasks.wait();
+    // The queries stop on an abort, the files are indexed on the next update instead
+    if (Utils::Cancellation::isCanceled()) {
+        if (changed)
+            buildLookups();
+        return changed;
+    }
+
+    for (auto &job : jobs) {
+        if (!job.isReadable) {
+            changed |= m_files.erase(job.fileName) > 0;
+        } else if (!job.isParsed) {
+            auto &entry = m_files[job.fileName];
+            entry.size = job.entry.size;
+            entry.lastModified = job.entry.lastModified;
+            changed = true;
+        } else {
+            m_files[job.fileName] = std::move(job.entry);
+            changed = true;
+        }
+    }
+    spdlog::debug("SymbolIndex::update - {} files checked, {} files indexed", jobs.size(),
+                  std::ranges::count_if(jobs, &Job::isParsed));
+
+    buildLookups();
+    return changed;
+}
+
+void SymbolIndex::buildLookups()
+{
+    m_symbolsByName.clear();
+    m_classesByBase.clear();
+
+    // Files are sorted, so the results are in a stable order: by file, then by position in the file
+    std::vector<const std::pair<const QString, FileEntry> *> files;
+    files.reserve(m_files.size());
+    for (const auto &item : m_files)
+        files.push_back(&item);
+    std::ranges::sort(files, {}, [](const auto *item) {
+        return item->first;
+    });
+
+    for (const auto *item : files) {
+        for (const auto &symbol : item->second.symbols) {
+            m_symbolsByName[symbol.name].push_back(symbol);
+            for (const auto &base : symbol.bases)
+                m_classesByBase[simpleClassName(base)].push_back(symbol);
+        }
+    }
+}
+
+IndexedSymbolList SymbolIndex::find(const QString &name) const
+{
+    const auto scopeEnd = name.lastIndexOf("::");
+    const auto it = m_symbolsByName.find(scopeEnd == -1 ? name : name.mid(scopeEnd + 2));
+    if (it == m_symbolsByName.end())
+        return {};
+    if (scopeEnd == -1)
+        return it->second;
+
+    // The scope given may be partial: `Bar::foo` matches both `Bar::foo` and `Foo::Bar::foo`
+    const QString scope = name.left(scopeEnd);
+    const QString scopeSuffix = "::" + scope;
+    IndexedSymbolList result;
+    for (const auto &symbol : it->second) {
+        if (symbol.scope == scope || symbol.scope.endsWith(scopeSuffix))
+            result.push_back(symbol);
+    }
+    return result;
+}
+
+IndexedSymbolList SymbolIndex::derivedClasses(const QString &className, bool recursive) const
+{
+    IndexedSymbolList result;
+    std::unordered_set<QString> visited;
+    QStringList classNames = {simpleClassName(className)};
+    while (!classNames.isEmpty()) {
+        const auto name = classNames.takeFirst();
+        if (!visited.insert(name).second)
+            continue;
+        const auto it = m_classesByBase.find(name);
+        if (it == m_classesByBase.end())
+            continue;
+        for (const auto &symbol : it->second) {
+            result.push_back(symbol);
+            if (recursive)
+                classNames.push_back(symbol.name);
+        }
+    }
+    return result;
+}
+
+int SymbolIndex::fileCount() const
+{
+    return static_cast<int>(m_files.size());
+}
+
+//=============================================================================
+// Serialization
+//=============================================================================
+// Increase IndexVersion when changing the data stored, or the symbols query.
+static constexpr quint32 IndexMagic = 0x4b53594d; // KSYM
+static constexpr quint32 IndexVersion = 1;
+
+static QDataStream &operator<<(QDataStream &stream, const IndexedSymbol &symbol)
+{
+    return stream << symbol.name << symbol.scope << static_cast<qint32>(symbol.kind) << symbol.fileName
+                  << symbol.range.start << symbol.range.end << symbol.selectionRange.start
+                  << symbol.selectionRange.end << symbol.isDefinition << symbol.bases;
+}
+
+static QDataStream &operator>>(QDataStream &stream, IndexedSymbol &symbol)
+{
+    qint32 kind = 0;
+    stream >> symbol.name >> symbol.scope >> kind >> symbol.fileName >> symbol.range.start >> symbol.range.end
+        >> symbol.selectionRange.start >> symbol.selectionRange.end >> symbol.isDefinition >> symbol.bases;
+    symbol.kind = static_cast<Symbol::Kind>(kind);
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const SymbolIndex::FileEntry &entry)
+{
+    return stream << entry.size << entry.lastModified << entry.hash << entry.symbols;
+}
+
+QDataStream &operator>>(QDataStream &stream, SymbolIndex::FileEntry &entry)
+{
+    return stream >> entry.size >> entry.lastModified >> entry.hash >> entry.symbols;
+}
+
+bool SymbolIndex::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != IndexMagic || version != IndexVersion)
+        return false;
+
+    quint32 count = 0;
+    stream >> count;
+    std::unordered_map<QString, FileEntry> files;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        QString entryFileName;
+        FileEntry entry;
+        stream >> entryFileName >> entry;
+        files[entryFileName] = std::move(entry);
+    }
+    if (stream.status() != QDataStream::Ok) {
+        spdlog::warn("SymbolIndex::load - invalid index file {}", fileName);
+        return false;
+    }
+
+    m_files = std::move(files);
+    buildLookups();
+    return true;
+}
+
+bool SymbolIndex::save(const QString &fileName) const
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("SymbolIndex::save - can't write index file {}", fileName);
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << IndexMagic << IndexVersion << static_cast<quint32>(m_files.size());
+    for (const auto &[entryFileName, entry] : m_files)
+        stream << entryFileName << entry;
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        spdlog::warn("SymbolIndex::save - can't write index file {}", fileName);
+        return false;
+    }
+    return true;
+}
+
+} // namespace Core
@@ -0,0 +1,101 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "symbol.h"
+#include "textrange.h"
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <unordered_map>
+
+class QDataStream;
+
+namespace Core {
+
+struct IndexedSymbol
+{
+    Q_GADGET
+
+    Q_PROPERTY(QString name MEMBER name CONSTANT)
+    Q_PROPERTY(QString scope MEMBER scope CONSTANT)
+    Q_PROPERTY(QString qualifiedName READ qualifiedName CONSTANT)
+    Q_PROPERTY(Core::Symbol::Kind kind MEMBER kind CONSTANT)
+    Q_PROPERTY(QString fileName MEMBER fileName CONSTANT)
+    Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
+    Q_PROPERTY(Core::TextRange selectionRange MEMBER selectionRange CONSTANT)
+    Q_PROPERTY(bool isDefinition MEMBER isDefinition CONSTANT)
+    Q_PROPERTY(QStringList bases MEMBER bases CONSTANT)
+
+public:
+    QString qualifiedName() const;
+    Q_INVOKABLE QString toString() const;
+
+    QString name;
+    QString scope;
+    Symbol::Kind kind = Symbol::Kind::Null;
+    QString fileName;
+    Core::TextRange range;
+    Core::TextRange selectionRange;
+    bool isDefinition = false;
+    QStringList bases;
+};
+
+using IndexedSymbolList = QList<Core::IndexedSymbol>;
+
+// Index of the C++ symbols of a set of files, extracted with Tree-sitter without opening any document.
+// The index is updated incrementally: only files whose content changed are parsed again. It can be saved to and
+// loaded from a binary file, so the symbols of a project are not extracted again each time Knut is started.
+class SymbolIndex
+{
+public:
+    SymbolIndex() = default;
+
+    // Updates the index to contain exactly `files`, parsing new and changed files in parallel.
+    // Returns true if the index has changed.
+    bool update(const QStringList &files);
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    // Returns the symbols named `name`, which can be a simple or a qualified name (`Foo::bar`).
+    IndexedSymbolList find(const QString &name) const;
+    // Returns the classes deriving from `className`, directly or, if `recursive` is true, indirectly.
+    IndexedSymbolList derivedClasses(const QString &className, bool recursive = false) const;
+
+    int fileCount() const;
+
+    // Query extracting the symbols of a file, compiled once for the whole process
+    static const char *symbolsQuery();
+
+private:
+    struct FileEntry
+    {
+        qint64 size = 0;
+        qint64 lastModified = 0;
+        QByteArray hash;
+        IndexedSymbolList symbols;
+    };
+    friend QDataStream &operator<<(QDataStream &stream, const FileEntry &entry);
+    friend QDataStream &operator>>(QDataStream &stream, FileEntry &entry);
+
+    void buildLookups();
+
+    std::unordered_map<QString, FileEntry> m_files;
+    // Lookups, rebuilt each time the index changes. The classes are stored by their simple base class names.
+    std::unordered_map<QString, IndexedSymbolList> m_symbolsByName;
+    std::unordered_map<QString, IndexedSymbolList> m_classesByBase;
+};
+
+} // namespace Core
+
+Q_DECLARE_METATYPE(Core::IndexedSymbol)
@@ -0,0 +1,234 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "testrunner.h"
+#include "benchrunner.h"
+#include "utils/log.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <QXmlStreamWriter>
+#include <algorithm>
+#include <iostream>
+
+namespace Core {
+
+TestRunner::TestRunner(const QString &directory, int jobs, QObject *parent)
+    : QObject(parent)
+    , m_directory(QDir(directory).absolutePath())
+    , m_jobs(std::max(jobs, 1))
+{
+}
+
+TestRunner::~TestRunner() = default;
+
+QStringList TestRunner::findTests(const QString &directory)
+{
+    QStringList tests;
+    QDirIterator it(directory, {"tst_*.qml"}, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext())
+        tests.push_back(it.next());
+    tests.sort();
+    return tests;
+}
+
+QString TestRunner::testProject(const QString &testFile)
+{
+    const QFileInfo fi(testFile);
+    const QFileInfo project(fi.absoluteDir().filePath(fi.completeBaseName()));
+    return project.isDir() ? project.absoluteFilePath() : QString();
+}
+
+void TestRunner::setJUnitFile(const QString &fileName)
+{
+    m_junitFile = fileName;
+}
+
+void TestRunner::start()
+{
+    const auto tests = findTests(m_directory);
+    m_projectDir = std::make_unique<QTemporaryDir>();
+    if (tests.isEmpty() || !m_projectDir->isValid()) {
+        if (tests.isEmpty())
+            spdlog::warn("TestRunner::start - no tests in {}", m_directory);
+        else
+            spdlog::error("TestRunner::start - can't create a temporary directory for the projects");
+        QMetaObject::invokeMethod(
+            this,
+            [this, exitCode = tests.isEmpty() ? 0 : 1]() {
+                emit finished(exitCode);
+            },
+            Qt::QueuedConnection);
+        return;
+    }
+
+    m_results.resize(tests.size());
+    for (qsizetype i = 0; i < tests.size(); ++i)
+        m_results[i].file = tests.at(i);
+    m_runs.resize(tests.size());
+    m_timer.start();
+    while (m_running < m_jobs && m_nextJob < m_runs.size())
+        startNextJob();
+}
+
+void TestRunner::startNextJob()
+{
+    const size_t index = m_nextJob++;
+    auto &run = m_runs[index];
+
+    QStringList arguments {"--test", m_results[index].file};
+    // Tests may change their project, each one gets its own copy
+    const QString project = testProject(m_results[index].file);
+    if (!project.isEmpty()) {
+        const QString projectPath = m_projectDir->filePath(QString::number(index));
+        if (!BenchRunner::copyDirectory(project, projectPath)) {
+            spdlog::error("TestRunner::startNextJob - can't copy the project {}", project);
+            m_results[index].output = "Can't copy the test project\n";
+            ++m_running;
+            jobFinished(index, 1);
+            return;
+        }
+        arguments.append(projectPath);
+    }
+
+    run.process = new QProcess(this);
+    run.process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(run.process, &QProcess::readyReadStandardOutput, this, [this, index]() {
+        m_results[index].output += m_runs[index].process->readAllStandardOutput();
+    });
+    connect(run.process, &QProcess::finished, this, [this, index](int exitCode, QProcess::ExitStatus status) {
+        jobFinished(index, status == QProcess::NormalExit ? exitCode : -1);
+    });
+    connect(run.process, &QProcess::errorOccurred, this, [this, index](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart)
+            jobFinished(index, -1);
+    });
+
+    ++m_running;
+    run.timer.start();
+    run.process->start(QCoreApplication::applicationFilePath(), arguments);
+}
+
+void TestRunner::jobFinished(size_t index, int exitCode)
+{
+    auto &run = m_runs[index];
+    if (run.done)
+        return;
+
+    auto &result = m_results[index];
+    if (run.process) {
+        run.process->disconnect(this);
+        result.output += run.process->readAllStandardOutput();
+        run.process->deleteLater();
+        run.process = nullptr;
+    }
+    run.done = true;
+    result.exitCode = exitCode;
+    result.time = run.timer.isValid() ? run.timer.elapsed() : 0;
+    QDir(m_projectDir->filePath(QString::number(index))).removeRecursively();
+    --m_running;
+
+    flushOutput();
+
+    if (m_nextJob < m_runs.size())
+        startNextJob();
+    else if (m_running == 0)
+        finish();
+}
+
+void TestRunner::flushOutput()
+{
+    const QDir dir(m_directory);
+    while (m_nextOutput < m_runs.size() && m_runs[m_nextOutput].done) {
+        auto &result = m_results[m_nextOutput];
+        const bool passed = result.exitCode == 0;
+        std::cout << (passed ? "PASS " : "FAIL ") << dir.relativeFilePath(result.file).toStdString() << " ("
+                  << result.time << " ms";
+        if (!passed)
+            std::cout << ", exit code " << result.exitCode;
+        std::cout << ")\n";
+        // The output of the passed tests is only in the JUnit report
+        if (!passed) {
+            std::cout.write(result.output.constData(), result.output.size());
+            ++m_failed;
+        }
+        std::cout.flush();
+        ++m_nextOutput;
+    }
+}
+
+void TestRunner::finish()
+{
+    std::cout << "==> " << m_results.size() << " tests, " << m_failed << " failed, " << m_timer.elapsed() << " ms"
+              << std::endl;
+    int exitCode = m_failed == 0 ? 0 : 1;
+    if (!m_junitFile.isEmpty() && !writeJUnitReport(m_junitFile, m_directory, m_results))
+        exitCode = 1;
+    emit finished(exitCode);
+}
+
+bool TestRunner::writeJUnitReport(const QString &fileName, const QString &directory, const std::vector<Result> &results)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::error("TestRunner::writeJUnitReport - can't write the report {}: {}", fileName, file.errorString());
+        return false;
+    }
+
+    const auto failures = std::ranges::count_if(results, [](const Result &result) {
+        return result.exitCode != 0;
+    });
+    qint64 time = 0;
+    for (const auto &result : results)
+        time += result.time;
+    auto toSeconds = [](qint64 milliseconds) {
+        return QString::number(milliseconds / 1000.0, 'f', 3);
+    };
+
+    const QDir dir(directory);
+    QXmlStreamWriter writer(&file);
+    writer.setAutoFormatting(true);
+    writer.writeStartDocument();
+    writer.writeStartElement("testsuites");
+    writer.writeStartElement("testsuite");
+    writer.writeAttribute("name", "knut");
+    writer.writeAttribute("tests", QString::number(results.size()));
+    writer.writeAttribute("failures", QString::number(failures));
+    writer.writeAttribute("time", toSeconds(time));
+    for (const auto &result : results) {
+        writer.writeStartElement("testcase");
+        writer.writeAttribute("name", dir.relativeFilePath(result.file));
+        writer.writeAttribute("classname", "knut");
+        writer.writeAttribute("time", toSeconds(result.time));
+        if (result.exitCode != 0) {
+            writer.writeStartElement("failure");
+            writer.writeAttribute("message", QString("exit code %1").arg(result.exitCode));
+            writer.writeEndElement();
+        }
+        writer.writeTextElement("system-out", QString::fromUtf8(result.output));
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+    writer.writeEndElement();
+    writer.writeEndDocument();
+
+    if (writer.hasError() || !file.commit()) {
+        spdlog::error("TestRunner::writeJUnitReport - can't write the report {}: {}", fileName, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+} // namespace Core
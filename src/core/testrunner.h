@@ -0,0 +1,94 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+class QProcess;
+class QTemporaryDir;
+
+namespace Core {
+
+/**
+ * \brief Runs all the QML tests of a directory, using multiple knut processes
+ *
+ * The tests are the `tst_*.qml` files of the directory and its sub-directories. Each test is run by its own knut
+ * process, started with the `--test` option, so every test gets its own script engine. If a `tst_<name>` directory is
+ * next to the test, the test runs on a fresh copy of it as its project. At most `jobs` processes are running at the
+ * same time.
+ *
+ * The result of each test is printed once it's done, in the order of the tests, with the output of the failed ones. The
+ * results can also be written as a JUnit report, with the time of each test.
+ */
+class TestRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result
+    {
+        QString file;
+        int exitCode = 0;
+        // In milliseconds
+        qint64 time = 0;
+        QByteArray output;
+    };
+
+    TestRunner(const QString &directory, int jobs, QObject *parent = nullptr);
+    ~TestRunner() override;
+
+    void start();
+    // Writes the results as a JUnit report to fileName once all the tests are done
+    void setJUnitFile(const QString &fileName);
+
+    // Returns the tests of the directory and its sub-directories, sorted by path
+    static QStringList findTests(const QString &directory);
+    // Returns the project directory of a test, tst_<name> next to tst_<name>.qml, or an empty string if there is none
+    static QString testProject(const QString &testFile);
+    // The test names are the paths relative to directory
+    static bool writeJUnitReport(const QString &fileName, const QString &directory, const std::vector<Result> &results);
+
+signals:
+    void finished(int exitCode);
+
+private:
+    struct Job
+    {
+        QProcess *process = nullptr;
+        QElapsedTimer timer;
+        bool done = false;
+    };
+
+    void startNextJob();
+    void jobFinished(size_t index, int exitCode);
+    void flushOutput();
+    void finish();
+
+    const QString m_directory;
+    const int m_jobs;
+    QString m_junitFile;
+    std::unique_ptr<QTemporaryDir> m_projectDir;
+    QElapsedTimer m_timer;
+
+    std::vector<Job> m_runs;
+    std::vector<Result> m_results;
+    size_t m_nextJob = 0;
+    size_t m_nextOutput = 0;
+    int m_running = 0;
+    int m_failed = 0;
+};
+
+} // namespace Core
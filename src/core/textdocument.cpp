@@ -9,22 +9,32 @@
 */
 
 #include "textdocument.h"
+#include "dryrun.h"
 #include "logger.h"
 #include "mark.h"
+#include "mark_p.h"
 #include "rangemark.h"
 #include "settings.h"
 #include "textdocument_p.h"
 #include "texteditor.h"
+#include "utils/linediff.h"
+#include "utils/literalfinder.h"
 #include "utils/log.h"
 #include "utils/string_helper.h"
+#include "utils/textcodec.h"
 
+#include <QClipboard>
 #include <QFile>
+#include <QGuiApplication>
 #include <QKeyEvent>
 #include <QPlainTextEdit>
 #include <QRegularExpression>
+#include <QSaveFile>
 #include <QSignalBlocker>
 #include <QTextBlock>
-#include <QTextStream>
+#include <QTextDocumentFragment>
+#include <algorithm>
+#include <ranges>
 #include <private/qwidgettextcontrol_p.h>
 
 namespace Core {
@@ -99,6 +109,9 @@ matchInBlock(const QTextBlock &block, const QRegularExpression &expr, int offset
 /*!
  * \qmlproperty string TextDocument::text
  * This property holds the text of the document.
+ *
+ * Setting the text only replaces the parts that differ from the current text, as one undoable edit: the marks on the
+ * unchanged text stay in place.
  */
 /*!
  * \qmlproperty string TextDocument::selectedText
@@ -130,26 +143,118 @@ TextDocument::TextDocument(QObject *parent)
 
 TextDocument::~TextDocument()
 {
-    delete m_document;
+    delete m_textEdit;
 }
 
 TextDocument::TextDocument(Type type, QObject *parent)
     : Document(type, parent)
-    , m_document(new TextEditor)
-{
-    m_document->hide();
-    connect(m_document, &QPlainTextEdit::textChanged, this, &TextDocument::textChanged);
-    connect(m_document, &QPlainTextEdit::selectionChanged, this, &TextDocument::selectionChanged);
-    connect(m_document, &QPlainTextEdit::cursorPositionChanged, this, &TextDocument::positionChanged);
-    connect(m_document->document(), &QTextDocument::contentsChange, this, [this]() {
+    , m_textDocument(new QTextDocument(this))
+    , m_markTable(std::make_unique<MarkTable>())
+    , m_lineIndex(std::make_unique<LineIndex>(m_textDocument))
+    , m_cursor(m_textDocument)
+{
+    m_textDocument->setDocumentLayout(new QPlainTextDocumentLayout(m_textDocument));
+    connect(m_textDocument, &QTextDocument::contentsChange, this, [this](int from, int charsRemoved, int charsAdded) {
+        // First connection, so the text cached by plainText is outdated for all the other ones
+        ++m_textRevision;
+        if (m_undoJournal)
+            recordUndo(from, charsRemoved, charsAdded);
+        if (m_pendingChanges) {
+            m_markTable->update(*m_pendingChanges);
+            m_pendingChanges = nullptr;
+        } else {
+            m_markTable->update(from, charsRemoved, charsAdded);
+        }
+        m_lineIndex->update(from, charsRemoved, charsAdded);
+    });
+    connect(m_textDocument, &QTextDocument::contentsChanged, this, &TextDocument::textChanged);
+    connect(m_textDocument, &QTextDocument::contentsChange, this, [this](int from, int charsRemoved, int charsAdded) {
         setHasChanged(true);
+        // Edits done with another cursor may have moved the current one
+        if (!m_textEdit)
+            updateCursorState();
+
+        if (m_transactionLevel == 0) {
+            changeContent(from, charsRemoved, charsAdded);
+            return;
+        }
+        if (!m_transactionChange) {
+            m_transactionChange = TransactionChange {from, charsRemoved, charsAdded};
+            return;
+        }
+        // Union of both changes in the current text; after the merged change, it maps directly to the old text
+        auto &change = *m_transactionChange;
+        const int start = std::min(change.position, from);
+        const int end = std::max(change.position + change.charsAdded, from + charsRemoved);
+        change.charsRemoved = end - (change.charsAdded - change.charsRemoved) - start;
+        change.charsAdded = end - start - charsRemoved + charsAdded;
+        change.position = start;
     });
-    m_document->installEventFilter(this);
+}
+
+/**
+ * \brief Creates the editor used to display the document
+ *
+ * The document itself doesn't need any widget, the editor is only created when the GUI is asking for it.
+ */
+void TextDocument::createTextEdit()
+{
+    Q_ASSERT(!m_textEdit);
+    ensureLoaded();
+    m_textEdit = new TextEditor;
+    m_textEdit->hide();
+    m_textEdit->setDocument(m_textDocument);
+    m_textEdit->setTextCursor(m_cursor);
+    connect(m_textEdit, &QPlainTextEdit::selectionChanged, this, &TextDocument::selectionChanged);
+    connect(m_textEdit, &QPlainTextEdit::cursorPositionChanged, this, &TextDocument::positionChanged);
+    connect(m_textEdit, &QPlainTextEdit::cursorPositionChanged, this, [this]() {
+        m_cursor = m_textEdit->textCursor();
+    });
+    connect(m_textEdit, &QPlainTextEdit::selectionChanged, this, [this]() {
+        m_cursor = m_textEdit->textCursor();
+    });
+    m_textEdit->installEventFilter(this);
+}
+
+void TextDocument::setPlainText(const QString &text)
+{
+    m_isLoaded = true;
+    if (m_textEdit)
+        m_textEdit->setPlainText(text);
+    else
+        m_textDocument->setPlainText(text);
+    // Like the QTextDocument undo stack, the journal starts from the new text
+    if (m_undoJournal)
+        m_undoJournal->clear();
+    if (m_textEdit)
+        return;
+    m_cursor = QTextCursor(m_textDocument);
+    updateCursorState();
+}
+
+/**
+ * \brief Emits positionChanged and selectionChanged if the cursor has changed, when there's no editor
+ */
+void TextDocument::updateCursorState()
+{
+    const int position = m_cursor.position();
+    const int anchor = m_cursor.anchor();
+    if (position == m_lastPosition && anchor == m_lastAnchor)
+        return;
+    const bool hadSelection = m_lastPosition != m_lastAnchor;
+    const bool emitSelection = anchor != m_lastAnchor || hadSelection || m_cursor.hasSelection();
+    const bool emitPosition = position != m_lastPosition;
+    m_lastPosition = position;
+    m_lastAnchor = anchor;
+    if (emitPosition)
+        emit positionChanged();
+    if (emitSelection)
+        emit selectionChanged();
 }
 
 bool TextDocument::eventFilter(QObject *watched, QEvent *event)
 {
-    Q_ASSERT(watched == m_document);
+    Q_ASSERT(watched == m_textEdit);
 
     if (event->type() == QEvent::KeyPress) {
         auto keyEvent = static_cast<QKeyEvent *>(event);
@@ -209,11 +314,11 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::Paste)
             paste();
         else if (keyEvent == QKeySequence::Delete)
-            m_document->textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
+            textCursor().hasSelection() ? deleteSelection() : deleteNextCharacter();
         else if (keyEvent == QKeySequence::Backspace
                  || (keyEvent->key() == Qt::Key_Backspace
                      && !(keyEvent->modifiers() & ~Qt::ShiftModifier))) // test is coming from QTextWidgetControl
-            m_document->textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
+            textCursor().hasSelection() ? deleteSelection() : deletePreviousCharacter();
         else if (keyEvent == QKeySequence::InsertParagraphSeparator)
             insert("\n");
         else if (keyEvent == QKeySequence::InsertLineSeparator)
@@ -227,7 +332,7 @@ bool TextDocument::eventFilter(QObject *watched, QEvent *event)
         else if (keyEvent == QKeySequence::SelectAll)
             selectAll();
         else if (!keyEvent->text().isEmpty()) {
-            auto control = m_document->findChild<QWidgetTextControl *>();
+            auto control = m_textEdit->findChild<QWidgetTextControl *>();
             if (control->isAcceptableInput(keyEvent))
                 insert(keyEvent->text());
         }
@@ -241,25 +346,114 @@ bool TextDocument::doSave(const QString &fileName)
 {
     Q_ASSERT(!fileName.isEmpty());
 
-    QFile file(fileName);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        setErrorString(file.errorString());
-        spdlog::error("Can't save file {}: {}", fileName, errorString());
+    QString error;
+    if (writeFile(fileName, error))
+        return true;
+    setErrorString(error);
+    spdlog::error("Can't save file {}: {}", fileName, errorString());
+    return false;
+}
+
+bool TextDocument::doDryRunSave(const QString &fileName)
+{
+    // The text snapshot is shared, recording it doesn't copy the text
+    DryRun::addChange(fileName, plainText(), m_encoding, m_lineEnding == CRLFLineEnding);
+    return true;
+}
+
+// Appends the text in the encoding of the file, with the same characters as QTextDocument::toPlainText and the given
+// line ending
+static void appendPlainText(QByteArray &buffer, QStringView text, QByteArrayView newLine, const QString &encoding)
+{
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const QChar ch = text.at(i);
+        if (ch == u'\n' || ch == QChar::LineSeparator || ch == QChar::ParagraphSeparator || ch == QChar::Nbsp) {
+            Utils::appendEncodedText(buffer, text.sliced(start, i - start), encoding);
+            if (ch == QChar::Nbsp)
+                buffer.append(' ');
+            else
+                buffer.append(newLine);
+            start = i + 1;
+        }
+    }
+    Utils::appendEncodedText(buffer, text.sliced(start), encoding);
+}
+
+/**
+ * \brief Writes the document to `fileName`
+ *
+ * The text is encoded block by block, with the line endings translated on the fly, so there's no copy of the whole
+ * text. The file is written to a temporary file first, and renamed at the end.
+ */
+bool TextDocument::writeFile(const QString &fileName, QString &error) const
+{
+    // Size after which the encoded text is written to the file
+    static constexpr qsizetype BufferSize = 1 << 20;
+
+    QSaveFile file(fileName);
+    // Read-only directories can't have a temporary file, write directly to the file there
+    file.setDirectWriteFallback(true);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = file.errorString();
         return false;
     }
 
+    QByteArray buffer;
+    buffer.reserve(BufferSize + 1024);
     if (m_utf8Bom)
-        file.write("\xef\xbb\xbf", 3);
-
-    QString plainText = m_document->toPlainText();
-    if (m_lineEnding == CRLFLineEnding)
-        plainText.replace('\n', "\r\n");
+        buffer.append("\xef\xbb\xbf", 3);
+    const QByteArrayView newLine = m_lineEnding == CRLFLineEnding ? "\r\n" : "\n";
+    auto flush = [&](bool force) {
+        if (buffer.size() < BufferSize && !force)
+            return true;
+        const bool written = file.write(buffer) == buffer.size();
+        buffer.clear();
+        return written;
+    };
+
+    bool written = true;
+    if (m_isLoaded) {
+        for (auto block = m_textDocument->begin(); block.isValid() && written; block = block.next()) {
+            appendPlainText(buffer, block.text(), newLine, m_encoding);
+            if (block.next().isValid())
+                buffer.append(newLine);
+            written = flush(false);
+        }
+    } else {
+        // The text is not in the QTextDocument yet, it's already normalized
+        const QStringView text = m_plainText;
+        qsizetype start = 0;
+        while (start < text.size() && written) {
+            auto end = std::min(start + BufferSize, text.size());
+            // Don't split a surrogate pair between two chunks
+            if (end < text.size() && text.at(end - 1).isHighSurrogate())
+                --end;
+            appendPlainText(buffer, text.sliced(start, end - start), newLine, m_encoding);
+            written = flush(false);
+            start = end;
+        }
+    }
+    if (written)
+        written = flush(true);
 
-    QTextStream stream(&file);
-    stream << plainText;
+    if (!written || !file.commit()) {
+        error = file.errorString();
+        return false;
+    }
     return true;
 }
 
+QString toDocumentText(QString text)
+{
+    text.replace("\r\n", "\n");
+    text.replace(u'\r', u'\n');
+    text.replace(QChar::ParagraphSeparator, u'\n');
+    text.replace(QChar::LineSeparator, u'\n');
+    text.replace(QChar::Nbsp, u' ');
+    return text;
+}
+
 bool TextDocument::doLoad(const QString &fileName)
 {
     Q_ASSERT(!fileName.isEmpty());
@@ -271,76 +465,204 @@ bool TextDocument::doLoad(const QString &fileName)
         return false;
     }
 
-    QByteArray data = file.readAll();
-    detectFormat(data);
-    QTextStream stream(data);
-    const QString text = stream.readAll();
+    // The text may have been read and decoded ahead by the project, see DocumentPrefetcher and
+    // Project::checkDocumentsOnDisk
+    auto reloadReplacements = std::move(m_reloadReplacements);
+    Utils::DecodedText decoded;
+    bool isEmpty = false;
+    if (m_prefetchedText) {
+        decoded = std::move(*m_prefetchedText);
+        m_prefetchedText.reset();
+        isEmpty = decoded.text.isEmpty() && !decoded.utf8Bom && decoded.encoding.isEmpty();
+    } else {
+        // The data is decoded straight from the mapped file, without reading it in a buffer first
+        const auto size = file.size();
+        const uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+        const QByteArray data = mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size)
+                                       : file.readAll();
+        // The format is found while decoding, files that aren't valid UTF-8 use the fallback encoding of the settings
+        const auto fallbackEncoding =
+            Settings::exists() ? Settings::instance()->snapshot().fallbackEncoding : QString();
+        decoded = Utils::decodeText(data, fallbackEncoding);
+        isEmpty = data.isEmpty();
+    }
+    if (!isEmpty)
+        setFormat(decoded);
+    QString text = std::move(decoded.text);
+
+    // A reload only changes the lines that differ: the marks and the cursor stay on the same text, and the other parts
+    // of Knut (syntax tree, LSP...) see the changes like any edit
+    if (m_isLoaded && !m_textDocument->isEmpty() && fileName == this->fileName()) {
+        const auto replacements =
+            reloadReplacements ? std::move(*reloadReplacements) : diffReplacements(plainText(), toDocumentText(text));
+        if (!replacements.empty())
+            applyReplacements(replacements, false);
+        setHasChanged(false);
+        return true;
+    }
+
+    // A document that isn't displayed yet is loaded lazily: until the text is needed in the QTextDocument (edition,
+    // cursor, editor...), it's only kept as the plain text, which is enough to read it or query its syntax tree.
+    if (!m_textEdit && m_textDocument->isEmpty()) {
+        m_plainText = toDocumentText(std::move(text));
+        m_plainTextRevision = m_textRevision;
+        m_isLoaded = false;
+        setHasChanged(false);
+        return true;
+    }
 
-    QSignalBlocker sb(m_document->document());
+    QSignalBlocker sb(m_textDocument);
     // This will replace '\r\n' with '\n'
-    m_document->setPlainText(text);
+    setPlainText(text);
     setHasChanged(false);
 
     return true;
 }
 
-// This function is copied from TextFileFormat::detect from Qt Creator.
-void TextDocument::detectFormat(const QByteArray &data)
+/**
+ * \brief Sets the text loaded lazily by doLoad in the QTextDocument, if not done yet
+ */
+void TextDocument::ensureLoaded() const
 {
-    if (data.isEmpty())
+    if (m_isLoaded)
         return;
-    const int bytesRead = data.size();
-    const auto buf = reinterpret_cast<const unsigned char *>(data.constData());
-    // code taken from qtextstream
-    if (bytesRead >= 3 && ((buf[0] == 0xef && buf[1] == 0xbb) && buf[2] == 0xbf))
-        m_utf8Bom = true;
-
-    // end code taken from qtextstream
-    const int newLinePos = data.indexOf('\n');
-    if (newLinePos == -1)
+
+    QSignalBlocker sb(m_textDocument);
+    const_cast<TextDocument *>(this)->setPlainText(m_plainText);
+    // Use the text of the QTextDocument from now on, in case it differs
+    m_plainTextRevision = -1;
+    if (m_undoJournal)
+        plainText();
+}
+
+/**
+ * \brief Records the change undoing the last edit in the undo journal
+ *
+ * The removed text is taken from the text snapshot of the previous revision, which is kept up-to-date with each change
+ * while the journal is enabled.
+ */
+void TextDocument::recordUndo(int from, int charsRemoved, int charsAdded)
+{
+    // Without the text before the change, it can't be undone: start again from the current text
+    auto resync = [this]() {
+        spdlog::debug("TextDocument::recordUndo - text out of sync, clearing the undo journal");
+        m_undoJournal->clear();
+        m_plainTextRevision = -1;
+        plainText();
+    };
+
+    // Changes may be reported up to the last paragraph separator, which is not part of the text
+    const int characterCount = m_textDocument->characterCount() - 1;
+    if (m_plainTextRevision != m_textRevision - 1 || from > m_plainText.size() || from > characterCount) {
+        resync();
+        return;
+    }
+    charsRemoved = std::min(charsRemoved, static_cast<int>(m_plainText.size()) - from);
+    charsAdded = std::min(charsAdded, characterCount - from);
+
+    QTextCursor cursor(m_textDocument);
+    cursor.setPosition(from);
+    cursor.setPosition(from + charsAdded, QTextCursor::KeepAnchor);
+    // Same characters as QTextDocument::toPlainText
+    QString added = cursor.selectedText();
+    for (auto &ch : added) {
+        if (ch == QChar::ParagraphSeparator || ch == QChar::LineSeparator)
+            ch = u'\n';
+        else if (ch == QChar::Nbsp)
+            ch = u' ';
+    }
+
+    QString removed = m_plainText.sliced(from, charsRemoved);
+    m_plainText.replace(from, charsRemoved, added);
+    m_plainTextRevision = m_textRevision;
+    if (m_plainText.size() != characterCount) {
+        resync();
+        return;
+    }
+
+    // Format changes are reported as changes of the same text
+    if (removed == added)
+        return;
+    const int group = m_transactionLevel > 0 ? m_transactionGroup : 0;
+    m_undoJournal->record({.position = from, .length = charsAdded, .text = std::move(removed)}, group);
+}
+
+MemoryUsage TextDocument::memoryUsage() const
+{
+    // Estimate of the QTextDocument data for each block: its nodes in the fragment and block maps, and its layout
+    constexpr qint64 BlockSize = 128;
+    // Estimate of a QTextDocument undo command, the text removed is kept in the text buffer while it can be undone
+    constexpr qint64 UndoCommandSize = 64;
+
+    MemoryUsage usage;
+    usage.add("text buffer", memorySize(m_plainText));
+    usage.add("QTextDocument",
+              m_textDocument->characterCount() * static_cast<qint64>(sizeof(QChar))
+                  + m_textDocument->blockCount() * BlockSize);
+    usage.add("undo stack",
+              m_undoJournal ? m_undoJournal->memorySize()
+                            : (m_textDocument->availableUndoSteps() + m_textDocument->availableRedoSteps())
+                      * UndoCommandSize);
+    usage.add("marks", m_markTable->memorySize());
+    usage.add("line index", m_lineIndex->memorySize());
+    return usage;
+}
+
+void TextDocument::enableUndoJournal(int maxSteps, qsizetype maxSize)
+{
+    m_undoJournal = std::make_unique<UndoJournal>(maxSteps, maxSize);
+    m_textDocument->setUndoRedoEnabled(false);
+    // The journal needs the text before each change
+    if (m_isLoaded)
+        plainText();
+}
+
+void TextDocument::setFormat(const Utils::DecodedText &decoded)
+{
+    m_utf8Bom = decoded.utf8Bom;
+    m_encoding = decoded.encoding;
+    if (!decoded.hasNewLine)
         setLineEnding(NativeLineEnding);
-    else if (newLinePos == 0)
-        setLineEnding(LFLineEnding);
     else
-        setLineEnding(data.at(newLinePos - 1) == '\r' ? CRLFLineEnding : LFLineEnding);
+        setLineEnding(decoded.crlf ? CRLFLineEnding : LFLineEnding);
 }
 
 int TextDocument::column() const
 {
     LOG("TextDocument::column");
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("column", cursor.positionInBlock() + 1);
 }
 
 int TextDocument::line() const
 {
     LOG("TextDocument::line");
-    const QTextCursor cursor = m_document->textCursor();
+    const QTextCursor cursor = textCursor();
     LOG_RETURN("line", cursor.blockNumber() + 1);
 }
 
 int TextDocument::lineCount() const
 {
     LOG("TextDocument::lineCount");
-    return m_document->document()->lineCount();
+    return textDocument()->lineCount();
 }
 
 int TextDocument::position() const
 {
     LOG("TextDocument::position");
-    LOG_RETURN("pos", m_document->textCursor().position());
+    LOG_RETURN("pos", textCursor().position());
 }
 
 int TextDocument::selectionStart() const
 {
     LOG("TextDocument::selectionStart");
-    LOG_RETURN("pos", m_document->textCursor().selectionStart());
+    LOG_RETURN("pos", textCursor().selectionStart());
 }
 
 int TextDocument::selectionEnd() const
 {
     LOG("TextDocument::selectionEnd");
-    LOG_RETURN("pos", m_document->textCursor().selectionEnd());
+    LOG_RETURN("pos", textCursor().selectionEnd());
 }
 
 void TextDocument::setPosition(int newPosition)
@@ -349,29 +671,30 @@ void TextDocument::setPosition(int newPosition)
 
     if (position() == newPosition)
         return;
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(newPosition);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
     emit positionChanged();
 }
 
 void TextDocument::convertPosition(int pos, int *line, int *column) const
 {
     Q_ASSERT(line && column);
-    const QTextBlock block = m_document->document()->findBlock(pos);
-    if (!block.isValid()) {
+    ensureLoaded();
+    const int lineIndex = m_lineIndex->lineAt(pos);
+    if (lineIndex == -1) {
         (*line) = -1;
         (*column) = -1;
     } else {
         // line and column are both 1-based
-        (*line) = block.blockNumber() + 1;
-        (*column) = pos - block.position() + 1;
+        (*line) = lineIndex + 1;
+        (*column) = pos - m_lineIndex->lineStart(lineIndex) + 1;
     }
 }
 
 int TextDocument::position(QTextCursor::MoveOperation operation, int pos) const
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
 
     if (pos != -1)
         cursor.setPosition(pos);
@@ -416,31 +739,41 @@ int TextDocument::columnAtPosition(int position)
 int TextDocument::positionAt(int line, int column)
 {
     LOG("TextDocument::positionAt", LOG_ARG("line", line), LOG_ARG("column", column));
-    const QTextBlock block = m_document->document()->findBlockByLineNumber(line - 1);
-    if (!block.isValid()) {
+    ensureLoaded();
+    const int lineStart = m_lineIndex->lineStart(line - 1);
+    if (lineStart == -1) {
         return -1;
     } else {
-        return block.position() + column - 1;
+        return lineStart + column - 1;
     }
 }
 
 QString TextDocument::text() const
 {
     LOG("TextDocument::text");
-    LOG_RETURN("text", m_document->toPlainText());
+    LOG_RETURN("text", plainText());
 }
 
 void TextDocument::setText(const QString &newText)
 {
     LOG("TextDocument::text", LOG_ARG("text", newText));
 
-    m_document->setPlainText(newText);
+    // Only the changed parts are replaced, in one edit: the marks on the rest of the text don't move, the change can be
+    // undone, and the syntax tree and the LSP server are only updated for what changed
+    ensureLoaded();
+    if (m_textDocument->isEmpty()) {
+        setPlainText(newText);
+        return;
+    }
+    const auto replacements = diffReplacements(plainText(), toDocumentText(newText));
+    if (!replacements.empty())
+        applyReplacements(replacements, false);
 }
 
 QString TextDocument::currentLine() const
 {
     LOG("TextDocument::currentLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine);
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -449,7 +782,7 @@ QString TextDocument::currentLine() const
 QString TextDocument::currentWord() const
 {
     LOG("TextDocument::currentWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfWord);
     cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
     LOG_RETURN("text", cursor.selectedText());
@@ -459,7 +792,7 @@ QString TextDocument::selectedText() const
 {
     LOG("TextDocument::selectedText");
     // Replace \u2029 with \n
-    const QString text = m_document->textCursor().selectedText().replace(QChar(8233), "\n");
+    const QString text = textCursor().selectedText().replace(QChar(8233), "\n");
     LOG_RETURN("text", text);
 }
 
@@ -473,9 +806,58 @@ bool TextDocument::hasUtf8Bom() const
     return m_utf8Bom;
 }
 
+/**
+ * \brief Returns the editor used to display the document, creating it if needed
+ */
 QPlainTextEdit *TextDocument::textEdit() const
 {
-    return m_document;
+    if (!m_textEdit)
+        const_cast<TextDocument *>(this)->createTextEdit();
+    return m_textEdit;
+}
+
+QTextDocument *TextDocument::textDocument() const
+{
+    ensureLoaded();
+    return m_textDocument;
+}
+
+/**
+ * \brief Returns the text of the document, without logging it
+ *
+ * The text is only extracted from the QTextDocument once per revision, all the calls in between return the same
+ * implicitly shared string, so it's cheap to call repeatedly.
+ */
+QString TextDocument::plainText() const
+{
+    if (m_plainTextRevision != m_textRevision) {
+        m_plainText = m_textDocument->toPlainText();
+        m_plainTextRevision = m_textRevision;
+    }
+    return m_plainText;
+}
+
+int TextDocument::textRevision() const
+{
+    return m_textRevision;
+}
+
+QTextCursor TextDocument::textCursor() const
+{
+    ensureLoaded();
+    if (m_textEdit)
+        return m_textEdit->textCursor();
+    return m_cursor;
+}
+
+void TextDocument::setTextCursor(const QTextCursor &cursor)
+{
+    if (m_textEdit) {
+        m_textEdit->setTextCursor(cursor);
+        return;
+    }
+    m_cursor = cursor;
+    updateCursorState();
 }
 
 /**
@@ -489,17 +871,83 @@ QString TextDocument::tab() const
     return QStringLiteral("\t");
 }
 
+// Applies a change of the undo journal with the cursor, leaving it after the restored text
+static UndoJournal::ApplyFunction applyJournalChange(QTextCursor &cursor)
+{
+    return [&cursor](const UndoJournal::Change &change) {
+        cursor.setPosition(change.position);
+        cursor.setPosition(change.position + change.length, QTextCursor::KeepAnchor);
+        cursor.insertText(change.text);
+    };
+}
+
 /*!
  * \qmlmethod TextDocument::undo(int count)
  * Undo `count` times the last actions.
+ *
+ * If the `/text_editor/undo_journal` setting is enabled, the history is kept as a journal of reverse diffs, limited in
+ * steps and size, and all the changes done in a transaction are undone at once.
  */
 void TextDocument::undo(int count)
 {
     LOG_AND_MERGE("TextDocument::undo", count);
+    QTextCursor cursor = textCursor();
     while (count != 0) {
-        m_document->undo();
+        if (m_undoJournal) {
+            if (!m_undoJournal->undo(applyJournalChange(cursor)))
+                break;
+        } else {
+            textDocument()->undo(&cursor);
+        }
         --count;
     }
+    setTextCursor(cursor);
+}
+
+/*!
+ * \qmlmethod TextDocument::beginTransaction()
+ * Starts a transaction, to do many changes in a row efficiently.
+ *
+ * The text, the position and the marks are still updated with each change, but the syntax tree and the language
+ * server are only told about the changes once, when the transaction is committed. Transactions can be nested, only
+ * the last `commit` commits the changes.
+ */
+void TextDocument::beginTransaction()
+{
+    LOG("TextDocument::beginTransaction");
+    if (m_transactionLevel++ == 0)
+        ++m_transactionGroup;
+}
+
+/*!
+ * \qmlmethod TextDocument::commit()
+ * Commits the changes done since the call to `beginTransaction`.
+ */
+void TextDocument::commit()
+{
+    LOG("TextDocument::commit");
+    if (m_transactionLevel == 0) {
+        spdlog::warn("TextDocument::commit - no transaction to commit");
+        return;
+    }
+    if (--m_transactionLevel == 0)
+        flushTransaction();
+}
+
+void TextDocument::flushTransaction()
+{
+    if (!m_transactionChange)
+        return;
+    const auto change = *m_transactionChange;
+    m_transactionChange.reset();
+    changeContent(change.position, change.charsRemoved, change.charsAdded);
+}
+
+void TextDocument::changeContent(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(position)
+    Q_UNUSED(charsRemoved)
+    Q_UNUSED(charsAdded)
 }
 
 /*!
@@ -509,17 +957,24 @@ void TextDocument::undo(int count)
 void TextDocument::redo(int count)
 {
     LOG_AND_MERGE("TextDocument::redo", count);
+    QTextCursor cursor = textCursor();
     while (count != 0) {
-        m_document->redo();
+        if (m_undoJournal) {
+            if (!m_undoJournal->redo(applyJournalChange(cursor)))
+                break;
+        } else {
+            textDocument()->redo(&cursor);
+        }
         --count;
     }
+    setTextCursor(cursor);
 }
 
 void TextDocument::movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode, int count)
 {
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(operation, mode, count);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -532,22 +987,176 @@ void TextDocument::gotoLine(int line, int column)
 {
     LOG("TextDocument::gotoLine", LOG_ARG("line", line), LOG_ARG("column", column));
 
-    gotoLineInTextEdit(m_document, line, column);
+    QTextCursor cursor = textCursor();
+    gotoLineInTextCursor(cursor, line, column);
+    setTextCursor(cursor);
 }
 
-void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column)
+void gotoLineInTextCursor(QTextCursor &cursor, int line, int column)
 {
     // Internally, columns are 0-based, while 1-based on the API
     column = column - 1;
-    const int blockNumber = qMin(line, textEdit->document()->blockCount()) - 1;
-    const QTextBlock &block = textEdit->document()->findBlockByNumber(blockNumber);
+    const int blockNumber = qMin(line, cursor.document()->blockCount()) - 1;
+    const QTextBlock &block = cursor.document()->findBlockByNumber(blockNumber);
     if (block.isValid()) {
-        QTextCursor cursor(block);
+        cursor = QTextCursor(block);
         if (column > 0)
             cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, column);
+    }
+}
+
+void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column)
+{
+    QTextCursor cursor = textEdit->textCursor();
+    gotoLineInTextCursor(cursor, line, column);
+    textEdit->setTextCursor(cursor);
+}
+
+LineIndex::LineIndex(QTextDocument *document)
+    : m_document(document)
+{
+}
+
+void LineIndex::build()
+{
+    m_lineStarts.clear();
+    m_lineStarts.reserve(m_document->blockCount());
+    for (auto block = m_document->begin(); block.isValid(); block = block.next())
+        m_lineStarts.push_back(block.position());
+    m_characterCount = m_document->characterCount();
+    m_isValid = true;
+}
+
+UndoJournal::UndoJournal(int maxSteps, qsizetype maxSize)
+    : m_maxSteps(maxSteps)
+    , m_maxSize(maxSize)
+{
+}
+
+void UndoJournal::record(Change change, int group)
+{
+    const auto size = change.text.size();
+    if (m_replayEntry) {
+        m_replayEntry->step.push_back(std::move(change));
+        m_replayEntry->size += size;
+        return;
+    }
+
+    // A new change makes the undone steps obsolete
+    for (const auto &entry : m_redoSteps)
+        m_size -= entry.size;
+    m_redoSteps.clear();
+
+    if (group == 0 || m_undoSteps.empty() || m_undoSteps.back().group != group)
+        m_undoSteps.push_back({.group = group});
+    auto &entry = m_undoSteps.back();
+    entry.step.push_back(std::move(change));
+    entry.size += size;
+    m_size += size;
+    trim();
+}
 
-        textEdit->setTextCursor(cursor);
+bool UndoJournal::undo(const ApplyFunction &apply)
+{
+    return replay(m_undoSteps, m_redoSteps, apply);
+}
+
+bool UndoJournal::redo(const ApplyFunction &apply)
+{
+    return replay(m_redoSteps, m_undoSteps, apply);
+}
+
+qint64 UndoJournal::memorySize() const
+{
+    auto size = static_cast<qint64>(m_size * sizeof(QChar));
+    for (const auto *steps : {&m_undoSteps, &m_redoSteps}) {
+        for (const auto &entry : *steps)
+            size += static_cast<qint64>(sizeof(Entry) + entry.step.capacity() * sizeof(Change));
+    }
+    return size;
+}
+
+void UndoJournal::clear()
+{
+    m_undoSteps.clear();
+    m_redoSteps.clear();
+    m_size = 0;
+}
+
+bool UndoJournal::replay(std::deque<Entry> &from, std::deque<Entry> &to, const ApplyFunction &apply)
+{
+    if (from.empty())
+        return false;
+
+    const Entry entry = std::move(from.back());
+    from.pop_back();
+    m_size -= entry.size;
+
+    m_replayEntry = Entry();
+    for (const auto &change : entry.step | std::views::reverse)
+        apply(change);
+    m_size += m_replayEntry->size;
+    to.push_back(std::move(*m_replayEntry));
+    m_replayEntry.reset();
+    trim();
+    return true;
+}
+
+void UndoJournal::trim()
+{
+    while (!m_undoSteps.empty() && (std::ssize(m_undoSteps) > m_maxSteps || m_size > m_maxSize)) {
+        m_size -= m_undoSteps.front().size;
+        m_undoSteps.pop_front();
+    }
+}
+
+void LineIndex::update(int from, int charsRemoved, int charsAdded)
+{
+    if (!m_isValid)
+        return;
+    // The change doesn't match the indexed text, rebuild the index on the next use
+    if (from < 0 || from + charsRemoved > m_characterCount
+        || m_characterCount - charsRemoved + charsAdded != m_document->characterCount()) {
+        m_isValid = false;
+        return;
     }
+
+    // Lines starting in the removed text are gone, the ones after are moved
+    auto first = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), from);
+    auto last = std::upper_bound(first, m_lineStarts.end(), from + charsRemoved);
+    const int delta = charsAdded - charsRemoved;
+    std::for_each(last, m_lineStarts.end(), [delta](int &start) {
+        start += delta;
+    });
+
+    // Lines starting in the added text
+    std::vector<int> addedStarts;
+    for (auto block = m_document->findBlock(from).next(); block.isValid() && block.position() <= from + charsAdded;
+         block = block.next()) {
+        addedStarts.push_back(block.position());
+    }
+    first = m_lineStarts.erase(first, last);
+    m_lineStarts.insert(first, addedStarts.begin(), addedStarts.end());
+    m_characterCount = m_document->characterCount();
+}
+
+int LineIndex::lineAt(int position)
+{
+    if (!m_isValid)
+        build();
+    if (position < 0 || position >= m_characterCount)
+        return -1;
+    const auto it = std::upper_bound(m_lineStarts.cbegin(), m_lineStarts.cend(), position);
+    return static_cast<int>(std::distance(m_lineStarts.cbegin(), it)) - 1;
+}
+
+int LineIndex::lineStart(int line)
+{
+    if (!m_isValid)
+        build();
+    if (line < 0 || line >= static_cast<int>(m_lineStarts.size()))
+        return -1;
+    return m_lineStarts[line];
 }
 
 /*!
@@ -677,9 +1286,9 @@ void TextDocument::gotoEndOfDocument()
 void TextDocument::unselect()
 {
     LOG("TextDocument::unselect");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.clearSelection();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -689,7 +1298,7 @@ void TextDocument::unselect()
 bool TextDocument::hasSelection()
 {
     LOG("TextDocument::hasSelection");
-    return m_document->textCursor().hasSelection();
+    return textCursor().hasSelection();
 }
 
 /*!
@@ -699,7 +1308,9 @@ bool TextDocument::hasSelection()
 void TextDocument::selectAll()
 {
     LOG("TextDocument::selectAll");
-    m_document->selectAll();
+    QTextCursor cursor = textCursor();
+    cursor.select(QTextCursor::Document);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -709,9 +1320,9 @@ void TextDocument::selectAll()
 void TextDocument::selectTo(int pos)
 {
     LOG("TextDocument::selectTo", LOG_ARG("pos", pos));
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -821,10 +1432,10 @@ void TextDocument::selectNextWord(int count)
 void TextDocument::selectRegion(int from, int to)
 {
     LOG("TextDocument::selectRegion", from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(textDocument());
     cursor.setPosition(from, QTextCursor::MoveAnchor);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -844,7 +1455,13 @@ void TextDocument::selectRange(const TextRange &range)
 void TextDocument::copy()
 {
     LOG("TextDocument::copy");
-    m_document->copy();
+    if (m_textEdit) {
+        m_textEdit->copy();
+        return;
+    }
+    const QTextCursor cursor = textCursor();
+    if (cursor.hasSelection())
+        QGuiApplication::clipboard()->setText(cursor.selection().toPlainText());
 }
 
 /*!
@@ -854,7 +1471,13 @@ void TextDocument::copy()
 void TextDocument::paste()
 {
     LOG("TextDocument::paste");
-    m_document->paste();
+    if (m_textEdit) {
+        m_textEdit->paste();
+        return;
+    }
+    QTextCursor cursor = textCursor();
+    cursor.insertText(QGuiApplication::clipboard()->text());
+    setTextCursor(cursor);
 }
 
 /*!
@@ -864,7 +1487,16 @@ void TextDocument::paste()
 void TextDocument::cut()
 {
     LOG("TextDocument::cut");
-    m_document->cut();
+    if (m_textEdit) {
+        m_textEdit->cut();
+        return;
+    }
+    QTextCursor cursor = textCursor();
+    if (!cursor.hasSelection())
+        return;
+    QGuiApplication::clipboard()->setText(cursor.selection().toPlainText());
+    cursor.removeSelectedText();
+    setTextCursor(cursor);
 }
 
 /*!
@@ -874,10 +1506,10 @@ void TextDocument::cut()
 void TextDocument::remove(int length)
 {
     LOG("TextDocument::remove", length);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -887,7 +1519,9 @@ void TextDocument::remove(int length)
 void TextDocument::insert(const QString &text)
 {
     LOG_AND_MERGE("TextDocument::insert", LOG_ARG("text", text));
-    m_document->insertPlainText(text);
+    QTextCursor cursor = textCursor();
+    cursor.insertText(text);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -901,10 +1535,10 @@ void TextDocument::insertAtLine(const QString &text, int line)
     else
         LOG("TextDocument::insertAtLine", LOG_ARG("text", text), LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, textDocument()->blockCount()) - 1;
+        const QTextBlock &block = textDocument()->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     }
@@ -918,7 +1552,7 @@ void TextDocument::insertAtLine(const QString &text, int line)
 void TextDocument::insertAtPosition(const QString &text, int pos)
 {
     LOG("TextDocument::insertAtPosition", text, pos);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(pos);
     cursor.beginEditBlock();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
@@ -933,10 +1567,10 @@ void TextDocument::insertAtPosition(const QString &text, int pos)
 void TextDocument::replace(int length, const QString &text)
 {
     LOG("TextDocument::replace", length, text);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(cursor.position() + length, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -946,11 +1580,11 @@ void TextDocument::replace(int length, const QString &text)
 void TextDocument::replace(int from, int to, const QString &text)
 {
     LOG("TextDocument::replace", from, to, text);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(textDocument());
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.insertText(text);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -963,6 +1597,55 @@ void TextDocument::replace(const TextRange &range, const QString &text)
     replace(range.start, range.end, text);
 }
 
+/*!
+ * \qmlmethod bool TextDocument::replaceRanges(array<RangeMark> ranges, array<string> texts)
+ * Replaces the text of each range of `ranges` with the string at the same index in `texts`, as a single edit.
+ *
+ * This is a lot faster than calling `RangeMark::replace` for each range: the syntax tree, the language server and the
+ * marks are updated once for all the replacements, and it's one undo step. The ranges can be given in any order, but
+ * they can't overlap.
+ *
+ * Returns false, without changing the text, if a range is invalid or from another document, if ranges overlap or if
+ * the number of texts doesn't match the number of ranges.
+ */
+bool TextDocument::replaceRanges(const RangeMarkList &ranges, const QStringList &texts)
+{
+    // A list of ranges has no text representation for the history
+    LOG("TextDocument::replaceRanges", texts);
+
+    if (ranges.size() != texts.size()) {
+        spdlog::error("TextDocument::replaceRanges - {} ranges for {} texts", ranges.size(), texts.size());
+        return false;
+    }
+    if (ranges.isEmpty())
+        return true;
+
+    std::vector<TextReplacement> replacements;
+    replacements.reserve(ranges.size());
+    for (qsizetype i = 0; i < ranges.size(); ++i) {
+        const auto &range = ranges.at(i);
+        if (!range.isValid() || range.document() != this) {
+            spdlog::error("TextDocument::replaceRanges - invalid range {}", range.toString());
+            return false;
+        }
+        replacements.push_back({.start = range.start(), .end = range.end(), .text = texts.at(i)});
+    }
+
+    std::ranges::stable_sort(replacements, {}, &TextReplacement::start);
+    for (size_t i = 1; i < replacements.size(); ++i) {
+        if (replacements[i].start < replacements[i - 1].end) {
+            spdlog::error("TextDocument::replaceRanges - overlapping ranges {}-{} and {}-{}", replacements[i - 1].start,
+                          replacements[i - 1].end, replacements[i].start, replacements[i].end);
+            return false;
+        }
+    }
+
+    // The positions in the text must match the QTextDocument
+    ensureLoaded();
+    applyReplacements(replacements);
+    return true;
+}
+
 /*!
  * \qmlmethod TextDocument::deleteLine(int line = -1)
  * Remove a the line `line`. If `line` is -1, remove the current line. `line` is 1-based.
@@ -974,10 +1657,10 @@ void TextDocument::deleteLine(int line)
     else
         LOG("TextDocument::deleteLine", LOG_ARG("line", line));
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (line > 0) {
-        const int blockNumber = qMin(line, m_document->document()->blockCount()) - 1;
-        const QTextBlock &block = m_document->document()->findBlockByNumber(blockNumber);
+        const int blockNumber = qMin(line, textDocument()->blockCount()) - 1;
+        const QTextBlock &block = textDocument()->findBlockByNumber(blockNumber);
         if (block.isValid())
             cursor = QTextCursor(block);
     } else {
@@ -994,7 +1677,7 @@ void TextDocument::deleteLine(int line)
 void TextDocument::deleteSelection()
 {
     LOG("TextDocument::deleteSelection");
-    m_document->textCursor().removeSelectedText();
+    textCursor().removeSelectedText();
 }
 
 /*!
@@ -1004,11 +1687,11 @@ void TextDocument::deleteSelection()
 void TextDocument::deleteRegion(int from, int to)
 {
     LOG("TextDocument::deleteRegion", from, to);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(textDocument());
     cursor.setPosition(from);
     cursor.setPosition(to, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1018,11 +1701,11 @@ void TextDocument::deleteRegion(int from, int to)
 void TextDocument::deleteRange(const TextRange &range)
 {
     LOG("TextDocument::deleteRange", range);
-    QTextCursor cursor(m_document->document());
+    QTextCursor cursor(textDocument());
     cursor.setPosition(range.start, QTextCursor::MoveAnchor);
     cursor.setPosition(range.end, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1032,10 +1715,10 @@ void TextDocument::deleteRange(const TextRange &range)
 void TextDocument::deleteEndOfLine()
 {
     LOG("TextDocument::deleteEndOfLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1045,10 +1728,10 @@ void TextDocument::deleteEndOfLine()
 void TextDocument::deleteStartOfLine()
 {
     LOG("TextDocument::deleteStartOfLine");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::StartOfLine, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1058,11 +1741,11 @@ void TextDocument::deleteStartOfLine()
 void TextDocument::deleteEndOfWord()
 {
     LOG("TextDocument::deleteEndOfWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::NextWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1072,11 +1755,11 @@ void TextDocument::deleteEndOfWord()
 void TextDocument::deleteStartOfWord()
 {
     LOG("TextDocument::deleteStartOfWord");
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     if (!cursor.hasSelection())
         cursor.movePosition(QTextCursor::PreviousWord, QTextCursor::KeepAnchor);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1086,10 +1769,10 @@ void TextDocument::deleteStartOfWord()
 void TextDocument::deletePreviousCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deletePreviousCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1099,10 +1782,10 @@ void TextDocument::deletePreviousCharacter(int count)
 void TextDocument::deleteNextCharacter(int count)
 {
     LOG_AND_MERGE("TextDocument::deleteNextCharacter", count);
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, count);
     cursor.removeSelectedText();
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1131,9 +1814,9 @@ void TextDocument::gotoMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position());
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /*!
@@ -1148,9 +1831,9 @@ void TextDocument::selectToMark(const Mark &mark)
         return;
     }
 
-    QTextCursor cursor = m_document->textCursor();
+    QTextCursor cursor = textCursor();
     cursor.setPosition(mark.position(), QTextCursor::KeepAnchor);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 }
 
 /**
@@ -1176,7 +1859,7 @@ Core::RangeMark TextDocument::createRangeMark(int from, int to)
 Core::RangeMark TextDocument::createRangeMark()
 {
     LOG("TextDocument::createRangeMark");
-    const auto cursor = m_document->textCursor();
+    const auto cursor = textCursor();
     const int start = cursor.selectionStart();
     const int end = cursor.selectionEnd();
 
@@ -1221,10 +1904,64 @@ bool TextDocument::find(const QString &text, int options)
     LOG("TextDocument::find", LOG_ARG("text", text), options);
     if (options & FindRegexp)
         return findRegexp(text, options);
-    else if (options & FindWholeWords)
-        return findRegexp(QRegularExpression::escape(text), options);
-    else
-        return m_document->find(text, static_cast<QTextDocument::FindFlags>(options));
+
+    const QTextCursor cursor = findLiteral(text, options);
+    if (cursor.isNull())
+        return false;
+    setTextCursor(cursor);
+    return true;
+}
+
+// Literal search used when FindRegexp is not set. It matches like the searches it replaces: QTextDocument::find for
+// plain text, and the regexp search with `\b` for whole words (which is case sensitive with PreserveCase).
+static Utils::LiteralFinder createLiteralFinder(const QString &text, int options)
+{
+    const bool wholeWords = options & TextDocument::FindWholeWords;
+    int caseFlags = TextDocument::FindCaseSensitively;
+    if (wholeWords)
+        caseFlags |= TextDocument::PreserveCase;
+    return Utils::LiteralFinder(text, (options & caseFlags) ? Qt::CaseSensitive : Qt::CaseInsensitive, wholeWords);
+}
+
+// A literal can't match across lines, as the search is done line by line in QTextDocument
+static bool isSingleLine(const QString &text)
+{
+    return !text.contains(u'\n') && !text.contains(QChar::ParagraphSeparator);
+}
+
+/**
+ * \brief Searches the literal `text` in the document, starting from the current cursor
+ *
+ * The search is done on the text snapshot, without walking the blocks of the document. Returns the cursor selecting
+ * the match, or a null cursor if nothing is found.
+ */
+QTextCursor TextDocument::findLiteral(const QString &text, int options) const
+{
+    if (text.isEmpty() || !isSingleLine(text))
+        return {};
+
+    QTextCursor cursor = textCursor();
+    const auto finder = createLiteralFinder(text, options);
+    const QString snapshot = plainText();
+
+    qsizetype start = -1;
+    if (options & FindBackward) {
+        // The cursor is positioned between characters, don't include the character at the cursor position
+        const int from = cursor.selectionStart() - 1;
+        if (from >= 0)
+            start = finder.lastIndexIn(snapshot, from);
+    } else {
+        start = finder.indexIn(snapshot, cursor.selectionEnd());
+    }
+    if (start == -1)
+        return {};
+
+    const auto end = start + finder.size();
+    // Like the regexp search, a whole words match found backward keeps the cursor at its start
+    const bool reversed = (options & FindBackward) && (options & FindWholeWords);
+    cursor.setPosition(static_cast<int>(reversed ? end : start));
+    cursor.setPosition(static_cast<int>(reversed ? start : end), QTextCursor::KeepAnchor);
+    return cursor;
 }
 
 /*!
@@ -1245,27 +1982,31 @@ bool TextDocument::findRegexp(const QString &regexp, int options)
     return found.has_value();
 }
 
-auto TextDocument::selectRegexpMatch(
-    QString regexp, int options,
-    const std::function<bool(const QRegularExpression &, const QRegularExpressionMatch &, const QTextCursor &)>
-        &selectionFunction) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>
+// Regular expression used by the regexp search, or when searching for whole words
+static QRegularExpression createFindExpression(QString regexp, int options)
 {
-    unselect();
-
-    if (options & FindWholeWords) {
+    if (options & TextDocument::FindWholeWords) {
         if (!regexp.startsWith("\\b"))
             regexp = "\\b" + regexp;
         if (!regexp.endsWith("\\b"))
             regexp += "\\b";
     }
 
-    QRegularExpression expression(regexp);
-    if (options & (TextDocument::FindCaseSensitively | TextDocument::PreserveCase))
-        expression.setPatternOptions(expression.patternOptions() & ~QRegularExpression::CaseInsensitiveOption);
-    else
-        expression.setPatternOptions(expression.patternOptions() | QRegularExpression::CaseInsensitiveOption);
+    const bool caseSensitive = options & (TextDocument::FindCaseSensitively | TextDocument::PreserveCase);
+    return Utils::cachedRegularExpression(regexp, caseSensitive ? QRegularExpression::NoPatternOption
+                                                                : QRegularExpression::CaseInsensitiveOption);
+}
+
+auto TextDocument::selectRegexpMatch(
+    QString regexp, int options,
+    const std::function<bool(const QRegularExpression &, const QRegularExpressionMatch &, const QTextCursor &)>
+        &selectionFunction) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>
+{
+    unselect();
 
-    const QTextCursor startCursor = m_document->textCursor();
+    const QRegularExpression expression = createFindExpression(std::move(regexp), options);
+
+    const QTextCursor startCursor = textCursor();
     QTextBlock block = startCursor.block();
     int blockOffset = startCursor.positionInBlock();
 
@@ -1274,7 +2015,7 @@ auto TextDocument::selectRegexpMatch(
         if (found.has_value()) {
             const auto &[match, newCursor] = *found;
             if (selectionFunction(expression, match, newCursor)) {
-                m_document->setTextCursor(newCursor);
+                setTextCursor(newCursor);
                 return found;
             }
 
@@ -1350,9 +2091,9 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
 {
     LOG("TextDocument::replaceOne", LOG_ARG("text", before), after, options);
 
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(QTextCursor::Start);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
 
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
@@ -1360,7 +2101,7 @@ bool TextDocument::replaceOne(const QString &before, const QString &after, int o
     const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
     if (find(before, options)) {
         cursor.beginEditBlock();
-        const auto found = m_document->textCursor();
+        const auto found = textCursor();
         cursor.setPosition(found.selectionStart());
         cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
         QString afterText = after;
@@ -1442,15 +2183,20 @@ int TextDocument::replaceAll(const QString &before, const QString &after, int op
     const bool usesRegExp = options & FindRegexp;
     const bool preserveCase = options & PreserveCase;
 
+    // Replacing backward may not give the same result when occurrences overlap, so only that case is done one
+    // occurrence at a time
+    if (!backwards)
+        return replaceAllInOnePass(before, after, options, filterAcceptsCursor);
+
     int count = 0;
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.movePosition(backwards ? QTextCursor::End : QTextCursor::Start);
-    m_document->setTextCursor(cursor);
+    setTextCursor(cursor);
     cursor.beginEditBlock();
 
     const auto regexp = Utils::createRegularExpression(before, options, usesRegExp);
     while (find(before, options)) {
-        const auto found = m_document->textCursor();
+        const auto found = textCursor();
         cursor.setPosition(found.selectionStart());
         cursor.setPosition(found.selectionEnd(), QTextCursor::KeepAnchor);
         if (!filterAcceptsCursor(cursor)) {
@@ -1472,6 +2218,174 @@ int TextDocument::replaceAll(const QString &before, const QString &after, int op
     return count;
 }
 
+void forEachMatch(QStringView text, const QString &pattern, int options, const MatchFunction &onMatch)
+{
+    if (!(options & TextDocument::FindRegexp)) {
+        if (!pattern.isEmpty() && isSingleLine(pattern)) {
+            const auto finder = createLiteralFinder(pattern, options);
+            for (const auto start : finder.findAll(text))
+                onMatch(start, start + finder.size(), nullptr);
+        }
+        return;
+    }
+
+    const QRegularExpression expression = createFindExpression(pattern, options);
+    qsizetype lineStart = 0;
+    while (lineStart <= text.size()) {
+        auto lineEnd = text.indexOf(u'\n', lineStart);
+        if (lineEnd == -1)
+            lineEnd = text.size();
+
+        auto it = expression.globalMatch(text.sliced(lineStart, lineEnd - lineStart));
+        while (it.hasNext()) {
+            const auto match = it.next();
+            onMatch(lineStart + match.capturedStart(), lineStart + match.capturedEnd(), &match);
+        }
+        lineStart = lineEnd + 1;
+    }
+}
+
+std::vector<TextReplacement> findReplacements(const QString &text, const QString &before, const QString &after,
+                                              int options, const std::function<bool(int, int)> &filterAccepts)
+{
+    const bool usesRegExp = options & TextDocument::FindRegexp;
+    const bool preserveCase = options & TextDocument::PreserveCase;
+
+    std::vector<TextReplacement> replacements;
+    // Like matchInBlock and QTextDocument::find, non-breaking spaces are matched as spaces
+    QString searchText = text;
+    searchText.replace(QChar::Nbsp, u' ');
+
+    auto addReplacement = [&](qsizetype start, qsizetype end, const QRegularExpressionMatch *match) {
+        if (filterAccepts && !filterAccepts(static_cast<int>(start), static_cast<int>(end)))
+            return;
+
+        QString afterText = after;
+        if (usesRegExp)
+            afterText = Utils::expandRegExpReplacement(after, match->capturedTexts());
+        else if (preserveCase)
+            afterText = Utils::matchCaseReplacement(QStringView(text).sliced(start, end - start), QStringView(after));
+        replacements.push_back(
+            {.start = static_cast<int>(start), .end = static_cast<int>(end), .text = std::move(afterText)});
+    };
+    forEachMatch(searchText, before, options, addReplacement);
+    return replacements;
+}
+
+/**
+ * \brief Replaces all occurrences found forward as one edit
+ *
+ * The occurrences are searched in the text once, line by line like `find`, and replaced with applyReplacements.
+ */
+int TextDocument::replaceAllInOnePass(const QString &before, const QString &after, int options,
+                                      const std::function<bool(QTextCursor)> &filterAcceptsCursor)
+{
+    // The positions in the text must match the QTextDocument
+    ensureLoaded();
+
+    const QString text = plainText();
+    const auto replacements = findReplacements(text, before, after, options, [&](int start, int end) {
+        QTextCursor cursor(textDocument());
+        cursor.setPosition(start);
+        cursor.setPosition(end, QTextCursor::KeepAnchor);
+        return filterAcceptsCursor(cursor);
+    });
+
+    if (replacements.empty()) {
+        setTextCursor(QTextCursor(textDocument()));
+        return 0;
+    }
+    applyReplacements(replacements);
+    return static_cast<int>(replacements.size());
+}
+
+std::vector<TextReplacement> diffReplacements(const QString &oldText, const QString &newText)
+{
+    const auto oldLines = Utils::splitLines(oldText);
+    const auto newLines = Utils::splitLines(newText);
+    // The lines are views on the texts, the position after the last line is the end of the text
+    auto lineStart = [](const std::vector<QStringView> &lines, const QString &text, int line) {
+        return line < static_cast<int>(lines.size()) ? static_cast<int>(lines[line].constData() - text.constData())
+                                                     : static_cast<int>(text.size());
+    };
+
+    std::vector<TextReplacement> replacements;
+    // Keep the start and end of the changed lines that are the same, so the marks on them don't move. A surrogate pair
+    // is never split.
+    auto addReplacement = [&](int oldStart, int oldEnd, int newStart, int newEnd) {
+        const auto oldPart = QStringView(oldText).sliced(oldStart, oldEnd - oldStart);
+        const auto newPart = QStringView(newText).sliced(newStart, newEnd - newStart);
+        const auto minSize = std::min(oldPart.size(), newPart.size());
+        qsizetype prefix = 0;
+        while (prefix < minSize && oldPart[prefix] == newPart[prefix])
+            ++prefix;
+        if (prefix > 0 && oldPart[prefix - 1].isHighSurrogate())
+            --prefix;
+        qsizetype suffix = 0;
+        while (suffix < minSize - prefix
+               && oldPart[oldPart.size() - suffix - 1] == newPart[newPart.size() - suffix - 1])
+            ++suffix;
+        if (suffix > 0 && oldPart[oldPart.size() - suffix].isLowSurrogate())
+            --suffix;
+
+        replacements.push_back({oldStart + static_cast<int>(prefix), oldEnd - static_cast<int>(suffix),
+                                newPart.sliced(prefix, newPart.size() - prefix - suffix).toString()});
+    };
+
+    // Past that many lines removed and added, the diff costs more than replacing the whole changed part at once
+    constexpr int MaxDiffEdits = 1000;
+    const auto hunks = Utils::boundedDiffLines(oldLines, newLines, 0, MaxDiffEdits);
+    if (!hunks) {
+        if (oldText != newText)
+            addReplacement(0, static_cast<int>(oldText.size()), 0, static_cast<int>(newText.size()));
+        return replacements;
+    }
+    for (const auto &hunk : *hunks) {
+        addReplacement(lineStart(oldLines, oldText, hunk.oldStart),
+                       lineStart(oldLines, oldText, hunk.oldStart + hunk.oldCount),
+                       lineStart(newLines, newText, hunk.newStart),
+                       lineStart(newLines, newText, hunk.newStart + hunk.newCount));
+    }
+    return replacements;
+}
+
+/**
+ * \brief Applies all the replacements as one edit
+ *
+ * The part of the document between the first and the last replacement is replaced at once. This creates only one undo
+ * step and one text change for the other parts of Knut (syntax tree, LSP...), and the marks are updated for all the
+ * replacements in one pass.
+ */
+void TextDocument::applyReplacements(const std::vector<TextReplacement> &replacements, bool moveCursor)
+{
+    const QString text = plainText();
+    QTextCursor cursor(textDocument());
+
+    // Only the text between the first and last replacements is changed
+    const int from = replacements.front().start;
+    const int to = replacements.back().end;
+    QString newText;
+    TextChanges changes;
+    int position = from;
+    for (const auto &replacement : replacements) {
+        newText.append(QStringView(text).sliced(position, replacement.start - position));
+        newText.append(replacement.text);
+        changes.add(replacement.start, replacement.end - replacement.start, replacement.text.size());
+        position = replacement.end;
+    }
+
+    cursor.setPosition(from);
+    cursor.setPosition(to, QTextCursor::KeepAnchor);
+    m_pendingChanges = &changes;
+    cursor.beginEditBlock();
+    cursor.insertText(newText);
+    cursor.endEditBlock();
+    m_pendingChanges = nullptr;
+
+    if (moveCursor)
+        setTextCursor(cursor);
+}
+
 /*!
  * \qmlmethod bool TextDocument::replaceAllRegexp(string regexp, string after, int options = TextDocument.NoFindFlags)
  * Replaces all occurrences of the matches for the `regexp` with `after`. See the options from `replaceAll`.
@@ -1524,7 +2438,7 @@ int TextDocument::replaceAllRegexp(const QString &regexp, const QString &after,
     return replaceAll(regexp, after, options | FindRegexp, filterAcceptsCursor);
 }
 
-static int columnAt(const QString &text, int position, int tabSize)
+static int columnAt(QStringView text, int position, int tabSize)
 {
     int column = 0;
     for (int i = 0; i < position; ++i) {
@@ -1536,7 +2450,7 @@ static int columnAt(const QString &text, int position, int tabSize)
     return column;
 }
 
-static int firstNonSpace(const QString &text)
+static int firstNonSpace(QStringView text)
 {
     int i = 0;
     while (i < text.size()) {
@@ -1567,14 +2481,13 @@ static int indentOneLine(QTextCursor &cursor, int tabCount, const TabSettings &s
     return text.size() - oldSize;
 }
 
-void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount)
+void indentTextInTextCursor(QTextCursor &cursor, int tabCount)
 {
     const auto settings = Core::Settings::instance()->value<Core::TabSettings>(Core::Settings::Tab);
 
-    QTextCursor cursor = textEdit->textCursor();
     const bool hasSelection = cursor.hasSelection();
-    const int lineStart = textEdit->document()->findBlock(cursor.selectionStart()).blockNumber();
-    const int lineEnd = textEdit->document()->findBlock(cursor.selectionEnd()).blockNumber();
+    const int lineStart = cursor.document()->findBlock(cursor.selectionStart()).blockNumber();
+    const int lineEnd = cursor.document()->findBlock(cursor.selectionEnd()).blockNumber();
 
     // Move the position to the beginning of the first line
     int startPosition = cursor.position();
@@ -1598,13 +2511,19 @@ void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount)
     } else {
         cursor.select(QTextCursor::LineUnderCursor);
         startPosition += indentOneLine(cursor, tabCount, settings);
-        const int finalLine = textEdit->document()->findBlock(startPosition).blockNumber();
+        const int finalLine = cursor.document()->findBlock(startPosition).blockNumber();
         if (finalLine != lineStart)
-            gotoLineInTextEdit(textEdit, lineStart + 1);
+            gotoLineInTextCursor(cursor, lineStart + 1);
         else
             cursor.setPosition(startPosition);
     }
     cursor.endEditBlock();
+}
+
+void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount)
+{
+    QTextCursor cursor = textEdit->textCursor();
+    indentTextInTextCursor(cursor, tabCount);
     textEdit->setTextCursor(cursor);
 }
 
@@ -1616,7 +2535,9 @@ void TextDocument::indent(int count)
 {
     LOG_AND_MERGE("TextDocument::indent", count);
     while (count != 0) {
-        indentTextInTextEdit(m_document, 1);
+        QTextCursor cursor = textCursor();
+        indentTextInTextCursor(cursor, 1);
+        setTextCursor(cursor);
         --count;
     }
 }
@@ -1629,11 +2550,60 @@ void TextDocument::removeIndent(int count)
 {
     LOG_AND_MERGE("TextDocument::removeIndent", count);
     while (count != 0) {
-        indentTextInTextEdit(m_document, -1);
+        QTextCursor cursor = textCursor();
+        indentTextInTextCursor(cursor, -1);
+        setTextCursor(cursor);
         --count;
     }
 }
 
+/*!
+ * \qmlmethod int TextDocument::reindentRange(RangeMark range, int levels)
+ * Changes the indentation of all the lines of `range` by `levels`, a negative value removing indentation, and returns
+ * the number of lines changed.
+ *
+ * The new indentations are computed from the tab settings in one pass, and applied as a single edit: this is a lot
+ * faster than `indent` or `removeIndent` on a large range, and it's one undo step. Like `indent`, the indentation is
+ * written with the tab settings, so 0 `levels` only converts the indentation of the lines. Blank lines are left
+ * unchanged.
+ */
+int TextDocument::reindentRange(const RangeMark &range, int levels)
+{
+    LOG("TextDocument::reindentRange", range, levels);
+
+    if (!range.isValid() || range.document() != this) {
+        spdlog::error("TextDocument::reindentRange - invalid range {}", range.toString());
+        return 0;
+    }
+
+    const auto settings = Settings::instance()->value<TabSettings>(Settings::Tab);
+    const QString text = plainText();
+    std::vector<TextReplacement> replacements;
+    // From the start of the line of the range start, to the line of the range end included
+    int lineStart = range.start() == 0 ? 0 : static_cast<int>(text.lastIndexOf(u'\n', range.start() - 1)) + 1;
+    while (lineStart <= range.end() && lineStart < text.size()) {
+        int lineEnd = static_cast<int>(text.indexOf(u'\n', lineStart));
+        if (lineEnd == -1)
+            lineEnd = static_cast<int>(text.size());
+        const QStringView line = QStringView(text).sliced(lineStart, lineEnd - lineStart);
+
+        const int firstChar = firstNonSpace(line);
+        if (firstChar < line.size()) {
+            const int startColumn = columnAt(line, firstChar, settings.tabSize);
+            const int indentSize = std::max(startColumn / settings.tabSize + levels, 0);
+            const QString indentation = settings.insertSpaces ? QString(indentSize * settings.tabSize, u' ')
+                                                              : QString(indentSize, u'\t');
+            if (line.first(firstChar) != indentation)
+                replacements.push_back({.start = lineStart, .end = lineStart + firstChar, .text = indentation});
+        }
+        lineStart = lineEnd + 1;
+    }
+
+    if (!replacements.empty())
+        applyReplacements(replacements, false);
+    return static_cast<int>(replacements.size());
+}
+
 void TextDocument::setLineEnding(LineEnding newLineEnding)
 {
     LOG("TextDocument::setLineEnding", newLineEnding);
@@ -1651,7 +2621,7 @@ void TextDocument::setLineEnding(LineEnding newLineEnding)
 QString TextDocument::indentationAtPosition(int pos)
 {
     LOG("TextDocument::indentationAtPosition", pos);
-    auto cursor = m_document->textCursor();
+    auto cursor = textCursor();
     cursor.setPosition(pos);
     cursor.movePosition(QTextCursor::StartOfLine);
     const QString line = cursor.block().text();
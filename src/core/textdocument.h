@@ -18,12 +18,24 @@
 #include <QRegularExpressionMatch>
 #include <QTextCursor>
 #include <QTextDocument>
+#include <memory>
+
+namespace Utils {
+struct DecodedText;
+}
 
 class QPlainTextEdit;
 
 namespace Core {
 
+class LineIndex;
+class MarkPositions;
+class MarkTable;
 class RangeMark;
+class RangeMarkPrivate;
+class TextChanges;
+class UndoJournal;
+struct TextReplacement;
 
 class TextDocument : public Document
 {
@@ -88,9 +100,28 @@ public:
     bool hasUtf8Bom() const;
 
     QPlainTextEdit *textEdit() const;
+    QTextDocument *textDocument() const;
+
+    // Same as text(), but not logged: to be used internally instead of text() or QTextDocument::toPlainText()
+    QString plainText() const;
+    // Incremented each time the text changes
+    int textRevision() const;
+
+    // Propagates the changes done so far in the current transaction, if any. To be called before using anything
+    // derived from the text by changeContent (syntax tree, LSP...).
+    void flushTransaction();
+
+    // Replaces the QTextDocument undo stack with a journal of reverse diffs, capped to `maxSteps` undo steps and
+    // `maxSize` characters of text kept to undo them. Each transaction is one undo step.
+    void enableUndoJournal(int maxSteps, qsizetype maxSize);
+
+    QTextCursor textCursor() const;
+    void setTextCursor(const QTextCursor &cursor);
 
     QString tab() const;
 
+    MemoryUsage memoryUsage() const override;
+
 public slots:
     void setPosition(int newPosition);
     void setText(const QString &newText);
@@ -150,6 +181,11 @@ public slots:
     void replace(int length, const QString &text);
     void replace(int from, int to, const QString &text);
     void replace(const Core::TextRange &range, const QString &text);
+    bool replaceRanges(const Core::RangeMarkList &ranges, const QStringList &texts);
+
+    // Transaction
+    void beginTransaction();
+    void commit();
 
     // Deletion
     void deleteLine(int line = -1);
@@ -190,6 +226,7 @@ public slots:
     // Indentation
     void indent(int count = 1);
     void removeIndent(int count = 1);
+    int reindentRange(const Core::RangeMark &range, int levels);
     QString indentationAtPosition(int pos);
 
 signals:
@@ -203,8 +240,11 @@ protected:
 
     bool doSave(const QString &fileName) override;
     bool doLoad(const QString &fileName) override;
+    bool doDryRunSave(const QString &fileName) override;
 
     friend MarkPrivate;
+    friend MarkPositions;
+    friend RangeMarkPrivate;
     void convertPosition(int pos, int *line, int *column) const;
     int position(QTextCursor::MoveOperation operation, int pos) const;
 
@@ -213,8 +253,25 @@ protected:
     int replaceAllRegexp(const QString &regexp, const QString &after, int options,
                          const std::function<bool(QTextCursor)> &filterAcceptsCursor);
 
+    // Called after each change of the text, or once per transaction with all the changes merged
+    virtual void changeContent(int position, int charsRemoved, int charsAdded);
+    // Applies the replacements, sorted and not overlapping, as one edit
+    void applyReplacements(const std::vector<TextReplacement> &replacements, bool moveCursor = true);
+
 private:
-    void detectFormat(const QByteArray &data);
+    friend class Project;
+
+    int replaceAllInOnePass(const QString &before, const QString &after, int options,
+                            const std::function<bool(QTextCursor)> &filterAcceptsCursor);
+    QTextCursor findLiteral(const QString &text, int options) const;
+    void setFormat(const Utils::DecodedText &decoded);
+    void createTextEdit();
+    void setPlainText(const QString &text);
+    void ensureLoaded() const;
+    void recordUndo(int from, int charsRemoved, int charsAdded);
+    // Writes the text to the file, from any thread as long as the document isn't changed meanwhile
+    bool writeFile(const QString &fileName, QString &error) const;
+    void updateCursorState();
 
     void movePosition(QTextCursor::MoveOperation operation, QTextCursor::MoveMode mode = QTextCursor::MoveAnchor,
                       int count = 1);
@@ -226,11 +283,46 @@ private:
                 return true;
             }) -> std::optional<std::pair<QRegularExpressionMatch, QTextCursor>>;
 
-    // TODO: use a QTextDocument maybe, to avoid creating a widget
-    // The QPlainTextEdit has a nicer API, so it's slightly easier with that now
-    QPointer<QPlainTextEdit> m_document;
+    QTextDocument *m_textDocument = nullptr;
+    int m_textRevision = 0;
+    // Text of the document at m_plainTextRevision, shared with all the callers of plainText until the next change
+    mutable QString m_plainText;
+    mutable int m_plainTextRevision = -1;
+    // False when the text loaded from the file is only in m_plainText, and not yet in the QTextDocument
+    bool m_isLoaded = true;
+    // Set while applying several changes as one edit, so the marks are updated for each of them
+    const TextChanges *m_pendingChanges = nullptr;
+    // Changes done in a transaction, merged in one change: the position and added characters are in the current text,
+    // the removed characters in the text before the transaction
+    struct TransactionChange
+    {
+        int position;
+        int charsRemoved;
+        int charsAdded;
+    };
+    int m_transactionLevel = 0;
+    // Identifies the current top-level transaction, to merge all its changes in one undo step
+    int m_transactionGroup = 0;
+    std::optional<TransactionChange> m_transactionChange;
+    // Only set when enabled in the settings, otherwise the QTextDocument undo stack is used
+    std::unique_ptr<UndoJournal> m_undoJournal;
+    // All the marks of the document, updated at once when the text changes
+    std::unique_ptr<MarkTable> m_markTable;
+    std::unique_ptr<LineIndex> m_lineIndex;
+    // Cursor used when there's no editor, and kept in sync with the editor cursor otherwise
+    QTextCursor m_cursor;
+    int m_lastPosition = 0;
+    int m_lastAnchor = 0;
+    // The editor is only created on demand, when the GUI needs to display the document
+    mutable QPointer<QPlainTextEdit> m_textEdit;
     LineEnding m_lineEnding = NativeLineEnding;
     bool m_utf8Bom = false;
+    // Encoding of the file when it's not UTF-8
+    QString m_encoding;
+    // Text read ahead by the project, used by the next doLoad instead of reading the file
+    std::unique_ptr<Utils::DecodedText> m_prefetchedText;
+    // Changes from the current text to m_prefetchedText, computed ahead by the project when reloading the document
+    std::unique_ptr<std::vector<TextReplacement>> m_reloadReplacements;
 };
 
 } // namespace Core
@@ -12,7 +12,16 @@
 
 #include "utils/json.h"
 
+#include <QString>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <vector>
+
 class QPlainTextEdit;
+class QRegularExpressionMatch;
+class QTextCursor;
+class QTextDocument;
 
 namespace Core {
 
@@ -25,7 +34,119 @@ struct TabSettings
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(TabSettings, insertSpaces, tabSize);
 
+void indentTextInTextCursor(QTextCursor &cursor, int tabCount);
+void gotoLineInTextCursor(QTextCursor &cursor, int line, int column = 1);
+
+// Same conversions as QTextDocument::setPlainText followed by QTextDocument::toPlainText
+QString toDocumentText(QString text);
+
 void indentTextInTextEdit(QPlainTextEdit *textEdit, int tabCount);
 void gotoLineInTextEdit(QPlainTextEdit *textEdit, int line, int column = 1);
 
+struct TextReplacement
+{
+    int start;
+    int end;
+    QString text;
+};
+
+//! Store the undo journal settings, see TextDocument::enableUndoJournal
+struct UndoJournalSettings
+{
+    bool enabled = false;
+    int maxSteps = 1000;
+    qsizetype maxSize = 10'000'000;
+};
+
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(UndoJournalSettings, enabled, maxSteps, maxSize);
+
+using MatchFunction = std::function<void(qsizetype start, qsizetype end, const QRegularExpressionMatch *match)>;
+
+// Calls `onMatch` for each occurrence of `pattern` in `text`, found forward and line by line like TextDocument::find
+// with the TextDocument::FindFlags `options`. The match is only set for a regexp search. Only uses the text, so it can
+// be called from any thread.
+void forEachMatch(QStringView text, const QString &pattern, int options, const MatchFunction &onMatch);
+
+// Finds all the occurrences of `before` in `text`, forward and line by line like TextDocument::find, and computes
+// their replacement with the TextDocument::FindFlags `options`. `filterAccepts` is called with the start and end of
+// each occurrence, if set.
+std::vector<TextReplacement> findReplacements(const QString &text, const QString &before, const QString &after,
+                                              int options, const std::function<bool(int, int)> &filterAccepts = {});
+
+// Returns the replacements of the lines changed between oldText and newText, found with a line diff, without the
+// start and end of the lines that are the same. Only uses the texts, so it can be called from any thread.
+std::vector<TextReplacement> diffReplacements(const QString &oldText, const QString &newText);
+
+// Start position of each line of a document, to convert positions to lines and back with a binary search.
+// It's updated with each change of the document, only visiting the blocks of the added text, and rebuilt from all the
+// blocks on the next use when a change can't be applied.
+class LineIndex
+{
+public:
+    explicit LineIndex(QTextDocument *document);
+
+    void update(int from, int charsRemoved, int charsAdded);
+
+    // Returns the 0-based line of the position, or -1 if the position is outside of the document
+    int lineAt(int position);
+    // Returns the position of the start of the 0-based line, or -1 if there's no such line
+    int lineStart(int line);
+
+    qint64 memorySize() const { return static_cast<qint64>(m_lineStarts.capacity() * sizeof(int)); }
+
+private:
+    void build();
+
+    QTextDocument *m_document;
+    std::vector<int> m_lineStarts;
+    // Character count of the document when indexed, including the last paragraph separator
+    int m_characterCount = 0;
+    bool m_isValid = false;
+};
+
+// Undo history stored as reverse diffs, instead of the full block data kept by the QTextDocument undo stack.
+// A step is one change of the document, or all the changes with the same non-zero group (a transaction). The oldest
+// steps are dropped when there are more than maxSteps, or when the text kept by all the steps is over maxSize.
+class UndoJournal
+{
+public:
+    // Replaces `length` characters at `position` with `text`
+    struct Change
+    {
+        int position;
+        int length;
+        QString text;
+    };
+    using Step = std::vector<Change>;
+    using ApplyFunction = std::function<void(const Change &)>;
+
+    UndoJournal(int maxSteps, qsizetype maxSize);
+
+    // Records the change reverting the last edit. While undoing or redoing, it's part of the step to redo or undo it.
+    void record(Change change, int group);
+    // Applies the changes of the last step in reverse order, the changes recorded meanwhile can then redo it
+    bool undo(const ApplyFunction &apply);
+    bool redo(const ApplyFunction &apply);
+    void clear();
+
+    qint64 memorySize() const;
+
+private:
+    struct Entry
+    {
+        Step step;
+        int group = 0;
+        qsizetype size = 0;
+    };
+    bool replay(std::deque<Entry> &from, std::deque<Entry> &to, const ApplyFunction &apply);
+    void trim();
+
+    int m_maxSteps;
+    qsizetype m_maxSize;
+    std::deque<Entry> m_undoSteps;
+    std::deque<Entry> m_redoSteps;
+    qsizetype m_size = 0;
+    std::optional<Entry> m_replayEntry;
+};
+
 } // namespace Core
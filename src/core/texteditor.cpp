@@ -70,7 +70,17 @@ void TextEditor::updateCurrentLine()
     if (m_currentLine == textCursor().blockNumber())
         return;
     m_currentLine = textCursor().blockNumber();
+    updateExtraSelections();
+}
 
+void TextEditor::setHighlightSelections(QList<QTextEdit::ExtraSelection> selections)
+{
+    m_highlightSelections = std::move(selections);
+    updateExtraSelections();
+}
+
+void TextEditor::updateExtraSelections()
+{
     QList<QTextEdit::ExtraSelection> extraSelections;
     QTextEdit::ExtraSelection selection;
     selection.format.setBackground(palette().alternateBase());
@@ -78,6 +88,7 @@ void TextEditor::updateCurrentLine()
     selection.cursor = textCursor();
     selection.cursor.clearSelection();
     extraSelections.append(selection);
+    extraSelections.append(m_highlightSelections);
     setExtraSelections(extraSelections);
 }
 
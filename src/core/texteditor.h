@@ -23,6 +23,9 @@ class TextEditor : public QPlainTextEdit
 public:
     explicit TextEditor(QWidget *parent = nullptr);
 
+    // Extra selections shown on top of the current line, like the matches of a search
+    void setHighlightSelections(QList<QTextEdit::ExtraSelection> selections);
+
 protected:
     void resizeEvent(QResizeEvent *) override;
 
@@ -30,12 +33,14 @@ private:
     void updateGutterWidth(int);
     void updateGutter(const QRect &rect, int dy);
     void updateCurrentLine();
+    void updateExtraSelections();
 
 private:
     friend class Gutter;
 
     Gutter *const m_gutter;
     int m_currentLine = -1;
+    QList<QTextEdit::ExtraSelection> m_highlightSelections;
 };
 
 }
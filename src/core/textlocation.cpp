@@ -27,15 +27,38 @@ namespace Core {
 /*!
  * \qmlproperty CodeDocument TextLocation::document
  * This read-only property contains the source document for this text location.
+ *
+ * The document is opened when this property is read, if it's not opened yet.
+ */
+/*!
+ * \qmlproperty string TextLocation::fileName
+ * This read-only property contains the file name of the source document, without opening the document.
  */
 /*!
  * \qmlproperty TextRange TextLocation::range
  * This read-only property contains the range of text in the document.
  */
 
+LazyCodeDocument::LazyCodeDocument(CodeDocument *document)
+    : m_fileName(document ? document->fileName() : QString())
+{
+}
+
+LazyCodeDocument::LazyCodeDocument(QString fileName)
+    : m_fileName(std::move(fileName))
+{
+}
+
+CodeDocument *LazyCodeDocument::get() const
+{
+    if (m_fileName.isEmpty() || !Project::instance())
+        return nullptr;
+    return qobject_cast<CodeDocument *>(Project::instance()->get(m_fileName));
+}
+
 QString TextLocation::toString() const
 {
-    return QString("{'%1', %2}").arg(document->fileName(), range.toString());
+    return QString("{'%1', %2}").arg(document.fileName(), range.toString());
 }
 
 } // namespace Core
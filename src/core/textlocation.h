@@ -13,21 +13,51 @@
 #include "textrange.h"
 
 #include <QObject>
+#include <QString>
+#include <compare>
 
 namespace Core {
 
 class CodeDocument;
 
+// Document of a TextLocation, kept by file name: the document is only opened by the project when it's accessed
+class LazyCodeDocument
+{
+public:
+    LazyCodeDocument() = default;
+    LazyCodeDocument(CodeDocument *document);
+    explicit LazyCodeDocument(QString fileName);
+
+    const QString &fileName() const { return m_fileName; }
+    CodeDocument *get() const;
+
+    operator CodeDocument *() const { return get(); }
+    CodeDocument *operator->() const { return get(); }
+
+    bool operator==(const LazyCodeDocument &other) const { return m_fileName == other.m_fileName; }
+    std::strong_ordering operator<=>(const LazyCodeDocument &other) const
+    {
+        return QString::compare(m_fileName, other.m_fileName) <=> 0;
+    }
+
+private:
+    QString m_fileName;
+};
+
 struct TextLocation
 {
     Q_GADGET
-    Q_PROPERTY(Core::CodeDocument *document MEMBER document CONSTANT)
+    Q_PROPERTY(Core::CodeDocument *document READ codeDocument CONSTANT)
+    Q_PROPERTY(QString fileName READ fileName CONSTANT)
     Q_PROPERTY(Core::TextRange range MEMBER range CONSTANT)
 
 public:
-    CodeDocument *document;
+    LazyCodeDocument document;
     TextRange range;
 
+    CodeDocument *codeDocument() const { return document.get(); }
+    QString fileName() const { return document.fileName(); }
+
     Q_INVOKABLE QString toString() const;
 
     auto operator<=>(const TextLocation &) const = default;
@@ -9,6 +9,8 @@
 */
 
 #include "userdialog.h"
+#include "settings.h"
+#include "utils/log.h"
 
 #include <QApplication>
 #include <QFileDialog>
@@ -34,8 +36,20 @@ namespace Core {
  * else
  *     Message.log("Cancelled")
  * ````
+ *
+ * `knut-cli` can't show any dialog: the methods returning a value return `null`, like a cancelled dialog, and the
+ * messages are logged.
  */
 
+// Returns false, after logging an error, in knut-cli where there's no widget
+static bool canShowDialog(const char *method)
+{
+    if (Settings::hasWidgets())
+        return true;
+    spdlog::error("{} - no dialog can be shown without the user interface", method);
+    return false;
+}
+
 UserDialog::UserDialog(QQmlEngine *parent)
     : QObject(parent)
 {
@@ -50,6 +64,8 @@ UserDialog::UserDialog(QQmlEngine *parent)
  */
 QJSValue UserDialog::getOpenFileName(const QString &caption, const QString &dir, const QString &filters)
 {
+    if (!canShowDialog("UserDialog::getOpenFileName"))
+        return QJSValue(QJSValue::NullValue);
     const QString s = QFileDialog::getOpenFileName(dialogParent(), caption, dir, filters);
     if (!s.isEmpty())
         return s;
@@ -65,6 +81,8 @@ QJSValue UserDialog::getOpenFileName(const QString &caption, const QString &dir,
  */
 QJSValue UserDialog::getSaveFileName(const QString &caption, const QString &dir, const QString &filters)
 {
+    if (!canShowDialog("UserDialog::getSaveFileName"))
+        return QJSValue(QJSValue::NullValue);
     const QString s = QFileDialog::getSaveFileName(dialogParent(), caption, dir, filters);
     if (!s.isEmpty())
         return s;
@@ -79,6 +97,8 @@ QJSValue UserDialog::getSaveFileName(const QString &caption, const QString &dir,
  */
 QJSValue UserDialog::getExistingDirectory(const QString &caption, const QString &dir)
 {
+    if (!canShowDialog("UserDialog::getExistingDirectory"))
+        return QJSValue(QJSValue::NullValue);
     const QString s = QFileDialog::getExistingDirectory(dialogParent(), caption, dir);
     if (!s.isEmpty())
         return s;
@@ -98,6 +118,8 @@ QJSValue UserDialog::getExistingDirectory(const QString &caption, const QString
 QJSValue UserDialog::getItem(const QString &title, const QString &label, const QStringList &items, int current,
                              bool editable)
 {
+    if (!canShowDialog("UserDialog::getItem"))
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const QString ret = QInputDialog::getItem(dialogParent(), title, label, items, current, editable, &ok);
     if (ok)
@@ -119,6 +141,8 @@ QJSValue UserDialog::getItem(const QString &title, const QString &label, const Q
 QJSValue UserDialog::getDouble(const QString &title, const QString &label, double value, int decimals, double step,
                                double min, double max)
 {
+    if (!canShowDialog("UserDialog::getDouble"))
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const double ret =
         QInputDialog::getDouble(dialogParent(), title, label, value, min, max, decimals, &ok, Qt::WindowFlags(), step);
@@ -139,6 +163,8 @@ QJSValue UserDialog::getDouble(const QString &title, const QString &label, doubl
 // clang-format on
 QJSValue UserDialog::getInt(const QString &title, const QString &label, int value, int step, int min, int max)
 {
+    if (!canShowDialog("UserDialog::getInt"))
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const int ret = QInputDialog::getInt(dialogParent(), title, label, value, min, max, step, &ok);
     if (ok)
@@ -155,6 +181,8 @@ QJSValue UserDialog::getInt(const QString &title, const QString &label, int valu
  */
 QJSValue UserDialog::getText(const QString &title, const QString &label, const QString &text)
 {
+    if (!canShowDialog("UserDialog::getText"))
+        return QJSValue(QJSValue::NullValue);
     bool ok;
     const QString ret = QInputDialog::getText(dialogParent(), title, label, QLineEdit::Normal, text, &ok);
     if (ok)
@@ -168,6 +196,10 @@ QJSValue UserDialog::getText(const QString &title, const QString &label, const Q
  */
 void UserDialog::information(const QString &title, const QString &text)
 {
+    if (!Settings::hasWidgets()) {
+        spdlog::info("UserDialog::information - {}: {}", title, text);
+        return;
+    }
     QMessageBox::information(dialogParent(), title, text);
 }
 
@@ -177,6 +209,10 @@ void UserDialog::information(const QString &title, const QString &text)
  */
 void UserDialog::warning(const QString &title, const QString &text)
 {
+    if (!Settings::hasWidgets()) {
+        spdlog::warn("UserDialog::warning - {}: {}", title, text);
+        return;
+    }
     QMessageBox::warning(dialogParent(), title, text);
 }
 
@@ -186,6 +222,10 @@ void UserDialog::warning(const QString &title, const QString &text)
  */
 void UserDialog::critical(const QString &title, const QString &text)
 {
+    if (!Settings::hasWidgets()) {
+        spdlog::error("UserDialog::critical - {}: {}", title, text);
+        return;
+    }
     QMessageBox::critical(dialogParent(), title, text);
 }
 
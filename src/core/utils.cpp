@@ -11,14 +11,30 @@
 #include "utils.h"
 #include "logger.h"
 #include "scriptmanager.h"
+#include "settings.h"
 #include "utils/log.h"
+#include "utils/taskscheduler.h"
 
 #include <QApplication>
 #include <QClipboard>
+#include <QCryptographicHash>
 #include <QDir>
-#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
 #include <QFileInfo>
+#include <QJSEngine>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
 #include <QTemporaryFile>
+#include <QTextStream>
+#include <QTimer>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
 
 namespace Core {
 
@@ -40,6 +56,13 @@ Utils::Utils(QObject *parent)
 
 Utils::~Utils() = default;
 
+static std::atomic<bool> ndjsonOutput = false;
+
+void Utils::setNdjsonOutput(bool ndjson)
+{
+    ndjsonOutput = ndjson;
+}
+
 /*!
  * \qmlmethod string Utils::getEnv(string varName)
  * Returns the value of the environment variable `varName`.
@@ -118,16 +141,129 @@ void Utils::runScript(const QString &path, bool log)
 /*!
  * \qmlmethod Utils::sleep(int msecs)
  * Sleeps for `msecs` milliseconds.
+ *
+ * The events are still processed while sleeping, so the user interface and the LSP servers keep running. Use
+ * `delay` or `waitFor` to wait for something to happen.
  */
 void Utils::sleep(int msecs)
 {
     LOG("Utils::sleep", msecs);
 
-    QElapsedTimer timer;
-    timer.start();
-    while (timer.elapsed() < msecs) {
-        qApp->processEvents(QEventLoop::AllEvents, 100);
+    // The local event loop waits for the next event, instead of polling them
+    QEventLoop loop;
+    QTimer::singleShot(msecs, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+/*!
+ * \qmlmethod Promise Utils::delay(int msecs)
+ * Returns a promise resolved after `msecs` milliseconds, without blocking the script.
+ *
+ * ```
+ * Utils.delay(100).then(() => console.log("done"))
+ * ```
+ */
+QJSValue Utils::delay(int msecs)
+{
+    LOG("Utils::delay", msecs);
+
+    auto engine = qjsEngine(this);
+    Q_ASSERT(engine);
+    if (m_createDeferred.isUndefined()) {
+        m_createDeferred = engine->evaluate(QStringLiteral(
+            "(function() { let deferred = {}; deferred.promise = new Promise(resolve => deferred.resolve = resolve); "
+            "return deferred; })"));
     }
+
+    const auto deferred = m_createDeferred.call();
+    QTimer::singleShot(msecs, this, [resolve = deferred.property("resolve")]() mutable {
+        resolve.call();
+    });
+    return deferred.property("promise");
+}
+
+/*!
+ * \qmlmethod bool Utils::waitFor(signal signal, int timeout = -1)
+ * Waits until `signal` is emitted, or until `timeout` milliseconds have passed. Returns true if the signal was
+ * emitted. A negative `timeout` waits forever.
+ *
+ * The events are processed while waiting, without using the processor.
+ *
+ * ```
+ * process.start()
+ * if (!Utils.waitFor(process.finished, 5000))
+ *     console.log("timeout")
+ * ```
+ */
+bool Utils::waitFor(const QJSValue &signal, int timeout)
+{
+    LOG("Utils::waitFor", timeout);
+
+    auto connect = signal.property("connect");
+    auto disconnect = signal.property("disconnect");
+    if (!connect.isCallable() || !disconnect.isCallable()) {
+        spdlog::error("Utils::waitFor - the parameter is not a signal");
+        return false;
+    }
+
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    // The signal is connected to a javascript function quitting the event loop
+    auto engine = qjsEngine(this);
+    QJSEngine::setObjectOwnership(&loop, QJSEngine::CppOwnership);
+    auto quit = engine->evaluate(QStringLiteral("(function(loop) { return function() { loop.quit() } })"))
+                    .call({engine->newQObject(&loop)});
+    connect.callWithInstance(signal, {quit});
+
+    if (timeout >= 0)
+        timer.start(timeout);
+    loop.exec();
+    disconnect.callWithInstance(signal, {quit});
+
+    return timeout < 0 || timer.isActive();
+}
+
+/*!
+ * \qmlmethod Utils::emitRecord(var record)
+ * Outputs `record` as one line of JSON.
+ *
+ * Running the script with `knut --run <script> --output ndjson`, the records are written to the standard output as
+ * they are emitted, one per line (newline-delimited JSON), while the logs go to the standard error. Tools reading
+ * the output can process the results of a large analysis as they come, instead of the script collecting them all
+ * first. Otherwise, the records are logged.
+ *
+ * ```js
+ * for (const fileName of Project.allFiles()) {
+ *     for (const include of Project.includes(fileName))
+ *         Utils.emitRecord({file: fileName, include: include})
+ * }
+ * ```
+ */
+void Utils::emitRecord(const QJSValue &record)
+{
+    LOG("Utils::emitRecord");
+
+    if (m_stringify.isUndefined()) {
+        auto engine = qjsEngine(this);
+        Q_ASSERT(engine);
+        m_stringify = engine->globalObject().property("JSON").property("stringify");
+    }
+    // Same as JSON.stringify in the script, undefined and functions give null
+    const auto json = m_stringify.call({record});
+    const QByteArray line = json.isString() ? json.toString().toUtf8() : QByteArrayLiteral("null");
+
+    if (!ndjsonOutput) {
+        spdlog::info("Utils::emitRecord - {}", std::string_view(line.constData(), line.size()));
+        return;
+    }
+    // Records may come from the scripts of Utils.parallelMap, each line is written at once
+    static std::mutex mutex;
+    std::lock_guard lock(mutex);
+    std::cout.write(line.constData(), line.size());
+    std::cout << '\n' << std::flush;
 }
 
 /*!
@@ -179,6 +315,18 @@ QString Utils::convertCase(const QString &str, Case from, Case to)
     return ::Utils::convertCase(str, static_cast<::Utils::Case>(from), static_cast<::Utils::Case>(to));
 }
 
+/*!
+ * \qmlmethod array<string> Utils::convertCaseMany(array<string> strings, Case from, Case to)
+ * Converts all the strings of `strings` from the case `from` to the case `to`, and returns them in the same order.
+ *
+ * It's the same as calling `convertCase` on each string, but with only one call: use it to convert many identifiers.
+ */
+QStringList Utils::convertCaseMany(const QStringList &strings, Case from, Case to)
+{
+    LOG("Utils::convertCaseMany", strings, from, to);
+    return ::Utils::convertCase(strings, static_cast<::Utils::Case>(from), static_cast<::Utils::Case>(to));
+}
+
 /*!
  * \qmlmethod string Utils::copyToClipboard(string text)
  * Copy the text to the clipboard
@@ -303,4 +451,141 @@ QStringList Utils::cppPrimitiveTypes()
                         "char", "char8_t", "char16_t", "char32_t", "wchar_t"};
 }
 
+/*!
+ * \qmlmethod array Utils::parallelMap(array<string> fileNames, string scriptFile, var args)
+ * Runs the `map` function exported by the javascript module `scriptFile` on each file of `fileNames`, in parallel,
+ * and returns the results in the same order.
+ *
+ * The function is called with the file name, the file content and `args`: `map(fileName, text, args)`. Each worker
+ * thread has its own javascript engine, without access to the Knut API, so the function should only work on its
+ * arguments. `args` and the results must be serializable to json. The result for a file is `null` if the function
+ * throws an exception.
+ *
+ * ```js
+ * // count.mjs
+ * export function map(fileName, text, args) {
+ *     return text.split(args.separator).length
+ * }
+ *
+ * // script
+ * let counts = Utils.parallelMap(files, Dir.currentScriptPath + "/count.mjs", {separator: "\n"})
+ * ```
+ */
+QVariantList Utils::parallelMap(const QStringList &fileNames, const QString &scriptFile, const QVariant &args)
+{
+    LOG("Utils::parallelMap", fileNames, scriptFile);
+
+    const auto moduleFile = QFileInfo(scriptFile).absoluteFilePath();
+    if (!QFileInfo::exists(moduleFile)) {
+        spdlog::error("Utils::parallelMap - the script {} doesn't exist", scriptFile);
+        return {};
+    }
+
+    std::vector<QVariant> results(fileNames.size(), QVariant::fromValue(nullptr));
+    std::atomic<qsizetype> nextIndex = 0;
+    std::atomic<bool> moduleError = false;
+
+    // Each worker creates its engine once, then takes the next file until there's none left
+    auto work = [&]() {
+        QJSEngine engine;
+        engine.installExtensions(QJSEngine::ConsoleExtension);
+        const auto module = engine.importModule(moduleFile);
+        const auto map = module.property("map");
+        if (module.isError() || !map.isCallable()) {
+            if (!moduleError.exchange(true))
+                spdlog::error("Utils::parallelMap - {} doesn't export a map function: {}", scriptFile,
+                              module.toString());
+            return;
+        }
+        const auto argsValue = engine.toScriptValue(args);
+
+        for (qsizetype index = nextIndex++; index < fileNames.size(); index = nextIndex++) {
+            const auto &fileName = fileNames[index];
+            QString text;
+            QFile file(fileName);
+            if (file.open(QFile::ReadOnly | QIODevice::Text))
+                text = QTextStream(&file).readAll();
+
+            const auto result = map.call({fileName, text, argsValue});
+            if (result.isError())
+                spdlog::error("Utils::parallelMap - {}: {}", fileName, result.toString());
+            else
+                results[index] = result.toVariant();
+        }
+    };
+
+    Utils::TaskGroup tasks;
+    const int workerCount = std::min<qsizetype>(Utils::TaskScheduler::threadCount(), fileNames.size());
+    for (int i = 0; i < workerCount; ++i)
+        tasks.start(work);
+    tasks.wait();
+
+    return QVariantList(results.begin(), results.end());
+}
+
+/*!
+ * \qmlmethod var Utils::cache(string key, string inputsHash, function fn)
+ * Returns the result of `fn` for `key`, stored in the project cache across runs.
+ *
+ * `fn` is only called if there's no result stored for `key`, or if it was stored with a different `inputsHash`. The
+ * `inputsHash` identifies the inputs used by `fn`, like the hash of the files it reads with `Project.fileHash`. The
+ * result must be serializable to json.
+ *
+ * The results are stored in the `.knut/cache` directory of the project. Without a project, or when testing, `fn` is
+ * always called.
+ *
+ * ```js
+ * let classes = Utils.cache("classes:" + fileName, Project.fileHash(fileName), () => {
+ *     return Project.get(fileName).classes().map(symbol => symbol.name)
+ * })
+ * ```
+ * \sa Project::fileHash
+ */
+QVariant Utils::cache(const QString &key, const QString &inputsHash, const QJSValue &function)
+{
+    LOG("Utils::cache", key, inputsHash);
+
+    auto computeValue = [&function, &key]() -> std::optional<QVariant> {
+        const auto result = function.call();
+        if (result.isError()) {
+            spdlog::error("Utils::cache {} - {}", key, result.toString());
+            return {};
+        }
+        return result.toVariant();
+    };
+
+    const auto cachePath = Settings::instance()->cachePath();
+    if (cachePath.isEmpty())
+        return computeValue().value_or(QVariant());
+
+    // Keys can be any string, the file is named after their hash
+    const auto keyHash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    const QString fileName = cachePath + "/scripts/" + QString::fromLatin1(keyHash) + ".json";
+
+    QFile file(fileName);
+    if (file.open(QIODevice::ReadOnly)) {
+        const auto entry = QJsonDocument::fromJson(file.readAll()).object();
+        if (entry.value("key").toString() == key && entry.value("inputsHash").toString() == inputsHash)
+            return entry.value("value").toVariant();
+        file.close();
+    }
+
+    const auto value = computeValue();
+    if (!value)
+        return {};
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile saveFile(fileName);
+    if (saveFile.open(QIODevice::WriteOnly)) {
+        const QJsonObject entry {{"key", key},
+                                 {"inputsHash", inputsHash},
+                                 {"value", QJsonValue::fromVariant(*value)}};
+        saveFile.write(QJsonDocument(entry).toJson(QJsonDocument::Compact));
+        saveFile.commit();
+    }
+    if (saveFile.error() != QFileDevice::NoError)
+        spdlog::warn("Utils::cache {} - can't write {}", key, fileName);
+    return *value;
+}
+
 } // namespace Core
@@ -13,7 +13,9 @@
 #include "utils/string_helper.h"
 
 #include <QHash>
+#include <QJSValue>
 #include <QObject>
+#include <QVariant>
 
 namespace Core {
 
@@ -35,6 +37,14 @@ public:
     explicit Utils(QObject *parent = nullptr);
     ~Utils() override;
 
+    Q_INVOKABLE QJSValue delay(int msecs);
+    Q_INVOKABLE bool waitFor(const QJSValue &signal, int timeout = -1);
+    // `emit` is a Qt keyword, so the method can't be named after it
+    Q_INVOKABLE void emitRecord(const QJSValue &record);
+
+    // With --output ndjson, the records are written to stdout instead of the log
+    static void setNdjsonOutput(bool ndjson);
+
 public slots:
     static QString getEnv(const QString &varName);
 
@@ -49,6 +59,7 @@ public slots:
     static QString mktemp(const QString &pattern);
 
     static QString convertCase(const QString &str, Case from, Case to);
+    static QStringList convertCaseMany(const QStringList &strings, Case from, Case to);
 
     static void copyToClipboard(const QString &text);
 
@@ -56,8 +67,18 @@ public slots:
 
     static QStringList cppPrimitiveTypes();
 
+    static QVariantList parallelMap(const QStringList &fileNames, const QString &scriptFile,
+                                    const QVariant &args = {});
+
+    static QVariant cache(const QString &key, const QString &inputsHash, const QJSValue &function);
+
 private:
     static QHash<QString, QString> m_globals;
+
+    // Function returning a {promise, resolve} object, created once per engine
+    QJSValue m_createDeferred;
+    // JSON.stringify of the engine
+    QJSValue m_stringify;
 };
 
 } // namespace Core
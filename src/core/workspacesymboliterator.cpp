@@ -0,0 +1,174 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "workspacesymboliterator.h"
+#include "lsp/client.h"
+#include "lsp_utils.h"
+#include "utils/cancellation.h"
+
+#include <QEventLoop>
+#include <algorithm>
+
+namespace Core {
+
+/*!
+ * \qmltype WorkspaceSymbolIterator
+ * \brief Iterates over the symbols of the project found by the LSP servers, as they arrive.
+ * \inqmlmodule Script
+ * \ingroup CodeDocument
+ * \sa Project::workspaceSymbols
+ *
+ * The servers stream their results when they can: the first symbols are returned while the servers are still
+ * searching the others. Each symbol is an [IndexedSymbol](indexedsymbol.md), whose range is read from the file
+ * without opening it:
+ *
+ * ```js
+ * let it = Project.workspaceSymbols("MainWindow");
+ * while (it.hasNext()) {
+ *     let symbol = it.next();
+ *     Message.log(symbol.qualifiedName + " in " + symbol.fileName);
+ * }
+ * ```
+ *
+ * The servers only return the symbols matching the query best, clangd returns at most 100 symbols by default.
+ */
+
+WorkspaceSymbolIterator::WorkspaceSymbolIterator(const QString &query, const std::vector<Lsp::Client *> &clients)
+{
+    m_searches.resize(clients.size());
+    for (size_t i = 0; i < clients.size(); ++i) {
+        auto client = clients[i];
+        m_searches[i].client = client;
+        // Don't wait forever for a server which has stopped
+        connect(client, &Lsp::Client::stateChanged, this, [this, i](Lsp::Client::State state) {
+            if (state != Lsp::Client::Initialized && state != Lsp::Client::Initializing)
+                finishSearch(i);
+        });
+        auto addResults = [this, i](std::vector<Lsp::SymbolInformation> symbols, bool done) {
+            addSymbols(std::move(symbols));
+            if (done)
+                finishSearch(i);
+            else
+                emit symbolsReceived();
+        };
+        m_searches[i].id = client->workspaceSymbol(query.toStdString(), addResults);
+    }
+}
+
+WorkspaceSymbolIterator::~WorkspaceSymbolIterator()
+{
+    for (const auto &search : m_searches) {
+        if (!search.done && search.client)
+            search.client->cancelWorkspaceSymbol(search.id);
+    }
+}
+
+IndexedSymbolList WorkspaceSymbolIterator::toIndexedSymbols(std::vector<Lsp::SymbolInformation> &&symbols,
+                                                            QSet<QString> &found)
+{
+    std::vector<Lsp::Location> locations;
+    locations.reserve(symbols.size());
+    for (const auto &symbol : symbols)
+        locations.push_back(symbol.location);
+    auto textLocations = Utils::lspToTextLocations(locations);
+
+    IndexedSymbolList result;
+    for (size_t i = 0; i < symbols.size(); ++i) {
+        auto &location = textLocations[i];
+        if (!location)
+            continue;
+        auto &symbol = symbols[i];
+        const QString name = QString::fromStdString(symbol.name);
+        const QString key = QString("%1:%2:%3").arg(location->fileName()).arg(location->range.start).arg(name);
+        if (found.contains(key))
+            continue;
+        found.insert(key);
+        result.push_back({.name = name,
+                          .scope = QString::fromStdString(symbol.containerName.value_or(std::string())),
+                          .kind = static_cast<Symbol::Kind>(symbol.kind),
+                          .fileName = location->fileName(),
+                          .range = location->range,
+                          .selectionRange = location->range});
+    }
+    return result;
+}
+
+void WorkspaceSymbolIterator::addSymbols(std::vector<Lsp::SymbolInformation> &&symbols)
+{
+    auto result = toIndexedSymbols(std::move(symbols), m_found);
+    m_symbols.insert(m_symbols.end(), std::make_move_iterator(result.begin()), std::make_move_iterator(result.end()));
+}
+
+IndexedSymbolList WorkspaceSymbolIterator::cachedSymbols(const QString &query,
+                                                         const std::vector<Lsp::Client *> &clients)
+{
+    QSet<QString> found;
+    IndexedSymbolList result;
+    for (auto client : clients) {
+        if (client->state() == Lsp::Client::Initialized)
+            result.append(toIndexedSymbols(client->cachedWorkspaceSymbols(query.toStdString()), found));
+    }
+    return result;
+}
+
+void WorkspaceSymbolIterator::finishSearch(size_t index)
+{
+    if (m_searches[index].done)
+        return;
+    m_searches[index].done = true;
+    emit symbolsReceived();
+}
+
+bool WorkspaceSymbolIterator::isDone() const
+{
+    return std::ranges::all_of(m_searches, [](const Search &search) {
+        return search.done || !search.client;
+    });
+}
+
+/*!
+ * \qmlmethod bool WorkspaceSymbolIterator::hasNext()
+ * Returns true if there's another symbol, waiting for the servers to send it if needed.
+ */
+bool WorkspaceSymbolIterator::hasNext()
+{
+    if (!m_symbols.empty() || isDone())
+        return !m_symbols.empty();
+
+    // The results are read by the event loop, which is left as soon as new symbols arrive
+    QEventLoop loop;
+    connect(this, &WorkspaceSymbolIterator::symbolsReceived, &loop, &QEventLoop::quit);
+    ::Utils::Cancellation::quitOnCancel(loop);
+    while (m_symbols.empty() && !isDone() && !::Utils::Cancellation::isCanceled())
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    return !m_symbols.empty();
+}
+
+/*!
+ * \qmlmethod IndexedSymbol WorkspaceSymbolIterator::next()
+ * Returns the next symbol, or an empty symbol once all the symbols have been returned.
+ */
+IndexedSymbol WorkspaceSymbolIterator::next()
+{
+    if (!hasNext())
+        return {};
+    auto symbol = std::move(m_symbols.front());
+    m_symbols.pop_front();
+    return symbol;
+}
+
+IndexedSymbolList WorkspaceSymbolIterator::takeReceived()
+{
+    IndexedSymbolList symbols(std::make_move_iterator(m_symbols.begin()), std::make_move_iterator(m_symbols.end()));
+    m_symbols.clear();
+    return symbols;
+}
+
+} // namespace Core
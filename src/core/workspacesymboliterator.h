@@ -0,0 +1,70 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "lsp/types.h"
+#include "symbolindex.h"
+
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <deque>
+#include <vector>
+
+namespace Lsp {
+class Client;
+}
+
+namespace Core {
+
+class WorkspaceSymbolIterator : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Sends the query to all the clients, the results are merged
+    WorkspaceSymbolIterator(const QString &query, const std::vector<Lsp::Client *> &clients);
+    ~WorkspaceSymbolIterator() override;
+
+    Q_INVOKABLE bool hasNext();
+    Q_INVOKABLE Core::IndexedSymbol next();
+
+    // Returns the symbols received and not returned yet, without waiting for the servers
+    IndexedSymbolList takeReceived();
+    // True once all the servers have sent their results
+    bool isDone() const;
+
+    // Returns the symbols matching query from the results cached for a shorter query, see Lsp::Client
+    static IndexedSymbolList cachedSymbols(const QString &query, const std::vector<Lsp::Client *> &clients);
+
+signals:
+    // Emitted when symbols are received, and once all the servers are done
+    void symbolsReceived();
+
+private:
+    // Converts the symbols, skipping the ones already found
+    static IndexedSymbolList toIndexedSymbols(std::vector<Lsp::SymbolInformation> &&symbols, QSet<QString> &found);
+    void addSymbols(std::vector<Lsp::SymbolInformation> &&symbols);
+    void finishSearch(size_t index);
+
+    struct Search
+    {
+        QPointer<Lsp::Client> client;
+        int id = 0;
+        bool done = false;
+    };
+    std::vector<Search> m_searches;
+    std::deque<IndexedSymbol> m_symbols;
+    // The servers of several shards find the symbols of the headers they share
+    QSet<QString> m_found;
+};
+
+} // namespace Core
@@ -12,19 +12,32 @@
 #include "core/logger.h"
 #include "core/project.h"
 #include "core/textdocument.h"
+#include "core/textdocument_p.h"
 #include "guisettings.h"
+#include "textview.h"
 #include "ui_findwidget.h"
+#include "utils/taskscheduler.h"
 
 #include <QAction>
 #include <QKeySequence>
 #include <QPlainTextEdit>
 #include <QTextDocument>
+#include <QTimer>
+#include <algorithm>
 
 namespace Gui {
 
+// Typing in the find line edit restarts the search once the user pauses
+constexpr int FindAllDelay = 50;
+// The text is searched by chunks of lines, so a search is stopped quickly when a new one starts
+constexpr qsizetype FindAllChunkSize = 64 * 1024;
+// Number of matches sent at once to the view
+constexpr size_t FindAllBatchSize = 1000;
+
 FindWidget::FindWidget(QWidget *parent)
     : QWidget(parent)
     , ui(new Ui::FindWidget)
+    , m_findAllTimer(new QTimer(this))
 {
     ui->setupUi(this);
     setProperty("panelWidget", true);
@@ -53,9 +66,23 @@ FindWidget::FindWidget(QWidget *parent)
     connect(ui->replaceEdit, &QLineEdit::returnPressed, this, &FindWidget::replaceOne);
     connect(ui->replaceButton, &QToolButton::pressed, this, &FindWidget::replaceOne);
     connect(ui->replaceAllbutton, &QToolButton::pressed, this, &FindWidget::replaceAll);
+
+    m_findAllTimer->setSingleShot(true);
+    m_findAllTimer->setInterval(FindAllDelay);
+    connect(m_findAllTimer, &QTimer::timeout, this, &FindWidget::startFindAll);
+    auto scheduleFindAll = [this]() {
+        m_findAllTimer->start();
+    };
+    connect(ui->findEdit, &QLineEdit::textChanged, this, scheduleFindAll);
+    for (auto action : {m_matchCase, m_matchWord, m_matchRegexp})
+        connect(action, &QAction::toggled, this, scheduleFindAll);
+    connect(Core::Project::instance(), &Core::Project::currentDocumentChanged, this, scheduleFindAll);
 }
 
-FindWidget::~FindWidget() = default;
+FindWidget::~FindWidget()
+{
+    stopFindAll();
+}
 
 int FindWidget::findFlags() const
 {
@@ -116,6 +143,15 @@ void FindWidget::open()
     m_firstTime = true;
     show();
     ui->findEdit->setFocus(Qt::OtherFocusReason);
+    m_findAllTimer->start();
+}
+
+void FindWidget::hideEvent(QHideEvent *event)
+{
+    m_findAllTimer->stop();
+    stopFindAll();
+    updateCount();
+    QWidget::hideEvent(event);
 }
 
 void FindWidget::find(int options)
@@ -127,6 +163,136 @@ void FindWidget::find(int options)
         textDocument->find(findString(), options);
 }
 
+/**
+ * \brief Searches all the matches of the find line edit in the current document, in the background
+ *
+ * The search is done on the text snapshot of the document, with the same engines as TextDocument::find. The matches are
+ * sent to the view by batches while they are found, so the highlights and the count are updated during the search.
+ * It doesn't use findString, as it's not a search done by the user: nothing is logged.
+ */
+void FindWidget::startFindAll()
+{
+    stopFindAll();
+
+    auto textDocument = qobject_cast<Core::TextDocument *>(Core::Project::instance()->currentDocument());
+    const QString pattern = ui->findEdit->text();
+    if (isHidden() || !textDocument || pattern.isEmpty()) {
+        updateCount();
+        return;
+    }
+
+    m_findAllDocument = textDocument;
+    m_findAllRunning = true;
+    m_cursorConnection =
+        connect(textDocument->textEdit(), &QPlainTextEdit::cursorPositionChanged, this, &FindWidget::updateCount);
+    auto restartFindAll = [this]() {
+        // The matches found meanwhile are for the previous text
+        ++m_findAllGeneration;
+        m_findAllTimer->start();
+    };
+    m_contentsConnection =
+        connect(textDocument->textEdit()->document(), &QTextDocument::contentsChanged, this, restartFindAll);
+
+    m_findAllTasks = std::make_unique<Utils::TaskGroup>(Utils::TaskScheduler::Interactive);
+    auto *tasks = m_findAllTasks.get();
+    const int generation = m_findAllGeneration;
+    const int options = findFlags();
+    tasks->start([this, tasks, generation, text = textDocument->plainText(), pattern, options]() mutable {
+        // Like TextDocument::find, non-breaking spaces are matched as spaces
+        text.replace(QChar::Nbsp, u' ');
+
+        std::vector<Core::TextRange> matches;
+        qsizetype chunkStart = 0;
+        while (chunkStart <= text.size()) {
+            if (tasks->isCancelled())
+                return;
+
+            // A match never spans several lines, so the chunks end on a new line
+            qsizetype chunkEnd = -1;
+            if (chunkStart + FindAllChunkSize < text.size())
+                chunkEnd = text.indexOf(u'\n', chunkStart + FindAllChunkSize);
+            if (chunkEnd == -1)
+                chunkEnd = text.size();
+            Core::forEachMatch(QStringView(text).sliced(chunkStart, chunkEnd - chunkStart), pattern, options,
+                               [&](qsizetype start, qsizetype end, const QRegularExpressionMatch *) {
+                                   matches.push_back({static_cast<int>(chunkStart + start),
+                                                      static_cast<int>(chunkStart + end)});
+                               });
+            chunkStart = chunkEnd + 1;
+
+            const bool finished = chunkStart > text.size();
+            if (finished || matches.size() >= FindAllBatchSize) {
+                QMetaObject::invokeMethod(
+                    this,
+                    [this, generation, matches = std::move(matches), finished]() {
+                        addFindMatches(generation, matches, finished);
+                    },
+                    Qt::QueuedConnection);
+                matches.clear();
+            }
+        }
+    });
+    updateCount();
+}
+
+void FindWidget::stopFindAll()
+{
+    if (m_findAllTasks) {
+        m_findAllTasks->cancel();
+        m_findAllTasks.reset();
+    }
+    ++m_findAllGeneration;
+    m_findAllRunning = false;
+    disconnect(m_cursorConnection);
+    disconnect(m_contentsConnection);
+    if (auto *view = findAllView())
+        view->clearFindMatches();
+    m_findAllDocument = nullptr;
+}
+
+void FindWidget::addFindMatches(int generation, const std::vector<Core::TextRange> &matches, bool finished)
+{
+    if (generation != m_findAllGeneration)
+        return;
+    if (auto *view = findAllView())
+        view->addFindMatches(matches);
+    if (finished)
+        m_findAllRunning = false;
+    updateCount();
+}
+
+// Shows "n of m", n being the match selected in the document, with a "+" while the search is running
+void FindWidget::updateCount()
+{
+    const auto *view = findAllView();
+    if (!view) {
+        ui->countLabel->clear();
+        return;
+    }
+
+    const auto &matches = view->findMatches();
+    const QString total = QString::number(matches.size()) + (m_findAllRunning ? "+" : "");
+    if (matches.empty() && !m_findAllRunning) {
+        ui->countLabel->setText(tr("No results"));
+        return;
+    }
+
+    const QTextCursor cursor = m_findAllDocument->textEdit()->textCursor();
+    const Core::TextRange selection {cursor.selectionStart(), cursor.selectionEnd()};
+    const auto it = std::ranges::lower_bound(matches, selection);
+    if (it != matches.end() && *it == selection)
+        ui->countLabel->setText(tr("%1 of %2").arg(it - matches.begin() + 1).arg(total));
+    else
+        ui->countLabel->setText(tr("%1 matches").arg(total));
+}
+
+TextView *FindWidget::findAllView() const
+{
+    if (!m_findAllDocument)
+        return nullptr;
+    return qobject_cast<TextView *>(m_findAllDocument->textEdit()->parentWidget());
+}
+
 void FindWidget::replaceOne()
 {
     replace(true);
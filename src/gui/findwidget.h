@@ -10,10 +10,24 @@
 
 #pragma once
 
+#include <QPointer>
 #include <QWidget>
+#include <vector>
+
+class QTimer;
+
+namespace Core {
+class TextDocument;
+struct TextRange;
+}
+namespace Utils {
+class TaskGroup;
+}
 
 namespace Gui {
 
+class TextView;
+
 namespace Ui {
     class FindWidget;
 }
@@ -31,6 +45,9 @@ public:
 
     void open();
 
+protected:
+    void hideEvent(QHideEvent *event) override;
+
 private:
     int findFlags() const;
     QString findString();
@@ -40,6 +57,12 @@ private:
     void replaceAll();
     void replace(bool onlyOne);
 
+    void startFindAll();
+    void stopFindAll();
+    void addFindMatches(int generation, const std::vector<Core::TextRange> &matches, bool finished);
+    void updateCount();
+    TextView *findAllView() const;
+
     std::unique_ptr<Ui::FindWidget> ui;
     QAction *m_matchCase = nullptr;
     QAction *m_matchWord = nullptr;
@@ -48,6 +71,16 @@ private:
     QString m_defaultString;
     bool m_isDefaultSelection = false;
     bool m_firstTime = true;
+
+    // Find all, run in the background on the text of the current document
+    QTimer *m_findAllTimer = nullptr;
+    std::unique_ptr<Utils::TaskGroup> m_findAllTasks;
+    QPointer<Core::TextDocument> m_findAllDocument;
+    QMetaObject::Connection m_cursorConnection;
+    QMetaObject::Connection m_contentsConnection;
+    // Changed with each search, to discard the matches of the previous ones
+    int m_findAllGeneration = 0;
+    bool m_findAllRunning = false;
 };
 
 } // namespace Gui
@@ -0,0 +1,57 @@
+; Highlights of C++ documents, see TreeSitterHighlighter.
+; Groups are separated by an empty line and checked one by one, a group using a node unknown to the grammar is
+; skipped. When several captures cover the same text, the last one wins.
+
+(namespace_identifier) @namespace
+
+(type_identifier) @type
+
+[(primitive_type) (sized_type_specifier)] @type.builtin
+
+(function_declarator declarator: (identifier) @function)
+(function_declarator declarator: (field_identifier) @function)
+(function_declarator declarator: (qualified_identifier name: (identifier) @function))
+
+(call_expression function: (identifier) @function)
+(call_expression function: (field_expression field: (field_identifier) @function))
+(call_expression function: (qualified_identifier name: (identifier) @function))
+
+(preproc_def name: (identifier) @constant)
+
+(preproc_function_def name: (identifier) @function)
+
+["#include" "#define" "#if" "#ifdef" "#ifndef" "#else" "#elif" "#endif"] @preproc
+
+(preproc_directive) @preproc
+
+["if" "else" "for" "while" "do" "return" "switch" "case" "default" "break" "continue" "goto"] @keyword.control
+
+["try" "catch" "throw"] @keyword.control
+
+["class" "struct" "enum" "union" "namespace" "template" "typename" "using" "typedef"] @keyword
+
+["public" "private" "protected" "virtual" "friend" "explicit" "operator"] @keyword
+
+["const" "static" "inline" "extern" "volatile" "mutable" "constexpr"] @keyword
+
+["new" "delete" "sizeof"] @keyword
+
+["override" "final"] @keyword
+
+(this) @variable.builtin
+
+(number_literal) @number
+
+[(true) (false)] @boolean
+
+(nullptr) @constant
+
+(char_literal) @character
+
+[(string_literal) (raw_string_literal)] @string
+
+(system_lib_string) @string.special
+
+(escape_sequence) @string.escape
+
+(comment) @comment
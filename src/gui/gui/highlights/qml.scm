@@ -0,0 +1,52 @@
+; Highlights of QML documents, see TreeSitterHighlighter.
+; Groups are separated by an empty line and checked one by one, a group using a node unknown to the grammar is
+; skipped. When several captures cover the same text, the last one wins.
+
+(ui_binding name: (identifier) @property)
+
+(ui_binding name: (nested_identifier) @property)
+
+(ui_property name: (identifier) @property)
+
+(ui_property type: (type_identifier) @type)
+
+(ui_object_definition type_name: (identifier) @type)
+
+(ui_object_definition type_name: (nested_identifier) @type)
+
+(ui_import source: (identifier) @namespace)
+
+(ui_import source: (nested_identifier) @namespace)
+
+(ui_signal name: (identifier) @function)
+
+(function_declaration name: (identifier) @function)
+
+(call_expression function: (identifier) @function)
+(call_expression function: (member_expression property: (property_identifier) @function))
+
+["import" "pragma" "as"] @preproc
+
+["property" "signal" "readonly" "default"] @keyword
+
+["required" "component"] @keyword
+
+["if" "else" "for" "while" "do" "return" "switch" "case" "break" "continue"] @keyword.control
+
+["try" "catch" "finally" "throw"] @keyword.control
+
+["function" "var" "let" "const" "new" "typeof" "instanceof" "in" "of"] @keyword
+
+(this) @variable.builtin
+
+(number) @number
+
+[(true) (false)] @boolean
+
+[(null) (undefined)] @constant
+
+[(string) (template_string)] @string
+
+(escape_sequence) @string.escape
+
+(comment) @comment
@@ -9,10 +9,13 @@
 */
 
 #include "guisettings.h"
+#include "core/codedocument.h"
 #include "core/document.h"
 #include "core/settings.h"
 #include "core/textdocument_p.h"
 #include "knutstyle.h"
+#include "lazysyntaxhighlighter.h"
+#include "treesitterhighlighter.h"
 
 #include <QAction>
 #include <QApplication>
@@ -171,16 +174,25 @@ GuiSettings::ShortcutList GuiSettings::shortcuts() const
     return shortcuts;
 }
 
-static void setupHighlighter(KSyntaxHighlighting::SyntaxHighlighter *highlighter, const QString &theme,
-                             const QString &fileName = {})
+static KSyntaxHighlighting::Repository &repository()
 {
     static KSyntaxHighlighting::Repository repository;
+    return repository;
+}
+
+static KSyntaxHighlighting::Theme highlighterTheme(const QString &theme)
+{
     if (theme.isEmpty())
-        highlighter->setTheme(repository.themeForPalette(QApplication::palette()));
-    else
-        highlighter->setTheme(repository.theme(theme));
+        return repository().themeForPalette(QApplication::palette());
+    return repository().theme(theme);
+}
+
+static void setupHighlighter(KSyntaxHighlighting::SyntaxHighlighter *highlighter, const QString &theme,
+                             const QString &fileName = {})
+{
+    highlighter->setTheme(highlighterTheme(theme));
     if (!fileName.isEmpty()) {
-        const auto def = repository.definitionForFileName(fileName);
+        const auto def = repository().definitionForFileName(fileName);
         highlighter->setDefinition(def);
     }
 }
@@ -191,13 +203,30 @@ KSyntaxHighlighting::SyntaxHighlighter *GuiSettings::initializeTextEdit(QPlainTe
     textEdit->setProperty(IsDocument, true);
     instance()->updateTextEdit(textEdit, instance()->computeTextEditSettings());
 
-    auto highlighter = new KSyntaxHighlighting::SyntaxHighlighter(textEdit->document());
+    auto highlighter = new LazySyntaxHighlighter(textEdit);
     setupHighlighter(highlighter, instance()->m_theme, fileName);
     return highlighter;
 }
 
 void GuiSettings::setupDocumentTextEdit(QPlainTextEdit *textEdit, Core::Document *document)
 {
+    // C++ and QML documents are highlighted from their syntax tree, if the text edit shows the document itself
+    auto codeDocument = qobject_cast<Core::CodeDocument *>(document);
+    if (codeDocument && codeDocument->textDocument() == textEdit->document()
+        && TreeSitterHighlighter::hasHighlights(codeDocument->type())) {
+        textEdit->setProperty(IsDocument, true);
+        instance()->updateTextEdit(textEdit, instance()->computeTextEditSettings());
+
+        auto highlighter = new TreeSitterHighlighter(codeDocument);
+        highlighter->setTheme(highlighterTheme(instance()->m_theme));
+        connect(document, &Core::Document::fileUpdated, highlighter, &QSyntaxHighlighter::rehighlight);
+        // The highlighter belongs to the document, but is only needed by the view, which can be destroyed before
+        connect(textEdit, &QObject::destroyed, highlighter, [highlighter]() {
+            delete highlighter;
+        });
+        return;
+    }
+
     const auto &fileName = document->fileName();
     auto highlighter = initializeTextEdit(textEdit, fileName);
 
@@ -293,6 +322,11 @@ void GuiSettings::updateTheme() const
             setupHighlighter(highlighter, m_theme);
             highlighter->rehighlight();
         }
+        const auto treeSitterHighlighters = topLevel->findChildren<TreeSitterHighlighter *>();
+        for (auto *highlighter : treeSitterHighlighters) {
+            highlighter->setTheme(highlighterTheme(m_theme));
+            highlighter->rehighlight();
+        }
     }
 }
 
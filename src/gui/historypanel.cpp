@@ -10,33 +10,56 @@
 
 #include "historypanel.h"
 #include "core/logger.h"
+#include "core/settings.h"
 #include "guisettings.h"
 
 #include <QAction>
 #include <QHBoxLayout>
 #include <QHeaderView>
+#include <QTimer>
 #include <QToolButton>
 
 namespace Gui {
 
+// Number of rows used to compute the width of the name column, the history can have a lot of rows
+static constexpr int ResizeContentsPrecision = 100;
+
 HistoryPanel::HistoryPanel(QWidget *parent)
     : QTreeView(parent)
     , m_toolBar(new QWidget)
     , m_clearButton(new QToolButton(m_toolBar))
     , m_model(new Core::HistoryModel(this))
-
+    , m_scrollTimer(new QTimer(this))
 {
     setWindowTitle(tr("History"));
     setObjectName("HistoryPanel");
 
+    m_model->setMaximumSize(Core::Settings::instance()->value<int>(Core::Settings::HistorySize));
     setModel(m_model);
+    // All rows have the same height, this avoids computing the size of each row when scrolling
+    setUniformRowHeights(true);
+    setRootIsDecorated(false);
     header()->setStretchLastSection(true);
     header()->setSectionResizeMode(Core::HistoryModel::NameCol, QHeaderView::ResizeToContents);
+    header()->setResizeContentsPrecision(ResizeContentsPrecision);
 
-    auto showLast = [this]() {
+    // Scroll once all the rows of a script run are added, instead of after each of them
+    m_scrollTimer->setSingleShot(true);
+    m_scrollTimer->setInterval(0);
+    connect(m_scrollTimer, &QTimer::timeout, this, [this]() {
         scrollTo(m_model->index(m_model->rowCount() - 1, 0));
-    };
-    connect(m_model, &QAbstractItemModel::rowsInserted, this, showLast);
+    });
+    connect(m_model, &QAbstractItemModel::rowsInserted, m_scrollTimer, qOverload<>(&QTimer::start));
+
+    // When the history is full, the oldest rows are removed: keep the start of the recording on the same entry
+    connect(m_model, &QAbstractItemModel::rowsRemoved, this, [this](const QModelIndex &, int first, int last) {
+        if (isRecording())
+            m_startRow = std::max(0, m_startRow - (last - first + 1));
+    });
+    connect(m_model, &QAbstractItemModel::modelReset, this, [this]() {
+        if (isRecording())
+            m_startRow = 0;
+    });
 
     auto layout = new QHBoxLayout(m_toolBar);
     layout->setContentsMargins({});
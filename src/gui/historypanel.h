@@ -12,6 +12,7 @@
 
 #include <QTreeView>
 
+class QTimer;
 class QToolButton;
 
 namespace Core {
@@ -42,6 +43,7 @@ private:
     QWidget *const m_toolBar = nullptr;
     QToolButton *const m_clearButton = nullptr;
     Core::HistoryModel *const m_model = nullptr;
+    QTimer *const m_scrollTimer = nullptr;
     int m_startRow = -1;
 };
 
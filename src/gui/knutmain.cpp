@@ -9,6 +9,7 @@
 */
 
 #include "knutmain.h"
+#include "core/startuptrace.h"
 #include "mainwindow.h"
 #include "optionsdialog.h"
 #include "runscriptwidget.h"
@@ -46,8 +47,11 @@ void KnutMain::doParse(const QCommandLineParser &parser) const
     }
 
     // Default case: open the main window
+    auto &trace = Core::StartupTrace::instance();
     auto ide = new MainWindow();
+    trace.mark("Create main window");
     ide->show();
+    trace.mark("Show main window");
 }
 
 } // namespace Gui
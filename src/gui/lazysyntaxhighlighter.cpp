@@ -0,0 +1,135 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lazysyntaxhighlighter.h"
+#include "core/scriptmanager.h"
+
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QTimer>
+#include <limits>
+
+namespace Gui {
+
+// Number of blocks highlighted after the end of the viewport, so scrolling a bit doesn't show plain text
+static constexpr int VisibleMargin = 100;
+// Number of blocks highlighted each time the event loop is idle
+static constexpr int ChunkSize = 500;
+
+LazySyntaxHighlighter::LazySyntaxHighlighter(QPlainTextEdit *textEdit)
+    : KSyntaxHighlighting::SyntaxHighlighter(textEdit->document())
+    , m_textEdit(textEdit)
+    , m_idleTimer(new QTimer(this))
+    , m_pendingCursor(textEdit->document())
+    , m_budget(ChunkSize)
+{
+    // Text inserted at the start of the first block not highlighted yet is not highlighted either
+    m_pendingCursor.setKeepPositionOnInsert(true);
+
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(0);
+    connect(m_idleTimer, &QTimer::timeout, this, &LazySyntaxHighlighter::highlightNextChunk);
+
+    connect(textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this,
+            &LazySyntaxHighlighter::updateVisibleRange);
+    connect(textEdit->verticalScrollBar(), &QScrollBar::rangeChanged, this,
+            &LazySyntaxHighlighter::updateVisibleRange);
+    updateVisibleRange();
+
+    auto scriptManager = Core::ScriptManager::instance();
+    connect(scriptManager, &Core::ScriptManager::scriptStarted, this, [this]() {
+        setPaused(true);
+    });
+    connect(scriptManager, &Core::ScriptManager::scriptFinished, this, [this, scriptManager]() {
+        setPaused(scriptManager->isRunning());
+    });
+    m_paused = scriptManager->isRunning();
+}
+
+void LazySyntaxHighlighter::highlightBlock(const QString &text)
+{
+    const auto block = currentBlock();
+    const int number = block.blockNumber();
+    const int pendingNumber = m_pending ? m_pendingCursor.blockNumber() : std::numeric_limits<int>::max();
+
+    // A block starts from the state of the previous one, it can only be highlighted after it
+    if (m_paused || number > pendingNumber || (number > m_visibleEnd && m_budget <= 0)) {
+        keepFormats(block);
+        if (number < pendingNumber) {
+            m_pendingCursor.setPosition(block.position());
+            m_pending = true;
+        }
+        if (!m_paused)
+            m_idleTimer->start();
+        return;
+    }
+
+    KSyntaxHighlighting::SyntaxHighlighter::highlightBlock(text);
+    if (number > m_visibleEnd)
+        --m_budget;
+
+    if (number == pendingNumber) {
+        const auto next = block.next();
+        if (next.isValid())
+            m_pendingCursor.setPosition(next.position());
+        else
+            m_pending = false;
+    }
+}
+
+void LazySyntaxHighlighter::setPaused(bool paused)
+{
+    m_paused = paused;
+    if (!m_paused && m_pending)
+        m_idleTimer->start();
+}
+
+void LazySyntaxHighlighter::updateVisibleRange()
+{
+    if (!m_textEdit)
+        return;
+    const auto cursor = m_textEdit->cursorForPosition(QPoint(0, m_textEdit->viewport()->height()));
+    m_visibleEnd = cursor.blockNumber() + VisibleMargin;
+    // Not done right away, this may be called during a layout triggered by the highlighting
+    if (m_pending && !m_paused && m_pendingCursor.blockNumber() <= m_visibleEnd)
+        m_idleTimer->start();
+}
+
+void LazySyntaxHighlighter::highlightNextChunk()
+{
+    if (m_paused)
+        return;
+
+    m_budget = ChunkSize;
+    while (m_pending && m_budget > 0) {
+        const auto block = m_pendingCursor.block();
+        rehighlightBlock(block);
+        // Nothing was highlighted, wait for the next chunk
+        if (m_pending && m_pendingCursor.block() == block)
+            break;
+    }
+
+    if (m_pending)
+        m_idleTimer->start();
+    else
+        m_budget = ChunkSize;
+}
+
+// Skipped blocks would lose their formats otherwise, keep them until the block is highlighted again
+void LazySyntaxHighlighter::keepFormats(const QTextBlock &block)
+{
+    const auto formats = block.layout()->formats();
+    for (const auto &range : formats)
+        setFormat(range.start, range.length, range.format);
+}
+
+} // namespace Gui
@@ -0,0 +1,61 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QPointer>
+#include <QTextCursor>
+#include <syntaxhighlighter.h>
+
+class QPlainTextEdit;
+class QTimer;
+
+namespace Gui {
+
+/**
+ * \brief Syntax highlighter for large documents, highlighting only what's visible right away
+ *
+ * The blocks up to the end of the viewport, plus a margin, are highlighted synchronously. The other ones are
+ * highlighted by chunks when the event loop is idle. As each block starts from the state of the previous one, blocks
+ * are always highlighted in order: the highlighter keeps the first block not highlighted yet, and never highlights a
+ * block after it.
+ *
+ * The highlighting is paused while a script is running, the blocks changed by the script are highlighted once it's
+ * done. Blocks waiting to be highlighted keep their previous formats.
+ */
+class LazySyntaxHighlighter : public KSyntaxHighlighting::SyntaxHighlighter
+{
+    Q_OBJECT
+
+public:
+    explicit LazySyntaxHighlighter(QPlainTextEdit *textEdit);
+
+protected:
+    void highlightBlock(const QString &text) override;
+
+private:
+    void setPaused(bool paused);
+    void updateVisibleRange();
+    void highlightNextChunk();
+    void keepFormats(const QTextBlock &block);
+
+    QPointer<QPlainTextEdit> m_textEdit;
+    QTimer *const m_idleTimer;
+    // Start of the first block not highlighted yet, only valid if m_pending is true
+    QTextCursor m_pendingCursor;
+    bool m_pending = false;
+    bool m_paused = false;
+    // Last block highlighted synchronously, whatever the budget
+    int m_visibleEnd = 0;
+    // Number of blocks after the visible range that can still be highlighted before waiting for the next chunk
+    int m_budget = 0;
+};
+
+} // namespace Gui
@@ -17,15 +17,63 @@
 #include <QLabel>
 #include <QMetaObject>
 #include <QPlainTextEdit>
-#include <QPointer>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
+#include <QTimer>
 #include <QToolButton>
 #include <mutex>
-#include <spdlog/sinks/qt_sinks.h>
+#include <utility>
+#include <spdlog/sinks/base_sink.h>
 
 namespace Gui {
 
+// Maximum number of lines kept in the panel, the oldest ones are removed first
+static constexpr int MaxLogLines = 10000;
+// Lines logged are shown at most once per frame
+static constexpr int FlushInterval = 16;
+
+// Sink buffering the lines logged from any thread, the panel takes them all at once in flushLog
+class LogPanelSink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    explicit LogPanelSink(LogPanel *panel)
+        : m_panel(panel)
+    {
+    }
+
+    QStringList takeLines()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        m_flushScheduled = false;
+        return std::exchange(m_lines, {});
+    }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg &msg) override
+    {
+        spdlog::memory_buf_t formatted;
+        formatter_->format(msg, formatted);
+        auto size = formatted.size();
+        while (size > 0 && (formatted[size - 1] == '\n' || formatted[size - 1] == '\r'))
+            --size;
+        m_lines.push_back(QString::fromUtf8(formatted.data(), static_cast<qsizetype>(size)));
+        // The panel would remove them anyway
+        if (m_lines.size() > MaxLogLines)
+            m_lines.removeFirst();
+
+        if (!m_flushScheduled) {
+            m_flushScheduled = true;
+            QMetaObject::invokeMethod(m_panel, &LogPanel::scheduleFlush, Qt::QueuedConnection);
+        }
+    }
+    void flush_() override { }
+
+private:
+    LogPanel *const m_panel;
+    QStringList m_lines;
+    bool m_flushScheduled = false;
+};
+
 class LogHighlighter : public QSyntaxHighlighter
 {
 public:
@@ -70,13 +118,21 @@ private:
 LogPanel::LogPanel(QWidget *parent)
     : QPlainTextEdit(parent)
     , m_toolBar(new QWidget)
+    , m_sink(std::make_shared<LogPanelSink>(this))
+    , m_flushTimer(new QTimer(this))
 {
     setWindowTitle(tr("Log Output"));
     setObjectName("LogPanel");
     setReadOnly(true);
+    setMaximumBlockCount(MaxLogLines);
+
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(FlushInterval);
+    connect(m_flushTimer, &QTimer::timeout, this, &LogPanel::flushLog);
 
     auto logger = spdlog::default_logger();
-    logger->sinks().push_back(std::make_shared<spdlog::sinks::qt_sink_mt>(this, "appendPlainText"));
+    m_sink->set_level(logger->level());
+    logger->sinks().push_back(m_sink);
 
     // Setup text edit
     new LogHighlighter(document());
@@ -99,14 +155,30 @@ LogPanel::LogPanel(QWidget *parent)
     levelCombo->addItems({"trace", "debug", "info", "warning", "error", "critical"});
     levelCombo->setCurrentIndex(logger->level());
     layout->addWidget(levelCombo);
-    connect(levelCombo, qOverload<int>(&QComboBox::currentIndexChanged), levelCombo, [logger](int index) {
-        logger->set_level(static_cast<spdlog::level::level_enum>(index));
+    connect(levelCombo, qOverload<int>(&QComboBox::currentIndexChanged), levelCombo, [this, logger](int index) {
+        const auto level = static_cast<spdlog::level::level_enum>(index);
+        logger->set_level(level);
+        // Lines below the level are not even formatted, whatever the level of the other sinks
+        m_sink->set_level(level);
     });
 }
 LogPanel::~LogPanel()
 {
-    auto logger = spdlog::default_logger();
-    logger->sinks().pop_back();
+    auto &sinks = spdlog::default_logger()->sinks();
+    std::erase(sinks, m_sink);
+}
+
+void LogPanel::scheduleFlush()
+{
+    if (!m_flushTimer->isActive())
+        m_flushTimer->start();
+}
+
+void LogPanel::flushLog()
+{
+    const auto lines = m_sink->takeLines();
+    if (!lines.isEmpty())
+        appendPlainText(lines.join('\n'));
 }
 
 QWidget *LogPanel::toolBar() const
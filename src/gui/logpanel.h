@@ -11,9 +11,14 @@
 #pragma once
 
 #include <QPlainTextEdit>
+#include <memory>
+
+class QTimer;
 
 namespace Gui {
 
+class LogPanelSink;
+
 class LogPanel : public QPlainTextEdit
 {
 public:
@@ -23,7 +28,13 @@ public:
     QWidget *toolBar() const;
 
 private:
+    friend LogPanelSink;
+    void scheduleFlush();
+    void flushLog();
+
     QWidget *const m_toolBar = nullptr;
+    const std::shared_ptr<LogPanelSink> m_sink;
+    QTimer *const m_flushTimer;
 };
 
 } // namespace Gui
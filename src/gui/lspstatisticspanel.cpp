@@ -0,0 +1,104 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lspstatisticspanel.h"
+#include "guisettings.h"
+#include "lsp/requestprofiler.h"
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QTimer>
+#include <QToolButton>
+
+namespace Gui {
+
+static constexpr int RefreshInterval = 1000;
+
+LspStatisticsPanel::LspStatisticsPanel(QWidget *parent)
+    : QTreeWidget(parent)
+    , m_toolBar(new QWidget)
+    , m_timer(new QTimer(this))
+{
+    setWindowTitle(tr("LSP Statistics"));
+    setObjectName("LspStatisticsPanel");
+    setRootIsDecorated(false);
+    setSortingEnabled(true);
+    setHeaderLabels({tr("Method"), tr("Requests"), tr("Shared"), tr("In Flight"), tr("Max In Flight"), tr("p50 (ms)"),
+                     tr("p95 (ms)"), tr("p99 (ms)"), tr("Sent (bytes)"), tr("Received (bytes)")});
+    header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    sortByColumn(0, Qt::AscendingOrder);
+
+    m_timer->setInterval(RefreshInterval);
+    connect(m_timer, &QTimer::timeout, this, &LspStatisticsPanel::updateStatistics);
+
+    // Setup titlebar
+    auto layout = new QHBoxLayout(m_toolBar);
+    layout->setContentsMargins({});
+
+    auto clearButton = new QToolButton(m_toolBar);
+    GuiSettings::setIcon(clearButton, ":/gui/delete-sweep.png");
+    clearButton->setToolTip(tr("Clear"));
+    clearButton->setAutoRaise(true);
+    layout->addWidget(clearButton);
+    connect(clearButton, &QToolButton::clicked, this, [this]() {
+        Lsp::RequestProfiler::instance().clear();
+        updateStatistics();
+    });
+}
+
+QWidget *LspStatisticsPanel::toolBar() const
+{
+    return m_toolBar;
+}
+
+void LspStatisticsPanel::showEvent(QShowEvent *event)
+{
+    QTreeWidget::showEvent(event);
+    updateStatistics();
+    m_timer->start();
+}
+
+void LspStatisticsPanel::hideEvent(QHideEvent *event)
+{
+    QTreeWidget::hideEvent(event);
+    m_timer->stop();
+}
+
+void LspStatisticsPanel::updateStatistics()
+{
+    auto toMs = [](std::chrono::microseconds time) {
+        return static_cast<double>(time.count()) / 1000;
+    };
+
+    // Numbers are set as data, so columns are sorted by value
+    setSortingEnabled(false);
+    clear();
+    for (const auto &statistics : Lsp::RequestProfiler::instance().statistics()) {
+        auto item = new QTreeWidgetItem(this);
+        item->setText(0, QString::fromStdString(statistics.method));
+        const QVariantList values = {statistics.count,
+                                     statistics.shared,
+                                     statistics.inFlight,
+                                     statistics.maxInFlight,
+                                     toMs(statistics.latency(0.5)),
+                                     toMs(statistics.latency(0.95)),
+                                     toMs(statistics.latency(0.99)),
+                                     QVariant::fromValue(statistics.requestBytes),
+                                     QVariant::fromValue(statistics.responseBytes)};
+        for (int i = 0; i < values.size(); ++i) {
+            item->setData(i + 1, Qt::DisplayRole, values.at(i));
+            item->setTextAlignment(i + 1, Qt::AlignRight | Qt::AlignVCenter);
+        }
+    }
+    setSortingEnabled(true);
+}
+
+} // namespace Gui
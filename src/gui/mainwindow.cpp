@@ -20,6 +20,8 @@
 #include "core/qttsdocument.h"
 #include "core/qtuidocument.h"
 #include "core/rcdocument.h"
+#include "core/scriptmanager.h"
+#include "core/settings.h"
 #include "core/slintdocument.h"
 #include "core/textdocument.h"
 #include "core/version.h"
@@ -30,6 +32,7 @@
 #include "interfacesettings.h"
 #include "kdalgorithms.h"
 #include "logpanel.h"
+#include "lspstatisticspanel.h"
 #include "optionsdialog.h"
 #include "palette.h"
 #include "qmlview.h"
@@ -39,6 +42,7 @@
 #include "rctouidialog.h"
 #include "rcui/rcfileview.h"
 #include "runscriptwidget.h"
+#include "runtimestatisticspanel.h"
 #include "scriptlistpanel.h"
 #include "scriptpanel.h"
 #include "shortcutmanager.h"
@@ -63,7 +67,9 @@
 #include <QSettings>
 #include <QShortcut>
 #include <QToolButton>
+#include <QTimer>
 #include <QTreeView>
+#include <QVBoxLayout>
 
 namespace Gui {
 
@@ -106,6 +112,10 @@ MainWindow::MainWindow(QWidget *parent)
     auto logPanel = new LogPanel(this);
     createDock(logPanel, Qt::BottomDockWidgetArea, logPanel->toolBar());
     createDock(m_historyPanel, Qt::BottomDockWidgetArea, m_historyPanel->toolBar());
+    auto lspStatisticsPanel = new LspStatisticsPanel(this);
+    createDock(lspStatisticsPanel, Qt::BottomDockWidgetArea, lspStatisticsPanel->toolBar());
+    auto runtimeStatisticsPanel = new RuntimeStatisticsPanel(this);
+    createDock(runtimeStatisticsPanel, Qt::BottomDockWidgetArea, runtimeStatisticsPanel->toolBar());
     auto scriptDock = createDock(m_scriptPanel, Qt::LeftDockWidgetArea, m_scriptPanel->toolBar());
     auto scriptListDock = createDock(m_scriptlistpanel, Qt::BottomDockWidgetArea, m_scriptlistpanel->toolBar());
     scriptListDock->setAllowedAreas(Qt::AllDockWidgetAreas);
@@ -211,6 +221,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     auto project = Core::Project::instance();
     connect(project, &Core::Project::currentDocumentChanged, this, &MainWindow::changeCurrentDocument);
+    connect(project, &Core::Project::documentsChangedOnDisk, this, &MainWindow::reloadConflictingDocuments);
 
     auto reloadDocsIfNeeded = [this](Qt::ApplicationState state) {
         if (state == Qt::ApplicationActive)
@@ -475,25 +486,17 @@ QDockWidget *MainWindow::createDock(QWidget *widget, Qt::DockWidgetArea area, QW
 }
 
 void MainWindow::reloadDocuments()
+{
+    // The documents without changes are reloaded in the background, reloadConflictingDocuments is called for the others
+    Core::Project::instance()->checkDocumentsOnDisk();
+}
+
+void MainWindow::reloadConflictingDocuments(const QList<Core::Document *> &conflictDocs)
 {
     static bool conflictDialogShown = false;
     if (conflictDialogShown)
         return;
 
-    std::vector<Core::Document *> conflictDocs;
-    const auto documents = Core::Project::instance()->documents();
-    // Reload all documents that have changed on disk
-    for (auto *document : documents) {
-        if (document->hasChangedOnDisk()) {
-            if (document->hasChanged())
-                conflictDocs.push_back(document);
-            else
-                document->reload();
-        }
-    }
-
-    if (conflictDocs.empty())
-        return;
     auto conflictFiles = kdalgorithms::transformed<QStringList>(conflictDocs, &Core::Document::fileName);
 
     const auto title = conflictFiles.size() == 1 ? "File changed externally" : "Files changed externally";
@@ -546,7 +549,11 @@ void MainWindow::closeDocument()
     auto document = Core::Project::instance()->currentDocument();
     if (document)
         document->close();
+    auto tab = ui->tabWidget->currentWidget();
     ui->tabWidget->removeTab(ui->tabWidget->currentIndex());
+    m_viewTabs.removeOne(tab);
+    if (tab)
+        tab->deleteLater();
 }
 
 void MainWindow::createQrc()
@@ -792,6 +799,55 @@ static void updateTabTitle(QTabWidget *tabWidget, QWidget *widget, bool hasChang
 }
 
 void MainWindow::changeCurrentDocument()
+{
+    // A script opening many documents would create a view for each of them, only the document current when the GUI
+    // is updated is shown
+    if (Core::ScriptManager::instance()->isRunning()) {
+        if (!m_currentDocumentPending) {
+            m_currentDocumentPending = true;
+            QTimer::singleShot(0, this, [this]() {
+                m_currentDocumentPending = false;
+                showCurrentDocument();
+            });
+        }
+        return;
+    }
+    showCurrentDocument();
+}
+
+/**
+ * \brief Creates the view of the document in its tab, if needed
+ *
+ * Only the views of the last MaxViews tabs shown are kept, the least recently shown one is destroyed when there are
+ * more, and created again the next time its tab is shown.
+ */
+void MainWindow::createView(QWidget *tab, Core::Document *document)
+{
+    m_viewTabs.removeOne(tab);
+    m_viewTabs.push_back(tab);
+
+    if (tab->layout()->isEmpty()) {
+        auto widget = widgetForDocument(document);
+        if (const auto actions = widget->actions(); !actions.isEmpty()) {
+            auto toolBar = new Toolbar(widget);
+            toolBar->setVisible(true);
+            for (const auto &act : actions) {
+                toolBar->addAction(act);
+            }
+        }
+        tab->layout()->addWidget(widget);
+        tab->setFocusProxy(widget);
+    }
+
+    const int maxViews = Core::Settings::instance()->value<int>(Core::Settings::MaxViews);
+    while (maxViews > 0 && m_viewTabs.size() > maxViews) {
+        auto item = m_viewTabs.takeFirst()->layout()->takeAt(0);
+        delete item->widget();
+        delete item;
+    }
+}
+
+void MainWindow::showCurrentDocument()
 {
     auto project = Core::Project::instance();
     if (!project->currentDocument())
@@ -813,28 +869,22 @@ void MainWindow::changeCurrentDocument()
         }
     }
 
-    // open the window if it's already opened
+    // open the window if it's already opened, the view itself is created by createView
+    auto document = project->currentDocument();
     if (windowIndex == -1) {
-        auto document = project->currentDocument();
-        auto widget = widgetForDocument(document);
-
-        if (const auto actions = widget->actions(); !actions.isEmpty()) {
-            auto toolBar = new Toolbar(widget);
-            toolBar->setVisible(true);
-            for (const auto &act : actions) {
-                toolBar->addAction(act);
-            }
-        }
-
-        widget->setWindowTitle(fileName);
+        auto tab = new QWidget;
+        auto layout = new QVBoxLayout(tab);
+        layout->setContentsMargins({});
+        tab->setWindowTitle(fileName);
         const auto fi = QFileInfo {fileName};
-        windowIndex = ui->tabWidget->addTab(widget, fi.fileName());
+        windowIndex = ui->tabWidget->addTab(tab, fi.fileName());
         ui->tabWidget->setTabToolTip(windowIndex, fileName);
 
-        connect(document, &Core::Document::hasChangedChanged, this, [this, widget, document]() {
-            updateTabTitle(ui->tabWidget, widget, document->hasChanged());
+        connect(document, &Core::Document::hasChangedChanged, tab, [this, tab, document]() {
+            updateTabTitle(ui->tabWidget, tab, document->hasChanged());
         });
     }
+    createView(ui->tabWidget->widget(windowIndex), document);
     ui->tabWidget->setCurrentIndex(windowIndex);
     if (ui->tabWidget->currentWidget())
         ui->tabWidget->currentWidget()->setFocus(Qt::OtherFocusReason);
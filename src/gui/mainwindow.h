@@ -17,6 +17,10 @@ class QMenu;
 class QFileSystemModel;
 class QTreeView;
 
+namespace Core {
+class Document;
+}
+
 namespace Gui {
 
 class Palette;
@@ -95,10 +99,16 @@ private:
     void updateRecentProjects();
     void changeTab();
     void changeCurrentDocument();
+    void showCurrentDocument();
+    void createView(QWidget *tab, Core::Document *document);
     QDockWidget *createDock(QWidget *widget, Qt::DockWidgetArea area, QWidget *toolbar = nullptr);
     void reloadDocuments();
+    void reloadConflictingDocuments(const QList<Core::Document *> &conflictDocs);
 
     std::unique_ptr<Ui::MainWindow> ui;
+    // Tabs having a view, the least recently shown first, see createView
+    QList<QWidget *> m_viewTabs;
+    bool m_currentDocumentPending = false;
     QMenu *m_recentProjects = nullptr;
     QFileSystemModel *const m_fileModel = nullptr;
     QTreeView *const m_projectView = nullptr;
@@ -16,14 +16,15 @@
 #include "core/symbol.h"
 #include "core/textdocument.h"
 #include "core/utils.h"
+#include "core/workspacesymboliterator.h"
 #include "gui_constants.h"
 #include "mainwindow.h"
 #include "ui_palette.h"
+#include "utils/fuzzymatcher.h"
 
 #include <QAbstractTableModel>
 #include <QAction>
-#include <QDirIterator>
-#include <QFileInfo>
+#include <QDir>
 #include <QHeaderView>
 #include <QKeyEvent>
 #include <QMenuBar>
@@ -33,6 +34,7 @@
 #include <QSortFilterProxyModel>
 #include <QTimer>
 #include <algorithm>
+#include <numeric>
 
 namespace Gui {
 
@@ -48,7 +50,7 @@ public:
     {
         if (parent.isValid())
             return 0;
-        return static_cast<int>(m_files.size());
+        return static_cast<int>(m_rows.size());
     }
     int columnCount(const QModelIndex &parent = QModelIndex()) const override
     {
@@ -61,18 +63,17 @@ public:
     {
         Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
+        const int file = m_rows.at(index.row());
         switch (role) {
         case Qt::DisplayRole:
-            if (index.column() == 0) {
-                return m_files.at(index.row()).fileName;
-            } else if (index.column() == 1) {
-                QDir dir(Core::Project::instance()->root());
-                return dir.relativeFilePath(m_files.at(index.row()).path);
-            }
+            if (index.column() == 0)
+                return m_fileNames.at(file);
+            else if (index.column() == 1)
+                return m_relativePaths.at(file);
             break;
         case Qt::ToolTipRole:
         case Qt::UserRole:
-            return m_files.at(index.row()).path;
+            return m_paths.at(file);
         }
 
         return {};
@@ -80,45 +81,63 @@ public:
 
     void resetFileInfo()
     {
-        if (Core::Project::instance()->root().isEmpty())
+        const auto project = Core::Project::instance();
+        if (project->root().isEmpty())
             return;
 
-        beginResetModel();
-
-        m_files = allFilesInDirectory(Core::Project::instance()->root());
-
-        auto byFileName = [](const auto &fi1, const auto &fi2) {
-            return fi1.fileName < fi2.fileName;
-        };
-        std::ranges::sort(m_files, byFileName);
+        // The project index is shared, the matcher is only built again when the index has changed
+        const auto &files = project->indexedFiles();
+        if (!files.isSharedWith(m_indexedFiles) || m_rootPath != project->root()) {
+            m_indexedFiles = files;
+            m_rootPath = project->root();
+            buildIndex();
+        }
+        setFilterText({});
+    }
 
+    void setFilterText(const QString &text)
+    {
+        beginResetModel();
+        m_rows = m_matcher.match(text);
         endResetModel();
     }
 
 private:
-    struct FileInfo
-    {
-        QString fileName;
-        QString path;
-    };
+    static constexpr int MaxResults = 500;
 
-    // Returns the list of all files recursively, without the hidden files or directories (starting with '.')
-    QList<FileInfo> allFilesInDirectory(const QString &path)
+    void buildIndex()
     {
-        QList<FileInfo> result;
-        QDir dir(path);
-        const auto fiList = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-        for (const auto &fi : fiList) {
-            if (fi.fileName().startsWith('.'))
-                continue;
-            if (fi.isFile())
-                result.push_back({fi.fileName(), fi.absoluteFilePath()});
-            else if (fi.isDir())
-                result.append(allFilesInDirectory(fi.absoluteFilePath()));
+        QList<int> order(m_indexedFiles.size());
+        std::iota(order.begin(), order.end(), 0);
+        QStringList fileNames;
+        fileNames.reserve(m_indexedFiles.size());
+        for (const auto &path : std::as_const(m_indexedFiles))
+            fileNames.push_back(path.mid(path.lastIndexOf('/') + 1));
+        auto byFileName = [&fileNames](int index1, int index2) {
+            return fileNames.at(index1) < fileNames.at(index2);
+        };
+        std::ranges::stable_sort(order, byFileName);
+
+        const QDir dir(m_rootPath);
+        m_fileNames.clear();
+        m_relativePaths.clear();
+        m_paths.clear();
+        for (const int index : std::as_const(order)) {
+            m_fileNames.push_back(fileNames.at(index));
+            m_relativePaths.push_back(dir.relativeFilePath(m_indexedFiles.at(index)));
+            m_paths.push_back(m_indexedFiles.at(index));
         }
-        return result;
+        m_matcher.setFiles(m_fileNames, m_relativePaths);
     }
-    QList<FileInfo> m_files;
+
+    QStringList m_indexedFiles;
+    QString m_rootPath;
+    // Files sorted by file name
+    QStringList m_fileNames;
+    QStringList m_relativePaths;
+    QStringList m_paths;
+    Utils::FuzzyMatcher m_matcher {MaxResults};
+    std::vector<int> m_rows;
 };
 
 //=============================================================================
@@ -220,6 +239,105 @@ private:
     QList<Core::Symbol *> m_symbols;
 };
 
+//=============================================================================
+// Model listing the symbols of the project, found by the LSP servers
+//=============================================================================
+class WorkspaceSymbolModel : public QAbstractTableModel
+{
+public:
+    using QAbstractTableModel::QAbstractTableModel;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        if (parent.isValid())
+            return 0;
+        return static_cast<int>(m_symbols.size());
+    }
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        if (parent.isValid())
+            return 0;
+        return 2;
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override
+    {
+        Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
+
+        const auto &symbol = m_symbols.at(index.row());
+        switch (role) {
+        case Qt::DisplayRole:
+            if (index.column() == 0)
+                return symbol.qualifiedName();
+            else if (index.column() == 1)
+                return QDir(Core::Project::instance()->root()).relativeFilePath(symbol.fileName);
+            break;
+        case Qt::ToolTipRole:
+            return symbol.fileName;
+        case Qt::UserRole:
+            return QVariant::fromValue(symbol);
+        }
+        return {};
+    }
+
+    // Sends the query to the servers, the symbols cached for a shorter query are shown until they answer
+    void setQuery(const QString &query)
+    {
+        if (query == m_query && (m_iterator || query.isEmpty()))
+            return;
+        m_query = query;
+
+        Core::LoggerDisabler ld;
+        m_iterator.reset();
+        beginResetModel();
+        m_symbols.clear();
+        m_provisional = true;
+        if (!query.isEmpty()) {
+            const auto clients = Core::Project::instance()->lspClients();
+            m_symbols = Core::WorkspaceSymbolIterator::cachedSymbols(query, clients);
+            m_iterator = std::make_unique<Core::WorkspaceSymbolIterator>(query, clients);
+            connect(m_iterator.get(), &Core::WorkspaceSymbolIterator::symbolsReceived, this, [this]() {
+                addReceivedSymbols(true);
+            });
+            // Cached results are received right away
+            addReceivedSymbols(false);
+        }
+        endResetModel();
+    }
+
+private:
+    static constexpr int MaxResults = 500;
+
+    void addReceivedSymbols(bool notify)
+    {
+        auto symbols = m_iterator->takeReceived();
+        if (m_provisional && (!symbols.isEmpty() || m_iterator->isDone())) {
+            if (notify)
+                beginResetModel();
+            m_symbols = symbols.mid(0, MaxResults);
+            m_provisional = false;
+            if (notify)
+                endResetModel();
+            return;
+        }
+
+        const auto count = std::min<qsizetype>(symbols.size(), MaxResults - m_symbols.size());
+        if (count <= 0)
+            return;
+        if (notify)
+            beginInsertRows({}, static_cast<int>(m_symbols.size()), static_cast<int>(m_symbols.size() + count - 1));
+        m_symbols.append(symbols.mid(0, count));
+        if (notify)
+            endInsertRows();
+    }
+
+    QString m_query;
+    Core::IndexedSymbolList m_symbols;
+    std::unique_ptr<Core::WorkspaceSymbolIterator> m_iterator;
+    // The symbols shown come from the cache, they are replaced by the first symbols received
+    bool m_provisional = false;
+};
+
 //=============================================================================
 // Model listing all actions
 //=============================================================================
@@ -334,6 +452,7 @@ Palette::Palette(QMainWindow *parent)
         addLineSelector();
         addScriptSelector();
         addSymbolSelector();
+        addWorkspaceSymbolSelector();
         addActionSelector();
     };
     QTimer::singleShot(0, this, init);
@@ -430,8 +549,14 @@ void Palette::changeText(const QString &text)
         setSourceModel(m_selectors.at(index).model.get());
     }
 
-    const auto search = text.mid(m_selectors.at(m_currentSelector).prefix.length()).simplified();
-    m_proxyModel->setFilterWildcard(search);
+    const auto &selector = m_selectors.at(m_currentSelector);
+    const auto search = text.mid(selector.prefix.length()).simplified();
+    if (selector.filterFunc) {
+        selector.filterFunc(search);
+        m_proxyModel->setFilterWildcard("");
+    } else {
+        m_proxyModel->setFilterWildcard(search);
+    }
     updateListHeight();
 }
 
@@ -480,10 +605,13 @@ void Palette::addFileSelector()
     auto resetFiles = [model = fileModel.get()]() {
         model->resetFileInfo();
     };
+    auto filterFiles = [model = fileModel.get()](const QString &text) {
+        model->setFilterText(text);
+    };
     auto selectFile = [](const QVariant &path) {
         Core::Project::instance()->open(path.toString());
     };
-    m_selectors.emplace_back("", std::move(fileModel), selectFile, resetFiles);
+    m_selectors.emplace_back("", std::move(fileModel), selectFile, resetFiles, filterFiles);
 }
 
 void Palette::addLineSelector()
@@ -526,6 +654,32 @@ void Palette::addSymbolSelector()
     m_selectors.emplace_back("@", std::move(symbolModel), gotoSymbol, resetSymbols);
 }
 
+void Palette::addWorkspaceSymbolSelector()
+{
+    auto symbolModel = std::make_unique<WorkspaceSymbolModel>();
+    // The symbols arrive after the text has changed
+    connect(symbolModel.get(), &QAbstractItemModel::rowsInserted, this, &Palette::updateListHeight);
+    connect(symbolModel.get(), &QAbstractItemModel::modelReset, this, &Palette::updateListHeight);
+    auto resetSymbols = [model = symbolModel.get()]() {
+        model->setQuery({});
+    };
+    auto filterSymbols = [model = symbolModel.get()](const QString &text) {
+        model->setQuery(text);
+    };
+    auto gotoSymbol = [](const QVariant &value) {
+        // Text typed without selecting a symbol
+        if (value.metaType() != QMetaType::fromType<Core::IndexedSymbol>())
+            return;
+        const auto symbol = value.value<Core::IndexedSymbol>();
+        if (auto textDocument = qobject_cast<Core::TextDocument *>(Core::Project::instance()->open(symbol.fileName))) {
+            textDocument->setPosition(symbol.range.start);
+            textDocument->textEdit()->setFocus(Qt::OtherFocusReason);
+            textDocument->textEdit()->centerCursor();
+        }
+    };
+    m_selectors.emplace_back("#", std::move(symbolModel), gotoSymbol, resetSymbols, filterSymbols);
+}
+
 void Palette::addActionSelector()
 {
     auto actionModel = std::make_unique<ActionModel>();
@@ -51,6 +51,7 @@ private:
     void addLineSelector();
     void addScriptSelector();
     void addSymbolSelector();
+    void addWorkspaceSymbolSelector();
     void addActionSelector();
 
     struct Selector
@@ -59,13 +60,17 @@ private:
         std::unique_ptr<QAbstractItemModel> model;
         std::function<void(const QVariant &)> selectionFunc;
         std::function<void()> resetFunc = {};
+        // Filters the model directly, instead of using the proxy model
+        std::function<void(const QString &)> filterFunc = {};
 
         Selector(QString prefix, std::unique_ptr<QAbstractItemModel> model,
-                 std::function<void(const QVariant &)> selectionFunc, std::function<void()> resetFunc = {})
+                 std::function<void(const QVariant &)> selectionFunc, std::function<void()> resetFunc = {},
+                 std::function<void(const QString &)> filterFunc = {})
             : prefix(std::move(prefix))
             , model(std::move(model))
             , selectionFunc(std::move(selectionFunc))
             , resetFunc(std::move(resetFunc))
+            , filterFunc(std::move(filterFunc))
         {
         }
     };
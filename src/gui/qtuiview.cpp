@@ -13,17 +13,19 @@
 #include "core/rcdocument.h"
 
 #include <QAbstractTableModel>
-#include <QFile>
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QMdiArea>
 #include <QMdiSubWindow>
 #include <QMessageBox>
 #include <QTableView>
-#include <QUiLoader>
+#include <QTimer>
 
 namespace Gui {
 
+// Changes done by a script come in bursts, the preview is only rebuilt once they stop
+constexpr int PreviewUpdateDelay = 200;
+
 class QtUiModelView : public QAbstractTableModel
 {
 public:
@@ -103,6 +105,7 @@ QtUiView::QtUiView(QWidget *parent)
     : QSplitter(parent)
     , m_tableView(new QTableView(this))
     , m_previewArea(new QMdiArea(this))
+    , m_updateTimer(new QTimer(this))
 {
     addWidget(m_previewArea);
     addWidget(m_tableView);
@@ -111,6 +114,10 @@ QtUiView::QtUiView(QWidget *parent)
     m_tableView->setSelectionBehavior(QAbstractItemView::SelectRows);
     m_previewArea->setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
     m_previewArea->setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(PreviewUpdateDelay);
+    connect(m_updateTimer, &QTimer::timeout, this, &QtUiView::updateView);
 }
 
 void QtUiView::setUiDocument(Core::QtUiDocument *document)
@@ -121,40 +128,73 @@ void QtUiView::setUiDocument(Core::QtUiDocument *document)
         m_document->disconnect(this);
 
     m_document = document;
-    if (m_document)
-        connect(m_document, &Core::QtUiDocument::fileUpdated, this, &QtUiView::updateView);
+    if (m_document) {
+        connect(m_document, &Core::QtUiDocument::fileUpdated, this, &QtUiView::scheduleUpdate);
+        connect(m_document, &Core::QtUiDocument::uiChanged, this, &QtUiView::scheduleUpdate);
+    }
 
     updateView();
 }
 
+void QtUiView::showEvent(QShowEvent *event)
+{
+    QSplitter::showEvent(event);
+    if (m_updatePending)
+        updateView();
+}
+
+void QtUiView::scheduleUpdate()
+{
+    m_updateTimer->start();
+}
+
 void QtUiView::updateView()
 {
-    delete m_tableView->model();
-    m_previewArea->removeSubWindow(m_previewWindow);
+    m_updateTimer->stop();
+    if (!isVisible()) {
+        m_updatePending = true;
+        return;
+    }
+    m_updatePending = false;
 
+    delete m_tableView->model();
     m_tableView->setModel(new QtUiModelView(m_document));
     m_tableView->horizontalHeader()->resizeSections(QHeaderView::ResizeToContents);
     m_tableView->setMinimumWidth(m_tableView->horizontalHeader()->sectionSize(QtUiModelView::QtUiColumn::Name)
                                  + m_tableView->horizontalHeader()->sectionSize(QtUiModelView::QtUiColumn::ClassName)
                                  + 2 * m_tableView->frameWidth());
 
-    QUiLoader loader;
-    QFile file(m_document->fileName());
-    if (file.open(QIODevice::ReadOnly)) {
-        QWidget *widget = loader.load(&file);
-        if (!widget) {
-            QMessageBox::warning(this, tr("Knut Ui View"),
-                                 tr("Can't load the ui file due to some errors:\n%1").arg(loader.errorString()));
-            return;
-        }
-        widget->setAttribute(Qt::WA_DeleteOnClose);
-        widget->setMinimumSize(widget->size());
+    updatePreview();
+}
+
+/**
+ * \brief Rebuilds the preview from the ui in memory
+ *
+ * The preview is loaded from the xml document of QtUiDocument, so it shows the changes not saved yet. The sub window
+ * is kept from one update to the next, only its widget is replaced.
+ */
+void QtUiView::updatePreview()
+{
+    QString errorString;
+    QWidget *widget = m_document->createPreview(errorString);
+    if (!widget) {
+        QMessageBox::warning(this, tr("Knut Ui View"),
+                             tr("Can't load the ui file due to some errors:\n%1").arg(errorString));
+        return;
+    }
+
+    widget->setMinimumSize(widget->size());
+    if (!m_previewWindow) {
         m_previewWindow = m_previewArea->addSubWindow(widget, Qt::CustomizeWindowHint);
         m_previewWindow->setVisible(true);
+        return;
     }
-
-    qDebug() << m_previewArea->subWindowList().count();
-    qDebug() << m_previewWindow->geometry();
+    const QPoint position = m_previewWindow->pos();
+    delete m_previewWindow->widget();
+    m_previewWindow->setWidget(widget);
+    m_previewWindow->adjustSize();
+    m_previewWindow->move(position);
+    widget->show();
 }
 
 } // namespace Gui
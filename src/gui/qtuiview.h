@@ -10,11 +10,13 @@
 
 #pragma once
 
+#include <QPointer>
 #include <QSplitter>
 
 class QTableView;
 class QMdiArea;
 class QMdiSubWindow;
+class QTimer;
 
 namespace Core {
 class QtUiDocument;
@@ -30,13 +32,21 @@ public:
 
     void setUiDocument(Core::QtUiDocument *document);
 
+protected:
+    void showEvent(QShowEvent *event) override;
+
 private:
+    void scheduleUpdate();
     void updateView();
+    void updatePreview();
 
     QTableView *const m_tableView;
     QMdiArea *const m_previewArea;
     Core::QtUiDocument *m_document = nullptr;
-    QMdiSubWindow *m_previewWindow = nullptr;
+    QPointer<QMdiSubWindow> m_previewWindow;
+    QTimer *const m_updateTimer;
+    // The preview of a hidden view is only updated once shown
+    bool m_updatePending = false;
 };
 
 } // namespace Gui
@@ -0,0 +1,101 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "runtimestatisticspanel.h"
+#include "core/project.h"
+#include "guisettings.h"
+#include "utils/counters.h"
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QTimer>
+#include <QToolButton>
+
+namespace Gui {
+
+static constexpr int RefreshInterval = 1000;
+
+RuntimeStatisticsPanel::RuntimeStatisticsPanel(QWidget *parent)
+    : QTreeWidget(parent)
+    , m_toolBar(new QWidget)
+    , m_timer(new QTimer(this))
+{
+    setWindowTitle(tr("Runtime Statistics"));
+    setObjectName("RuntimeStatisticsPanel");
+    setHeaderLabels({tr("Counter"), tr("Value")});
+    header()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    m_timer->setInterval(RefreshInterval);
+    connect(m_timer, &QTimer::timeout, this, &RuntimeStatisticsPanel::updateStatistics);
+
+    // Setup titlebar
+    auto layout = new QHBoxLayout(m_toolBar);
+    layout->setContentsMargins({});
+
+    auto clearButton = new QToolButton(m_toolBar);
+    GuiSettings::setIcon(clearButton, ":/gui/delete-sweep.png");
+    clearButton->setToolTip(tr("Clear"));
+    clearButton->setAutoRaise(true);
+    layout->addWidget(clearButton);
+    connect(clearButton, &QToolButton::clicked, this, [this]() {
+        Utils::Counters::reset();
+        updateStatistics();
+    });
+}
+
+QWidget *RuntimeStatisticsPanel::toolBar() const
+{
+    return m_toolBar;
+}
+
+void RuntimeStatisticsPanel::showEvent(QShowEvent *event)
+{
+    QTreeWidget::showEvent(event);
+    updateStatistics();
+    m_timer->start();
+}
+
+void RuntimeStatisticsPanel::hideEvent(QHideEvent *event)
+{
+    QTreeWidget::hideEvent(event);
+    m_timer->stop();
+}
+
+void RuntimeStatisticsPanel::updateStatistics()
+{
+    auto addItem = [](QTreeWidgetItem *parent, const QString &name, const QVariant &value) {
+        auto item = new QTreeWidgetItem(parent);
+        item->setText(0, name);
+        item->setData(1, Qt::DisplayRole, value);
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        return item;
+    };
+
+    clear();
+    if (!Core::Project::instance())
+        return;
+    const auto stats = Core::Project::instance()->stats();
+    auto root = invisibleRootItem();
+    for (auto it = stats.cbegin(); it != stats.cend(); ++it) {
+        if (it.key() != "lspRequests")
+            addItem(root, it.key(), it.value());
+    }
+
+    const auto lspRequests = stats.value("lspRequests").toMap();
+    int requestCount = 0;
+    for (const auto &count : lspRequests)
+        requestCount += count.toInt();
+    auto lspItem = addItem(root, "lspRequests", requestCount);
+    for (auto it = lspRequests.cbegin(); it != lspRequests.cend(); ++it)
+        addItem(lspItem, it.key(), it.value());
+    lspItem->setExpanded(true);
+}
+
+} // namespace Gui
@@ -0,0 +1,39 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QTreeWidget>
+
+class QTimer;
+
+namespace Gui {
+
+// Counters of the work done by knut (see Project::stats), refreshed while the panel is visible
+class RuntimeStatisticsPanel : public QTreeWidget
+{
+    Q_OBJECT
+public:
+    explicit RuntimeStatisticsPanel(QWidget *parent = nullptr);
+
+    QWidget *toolBar() const;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    void updateStatistics();
+
+    QWidget *const m_toolBar = nullptr;
+    QTimer *const m_timer = nullptr;
+};
+
+} // namespace Gui
@@ -14,6 +14,7 @@
 #include "core/mark.h"
 #include "core/scriptmodel.h"
 #include "core/textdocument.h"
+#include "core/texteditor.h"
 #include "guisettings.h"
 
 #include <QEvent>
@@ -21,10 +22,12 @@
 #include <QPainter>
 #include <QPlainTextEdit>
 #include <QScrollBar>
+#include <QTextBlock>
 #include <QTextDocument>
 #include <QToolButton>
 #include <QToolTip>
 #include <QVBoxLayout>
+#include <algorithm>
 
 namespace Gui {
 
@@ -90,9 +93,12 @@ void TextView::setDocument(Core::TextDocument *document)
     textEdit->installEventFilter(this);
     setFocusProxy(textEdit);
     connect(textEdit->document(), &QTextDocument::contentsChanged, this, &TextView::updateMarkRect);
+    // The positions of the matches are wrong after a change, until they are found again
+    connect(textEdit->document(), &QTextDocument::contentsChanged, this, &TextView::clearFindMatches);
     GuiSettings::setupDocumentTextEdit(textEdit, document);
 
     connect(textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this, &TextView::updateQuickActionRect);
+    connect(textEdit->verticalScrollBar(), &QScrollBar::valueChanged, this, &TextView::updateFindSelections);
 
     // TODO, change once we have quick actions
     // m_quickActionButton->raise();
@@ -142,6 +148,8 @@ bool TextView::eventFilter(QObject *obj, QEvent *event)
     Q_UNUSED(obj)
     if (event->type() == QEvent::Paint)
         updateMarkRect();
+    if (event->type() == QEvent::Resize)
+        updateFindSelections();
     if (event->type() == QEvent::ToolTip) {
         if (const auto *codedocument = qobject_cast<Core::CodeDocument *>(m_document)) {
             if (const auto *helpEvent = dynamic_cast<QHelpEvent *>(event)) {
@@ -168,6 +176,60 @@ bool TextView::eventFilter(QObject *obj, QEvent *event)
     return false;
 }
 
+void TextView::clearFindMatches()
+{
+    m_findMatches.clear();
+    updateFindSelections();
+}
+
+void TextView::addFindMatches(const std::vector<Core::TextRange> &matches)
+{
+    m_findMatches.insert(m_findMatches.end(), matches.begin(), matches.end());
+    updateFindSelections();
+}
+
+const std::vector<Core::TextRange> &TextView::findMatches() const
+{
+    return m_findMatches;
+}
+
+/**
+ * \brief Highlights the matches shown in the viewport
+ *
+ * A document can have a lot of matches, so they are not all extra selections of the text edit: the visible ones are
+ * found with a binary search, each time the view is scrolled or resized.
+ */
+void TextView::updateFindSelections()
+{
+    auto *textEditor = m_document ? qobject_cast<Core::TextEditor *>(m_document->textEdit()) : nullptr;
+    if (!textEditor || (m_findMatches.empty() && !m_hasFindSelections))
+        return;
+
+    QList<QTextEdit::ExtraSelection> selections;
+    if (!m_findMatches.empty()) {
+        const QRect viewportRect = textEditor->viewport()->rect();
+        const int first = textEditor->cursorForPosition(viewportRect.topLeft()).block().position();
+        const QTextBlock lastBlock = textEditor->cursorForPosition(viewportRect.bottomRight()).block();
+        const int last = lastBlock.position() + lastBlock.length();
+
+        QTextCharFormat format;
+        QColor color = palette().highlight().color();
+        color.setAlpha(80);
+        format.setBackground(color);
+        auto it = std::ranges::lower_bound(m_findMatches, first, {}, &Core::TextRange::end);
+        for (; it != m_findMatches.end() && it->start < last; ++it) {
+            QTextEdit::ExtraSelection selection;
+            selection.format = format;
+            selection.cursor = QTextCursor(textEditor->document());
+            selection.cursor.setPosition(it->start);
+            selection.cursor.setPosition(it->end, QTextCursor::KeepAnchor);
+            selections.append(selection);
+        }
+    }
+    m_hasFindSelections = !selections.isEmpty();
+    textEditor->setHighlightSelections(std::move(selections));
+}
+
 Core::TextDocument *TextView::document() const
 {
     return m_document;
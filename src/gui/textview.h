@@ -11,8 +11,10 @@
 #pragma once
 
 #include "core/mark.h"
+#include "core/textrange.h"
 
 #include <QWidget>
+#include <vector>
 
 class QRubberBand;
 class QToolButton;
@@ -35,6 +37,11 @@ public:
     void selectToMark();
     bool hasMark() const;
 
+    // Matches of the find widget, added while they are found: only the ones in the viewport are highlighted
+    void clearFindMatches();
+    void addFindMatches(const std::vector<Core::TextRange> &matches);
+    const std::vector<Core::TextRange> &findMatches() const;
+
     bool eventFilter(QObject *obj, QEvent *event) override;
 
 protected:
@@ -44,11 +51,15 @@ private:
     void updateMarkRect();
     void updateQuickActionRect();
     void showQuickActionMenu();
+    void updateFindSelections();
 
     Core::TextDocument *m_document = nullptr;
     std::optional<Core::Mark> m_mark = {};
     QWidget *m_markRect = nullptr;
     QToolButton *m_quickActionButton = nullptr;
+    // Sorted by position
+    std::vector<Core::TextRange> m_findMatches;
+    bool m_hasFindSelections = false;
 };
 
 } // namespace Gui
@@ -12,11 +12,18 @@
 #include "guisettings.h"
 #include "ui_transformpreviewdialog.h"
 
+#include <QFileInfo>
 #include <QPushButton>
+#include <algorithm>
 
 namespace Gui {
 
-TransformPreviewDialog::TransformPreviewDialog(Core::CodeDocument *document, const QString &resultText,
+// Number of unchanged lines shown around each change
+static constexpr int ContextLines = 3;
+
+TransformPreviewDialog::TransformPreviewDialog(const QString &fileName, const QString &sourceText,
+                                               const QString &resultText,
+                                               const std::vector<treesitter::Transformation::Change> &changes,
                                                int numberReplacements, QWidget *parent /* = nullptr */)
     : QDialog(parent)
     , ui(new Ui::TransformPreviewDialog)
@@ -24,8 +31,9 @@ TransformPreviewDialog::TransformPreviewDialog(Core::CodeDocument *document, con
     ui->setupUi(this);
 
     ui->replacementsLabel->setText(tr("%1 Replacements made").arg(numberReplacements));
-    ui->transformedText->setPlainText(resultText);
-    GuiSettings::setupDocumentTextEdit(ui->transformedText, document);
+    ui->transformedText->setReadOnly(true);
+    ui->transformedText->setPlainText(createDiff(fileName, sourceText, resultText, changes));
+    GuiSettings::setupFileNameTextEdit(ui->transformedText, "transformation.diff");
 
     if (auto applyButton = ui->buttonBox->button(QDialogButtonBox::Apply)) {
         connect(applyButton, &QPushButton::clicked, this, &QDialog::accept);
@@ -37,4 +45,127 @@ TransformPreviewDialog::~TransformPreviewDialog()
     delete ui;
 }
 
+namespace {
+// Position of the start of each line of a text
+class LineIndex
+{
+public:
+    explicit LineIndex(const QString &text)
+        : m_text(text)
+    {
+        m_lineStarts.push_back(0);
+        for (int i = 0; i < text.size(); ++i) {
+            if (text.at(i) == '\n')
+                m_lineStarts.push_back(i + 1);
+        }
+    }
+
+    int lineCount() const
+    {
+        // A text ending with a new line doesn't have an extra empty line
+        const bool endsWithNewLine = m_lineStarts.size() > 1 && m_lineStarts.back() == m_text.size();
+        return static_cast<int>(m_lineStarts.size()) - (endsWithNewLine ? 1 : 0);
+    }
+
+    int lineAt(int position) const
+    {
+        const auto it = std::ranges::upper_bound(m_lineStarts, position);
+        return static_cast<int>(it - m_lineStarts.cbegin()) - 1;
+    }
+
+    QStringView line(int line) const
+    {
+        const int start = m_lineStarts.at(line);
+        const int end = line + 1 < static_cast<int>(m_lineStarts.size()) ? m_lineStarts.at(line + 1) - 1
+                                                                           : static_cast<int>(m_text.size());
+        return QStringView(m_text).mid(start, end - start);
+    }
+
+private:
+    const QString &m_text;
+    std::vector<int> m_lineStarts;
+};
+
+// Lines changed, last lines included
+struct LineChange
+{
+    int sourceFirst;
+    int sourceLast;
+    int resultFirst;
+    int resultLast;
+};
+}
+
+// Last line of a range, a range ending at the start of a line doesn't include that line
+static int lastLine(const LineIndex &index, int start, int end)
+{
+    return index.lineAt(end > start ? end - 1 : end);
+}
+
+QString TransformPreviewDialog::createDiff(const QString &fileName, const QString &sourceText,
+                                           const QString &resultText,
+                                           const std::vector<treesitter::Transformation::Change> &changes)
+{
+    const LineIndex sourceIndex(sourceText);
+    const LineIndex resultIndex(resultText);
+
+    // Changes on the same lines are shown together
+    std::vector<LineChange> lineChanges;
+    lineChanges.reserve(changes.size());
+    for (const auto &change : changes) {
+        const LineChange lineChange {sourceIndex.lineAt(change.sourceStart),
+                                     lastLine(sourceIndex, change.sourceStart, change.sourceEnd),
+                                     resultIndex.lineAt(change.resultStart),
+                                     lastLine(resultIndex, change.resultStart, change.resultEnd)};
+        if (!lineChanges.empty() && lineChange.sourceFirst <= lineChanges.back().sourceLast) {
+            lineChanges.back().sourceLast = lineChange.sourceLast;
+            lineChanges.back().resultLast = lineChange.resultLast;
+        } else {
+            lineChanges.push_back(lineChange);
+        }
+    }
+
+    const QString name = QFileInfo(fileName).fileName();
+    QString diff = QString("--- a/%1\n+++ b/%1\n").arg(name);
+    auto appendLines = [&diff](const LineIndex &index, char prefix, int first, int last) {
+        for (int line = first; line <= last; ++line) {
+            diff += prefix;
+            diff += index.line(line);
+            diff += '\n';
+        }
+    };
+
+    // The unchanged lines are the same in both texts, the context is read from the source
+    auto it = lineChanges.cbegin();
+    while (it != lineChanges.cend()) {
+        // A hunk contains all the changes whose context overlap
+        auto last = it;
+        while (std::next(last) != lineChanges.cend()
+               && std::next(last)->sourceFirst - ContextLines <= last->sourceLast + ContextLines + 1)
+            ++last;
+
+        const int contextBefore = std::min(ContextLines, it->sourceFirst);
+        const int contextAfter = std::clamp(sourceIndex.lineCount() - 1 - last->sourceLast, 0, ContextLines);
+        const int sourceStart = it->sourceFirst - contextBefore;
+        const int resultStart = it->resultFirst - contextBefore;
+        const int sourceCount = last->sourceLast + contextAfter - sourceStart + 1;
+        const int resultCount = last->resultLast + contextAfter - resultStart + 1;
+        diff += QString("@@ -%1,%2 +%3,%4 @@\n")
+                    .arg(sourceStart + 1)
+                    .arg(sourceCount)
+                    .arg(resultStart + 1)
+                    .arg(resultCount);
+
+        int line = sourceStart;
+        for (; it != std::next(last); ++it) {
+            appendLines(sourceIndex, ' ', line, it->sourceFirst - 1);
+            appendLines(sourceIndex, '-', it->sourceFirst, it->sourceLast);
+            appendLines(resultIndex, '+', it->resultFirst, it->resultLast);
+            line = it->sourceLast + 1;
+        }
+        appendLines(sourceIndex, ' ', line, line + contextAfter - 1);
+    }
+    return diff;
+}
+
 } // namespace Gui
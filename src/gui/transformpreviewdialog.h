@@ -10,9 +10,10 @@
 
 #pragma once
 
-#include "core/codedocument.h"
+#include "treesitter/transformation.h"
 
 #include <QDialog>
+#include <vector>
 
 namespace Gui {
 
@@ -25,10 +26,15 @@ class TransformPreviewDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit TransformPreviewDialog(Core::CodeDocument *document, const QString &resultText, int numberReplacements,
-                                    QWidget *parent = nullptr);
+    // Shows the changes made by the transformation as a unified diff, instead of the whole text
+    explicit TransformPreviewDialog(const QString &fileName, const QString &sourceText, const QString &resultText,
+                                    const std::vector<treesitter::Transformation::Change> &changes,
+                                    int numberReplacements, QWidget *parent = nullptr);
     ~TransformPreviewDialog() override;
 
+    static QString createDiff(const QString &fileName, const QString &sourceText, const QString &resultText,
+                              const std::vector<treesitter::Transformation::Change> &changes);
+
 private:
     Ui::TransformPreviewDialog *ui;
 };
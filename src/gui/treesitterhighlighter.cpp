@@ -0,0 +1,282 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "treesitterhighlighter.h"
+#include "core/codedocument.h"
+#include "core/scriptmanager.h"
+#include "treesitter/parser.h"
+#include "treesitter/query.h"
+#include "treesitter/tree.h"
+
+#include <QFile>
+#include <QHash>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <QTimer>
+#include <algorithm>
+#include <utility>
+#include <spdlog/spdlog.h>
+#include <theme.h>
+
+namespace Gui {
+
+// Number of blocks highlighted with one query
+static constexpr int ChunkSize = 256;
+
+using TextStyle = KSyntaxHighlighting::Theme::TextStyle;
+
+static QString highlightsFile(Core::Document::Type type)
+{
+    switch (type) {
+    case Core::Document::Type::Cpp:
+        return QStringLiteral(":/gui/highlights/cpp.scm");
+    case Core::Document::Type::Qml:
+        return QStringLiteral(":/gui/highlights/qml.scm");
+    default:
+        return {};
+    }
+}
+
+// Returns the style of a capture, looking for its parent if it's not known (`keyword.return` is a `keyword`)
+static int styleForCapture(QString name)
+{
+    static const QHash<QString, TextStyle> styles = {
+        {"comment", TextStyle::Comment},
+        {"string", TextStyle::String},
+        {"string.special", TextStyle::Import},
+        {"string.escape", TextStyle::SpecialChar},
+        {"character", TextStyle::Char},
+        {"number", TextStyle::DecVal},
+        {"boolean", TextStyle::Constant},
+        {"constant", TextStyle::Constant},
+        {"keyword", TextStyle::Keyword},
+        {"keyword.control", TextStyle::ControlFlow},
+        {"preproc", TextStyle::Preprocessor},
+        {"type", TextStyle::DataType},
+        {"function", TextStyle::Function},
+        {"variable", TextStyle::Variable},
+        {"variable.builtin", TextStyle::BuiltIn},
+        {"property", TextStyle::Attribute},
+        {"namespace", TextStyle::Others},
+        {"operator", TextStyle::Operator},
+    };
+    while (!name.isEmpty()) {
+        if (auto it = styles.constFind(name); it != styles.cend())
+            return static_cast<int>(*it);
+        name.truncate(std::max(name.lastIndexOf('.'), qsizetype(0)));
+    }
+    return -1;
+}
+
+// Builds the highlights query of the language. Each group of patterns is checked on its own: the grammars are updated
+// independently of the queries, and a node unknown to the grammar would make the whole query fail.
+static std::shared_ptr<treesitter::Query> highlightsQuery(Core::Document::Type type)
+{
+    QFile file(highlightsFile(type));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return {};
+
+    const auto language = treesitter::Parser::getLanguage(type);
+    QStringList groups;
+    const auto text = QString::fromUtf8(file.readAll());
+    for (const auto &group : text.split("\n\n", Qt::SkipEmptyParts)) {
+        try {
+            treesitter::Query query(language, group);
+            groups.push_back(group);
+        } catch (const treesitter::Query::Error &error) {
+            spdlog::warn("TreeSitterHighlighter: pattern `{}` skipped: {}", group, error.description);
+        }
+    }
+    if (groups.isEmpty())
+        return {};
+
+    try {
+        return treesitter::QueryCache::instance().get(language, groups.join("\n\n"));
+    } catch (const treesitter::Query::Error &error) {
+        spdlog::warn("TreeSitterHighlighter: invalid highlights query: {}", error.description);
+        return {};
+    }
+}
+
+TreeSitterHighlighter::TreeSitterHighlighter(Core::CodeDocument *document)
+    : QSyntaxHighlighter(static_cast<QObject *>(document->textDocument()))
+    , m_document(document)
+    , m_query(highlightsQuery(document->type()))
+    , m_updateTimer(new QTimer(this))
+{
+    if (m_query) {
+        for (const auto &capture : m_query->captures()) {
+            if (capture.id >= m_captureStyles.size())
+                m_captureStyles.resize(capture.id + 1, -1);
+            m_captureStyles[capture.id] = styleForCapture(capture.name);
+        }
+    }
+
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(0);
+    connect(m_updateTimer, &QTimer::timeout, this, &TreeSitterHighlighter::updateHighlighting);
+
+    // Connected before setting the document, so the snapshot is outdated before QSyntaxHighlighter reformats the blocks
+    connect(document->textDocument(), &QTextDocument::contentsChange, this, &TreeSitterHighlighter::changeContent);
+    connect(document, &Core::CodeDocument::syntaxChanged, this, [this](const QList<Core::TextRange> &ranges) {
+        for (const auto &range : ranges)
+            addDirtyRange(range.start, range.end);
+    });
+    connect(Core::ScriptManager::instance(), &Core::ScriptManager::scriptFinished, this, [this]() {
+        if (m_outdated)
+            m_updateTimer->start();
+    });
+    setDocument(document->textDocument());
+}
+
+bool TreeSitterHighlighter::hasHighlights(Core::Document::Type type)
+{
+    return !highlightsFile(type).isEmpty();
+}
+
+void TreeSitterHighlighter::setTheme(const KSyntaxHighlighting::Theme &theme)
+{
+    m_formats.assign(TextStyle::Error + 1, QTextCharFormat());
+    for (int style = 0; style <= TextStyle::Error; ++style) {
+        const auto textStyle = static_cast<TextStyle>(style);
+        auto &format = m_formats[style];
+        if (const auto color = theme.textColor(textStyle))
+            format.setForeground(QColor::fromRgba(color));
+        if (const auto color = theme.backgroundColor(textStyle))
+            format.setBackground(QColor::fromRgba(color));
+        if (theme.isBold(textStyle))
+            format.setFontWeight(QFont::Bold);
+        if (theme.isItalic(textStyle))
+            format.setFontItalic(true);
+        if (theme.isUnderline(textStyle))
+            format.setFontUnderline(true);
+        if (theme.isStrikeThrough(textStyle))
+            format.setFontStrikeOut(true);
+    }
+}
+
+void TreeSitterHighlighter::highlightBlock(const QString &text)
+{
+    Q_UNUSED(text)
+    const auto block = currentBlock();
+    if (m_outdated || !m_document) {
+        keepFormats(block);
+        return;
+    }
+
+    if (!m_snapshot)
+        m_snapshot = m_document->syntaxSnapshot();
+    if (!m_snapshot || !m_query || m_formats.empty())
+        return;
+
+    const int number = block.blockNumber();
+    if (m_chunkStart == -1 || number < m_chunkStart || number >= m_chunkStart + static_cast<int>(m_chunkSpans.size()))
+        computeChunk(block);
+    for (const auto &span : m_chunkSpans[number - m_chunkStart])
+        setFormat(span.start, span.length, m_formats[span.style]);
+}
+
+void TreeSitterHighlighter::addDirtyRange(int start, int end)
+{
+    QTextCursor cursor(document());
+    cursor.setPosition(std::min(start, document()->characterCount() - 1));
+    cursor.setPosition(std::min(end, document()->characterCount() - 1), QTextCursor::KeepAnchor);
+    m_dirtyRanges.push_back(cursor);
+}
+
+void TreeSitterHighlighter::changeContent(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved)
+    m_outdated = true;
+    m_snapshot.reset();
+    m_chunkStart = -1;
+    m_chunkSpans.clear();
+    addDirtyRange(position, position + charsAdded);
+    m_updateTimer->start();
+}
+
+void TreeSitterHighlighter::updateHighlighting()
+{
+    // Reparsing after each change of a script would slow it down, wait for the end
+    if (!m_document || Core::ScriptManager::instance()->isRunning())
+        return;
+
+    // Reparsing the document adds the ranges whose syntax changed
+    m_outdated = false;
+    m_snapshot = m_document->syntaxSnapshot();
+
+    // Ranges of blocks, each block is only highlighted once even if the ranges overlap
+    std::vector<std::pair<int, int>> blockRanges;
+    for (const auto &range : std::exchange(m_dirtyRanges, {})) {
+        blockRanges.emplace_back(document()->findBlock(range.selectionStart()).blockNumber(),
+                                 document()->findBlock(range.selectionEnd()).blockNumber());
+    }
+    std::ranges::sort(blockRanges);
+
+    int next = 0;
+    for (const auto &[first, last] : blockRanges) {
+        for (auto block = document()->findBlockByNumber(std::max(first, next));
+             block.isValid() && block.blockNumber() <= last; block = block.next())
+            rehighlightBlock(block);
+        next = std::max(next, last + 1);
+    }
+}
+
+// Runs the highlights query on the blocks starting at `block`, and splits the captures on the blocks they cover
+void TreeSitterHighlighter::computeChunk(const QTextBlock &block)
+{
+    m_chunkStart = block.blockNumber();
+    m_chunkSpans.clear();
+
+    auto last = block;
+    while (static_cast<int>(m_chunkSpans.size()) < ChunkSize - 1 && last.next().isValid()) {
+        m_chunkSpans.emplace_back();
+        last = last.next();
+    }
+    m_chunkSpans.emplace_back();
+
+    const int chunkStart = block.position();
+    const int chunkEnd = last.position() + last.length() - 1;
+
+    treesitter::QueryCursor cursor;
+    cursor.setByteRange(static_cast<uint32_t>(chunkStart * sizeof(QChar)),
+                        static_cast<uint32_t>(chunkEnd * sizeof(QChar)));
+    cursor.execute(m_query, m_snapshot);
+    while (const auto match = cursor.nextMatch()) {
+        for (const auto &capture : match->captures()) {
+            const int style = capture.id < m_captureStyles.size() ? m_captureStyles[capture.id] : -1;
+            if (style == -1)
+                continue;
+            const int start = std::max(static_cast<int>(capture.node.startPosition()), chunkStart);
+            const int end = std::min(static_cast<int>(capture.node.endPosition()), chunkEnd);
+            for (auto current = document()->findBlock(start); current.isValid() && current.position() < end;
+                 current = current.next()) {
+                const int index = current.blockNumber() - m_chunkStart;
+                if (index >= static_cast<int>(m_chunkSpans.size()))
+                    break;
+                const int spanStart = std::max(start, current.position());
+                const int spanEnd = std::min(end, current.position() + current.length() - 1);
+                if (spanEnd > spanStart)
+                    m_chunkSpans[index].push_back({spanStart - current.position(), spanEnd - spanStart, style});
+            }
+        }
+    }
+}
+
+// Blocks changed since the last parse keep their formats until they are highlighted again
+void TreeSitterHighlighter::keepFormats(const QTextBlock &block)
+{
+    const auto formats = block.layout()->formats();
+    for (const auto &range : formats)
+        setFormat(range.start, range.length, range.format);
+}
+
+} // namespace Gui
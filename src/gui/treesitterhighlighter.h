@@ -0,0 +1,100 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "core/document.h"
+
+#include <QList>
+#include <QPointer>
+#include <QSyntaxHighlighter>
+#include <QTextCharFormat>
+#include <QTextCursor>
+#include <memory>
+#include <vector>
+
+class QTimer;
+
+namespace KSyntaxHighlighting {
+class Theme;
+}
+
+namespace treesitter {
+class Query;
+class TreeSnapshot;
+}
+
+namespace Core {
+class CodeDocument;
+}
+
+namespace Gui {
+
+/**
+ * \brief Syntax highlighter using the syntax tree of a code document
+ *
+ * The text is highlighted with a highlights query (see the `gui/highlights` resources) run on the tree-sitter tree of
+ * the document, instead of lexing every line again. The query is run once for a chunk of blocks, and its captures are
+ * mapped to the text styles of the KSyntaxHighlighting theme.
+ *
+ * Changes are not highlighted right away, as it would reparse the document after each edit of a script. Once back in
+ * the event loop, and when no script is running, the document is reparsed incrementally: only the changed blocks and
+ * the ranges whose syntax changed are highlighted again.
+ */
+class TreeSitterHighlighter : public QSyntaxHighlighter
+{
+    Q_OBJECT
+
+public:
+    // The highlighter must be set on the text document of `document`
+    explicit TreeSitterHighlighter(Core::CodeDocument *document);
+
+    // Returns true if there is a highlights query for this type of document
+    static bool hasHighlights(Core::Document::Type type);
+
+    void setTheme(const KSyntaxHighlighting::Theme &theme);
+
+protected:
+    void highlightBlock(const QString &text) override;
+
+private:
+    struct Span
+    {
+        int start;
+        int length;
+        int style;
+    };
+
+    void addDirtyRange(int start, int end);
+    void changeContent(int position, int charsRemoved, int charsAdded);
+    void updateHighlighting();
+    void computeChunk(const QTextBlock &block);
+    void keepFormats(const QTextBlock &block);
+
+    QPointer<Core::CodeDocument> m_document;
+    std::shared_ptr<treesitter::Query> m_query;
+    // Text style of each capture of the query, -1 if not highlighted
+    std::vector<int> m_captureStyles;
+    // Format of each KSyntaxHighlighting::Theme::TextStyle
+    std::vector<QTextCharFormat> m_formats;
+
+    std::shared_ptr<const treesitter::TreeSnapshot> m_snapshot;
+    // The document has changed since m_snapshot, it's highlighted again by updateHighlighting
+    bool m_outdated = false;
+    // Ranges to highlight again, following the changes of the text
+    QList<QTextCursor> m_dirtyRanges;
+    QTimer *const m_updateTimer;
+
+    // Spans of the blocks of the last chunk, starting at block m_chunkStart
+    int m_chunkStart = -1;
+    std::vector<std::vector<Span>> m_chunkSpans;
+};
+
+} // namespace Gui
@@ -12,19 +12,33 @@
 #include "core/codedocument.h"
 #include "core/logger.h"
 #include "core/project.h"
+#include "core/settings.h"
 #include "transformpreviewdialog.h"
 #include "treesitter/languages.h"
+#include "treesitter/parser.h"
 #include "treesitter/predicates.h"
 #include "treesitter/transformation.h"
 #include "ui_treesitterinspector.h"
 #include "utils/log.h"
+#include "utils/taskscheduler.h"
 
+#include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QMessageBox>
 #include <QPalette>
+#include <QPointer>
+#include <QProgressDialog>
 #include <QTextEdit>
+#include <QTimer>
 
 namespace Gui {
 
+static constexpr int TextChangeDelay = 300;
+// The progress dialog is only shown if the transformation takes longer than this
+static constexpr int ProgressDialogDelay = 500;
+// Minimum interval between 2 updates of the number of replacements shown
+static constexpr int ProgressInterval = 100;
+
 QueryErrorHighlighter::QueryErrorHighlighter(QTextDocument *parent)
     : QSyntaxHighlighter(parent)
 {
@@ -80,13 +94,17 @@ void QueryErrorHighlighter::setUtf8Position(int position)
 TreeSitterInspector::TreeSitterInspector(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::TreeSitterInspector)
-    , m_parser(nullptr)
+    , m_textTimer(new QTimer(this))
     , m_errorHighlighter(nullptr)
     , m_document(nullptr)
 {
     ui->setupUi(this);
     m_errorHighlighter = new QueryErrorHighlighter(ui->query->document());
 
+    m_textTimer->setSingleShot(true);
+    m_textTimer->setInterval(TextChangeDelay);
+    connect(m_textTimer, &QTimer::timeout, this, &TreeSitterInspector::changeText);
+
     connect(Core::Project::instance(), &Core::Project::currentDocumentChanged, this,
             &TreeSitterInspector::changeCurrentDocument);
 
@@ -96,6 +114,7 @@ TreeSitterInspector::TreeSitterInspector(QWidget *parent)
             &TreeSitterInspector::changeTreeSelection);
 
     connect(ui->query, &QPlainTextEdit::textChanged, this, &TreeSitterInspector::changeQuery);
+    connect(&m_treemodel, &TreeSitterTreeModel::queryStateChanged, this, &TreeSitterInspector::changeQueryState);
 
     changeCurrentDocument(Core::Project::instance()->currentDocument());
 
@@ -117,12 +136,19 @@ void TreeSitterInspector::changeQueryState()
         int matchCount = m_treemodel.matchCount();
 
         const QColor col = palette().color(QPalette::ColorGroup::Normal, QPalette::Highlight);
+        const bool running = m_treemodel.isQueryRunning();
+        const QString state = running ? tr("running...") : tr("%1 ms").arg(m_treemodel.queryTime());
 
-        ui->queryInfo->setText(tr("<span style='color:%1'>%2 Patterns - %3 Matches - %4 Captures</span>")
+        ui->queryInfo->setText(tr("<span style='color:%1'>%2 Patterns - %3 Matches - %4 Captures - %5</span>")
                                    .arg(patternCount == 0 || matchCount == 0 ? col.name() : "green")
                                    .arg(patternCount)
                                    .arg(matchCount)
-                                   .arg(m_treemodel.captureCount()));
+                                   .arg(m_treemodel.captureCount())
+                                   .arg(state));
+        if (const auto profile = m_treemodel.queryProfile(); profile && !running)
+            ui->queryInfo->setToolTip(QString("<pre>%1</pre>").arg(profile->toString().toHtmlEscaped()));
+        else
+            ui->queryInfo->setToolTip("");
     }
 }
 
@@ -142,8 +168,9 @@ void TreeSitterInspector::changeQuery()
     m_queryText = text;
 
     if (text.isEmpty()) {
-        m_treemodel.setQuery({}, makePredicates());
+        m_treemodel.setQuery({});
         ui->queryInfo->setText("");
+        ui->queryInfo->setToolTip("");
         m_errorHighlighter->setUtf8Position(-1);
         return;
     }
@@ -151,13 +178,14 @@ void TreeSitterInspector::changeQuery()
     try {
         auto lang = treesitter::Parser::getLanguage(m_document->type());
         auto query = std::make_shared<treesitter::Query>(lang, ui->query->toPlainText());
-        m_treemodel.setQuery(query, makePredicates());
+        m_treemodel.setQuery(query);
         m_errorHighlighter->setUtf8Position(-1);
 
         changeQueryState();
     } catch (treesitter::Query::Error &error) {
-        m_treemodel.setQuery({}, nullptr);
+        m_treemodel.setQuery({});
         ui->queryInfo->setText(highlightQueryError(error));
+        ui->queryInfo->setToolTip("");
 
         // The error may be behind the last character, which couldn't be highlighted
         // So move back by one character in that case.
@@ -177,21 +205,30 @@ void TreeSitterInspector::showUnnamedChanged()
 
 void TreeSitterInspector::changeText()
 {
-    QString text;
+    m_textTimer->stop();
+    if (!m_document)
+        return;
+
+    // Use the document tree, which is reparsed incrementally after each change
+    std::shared_ptr<const treesitter::TreeSnapshot> tree;
     {
         Core::LoggerDisabler disableLogging;
-        text = m_document->text();
+        tree = m_document->syntaxSnapshot();
     }
-    auto tree = m_parser.parseString(text);
-    if (tree.has_value()) {
-        m_treemodel.setTree(std::move(tree.value()), makePredicates(), ui->enableUnnamed->isChecked());
-        ui->treeInspector->expandAll();
+    if (tree) {
+        ui->stateLabel->setText(tr("TreeSitter State"));
+        m_treemodel.setTree(std::move(tree), ui->enableUnnamed->isChecked());
+        // The nodes are only created when shown, don't expand the whole tree
+        ui->treeInspector->expandToDepth(1);
         for (int i = 0; i < 2; i++) {
             ui->treeInspector->resizeColumnToContents(i);
         }
         changeQueryState();
     } else {
         m_treemodel.clear();
+        const auto timeout = DEFAULT_VALUE(int, ParseTimeout);
+        if (timeout > 0)
+            ui->stateLabel->setText(tr("TreeSitter State - parsing stopped after %1ms").arg(timeout));
     }
 }
 
@@ -209,12 +246,14 @@ void TreeSitterInspector::setDocument(Core::CodeDocument *document)
 {
     if (m_document) {
         m_document->disconnect(this);
+        // The text changes are connected to the timer, not to the inspector
+        m_document->disconnect(m_textTimer);
     }
 
     m_document = document;
-    m_parser = treesitter::Parser::getLanguage(document->type());
+    m_textTimer->stop();
     if (m_document) {
-        connect(m_document, &Core::CodeDocument::textChanged, this, &TreeSitterInspector::changeText);
+        connect(m_document, &Core::CodeDocument::textChanged, m_textTimer, qOverload<>(&QTimer::start));
         connect(m_document, &Core::CodeDocument::positionChanged, this, &TreeSitterInspector::changeCursor);
 
         changeCursor();
@@ -241,16 +280,106 @@ QString TreeSitterInspector::preCheckTransformation() const
     return {};
 }
 
+static void showTransformationError(const QString &description)
+{
+    QMessageBox msgBox;
+    msgBox.setText(TreeSitterInspector::tr("Error performing Transformation"));
+    msgBox.setInformativeText(description);
+    msgBox.setIcon(QMessageBox::Critical);
+    msgBox.exec();
+}
+
 void TreeSitterInspector::previewTransformation()
 {
-    prepareTransformation([this](auto &transformation) {
-        auto result = transformation.run();
+    auto query = createTransformationQuery();
+    if (!query)
+        return;
 
-        TransformPreviewDialog dialog(m_document, result, transformation.replacementsMade(), this);
-        if (dialog.exec() == QDialog::Accepted) {
-            m_document->setText(result);
-        }
+    if (m_transformationResult && isCurrentTransformation(*m_transformationResult)) {
+        showTransformationPreview(*m_transformationResult);
+        return;
+    }
+    TransformationResult result {.source = m_document->plainText(),
+                                 .query = m_queryText,
+                                 .target = ui->target->toPlainText()};
+
+    // The transformation runs on a worker thread, with its own parser. Meanwhile, the progress dialog shows the number
+    // of replacements found so far, and blocks the inspector.
+    auto canceled = std::make_shared<std::atomic<bool>>(false);
+    auto progressDialog = new QProgressDialog(tr("Transforming..."), tr("Cancel"), 0, 0, this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setMinimumDuration(ProgressDialogDelay);
+    connect(progressDialog, &QProgressDialog::canceled, this, [canceled, progressDialog]() {
+        *canceled = true;
+        progressDialog->deleteLater();
     });
+
+    QPointer<TreeSitterInspector> inspector(this);
+    QPointer<QProgressDialog> progress(progressDialog);
+    QPointer<Core::CodeDocument> document(m_document);
+    const auto language = treesitter::Parser::getLanguage(m_document->type());
+    Utils::TaskScheduler::start(
+        [result = std::move(result), language, query, canceled, inspector, progress, document]() mutable {
+            try {
+                QElapsedTimer progressTime;
+                progressTime.start();
+                treesitter::Transformation transformation(result.source, treesitter::ParserPool::acquire(language),
+                                                          query, result.target);
+                transformation.setCancellationFlag(canceled.get());
+                transformation.setProgressCallback([&progressTime, progress](int replacements) {
+                    if (progressTime.elapsed() < ProgressInterval)
+                        return;
+                    progressTime.restart();
+                    QMetaObject::invokeMethod(
+                        QCoreApplication::instance(),
+                        [progress, replacements]() {
+                            if (progress)
+                                progress->setLabelText(tr("%1 Replacements made").arg(replacements));
+                        },
+                        Qt::QueuedConnection);
+                });
+
+                result.text = transformation.run();
+                result.replacements = transformation.replacementsMade();
+                result.changes = transformation.changes();
+            } catch (treesitter::Transformation::Error &error) {
+                result.error = error.description;
+            }
+
+            QMetaObject::invokeMethod(
+                QCoreApplication::instance(),
+                [inspector, progress, document, canceled, result = std::move(result)]() {
+                    if (*canceled)
+                        return;
+                    delete progress.data();
+                    if (inspector && document && inspector->m_document == document)
+                        inspector->showTransformationPreview(result);
+                },
+                Qt::QueuedConnection);
+        },
+        Utils::TaskScheduler::Interactive);
+}
+
+void TreeSitterInspector::showTransformationPreview(const TransformationResult &result)
+{
+    if (!result.error.isEmpty()) {
+        showTransformationError(result.error);
+        return;
+    }
+
+    m_transformationResult = result;
+    TransformPreviewDialog dialog(m_document->fileName(), result.source, result.text, result.changes,
+                                  result.replacements, this);
+    if (dialog.exec() == QDialog::Accepted) {
+        m_document->setText(result.text);
+        m_transformationResult.reset();
+    }
+}
+
+bool TreeSitterInspector::isCurrentTransformation(const TransformationResult &result) const
+{
+    return result.query == m_queryText && result.target == ui->target->toPlainText()
+        && result.source == m_document->plainText();
 }
 
 QString TreeSitterInspector::highlightQueryError(const treesitter::Query::Error &error) const
@@ -262,6 +391,14 @@ QString TreeSitterInspector::highlightQueryError(const treesitter::Query::Error
 
 void TreeSitterInspector::runTransformation()
 {
+    // The result of the preview is used if nothing changed since
+    if (m_transformationResult && preCheckTransformation().isEmpty()
+        && isCurrentTransformation(*m_transformationResult)) {
+        m_document->setText(m_transformationResult->text);
+        m_transformationResult.reset();
+        return;
+    }
+
     prepareTransformation([this](auto &transformation) {
         m_document->setText(transformation.run());
 
@@ -272,6 +409,23 @@ void TreeSitterInspector::runTransformation()
 
 void TreeSitterInspector::prepareTransformation(
     const std::function<void(treesitter::Transformation &transformation)> &runFunction)
+{
+    auto query = createTransformationQuery();
+    if (!query)
+        return;
+
+    try {
+        auto lang = treesitter::Parser::getLanguage(m_document->type());
+        treesitter::Transformation transformation(m_document->plainText(), treesitter::ParserPool::acquire(lang), query,
+                                                  ui->target->toPlainText());
+
+        runFunction(transformation);
+    } catch (treesitter::Transformation::Error &error) {
+        showTransformationError(error.description);
+    }
+}
+
+std::shared_ptr<treesitter::Query> TreeSitterInspector::createTransformationQuery() const
 {
     const auto errorMessage = preCheckTransformation();
     if (!errorMessage.isEmpty()) {
@@ -279,42 +433,19 @@ void TreeSitterInspector::prepareTransformation(
         msgBox.setText(errorMessage);
         msgBox.setIcon(QMessageBox::Critical);
         msgBox.exec();
-        return;
+        return {};
     }
 
     try {
-        auto lang = treesitter::Parser::getLanguage(m_document->type());
-        auto query = std::make_shared<treesitter::Query>(lang, m_queryText);
-        treesitter::Parser parser(lang);
-
-        treesitter::Transformation transformation(m_document->text(), std::move(parser), query,
-                                                  ui->target->toPlainText());
-
-        runFunction(transformation);
+        return std::make_shared<treesitter::Query>(treesitter::Parser::getLanguage(m_document->type()), m_queryText);
     } catch (treesitter::Query::Error &error) {
         QMessageBox msgBox;
         msgBox.setText(tr("Error in Query"));
         msgBox.setInformativeText(highlightQueryError(error));
         msgBox.setIcon(QMessageBox::Critical);
         msgBox.exec();
-    } catch (treesitter::Transformation::Error &error) {
-        QMessageBox msgBox;
-        msgBox.setText(tr("Error performing Transformation"));
-        msgBox.setInformativeText(error.description);
-        msgBox.setIcon(QMessageBox::Critical);
-        msgBox.exec();
-    }
-}
-
-std::unique_ptr<treesitter::Predicates> TreeSitterInspector::makePredicates()
-{
-    if (m_document) {
-        // No need to always log the call to TextDocument::text
-        Core::LoggerDisabler disabler;
-        return std::make_unique<treesitter::Predicates>(m_document->text());
-    } else {
-        return nullptr;
     }
+    return {};
 }
 
 void TreeSitterInspector::changeTreeSelection(const QModelIndex &current, const QModelIndex &previous)
@@ -10,16 +10,14 @@
 
 #pragma once
 
-#include "treesitter/parser.h"
+#include "treesitter/transformation.h"
 #include "treesittertreemodel.h"
 
 #include <QDialog>
 #include <QSyntaxHighlighter>
+#include <optional>
 
-namespace treesitter {
-class Transformation;
-class Predicates;
-}
+class QTimer;
 
 namespace Core {
 class Document;
@@ -61,11 +59,24 @@ private:
     void changeCursor();
     void changeQuery();
     void changeQueryState();
+    // Result of a transformation, kept so it's not computed again if the transformation is run after the preview
+    struct TransformationResult
+    {
+        QString source;
+        QString query;
+        QString target;
+        QString text;
+        int replacements = 0;
+        std::vector<treesitter::Transformation::Change> changes;
+        QString error;
+    };
+
     void previewTransformation();
+    void showTransformationPreview(const TransformationResult &result);
     void runTransformation();
     void prepareTransformation(const std::function<void(treesitter::Transformation &transformation)> &runFunction);
-
-    std::unique_ptr<treesitter::Predicates> makePredicates();
+    std::shared_ptr<treesitter::Query> createTransformationQuery() const;
+    bool isCurrentTransformation(const TransformationResult &result) const;
 
     QString preCheckTransformation() const;
 
@@ -75,13 +86,16 @@ private:
 
     Ui::TreeSitterInspector *ui;
 
-    treesitter::Parser m_parser;
     TreeSitterTreeModel m_treemodel;
+    // Delays the tree update after a text change, so it's done once the user stops typing
+    QTimer *const m_textTimer;
     QueryErrorHighlighter *m_errorHighlighter;
 
     Core::CodeDocument *m_document;
 
     QString m_queryText;
+
+    std::optional<TransformationResult> m_transformationResult;
 };
 
 } // namespace Gui
@@ -10,14 +10,25 @@
 
 #include "treesittertreemodel.h"
 #include "utils/log.h"
+#include "utils/taskscheduler.h"
 
 #include <QBrush>
 #include <QColor>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <functional>
+#include <utility>
 
 namespace Gui {
 
-TreeSitterTreeModel::TreeNode::TreeNode(const treesitter::Node &node, const TreeNode *parent, bool enableUnnamed)
+// Interval between two partial results sent by the query worker
+static constexpr qint64 QueryResultInterval = 50;
+
+TreeSitterTreeModel::TreeNode::TreeNode(const treesitter::Node &node, const TreeNode *parent, int row,
+                                        bool enableUnnamed)
     : m_parent(parent)
+    , m_row(row)
     , m_node(node)
     , m_enableUnnamed(enableUnnamed)
 {
@@ -34,9 +45,10 @@ std::vector<std::unique_ptr<TreeSitterTreeModel::TreeNode>> &TreeSitterTreeModel
 {
 
     if (m_children.empty() && childCount() > 0) {
-        auto children = m_enableUnnamed ? m_node.children() : m_node.namedChildren();
-        for (const auto &child : children) {
-            m_children.emplace_back(new TreeNode(child, this, m_enableUnnamed));
+        m_children.reserve(childCount());
+        int row = 0;
+        for (const auto &child : m_enableUnnamed ? m_node.childRange() : m_node.namedChildRange()) {
+            m_children.emplace_back(new TreeNode(child, this, row++, m_enableUnnamed));
         }
     }
 
@@ -85,20 +97,9 @@ QVariant TreeSitterTreeModel::TreeNode::data(int column) const
     return {};
 }
 
-bool operator==(const std::unique_ptr<TreeSitterTreeModel::TreeNode> &unique, const TreeSitterTreeModel::TreeNode *ptr)
-{
-    return unique.get() == ptr;
-}
-
 int TreeSitterTreeModel::TreeNode::row() const
 {
-    if (m_parent) {
-        const auto &children = m_parent->children();
-        const auto it = std::find(children.cbegin(), children.cend(), this);
-
-        return std::distance(children.cbegin(), it);
-    }
-    return 0;
+    return m_row;
 }
 
 const TreeSitterTreeModel::TreeNode *TreeSitterTreeModel::TreeNode::parent() const
@@ -122,7 +123,7 @@ void TreeSitterTreeModel::TreeNode::traverse(const std::function<void(TreeNode *
     if (filter(this)) {
         fun(this);
 
-        for (const auto &child : children()) {
+        for (const auto &child : m_children) {
             child->traverse(fun, filter);
         }
     }
@@ -136,6 +137,22 @@ TreeSitterTreeModel::TreeSitterTreeModel(QObject *parent)
 {
 }
 
+TreeSitterTreeModel::~TreeSitterTreeModel()
+{
+    cancelQuery();
+}
+
+size_t TreeSitterTreeModel::NodeKeyHash::operator()(const NodeKey &key) const noexcept
+{
+    return std::hash<uint32_t> {}(key.start) ^ (std::hash<uint32_t> {}(key.end) << 1)
+        ^ (std::hash<TSSymbol> {}(key.symbol) << 2);
+}
+
+TreeSitterTreeModel::NodeKey TreeSitterTreeModel::nodeKey(const treesitter::Node &node)
+{
+    return {node.startPosition(), node.endPosition(), node.symbol()};
+}
+
 QModelIndex TreeSitterTreeModel::indexFor(const TreeNode &node, int column) const
 {
     return createIndex(node.row(), column, &node);
@@ -229,7 +246,7 @@ QVariant TreeSitterTreeModel::data(const QModelIndex &index, int role) const
             return node->data(index.column());
         } else {
             if (m_query.has_value()) {
-                const auto it = m_query->captures.find(node->tsNode());
+                const auto it = m_query->captures.find(nodeKey(node->tsNode()));
                 if (it != m_query->captures.cend()) {
                     return it->second;
                 }
@@ -254,75 +271,147 @@ Qt::ItemFlags TreeSitterTreeModel::flags(const QModelIndex &index) const
     return QAbstractItemModel::flags(index);
 }
 
-void TreeSitterTreeModel::setTree(treesitter::Tree &&tree, std::unique_ptr<treesitter::Predicates> &&predicates,
-                                  bool enableUnnamed)
+void TreeSitterTreeModel::setTree(std::shared_ptr<const treesitter::TreeSnapshot> tree, bool enableUnnamed)
 {
     beginResetModel();
     m_tree = std::move(tree);
-    m_rootNode = std::make_unique<TreeNode>(m_tree->rootNode(), nullptr, enableUnnamed);
-    executeQuery(std::move(predicates));
+    m_rootNode = std::make_unique<TreeNode>(m_tree->rootNode(), nullptr, 0, enableUnnamed);
+    executeQuery();
     endResetModel();
 }
 
 void TreeSitterTreeModel::clear()
 {
+    cancelQuery();
     beginResetModel();
-    m_tree = {};
     m_rootNode.reset();
+    m_tree.reset();
     m_cursorPosition = -1;
     endResetModel();
 }
 
-void TreeSitterTreeModel::executeQuery(std::unique_ptr<treesitter::Predicates> &&predicates)
+void TreeSitterTreeModel::cancelQuery()
 {
-    treesitter::QueryCursor cursor;
-
-    if (m_rootNode && m_query.has_value()) {
-        m_query->captures = decltype(m_query->captures)();
-        m_query->numCaptures = 0;
-        m_query->numMatches = 0;
+    if (m_queryCanceled)
+        *m_queryCanceled = true;
+    m_queryCanceled.reset();
+    ++m_queryGeneration;
+}
 
-        cursor.execute(m_query->query, m_rootNode->tsNode(), std::move(predicates));
+void TreeSitterTreeModel::executeQuery()
+{
+    cancelQuery();
+    if (!m_rootNode || !m_query.has_value())
+        return;
 
-        while (const auto match = cursor.nextMatch()) {
-            m_query->numMatches++;
+    m_query->captures = {};
+    m_query->numCaptures = 0;
+    m_query->numMatches = 0;
+    m_query->running = true;
+    m_query->time = 0;
+    m_query->profile = {};
 
-            const auto captures = match->captures();
-            for (const auto &capture : captures) {
-                m_query->numCaptures++;
-                m_query->captures[capture.node] += " @" + m_query->query->captureAt(capture.id).name;
+    // The worker has its own copy of the tree, and results are only sent back to the model if it still exists
+    auto canceled = std::make_shared<std::atomic<bool>>(false);
+    m_queryCanceled = canceled;
+    const int generation = m_queryGeneration;
+    QPointer<TreeSitterTreeModel> model(this);
+    auto sendResult = [model, generation](QueryResult &&result) {
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [model, generation, result = std::move(result)]() {
+                if (model)
+                    model->addQueryResult(generation, result);
+            },
+            Qt::QueuedConnection);
+    };
+
+    Utils::TaskScheduler::start(
+        [query = m_query->query, snapshot = m_tree->copy(), canceled, sendResult]() {
+            QElapsedTimer time;
+            time.start();
+            QElapsedTimer resultTime;
+            resultTime.start();
+
+            treesitter::QueryProfile profile;
+            treesitter::QueryCursor cursor;
+            cursor.setProfile(&profile);
+            cursor.execute(query, snapshot);
+
+            QueryResult result;
+            while (!*canceled) {
+                const auto match = cursor.nextMatch();
+                if (!match)
+                    break;
+                ++result.numMatches;
+                for (const auto &capture : match->captures())
+                    result.captures.emplace_back(nodeKey(capture.node), " @" + query->captureAt(capture.id).name);
+
+                if (resultTime.elapsed() >= QueryResultInterval) {
+                    sendResult(std::exchange(result, {}));
+                    resultTime.restart();
+                }
             }
-        }
+            if (*canceled)
+                return;
+
+            result.finished = true;
+            result.time = time.elapsed();
+            result.profile = std::move(profile);
+            sendResult(std::move(result));
+        },
+        Utils::TaskScheduler::Interactive);
+}
+
+void TreeSitterTreeModel::addQueryResult(int generation, const QueryResult &result)
+{
+    if (generation != m_queryGeneration || !m_query.has_value())
+        return;
+
+    Captures changed;
+    m_query->numMatches += result.numMatches;
+    for (const auto &[key, name] : result.captures) {
+        m_query->numCaptures++;
+        m_query->captures[key] += name;
+        changed.emplace(key, QString());
+    }
+    if (result.finished) {
+        m_query->running = false;
+        m_query->time = result.time;
+        m_query->profile = result.profile;
+        m_queryCanceled.reset();
     }
+    capturesChanged(changed);
+    emit queryStateChanged();
 }
 
-void TreeSitterTreeModel::capturesChanged(const std::unordered_map<treesitter::Node, QString> &oldCaptures)
+void TreeSitterTreeModel::capturesChanged(const Captures &captures)
 {
-    if (m_rootNode) {
-        m_rootNode->traverse([&oldCaptures, this](const auto *node) {
-            const bool isOldCapture = oldCaptures.contains(node->tsNode());
-            const bool isNewCapture = m_query.has_value() && m_query->captures.contains(node->tsNode());
-            if (isOldCapture || isNewCapture) {
+    if (m_rootNode && !captures.empty()) {
+        m_rootNode->traverse([&captures, this](const auto *node) {
+            if (captures.contains(nodeKey(node->tsNode())))
                 emit dataChanged(indexFor(*node, 2), indexFor(*node, 2));
-            }
         });
     }
 }
 
-void TreeSitterTreeModel::setQuery(const std::shared_ptr<treesitter::Query> &query,
-                                   std::unique_ptr<treesitter::Predicates> &&predicates)
+void TreeSitterTreeModel::setQuery(const std::shared_ptr<treesitter::Query> &query)
 {
-    std::unordered_map<treesitter::Node, QString> oldCaptures =
-        m_query.has_value() ? std::move(m_query->captures) : decltype(m_query->captures)();
+    Captures oldCaptures = m_query.has_value() ? std::move(m_query->captures) : Captures();
 
     if (query != nullptr) {
-        m_query =
-            QueryData {.query = query, .captures = decltype(m_query->captures)(), .numMatches = 0, .numCaptures = 0};
+        m_query = QueryData {.query = query,
+                             .captures = {},
+                             .numMatches = 0,
+                             .numCaptures = 0,
+                             .running = false,
+                             .time = 0,
+                             .profile = {}};
     } else {
         m_query = {};
     }
 
-    executeQuery(std::move(predicates));
+    executeQuery();
     capturesChanged(oldCaptures);
 }
 
@@ -362,6 +451,16 @@ bool TreeSitterTreeModel::hasQuery() const
     return m_query.has_value();
 }
 
+bool TreeSitterTreeModel::isQueryRunning() const
+{
+    return m_query.has_value() && m_query->running;
+}
+
+qint64 TreeSitterTreeModel::queryTime() const
+{
+    return m_query.has_value() ? m_query->time : 0;
+}
+
 int TreeSitterTreeModel::patternCount() const
 {
     if (m_query.has_value()) {
@@ -387,4 +486,9 @@ int TreeSitterTreeModel::captureCount() const
     return 0;
 }
 
+const treesitter::QueryProfile *TreeSitterTreeModel::queryProfile() const
+{
+    return m_query.has_value() ? &m_query->profile : nullptr;
+}
+
 }
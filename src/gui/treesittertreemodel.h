@@ -15,8 +15,11 @@
 #include "treesitter/tree.h"
 
 #include <QAbstractItemModel>
+#include <atomic>
 #include <memory>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace Gui {
 
@@ -28,7 +31,7 @@ public:
     class TreeNode
     {
     public:
-        explicit TreeNode(const treesitter::Node &node, const TreeNode *parent, bool enableUnnamed);
+        explicit TreeNode(const treesitter::Node &node, const TreeNode *parent, int row, bool enableUnnamed);
 
         int childCount() const;
         const TreeNode *child(int row) const;
@@ -44,6 +47,7 @@ public:
         const std::vector<std::unique_ptr<TreeNode>> &children() const;
         std::vector<std::unique_ptr<TreeNode>> &children();
 
+        // Only visits the nodes already created, the other ones are not known by the view yet
         void traverse(
             const std::function<void(TreeNode *)> &fun, const std::function<bool(TreeNode *)> &filter = [](auto) {
                 return true;
@@ -51,12 +55,14 @@ public:
 
     private:
         const TreeNode *m_parent;
+        int m_row;
         mutable std::vector<std::unique_ptr<TreeNode>> m_children;
         treesitter::Node m_node;
         bool m_enableUnnamed;
     };
 
     TreeSitterTreeModel(QObject *parent = nullptr);
+    ~TreeSitterTreeModel() override;
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -69,36 +75,80 @@ public:
     QVariant data(const QModelIndex &index, int role) const override;
     Qt::ItemFlags flags(const QModelIndex &index) const override;
 
-    void setQuery(const std::shared_ptr<treesitter::Query> &query,
-                  std::unique_ptr<treesitter::Predicates> &&predicates);
+    // The query runs on a worker thread, on its own copy of the tree, and the captures are shown as they are found.
+    // Setting another query or tree cancels the running one.
+    void setQuery(const std::shared_ptr<treesitter::Query> &query);
     void setCursorPosition(int position);
-    void setTree(treesitter::Tree &&tree, std::unique_ptr<treesitter::Predicates> &&predicates, bool enableUnnamed);
+    void setTree(std::shared_ptr<const treesitter::TreeSnapshot> tree, bool enableUnnamed);
     void clear();
 
     std::optional<treesitter::Node> tsNode(const QModelIndex &index) const;
 
     bool hasQuery() const;
+    bool isQueryRunning() const;
     int patternCount() const;
     int captureCount() const;
     int matchCount() const;
+    // Time spent to evaluate the query, in milliseconds, once it's done
+    qint64 queryTime() const;
+    const treesitter::QueryProfile *queryProfile() const;
+
+signals:
+    // Emitted each time new matches are found, and once the query is done
+    void queryStateChanged();
 
 private:
+    // Identifies a node in any copy of the tree, treesitter::Node is only valid for the tree it comes from
+    struct NodeKey
+    {
+        uint32_t start;
+        uint32_t end;
+        TSSymbol symbol;
+
+        bool operator==(const NodeKey &other) const = default;
+    };
+    struct NodeKeyHash
+    {
+        size_t operator()(const NodeKey &key) const noexcept;
+    };
+    using Captures = std::unordered_map<NodeKey, QString, NodeKeyHash>;
+    static NodeKey nodeKey(const treesitter::Node &node);
+
+    // Part of the query result, sent by the worker thread
+    struct QueryResult
+    {
+        int numMatches = 0;
+        std::vector<std::pair<NodeKey, QString>> captures;
+        bool finished = false;
+        qint64 time = 0;
+        treesitter::QueryProfile profile;
+    };
+
     void positionChanged(int position);
-    void capturesChanged(const std::unordered_map<treesitter::Node, QString> &oldCaptures);
-    void executeQuery(std::unique_ptr<treesitter::Predicates> &&predicates);
+    void capturesChanged(const Captures &captures);
+    void executeQuery();
+    void cancelQuery();
+    void addQueryResult(int generation, const QueryResult &result);
 
     int m_cursorPosition;
-    std::optional<treesitter::Tree> m_tree;
+    // Shared with the document, it's the document incremental tree at the time of the last update
+    std::shared_ptr<const treesitter::TreeSnapshot> m_tree;
 
     struct QueryData
     {
         std::shared_ptr<treesitter::Query> query;
-        std::unordered_map<treesitter::Node, QString> captures;
+        Captures captures;
         int numMatches;
         int numCaptures;
+        bool running;
+        qint64 time;
+        treesitter::QueryProfile profile;
     };
 
     std::optional<QueryData> m_query;
+    // Results of older evaluations are ignored
+    int m_queryGeneration = 0;
+    std::shared_ptr<std::atomic<bool>> m_queryCanceled;
     std::unique_ptr<TreeNode> m_rootNode;
 };
 
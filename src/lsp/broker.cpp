@@ -0,0 +1,479 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "broker.h"
+#include "jsonreader.h"
+#include "utils/log.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QEventLoop>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QTimer>
+#include <chrono>
+#include <charconv>
+#include <nlohmann/json.hpp>
+#include <utility>
+
+using json = nlohmann::json;
+
+namespace Lsp {
+
+// Time to wait for a running broker, and for a new one to be ready
+constexpr int ConnectTimeout = 1000;
+constexpr int StartTimeout = 10000;
+constexpr int RetryInterval = 100;
+// Time given to the server to exit properly once shut down
+constexpr int ExitTimeout = 5000;
+
+namespace {
+
+    // Top-level fields of a message, read in place
+    struct MessageFields
+    {
+        // Json text of the id, empty for a notification
+        std::string_view id;
+        size_t idStart = 0;
+        size_t idEnd = 0;
+        std::string method;
+        std::string_view result;
+    };
+
+}
+
+static std::string_view trimmed(std::string_view text)
+{
+    const auto start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos)
+        return {};
+    const auto end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+static bool readFields(std::string_view content, MessageFields &fields)
+{
+    JsonReader reader(content);
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "id" || key == "result") {
+            const auto start = reader.position();
+            if (!reader.skipValue())
+                return false;
+            const auto end = reader.position();
+            const auto value = trimmed(content.substr(start, end - start));
+            if (key == "id") {
+                fields.id = value;
+                fields.idStart = start;
+                fields.idEnd = end;
+            } else {
+                fields.result = value;
+            }
+            return true;
+        }
+        if (key == "method")
+            return read(reader, fields.method);
+        return reader.skipValue();
+    });
+    return ok && reader.atEnd();
+}
+
+// Returns the message with a new id, the rest of the text is kept as is
+static std::string withId(std::string_view content, const MessageFields &fields, std::string_view id)
+{
+    std::string message;
+    message.reserve(content.size() + id.size());
+    message.append(content.substr(0, fields.idStart));
+    message.append(id);
+    message.append(content.substr(fields.idEnd));
+    return message;
+}
+
+static std::string responseMessage(std::string_view id, std::string_view result)
+{
+    std::string message = R"({"jsonrpc":"2.0","id":)";
+    message.append(id);
+    message.append(R"(,"result":)");
+    message.append(result);
+    message.append("}");
+    return message;
+}
+
+static std::string closeMessage(const std::string &uri)
+{
+    return json {{"jsonrpc", "2.0"},
+                 {"method", "textDocument/didClose"},
+                 {"params", {{"textDocument", {{"uri", uri}}}}}}
+        .dump();
+}
+
+static std::string cancelMessage(int id)
+{
+    return json {{"jsonrpc", "2.0"}, {"method", "$/cancelRequest"}, {"params", {{"id", id}}}}.dump();
+}
+
+// Returns params.textDocument.uri, without reading the text of the document
+static std::string documentUri(std::string_view content)
+{
+    std::string uri;
+    JsonReader reader(content);
+    auto readMember = [&reader](std::string_view name, auto &&readValue) {
+        return [&reader, name, readValue](std::string_view key) {
+            return key == name ? readValue() : reader.skipValue();
+        };
+    };
+    reader.readObject(readMember("params", [&]() {
+        return reader.readObject(readMember("textDocument", [&]() {
+            return reader.readObject(readMember("uri", [&]() {
+                return read(reader, uri);
+            }));
+        }));
+    }));
+    return uri;
+}
+
+Broker::Broker(QString serverName, QString program, QStringList arguments, int idleTimeout, QObject *parent)
+    : QObject(parent)
+    , m_serverName(std::move(serverName))
+    , m_program(std::move(program))
+    , m_arguments(std::move(arguments))
+    , m_server(new QLocalServer(this))
+    , m_process(new QProcess(this))
+    , m_idleTimer(new QTimer(this))
+{
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(std::chrono::seconds(idleTimeout));
+    connect(m_idleTimer, &QTimer::timeout, this, &Broker::stop);
+}
+
+Broker::~Broker()
+{
+    if (m_process->state() == QProcess::NotRunning)
+        return;
+    m_process->kill();
+    m_process->waitForFinished(300);
+}
+
+bool Broker::start()
+{
+    if (!m_server->listen(m_serverName)) {
+        // A broker may have crashed, and left its socket behind
+        QLocalSocket probe;
+        probe.connectToServer(m_serverName);
+        if (probe.waitForConnected(ConnectTimeout)) {
+            spdlog::info("Broker::start - broker {} already running", m_serverName);
+            return false;
+        }
+        QLocalServer::removeServer(m_serverName);
+        if (!m_server->listen(m_serverName)) {
+            spdlog::error("Broker::start - can't listen on {}: {}", m_serverName, m_server->errorString());
+            return false;
+        }
+    }
+    connect(m_server, &QLocalServer::newConnection, this, &Broker::addConnection);
+
+    // Nobody reads the server logs here
+    m_process->setStandardErrorFile(QProcess::nullDevice());
+    connect(m_process, &QProcess::readyReadStandardOutput, this, &Broker::readServer);
+    connect(m_process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, [this]() {
+        spdlog::info("Broker - LSP server {} exited", m_program);
+        m_server->close();
+        for (const auto &connection : m_connections)
+            connection->socket->disconnectFromServer();
+        emit finished();
+    });
+    m_process->start(m_program, m_arguments);
+    if (!m_process->waitForStarted()) {
+        spdlog::error("Broker::start - can't start LSP server {}", m_program);
+        return false;
+    }
+
+    spdlog::info("Broker::start - LSP server {} shared on {}", m_program, m_serverName);
+    m_idleTimer->start();
+    return true;
+}
+
+QString Broker::serverName(const std::string &language, const QString &rootPath, const QString &program,
+                           const QStringList &arguments)
+{
+    // The home path is part of the name, so two users don't share the same server
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const auto &value : QStringList {QString::fromStdString(language), QDir(rootPath).absolutePath(),
+                                          QDir::homePath(), program}
+                                 + arguments) {
+        hash.addData(value.toUtf8());
+        hash.addData(QByteArrayView("\0", 1));
+    }
+    return QString("knut-lsp-%1").arg(QString::fromLatin1(hash.result().toHex().left(16)));
+}
+
+QLocalSocket *Broker::openConnection(const QString &serverName, const QString &program, const QStringList &arguments,
+                                     const QString &rootPath, int idleTimeout, QObject *parent)
+{
+    auto socket = new QLocalSocket(parent);
+    socket->connectToServer(serverName);
+    if (socket->waitForConnected(ConnectTimeout))
+        return socket;
+
+    // No broker running yet: start one, detached so it outlives this process
+    QProcess broker;
+    broker.setProgram(QCoreApplication::applicationFilePath());
+    broker.setArguments(QStringList {"--lsp-broker", serverName, "--lsp-idle-timeout", QString::number(idleTimeout),
+                                     "--", program}
+                        + arguments);
+    broker.setWorkingDirectory(rootPath);
+    broker.setStandardOutputFile(QProcess::nullDevice());
+    broker.setStandardErrorFile(QProcess::nullDevice());
+    // The broker never shows any window
+    auto environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("QT_QPA_PLATFORM", "offscreen");
+    broker.setProcessEnvironment(environment);
+    if (!broker.startDetached()) {
+        spdlog::error("Broker::openConnection - can't start the broker {}", serverName);
+        delete socket;
+        return nullptr;
+    }
+
+    // The broker needs some time before listening, try again on each failure until it's ready or too late
+    QEventLoop loop;
+    QTimer retryTimer;
+    retryTimer.setSingleShot(true);
+    retryTimer.setInterval(RetryInterval);
+    connect(&retryTimer, &QTimer::timeout, socket, [socket, &serverName]() {
+        socket->connectToServer(serverName);
+    });
+    connect(socket, &QLocalSocket::errorOccurred, &retryTimer, qOverload<>(&QTimer::start));
+    connect(socket, &QLocalSocket::connected, &loop, &QEventLoop::quit);
+    QTimer::singleShot(StartTimeout, &loop, &QEventLoop::quit);
+    socket->connectToServer(serverName);
+    if (socket->state() != QLocalSocket::ConnectedState)
+        loop.exec();
+    if (socket->state() == QLocalSocket::ConnectedState)
+        return socket;
+
+    spdlog::error("Broker::openConnection - can't connect to the broker {}", serverName);
+    delete socket;
+    return nullptr;
+}
+
+void Broker::addConnection()
+{
+    while (auto socket = m_server->nextPendingConnection()) {
+        auto connection = m_connections.emplace_back(std::make_unique<Connection>()).get();
+        connection->socket = socket;
+        connect(socket, &QLocalSocket::readyRead, this, [this, connection]() {
+            readConnection(connection);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, connection]() {
+            removeConnection(connection);
+        });
+        m_idleTimer->stop();
+    }
+}
+
+void Broker::readConnection(Connection *connection)
+{
+    connection->buffer.readFrom(connection->socket);
+    while (auto content = connection->buffer.getNextMessage())
+        handleClientMessage(connection, *content);
+}
+
+void Broker::removeConnection(Connection *connection)
+{
+    // Copy the list, closing a document removes it from the connection
+    const std::vector<std::string> documents(connection->documents.begin(), connection->documents.end());
+    for (const auto &uri : documents)
+        closeDocument(connection, uri);
+
+    // Nobody is waiting for the responses anymore
+    std::erase_if(m_initializeRequests, [connection](const auto &request) {
+        return request.connection == connection;
+    });
+    for (auto it = m_pendingRequests.begin(); it != m_pendingRequests.end();) {
+        if (it->second.connection == connection) {
+            writeMessage(m_process, cancelMessage(it->first));
+            it = m_pendingRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    connection->socket->deleteLater();
+    std::erase_if(m_connections, [connection](const auto &item) {
+        return item.get() == connection;
+    });
+    if (m_connections.empty())
+        m_idleTimer->start();
+}
+
+void Broker::readServer()
+{
+    m_serverBuffer.readFrom(m_process);
+    while (auto content = m_serverBuffer.getNextMessage())
+        handleServerMessage(*content);
+}
+
+void Broker::handleClientMessage(Connection *connection, std::string_view content)
+{
+    MessageFields fields;
+    if (!readFields(content, fields)) {
+        spdlog::error("Broker - invalid message from a knut process");
+        return;
+    }
+    // Knut never answers the server requests
+    if (fields.method.empty())
+        return;
+
+    // Requests
+    if (!fields.id.empty()) {
+        if (fields.method == "initialize") {
+            if (m_initializeResult) {
+                writeMessage(connection->socket, responseMessage(fields.id, *m_initializeResult));
+                return;
+            }
+            m_initializeRequests.push_back({connection, std::string(fields.id)});
+            if (!m_initializeId) {
+                m_initializeId = m_nextId++;
+                writeMessage(m_process, withId(content, fields, std::to_string(*m_initializeId)));
+            }
+            return;
+        }
+        // The server is stopped by the broker, once nobody is using it
+        if (fields.method == "shutdown") {
+            writeMessage(connection->socket, responseMessage(fields.id, "null"));
+            return;
+        }
+        const int id = m_nextId++;
+        m_pendingRequests[id] = {connection, std::string(fields.id)};
+        writeMessage(m_process, withId(content, fields, std::to_string(id)));
+        return;
+    }
+
+    // Notifications
+    if (fields.method == "initialized") {
+        if (m_initialized)
+            return;
+        m_initialized = true;
+    } else if (fields.method == "exit") {
+        return;
+    } else if (fields.method == "textDocument/didOpen") {
+        openDocument(connection, content);
+        return;
+    } else if (fields.method == "textDocument/didClose") {
+        closeDocument(connection, documentUri(content), content);
+        return;
+    } else if (fields.method == "$/cancelRequest") {
+        cancelRequest(connection, content);
+        return;
+    }
+    writeMessage(m_process, content);
+}
+
+void Broker::handleServerMessage(std::string_view content)
+{
+    MessageFields fields;
+    if (!readFields(content, fields)) {
+        spdlog::error("Broker - invalid message from the LSP server");
+        return;
+    }
+
+    // Notifications are sent to everyone, requests from the server are ignored, as knut does
+    if (fields.id.empty()) {
+        for (const auto &connection : m_connections)
+            writeMessage(connection->socket, content);
+        return;
+    }
+    if (!fields.method.empty())
+        return;
+
+    int id = 0;
+    if (std::from_chars(fields.id.data(), fields.id.data() + fields.id.size(), id).ec != std::errc())
+        return;
+
+    if (id == m_initializeId) {
+        // An error is sent to the waiting connections, the next one will try again
+        if (fields.result.empty())
+            m_initializeId.reset();
+        else
+            m_initializeResult = std::string(fields.result);
+        for (const auto &request : std::exchange(m_initializeRequests, {}))
+            writeMessage(request.connection->socket, withId(content, fields, request.id));
+        return;
+    }
+    if (id == m_shutdownId) {
+        writeMessage(m_process, R"({"jsonrpc":"2.0","method":"exit"})");
+        return;
+    }
+
+    auto it = m_pendingRequests.find(id);
+    if (it == m_pendingRequests.end())
+        return;
+    const auto request = std::move(it->second);
+    m_pendingRequests.erase(it);
+    writeMessage(request.connection->socket, withId(content, fields, request.id));
+}
+
+void Broker::openDocument(Connection *connection, std::string_view content)
+{
+    const auto uri = documentUri(content);
+    // Already opened by another knut process: close it first, so the server takes the new text
+    auto &count = m_documents[uri];
+    if (count > 0)
+        writeMessage(m_process, closeMessage(uri));
+    if (connection->documents.insert(uri).second)
+        ++count;
+    writeMessage(m_process, content);
+}
+
+void Broker::closeDocument(Connection *connection, const std::string &uri, std::string_view content)
+{
+    if (!connection->documents.erase(uri))
+        return;
+    auto it = m_documents.find(uri);
+    if (it == m_documents.end())
+        return;
+    // Still opened by another knut process
+    if (--it->second > 0)
+        return;
+    m_documents.erase(it);
+    if (content.empty())
+        writeMessage(m_process, closeMessage(uri));
+    else
+        writeMessage(m_process, content);
+}
+
+void Broker::cancelRequest(Connection *connection, std::string_view content)
+{
+    const auto message = json::parse(content.begin(), content.end(), nullptr, false);
+    if (message.is_discarded() || !message.contains("params") || !message["params"].contains("id"))
+        return;
+    const auto id = message["params"]["id"].dump();
+    for (const auto &[requestId, request] : m_pendingRequests) {
+        if (request.connection == connection && request.id == id) {
+            writeMessage(m_process, cancelMessage(requestId));
+            return;
+        }
+    }
+}
+
+void Broker::stop()
+{
+    spdlog::info("Broker - no connection for {} s, stopping the LSP server",
+                 std::chrono::duration_cast<std::chrono::seconds>(m_idleTimer->intervalAsDuration()).count());
+    m_server->close();
+    m_shutdownId = m_nextId++;
+    writeMessage(m_process, json {{"jsonrpc", "2.0"}, {"id", *m_shutdownId}, {"method", "shutdown"}}.dump());
+    // Don't wait forever for a server not answering
+    QTimer::singleShot(ExitTimeout, m_process, &QProcess::kill);
+}
+
+}
@@ -0,0 +1,118 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "messagebuffer.h"
+
+#include <QObject>
+#include <QStringList>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class QLocalServer;
+class QLocalSocket;
+class QProcess;
+class QTimer;
+
+namespace Lsp {
+
+/**
+ * \brief Shares one LSP server between several knut processes
+ *
+ * The broker runs in its own knut process (`knut --lsp-broker`), started by the first knut process needing the
+ * server, and keeps the server alive between the knut runs, so the server index is only built once. Knut processes
+ * connect to it with a local socket, named after the language, the project root and the server command line.
+ *
+ * Messages are forwarded as they are, only the ids of the requests are changed so they don't clash between the
+ * connections:
+ * - the server is initialized once, the next `initialize` requests get the result of the first one,
+ * - `shutdown` and `exit` are answered by the broker, the server is only stopped once nobody is connected for
+ * `idleTimeout` seconds,
+ * - the documents opened by a connection are closed when it disconnects.
+ */
+class Broker : public QObject
+{
+    Q_OBJECT
+
+public:
+    Broker(QString serverName, QString program, QStringList arguments, int idleTimeout, QObject *parent = nullptr);
+    ~Broker() override;
+
+    // Returns false if the server can't be started, or if another broker is already running
+    bool start();
+
+    static QString serverName(const std::string &language, const QString &rootPath, const QString &program,
+                              const QStringList &arguments);
+    // Connects to the broker, starts it first if it's not running. Returns nullptr if it can't connect.
+    static QLocalSocket *openConnection(const QString &serverName, const QString &program,
+                                        const QStringList &arguments, const QString &rootPath, int idleTimeout,
+                                        QObject *parent = nullptr);
+
+signals:
+    void finished();
+
+private:
+    struct Connection
+    {
+        QLocalSocket *socket = nullptr;
+        MessageBuffer buffer;
+        std::unordered_set<std::string> documents;
+    };
+
+    void addConnection();
+    void readConnection(Connection *connection);
+    void removeConnection(Connection *connection);
+    void readServer();
+
+    void handleClientMessage(Connection *connection, std::string_view content);
+    void handleServerMessage(std::string_view content);
+    void openDocument(Connection *connection, std::string_view content);
+    void closeDocument(Connection *connection, const std::string &uri, std::string_view content = {});
+    void cancelRequest(Connection *connection, std::string_view content);
+    void stop();
+
+private:
+    const QString m_serverName;
+    const QString m_program;
+    const QStringList m_arguments;
+    QLocalServer *m_server = nullptr;
+    QProcess *m_process = nullptr;
+    QTimer *m_idleTimer = nullptr;
+    MessageBuffer m_serverBuffer;
+
+    std::vector<std::unique_ptr<Connection>> m_connections;
+
+    // Requests sent to the server, with the connection and the original id (as json text) to answer
+    struct PendingRequest
+    {
+        Connection *connection = nullptr;
+        std::string id;
+    };
+    std::unordered_map<int, PendingRequest> m_pendingRequests;
+    int m_nextId = 1;
+
+    // The result of the initialize request is kept for the next connections
+    std::optional<int> m_initializeId;
+    std::optional<std::string> m_initializeResult;
+    std::vector<PendingRequest> m_initializeRequests;
+    bool m_initialized = false;
+    std::optional<int> m_shutdownId;
+
+    // Number of connections having opened each document
+    std::unordered_map<std::string, int> m_documents;
+};
+
+}
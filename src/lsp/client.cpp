@@ -14,11 +14,23 @@
 #include "notifications.h"
 #include "requestmessage_json.h"
 #include "types_json.h"
+#include "utils/cancellation.h"
 
 #include <QCoreApplication>
 #include <QDir>
 #include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
 #include <QFileInfo>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QPromise>
+#include <QTimer>
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <memory>
+#include <ranges>
 #include <QUrl>
 
 namespace Lsp {
@@ -58,6 +70,147 @@ std::optional<typename Request::Result> sendRequest(ClientBackend *backend, Requ
     return {};
 }
 
+// Responses are cached until the document changes, several identical requests in a row only do one round trip.
+// Identical requests in flight at the same time are merged by the backend, and wait for the same response.
+static constexpr size_t MaxCachedResults = 1000;
+
+template <typename Request>
+static std::string cacheKey(const Request &request)
+{
+    return request.method + nlohmann::json(request.params).dump();
+}
+
+template <typename Request>
+const typename Request::Result *Client::cachedResult(const std::string &key) const
+{
+    auto it = m_cachedResults.find(key);
+    if (it == m_cachedResults.end())
+        return nullptr;
+    return std::any_cast<typename Request::Result>(&it->second.result);
+}
+
+template <typename Request>
+void Client::cacheResult(std::string key, const std::string &uri, const typename Request::Result &result,
+                         size_t generation)
+{
+    if (generation != m_cacheGeneration)
+        return;
+    if (m_cachedResults.size() >= MaxCachedResults)
+        m_cachedResults.clear();
+    // The symbols of a document don't change when another document is changed, unlike the other results
+    constexpr bool documentOnly = std::is_same_v<Request, TextDocumentDocumentSymbolRequest>;
+    m_cachedResults[std::move(key)] = {uri, documentOnly, result};
+}
+
+void Client::invalidateCache(const std::string &uri)
+{
+    ++m_cacheGeneration;
+    std::erase_if(m_cachedResults, [&uri](const auto &item) {
+        return item.second.uri == uri || !item.second.documentOnly;
+    });
+}
+
+template <typename Request, typename Params>
+std::optional<typename Request::Result>
+Client::sendGenericRequest(bool (Client::*canSend)() const, const char *name, Params &&params,
+                           std::function<void(typename Request::Result)> asyncCallback)
+{
+    if (!waitForInitialized()) {
+        spdlog::error("{} - LSP server not initialized", name);
+        return {};
+    }
+    if (!(this->*canSend)()) {
+        spdlog::error("{} not supported by LSP server", name);
+        return {};
+    }
+
+    Request request;
+    request.params = std::forward<Params>(params);
+
+    auto key = cacheKey(request);
+    if (auto result = cachedResult<Request>(key)) {
+        spdlog::trace("Cached response for request {}", request.method);
+        if (asyncCallback) {
+            asyncCallback(*result);
+            return {};
+        }
+        return *result;
+    }
+
+    request.id = m_nextRequestId++;
+    const auto uri = request.params.textDocument.uri;
+    useDocument(uri);
+    const auto generation = m_cacheGeneration;
+    if (asyncCallback) {
+        QPointer<Client> safeThis(this);
+        auto callback = [safeThis, key = std::move(key), uri, generation, asyncCallback = std::move(asyncCallback)](
+                            typename Request::Result result) mutable {
+            if (safeThis)
+                safeThis->cacheResult<Request>(std::move(key), uri, result, generation);
+            asyncCallback(std::move(result));
+        };
+        return sendRequest(m_backend, request, std::function<void(typename Request::Result)>(std::move(callback)));
+    }
+
+    auto result = sendRequest(m_backend, request, {});
+    if (result)
+        cacheResult<Request>(std::move(key), uri, *result, generation);
+    return result;
+}
+
+template <typename Request, typename Params>
+RequestFuture<Request> Client::sendFutureRequest(bool (Client::*canSend)() const, const char *name, Params &&params)
+{
+    using Result = std::optional<typename Request::Result>;
+    auto promise = std::make_shared<QPromise<Result>>();
+    auto future = promise->future();
+    promise->start();
+
+    if (!waitForInitialized() || !(this->*canSend)()) {
+        spdlog::error("{} not supported by LSP server", name);
+        promise->addResult(Result {});
+        promise->finish();
+        return future;
+    }
+
+    Request request;
+    request.params = std::forward<Params>(params);
+
+    auto key = cacheKey(request);
+    if (auto result = cachedResult<Request>(key)) {
+        promise->addResult(Result {*result});
+        promise->finish();
+        return future;
+    }
+    request.id = m_nextRequestId++;
+    useDocument(request.params.textDocument.uri);
+
+    QPointer<Client> safeThis(this);
+    auto requestCallback = [promise, safeThis, key = std::move(key), uri = request.params.textDocument.uri,
+                            generation = m_cacheGeneration,
+                            method = request.method](typename Request::Response response) mutable {
+        if (!response.isValid() || response.error) {
+            spdlog::warn("Response error for request {} - {}", method, response.error ? response.error->message : "");
+            promise->addResult(Result {});
+        } else {
+            if (safeThis && response.result)
+                safeThis->cacheResult<Request>(std::move(key), uri, *response.result, generation);
+            promise->addResult(std::move(response.result));
+        }
+        promise->finish();
+    };
+    const auto handle = m_backend->sendAsyncRequest(request, requestCallback);
+
+    // Cancelling the future cancels the request on the server
+    auto watcher = new QFutureWatcher<Result>(this);
+    connect(watcher, &QFutureWatcherBase::canceled, m_backend, [backend = m_backend, handle]() {
+        backend->cancelRequest(handle);
+    });
+    connect(watcher, &QFutureWatcherBase::finished, watcher, &QObject::deleteLater);
+    watcher->setFuture(future);
+    return future;
+}
+
 Client::Client(std::string languageId, QString program, QStringList arguments, QObject *parent)
     : QObject(parent)
     , m_languageId(std::move(languageId))
@@ -69,6 +222,12 @@ Client::Client(std::string languageId, QString program, QStringList arguments, Q
     connect(m_backend, &ClientBackend::finished, this, [this]() {
         setState(Shutdown);
     });
+    m_backend->setRequestHandler(WorkDoneProgressCreateName, [this](std::string_view content) {
+        return createProgress(content);
+    });
+    m_backend->setNotificationHandler(ProgressName, [this](std::string_view content) {
+        updateProgress(content);
+    });
 }
 
 Client::~Client() = default;
@@ -78,13 +237,135 @@ std::string Client::languageId() const
     return m_languageId;
 }
 
+void Client::useBroker(const QString &rootPath, int idleTimeout)
+{
+    Q_ASSERT(m_state == Uninitialized);
+    m_backend->useBroker(m_languageId, rootPath, idleTimeout);
+}
+
 bool Client::initialize(const QString &rootPath)
 {
     if (!m_backend->start())
         return false;
 
     spdlog::debug("LSP server started in: {}", rootPath);
+    return initializeCallback(m_backend->sendRequest(initializeRequest(rootPath)));
+}
+
+void Client::initializeAsync(const QString &rootPath)
+{
+    Q_ASSERT(m_state == Uninitialized);
+    setState(Initializing);
+    m_backend->startAsync();
+
+    spdlog::debug("LSP server starting in the background in: {}", rootPath);
+    m_backend->sendAsyncRequest(initializeRequest(rootPath), [this](InitializeRequest::Response response) {
+        initializeCallback(std::move(response));
+    });
+}
+
+bool Client::waitForInitialized()
+{
+    if (m_state == Initializing) {
+        QElapsedTimer time;
+        time.start();
+        // The loop is left on Initialized, but also on Error if the server can't start, or if the script is aborted
+        QEventLoop loop;
+        connect(this, &Client::stateChanged, &loop, &QEventLoop::quit);
+        Utils::Cancellation::quitOnCancel(loop);
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+        spdlog::trace("{} ms waiting for the LSP server initialization", static_cast<int>(time.elapsed()));
+    }
+    return m_state == Initialized;
+}
+
+bool Client::isIndexReady() const
+{
+    return m_state == Initialized && m_progress.empty();
+}
+
+bool Client::waitForIndexReady(int timeout)
+{
+    if (!waitForInitialized())
+        return false;
+    if (isIndexReady() || timeout <= 0)
+        return isIndexReady();
+
+    QElapsedTimer time;
+    time.start();
+    // The loop is also left if the server stops, or if the script is aborted
+    QEventLoop loop;
+    connect(this, &Client::indexReadyChanged, &loop, &QEventLoop::quit);
+    connect(this, &Client::stateChanged, &loop, &QEventLoop::quit);
+    QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+    Utils::Cancellation::quitOnCancel(loop);
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+    spdlog::debug("{} ms waiting for the LSP server index", static_cast<int>(time.elapsed()));
+    return isIndexReady();
+}
+
+void Client::setIndexTimeout(int timeout)
+{
+    m_indexTimeout = timeout;
+}
+
+nlohmann::json Client::createProgress(std::string_view content)
+{
+    const bool wasReady = isIndexReady();
+    auto request = nlohmann::json::parse(content, nullptr, false);
+    if (request.is_discarded() || !request.contains("params"))
+        return nullptr;
+    WorkDoneProgressCreateParams params;
+    try {
+        request.at("params").get_to(params);
+    } catch (...) {
+        spdlog::warn("Client::createProgress - invalid params for {}", WorkDoneProgressCreateName);
+        return nullptr;
+    }
+    m_progress.try_emplace(params.token);
+    if (wasReady)
+        emit indexReadyChanged(false);
+    return nullptr;
+}
 
+void Client::updateProgress(std::string_view content)
+{
+    auto notification = nlohmann::json::parse(content, nullptr, false);
+    if (notification.is_discarded() || !notification.contains("params"))
+        return;
+    ProgressParams params;
+    try {
+        notification.at("params").get_to(params);
+    } catch (...) {
+        spdlog::warn("Client::updateProgress - invalid params for {}", ProgressName);
+        return;
+    }
+    if (const auto *token = std::get_if<std::string>(&params.token)) {
+        if (m_workspaceSymbolSearches.contains(*token)) {
+            addWorkspaceSymbols(*token, params.value);
+            return;
+        }
+    }
+
+    // Work done progress created by the server
+    auto it = m_progress.find(params.token);
+    if (it == m_progress.end() || !params.value.is_object())
+        return;
+
+    const auto kind = params.value.value("kind", std::string());
+    if (kind == WorkDoneProgressBegin::kind) {
+        it->second = params.value.value("title", std::string());
+        spdlog::debug("LSP server {}: started {}", m_languageId, it->second);
+    } else if (kind == WorkDoneProgressEnd::kind) {
+        spdlog::debug("LSP server {}: finished {}", m_languageId, it->second);
+        m_progress.erase(it);
+        if (isIndexReady())
+            emit indexReadyChanged(true);
+    }
+}
+
+InitializeRequest Client::initializeRequest(const QString &rootPath)
+{
     InitializeRequest request;
     request.id = m_nextRequestId++;
     request.params.processId = static_cast<int>(QCoreApplication::applicationPid());
@@ -97,6 +378,13 @@ bool Client::initialize(const QString &rootPath)
         request.params.capabilities.workspace = workspaceCapabilities;
     }
 
+    // Window capabilities, the progress is used to know when the index is ready
+    {
+        WindowClientCapabilities windowCapabilities;
+        windowCapabilities.workDoneProgress = true;
+        request.params.capabilities.window = windowCapabilities;
+    }
+
     // TextDocument capabilities
     {
         TextDocumentSyncClientCapabilities synchronization;
@@ -140,8 +428,7 @@ bool Client::initialize(const QString &rootPath)
         std::vector<WorkspaceFolder> wsf = {{toDocumentUri(rootPath), fi.baseName().toStdString()}};
         request.params.workspaceFolders = wsf;
     }
-
-    return initializeCallback(m_backend->sendRequest(request));
+    return request;
 }
 
 bool Client::shutdown()
@@ -152,6 +439,18 @@ bool Client::shutdown()
     return shutdownCallback(m_backend->sendRequest(request));
 }
 
+void Client::shutdownAsync()
+{
+    Q_ASSERT(m_state == Initialized);
+    ShutdownRequest request;
+    request.id = m_nextRequestId++;
+    // The server handles the messages in order, exit is only read once shutdown is done
+    m_backend->sendAsyncRequest(request, {});
+    m_backend->sendNotification(ExitNotification());
+    spdlog::debug("LSP server exiting");
+    setState(Shutdown);
+}
+
 void Client::openProject(const QString &rootPath)
 {
     Q_ASSERT(m_state == Initialized);
@@ -176,21 +475,39 @@ void Client::closeProject(const QString &rootPath)
     m_backend->sendNotification(notification);
 }
 
-void Client::didOpen(DidOpenTextDocumentParams &&params)
+void Client::didOpen(DidOpenTextDocumentParams &&params, ReopenFunction reopen)
 {
+    invalidateCache(params.textDocument.uri);
     if (!canSendOpenCloseChanges())
         return;
 
+    const auto uri = params.textDocument.uri;
+    auto it = m_openDocuments.find(uri);
+    if (it == m_openDocuments.end() || !it->second.opened)
+        ++m_openedCount;
+    m_openDocuments[uri] = {std::move(reopen), true, ++m_useCounter};
+
     TextDocumentDidOpenNotification notification;
     notification.params = std::move(params);
     m_backend->sendNotification(notification);
+    closeLeastRecentlyUsedDocuments(uri);
 }
 
 void Client::didClose(DidCloseTextDocumentParams &&params)
 {
+    invalidateCache(params.textDocument.uri);
     if (!canSendOpenCloseChanges())
         return;
 
+    if (auto it = m_openDocuments.find(params.textDocument.uri); it != m_openDocuments.end()) {
+        const bool opened = it->second.opened;
+        m_openDocuments.erase(it);
+        // Already closed on the server
+        if (!opened)
+            return;
+        --m_openedCount;
+    }
+
     TextDocumentDidCloseNotification notification;
     notification.params = std::move(params);
     m_backend->sendNotification(notification);
@@ -198,14 +515,92 @@ void Client::didClose(DidCloseTextDocumentParams &&params)
 
 void Client::didChange(DidChangeTextDocumentParams &&params)
 {
+    invalidateCache(params.textDocument.uri);
     if (!canSendOpenCloseChanges())
         return;
 
+    // The whole text is sent when the document is opened again
+    if (auto it = m_openDocuments.find(params.textDocument.uri); it != m_openDocuments.end()) {
+        if (!it->second.opened)
+            return;
+        it->second.lastUse = ++m_useCounter;
+    }
+
     TextDocumentDidChangeNotification notification;
     notification.params = std::move(params);
     m_backend->sendNotification(notification);
 }
 
+void Client::setMaxOpenDocuments(int count)
+{
+    m_maxOpenDocuments = count;
+}
+
+void Client::setShards(std::vector<Client *> shards)
+{
+    std::erase(shards, this);
+    m_shards = std::move(shards);
+}
+
+qint64 Client::bufferSize() const
+{
+    qint64 size = m_backend->bufferSize();
+    for (const auto &[key, cachedResult] : m_cachedResults)
+        size += static_cast<qint64>(sizeof(CachedResult) + key.capacity() + cachedResult.uri.capacity());
+    for (const auto &uri : m_openDocuments | std::views::keys)
+        size += static_cast<qint64>(sizeof(OpenDocument) + uri.capacity());
+    return size;
+}
+
+void Client::useDocument(const std::string &uri)
+{
+    auto it = m_openDocuments.find(uri);
+    if (it == m_openDocuments.end())
+        return;
+    it->second.lastUse = ++m_useCounter;
+    if (it->second.opened)
+        return;
+
+    auto params = it->second.reopen();
+    if (!params) {
+        m_openDocuments.erase(it);
+        return;
+    }
+    spdlog::debug("Client::useDocument - opening {} again", uri);
+    it->second.opened = true;
+    ++m_openedCount;
+    TextDocumentDidOpenNotification notification;
+    notification.params = std::move(*params);
+    m_backend->sendNotification(notification);
+    closeLeastRecentlyUsedDocuments(uri);
+}
+
+void Client::closeLeastRecentlyUsedDocuments(const std::string &keep)
+{
+    if (m_maxOpenDocuments <= 0)
+        return;
+
+    while (m_openedCount > m_maxOpenDocuments) {
+        // Only the documents which can be opened again are closed
+        auto oldest = m_openDocuments.end();
+        for (auto it = m_openDocuments.begin(); it != m_openDocuments.end(); ++it) {
+            const auto &document = it->second;
+            if (document.opened && document.reopen && it->first != keep
+                && (oldest == m_openDocuments.end() || document.lastUse < oldest->second.lastUse))
+                oldest = it;
+        }
+        if (oldest == m_openDocuments.end())
+            return;
+
+        spdlog::debug("Client::closeLeastRecentlyUsedDocuments - closing {} on the server", oldest->first);
+        oldest->second.opened = false;
+        --m_openedCount;
+        TextDocumentDidCloseNotification notification;
+        notification.params.textDocument.uri = oldest->first;
+        m_backend->sendNotification(notification);
+    }
+}
+
 std::optional<TextDocumentDocumentSymbolRequest::Result>
 Client::documentSymbol(DocumentSymbolParams &&params,
                        std::function<void(TextDocumentDocumentSymbolRequest::Result)> asyncCallback)
@@ -233,8 +628,232 @@ std::optional<TextDocumentReferencesRequest::Result>
 Client::references(ReferenceParams &&params,
                    std::function<void(TextDocumentReferencesRequest::Result)> asyncCallback /* = {} */)
 {
-    return sendGenericRequest<TextDocumentReferencesRequest>(&Client::canSendReferences, TextDocumentReferencesName,
-                                                             std::move(params), asyncCallback);
+    // The references are only complete once the project is indexed
+    if (!asyncCallback && m_indexTimeout > 0 && !waitForIndexReady(m_indexTimeout))
+        spdlog::warn("Client::references - the LSP server index is not ready after {} ms", m_indexTimeout);
+
+    if (asyncCallback || m_shards.empty()) {
+        return sendGenericRequest<TextDocumentReferencesRequest>(&Client::canSendReferences,
+                                                                 TextDocumentReferencesName, std::move(params),
+                                                                 asyncCallback);
+    }
+
+    const ReferenceParams shardParams = params;
+    auto result = sendGenericRequest<TextDocumentReferencesRequest>(
+        &Client::canSendReferences, TextDocumentReferencesName, std::move(params), asyncCallback);
+    if (!result)
+        return result;
+    auto *locations = std::get_if<std::vector<Location>>(&*result);
+    if (!locations)
+        return result;
+
+    // Locations in headers shared between the shards are found several times
+    auto sameLocation = [](const Location &lhs, const Location &rhs) {
+        return lhs.uri == rhs.uri && lhs.range.start.line == rhs.range.start.line
+            && lhs.range.start.character == rhs.range.start.character && lhs.range.end.line == rhs.range.end.line
+            && lhs.range.end.character == rhs.range.end.character;
+    };
+    for (auto shard : m_shards) {
+        auto shardResult = shard->shardReferences(shardParams);
+        if (!shardResult)
+            continue;
+        if (const auto *shardLocations = std::get_if<std::vector<Location>>(&*shardResult)) {
+            for (const auto &location : *shardLocations) {
+                if (std::ranges::none_of(*locations, [&](const Location &other) {
+                        return sameLocation(location, other);
+                    }))
+                    locations->push_back(location);
+            }
+        }
+    }
+    return result;
+}
+
+std::optional<TextDocumentReferencesRequest::Result> Client::shardReferences(const ReferenceParams &params)
+{
+    if (m_state != Initialized || !canSendReferences())
+        return {};
+
+    // The document is opened with its content on disk, unsaved changes are only known by the owning shard
+    const auto &uri = params.textDocument.uri;
+    const bool opened = m_openDocuments.contains(uri);
+    if (!opened && canSendOpenCloseChanges()) {
+        QFile file(QUrl(QString::fromStdString(uri)).toLocalFile());
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+            return {};
+        TextDocumentDidOpenNotification notification;
+        notification.params.textDocument.uri = uri;
+        notification.params.textDocument.version = 0;
+        notification.params.textDocument.text = file.readAll().toStdString();
+        notification.params.textDocument.languageId = m_languageId;
+        m_backend->sendNotification(notification);
+    }
+
+    // Not cached, the changes made in the other shards don't invalidate this cache
+    TextDocumentReferencesRequest request;
+    request.id = m_nextRequestId++;
+    request.params = params;
+    auto result = sendRequest(m_backend, request, {});
+
+    if (!opened && canSendOpenCloseChanges()) {
+        TextDocumentDidCloseNotification notification;
+        notification.params.textDocument.uri = uri;
+        m_backend->sendNotification(notification);
+    }
+    return result;
+}
+
+RequestFuture<TextDocumentDocumentSymbolRequest> Client::documentSymbolAsync(DocumentSymbolParams &&params)
+{
+    return sendFutureRequest<TextDocumentDocumentSymbolRequest>(&Client::canSendDocumentSymbol,
+                                                                TextDocumentDocumentSymbolName, std::move(params));
+}
+
+RequestFuture<TextDocumentDeclarationRequest> Client::declarationAsync(DeclarationParams &&params)
+{
+    return sendFutureRequest<TextDocumentDeclarationRequest>(&Client::canSendDeclaration, TextDocumentDeclarationName,
+                                                             std::move(params));
+}
+
+RequestFuture<TextDocumentHoverRequest> Client::hoverAsync(HoverParams &&params)
+{
+    return sendFutureRequest<TextDocumentHoverRequest>(&Client::canSendHover, TextDocumentHoverName, std::move(params));
+}
+
+RequestFuture<TextDocumentReferencesRequest> Client::referencesAsync(ReferenceParams &&params)
+{
+    return sendFutureRequest<TextDocumentReferencesRequest>(&Client::canSendReferences, TextDocumentReferencesName,
+                                                            std::move(params));
+}
+
+static std::string workspaceSymbolKey(const std::string &query)
+{
+    return WorkspaceSymbolName + query;
+}
+
+// The servers may answer with the older SymbolInformation, or with WorkspaceSymbol, whose range is optional
+static std::vector<SymbolInformation> toSymbolInformation(WorkspaceSymbolRequest::Result &&result)
+{
+    if (auto symbols = std::get_if<std::vector<SymbolInformation>>(&result))
+        return std::move(*symbols);
+    std::vector<SymbolInformation> symbols;
+    if (auto workspaceSymbols = std::get_if<std::vector<WorkspaceSymbol>>(&result)) {
+        symbols.reserve(workspaceSymbols->size());
+        for (auto &workspaceSymbol : *workspaceSymbols) {
+            SymbolInformation &symbol = symbols.emplace_back();
+            if (auto location = std::get_if<Location>(&workspaceSymbol.location))
+                symbol.location = std::move(*location);
+            else
+                symbol.location.uri = std::get<WorkspaceSymbol::LocationType>(workspaceSymbol.location).uri;
+            static_cast<BaseSymbolInformation &>(symbol) = std::move(workspaceSymbol);
+        }
+    }
+    return symbols;
+}
+
+int Client::workspaceSymbol(const std::string &query, WorkspaceSymbolCallback callback)
+{
+    if (!waitForInitialized() || !canSendWorkspaceSymbol()) {
+        spdlog::error("{} not supported by LSP server", WorkspaceSymbolName);
+        callback({}, true);
+        return 0;
+    }
+
+    const auto key = workspaceSymbolKey(query);
+    if (auto it = m_cachedResults.find(key); it != m_cachedResults.end()) {
+        spdlog::trace("Cached response for request {}", WorkspaceSymbolName);
+        callback(std::any_cast<std::vector<SymbolInformation>>(it->second.result), true);
+        return 0;
+    }
+
+    const int id = m_nextSearchId++;
+    std::string token = "knut/workspaceSymbol/" + std::to_string(id);
+    WorkspaceSymbolRequest request;
+    request.id = m_nextRequestId++;
+    request.params.query = query;
+    request.params.partialResultToken = token;
+
+    auto &search = m_workspaceSymbolSearches[token];
+    search.query = query;
+    search.callback = std::move(callback);
+    search.handle = m_backend->sendAsyncRequest(request, [this, token](WorkspaceSymbolRequest::Response response) {
+        auto it = m_workspaceSymbolSearches.find(token);
+        if (it == m_workspaceSymbolSearches.end())
+            return;
+        auto search = std::move(it->second);
+        m_workspaceSymbolSearches.erase(it);
+
+        // Once partial results have been sent, the response has no result
+        std::vector<SymbolInformation> symbols;
+        if (!response.isValid() || response.error) {
+            spdlog::warn("Response error for request {} - {}", WorkspaceSymbolName,
+                         response.error ? response.error->message : "");
+        } else {
+            symbols = toSymbolInformation(std::move(*response.result));
+            search.symbols.insert(search.symbols.end(), symbols.begin(), symbols.end());
+            if (m_cachedResults.size() >= MaxCachedResults)
+                m_cachedResults.clear();
+            m_cachedResults[workspaceSymbolKey(search.query)] = {{}, false, std::move(search.symbols)};
+        }
+        search.callback(std::move(symbols), true);
+    });
+    return id;
+}
+
+void Client::addWorkspaceSymbols(const std::string &token, const nlohmann::json &value)
+{
+    WorkspaceSymbolRequest::Result result;
+    try {
+        value.get_to(result);
+    } catch (...) {
+        spdlog::warn("Client::addWorkspaceSymbols - invalid partial result for {}", WorkspaceSymbolName);
+        return;
+    }
+    auto symbols = toSymbolInformation(std::move(result));
+    auto &search = m_workspaceSymbolSearches.at(token);
+    search.symbols.insert(search.symbols.end(), symbols.begin(), symbols.end());
+    // The callback may cancel the request, or send another one
+    auto callback = search.callback;
+    callback(std::move(symbols), false);
+}
+
+void Client::cancelWorkspaceSymbol(int id)
+{
+    auto it = m_workspaceSymbolSearches.find("knut/workspaceSymbol/" + std::to_string(id));
+    if (it == m_workspaceSymbolSearches.end())
+        return;
+    const int handle = it->second.handle;
+    m_workspaceSymbolSearches.erase(it);
+    m_backend->cancelRequest(handle);
+}
+
+std::vector<SymbolInformation> Client::cachedWorkspaceSymbols(const std::string &query) const
+{
+    auto toLower = [](char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    };
+    // Same as the fuzzy match of the servers: the characters of the query appear in order in the name
+    auto matches = [&](const std::string &name) {
+        size_t next = 0;
+        for (const char c : name) {
+            if (next < query.size() && toLower(c) == toLower(query[next]))
+                ++next;
+        }
+        return next == query.size();
+    };
+
+    for (size_t length = query.size(); length > 0; --length) {
+        auto it = m_cachedResults.find(workspaceSymbolKey(query.substr(0, length)));
+        if (it == m_cachedResults.end())
+            continue;
+        const auto &symbols = std::any_cast<const std::vector<SymbolInformation> &>(it->second.result);
+        std::vector<SymbolInformation> result;
+        std::ranges::copy_if(symbols, std::back_inserter(result), [&](const SymbolInformation &symbol) {
+            return matches(symbol.name);
+        });
+        return result;
+    }
+    return {};
 }
 
 std::string Client::toUri(const QString &path)
@@ -347,4 +966,9 @@ bool Client::canSendReferences() const
     return canSend<ReferenceOptions>(&Lsp::ServerCapabilities::referencesProvider);
 }
 
+bool Client::canSendWorkspaceSymbol() const
+{
+    return canSend<WorkspaceSymbolOptions>(&Lsp::ServerCapabilities::workspaceSymbolProvider);
+}
+
 } // namespace Lsp
@@ -14,13 +14,23 @@
 #include "types.h"
 #include "utils/log.h"
 
+#include <QFuture>
 #include <QObject>
+#include <any>
+#include <functional>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace Lsp {
 
 class ClientBackend;
 
+// Future returned by the future-based requests, an empty optional means there was an error.
+template <typename Request>
+using RequestFuture = QFuture<std::optional<typename Request::Result>>;
+
 class Client : public QObject
 {
     Q_OBJECT
@@ -28,6 +38,7 @@ class Client : public QObject
 public:
     enum State {
         Uninitialized,
+        Initializing,
         Initialized,
         Shutdown,
         Error,
@@ -38,8 +49,45 @@ public:
 
     std::string languageId() const;
 
+    /**
+     * Uses a server shared with the other knut processes, kept alive by a broker, see Broker.
+     * Must be called before initializing the client.
+     */
+    void useBroker(const QString &rootPath, int idleTimeout);
+
     bool initialize(const QString &rootPath = {});
+    /**
+     * Starts and initializes the server in the background, the state is Initializing until the server has answered.
+     * Requests sent in the meantime wait for the initialization to be done.
+     */
+    void initializeAsync(const QString &rootPath = {});
+    /**
+     * Waits for a server started with initializeAsync, returns true if the server is initialized.
+     */
+    bool waitForInitialized();
+
+    /**
+     * True once the server is initialized and has no work in progress, like the background index of clangd
+     *
+     * The work is reported by the server with `$/progress` notifications, for the tokens it creates with
+     * `window/workDoneProgress/create`. A server which doesn't report its work is ready once initialized.
+     */
+    bool isIndexReady() const;
+    /**
+     * Waits for the index to be ready, at most timeout milliseconds, returns true if it's ready.
+     */
+    bool waitForIndexReady(int timeout);
+    /**
+     * The synchronous `references` requests wait for the index to be ready first, at most timeout milliseconds.
+     * 0, the default, doesn't wait.
+     */
+    void setIndexTimeout(int timeout);
     bool shutdown();
+    /**
+     * Sends the shutdown request and the exit notification without waiting for the server, which exits in the
+     * background once the client is deleted.
+     */
+    void shutdownAsync();
 
     /**
      * Opens a new project, this will add a new workspace on the server
@@ -52,8 +100,13 @@ public:
 
     /**
      * Sends the didOpen notification, when a document has been opened
+     *
+     * If reopen is set, the document may be closed on the server once more than maxOpenDocuments are opened, the
+     * least recently used first. It's opened again with the parameters returned by reopen when a request needs it, and
+     * the changes are not sent in the meantime.
      */
-    void didOpen(DidOpenTextDocumentParams &&params);
+    using ReopenFunction = std::function<std::optional<DidOpenTextDocumentParams>()>;
+    void didOpen(DidOpenTextDocumentParams &&params, ReopenFunction reopen = {});
     /**
      * Sends the didClose notification, when a document has been closed
      */
@@ -70,6 +123,24 @@ public:
      */
     bool canSendDocumentChanges(TextDocumentSyncKind kind) const;
 
+    /**
+     * Maximum number of documents opened on the server, 0 means no limit
+     */
+    void setMaxOpenDocuments(int count);
+
+    /**
+     * Other clients for the same language, each serving one part of a large workspace
+     *
+     * The documents are only opened on the client owning them, but the synchronous workspace-wide requests
+     * (`references`) are also sent to the other shards, and the results merged.
+     */
+    void setShards(std::vector<Client *> shards);
+
+    /**
+     * Approximate memory used by the client: the message buffers, and the keys of the cached responses
+     */
+    qint64 bufferSize() const;
+
     /**
      * ##### LSP requests #####
      * If asyncCallback is not null, the request will be sent asynchronously and the callback called once the response
@@ -90,17 +161,53 @@ public:
     std::optional<TextDocumentReferencesRequest::Result>
     references(ReferenceParams &&params, std::function<void(TextDocumentReferencesRequest::Result)> asyncCallback = {});
 
+    /**
+     * ##### Future-based LSP requests #####
+     * The request is sent immediately, and the future is finished once the response has arrived. Several requests can
+     * be in flight at the same time, identical requests share the same response.
+     * Cancelling the future cancels the request on the server.
+     */
+    RequestFuture<TextDocumentDocumentSymbolRequest> documentSymbolAsync(DocumentSymbolParams &&params);
+    RequestFuture<TextDocumentDeclarationRequest> declarationAsync(DeclarationParams &&params);
+    RequestFuture<TextDocumentHoverRequest> hoverAsync(HoverParams &&params);
+    RequestFuture<TextDocumentReferencesRequest> referencesAsync(ReferenceParams &&params);
+
+    /**
+     * ##### Streamed LSP requests #####
+     * Sends a `workspace/symbol` request with a partial result token: callback is called with each part of the
+     * results, as soon as the server sends it, and a last time with done set. Servers which don't stream their results
+     * send them all with the response.
+     *
+     * The complete results are cached by query until a document changes. If they are cached, or if the server doesn't
+     * support the request, the callback is called before returning 0. Otherwise, returns an id for
+     * cancelWorkspaceSymbol.
+     */
+    using WorkspaceSymbolCallback = std::function<void(std::vector<SymbolInformation> symbols, bool done)>;
+    int workspaceSymbol(const std::string &query, WorkspaceSymbolCallback callback);
+    // Cancels the request on the server, its callback is not called anymore
+    void cancelWorkspaceSymbol(int id);
+    /**
+     * Returns the symbols matching query in the cached results of its longest prefix, to show while the request for
+     * query is in flight: the query of a search field grows one character at a time.
+     */
+    std::vector<SymbolInformation> cachedWorkspaceSymbols(const std::string &query) const;
+
     State state() const { return m_state; }
 
     static std::string toUri(const QString &path);
 
 signals:
     void stateChanged(Lsp::Client::State state);
+    void indexReadyChanged(bool ready);
 
 private:
     void setState(State newState);
+    InitializeRequest initializeRequest(const QString &rootPath);
     bool initializeCallback(InitializeRequest::Response response);
     bool shutdownCallback(ShutdownRequest::Response response);
+    nlohmann::json createProgress(std::string_view content);
+    void updateProgress(std::string_view content);
+    void addWorkspaceSymbols(const std::string &token, const nlohmann::json &value);
 
     bool canSendWorkspaceFoldersChanges() const;
     bool canSendOpenCloseChanges() const;
@@ -108,23 +215,30 @@ private:
     bool canSendDeclaration() const;
     bool canSendHover() const;
     bool canSendReferences() const;
+    bool canSendWorkspaceSymbol() const;
 
+    // Defined in client.cpp, as they are only used there
     template <typename Request, typename Params>
     std::optional<typename Request::Result>
     sendGenericRequest(bool (Client::*canSend)() const, const char *name, Params &&params,
-                       std::function<void(typename Request::Result)> asyncCallback)
-    {
-        if (!(this->*canSend)()) {
-            spdlog::error("{} not supported by LSP server", name);
-            return {};
-        }
+                       std::function<void(typename Request::Result)> asyncCallback);
+    template <typename Request, typename Params>
+    RequestFuture<Request> sendFutureRequest(bool (Client::*canSend)() const, const char *name, Params &&params);
 
-        Request request;
-        request.id = m_nextRequestId++;
-        request.params = std::forward<Params>(params);
+    // Cache of the responses, see sendGenericRequest
+    template <typename Request>
+    const typename Request::Result *cachedResult(const std::string &key) const;
+    template <typename Request>
+    void cacheResult(std::string key, const std::string &uri, const typename Request::Result &result,
+                     size_t generation);
+    void invalidateCache(const std::string &uri);
 
-        return sendRequest(m_backend, request, asyncCallback);
-    }
+    // Opens the document again on the server if it has been closed, see didOpen
+    void useDocument(const std::string &uri);
+    void closeLeastRecentlyUsedDocuments(const std::string &keep);
+
+    // Sends a request for a document owned by another shard, see setShards
+    std::optional<TextDocumentReferencesRequest::Result> shardReferences(const ReferenceParams &params);
 
     template <typename Options, typename Variant>
     bool canSend(Variant Lsp::ServerCapabilities::*pProvider) const
@@ -146,6 +260,48 @@ private:
     State m_state = Uninitialized;
 
     ServerCapabilities m_serverCapabilities;
+
+    struct CachedResult
+    {
+        std::string uri;
+        // The result only depends on the document itself, and not on the other documents of the project
+        bool documentOnly = false;
+        std::any result;
+    };
+    // The key is the method and the parameters of the request
+    std::unordered_map<std::string, CachedResult> m_cachedResults;
+    // Incremented each time a document changes: a response to a request sent before is not cached, it may be outdated
+    size_t m_cacheGeneration = 0;
+
+    struct OpenDocument
+    {
+        ReopenFunction reopen;
+        // False if the document has been closed on the server, to open fewer documents
+        bool opened = true;
+        quint64 lastUse = 0;
+    };
+    std::unordered_map<std::string, OpenDocument> m_openDocuments;
+    int m_maxOpenDocuments = 0;
+    int m_openedCount = 0;
+    quint64 m_useCounter = 0;
+
+    std::vector<Client *> m_shards;
+
+    // Work in progress on the server, with its title, from its creation to its end
+    std::unordered_map<ProgressToken, std::string> m_progress;
+    int m_indexTimeout = 0;
+
+    // Streamed workspace/symbol requests in flight, by partial result token
+    struct WorkspaceSymbolSearch
+    {
+        std::string query;
+        int handle = 0;
+        WorkspaceSymbolCallback callback;
+        // All the symbols received so far, cached once the request is done
+        std::vector<SymbolInformation> symbols;
+    };
+    std::unordered_map<std::string, WorkspaceSymbolSearch> m_workspaceSymbolSearches;
+    int m_nextSearchId = 1;
 };
 
 } // namespace Lsp
@@ -9,17 +9,25 @@
 */
 
 #include "clientbackend.h"
+#include "broker.h"
 #include "notificationmessage_json.h"
 #include "notifications.h"
 #include "requestmessage_json.h"
+#include "requestprofiler.h"
 #include "requests.h"
 #include "types_json.h"
+#include "utils/cancellation.h"
+#include "utils/trace.h"
 
-#include <QBuffer>
+#include <QCoreApplication>
 #include <QEventLoop>
+#include <QLocalSocket>
 #include <QString>
+#include <QTimer>
 #include <QtEnvironmentVariables>
+#include <algorithm>
 #include <ctime>
+#include <string_view>
 #include <spdlog/sinks/basic_file_sink.h>
 
 using json = nlohmann::json;
@@ -28,29 +36,12 @@ namespace Lsp {
 
 // Create a new LSP message to send
 // Return the message to send, with the header + content
-static QByteArray toMessage(const json &content)
-{
-    const QByteArray data = QByteArray::fromStdString(content.dump());
-    const int length = data.size();
-
-    // https://microsoft.github.io/language-server-protocol/specifications/specification-current/#headerPart
-    // The content-type is optional, and only UTF-8 is accepted for the charset
-    // Content-Length: ...\r\n
-    // Content-Type: application/vscode-jsonrpc; charset=utf-8\r\n
-    // \r\n
-    // {
-    //     ~~~
-    // }
-    const QString header = QString("Content-Length: %1\r\n\r\n").arg(length);
-
-    return header.toLatin1() + data;
-}
-
 ClientBackend::ClientBackend(const std::string &language, QString program, QStringList arguments, QObject *parent)
     : QObject(parent)
     , m_program(std::move(program))
     , m_arguments(std::move(arguments))
     , m_process(new QProcess(this))
+    , m_device(m_process)
 {
     if (!qEnvironmentVariable("KNUT_LOG_LSP").isEmpty()) {
         const auto serverLogName = language + "_server";
@@ -70,25 +61,84 @@ ClientBackend::ClientBackend(const std::string &language, QString program, QStri
         }
     }
 
+    bool ok = false;
+    const int traceSize = qEnvironmentVariableIntValue("KNUT_TRACE_LSP", &ok);
+    if (ok && traceSize > 0) {
+        m_trace = std::make_unique<MessageTrace>(traceSize);
+        m_traceFileName = QString::fromStdString(language + "_trace.bin");
+    }
+
     connect(m_process, &QProcess::readyReadStandardError, this, &ClientBackend::readError);
     connect(m_process, &QProcess::readyReadStandardOutput, this, &ClientBackend::readOutput);
     connect(m_process, &QProcess::errorOccurred, this, &ClientBackend::handleError);
     connect(m_process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, &ClientBackend::handleFinished);
 }
 
+// Time given to the server to exit by itself once its backend is deleted, before being terminated
+static constexpr int ReapTimeout = 2000;
+
+// Lets the server exit in the background, instead of blocking the deletion of the backend: the shutdown and exit
+// messages already written are sent from the event loop. The process is killed when the application quits.
+static void reapProcess(QProcess *process)
+{
+    auto application = QCoreApplication::instance();
+    if (!application) {
+        process->kill();
+        process->waitForFinished(300);
+        return;
+    }
+
+    process->disconnect();
+    process->closeReadChannel(QProcess::StandardOutput);
+    process->closeReadChannel(QProcess::StandardError);
+    process->setParent(application);
+    QObject::connect(process, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), process,
+                     &QObject::deleteLater);
+    QObject::connect(application, &QCoreApplication::aboutToQuit, process, &QProcess::kill);
+    QTimer::singleShot(ReapTimeout, process, &QProcess::terminate);
+}
+
 ClientBackend::~ClientBackend()
 {
-    if (m_process->state() == QProcess::NotRunning)
+    if (m_trace && !m_trace->save(m_traceFileName))
+        spdlog::error("ClientBackend - can't save the LSP trace in {}", m_traceFileName);
+
+    // The server is owned by the broker, and stays alive for the other knut processes
+    if (m_socket) {
+        m_socket->flush();
+        m_socket->disconnectFromServer();
         return;
-    m_process->terminate();
-    if (m_process->waitForFinished(300) && m_process->state() == QProcess::Running)
+    }
+    if (m_process->state() == QProcess::NotRunning)
         return;
-    m_process->kill();
-    m_process->waitForFinished(300);
+    reapProcess(m_process);
+}
+
+void ClientBackend::useBroker(const std::string &language, const QString &rootPath, int idleTimeout)
+{
+    m_brokerName = Broker::serverName(language, rootPath, m_program, m_arguments);
+    m_brokerRootPath = rootPath;
+    m_brokerIdleTimeout = idleTimeout;
 }
 
 bool ClientBackend::start()
 {
+    if (!m_brokerName.isEmpty()) {
+        if (m_serverLogger)
+            m_serverLogger->trace("==> Connecting to LSP broker {}", m_brokerName);
+        m_socket = Broker::openConnection(m_brokerName, m_program, m_arguments, m_brokerRootPath, m_brokerIdleTimeout,
+                                          this);
+        if (!m_socket)
+            return false;
+        m_device = m_socket;
+        connect(m_socket, &QLocalSocket::readyRead, this, &ClientBackend::readOutput);
+        connect(m_socket, &QLocalSocket::errorOccurred, this, [this]() {
+            emit errorOccured(m_socket->errorString());
+        });
+        connect(m_socket, &QLocalSocket::disconnected, this, &ClientBackend::finished);
+        return true;
+    }
+
     if (m_serverLogger)
         m_serverLogger->trace("==> Starting LSP server {}", m_program);
     m_process->start(m_program, m_arguments);
@@ -97,38 +147,121 @@ bool ClientBackend::start()
     return false;
 }
 
+void ClientBackend::startAsync()
+{
+    // Connecting to a broker is fast, unless it has to be started
+    if (!m_brokerName.isEmpty()) {
+        if (!start())
+            emit errorOccured(QString("can't connect to the LSP broker %1").arg(m_brokerName));
+        return;
+    }
+    if (m_serverLogger)
+        m_serverLogger->trace("==> Starting LSP server {} in the background", m_program);
+    m_process->start(m_program, m_arguments);
+}
+
 void ClientBackend::readError()
 {
     if (m_serverLogger)
         m_serverLogger->info(m_process->readAllStandardError());
 }
 
+// Notifications from the server, which can't have an id: the read of their header stops at the method, so their
+// content (e.g. the diagnostics of a whole file after each change) isn't read unless they have a handler
+static bool isServerNotification(std::string_view method)
+{
+    return method.starts_with("$/") || method == "textDocument/publishDiagnostics" || method == "window/logMessage"
+        || method == "window/showMessage" || method == "telemetry/event" || method == "textDocument/clangd.fileStatus";
+}
+
+void ClientBackend::setNotificationHandler(const std::string &method, NotificationCallback callback)
+{
+    if (callback)
+        m_notificationHandlers[method] = std::move(callback);
+    else
+        m_notificationHandlers.erase(method);
+}
+
+void ClientBackend::setRequestHandler(const std::string &method, ServerRequestCallback callback)
+{
+    if (callback)
+        m_requestHandlers[method] = std::move(callback);
+    else
+        m_requestHandlers.erase(method);
+}
+
 void ClientBackend::readOutput()
 {
-    m_message.addData(m_process->readAllStandardOutput());
+    m_message.readFrom(m_device);
+
+    while (auto view = m_message.getNextMessage()) {
+        // Only the header is read here, the content of a response is deserialized by the callback of its request
+        MessageHeader header;
+        JsonReader reader(*view);
+        if (!read(reader, header, isServerNotification) || (!header.stopped && !reader.atEnd())) {
+            spdlog::error("ClientBackend::readOutput - invalid json message from the LSP server");
+            continue;
+        }
 
-    auto message = m_message.getNextMessage();
-    while (!message.is_null()) {
         // Check if there is an error
-        if (message.contains("error")) {
-            auto errorString = message.at("error").at("message").get<std::string>();
+        if (header.errorMessage) {
             if (m_serverLogger)
-                m_serverLogger->error("<== Error response: {}", errorString);
+                m_serverLogger->error("<== Error response: {}", *header.errorMessage);
         }
 
-        if (message.contains("id")) {
-            const MessageId id = message.at("id").get<MessageId>();
-            auto it = m_callbacks.find(id);
-            if (it != m_callbacks.end()) {
-                logMessage("receive-response", message);
-                it->second(std::move(message));
+        // A callback may wait for another response, and read more data in the buffer: it gets a copy of the message
+        const std::string_view content = *view;
+        if (header.id && !header.hasMethod) {
+            logMessage("receive-response", content);
+            auto it = m_pendingRequests.find(*header.id);
+            if (m_trace) {
+                if (it != m_pendingRequests.end())
+                    m_trace->add(MessageTrace::Type::ReceiveResponse, it->second.method, content.size(),
+                                 MessageTrace::Clock::now() - it->second.sent);
+                else
+                    m_trace->add(MessageTrace::Type::ReceiveResponse, {}, content.size());
+            }
+            if (it != m_pendingRequests.end()) {
+                RequestProfiler::instance().responseReceived(it->second.method, content.size(),
+                                                             RequestProfiler::Clock::now() - it->second.sent);
+                auto callbacks = std::move(it->second.callbacks);
+                m_pendingRequestIds.erase(it->second.key);
+                m_pendingRequests.erase(it);
+                for (const auto &[handle, _] : callbacks)
+                    m_requestHandles.erase(handle);
+
+                // Identical requests share the same response, each callback reads its own copy of the result
+                const std::string text(content);
+                for (const auto &[_, callback] : callbacks)
+                    callback(text);
+            }
+        } else if (header.id) {
+            logMessage("receive-request", content);
+            if (m_trace)
+                m_trace->add(MessageTrace::Type::ReceiveRequest, header.method, content.size());
+
+            // The server may wait for the response, e.g. before reporting a progress
+            json response = {{"jsonrpc", "2.0"}, {"id", *header.id}};
+            if (auto it = m_requestHandlers.find(header.method); it != m_requestHandlers.end()) {
+                const std::string text(content);
+                auto callback = it->second;
+                response["result"] = callback(text);
             } else {
-                logMessage("receive-request", message);
+                response["error"] = {{"code", static_cast<int>(ErrorCodes::MethodNotFound)},
+                                     {"message", "Unhandled method " + header.method}};
             }
+            writeMessage(MessageTrace::Type::SendResponse, header.method, response);
         } else {
-            logMessage("receive-notification", message);
+            logMessage("receive-notification", content);
+            if (m_trace)
+                m_trace->add(MessageTrace::Type::ReceiveNotification, header.method, content.size());
+            if (auto it = m_notificationHandlers.find(header.method); it != m_notificationHandlers.end()) {
+                const std::string text(content);
+                // The handler may be removed during the call
+                auto callback = it->second;
+                callback(text);
+            }
         }
-        message = m_message.getNextMessage();
     }
 }
 
@@ -147,105 +280,126 @@ void ClientBackend::handleFinished(int exitCode, QProcess::ExitStatus exitStatus
         emit finished();
 }
 
-void ClientBackend::sendAsyncJsonRequest(const nlohmann::json &jsonRequest)
+ClientBackend::RequestHandle ClientBackend::sendAsyncJsonRequest(const nlohmann::json &jsonRequest,
+                                                                 ResponseCallback callback)
+{
+    const auto handle = m_nextHandle++;
+    std::string method = jsonRequest.at("method").get<std::string>();
+    std::string key = method;
+    if (jsonRequest.contains("params"))
+        key += jsonRequest.at("params").dump();
+
+    // Same request already sent, wait for its response
+    if (auto it = m_pendingRequestIds.find(key); it != m_pendingRequestIds.end()) {
+        if (m_serverLogger)
+            m_serverLogger->debug("==> Request {} already in flight, sharing the response", key);
+        m_pendingRequests[it->second].callbacks.emplace_back(handle, std::move(callback));
+        m_requestHandles[handle] = it->second;
+        RequestProfiler::instance().requestShared(method);
+        return handle;
+    }
+
+    const MessageId id = jsonRequest.at("id").get<MessageId>();
+    m_pendingRequestIds[key] = id;
+    m_requestHandles[handle] = id;
+    auto &pending = m_pendingRequests[id];
+    pending.key = std::move(key);
+    pending.sent = MessageTrace::Clock::now();
+    pending.callbacks.emplace_back(handle, std::move(callback));
+
+    const auto size = writeMessage(MessageTrace::Type::SendRequest, method, jsonRequest);
+    RequestProfiler::instance().requestSent(method, size);
+    pending.method = std::move(method);
+    return handle;
+}
+
+qint64 ClientBackend::bufferSize() const
+{
+    return m_message.capacity() + (m_device ? m_device->bytesAvailable() : 0);
+}
+
+void ClientBackend::cancelRequest(RequestHandle handle)
 {
-    logMessage("send-request", jsonRequest);
-    const auto message = toMessage(jsonRequest);
-    m_process->write(message);
+    auto handleIt = m_requestHandles.find(handle);
+    if (handleIt == m_requestHandles.end())
+        return;
+    const MessageId id = handleIt->second;
+    m_requestHandles.erase(handleIt);
+
+    auto it = m_pendingRequests.find(id);
+    if (it == m_pendingRequests.end())
+        return;
+    auto &callbacks = it->second.callbacks;
+    std::erase_if(callbacks, [handle](const auto &callback) {
+        return callback.first == handle;
+    });
+    if (!callbacks.empty())
+        return;
+
+    RequestProfiler::instance().requestCancelled(it->second.method);
+    m_pendingRequestIds.erase(it->second.key);
+    m_pendingRequests.erase(it);
+
+    CancelRequestNotification notification;
+    notification.params.id = id;
+    sendNotification(notification);
 }
 
-nlohmann::json ClientBackend::sendJsonRequest(const nlohmann::json &jsonRequest)
+std::string ClientBackend::sendJsonRequest(const nlohmann::json &jsonRequest)
 {
+    TRACE("ClientBackend::sendJsonRequest", QString::fromStdString(jsonRequest.value("method", std::string())));
+    // No response once the script is aborted, as if the server was gone
+    if (Utils::Cancellation::isCanceled())
+        return {};
+
     // Wait for the response to be emitted using the QEventLoop trick
+    // Each request has its own loop and response, so a request can be sent while waiting for another one.
     QEventLoop loop;
-    connect(this, &ClientBackend::responseEmitted, &loop, [&loop]() {
+    std::string response;
+    bool hasResponse = false;
+    const auto handle = sendAsyncJsonRequest(jsonRequest, [&loop, &response, &hasResponse](std::string_view content) {
+        response = content;
+        hasResponse = true;
         loop.exit();
     });
-    sendAsyncJsonRequest(jsonRequest);
+    // Don't wait forever if the server is gone
+    connect(this, &ClientBackend::finished, &loop, &QEventLoop::quit);
+    connect(this, &ClientBackend::errorOccured, &loop, &QEventLoop::quit);
+    Utils::Cancellation::quitOnCancel(loop);
     loop.exec(QEventLoop::ExcludeUserInputEvents);
 
-    return m_response;
+    // The callback is referencing local variables, it can't outlive this function
+    if (!hasResponse)
+        cancelRequest(handle);
+    return response;
 }
 
 void ClientBackend::sendJsonNotification(const nlohmann::json &jsonNotification)
 {
-    logMessage("send-notification", jsonNotification);
-    const auto message = toMessage(jsonNotification);
-    m_process->write(message);
-}
-
-void ClientBackend::logMessage(std::string type, const nlohmann::json &message)
-{
-    json log = {
-        {"type", type},
-        {"message", message},
-        {"timestamp", std::time(nullptr)},
-    };
-    if (m_messageLogger) {
-        m_messageLogger->info(log.dump());
-        m_messageLogger->flush();
-    }
+    writeMessage(MessageTrace::Type::SendNotification, jsonNotification.at("method").get_ref<const std::string &>(),
+                 jsonNotification);
 }
 
-void ClientBackend::Message::addData(const QByteArray &data)
+void ClientBackend::logMessage(std::string_view type, std::string_view content)
 {
-    m_data += data;
+    if (!m_messageLogger || !m_messageLogger->should_log(spdlog::level::info))
+        return;
+    // Same as dumping {"message": ..., "timestamp": ..., "type": ...}, without going through a json DOM
+    m_messageLogger->info(R"({{"message":{},"timestamp":{},"type":"{}"}})", content, std::time(nullptr), type);
+    m_messageLogger->flush();
 }
 
-nlohmann::json ClientBackend::Message::getNextMessage()
+size_t ClientBackend::writeMessage(MessageTrace::Type type, std::string_view method, const json &content)
 {
-    // Not enough data yet to read the message
-    if (m_length == 0 && !readHeader())
-        return {};
-
-    // There is a message
-    if (m_length) {
-        QBuffer buf;
-        buf.setData(m_data);
-        if (buf.open(QIODevice::ReadOnly)) {
-            json message;
-            try {
-                message = json::parse(buf.read(m_length).constData());
-
-                m_length = 0;
-                m_data = m_data.mid(buf.pos());
-            } catch (...) {
-                // If we have parsing errors then the message
-                // is not fully received, return an empty message
-                // and wait for the next time this function runs.
-                message = {};
-            }
-            return message;
-        }
-    }
-    return {};
+    const std::string data = content.dump();
+    logMessage(type == MessageTrace::Type::SendRequest        ? "send-request"
+                   : type == MessageTrace::Type::SendResponse ? "send-response"
+                                                              : "send-notification",
+               data);
+    if (m_trace)
+        m_trace->add(type, method, data.size());
+    Lsp::writeMessage(m_device, data);
+    return data.size();
 }
 
-bool ClientBackend::Message::readHeader()
-{
-    QBuffer buf;
-    buf.setData(m_data);
-    int length = 0;
-    if (buf.open(QIODevice::ReadOnly)) {
-        while (!buf.atEnd()) {
-            const QByteArray &headerLine = buf.readLine();
-
-            // There's always an empty line between header and content
-            if (headerLine == "\r\n") {
-                m_length = length;
-                m_data = m_data.mid(buf.pos());
-                return true;
-            }
-
-            int assignmentIndex = headerLine.indexOf(": ");
-            if (assignmentIndex >= 0) {
-                const QByteArray &key = headerLine.mid(0, assignmentIndex).trimmed();
-                const QByteArray &value = headerLine.mid(assignmentIndex + 2).trimmed();
-                if (key == "Content-Length")
-                    length = value.toInt();
-            }
-        }
-    }
-    return false;
-}
 }
@@ -10,15 +10,24 @@
 
 #pragma once
 
+#include "messagebuffer.h"
+#include "messagetrace.h"
 #include "requestmessage.h"
+#include "requestmessage_reader.h"
+#include "types_reader.h"
 #include "utils/json.h"
 #include "utils/log.h"
 
 #include <QObject>
 #include <QProcess>
 #include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
+class QLocalSocket;
 class QProcess;
 
 namespace Lsp {
@@ -31,38 +40,64 @@ public:
     ClientBackend(const std::string &language, QString program, QStringList arguments, QObject *parent = nullptr);
     ~ClientBackend() override;
 
+    /**
+     * Uses a server shared with other knut processes, see Broker, instead of starting a new one.
+     * Must be called before starting, the broker is started if it's not running yet.
+     */
+    void useBroker(const std::string &language, const QString &rootPath, int idleTimeout);
+
     bool start();
+    // Starts the server without waiting, an error is reported with errorOccured.
+    // Messages can already be sent, they are read by the server once it's running.
+    void startAsync();
+
+    // Identifies a call to sendAsyncRequest, used to cancel it.
+    using RequestHandle = int;
 
+    // Sends the request, the callback is called once the response has arrived.
+    // If the same request is already in flight, no new request is sent and the callback is called with the response
+    // of the first one.
     template <typename Request>
-    void sendAsyncRequest(const Request &request, typename Request::ResponseCallback callback)
+    RequestHandle sendAsyncRequest(const Request &request, typename Request::ResponseCallback callback)
     {
-        m_callbacks[request.id] = [this, callback](nlohmann::json &&j) {
+        return sendAsyncJsonRequest(request, [this, callback](std::string_view content) {
             if (callback) {
-                auto response = deserializeResponse<typename Request::Response>(std::move(j));
+                auto response = deserializeResponse<typename Request::Response>(content);
                 callback(std::move(response));
             }
-        };
-        sendAsyncJsonRequest(request);
+        });
     }
 
     template <typename Request>
     typename Request::Response sendRequest(const Request &request)
     {
-        m_callbacks[request.id] = [this](nlohmann::json &&j) {
-            m_response = std::move(j);
-            emit responseEmitted(QPrivateSignal {});
-        };
-
         std::visit(
             [this, &request](const auto &id) {
                 if (m_serverLogger)
                     m_serverLogger->debug("==> Sending Request {} with id {}", request.method, id);
             },
             request.id);
-        auto j = sendJsonRequest(request);
-        return deserializeResponse<typename Request::Response>(std::move(j));
+        const auto content = sendJsonRequest(request);
+        return deserializeResponse<typename Request::Response>(content);
     }
 
+    // Cancels a request sent with sendAsyncRequest, its callback won't be called.
+    // The server is only notified once no one is waiting for the response anymore.
+    void cancelRequest(RequestHandle handle);
+
+    // Called with the text of each notification with this method from the server, the text is only valid during the
+    // call. Without a handler, a notification is only logged. A null callback removes the handler.
+    using NotificationCallback = std::function<void(std::string_view)>;
+    void setNotificationHandler(const std::string &method, NotificationCallback callback);
+
+    // Called with the text of each request with this method from the server, returns the result sent back in the
+    // response. The requests without a handler get a MethodNotFound error. A null callback removes the handler.
+    using ServerRequestCallback = std::function<nlohmann::json(std::string_view)>;
+    void setRequestHandler(const std::string &method, ServerRequestCallback callback);
+
+    // Memory used by the message buffer, and by the data read from the server but not handled yet
+    qint64 bufferSize() const;
+
     template <typename Notification>
     void sendNotification(const Notification &notification)
     {
@@ -74,7 +109,6 @@ public:
 signals:
     void errorOccured(const QString &message);
     void finished();
-    void responseEmitted(QPrivateSignal);
 
 private:
     void readError();
@@ -82,11 +116,13 @@ private:
     void handleError();
     void handleFinished(int exitCode, QProcess::ExitStatus exitStatus);
 
+    // The response is read straight from the message text, without going through a json DOM
     template <typename Response>
-    Response deserializeResponse(nlohmann::json &&j)
+    Response deserializeResponse(std::string_view content)
     {
-        try {
-            auto response = j.get<Response>();
+        Response response;
+        JsonReader reader(content);
+        if (read(reader, response) && reader.atEnd()) {
             std::visit(
                 [this](const auto &id) {
                     if (m_serverLogger)
@@ -94,48 +130,55 @@ private:
                 },
                 response.id);
             return response;
-        } catch (...) {
-            if (m_serverLogger)
-                m_serverLogger->error("<== Invalid response from server: {}", j.dump());
         }
+        if (m_serverLogger)
+            m_serverLogger->error("<== Invalid response from server: {}", content);
         return {};
     }
 
-    void sendAsyncJsonRequest(const nlohmann::json &jsonRequest);
-    nlohmann::json sendJsonRequest(const nlohmann::json &jsonRequest);
+    // The callback gets the text of the response message, only valid during the call
+    using ResponseCallback = std::function<void(std::string_view)>;
+    RequestHandle sendAsyncJsonRequest(const nlohmann::json &jsonRequest, ResponseCallback callback);
+    std::string sendJsonRequest(const nlohmann::json &jsonRequest);
     void sendJsonNotification(const nlohmann::json &jsonNotification);
 
-    void logMessage(std::string type, const nlohmann::json &message);
+    // The message is only formatted if it's logged, content is its json text
+    void logMessage(std::string_view type, std::string_view content);
+    // Returns the size of the content
+    size_t writeMessage(MessageTrace::Type type, std::string_view method, const nlohmann::json &content);
 
 private:
     std::shared_ptr<spdlog::logger> m_serverLogger;
     std::shared_ptr<spdlog::logger> m_messageLogger;
+    // Enabled with KNUT_TRACE_LSP=<number of messages>, saved when the backend is destroyed
+    std::unique_ptr<MessageTrace> m_trace;
+    QString m_traceFileName;
     const QString m_program;
     const QStringList m_arguments;
     QProcess *m_process = nullptr;
-
-    std::unordered_map<MessageId, std::function<void(nlohmann::json)>> m_callbacks;
-    nlohmann::json m_response;
-
-    class Message
+    // Connection with the LSP server: either the process, or the socket of the broker
+    QIODevice *m_device = nullptr;
+    QLocalSocket *m_socket = nullptr;
+    QString m_brokerName;
+    QString m_brokerRootPath;
+    int m_brokerIdleTimeout = 0;
+
+    struct PendingRequest
     {
-    public:
-        void addData(const QByteArray &data);
-
-        // Parse the current data, and return a message as a json object or empty if there's nothing
-        nlohmann::json getNextMessage();
-
-    private:
-        // Read the header file and remove the data from m_data
-        // Returns true if the header file is read
-        bool readHeader();
-
-    private:
-        QByteArray m_data;
-        int m_length = 0;
+        // Method and parameters of the request, used to share the response between identical requests
+        std::string key;
+        std::string method;
+        MessageTrace::Clock::time_point sent;
+        std::vector<std::pair<RequestHandle, ResponseCallback>> callbacks;
     };
-
-    Message m_message;
+    std::unordered_map<MessageId, PendingRequest> m_pendingRequests;
+    std::unordered_map<std::string, MessageId> m_pendingRequestIds;
+    std::unordered_map<RequestHandle, MessageId> m_requestHandles;
+    RequestHandle m_nextHandle = 1;
+    std::unordered_map<std::string, NotificationCallback> m_notificationHandlers;
+    std::unordered_map<std::string, ServerRequestCallback> m_requestHandlers;
+
+    MessageBuffer m_message;
 };
 
 }
@@ -0,0 +1,308 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "jsonreader.h"
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+
+namespace Lsp {
+
+JsonReader::JsonReader(std::string_view text)
+    : m_text(text)
+{
+}
+
+bool JsonReader::atEnd()
+{
+    skipWhitespace();
+    return m_position == m_text.size();
+}
+
+void JsonReader::skipWhitespace()
+{
+    while (m_position < m_text.size()) {
+        const char c = m_text[m_position];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            return;
+        ++m_position;
+    }
+}
+
+bool JsonReader::consume(char c)
+{
+    skipWhitespace();
+    if (m_position < m_text.size() && m_text[m_position] == c) {
+        ++m_position;
+        return true;
+    }
+    return false;
+}
+
+bool JsonReader::readNull()
+{
+    skipWhitespace();
+    if (m_text.substr(m_position, 4) != "null")
+        return false;
+    m_position += 4;
+    return true;
+}
+
+bool JsonReader::readBool(bool &value)
+{
+    skipWhitespace();
+    if (m_text.substr(m_position, 4) == "true") {
+        m_position += 4;
+        value = true;
+        return true;
+    }
+    if (m_text.substr(m_position, 5) == "false") {
+        m_position += 5;
+        value = false;
+        return true;
+    }
+    return false;
+}
+
+// https://www.json.org/: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+bool JsonReader::readNumberToken(std::string_view &token, bool &isInteger)
+{
+    skipWhitespace();
+    const size_t start = m_position;
+    auto isDigit = [this]() {
+        return m_position < m_text.size() && m_text[m_position] >= '0' && m_text[m_position] <= '9';
+    };
+    auto skipDigits = [&]() {
+        const size_t digitsStart = m_position;
+        while (isDigit())
+            ++m_position;
+        return m_position > digitsStart;
+    };
+
+    isInteger = true;
+    if (m_position < m_text.size() && m_text[m_position] == '-')
+        ++m_position;
+    if (m_position < m_text.size() && m_text[m_position] == '0')
+        ++m_position;
+    else if (!skipDigits())
+        return false;
+    if (m_position < m_text.size() && m_text[m_position] == '.') {
+        ++m_position;
+        isInteger = false;
+        if (!skipDigits())
+            return false;
+    }
+    if (m_position < m_text.size() && (m_text[m_position] == 'e' || m_text[m_position] == 'E')) {
+        ++m_position;
+        isInteger = false;
+        if (m_position < m_text.size() && (m_text[m_position] == '+' || m_text[m_position] == '-'))
+            ++m_position;
+        if (!skipDigits())
+            return false;
+    }
+    token = m_text.substr(start, m_position - start);
+    return true;
+}
+
+bool JsonReader::readInteger(long long &value)
+{
+    std::string_view token;
+    bool isInteger = false;
+    if (!readNumberToken(token, isInteger))
+        return false;
+    // Same as the json conversion, a decimal number is truncated
+    if (!isInteger) {
+        value = static_cast<long long>(std::strtod(std::string(token).c_str(), nullptr));
+        return true;
+    }
+    return std::from_chars(token.data(), token.data() + token.size(), value).ec == std::errc();
+}
+
+bool JsonReader::readNumber(double &value)
+{
+    std::string_view token;
+    bool isInteger = false;
+    if (!readNumberToken(token, isInteger))
+        return false;
+    // std::from_chars for floating points is not available everywhere yet
+    value = std::strtod(std::string(token).c_str(), nullptr);
+    return true;
+}
+
+static void appendUtf8(std::string &value, uint32_t codePoint)
+{
+    if (codePoint < 0x80) {
+        value += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        value += static_cast<char>(0xC0 | (codePoint >> 6));
+        value += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        value += static_cast<char>(0xE0 | (codePoint >> 12));
+        value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        value += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        value += static_cast<char>(0xF0 | (codePoint >> 18));
+        value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        value += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Reads the string after the opening quote, value is nullptr when the string is only skipped
+bool JsonReader::readStringContent(std::string *value)
+{
+    auto readHex = [this](uint32_t &codePoint) {
+        if (m_position + 4 > m_text.size())
+            return false;
+        const char *begin = m_text.data() + m_position;
+        m_position += 4;
+        return std::from_chars(begin, begin + 4, codePoint, 16).ptr == begin + 4;
+    };
+
+    while (m_position < m_text.size()) {
+        // Copy the text up to the next quote or escape sequence in one go
+        const size_t start = m_position;
+        while (m_position < m_text.size() && m_text[m_position] != '"' && m_text[m_position] != '\\') {
+            if (static_cast<unsigned char>(m_text[m_position]) < 0x20)
+                return false;
+            ++m_position;
+        }
+        if (value)
+            value->append(m_text.substr(start, m_position - start));
+        if (m_position == m_text.size())
+            return false;
+        if (m_text[m_position++] == '"')
+            return true;
+
+        if (m_position == m_text.size())
+            return false;
+        const char escape = m_text[m_position++];
+        char c = 0;
+        switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+            c = escape;
+            break;
+        case 'b':
+            c = '\b';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'u': {
+            uint32_t codePoint = 0;
+            if (!readHex(codePoint))
+                return false;
+            // Characters outside the BMP are encoded as a surrogate pair
+            if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+                uint32_t low = 0;
+                if (m_text.substr(m_position, 2) != "\\u")
+                    return false;
+                m_position += 2;
+                if (!readHex(low) || low < 0xDC00 || low > 0xDFFF)
+                    return false;
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+            }
+            if (value)
+                appendUtf8(*value, codePoint);
+            continue;
+        }
+        default:
+            return false;
+        }
+        if (value)
+            *value += c;
+    }
+    return false;
+}
+
+bool JsonReader::readString(std::string &value)
+{
+    if (!consume('"'))
+        return false;
+    value.clear();
+    return readStringContent(&value);
+}
+
+bool JsonReader::readKey(std::string_view &key)
+{
+    if (!consume('"'))
+        return false;
+    // Most keys don't have any escape sequence, and can be used in place
+    const size_t start = m_position;
+    const size_t end = m_text.find_first_of("\"\\", start);
+    if (end != std::string_view::npos && m_text[end] == '"') {
+        key = m_text.substr(start, end - start);
+        m_position = end + 1;
+        return true;
+    }
+    m_key.clear();
+    if (!readStringContent(&m_key))
+        return false;
+    key = m_key;
+    return true;
+}
+
+bool JsonReader::skipValue()
+{
+    skipWhitespace();
+    if (m_position == m_text.size())
+        return false;
+
+    switch (m_text[m_position]) {
+    case '{':
+        return readObject([this](std::string_view) {
+            return skipValue();
+        });
+    case '[':
+        return readArray([this]() {
+            return skipValue();
+        });
+    case '"':
+        ++m_position;
+        return readStringContent(nullptr);
+    case 't':
+    case 'f': {
+        bool value;
+        return readBool(value);
+    }
+    case 'n':
+        return readNull();
+    default: {
+        std::string_view token;
+        bool isInteger;
+        return readNumberToken(token, isInteger);
+    }
+    }
+}
+
+bool JsonReader::readJson(nlohmann::json &value)
+{
+    skipWhitespace();
+    const size_t start = m_position;
+    if (!skipValue())
+        return false;
+    const auto text = m_text.substr(start, m_position - start);
+    value = nlohmann::json::parse(text.data(), text.data() + text.size(), nullptr, false);
+    return !value.is_discarded();
+}
+
+}
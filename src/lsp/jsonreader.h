@@ -0,0 +1,218 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace Lsp {
+
+/**
+ * \brief Reads a JSON text in place, without building a DOM
+ *
+ * The LSP types are deserialized directly from the text of a message with the `read` functions below, and the ones
+ * generated by spec2cpp in types_reader.h. All the reads return false if the text doesn't match the expected type,
+ * the position is then undefined: save it with position() to try another type, as for a std::variant.
+ */
+class JsonReader
+{
+public:
+    explicit JsonReader(std::string_view text);
+
+    size_t position() const { return m_position; }
+    void setPosition(size_t position) { m_position = position; }
+    // Returns true if the whole text has been read
+    bool atEnd();
+
+    bool readNull();
+    bool readBool(bool &value);
+    bool readInteger(long long &value);
+    bool readNumber(double &value);
+    bool readString(std::string &value);
+    bool skipValue();
+    // Reads the next value in a json DOM, used for the types without a reader
+    bool readJson(nlohmann::json &value);
+
+    // Reads an object, readMember is called for each member with the key, and must read the value.
+    template <typename ReadMember>
+    bool readObject(ReadMember &&readMember)
+    {
+        if (!consume('{'))
+            return false;
+        if (consume('}'))
+            return true;
+        do {
+            std::string_view key;
+            if (!readKey(key) || !consume(':') || !readMember(key))
+                return false;
+        } while (consume(','));
+        return consume('}');
+    }
+
+    // Reads an array, readElement is called for each element, and must read it.
+    template <typename ReadElement>
+    bool readArray(ReadElement &&readElement)
+    {
+        if (!consume('['))
+            return false;
+        if (consume(']'))
+            return true;
+        do {
+            if (!readElement())
+                return false;
+        } while (consume(','));
+        return consume(']');
+    }
+
+private:
+    void skipWhitespace();
+    bool consume(char c);
+    // The key is a view on the text, unless it has escape sequences
+    bool readKey(std::string_view &key);
+    bool readStringContent(std::string *value);
+    bool readNumberToken(std::string_view &token, bool &isInteger);
+
+    std::string_view m_text;
+    size_t m_position = 0;
+    std::string m_key;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Basic types
+///////////////////////////////////////////////////////////////////////////////
+inline bool read(JsonReader &reader, std::nullptr_t &)
+{
+    return reader.readNull();
+}
+
+inline bool read(JsonReader &reader, bool &value)
+{
+    return reader.readBool(value);
+}
+
+inline bool read(JsonReader &reader, int &value)
+{
+    long long integer = 0;
+    if (!reader.readInteger(integer))
+        return false;
+    value = static_cast<int>(integer);
+    return true;
+}
+
+inline bool read(JsonReader &reader, unsigned int &value)
+{
+    long long integer = 0;
+    if (!reader.readInteger(integer))
+        return false;
+    value = static_cast<unsigned int>(integer);
+    return true;
+}
+
+inline bool read(JsonReader &reader, float &value)
+{
+    double number = 0;
+    if (!reader.readNumber(number))
+        return false;
+    value = static_cast<float>(number);
+    return true;
+}
+
+inline bool read(JsonReader &reader, double &value)
+{
+    return reader.readNumber(value);
+}
+
+inline bool read(JsonReader &reader, std::string &value)
+{
+    return reader.readString(value);
+}
+
+inline bool read(JsonReader &reader, nlohmann::json &value)
+{
+    return reader.readJson(value);
+}
+
+// Fallback for the types without a reader: the value is read in a DOM, and converted with its from_json function.
+template <typename T>
+bool read(JsonReader &reader, T &value)
+{
+    nlohmann::json j;
+    if (!reader.readJson(j))
+        return false;
+    try {
+        j.get_to(value);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Enumerations serialized as numbers, string enumerations use their from_json function
+template <typename T>
+bool readEnum(JsonReader &reader, T &value)
+{
+    long long integer = 0;
+    if (!reader.readInteger(integer))
+        return false;
+    value = static_cast<T>(integer);
+    return true;
+}
+
+template <typename T>
+bool read(JsonReader &reader, std::optional<T> &value)
+{
+    value.emplace();
+    return read(reader, *value);
+}
+
+template <typename T>
+bool read(JsonReader &reader, std::vector<T> &value)
+{
+    value.clear();
+    return reader.readArray([&reader, &value]() {
+        return read(reader, value.emplace_back());
+    });
+}
+
+// Same as the json deserialization of a variant, where the last matching type wins: types are tried from the last.
+template <size_t Index, typename... Ts>
+bool readVariant(JsonReader &reader, std::variant<Ts...> &value, size_t start)
+{
+    reader.setPosition(start);
+    if (read(reader, value.template emplace<Index>()))
+        return true;
+    if constexpr (Index > 0)
+        return readVariant<Index - 1>(reader, value, start);
+    else
+        return false;
+}
+
+template <typename... Ts>
+bool read(JsonReader &reader, std::variant<Ts...> &value)
+{
+    return readVariant<sizeof...(Ts) - 1>(reader, value, reader.position());
+}
+
+// Reads a required member of a structure, and flags it as found
+template <typename T>
+bool readField(JsonReader &reader, T &value, int &found, int flag)
+{
+    found |= flag;
+    return read(reader, value);
+}
+
+}
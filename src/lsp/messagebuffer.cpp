@@ -0,0 +1,108 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "messagebuffer.h"
+
+#include <QIODevice>
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+namespace Lsp {
+
+void MessageBuffer::readFrom(QIODevice *device)
+{
+    const qint64 available = device->bytesAvailable();
+    if (available <= 0)
+        return;
+
+    // Drop the data already parsed, before growing the buffer
+    if (m_start > 0) {
+        m_data.remove(0, m_start);
+        m_start = 0;
+    }
+
+    const qsizetype size = m_data.size();
+    m_data.resize(size + available);
+    const qint64 read = device->read(m_data.data() + size, available);
+    m_data.resize(size + std::max<qint64>(read, 0));
+}
+
+std::optional<std::string_view> MessageBuffer::getNextMessage()
+{
+    // Not enough data yet to read the message
+    if (m_length == 0 && !readHeader())
+        return {};
+
+    // Wait until the whole content has arrived
+    if (m_data.size() - m_start < m_length)
+        return {};
+
+    const std::string_view content(m_data.constData() + m_start, m_length);
+    m_start += m_length;
+    m_length = 0;
+    return content;
+}
+
+bool MessageBuffer::readHeader()
+{
+    // https://microsoft.github.io/language-server-protocol/specifications/specification-current/#headerPart
+    // Header lines are separated by "\r\n", and there's always an empty line between header and content
+    const QByteArrayView data(m_data.constData() + m_start, m_data.size() - m_start);
+    const qsizetype headerEnd = data.indexOf("\r\n\r\n");
+    if (headerEnd < 0)
+        return false;
+
+    qsizetype length = 0;
+    qsizetype lineStart = 0;
+    while (lineStart < headerEnd) {
+        qsizetype lineEnd = data.indexOf("\r\n", lineStart);
+        if (lineEnd < 0 || lineEnd > headerEnd)
+            lineEnd = headerEnd;
+        const QByteArrayView headerLine = data.sliced(lineStart, lineEnd - lineStart);
+        const qsizetype assignmentIndex = headerLine.indexOf(": ");
+        if (assignmentIndex >= 0) {
+            const QByteArrayView key = headerLine.first(assignmentIndex).trimmed();
+            const QByteArrayView value = headerLine.sliced(assignmentIndex + 2).trimmed();
+            if (key == "Content-Length")
+                length = value.toLongLong();
+        }
+        lineStart = lineEnd + 2;
+    }
+
+    m_start += headerEnd + 4;
+    m_length = length;
+    // An empty message is not a valid json, it will be skipped when parsed
+    return true;
+}
+
+void writeMessage(QIODevice *device, std::string_view content)
+{
+    // https://microsoft.github.io/language-server-protocol/specifications/specification-current/#headerPart
+    // The content-type is optional, and only UTF-8 is accepted for the charset
+    // Content-Length: ...\r\n
+    // Content-Type: application/vscode-jsonrpc; charset=utf-8\r\n
+    // \r\n
+    // {
+    //     ~~~
+    // }
+    // The header is small enough to live on the stack, and both parts go straight to the device write buffer, so
+    // the body is never copied into a temporary message.
+    constexpr std::string_view prefix = "Content-Length: ";
+    std::array<char, 48> header;
+    auto end = std::copy(prefix.begin(), prefix.end(), header.begin());
+    end = std::to_chars(end, header.data() + header.size(), content.size()).ptr;
+    end = std::copy_n("\r\n\r\n", 4, end);
+
+    device->write(header.data(), end - header.data());
+    device->write(content.data(), static_cast<qint64>(content.size()));
+}
+
+}
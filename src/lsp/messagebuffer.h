@@ -0,0 +1,54 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <optional>
+#include <string_view>
+
+class QIODevice;
+
+namespace Lsp {
+
+/**
+ * \brief Splits the data read from a LSP connection into messages
+ *
+ * Used for the connection with a LSP server, and by the broker for the connections with the knut processes.
+ */
+class MessageBuffer
+{
+public:
+    // Read all the available data from the device, directly into the buffer
+    void readFrom(QIODevice *device);
+
+    // Returns the content of the next message, or nothing if it has not fully arrived yet
+    // The content is a view on the buffer, only valid until the next call to readFrom.
+    std::optional<std::string_view> getNextMessage();
+
+    qsizetype capacity() const { return m_data.capacity(); }
+
+private:
+    // Parse the header in place, starting at m_start, and skip it
+    // Returns true if the header is complete
+    bool readHeader();
+
+private:
+    // Data already parsed is not removed, it's only skipped using m_start. The buffer is compacted when more data
+    // arrives, so its allocation is reused from one message to the next.
+    QByteArray m_data;
+    qsizetype m_start = 0;
+    qsizetype m_length = 0;
+};
+
+// Writes a message with its header, the content is a json text
+void writeMessage(QIODevice *device, std::string_view content);
+
+}
@@ -0,0 +1,93 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "messagetrace.h"
+
+#include <QFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace Lsp {
+
+MessageTrace::MessageTrace(size_t capacity)
+    : m_records(std::max<size_t>(capacity, 1))
+{
+}
+
+void MessageTrace::add(Type type, std::string_view method, size_t size, Clock::duration latency)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    constexpr auto MaxValue = std::numeric_limits<uint32_t>::max();
+
+    Record &record = m_records[m_next];
+    record.timestamp = duration_cast<microseconds>(Clock::now() - m_start).count();
+    record.size = static_cast<uint32_t>(std::min<size_t>(size, MaxValue));
+    record.latency = static_cast<uint32_t>(std::min<int64_t>(duration_cast<microseconds>(latency).count(), MaxValue));
+    record.type = type;
+    const auto length = std::min(method.size(), sizeof(record.method) - 1);
+    std::copy_n(method.data(), length, record.method);
+    record.method[length] = '\0';
+
+    if (++m_next == m_records.size()) {
+        m_next = 0;
+        m_full = true;
+    }
+}
+
+std::vector<MessageTrace::Record> MessageTrace::records() const
+{
+    if (!m_full)
+        return {m_records.begin(), m_records.begin() + m_next};
+    std::vector<Record> records;
+    records.reserve(m_records.size());
+    records.insert(records.end(), m_records.begin() + m_next, m_records.end());
+    records.insert(records.end(), m_records.begin(), m_records.begin() + m_next);
+    return records;
+}
+
+bool MessageTrace::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    const auto records = this->records();
+    const auto count = qToLittleEndian(static_cast<uint32_t>(records.size()));
+    file.write("KNUTLSPT", 8);
+    file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char *>(records.data()), static_cast<qint64>(records.size() * sizeof(Record)));
+    return true;
+}
+
+std::optional<std::vector<MessageTrace::Record>> MessageTrace::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    const QByteArray data = file.readAll();
+    if (data.size() < 12 || !data.startsWith("KNUTLSPT"))
+        return {};
+    const auto count = qFromLittleEndian<uint32_t>(data.constData() + 8);
+    if (static_cast<size_t>(data.size() - 12) != count * sizeof(Record))
+        return {};
+
+    std::vector<Record> records(count);
+    std::memcpy(records.data(), data.constData() + 12, count * sizeof(Record));
+    // The method may not be terminated in a corrupted file
+    for (auto &record : records)
+        record.method[sizeof(record.method) - 1] = '\0';
+    return records;
+}
+
+}
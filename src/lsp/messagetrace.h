@@ -0,0 +1,76 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace Lsp {
+
+/**
+ * \brief Bounded binary trace of the LSP messages
+ *
+ * Only a fixed-size record is kept for each message, in a ring buffer allocated once: adding a record is a copy of
+ * the method name, nothing is formatted or allocated. Once full, the oldest records are overwritten.
+ *
+ * The trace is saved as: the "KNUTLSPT" magic, the record count as a little-endian uint32, then the records as they
+ * are in memory, oldest first.
+ */
+class MessageTrace
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Type : uint8_t {
+        SendRequest,
+        SendNotification,
+        ReceiveResponse,
+        ReceiveRequest,
+        ReceiveNotification,
+        SendResponse,
+    };
+
+    struct Record
+    {
+        // Time since the trace was created, in microseconds
+        int64_t timestamp = 0;
+        // Size of the message content, in bytes
+        uint32_t size = 0;
+        // For a response, time since its request was sent, in microseconds
+        uint32_t latency = 0;
+        Type type = Type::SendRequest;
+        // Truncated and null-terminated, empty for a response to an unknown request
+        char method[47] = {};
+    };
+    static_assert(sizeof(Record) == 64);
+
+    explicit MessageTrace(size_t capacity);
+
+    void add(Type type, std::string_view method, size_t size, Clock::duration latency = {});
+
+    // Returns the records, oldest first
+    std::vector<Record> records() const;
+    bool save(const QString &fileName) const;
+    // Reads the records of a trace written by save, returns nothing if the file is not a valid trace
+    static std::optional<std::vector<Record>> load(const QString &fileName);
+
+private:
+    const Clock::time_point m_start = Clock::now();
+    std::vector<Record> m_records;
+    size_t m_next = 0;
+    bool m_full = false;
+};
+
+}
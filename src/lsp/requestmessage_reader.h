@@ -0,0 +1,105 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "jsonreader.h"
+#include "requestmessage.h"
+
+namespace Lsp {
+
+template <typename ErrorData>
+bool read(JsonReader &reader, ResponseError<ErrorData> &responseError)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "code")
+            return readField(reader, responseError.code, found, 0x1);
+        if (key == "message")
+            return readField(reader, responseError.message, found, 0x2);
+        if (key == "data")
+            return read(reader, responseError.data);
+        return reader.skipValue();
+    });
+    return ok && found == 0x3;
+}
+
+template <typename ResultData, typename ErrorData>
+bool read(JsonReader &reader, ResponseMessage<ResultData, ErrorData> &response)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "jsonrpc")
+            return readField(reader, response.jsonrpc, found, 0x1);
+        if (key == "id")
+            return readField(reader, response.id, found, 0x2);
+        if (key == "result")
+            return read(reader, response.result);
+        if (key == "error")
+            return read(reader, response.error);
+        return reader.skipValue();
+    });
+    return ok && found == 0x3;
+}
+
+// Header of a message, read without deserializing its content
+struct MessageHeader
+{
+    std::optional<MessageId> id;
+    bool hasMethod = false;
+    std::string method;
+    std::optional<std::string> errorMessage;
+    // The read stopped after the method, see below
+    bool stopped = false;
+};
+
+// Reads the header of a message. The read stops right after the method of a notification if skipNotification returns
+// true for it: `stopped` is then set, and the rest of the message isn't read at all.
+template <typename SkipNotification>
+bool read(JsonReader &reader, MessageHeader &header, SkipNotification &&skipNotification)
+{
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "id") {
+            const auto start = reader.position();
+            if (read(reader, header.id))
+                return true;
+            // The id of a response to an invalid request is null
+            header.id.reset();
+            reader.setPosition(start);
+            return reader.skipValue();
+        }
+        if (key == "method") {
+            header.hasMethod = true;
+            if (!read(reader, header.method))
+                return false;
+            // Stops the read of the object, reported below as a success
+            header.stopped = !header.id && skipNotification(std::string_view(header.method));
+            return !header.stopped;
+        }
+        if (key == "error") {
+            return reader.readObject([&](std::string_view errorKey) {
+                if (errorKey == "message")
+                    return read(reader, header.errorMessage);
+                return reader.skipValue();
+            });
+        }
+        return reader.skipValue();
+    });
+    return ok || header.stopped;
+}
+
+inline bool read(JsonReader &reader, MessageHeader &header)
+{
+    return read(reader, header, [](std::string_view) {
+        return false;
+    });
+}
+
+}
@@ -0,0 +1,152 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "requestprofiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace Lsp {
+
+void RequestStatistics::addLatency(std::chrono::microseconds latency)
+{
+    totalLatency += latency;
+    const auto us = static_cast<double>(latency.count());
+    const int bucket = us <= 1 ? 0 : static_cast<int>(std::ceil(4 * std::log2(us)));
+    ++latencies[std::min(bucket, BucketCount - 1)];
+}
+
+std::chrono::microseconds RequestStatistics::latency(double percentile) const
+{
+    uint64_t total = 0;
+    for (const auto count : latencies)
+        total += count;
+    if (total == 0)
+        return {};
+
+    const auto target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile * total)));
+    uint64_t cumulated = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        cumulated += latencies[i];
+        if (cumulated >= target)
+            return std::chrono::microseconds(std::llround(std::exp2(i / 4.0)));
+    }
+    return std::chrono::microseconds(std::llround(std::exp2((BucketCount - 1) / 4.0)));
+}
+
+QString RequestStatistics::toString() const
+{
+    auto toMs = [](std::chrono::microseconds time) {
+        return QString::number(static_cast<double>(time.count()) / 1000, 'f', 2);
+    };
+
+    QString result = QString("%1 requests - %2 shared - %3 cancelled - %4 in flight (max %5)\n")
+                         .arg(count)
+                         .arg(shared)
+                         .arg(cancelled)
+                         .arg(inFlight)
+                         .arg(maxInFlight);
+    result += QString("  Latency: p50 %1ms - p95 %2ms - p99 %3ms - total %4ms\n")
+                  .arg(toMs(latency(0.5)), toMs(latency(0.95)), toMs(latency(0.99)), toMs(totalLatency));
+    result += QString("  Size: %1 bytes sent - %2 bytes received - largest response %3 bytes\n")
+                  .arg(requestBytes)
+                  .arg(responseBytes)
+                  .arg(maxResponseSize);
+    return result;
+}
+
+RequestProfiler &RequestProfiler::instance()
+{
+    static RequestProfiler profiler;
+    return profiler;
+}
+
+RequestStatistics &RequestProfiler::methodStatistics(std::string_view method)
+{
+    auto it = m_statistics.find(method);
+    if (it == m_statistics.end()) {
+        it = m_statistics.emplace(std::string(method), RequestStatistics {}).first;
+        it->second.method = it->first;
+    }
+    return it->second;
+}
+
+void RequestProfiler::requestSent(std::string_view method, size_t size)
+{
+    std::lock_guard lock(m_mutex);
+    auto &statistics = methodStatistics(method);
+    ++statistics.count;
+    statistics.requestBytes += size;
+    statistics.maxInFlight = std::max(statistics.maxInFlight, ++statistics.inFlight);
+}
+
+void RequestProfiler::requestShared(std::string_view method)
+{
+    std::lock_guard lock(m_mutex);
+    ++methodStatistics(method).shared;
+}
+
+void RequestProfiler::requestCancelled(std::string_view method)
+{
+    std::lock_guard lock(m_mutex);
+    auto &statistics = methodStatistics(method);
+    ++statistics.cancelled;
+    --statistics.inFlight;
+}
+
+void RequestProfiler::responseReceived(std::string_view method, size_t size, Clock::duration latency)
+{
+    std::lock_guard lock(m_mutex);
+    auto &statistics = methodStatistics(method);
+    ++statistics.responses;
+    --statistics.inFlight;
+    statistics.responseBytes += size;
+    statistics.maxResponseSize = std::max(statistics.maxResponseSize, size);
+    statistics.addLatency(std::chrono::duration_cast<std::chrono::microseconds>(latency));
+}
+
+std::vector<RequestStatistics> RequestProfiler::statistics() const
+{
+    std::lock_guard lock(m_mutex);
+    std::vector<RequestStatistics> result;
+    result.reserve(m_statistics.size());
+    for (const auto &[method, statistics] : m_statistics)
+        result.push_back(statistics);
+    return result;
+}
+
+int RequestProfiler::inFlight() const
+{
+    std::lock_guard lock(m_mutex);
+    int result = 0;
+    for (const auto &[method, statistics] : m_statistics)
+        result += statistics.inFlight;
+    return result;
+}
+
+void RequestProfiler::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_statistics.clear();
+}
+
+QString RequestProfiler::report() const
+{
+    auto statistics = this->statistics();
+    std::ranges::sort(statistics, std::greater {}, &RequestStatistics::totalLatency);
+
+    QString result = QString("LSP requests - %1 methods\n").arg(statistics.size());
+    for (const auto &methodStatistics : statistics)
+        result += QString("\n%1\n%2").arg(QString::fromStdString(methodStatistics.method), methodStatistics.toString());
+    return result;
+}
+
+}
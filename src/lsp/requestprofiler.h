@@ -0,0 +1,84 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Lsp {
+
+// Statistics of the requests sent to the LSP servers for one method
+struct RequestStatistics
+{
+    std::string method;
+    // Requests sent to the server
+    int count = 0;
+    // Requests sharing the response of an identical request already in flight
+    int shared = 0;
+    int cancelled = 0;
+    int responses = 0;
+    int inFlight = 0;
+    int maxInFlight = 0;
+    uint64_t requestBytes = 0;
+    uint64_t responseBytes = 0;
+    size_t maxResponseSize = 0;
+    std::chrono::microseconds totalLatency = {};
+
+    // Logarithmic histogram of the latencies: bucket i counts the latencies up to 2^(i/4) microseconds, so a
+    // percentile is known within 20%, with a fixed memory
+    static constexpr int BucketCount = 128;
+    std::array<uint32_t, BucketCount> latencies = {};
+
+    void addLatency(std::chrono::microseconds latency);
+    // Returns the latency for the percentile, between 0 and 1
+    std::chrono::microseconds latency(double percentile) const;
+    QString toString() const;
+};
+
+// Process-wide statistics of the LSP requests, merged by method. Printed on exit with `knut --lsp-stats`.
+class RequestProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static RequestProfiler &instance();
+
+    void requestSent(std::string_view method, size_t size);
+    void requestShared(std::string_view method);
+    void requestCancelled(std::string_view method);
+    void responseReceived(std::string_view method, size_t size, Clock::duration latency);
+
+    std::vector<RequestStatistics> statistics() const;
+    // Number of requests waiting for a response, for all methods
+    int inFlight() const;
+    void clear();
+
+    // Human readable report, the methods with the longest total latency first
+    QString report() const;
+
+private:
+    RequestProfiler() = default;
+
+    // Must be called with the mutex locked
+    RequestStatistics &methodStatistics(std::string_view method);
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, RequestStatistics, std::less<>> m_statistics;
+};
+
+}
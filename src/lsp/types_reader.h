@@ -0,0 +1,125 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// File generated by spec2cpp tool
+// DO NOT MAKE ANY CHANGES HERE
+
+#pragma once
+
+#include "jsonreader.h"
+#include "types.h"
+#include "types_json.h"
+
+namespace Lsp {
+
+inline bool read(JsonReader &reader, SymbolKind &value);
+inline bool read(JsonReader &reader, SymbolTag &value);
+inline bool read(JsonReader &reader, Location &value);
+inline bool read(JsonReader &reader, Range &value);
+inline bool read(JsonReader &reader, Position &value);
+inline bool read(JsonReader &reader, SymbolInformation &value);
+inline bool read(JsonReader &reader, DocumentSymbol &value);
+
+inline bool read(JsonReader &reader, SymbolKind &value)
+{
+    return readEnum(reader, value);
+}
+
+inline bool read(JsonReader &reader, SymbolTag &value)
+{
+    return readEnum(reader, value);
+}
+
+inline bool read(JsonReader &reader, Location &value)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "uri")
+            return readField(reader, value.uri, found, 0x1);
+        if (key == "range")
+            return readField(reader, value.range, found, 0x2);
+        return reader.skipValue();
+    });
+    return ok && found == 0x3;
+}
+
+inline bool read(JsonReader &reader, Range &value)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "start")
+            return readField(reader, value.start, found, 0x1);
+        if (key == "end")
+            return readField(reader, value.end, found, 0x2);
+        return reader.skipValue();
+    });
+    return ok && found == 0x3;
+}
+
+inline bool read(JsonReader &reader, Position &value)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "line")
+            return readField(reader, value.line, found, 0x1);
+        if (key == "character")
+            return readField(reader, value.character, found, 0x2);
+        return reader.skipValue();
+    });
+    return ok && found == 0x3;
+}
+
+inline bool read(JsonReader &reader, SymbolInformation &value)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "deprecated")
+            return read(reader, value.deprecated);
+        if (key == "location")
+            return readField(reader, value.location, found, 0x1);
+        if (key == "name")
+            return readField(reader, value.name, found, 0x2);
+        if (key == "kind")
+            return readField(reader, value.kind, found, 0x4);
+        if (key == "tags")
+            return read(reader, value.tags);
+        if (key == "containerName")
+            return read(reader, value.containerName);
+        return reader.skipValue();
+    });
+    return ok && found == 0x7;
+}
+
+inline bool read(JsonReader &reader, DocumentSymbol &value)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+        if (key == "name")
+            return readField(reader, value.name, found, 0x1);
+        if (key == "detail")
+            return read(reader, value.detail);
+        if (key == "kind")
+            return readField(reader, value.kind, found, 0x2);
+        if (key == "tags")
+            return read(reader, value.tags);
+        if (key == "deprecated")
+            return read(reader, value.deprecated);
+        if (key == "range")
+            return readField(reader, value.range, found, 0x4);
+        if (key == "selectionRange")
+            return readField(reader, value.selectionRange, found, 0x8);
+        if (key == "children")
+            return read(reader, value.children);
+        return reader.skipValue();
+    });
+    return ok && found == 0xf;
+}
+
+}
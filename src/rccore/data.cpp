@@ -227,50 +227,69 @@ bool operator==(const ToolBarItem &left, const ToolBarItem &right)
     return left.id == right.id;
 }
 
-template <typename T>
-const T *findById(const QList<T> &collection, const QString &id)
-{
-    auto it = std::find_if(collection.cbegin(), collection.cend(), [id](const auto &data) {
-        return data.id == id;
-    });
-    if (it == collection.cend())
-        return nullptr;
-    return &*it;
-}
-
 const Asset *Data::asset(const QString &id) const
 {
-    return findById(assets, id);
+    return m_assetIndex.find(assets, id);
 }
 
 const ToolBar *Data::toolBar(const QString &id) const
 {
-    return findById(toolBars, id);
+    return m_toolBarIndex.find(toolBars, id);
 }
 
 const Data::Dialog *Data::dialog(const QString &id) const
 {
-    return findById(dialogs, id);
+    return m_dialogIndex.find(dialogs, id);
 }
 
 const Data::DialogData *Data::dialogData(const QString &id) const
 {
-    return findById(dialogDataList, id);
+    return m_dialogDataIndex.find(dialogDataList, id);
 }
 
 const Menu *Data::menu(const QString &id) const
 {
-    return findById(menus, id);
+    return m_menuIndex.find(menus, id);
 }
 
 const Data::AcceleratorTable *Data::acceleratorTable(const QString &id) const
 {
-    return findById(acceleratorTables, id);
+    return m_acceleratorTableIndex.find(acceleratorTables, id);
 }
 
 const Ribbon *Data::ribbon(const QString &id) const
 {
-    return findById(ribbons, id);
+    return m_ribbonIndex.find(ribbons, id);
+}
+
+const Data::Control *Data::Dialog::control(const QString &id) const
+{
+    return controlIndex.find(controls, id);
+}
+
+void Data::buildIndexes()
+{
+    m_assetIndex.build(assets);
+    m_toolBarIndex.build(toolBars);
+    m_dialogIndex.build(dialogs);
+    m_dialogDataIndex.build(dialogDataList);
+    m_menuIndex.build(menus);
+    m_acceleratorTableIndex.build(acceleratorTables);
+    m_ribbonIndex.build(ribbons);
+    for (auto &dialog : dialogs)
+        dialog.controlIndex.build(dialog.controls);
+}
+
+void Data::internStrings(StringPool &pool)
+{
+    for (auto &dialog : dialogs) {
+        pool.intern(dialog.styles);
+        for (auto &control : dialog.controls) {
+            control.id = pool.intern(control.id);
+            control.className = pool.intern(control.className);
+            pool.intern(control.styles);
+        }
+    }
 }
 
 bool operator==(const Widget &left, const Widget &right)
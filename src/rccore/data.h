@@ -16,8 +16,11 @@
 #include <QHash>
 #include <QList>
 #include <QRect>
+#include <QSet>
 #include <QString>
+#include <QStringList>
 #include <QVariant>
+#include <algorithm>
 
 namespace RcCore {
 
@@ -213,6 +216,68 @@ public:
 };
 bool operator==(const String &left, const String &right);
 
+//=============================================================================
+// Index from an id to the position of the first item with this id in a list
+//=============================================================================
+// The index is only used if the list didn't change size since it was built, and falls back to a linear search
+// otherwise. It needs to be built again after changing the list.
+class IdIndex
+{
+public:
+    template <typename T>
+    void build(const QList<T> &list)
+    {
+        m_positions.clear();
+        m_positions.reserve(list.size());
+        for (qsizetype i = 0; i < list.size(); ++i) {
+            if (!m_positions.contains(list.at(i).id))
+                m_positions.insert(list.at(i).id, i);
+        }
+        m_size = list.size();
+    }
+
+    template <typename T>
+    const T *find(const QList<T> &list, const QString &id) const
+    {
+        if (m_size == list.size()) {
+            const auto it = m_positions.constFind(id);
+            if (it == m_positions.cend())
+                return nullptr;
+            if (list.at(it.value()).id == id)
+                return &list.at(it.value());
+        }
+        auto it = std::find_if(list.cbegin(), list.cend(), [&id](const auto &data) {
+            return data.id == id;
+        });
+        if (it == list.cend())
+            return nullptr;
+        return &*it;
+    }
+
+private:
+    QHash<QString, qsizetype> m_positions;
+    qsizetype m_size = -1;
+};
+
+//=============================================================================
+// Pool of the strings repeated all over a RC file
+//=============================================================================
+// The class names, ids and styles of the controls are the same few hundred values repeated for each control of each
+// language: interned through the pool, equal strings share the same data instead of each having a copy.
+class StringPool
+{
+public:
+    QString intern(const QString &string) { return *m_strings.insert(string); }
+    void intern(QStringList &strings)
+    {
+        for (auto &string : strings)
+            string = intern(string);
+    }
+
+private:
+    QSet<QString> m_strings;
+};
+
 //=============================================================================
 // Structure describing RC data for a given language
 //=============================================================================
@@ -263,6 +328,9 @@ struct Data
         QString menu;
         QStringList styles;
         QList<Control> controls;
+        IdIndex controlIndex;
+
+        const Control *control(const QString &id) const;
     };
 
     QString fileName;
@@ -287,6 +355,20 @@ struct Data
     const Menu *menu(const QString &id) const;
     const AcceleratorTable *acceleratorTable(const QString &id) const;
     const Ribbon *ribbon(const QString &id) const;
+
+    // Builds the indexes used by the accessors above, call it once the lists are filled
+    void buildIndexes();
+    // Shares the ids, class names and styles of the dialogs and controls with the other data using the same pool
+    void internStrings(StringPool &pool);
+
+private:
+    IdIndex m_assetIndex;
+    IdIndex m_toolBarIndex;
+    IdIndex m_dialogIndex;
+    IdIndex m_dialogDataIndex;
+    IdIndex m_menuIndex;
+    IdIndex m_acceleratorTableIndex;
+    IdIndex m_ribbonIndex;
 };
 
 } // namespace RcCore
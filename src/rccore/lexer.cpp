@@ -12,101 +12,188 @@
 #include "utils/log.h"
 
 #include <QDir>
-#include <QHash>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <utility>
 
 namespace RcCore {
 
-#define COMMA ,
+namespace {
+
+struct KeywordName
+{
+    QStringView name;
+    Keywords keyword;
+};
+
+// Perfect hash of the keyword names: a seed is found at compile time so that each name has its own slot. A word is
+// then a keyword only if it's the name in its slot, without allocating a string or probing a hash table.
+constexpr size_t KeywordSlotCount = 4096;
+
+struct KeywordTable
+{
+    uint32_t seed = 0;
+    // Index of the keyword name plus one, 0 for an empty slot
+    std::array<uint8_t, KeywordSlotCount> slots = {};
+};
+
+} // namespace
+
+// The first name of a keyword is the one used to print it
 // clang-format off
-Q_GLOBAL_STATIC_WITH_ARGS(QHash<QString COMMA Keywords>, KeywordMap, {
-    // Used in MENUITEM - not handled in Qt
-    {"ACCELERATORS" COMMA Keywords::ACCELERATORS} COMMA
-    {"AFX_DIALOG_LAYOUT" COMMA Keywords::AFX_DIALOG_LAYOUT} COMMA
-    {"BITMAP" COMMA Keywords::BITMAP} COMMA
-    {"CURSOR" COMMA Keywords::CURSOR} COMMA
-    {"DESIGNINFO" COMMA Keywords::DESIGNINFO} COMMA
-    {"DIALOG" COMMA Keywords::DIALOG} COMMA
-    {"DIALOGEX" COMMA Keywords::DIALOGEX} COMMA
-    {"DLGINIT" COMMA Keywords::DLGINIT} COMMA
-    {"FONT" COMMA Keywords::FONT} COMMA
-    {"HTML" COMMA Keywords::HTML} COMMA
-    {"ICON" COMMA Keywords::ICON} COMMA
-    {"IMAGE" COMMA Keywords::IMAGE} COMMA
-    {"MENU" COMMA Keywords::MENU} COMMA
-    {"MENUEX" COMMA Keywords::MENUEX} COMMA
-    {"MESSAGETABLE" COMMA Keywords::MESSAGETABLE} COMMA
-    {"PNG" COMMA Keywords::PNG} COMMA
-    {"POPUP" COMMA Keywords::POPUP} COMMA
-    {"RCDATA" COMMA Keywords::RCDATA} COMMA
-    {"REGISTRY" COMMA Keywords::REGISTRY} COMMA
-    {"STRINGTABLE" COMMA Keywords::STRINGTABLE} COMMA
-    {"TEXTINCLUDE" COMMA Keywords::TEXTINCLUDE} COMMA
-    {"TOOLBAR" COMMA Keywords::TOOLBAR} COMMA
-    {"VERSIONINFO" COMMA Keywords::VERSIONINFO} COMMA
-    {"RT_RIBBON_XML" COMMA Keywords::RT_RIBBON_XML} COMMA
-    {"PRELOAD" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"LOADONCALL" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"FIXED" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"MOVEABLE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"DISCARDABLE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"PURE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"IMPURE" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"SHARED" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"NONSHARED" COMMA Keywords::IGNORE_16BITS} COMMA
-    {"BEGIN" COMMA Keywords::BEGIN} COMMA
-    {"END" COMMA Keywords::END} COMMA
-    {"SEPARATOR" COMMA Keywords::SEPARATOR} COMMA
-    {"MFT_SEPARATOR" COMMA Keywords::SEPARATOR} COMMA
-    {"BUTTON" COMMA Keywords::BUTTON} COMMA
-    {"NOT" COMMA Keywords::NOT} COMMA
-    {"CHECKED" COMMA Keywords::CHECKED} COMMA
-    {"MFS_CHECKED" COMMA Keywords::CHECKED} COMMA
-    {"GRAYED" COMMA Keywords::GRAYED} COMMA
-    {"MFS_GRAYED" COMMA Keywords::GRAYED} COMMA
-    {"MFS_DISABLED" COMMA Keywords::INACTIVE} COMMA
-    {"HELP" COMMA Keywords::HELP} COMMA
-    {"INACTIVE" COMMA Keywords::INACTIVE} COMMA
-    {"MENUBARBREAK" COMMA Keywords::MENUBARBREAK} COMMA
-    {"MFT_MENUBARBREAK" COMMA Keywords::MENUBARBREAK} COMMA
-    {"MENUBREAK" COMMA Keywords::MENUBREAK} COMMA
-    {"MFT_MENUBREAK" COMMA Keywords::MENUBREAK} COMMA
-    {"MFT_STRING" COMMA Keywords::MFTSTRING} COMMA
-    {"MFS_ENABLED" COMMA Keywords::MFSENABLED} COMMA
-    {"MFT_RIGHTJUSTIFY" COMMA Keywords::MFTRIGHTJUSTIFY} COMMA
-    {"ALT" COMMA Keywords::ALT} COMMA
-    {"ASCII" COMMA Keywords::ASCII} COMMA
-    {"NOINVERT" COMMA Keywords::NOINVERT} COMMA
-    {"SHIFT" COMMA Keywords::SHIFT} COMMA
-    {"VIRTKEY" COMMA Keywords::VIRTKEY} COMMA
-    {"CAPTION" COMMA Keywords::CAPTION} COMMA
-    {"CHARACTERISTICS" COMMA Keywords::CHARACTERISTICS} COMMA
-    {"CLASS" COMMA Keywords::CLASS} COMMA
-    {"EXSTYLE" COMMA Keywords::EXSTYLE} COMMA
-    {"LANGUAGE" COMMA Keywords::LANGUAGE} COMMA
-    {"MENUITEM" COMMA Keywords::MENUITEM} COMMA
-    {"STYLE" COMMA Keywords::STYLE} COMMA
-    {"VERSION" COMMA Keywords::VERSION} COMMA
-    {"AUTO3STATE" COMMA Keywords::AUTO3STATE} COMMA
-    {"AUTOCHECKBOX" COMMA Keywords::AUTOCHECKBOX} COMMA
-    {"AUTORADIOBUTTON" COMMA Keywords::AUTORADIOBUTTON} COMMA
-    {"CHECKBOX" COMMA Keywords::CHECKBOX} COMMA
-    {"COMBOBOX" COMMA Keywords::COMBOBOX} COMMA
-    {"CONTROL" COMMA Keywords::CONTROL} COMMA
-    {"CTEXT" COMMA Keywords::CTEXT} COMMA
-    {"DEFPUSHBUTTON" COMMA Keywords::DEFPUSHBUTTON} COMMA
-    {"EDITTEXT" COMMA Keywords::EDITTEXT} COMMA
-    {"GROUPBOX" COMMA Keywords::GROUPBOX} COMMA
-    {"LISTBOX" COMMA Keywords::LISTBOX} COMMA
-    {"LTEXT" COMMA Keywords::LTEXT} COMMA
-    {"PUSHBOX" COMMA Keywords::PUSHBOX} COMMA
-    {"PUSHBUTTON" COMMA Keywords::PUSHBUTTON} COMMA
-    {"RADIOBUTTON" COMMA Keywords::RADIOBUTTON} COMMA
-    {"RTEXT" COMMA Keywords::RTEXT} COMMA
-    {"SCROLLBAR" COMMA Keywords::SCROLLBAR} COMMA
-    {"STATE3" COMMA Keywords::STATE3} COMMA
-});
+static constexpr KeywordName KeywordNames[] = {
+    {u"ACCELERATORS", Keywords::ACCELERATORS},
+    {u"AFX_DIALOG_LAYOUT", Keywords::AFX_DIALOG_LAYOUT},
+    {u"BITMAP", Keywords::BITMAP},
+    {u"CURSOR", Keywords::CURSOR},
+    {u"DESIGNINFO", Keywords::DESIGNINFO},
+    {u"DIALOG", Keywords::DIALOG},
+    {u"DIALOGEX", Keywords::DIALOGEX},
+    {u"DLGINIT", Keywords::DLGINIT},
+    {u"FONT", Keywords::FONT},
+    {u"HTML", Keywords::HTML},
+    {u"ICON", Keywords::ICON},
+    {u"IMAGE", Keywords::IMAGE},
+    {u"MENU", Keywords::MENU},
+    {u"MENUEX", Keywords::MENUEX},
+    {u"MESSAGETABLE", Keywords::MESSAGETABLE},
+    {u"PNG", Keywords::PNG},
+    {u"POPUP", Keywords::POPUP},
+    {u"RCDATA", Keywords::RCDATA},
+    {u"REGISTRY", Keywords::REGISTRY},
+    {u"STRINGTABLE", Keywords::STRINGTABLE},
+    {u"TEXTINCLUDE", Keywords::TEXTINCLUDE},
+    {u"TOOLBAR", Keywords::TOOLBAR},
+    {u"VERSIONINFO", Keywords::VERSIONINFO},
+    {u"RT_RIBBON_XML", Keywords::RT_RIBBON_XML},
+    {u"PRELOAD", Keywords::IGNORE_16BITS},
+    {u"LOADONCALL", Keywords::IGNORE_16BITS},
+    {u"FIXED", Keywords::IGNORE_16BITS},
+    {u"MOVEABLE", Keywords::IGNORE_16BITS},
+    {u"DISCARDABLE", Keywords::IGNORE_16BITS},
+    {u"PURE", Keywords::IGNORE_16BITS},
+    {u"IMPURE", Keywords::IGNORE_16BITS},
+    {u"SHARED", Keywords::IGNORE_16BITS},
+    {u"NONSHARED", Keywords::IGNORE_16BITS},
+    {u"BEGIN", Keywords::BEGIN},
+    {u"END", Keywords::END},
+    {u"SEPARATOR", Keywords::SEPARATOR},
+    {u"MFT_SEPARATOR", Keywords::SEPARATOR},
+    {u"BUTTON", Keywords::BUTTON},
+    {u"NOT", Keywords::NOT},
+    {u"CHECKED", Keywords::CHECKED},
+    {u"MFS_CHECKED", Keywords::CHECKED},
+    {u"GRAYED", Keywords::GRAYED},
+    {u"MFS_GRAYED", Keywords::GRAYED},
+    {u"MFS_DISABLED", Keywords::INACTIVE},
+    {u"HELP", Keywords::HELP},
+    {u"INACTIVE", Keywords::INACTIVE},
+    {u"MENUBARBREAK", Keywords::MENUBARBREAK},
+    {u"MFT_MENUBARBREAK", Keywords::MENUBARBREAK},
+    {u"MENUBREAK", Keywords::MENUBREAK},
+    {u"MFT_MENUBREAK", Keywords::MENUBREAK},
+    {u"MFT_STRING", Keywords::MFTSTRING},
+    {u"MFS_ENABLED", Keywords::MFSENABLED},
+    {u"MFT_RIGHTJUSTIFY", Keywords::MFTRIGHTJUSTIFY},
+    {u"ALT", Keywords::ALT},
+    {u"ASCII", Keywords::ASCII},
+    {u"NOINVERT", Keywords::NOINVERT},
+    {u"SHIFT", Keywords::SHIFT},
+    {u"VIRTKEY", Keywords::VIRTKEY},
+    {u"CAPTION", Keywords::CAPTION},
+    {u"CHARACTERISTICS", Keywords::CHARACTERISTICS},
+    {u"CLASS", Keywords::CLASS},
+    {u"EXSTYLE", Keywords::EXSTYLE},
+    {u"LANGUAGE", Keywords::LANGUAGE},
+    {u"MENUITEM", Keywords::MENUITEM},
+    {u"STYLE", Keywords::STYLE},
+    {u"VERSION", Keywords::VERSION},
+    {u"AUTO3STATE", Keywords::AUTO3STATE},
+    {u"AUTOCHECKBOX", Keywords::AUTOCHECKBOX},
+    {u"AUTORADIOBUTTON", Keywords::AUTORADIOBUTTON},
+    {u"CHECKBOX", Keywords::CHECKBOX},
+    {u"COMBOBOX", Keywords::COMBOBOX},
+    {u"CONTROL", Keywords::CONTROL},
+    {u"CTEXT", Keywords::CTEXT},
+    {u"DEFPUSHBUTTON", Keywords::DEFPUSHBUTTON},
+    {u"EDITTEXT", Keywords::EDITTEXT},
+    {u"GROUPBOX", Keywords::GROUPBOX},
+    {u"LISTBOX", Keywords::LISTBOX},
+    {u"LTEXT", Keywords::LTEXT},
+    {u"PUSHBOX", Keywords::PUSHBOX},
+    {u"PUSHBUTTON", Keywords::PUSHBUTTON},
+    {u"RADIOBUTTON", Keywords::RADIOBUTTON},
+    {u"RTEXT", Keywords::RTEXT},
+    {u"SCROLLBAR", Keywords::SCROLLBAR},
+    {u"STATE3", Keywords::STATE3},
+};
 // clang-format on
 
+static constexpr std::pair<qsizetype, qsizetype> keywordSizeRange()
+{
+    qsizetype min = KeywordNames[0].name.size();
+    qsizetype max = min;
+    for (const auto &entry : KeywordNames) {
+        min = std::min(min, entry.name.size());
+        max = std::max(max, entry.name.size());
+    }
+    return {min, max};
+}
+
+static constexpr auto KeywordSizes = keywordSizeRange();
+
+static constexpr size_t keywordSlot(QStringView word, uint32_t seed)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u ^ seed;
+    for (qsizetype i = 0; i < word.size(); ++i) {
+        hash ^= word[i].unicode();
+        hash *= 16777619u;
+    }
+    return hash % KeywordSlotCount;
+}
+
+static constexpr KeywordTable buildKeywordTable()
+{
+    static_assert(std::size(KeywordNames) < 256);
+    for (uint32_t seed = 0;; ++seed) {
+        KeywordTable table {.seed = seed};
+        bool collision = false;
+        for (size_t i = 0; i < std::size(KeywordNames) && !collision; ++i) {
+            auto &slot = table.slots[keywordSlot(KeywordNames[i].name, seed)];
+            collision = slot != 0;
+            slot = static_cast<uint8_t>(i + 1);
+        }
+        if (!collision)
+            return table;
+    }
+}
+
+static constexpr KeywordTable KeywordSlots = buildKeywordTable();
+
+static std::optional<Keywords> findKeyword(QStringView word)
+{
+    // All keywords are in upper case
+    if (word.size() < KeywordSizes.first || word.size() > KeywordSizes.second || word.front() < u'A'
+        || word.front() > u'Z')
+        return {};
+    const int slot = KeywordSlots.slots[keywordSlot(word, KeywordSlots.seed)];
+    if (slot == 0 || KeywordNames[slot - 1].name != word)
+        return {};
+    return KeywordNames[slot - 1].keyword;
+}
+
+static QString keywordName(Keywords keyword)
+{
+    for (const auto &entry : KeywordNames) {
+        if (entry.keyword == keyword)
+            return entry.name.toString();
+    }
+    return {};
+}
+
 //=============================================================================
 // Parser::Token
 //=============================================================================
@@ -115,7 +202,7 @@ QString Token::toString() const
 {
     if (data.index() == 1)
         return std::get<QString>(data);
-    return KeywordMap->key(std::get<Keywords>(data));
+    return keywordName(std::get<Keywords>(data));
 }
 
 QString Token::prettyPrint() const
@@ -132,7 +219,7 @@ QString Token::prettyPrint() const
     case Token::Integer:
         return QString::number(toInt());
     case Token::Keyword:
-        return KeywordMap->key(toKeyword());
+        return keywordName(toKeyword());
     case Token::Word:
         return toString();
     }
@@ -179,7 +266,7 @@ void Lexer::skipScope()
         skipSpace();
         const QChar &ch = m_stream.peek();
         if (ch == 'B' || ch == 'E') {
-            const QString word = readWhile([](const auto &c) {
+            const QStringView word = readWhile([](const auto &c) {
                 return c.isLetter();
             });
             if (word == "BEGIN")
@@ -202,7 +289,7 @@ void Lexer::skipToBegin()
         skipSpace();
         const QChar &ch = m_stream.peek();
         if (ch == 'B') {
-            const QString word = readWhile([](const auto &c) {
+            const QStringView word = readWhile([](const auto &c) {
                 return c.isLetter();
             });
             if (word == "BEGIN")
@@ -229,9 +316,19 @@ std::optional<Token> Lexer::peek()
     return m_current;
 }
 
+void Lexer::seek(qsizetype position, int line)
+{
+    m_stream.seek(position, line);
+    m_current.reset();
+}
+
 QList<QString> Lexer::keywords()
 {
-    return KeywordMap->keys();
+    QList<QString> keywords;
+    keywords.reserve(std::size(KeywordNames));
+    for (const auto &entry : KeywordNames)
+        keywords.append(entry.name.toString());
+    return keywords;
 }
 
 std::optional<Token> Lexer::readNext()
@@ -240,6 +337,8 @@ std::optional<Token> Lexer::readNext()
     if (m_stream.atEnd())
         return {};
 
+    m_tokenPosition = m_stream.position();
+    m_tokenLine = m_stream.line();
     const QChar &ch = m_stream.peek();
     if (ch == '/') { // Skip comments
         skipLine();
@@ -274,15 +373,27 @@ Token Lexer::readDirective()
 {
     m_stream.next(); // Read the first '#'
     return {Token::Directive, readWhile([](const auto &c) {
-                return c.isLetter();
-            })};
+                                  return c.isLetter();
+                              }).toString()};
 }
 
 Token Lexer::readString()
 {
-    QString str;
     m_stream.next(); // Read the first '"'
+
+    // Fast path: most strings don't have any escape sequence, and are just a slice of the content
+    QString str = readWhile([](const auto &c) {
+                      return c != '"' && c != '\\';
+                  }).toString();
     bool escaped = false;
+    if (m_stream.peek() == '"') {
+        m_stream.next();
+        // " are escaped with "" in RC files
+        if (m_stream.peek() != '"')
+            return {Token::String, str};
+        escaped = true;
+    }
+
     while (!m_stream.atEnd()) {
         const QChar &ch = m_stream.next();
         if (escaped) {
@@ -312,43 +423,40 @@ Token Lexer::readString()
 
 Token Lexer::readInclude()
 {
-    QString str;
-    m_stream.next(); // Read the first '"'
-    while (!m_stream.atEnd()) {
-        const QChar &ch = m_stream.next();
-        if (ch == '>')
-            break;
-        else
-            str += ch;
-    }
+    m_stream.next(); // Read the first '<'
+    const QString str = readWhile([](const auto &c) {
+                            return c != '>';
+                        }).toString();
+    m_stream.next(); // Read the last '>'
     return {Token::String, str};
 }
 
 Token Lexer::readNumber()
 {
-    QString text = m_stream.next();
-    if (text[0] == '0' && m_stream.peek() == 'x') {
-        text += m_stream.next();
-        text += readWhile([](const auto &c) {
+    const auto start = m_stream.position();
+    const QChar first = m_stream.next();
+    if (first == '0' && m_stream.peek() == 'x') {
+        m_stream.next();
+        readWhile([](const auto &c) {
             return c.isLetterOrNumber();
         });
-        return {Token::Word, text};
+        return {Token::Word, m_stream.textFrom(start).toString()};
     }
 
-    text += readWhile([](const auto &c) {
+    readWhile([](const auto &c) {
         return c.isNumber();
     });
-    return {Token::Integer, text.toInt()};
+    return {Token::Integer, m_stream.textFrom(start).toInt()};
 }
 
 Token Lexer::readWord()
 {
-    const QString word = readWhile([](const auto &c) {
+    const QStringView word = readWhile([](const auto &c) {
         return c.isLetterOrNumber() || c == '_';
     });
-    if (auto it = KeywordMap->find(word); it != KeywordMap->end())
-        return {Token::Keyword, it.value()};
-    return {Token::Word, word};
+    if (const auto keyword = findKeyword(word))
+        return {Token::Keyword, *keyword};
+    return {Token::Word, word.toString()};
 }
 
 } // namespace RcCore
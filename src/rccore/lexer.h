@@ -146,7 +146,13 @@ public:
     void skipToBegin();
 
     int line() const { return m_stream.line(); }
-    QString content() const { return m_stream.content(); }
+    const QString &content() const { return m_stream.content(); }
+
+    // Position and line of the start of the last token read or peeked
+    qsizetype tokenPosition() const { return m_tokenPosition; }
+    int tokenLine() const { return m_tokenLine; }
+    // Continues lexing from position, which is the start of a token or a line
+    void seek(qsizetype position, int line);
 
     void setFileName(const QString &name) { m_fileName = name; }
     QString fileName() const { return m_fileName; }
@@ -162,16 +168,13 @@ private:
     template <typename Func>
     void skipWhile(Func func)
     {
-        while (!m_stream.atEnd() && std::invoke(func, m_stream.peek()))
-            m_stream.next();
+        m_stream.readWhile(func);
     }
+    // The view is only valid as long as the lexer is alive
     template <typename Func>
-    QString readWhile(Func func)
+    QStringView readWhile(Func func)
     {
-        QString result;
-        while (!m_stream.atEnd() && std::invoke(func, m_stream.peek()))
-            result += m_stream.next();
-        return result;
+        return m_stream.readWhile(func);
     }
 
     Token readDirective();
@@ -184,6 +187,8 @@ private:
     Stream m_stream;
     std::optional<Token> m_current;
     QString m_fileName;
+    qsizetype m_tokenPosition = 0;
+    int m_tokenLine = 1;
 };
 
 } // namespace RcCore
@@ -0,0 +1,295 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "rc_cache_p.h"
+#include "rcfile.h"
+#include "utils/log.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <tuple>
+#include <type_traits>
+
+namespace RcCore {
+
+//=============================================================================
+// Serialization of the RC data
+//=============================================================================
+// Each serialized struct lists its members here, in the order they are stored in the cache.
+// Increase CacheVersion when changing any of the lists, or the structs themselves.
+static constexpr quint32 CacheMagic = 0x4b524343; // KRCC
+static constexpr quint32 CacheVersion = 1;
+
+// clang-format off
+static constexpr auto cacheMembers(std::type_identity<Asset>) {
+    return std::make_tuple(&Asset::id, &Asset::fileName, &Asset::exist, &Asset::line, &Asset::originalFileName,
+                           &Asset::iconRect);
+}
+static constexpr auto cacheMembers(std::type_identity<ToolBarItem>) {
+    return std::make_tuple(&ToolBarItem::id, &ToolBarItem::line);
+}
+static constexpr auto cacheMembers(std::type_identity<ToolBar>) {
+    return std::make_tuple(&ToolBar::id, &ToolBar::iconSize, &ToolBar::children, &ToolBar::line);
+}
+static constexpr auto cacheMembers(std::type_identity<MenuItem>) {
+    return std::make_tuple(&MenuItem::id, &MenuItem::text, &MenuItem::children, &MenuItem::isTopLevel,
+                           &MenuItem::shortcut, &MenuItem::flags, &MenuItem::line);
+}
+static constexpr auto cacheMembers(std::type_identity<Menu>) {
+    return std::make_tuple(&Menu::id, &Menu::children, &Menu::line);
+}
+static constexpr auto cacheMembers(std::type_identity<String>) {
+    return std::make_tuple(&String::id, &String::text, &String::line);
+}
+static constexpr auto cacheMembers(std::type_identity<RibbonElement>) {
+    return std::make_tuple(&RibbonElement::type, &RibbonElement::id, &RibbonElement::text, &RibbonElement::keys,
+                           &RibbonElement::smallIndex, &RibbonElement::largeIndex, &RibbonElement::elements);
+}
+static constexpr auto cacheMembers(std::type_identity<RibbonPanel>) {
+    return std::make_tuple(&RibbonPanel::text, &RibbonPanel::keys, &RibbonPanel::elements);
+}
+static constexpr auto cacheMembers(std::type_identity<RibbonCategory>) {
+    return std::make_tuple(&RibbonCategory::text, &RibbonCategory::keys, &RibbonCategory::smallImage,
+                           &RibbonCategory::largeImage, &RibbonCategory::panels);
+}
+static constexpr auto cacheMembers(std::type_identity<RibbonContext>) {
+    return std::make_tuple(&RibbonContext::id, &RibbonContext::text, &RibbonContext::categories);
+}
+static constexpr auto cacheMembers(std::type_identity<RibbonMenu>) {
+    return std::make_tuple(&RibbonMenu::text, &RibbonMenu::smallImage, &RibbonMenu::largeImage,
+                           &RibbonMenu::elements, &RibbonMenu::recentFilesText);
+}
+static constexpr auto cacheMembers(std::type_identity<Ribbon>) {
+    return std::make_tuple(&Ribbon::id, &Ribbon::menu, &Ribbon::categories, &Ribbon::contexts, &Ribbon::line,
+                           &Ribbon::fileName);
+}
+static constexpr auto cacheMembers(std::type_identity<Data::Include>) {
+    return std::make_tuple(&Data::Include::line, &Data::Include::fileName, &Data::Include::exist);
+}
+static constexpr auto cacheMembers(std::type_identity<Data::DialogData>) {
+    return std::make_tuple(&Data::DialogData::line, &Data::DialogData::id, &Data::DialogData::values);
+}
+static constexpr auto cacheMembers(std::type_identity<Data::Accelerator>) {
+    return std::make_tuple(&Data::Accelerator::line, &Data::Accelerator::id, &Data::Accelerator::shortcut);
+}
+static constexpr auto cacheMembers(std::type_identity<Data::AcceleratorTable>) {
+    return std::make_tuple(&Data::AcceleratorTable::line, &Data::AcceleratorTable::id,
+                           &Data::AcceleratorTable::accelerators);
+}
+static constexpr auto cacheMembers(std::type_identity<Data::Control>) {
+    return std::make_tuple(&Data::Control::line, &Data::Control::type, &Data::Control::text, &Data::Control::id,
+                           &Data::Control::className, &Data::Control::geometry, &Data::Control::styles);
+}
+static constexpr auto cacheMembers(std::type_identity<Data::Dialog>) {
+    return std::make_tuple(&Data::Dialog::line, &Data::Dialog::id, &Data::Dialog::geometry, &Data::Dialog::caption,
+                           &Data::Dialog::menu, &Data::Dialog::styles, &Data::Dialog::controls);
+}
+static constexpr auto cacheMembers(std::type_identity<Data>) {
+    return std::make_tuple(&Data::fileName, &Data::language, &Data::icons, &Data::assets, &Data::strings,
+                           &Data::acceleratorTables, &Data::menus, &Data::toolBars, &Data::dialogDataList,
+                           &Data::dialogs, &Data::ribbons);
+}
+static constexpr auto cacheMembers(std::type_identity<RcFile>) {
+    return std::make_tuple(&RcFile::fileName, &RcFile::content, &RcFile::isValid, &RcFile::includes,
+                           &RcFile::resourceMap, &RcFile::data);
+}
+// clang-format on
+
+template <typename T>
+concept Cacheable = requires { cacheMembers(std::type_identity<T> {}); };
+
+template <Cacheable T>
+QDataStream &operator<<(QDataStream &stream, const T &value)
+{
+    std::apply(
+        [&](auto... member) {
+            ((stream << value.*member), ...);
+        },
+        cacheMembers(std::type_identity<T> {}));
+    return stream;
+}
+
+template <Cacheable T>
+QDataStream &operator>>(QDataStream &stream, T &value)
+{
+    std::apply(
+        [&](auto... member) {
+            ((stream >> value.*member), ...);
+        },
+        cacheMembers(std::type_identity<T> {}));
+    return stream;
+}
+
+//=============================================================================
+// Cache validation
+//=============================================================================
+QDataStream &operator<<(QDataStream &stream, const CacheDependency &dependency)
+{
+    return stream << dependency.fileName << dependency.exist << dependency.size << dependency.lastModified
+                  << dependency.hash;
+}
+
+QDataStream &operator>>(QDataStream &stream, CacheDependency &dependency)
+{
+    return stream >> dependency.fileName >> dependency.exist >> dependency.size >> dependency.lastModified
+        >> dependency.hash;
+}
+
+static QByteArray fileHash(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+CacheDependency createDependency(const QString &fileName, bool withHash)
+{
+    const QFileInfo fi(fileName);
+    CacheDependency dependency {.fileName = fileName, .exist = fi.exists()};
+    if (dependency.exist && withHash) {
+        dependency.size = fi.size();
+        dependency.lastModified = fi.lastModified().toMSecsSinceEpoch();
+        dependency.hash = fileHash(fileName);
+    }
+    return dependency;
+}
+
+bool isUpToDate(const CacheDependency &dependency)
+{
+    const QFileInfo fi(dependency.fileName);
+    if (fi.exists() != dependency.exist)
+        return false;
+    if (!dependency.exist || dependency.hash.isEmpty())
+        return true;
+    // The modification time is only used as a shortcut, a touched but unchanged file is still valid
+    if (fi.size() == dependency.size && fi.lastModified().toMSecsSinceEpoch() == dependency.lastModified)
+        return true;
+    return fi.size() == dependency.size && fileHash(dependency.fileName) == dependency.hash;
+}
+
+static QList<CacheDependency> dependencies(const RcFile &rcFile)
+{
+    QList<CacheDependency> result;
+    result.push_back(createDependency(rcFile.fileName, true));
+    for (const auto &include : rcFile.includes) {
+        if (include.exist)
+            result.push_back(createDependency(include.fileName, true));
+    }
+    for (const auto &data : rcFile.data) {
+        for (const auto &ribbon : data.ribbons)
+            result.push_back(createDependency(ribbon.fileName, true));
+        // Only the existence of the assets is part of the parsed data
+        for (const auto &asset : data.icons)
+            result.push_back(createDependency(asset.fileName, false));
+        for (const auto &asset : data.assets)
+            result.push_back(createDependency(asset.fileName, false));
+    }
+    return result;
+}
+
+//=============================================================================
+// RcCore::parseCached
+//=============================================================================
+static QString cacheFilePath(const QString &fileName, const QString &cacheDir)
+{
+    const QFileInfo fi(fileName);
+    const auto pathHash = QCryptographicHash::hash(fi.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+    return QStringLiteral("%1/%2-%3.rccache").arg(cacheDir, fi.completeBaseName(), pathHash.toHex().left(16));
+}
+
+static std::optional<RcFile> loadCache(const QString &fileName, const QString &cacheFileName)
+{
+    QFile file(cacheFileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    // The data is copied while deserializing, so the mapping only lives as long as the file
+    const auto size = file.size();
+    const uchar *mapped = file.map(0, size);
+    if (!mapped)
+        return {};
+    const auto buffer = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), size);
+
+    QDataStream stream(buffer);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString sourceFileName;
+    stream >> magic >> version >> sourceFileName;
+    if (magic != CacheMagic || version != CacheVersion || sourceFileName != fileName)
+        return {};
+
+    QList<CacheDependency> dependencies;
+    stream >> dependencies;
+    if (stream.status() != QDataStream::Ok)
+        return {};
+    for (const auto &dependency : std::as_const(dependencies)) {
+        if (!isUpToDate(dependency))
+            return {};
+    }
+
+    RcFile rcFile;
+    stream >> rcFile;
+    if (stream.status() != QDataStream::Ok) {
+        spdlog::warn("RcCore::parseCached - invalid cache file {}", cacheFileName);
+        return {};
+    }
+    // The indexes are not part of the cache, and each string is read on its own
+    StringPool stringPool;
+    for (auto &data : rcFile.data) {
+        data.internStrings(stringPool);
+        data.buildIndexes();
+    }
+    return rcFile;
+}
+
+static void saveCache(const RcFile &rcFile, const QString &cacheFileName)
+{
+    QDir().mkpath(QFileInfo(cacheFileName).absolutePath());
+    QSaveFile file(cacheFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        spdlog::warn("RcCore::parseCached - can't write cache file {}", cacheFileName);
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << CacheMagic << CacheVersion << rcFile.fileName << dependencies(rcFile) << rcFile;
+    if (stream.status() != QDataStream::Ok || !file.commit())
+        spdlog::warn("RcCore::parseCached - can't write cache file {}", cacheFileName);
+}
+
+RcFile parseCached(const QString &fileName, const QString &cacheDir)
+{
+    QElapsedTimer time;
+    time.start();
+
+    const auto cacheFileName = cacheFilePath(fileName, cacheDir);
+    if (auto rcFile = loadCache(fileName, cacheFileName)) {
+        spdlog::debug("RcCore::parseCached - {} loaded from cache in {}ms", fileName, time.elapsed());
+        return std::move(rcFile).value();
+    }
+
+    auto rcFile = parse(fileName);
+    if (rcFile.isValid)
+        saveCache(rcFile, cacheFileName);
+    return rcFile;
+}
+
+} // namespace RcCore
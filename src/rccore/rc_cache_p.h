@@ -0,0 +1,36 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+class QDataStream;
+
+namespace RcCore {
+
+// A file some cached data depends on. Files without hash are only checked for their existence.
+struct CacheDependency
+{
+    QString fileName;
+    bool exist = false;
+    qint64 size = 0;
+    qint64 lastModified = 0;
+    QByteArray hash;
+};
+
+CacheDependency createDependency(const QString &fileName, bool withHash);
+bool isUpToDate(const CacheDependency &dependency);
+
+QDataStream &operator<<(QDataStream &stream, const CacheDependency &dependency);
+QDataStream &operator>>(QDataStream &stream, CacheDependency &dependency);
+
+} // namespace RcCore
@@ -520,63 +520,89 @@ static Widget convertTabWidget(const Data &data, Data::Control &control)
     return widget;
 }
 
+enum class ControlClass {
+    Label,
+    Button,
+    ComboBox,
+    EditText,
+    Slider,
+    SpinBox,
+    ProgressBar,
+    ScrollBar,
+    Calendar,
+    DateTime,
+    IpAddress,
+    ListWidget,
+    TreeWidget,
+    TabWidget,
+};
+
 // https://docs.microsoft.com/en-us/windows/desktop/menurc/control-control
 static Widget convertControl(const Data &data, const QString &dialogId, Data::Control &control, bool useIdForPixmap)
 {
-    if (control.className == "Static")
-        return convertLabel(data, control, useIdForPixmap);
-    if (control.className == "Button")
-        return convertButton(data, control);
-    if (control.className == "ComboBox")
-        return convertComboBox(data, dialogId, control);
-    if (control.className == "ComboBoxEx32")
-        return convertComboBox(data, dialogId, control);
-    if (control.className == "Edit")
-        return convertEditText(data, control);
-    if (control.className == "RICHEDIT")
-        return convertEditText(data, control);
-    if (control.className == "RichEdit20W")
-        return convertEditText(data, control);
-    if (control.className == "RichEdit20A")
-        return convertEditText(data, control);
-    if (control.className == "msctls_trackbar")
-        return convertSlider(data, control);
-    if (control.className == "msctls_trackbar32")
-        return convertSlider(data, control);
-    if (control.className == "msctls_updown")
-        return convertSpinBox(data, control);
-    if (control.className == "msctls_updown32")
-        return convertSpinBox(data, control);
-    if (control.className == "msctls_progress")
-        return convertProgressBar(data, control);
-    if (control.className == "msctls_progress32")
-        return convertProgressBar(data, control);
-    if (control.className == "ScrollBar")
-        return convertScrollBar(data, control);
-    if (control.className == "SysMonthCal32")
-        return convertCalendarWidget(data, control);
-    if (control.className == "SysDateTimePick32")
-        return convertDateTime(data, control);
-    if (control.className == "SysIPAddress32")
-        return convertIpAddress(data, control);
-    if (control.className == "SysListView")
-        return convertListWidget(data, control);
-    if (control.className == "SysListView32")
-        return convertListWidget(data, control);
-    if (control.className == "SysTreeView")
-        return convertTreeWidget(data, control);
-    if (control.className == "SysTreeView32")
-        return convertTreeWidget(data, control);
-    if (control.className == "SysTabControl")
-        return convertTabWidget(data, control);
-    if (control.className == "SysTabControl32")
-        return convertTabWidget(data, control);
-    if (control.className == "SysLink")
-        return convertLabel(data, control, useIdForPixmap);
-    if (control.className == "MfcPropertyGrid")
-        return convertTreeWidget(data, control);
-    if (control.className == "MfcButton")
-        return convertButton(data, control);
+    // One lookup for each control, instead of comparing its class name with each of them
+    static const QHash<QString, ControlClass> controlClasses = {
+        {"Static", ControlClass::Label},
+        {"Button", ControlClass::Button},
+        {"ComboBox", ControlClass::ComboBox},
+        {"ComboBoxEx32", ControlClass::ComboBox},
+        {"Edit", ControlClass::EditText},
+        {"RICHEDIT", ControlClass::EditText},
+        {"RichEdit20W", ControlClass::EditText},
+        {"RichEdit20A", ControlClass::EditText},
+        {"msctls_trackbar", ControlClass::Slider},
+        {"msctls_trackbar32", ControlClass::Slider},
+        {"msctls_updown", ControlClass::SpinBox},
+        {"msctls_updown32", ControlClass::SpinBox},
+        {"msctls_progress", ControlClass::ProgressBar},
+        {"msctls_progress32", ControlClass::ProgressBar},
+        {"ScrollBar", ControlClass::ScrollBar},
+        {"SysMonthCal32", ControlClass::Calendar},
+        {"SysDateTimePick32", ControlClass::DateTime},
+        {"SysIPAddress32", ControlClass::IpAddress},
+        {"SysListView", ControlClass::ListWidget},
+        {"SysListView32", ControlClass::ListWidget},
+        {"SysTreeView", ControlClass::TreeWidget},
+        {"SysTreeView32", ControlClass::TreeWidget},
+        {"SysTabControl", ControlClass::TabWidget},
+        {"SysTabControl32", ControlClass::TabWidget},
+        {"SysLink", ControlClass::Label},
+        {"MfcPropertyGrid", ControlClass::TreeWidget},
+        {"MfcButton", ControlClass::Button},
+    };
+
+    if (const auto it = controlClasses.constFind(control.className); it != controlClasses.cend()) {
+        switch (*it) {
+        case ControlClass::Label:
+            return convertLabel(data, control, useIdForPixmap);
+        case ControlClass::Button:
+            return convertButton(data, control);
+        case ControlClass::ComboBox:
+            return convertComboBox(data, dialogId, control);
+        case ControlClass::EditText:
+            return convertEditText(data, control);
+        case ControlClass::Slider:
+            return convertSlider(data, control);
+        case ControlClass::SpinBox:
+            return convertSpinBox(data, control);
+        case ControlClass::ProgressBar:
+            return convertProgressBar(data, control);
+        case ControlClass::ScrollBar:
+            return convertScrollBar(data, control);
+        case ControlClass::Calendar:
+            return convertCalendarWidget(data, control);
+        case ControlClass::DateTime:
+            return convertDateTime(data, control);
+        case ControlClass::IpAddress:
+            return convertIpAddress(data, control);
+        case ControlClass::ListWidget:
+            return convertListWidget(data, control);
+        case ControlClass::TreeWidget:
+            return convertTreeWidget(data, control);
+        case ControlClass::TabWidget:
+            return convertTabWidget(data, control);
+        }
+    }
 
     spdlog::warn("{}({}): unknown CONTROL {} / {}", data.fileName, control.line, control.id, control.className);
 
@@ -11,15 +11,24 @@
 #include "lexer.h"
 #include "rcfile.h"
 #include "stream.h"
+#include "utils/cancellation.h"
 #include "utils/log.h"
+#include "utils/taskscheduler.h"
+#include "utils/trace.h"
 
+#include <QDateTime>
 #include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QHash>
 #include <QKeySequence>
-#include <QTextStream>
+#include <array>
+#include <charconv>
+#include <cstring>
 #include <kdalgorithms.h>
+#include <mutex>
+#include <string_view>
+#include <vector>
 
 namespace RcCore {
 
@@ -62,30 +71,81 @@ static std::optional<QString> computeFilePath(const QString &absolutePath, const
     return {};
 }
 
-static QHash<int, QString> loadResourceFile(const QString &resourceFile)
+// Reads the `#define NAME VALUE` lines of a resource header, the other lines are skipped without decoding them
+static QHash<int, QString> parseResourceFile(const QByteArray &content)
 {
-    QFile file(resourceFile);
-    if (!file.open(QIODevice::ReadOnly))
-        return {};
+    auto isSpace = [](char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    };
 
-    QTextStream stream(&file);
     QHash<int, QString> resourceMap;
-    while (!stream.atEnd()) {
-        const QString line = stream.readLine();
-        if (!line.startsWith("#define"))
+    const char *it = content.constData();
+    const char *const end = it + content.size();
+    while (it < end) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(it, '\n', end - it));
+        if (!lineEnd)
+            lineEnd = end;
+        const char *const lineStart = it;
+        it = lineEnd + 1;
+
+        constexpr std::string_view define = "#define";
+        if (lineEnd - lineStart <= static_cast<qsizetype>(define.size())
+            || std::string_view(lineStart, define.size()) != define || !isSpace(lineStart[define.size()]))
             continue;
 
-        QStringList fields = line.split(' ', Qt::SkipEmptyParts);
-        if (fields.size() < 3)
+        // Splits the next two fields
+        std::array<std::string_view, 2> fields;
+        const char *c = lineStart + define.size();
+        for (auto &field : fields) {
+            while (c < lineEnd && isSpace(*c))
+                ++c;
+            const char *const fieldStart = c;
+            while (c < lineEnd && !isSpace(*c))
+                ++c;
+            field = std::string_view(fieldStart, c - fieldStart);
+        }
+        if (fields[1].empty())
             continue;
-        const auto &value = fields.at(1);
-        bool ok;
-        const int key = fields.at(2).toInt(&ok);
-        if (!ok)
+
+        int key = 0;
+        const auto result = std::from_chars(fields[1].data(), fields[1].data() + fields[1].size(), key);
+        if (result.ec != std::errc() || result.ptr != fields[1].data() + fields[1].size())
             continue;
 
-        resourceMap[key] = value;
+        resourceMap[key] = QString::fromUtf8(fields[0].data(), fields[0].size());
+    }
+    return resourceMap;
+}
+
+// Resource headers are often shared by several RC files, they are only parsed again if they changed
+static QHash<int, QString> loadResourceFile(const QString &resourceFile)
+{
+    struct Entry
+    {
+        qint64 size = 0;
+        qint64 lastModified = 0;
+        QHash<int, QString> resourceMap;
+    };
+    static std::mutex mutex;
+    static QHash<QString, Entry> entries;
+
+    const QFileInfo fi(resourceFile);
+    const qint64 size = fi.size();
+    const qint64 lastModified = fi.lastModified().toMSecsSinceEpoch();
+    {
+        std::lock_guard lock(mutex);
+        const auto it = entries.constFind(resourceFile);
+        if (it != entries.cend() && it->size == size && it->lastModified == lastModified)
+            return it->resourceMap;
     }
+
+    QFile file(resourceFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    const auto resourceMap = parseResourceFile(file.readAll());
+
+    std::lock_guard lock(mutex);
+    entries.insert(resourceFile, {size, lastModified, resourceMap});
     return resourceMap;
 }
 
@@ -1395,26 +1455,108 @@ static void readDirective(Context &context, const QString &directive)
 //=============================================================================
 // RcFileUtils::parse
 //=============================================================================
-RcFile parse(const QString &fileName)
+// Part of the file parsed on its own: the file is split at each top-level LANGUAGE statement, and after each include
+// changing the resource ids, so the segments only depend on what's before them through the language and the ids.
+struct Segment
 {
-    QElapsedTimer time;
-    time.start();
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))
-        return {};
-
+    qsizetype start = 0;
+    int line = 1;
+    qsizetype end = 0;
+    QString language;
+    QHash<int, QString> resourceMap;
     RcFile rcFile;
-    rcFile.fileName = fileName;
+    bool isValid = false;
+};
 
-    Lexer lexer(Stream {&file});
-    lexer.setFileName(fileName);
-    rcFile.content = lexer.content();
+// Skips a resource without reading it, the same way readResource does
+static void skipResource(Lexer &lexer, Keywords keyword)
+{
+    skipResourceAttributes(lexer);
+    switch (keyword) {
+    case Keywords::AFX_DIALOG_LAYOUT:
+    case Keywords::DESIGNINFO:
+    case Keywords::TEXTINCLUDE:
+    case Keywords::RCDATA:
+    case Keywords::VERSIONINFO:
+    case Keywords::ACCELERATORS:
+    case Keywords::DIALOG:
+    case Keywords::DIALOGEX:
+    case Keywords::DLGINIT:
+    case Keywords::MENU:
+    case Keywords::MENUEX:
+    case Keywords::STRINGTABLE:
+    case Keywords::TOOLBAR:
+    case Keywords::BEGIN:
+        lexer.skipScope();
+        break;
+    default:
+        lexer.skipLine();
+        break;
+    }
+}
 
-    Context context = {.rcFile = rcFile, .lexer = lexer};
+// Reads the includes and the languages, and returns the segments to parse
+static std::vector<Segment> splitSegments(Context &context)
+{
+    LEXER_FROM_CONTEXT;
+
+    std::vector<Segment> segments;
+    auto startSegment = [&]() {
+        if (!segments.empty())
+            segments.back().end = lexer.tokenPosition();
+        segments.push_back({.start = lexer.tokenPosition(),
+                            .line = lexer.tokenLine(),
+                            .language = context.currentLanguage,
+                            .resourceMap = context.rcFile.resourceMap});
+    };
+
+    bool resourceMapChanged = true;
+    while (const auto token = lexer.peek()) {
+        if (Utils::Cancellation::isCanceled())
+            return {};
+        if (resourceMapChanged) {
+            startSegment();
+            resourceMapChanged = false;
+        }
+        lexer.next();
+        if (token->type == Token::Directive) {
+            const auto size = context.rcFile.resourceMap.size();
+            readDirective(context, token->toString());
+            resourceMapChanged = context.rcFile.resourceMap.size() != size;
+        } else if (token->type == Token::Keyword) {
+            if (token->toKeyword() == Keywords::LANGUAGE) {
+                if (segments.back().start != lexer.tokenPosition())
+                    startSegment();
+                skipResourceAttributes(lexer);
+                readLanguage(context);
+            } else {
+                skipResource(lexer, token->toKeyword());
+            }
+        }
+    }
+    if (!segments.empty())
+        segments.back().end = lexer.content().size();
+    return segments;
+}
+
+static void parseSegment(const RcFile &rcFile, Segment &segment)
+{
+    Lexer lexer(Stream {rcFile.content});
+    lexer.setFileName(rcFile.fileName);
+    lexer.seek(segment.start, segment.line);
+
+    segment.rcFile.fileName = rcFile.fileName;
+    segment.rcFile.resourceMap = segment.resourceMap;
+    Context context = {.rcFile = segment.rcFile, .lexer = lexer};
+    if (!segment.language.isEmpty())
+        context.setCurrentData(segment.language);
 
     try {
         std::optional<Token> previousToken;
-        while (lexer.peek()) {
+        while (lexer.peek() && lexer.tokenPosition() < segment.end) {
+            // The segment stays invalid, so the file isn't loaded
+            if (Utils::Cancellation::isCanceled())
+                return;
             const auto token = lexer.next();
             switch (token->type) {
             case Token::Operator_Comma:
@@ -1433,7 +1575,8 @@ RcFile parse(const QString &fileName)
                 previousToken = token;
                 break;
             case Token::Directive:
-                readDirective(context, token->toString());
+                // Already read by splitSegments
+                lexer.skipLine();
                 break;
             case Token::Keyword: {
                 readResource(context, token, previousToken);
@@ -1444,7 +1587,80 @@ RcFile parse(const QString &fileName)
         }
     } catch (...) {
         spdlog::critical("{}({}): parser general error", context.fileName(), context.line());
+        return;
+    }
+    segment.isValid = true;
+}
+
+// The segments are merged in the file order, so the result is the same as parsing the file in one go
+static void mergeSegment(RcFile &rcFile, Segment &segment)
+{
+    for (auto &[language, segmentData] : segment.rcFile.data.asKeyValueRange()) {
+        auto &data = rcFile.data[language];
+        data.language = language;
+        data.fileName = rcFile.fileName;
+        data.icons.append(std::move(segmentData.icons));
+        data.assets.append(std::move(segmentData.assets));
+        data.strings.insert(segmentData.strings);
+        data.acceleratorTables.append(std::move(segmentData.acceleratorTables));
+        data.menus.append(std::move(segmentData.menus));
+        data.toolBars.append(std::move(segmentData.toolBars));
+        data.dialogDataList.append(std::move(segmentData.dialogDataList));
+        data.dialogs.append(std::move(segmentData.dialogs));
+        data.ribbons.append(std::move(segmentData.ribbons));
+    }
+}
+
+RcFile parse(const QString &fileName)
+{
+    TRACE("RcCore::parse", fileName);
+    QElapsedTimer time;
+    time.start();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
         return {};
+
+    RcFile rcFile;
+    rcFile.fileName = fileName;
+
+    Lexer lexer(Stream {&file});
+    lexer.setFileName(fileName);
+    rcFile.content = lexer.content();
+
+    Context context = {.rcFile = rcFile, .lexer = lexer};
+
+    // Multilingual files are mostly independent parses, one for each language, done in parallel
+    std::vector<Segment> segments;
+    try {
+        segments = splitSegments(context);
+    } catch (...) {
+        spdlog::critical("{}({}): parser general error", context.fileName(), context.line());
+        return {};
+    }
+    if (Utils::Cancellation::isCanceled())
+        return {};
+    if (segments.size() == 1) {
+        parseSegment(rcFile, segments.front());
+    } else {
+        Utils::TaskGroup tasks;
+        for (auto &segment : segments) {
+            tasks.start([&rcFile, &segment]() {
+                parseSegment(rcFile, segment);
+            });
+        }
+        tasks.wait();
+    }
+
+    for (auto &segment : segments) {
+        if (!segment.isValid)
+            return {};
+        mergeSegment(rcFile, segment);
+    }
+    // The languages are parsed in parallel, their strings are only shared once they are all done
+    StringPool stringPool;
+    for (auto &data : rcFile.data) {
+        data.internStrings(stringPool);
+        data.buildIndexes();
     }
     spdlog::trace("{} ms for parsing {}", static_cast<int>(time.elapsed()), context.fileName());
     rcFile.isValid = true;
@@ -10,34 +10,79 @@
 
 #include "rcfile.h"
 
+#include <QSet>
+
 namespace RcCore {
 
+// Moves the items of a list into another one, skipping the ids already there
+template <typename T>
+class ListMerger
+{
+public:
+    explicit ListMerger(QList<T> &list)
+        : m_list(list)
+    {
+        m_ids.reserve(list.size());
+        for (const auto &item : std::as_const(list))
+            m_ids.insert(item.id);
+    }
+
+    void merge(QList<T> &&items)
+    {
+        m_list.reserve(m_list.size() + items.size());
+        for (auto &item : items) {
+            if (m_ids.contains(item.id))
+                continue;
+            m_ids.insert(item.id);
+            m_list.append(std::move(item));
+        }
+    }
+
+private:
+    QList<T> &m_list;
+    QSet<QString> m_ids;
+};
+
 void RcFile::mergeLanguages(const QStringList &languages, const QString &newLanguage)
 {
     if (languages.isEmpty() || (languages.count() == 1 && languages.first() == newLanguage))
         return;
 
-    Data newData = data.value(newLanguage, {});
+    // The data is taken out of the hash, so the lists are moved and not copied
+    Data newData = data.take(newLanguage);
     newData.language = newLanguage;
     newData.fileName = fileName;
 
-    for (const auto &d : std::as_const(data)) {
-        if (!languages.contains(d.language))
+    ListMerger acceleratorTables(newData.acceleratorTables);
+    ListMerger assets(newData.assets);
+    ListMerger dialogDataList(newData.dialogDataList);
+    ListMerger dialogs(newData.dialogs);
+    ListMerger icons(newData.icons);
+    ListMerger menus(newData.menus);
+    ListMerger toolBars(newData.toolBars);
+    ListMerger ribbons(newData.ribbons);
+
+    for (const auto &language : languages) {
+        if (language == newLanguage || !data.contains(language))
             continue;
-        newData.acceleratorTables.append(d.acceleratorTables);
-        newData.assets.append(d.assets);
-        newData.dialogDataList.append(d.dialogDataList);
-        newData.dialogs.append(d.dialogs);
-        newData.icons.append(d.icons);
-        newData.menus.append(d.menus);
-        newData.strings.insert(d.strings);
-        newData.toolBars.append(d.toolBars);
-        newData.ribbons.append(d.ribbons);
+        Data d = data.take(language);
+        acceleratorTables.merge(std::move(d.acceleratorTables));
+        assets.merge(std::move(d.assets));
+        dialogDataList.merge(std::move(d.dialogDataList));
+        dialogs.merge(std::move(d.dialogs));
+        icons.merge(std::move(d.icons));
+        menus.merge(std::move(d.menus));
+        toolBars.merge(std::move(d.toolBars));
+        ribbons.merge(std::move(d.ribbons));
+        newData.strings.reserve(newData.strings.size() + d.strings.size());
+        for (auto it = d.strings.begin(); it != d.strings.end(); ++it) {
+            if (!newData.strings.contains(it.key()))
+                newData.strings.insert(it.key(), std::move(it.value()));
+        }
     }
 
-    for (const auto &lang : languages)
-        data.remove(lang);
-    data[newLanguage] = newData;
+    newData.buildIndexes();
+    data.insert(newLanguage, std::move(newData));
 }
 
 } // namespace RcCore
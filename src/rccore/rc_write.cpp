@@ -8,79 +8,234 @@
   Contact KDAB at <info@kdab.com> for commercial licensing options.
 */
 
+#include "rc_cache_p.h"
 #include "rcfile.h"
+#include "utils/imagecache.h"
 #include "utils/log.h"
-#include "utils/qtuiwriter.h"
+#include "utils/taskscheduler.h"
 
+#include <QDataStream>
 #include <QDir>
 #include <QFileInfo>
 #include <QHash>
 #include <QIODevice>
 #include <QImage>
+#include <QSaveFile>
 #include <QSet>
 #include <QXmlStreamWriter>
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <optional>
+#include <vector>
 
 namespace RcCore {
 
 //=============================================================================
 // Asset writing
 //=============================================================================
-static QImage convertBmpImage(const Asset &asset, Asset::TransparentColors colors)
+// Makes the pixels of the key colors transparent, a row at a time. The loop has no branch, so the compiler can
+// vectorize it: each pixel is compared with all the keys (the unused ones are copies of the first key).
+static void makeTransparent(QImage &image, const std::array<QRgb, 3> &keys)
 {
-    QImage image(asset.originalFileName);
+    const auto width = image.width();
+    for (int y = 0; y < image.height(); ++y) {
+        auto *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const QRgb pixel = line[x];
+            const bool isKey = (pixel == keys[0]) | (pixel == keys[1]) | (pixel == keys[2]);
+            line[x] = isKey ? 0 : pixel;
+        }
+    }
+}
 
-    QSet<QRgb> transparentColors;
+static QImage convertBmpImage(const QString &fileName, Asset::TransparentColors colors)
+{
+    // The strip may already be decoded for the asset views
+    QImage image = Utils::ImageCache::instance()->image(fileName);
+
+    std::vector<QRgb> transparentColors;
     if (image.format() != QImage::Format_ARGB32) {
         if (colors & Asset::Gray)
-            transparentColors.insert(qRgb(192, 192, 192));
+            transparentColors.push_back(qRgb(192, 192, 192));
         if (colors & Asset::Magenta)
-            transparentColors.insert(qRgb(255, 0, 255));
+            transparentColors.push_back(qRgb(255, 0, 255));
         if (colors & Asset::BottomLeftPixel)
-            transparentColors.insert(image.pixel(0, image.height() - 1));
+            transparentColors.push_back(image.pixel(0, image.height() - 1));
     }
 
     image = image.convertToFormat(QImage::Format_ARGB32);
-    if (!transparentColors.isEmpty()) {
-        for (int x = 0; x < image.width(); ++x) {
-            for (int y = 0; y < image.height(); ++y) {
-                if (transparentColors.contains(image.pixel(x, y)))
-                    image.setPixel(x, y, qRgba(0, 0, 0, 0));
-            }
-        }
+    if (!transparentColors.empty()) {
+        std::array<QRgb, 3> keys;
+        keys.fill(transparentColors.front());
+        std::ranges::copy(transparentColors, keys.begin());
+        makeTransparent(image, keys);
     }
     return image;
 }
 
+//=============================================================================
+// Asset manifest
+//=============================================================================
+// Each output directory has a manifest of the images written there, with what they were converted from. An image
+// is only written again if its source or the conversion have changed since.
+static constexpr quint32 ManifestMagic = 0x4b524341; // KRCA
+static constexpr quint32 ManifestVersion = 1;
+static constexpr char ManifestFileName[] = ".knut_assets";
+
+struct ManifestEntry
+{
+    QRect iconRect;
+    int colors = 0;
+    CacheDependency source;
+};
+
+// The key is the file name of the image written
+using Manifest = QHash<QString, ManifestEntry>;
+
+static QDataStream &operator<<(QDataStream &stream, const ManifestEntry &entry)
+{
+    return stream << entry.iconRect << entry.colors << entry.source;
+}
+
+static QDataStream &operator>>(QDataStream &stream, ManifestEntry &entry)
+{
+    return stream >> entry.iconRect >> entry.colors >> entry.source;
+}
+
+static Manifest loadManifest(const QString &dir)
+{
+    QFile file(dir + '/' + ManifestFileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    Manifest manifest;
+    stream >> magic >> version;
+    if (magic != ManifestMagic || version != ManifestVersion)
+        return {};
+    stream >> manifest;
+    if (stream.status() != QDataStream::Ok)
+        return {};
+    return manifest;
+}
+
+static void saveManifest(const QString &dir, const Manifest &manifest)
+{
+    QSaveFile file(dir + '/' + ManifestFileName);
+    if (file.open(QIODevice::WriteOnly)) {
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << ManifestMagic << ManifestVersion << manifest;
+        if (stream.status() == QDataStream::Ok && file.commit())
+            return;
+    }
+    spdlog::warn("RcCore::writeAssetsToImage - can't write the manifest in {}", dir);
+}
+
+static bool isUpToDate(const Manifest &manifest, const Asset &asset, Asset::TransparentColors colors)
+{
+    auto it = manifest.constFind(asset.fileName);
+    if (it == manifest.cend() || !QFileInfo::exists(asset.fileName))
+        return false;
+    return it->iconRect == asset.iconRect && it->colors == static_cast<int>(colors)
+        && it->source.fileName == asset.originalFileName && isUpToDate(it->source);
+}
+
 /**
  * @brief Write new images for assets
  * Used if there's a BMP->PNG conversion, or toolbar splitting (default).
+ * The images are converted and written on a thread pool, the function returns once all of them are written.
+ * Images whose source and conversion didn't change since they were written are skipped, see the asset manifest.
  * @param assets list of assets
  * @param colors list of transparent colors for the conversion
+ * @return the errors, one for each asset that couldn't be written
  */
-void writeAssetsToImage(const QList<Asset> &assets, Asset::TransparentColors colors)
+QStringList writeAssetsToImage(const QList<Asset> &assets, Asset::TransparentColors colors)
 {
-    QHash<QString, QImage> cache;
-    for (const auto &asset : assets) {
-        if (!asset.exist)
-            continue;
+    // The manifests of the output directories, loaded on first use
+    QHash<QString, Manifest> manifests;
+    auto manifest = [&manifests](const Asset &asset) -> Manifest & {
+        const auto dir = QFileInfo(asset.fileName).absolutePath();
+        auto it = manifests.find(dir);
+        if (it == manifests.end())
+            it = manifests.insert(dir, loadManifest(dir));
+        return *it;
+    };
 
-        if (asset.isSame())
+    // Each source image is converted only once, a toolbar strip is shared by all the icons split from it
+    QStringList sources;
+    QHash<QString, int> sourceIndexes;
+    std::vector<int> assetSources(assets.size(), -1);
+    for (int i = 0; i < assets.size(); ++i) {
+        const auto &asset = assets.at(i);
+        if (!asset.exist || asset.isSame())
             continue;
+        if (isUpToDate(manifest(asset), asset, colors))
+            continue;
+        auto it = sourceIndexes.find(asset.originalFileName);
+        if (it == sourceIndexes.end()) {
+            it = sourceIndexes.insert(asset.originalFileName, static_cast<int>(sources.size()));
+            sources.push_back(asset.originalFileName);
+        }
+        assetSources[i] = it.value();
+    }
 
-        // Write BMP -> PNG conversion
-        if (asset.iconRect.isNull()) {
-            convertBmpImage(asset, colors).save(asset.fileName);
+    Utils::TaskGroup tasks;
+    std::vector<QImage> images(sources.size());
+    for (int i = 0; i < sources.size(); ++i) {
+        tasks.start([&, i]() {
+            images[i] = convertBmpImage(sources.at(i), colors);
+        });
+    }
+    tasks.wait();
 
-            // Write BMP -> PNG for split toolbars
-        } else {
-            QImage image = cache.value(asset.originalFileName);
+    // The converted images are only read from now on, PNG encoding is the expensive part
+    std::vector<QString> errors(assets.size());
+    for (int i = 0; i < assets.size(); ++i) {
+        if (assetSources[i] == -1)
+            continue;
+        tasks.start([&, i]() {
+            const auto &asset = assets.at(i);
+            const auto &image = images[assetSources[i]];
             if (image.isNull()) {
-                image = convertBmpImage(asset, colors);
-                cache[asset.originalFileName] = image;
+                errors[i] = QString("Can't read %1").arg(asset.originalFileName);
+                return;
             }
-            image.copy(asset.iconRect).save(asset.fileName);
+            // Write BMP -> PNG conversion, or BMP -> PNG for split toolbars
+            const QImage result = asset.iconRect.isNull() ? image : image.copy(asset.iconRect);
+            if (!result.save(asset.fileName))
+                errors[i] = QString("Can't write %1").arg(asset.fileName);
+        });
+    }
+    tasks.wait();
+
+    // The sources are hashed once, even if they are used by several images
+    std::vector<std::optional<CacheDependency>> sourceDependencies(sources.size());
+    QSet<QString> changedDirs;
+    QStringList result;
+    for (int i = 0; i < assets.size(); ++i) {
+        if (assetSources[i] == -1)
+            continue;
+        const auto &asset = assets.at(i);
+        if (!errors[i].isEmpty()) {
+            manifest(asset).remove(asset.fileName);
+            changedDirs.insert(QFileInfo(asset.fileName).absolutePath());
+            result.push_back(std::move(errors[i]));
+            continue;
         }
+        auto &dependency = sourceDependencies[assetSources[i]];
+        if (!dependency)
+            dependency = createDependency(asset.originalFileName, true);
+        manifest(asset)[asset.fileName] = {asset.iconRect, static_cast<int>(colors), *dependency};
+        changedDirs.insert(QFileInfo(asset.fileName).absolutePath());
     }
+    for (const auto &dir : std::as_const(changedDirs))
+        saveManifest(dir, manifests.value(dir));
+    return result;
 }
 
 /**
@@ -121,33 +276,254 @@ void writeAssetsToQrc(const QList<Asset> &assets, QIODevice *device, const QStri
 //=============================================================================
 // Dialog writing
 //=============================================================================
-static void writeWidget(Utils::QtUiWriter &writer, const Widget &widget, pugi::xml_node parent = {})
+// Writes a Qt Designer ui file as it goes, without building a DOM first. The output is the same as the one of
+// Utils::QtUiWriter, text is written as UTF-8.
+class UiStreamWriter
 {
-    auto widgetNode = writer.addWidget(widget.className, widget.id, parent);
+public:
+    explicit UiStreamWriter(QIODevice *device)
+        : m_device(device)
+    {
+    }
+
+    void writeDialog(const Widget &widget)
+    {
+        m_buffer.append("<?xml version=\"1.0\"?>\n");
+        startElement("ui", {{"version", "4.0"}});
+        textElement("class", widget.id);
+        writeWidget(widget);
+        emptyElement("resources");
+        emptyElement("connections");
+        endElement("ui");
+        flush();
+    }
+
+private:
+    struct Attribute
+    {
+        const char *name;
+        QString value;
+    };
+    using Attributes = std::initializer_list<Attribute>;
 
-    writer.addWidgetProperty(widgetNode, "mfc_id", widget.id, {{"notr", "true"}});
-    writer.addWidgetProperty(widgetNode, "geometry", widget.geometry);
+    void writeWidget(const Widget &widget)
+    {
+        startElement("widget", {{"class", widget.className}, {"name", widget.id}});
 
-    for (const auto &property : widget.properties.asKeyValueRange()) {
-        const auto &propertyName = property.first;
-        if (propertyName == "text")
-            writer.addWidgetProperty(widgetNode, property.first, property.second, {{"comment", widget.id}});
-        else
-            writer.addWidgetProperty(widgetNode, property.first, property.second);
+        // Special case of QMainWindow, the children are in an intermediary <widget> tag, before the properties
+        const bool isMainWindow = widget.className == "QMainWindow";
+        if (isMainWindow) {
+            const Attributes centralWidget = {{"class", "QWidget"}, {"name", "centralwidget"}};
+            if (widget.children.isEmpty()) {
+                emptyElement("widget", centralWidget);
+            } else {
+                startElement("widget", centralWidget);
+                for (const auto &child : widget.children)
+                    writeWidget(child);
+                endElement("widget");
+            }
+        }
+
+        writeProperty("mfc_id", widget.id, {{"notr", "true"}});
+        writeProperty("geometry", widget.geometry);
+        for (const auto &property : widget.properties.asKeyValueRange()) {
+            if (property.first == "text")
+                writeProperty(property.first, property.second, {{"comment", widget.id}});
+            else
+                writeProperty(property.first, property.second);
+        }
+
+        if (!isMainWindow) {
+            for (const auto &child : widget.children)
+                writeWidget(child);
+        }
+        endElement("widget");
+
+        if (m_buffer.size() > FlushSize)
+            flush();
     }
 
-    for (const auto &child : widget.children)
-        writeWidget(writer, child, widgetNode);
-}
+    void writeProperty(const QString &name, const QVariant &value, Attributes attributes = {})
+    {
+        const auto type = static_cast<QMetaType::Type>(value.typeId());
+        // Special case for stringlist
+        if (type == QMetaType::QStringList) {
+            const auto values = value.toStringList();
+            for (const auto &text : values) {
+                startElement("item");
+                startElement("property", {{"name", name}});
+                textElement("string", text);
+                endElement("property");
+                endElement("item");
+            }
+            return;
+        }
+
+        switch (type) {
+        case QMetaType::QRect: {
+            const auto rect = value.toRect();
+            startElement("property", {{"name", name}});
+            startElement("rect", attributes);
+            textElement("x", QString::number(rect.x()));
+            textElement("y", QString::number(rect.y()));
+            textElement("width", QString::number(rect.width()));
+            textElement("height", QString::number(rect.height()));
+            endElement("rect");
+            endElement("property");
+            break;
+        }
+        case QMetaType::Bool:
+            startElement("property", {{"name", name}});
+            textElement("bool", value.toBool() ? "true" : "false", attributes);
+            endElement("property");
+            break;
+        case QMetaType::Int:
+            startElement("property", {{"name", name}});
+            textElement("number", QString::number(value.toInt()), attributes);
+            endElement("property");
+            break;
+        case QMetaType::QString: {
+            const auto text = value.toString();
+            const char *tag = "string";
+            // Good enough for now, may need update for corner cases
+            if (name == "alignment")
+                tag = "set";
+            else if (text.contains("::") && !text.contains(' '))
+                tag = "enum";
+            startElement("property", {{"name", name}});
+            textElement(tag, text, attributes);
+            endElement("property");
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void startElement(const char *name, Attributes attributes = {})
+    {
+        openTag(name, attributes);
+        m_buffer.append(">\n");
+        ++m_depth;
+    }
+
+    void endElement(const char *name)
+    {
+        --m_depth;
+        indent();
+        m_buffer.append("</").append(name).append(">\n");
+    }
+
+    void emptyElement(const char *name, Attributes attributes = {})
+    {
+        openTag(name, attributes);
+        m_buffer.append(" />\n");
+    }
+
+    void textElement(const char *name, const QString &text, Attributes attributes = {})
+    {
+        openTag(name, attributes);
+        m_buffer.append('>');
+        appendEscaped(text, false);
+        m_buffer.append("</").append(name).append(">\n");
+    }
+
+    void openTag(const char *name, Attributes attributes)
+    {
+        indent();
+        m_buffer.append('<').append(name);
+        for (const auto &attribute : attributes) {
+            m_buffer.append(' ').append(attribute.name).append("=\"");
+            appendEscaped(attribute.value, true);
+            m_buffer.append('"');
+        }
+    }
+
+    void indent() { m_buffer.append(m_depth * 4, ' '); }
+
+    // Same escaping as pugixml: control characters are written as character references, except tabs and new lines
+    // in texts
+    void appendEscaped(const QString &text, bool isAttribute)
+    {
+        const QByteArray utf8 = text.toUtf8();
+        for (const char c : utf8) {
+            const auto ch = static_cast<unsigned char>(c);
+            if (c == '&') {
+                m_buffer.append("&amp;");
+            } else if (c == '<') {
+                m_buffer.append("&lt;");
+            } else if (c == '>' && !isAttribute) {
+                m_buffer.append("&gt;");
+            } else if (c == '"' && isAttribute) {
+                m_buffer.append("&quot;");
+            } else if (ch < 32 && (isAttribute || (c != '\t' && c != '\n' && c != '\r'))) {
+                m_buffer.append("&#").append(static_cast<char>('0' + ch / 10)).append(static_cast<char>('0' + ch % 10));
+                m_buffer.append(';');
+            } else {
+                m_buffer.append(c);
+            }
+        }
+    }
+
+    void flush()
+    {
+        m_device->write(m_buffer);
+        m_buffer.clear();
+    }
+
+    static constexpr qsizetype FlushSize = 64 * 1024;
+
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    int m_depth = 0;
+};
 
 void writeDialogToUi(const Widget &widget, QIODevice *device)
 {
-    pugi::xml_document doc;
-    Utils::QtUiWriter writer(doc);
+    Q_ASSERT(device);
 
-    writeWidget(writer, widget);
+    UiStreamWriter writer(device);
+    writer.writeDialog(widget);
+}
 
-    device->write(writer.dump().toUtf8());
+/**
+ * @brief Converts all the dialogs and writes them as ui files, in parallel
+ * Each dialog is written in `outputDir/<dialog id>.ui`.
+ * @param data data of the language to convert
+ * @param outputDir directory of the ui files, created if needed
+ * @return the errors, one for each dialog that couldn't be written
+ */
+QStringList writeDialogsToUi(const Data &data, const QString &outputDir, Widget::ConversionFlags flags, double scaleX,
+                             double scaleY)
+{
+    const QDir dir(outputDir);
+    if (!dir.mkpath("."))
+        return {QString("Can't create %1").arg(outputDir)};
+
+    Utils::TaskGroup tasks;
+    std::vector<QString> errors(data.dialogs.size());
+    for (int i = 0; i < data.dialogs.size(); ++i) {
+        tasks.start([&, i]() {
+            const auto widget = convertDialog(data, data.dialogs.at(i), flags, scaleX, scaleY);
+            const auto fileName = dir.filePath(widget.id + ".ui");
+            QSaveFile file(fileName);
+            if (!file.open(QIODevice::WriteOnly)) {
+                errors[i] = QString("Can't write %1").arg(fileName);
+                return;
+            }
+            writeDialogToUi(widget, &file);
+            if (!file.commit())
+                errors[i] = QString("Can't write %1").arg(fileName);
+        });
+    }
+    tasks.wait();
+
+    QStringList result;
+    for (auto &error : errors) {
+        if (!error.isEmpty())
+            result.push_back(std::move(error));
+    }
+    return result;
 }
 
 } // namespace RcCore
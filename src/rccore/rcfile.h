@@ -36,6 +36,9 @@ struct RcFile
 
 // Parse method
 RcFile parse(const QString &fileName);
+// Same as parse, but reuses the data stored in a binary cache in cacheDir, as long as the file and all the files it
+// depends on didn't change. The cache is updated otherwise.
+RcFile parseCached(const QString &fileName, const QString &cacheDir);
 
 // Conversion methods
 QList<Asset> convertAssets(const Data &data, Asset::ConversionFlags flags = Asset::AllFlags);
@@ -46,11 +49,16 @@ Widget convertDialog(const Data &data, const Data::Dialog &dialog,
 QList<Action> convertActions(const Data &data, Asset::ConversionFlags flags = Asset::AllFlags);
 
 // Write methods
-void writeAssetsToImage(const QList<Asset> &assets, Asset::TransparentColors colors = Asset::AllColors);
+// Returns the errors, one for each asset that couldn't be written
+QStringList writeAssetsToImage(const QList<Asset> &assets, Asset::TransparentColors colors = Asset::AllColors);
 
 void writeAssetsToQrc(const QList<Asset> &assets, QIODevice *device, const QString &fileName);
 
 void writeDialogToUi(const Widget &widget, QIODevice *device);
+// Converts all the dialogs of data and writes them in outputDir, returns the errors, one for each dialog not written
+QStringList writeDialogsToUi(const Data &data, const QString &outputDir,
+                             Widget::ConversionFlags flags = Widget::UpdateGeometry, double scaleX = 1.5,
+                             double scaleY = 1.65);
 
 QString convertLanguageToCode(const QString &name);
 
@@ -12,6 +12,9 @@
 
 #include <QChar>
 #include <QString>
+#include <QStringView>
+
+#include <functional>
 
 class QIODevice;
 
@@ -23,17 +26,58 @@ public:
     explicit Stream(QIODevice *device);
     Stream(const QString &text);
 
-    bool atEnd() const;
-    int line() const;
+    bool atEnd() const { return m_pos == m_content.size(); }
+    int line() const { return m_line; }
+    qsizetype position() const { return m_pos; }
+    // Moves to position, which is on the given line
+    void seek(qsizetype position, int line)
+    {
+        m_pos = position;
+        m_line = line;
+    }
+
+    QChar next()
+    {
+        if (atEnd())
+            return {};
+        const QChar ch = m_content.at(m_pos++);
+        if (ch == '\n')
+            ++m_line;
+        return ch;
+    }
+    QChar peek() const
+    {
+        if (atEnd())
+            return {};
+        return m_content.at(m_pos);
+    }
+
+    // Reads all characters for which func returns true, and returns them as a view on the content.
+    template <typename Func>
+    QStringView readWhile(Func func)
+    {
+        const auto start = m_pos;
+        const auto size = m_content.size();
+        const QChar *data = m_content.constData();
+        while (m_pos < size && std::invoke(func, data[m_pos])) {
+            if (data[m_pos] == '\n')
+                ++m_line;
+            ++m_pos;
+        }
+        return QStringView(data + start, m_pos - start);
+    }
 
-    QChar next();
-    QChar peek() const;
+    // Returns a view on the content between position and the current position.
+    QStringView textFrom(qsizetype position) const
+    {
+        return QStringView(m_content).sliced(position, m_pos - position);
+    }
 
-    QString content() const;
+    const QString &content() const { return m_content; }
 
 private:
     QString m_content;
-    int m_pos = 0;
+    qsizetype m_pos = 0;
     int m_line = 1;
 };
 
@@ -18,16 +18,10 @@ using namespace RcCore;
 namespace RcUi {
 
 AcceleratorModel::AcceleratorModel(const Data &data, int index, QObject *parent)
-    : QAbstractTableModel(parent)
+    : LazyTableModel(parent)
     , m_accelerators(data.acceleratorTables.value(index).accelerators)
 {
-}
-
-int AcceleratorModel::rowCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return m_accelerators.size();
+    setSourceRowCount(m_accelerators.size());
 }
 
 int AcceleratorModel::columnCount(const QModelIndex &parent) const
@@ -41,7 +35,7 @@ QVariant AcceleratorModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-        const auto &accelerator = m_accelerators.at(index.row());
+        const auto &accelerator = m_accelerators.at(sourceRow(index.row()));
         switch (index.column()) {
         case ID:
             return accelerator.id;
@@ -51,19 +45,24 @@ QVariant AcceleratorModel::data(const QModelIndex &index, int role) const
     }
 
     if (role == Qt::ForegroundRole) {
-        const auto &accelerator = m_accelerators.at(index.row());
+        const auto &accelerator = m_accelerators.at(sourceRow(index.row()));
         if (accelerator.isUnknown())
             return QVariant::fromValue(QColor(Qt::red));
     }
 
     if (role == LineRole) {
-        const auto &accelerator = m_accelerators.at(index.row());
+        const auto &accelerator = m_accelerators.at(sourceRow(index.row()));
         return accelerator.line;
     }
 
     return {};
 }
 
+QString AcceleratorModel::filterKey(int sourceRow) const
+{
+    return m_accelerators.at(sourceRow).id;
+}
+
 QVariant AcceleratorModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     static QStringList headers = {tr("Id"), tr("Shortcut")};
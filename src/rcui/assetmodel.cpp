@@ -10,6 +10,7 @@
 
 #include "assetmodel.h"
 #include "rcviewer_global.h"
+#include "utils/imagecache.h"
 
 #include <QColor>
 #include <algorithm>
@@ -19,19 +20,19 @@ using namespace RcCore;
 namespace RcUi {
 
 AssetModel::AssetModel(const QList<Asset> &assets, QObject *parent)
-    : QAbstractTableModel(parent)
+    : LazyTableModel(parent)
     , m_assets(assets)
 {
     std::ranges::sort(m_assets, [](const auto &left, const auto &right) {
         return left.id < right.id;
     });
-}
+    setSourceRowCount(m_assets.size());
 
-int AssetModel::rowCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return m_assets.size();
+    // The thumbnails are decoded in the background, the views only repaint the ones they show
+    connect(Utils::ImageCache::instance(), &Utils::ImageCache::thumbnailReady, this, [this]() {
+        if (const int count = rowCount())
+            emit dataChanged(index(0, FileName), index(count - 1, FileName), {Qt::DecorationRole});
+    });
 }
 
 int AssetModel::columnCount(const QModelIndex &parent) const
@@ -45,7 +46,7 @@ QVariant AssetModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-        const auto &asset = m_assets.at(index.row());
+        const auto &asset = m_assets.at(sourceRow(index.row()));
         switch (index.column()) {
         case ID:
             return asset.id;
@@ -54,20 +55,37 @@ QVariant AssetModel::data(const QModelIndex &index, int role) const
         }
     }
 
+    if (role == Qt::DecorationRole && index.column() == FileName) {
+        const auto &asset = m_assets.at(sourceRow(index.row()));
+        if (!asset.exist)
+            return {};
+        // Icons split from a toolbar are cut from the toolbar strip, they are only written on conversion
+        const QImage thumbnail = asset.isSame()
+            ? Utils::ImageCache::instance()->thumbnail(asset.fileName, {}, ThumbnailSize)
+            : Utils::ImageCache::instance()->thumbnail(asset.originalFileName, asset.iconRect, ThumbnailSize);
+        if (!thumbnail.isNull())
+            return thumbnail;
+    }
+
     if (role == Qt::ForegroundRole) {
-        const auto &asset = m_assets.at(index.row());
+        const auto &asset = m_assets.at(sourceRow(index.row()));
         if (!asset.exist)
             return QVariant::fromValue(QColor(Qt::red));
     }
 
     if (role == LineRole) {
-        const auto &asset = m_assets.at(index.row());
+        const auto &asset = m_assets.at(sourceRow(index.row()));
         return asset.line;
     }
 
     return {};
 }
 
+QString AssetModel::filterKey(int sourceRow) const
+{
+    return m_assets.at(sourceRow).id;
+}
+
 QVariant AssetModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     static QStringList headers = {tr("Id"), tr("FileName")};
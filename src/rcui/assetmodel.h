@@ -10,13 +10,14 @@
 
 #pragma once
 
+#include "lazytablemodel.h"
 #include "rccore/data.h"
 
-#include <QAbstractTableModel>
+#include <QSize>
 
 namespace RcUi {
 
-class AssetModel : public QAbstractTableModel
+class AssetModel : public LazyTableModel
 {
     Q_OBJECT
 
@@ -29,11 +30,15 @@ public:
 public:
     explicit AssetModel(const QList<RcCore::Asset> &assets, QObject *parent = nullptr);
 
-    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+    static constexpr QSize ThumbnailSize = {16, 16};
+
+protected:
+    QString filterKey(int sourceRow) const override;
+
 private:
     QList<RcCore::Asset> m_assets;
 };
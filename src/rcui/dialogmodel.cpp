@@ -18,16 +18,10 @@ using namespace RcCore;
 namespace RcUi {
 
 DialogModel::DialogModel(const Data &data, int index, QObject *parent)
-    : QAbstractTableModel(parent)
+    : LazyTableModel(parent)
     , m_controls(data.dialogs.value(index).controls)
 {
-}
-
-int DialogModel::rowCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return m_controls.size();
+    setSourceRowCount(m_controls.size());
 }
 
 int DialogModel::columnCount(const QModelIndex &parent) const
@@ -41,7 +35,7 @@ QVariant DialogModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-        const auto &control = m_controls.at(index.row());
+        const auto &control = m_controls.at(sourceRow(index.row()));
         switch (index.column()) {
         case Type:
             return control.type;
@@ -63,19 +57,24 @@ QVariant DialogModel::data(const QModelIndex &index, int role) const
     }
 
     if (role == Qt::ForegroundRole) {
-        const auto &control = m_controls.at(index.row());
+        const auto &control = m_controls.at(sourceRow(index.row()));
         if (control.id.isEmpty())
             return QVariant::fromValue(QColor(Qt::red));
     }
 
     if (role == LineRole) {
-        const auto &control = m_controls.at(index.row());
+        const auto &control = m_controls.at(sourceRow(index.row()));
         return control.line;
     }
 
     return {};
 }
 
+QString DialogModel::filterKey(int sourceRow) const
+{
+    return m_controls.at(sourceRow).id;
+}
+
 QVariant DialogModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     static QStringList headers = {tr("Type"), tr("Id"), tr("Geometry"), tr("Text"), tr("Class Name"), tr("Styles")};
@@ -10,13 +10,13 @@
 
 #pragma once
 
+#include "lazytablemodel.h"
 #include "rccore/data.h"
 
-#include <QAbstractTableModel>
 
 namespace RcUi {
 
-class DialogModel : public QAbstractTableModel
+class DialogModel : public LazyTableModel
 {
     Q_OBJECT
 
@@ -33,11 +33,13 @@ public:
 public:
     explicit DialogModel(const RcCore::Data &data, int index, QObject *parent = nullptr);
 
-    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+protected:
+    QString filterKey(int sourceRow) const override;
+
 private:
     const QList<RcCore::Data::Control> m_controls;
 };
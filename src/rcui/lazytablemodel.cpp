@@ -0,0 +1,85 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lazytablemodel.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace RcUi {
+
+int LazyTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return m_fetchedCount;
+}
+
+bool LazyTableModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return false;
+    return m_fetchedCount < m_rows.size();
+}
+
+void LazyTableModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        return;
+    const int count = std::min(FetchSize, static_cast<int>(m_rows.size()) - m_fetchedCount);
+    if (count <= 0)
+        return;
+    beginInsertRows({}, m_fetchedCount, m_fetchedCount + count - 1);
+    m_fetchedCount += count;
+    endInsertRows();
+}
+
+void LazyTableModel::setFilterText(const QString &text)
+{
+    if (text == m_filterText)
+        return;
+
+    beginResetModel();
+    // When the filter is only extended, only the rows matching the previous one can match the new one
+    const bool narrow = !m_filterText.isEmpty() && text.contains(m_filterText);
+    m_filterText = text;
+    if (text.isEmpty()) {
+        m_rows.resize(m_sourceRowCount);
+        std::iota(m_rows.begin(), m_rows.end(), 0);
+    } else {
+        QList<int> candidates;
+        if (narrow) {
+            candidates = std::move(m_rows);
+        } else {
+            candidates.resize(m_sourceRowCount);
+            std::iota(candidates.begin(), candidates.end(), 0);
+        }
+        m_rows.clear();
+        for (const int row : std::as_const(candidates)) {
+            if (filterKey(row).contains(text))
+                m_rows.push_back(row);
+        }
+    }
+    m_fetchedCount = std::min(FetchSize, static_cast<int>(m_rows.size()));
+    endResetModel();
+}
+
+void LazyTableModel::setSourceRowCount(int count)
+{
+    beginResetModel();
+    m_sourceRowCount = count;
+    m_filterText.clear();
+    m_rows.resize(count);
+    std::iota(m_rows.begin(), m_rows.end(), 0);
+    m_fetchedCount = std::min(FetchSize, count);
+    endResetModel();
+}
+
+} // namespace RcUi
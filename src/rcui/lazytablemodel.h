@@ -0,0 +1,51 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QList>
+
+namespace RcUi {
+
+// Table model showing its rows by chunks, as the view needs them, for the RC files with thousands of items.
+// The filter is done in the model, on all the rows and not only the ones fetched.
+class LazyTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    using QAbstractTableModel::QAbstractTableModel;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    // Only shows the rows whose filter key contains text
+    void setFilterText(const QString &text);
+
+protected:
+    // Needs to be called by the subclasses once their rows are set
+    void setSourceRowCount(int count);
+    // Position in the subclass list of a row of the model
+    int sourceRow(int row) const { return m_rows.at(row); }
+    virtual QString filterKey(int sourceRow) const = 0;
+
+private:
+    static constexpr int FetchSize = 256;
+
+    int m_sourceRowCount = 0;
+    QString m_filterText;
+    // Source rows matching the filter, only the first m_fetchedCount are in the model
+    QList<int> m_rows;
+    int m_fetchedCount = 0;
+};
+
+} // namespace RcUi
@@ -14,6 +14,7 @@
 #include "datamodel.h"
 #include "dialogmodel.h"
 #include "includemodel.h"
+#include "lazytablemodel.h"
 #include "menumodel.h"
 #include "rccore/rcfile.h"
 #include "rcviewer_global.h"
@@ -78,8 +79,7 @@ RcFileView::RcFileView(QWidget *parent)
     });
 
     m_contentProxyModel->setRecursiveFilteringEnabled(true);
-    connect(ui->contentFilter, &QLineEdit::textChanged, m_contentProxyModel,
-            &QSortFilterProxyModel::setFilterFixedString);
+    connect(ui->contentFilter, &QLineEdit::textChanged, this, &RcFileView::filterContent);
 
     connect(ui->searchText, &QLineEdit::textChanged, this, &RcFileView::slotSearchText);
     connect(ui->searchText, &QLineEdit::returnPressed, this, &RcFileView::slotSearchNext);
@@ -195,6 +195,7 @@ void RcFileView::setData(int type, int index)
     }
 
     m_contentProxyModel->setSourceModel(m_contentModel);
+    filterContent(ui->contentFilter->text());
 
     if (m_contentModel) {
         // Need to be done after setting the model
@@ -205,6 +206,17 @@ void RcFileView::setData(int type, int index)
     }
 }
 
+void RcFileView::filterContent(const QString &text)
+{
+    // Large tables are filtered by the model itself, as it doesn't have all its rows yet
+    if (auto lazyModel = qobject_cast<LazyTableModel *>(m_contentModel)) {
+        m_contentProxyModel->setFilterFixedString({});
+        lazyModel->setFilterText(text);
+    } else {
+        m_contentProxyModel->setFilterFixedString(text);
+    }
+}
+
 void RcFileView::updateDialogProperty(int index)
 {
     const RcCore::Data::Dialog &dialog = data().dialogs.at(index);
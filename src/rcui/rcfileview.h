@@ -48,6 +48,7 @@ private:
     void changeDataItem(const QModelIndex &current);
     void changeContentItem(const QModelIndex &current);
     void setData(int type, int index);
+    void filterContent(const QString &text);
     void updateDialogProperty(int index);
     void previewData(const QModelIndex &index);
     void slotContextMenu(QTreeView *treeView, const QPoint &pos);
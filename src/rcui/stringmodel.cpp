@@ -18,19 +18,13 @@ using namespace RcCore;
 namespace RcUi {
 
 StringModel::StringModel(const Data &data, QObject *parent)
-    : QAbstractTableModel(parent)
+    : LazyTableModel(parent)
     , m_strings(data.strings.values())
 {
     std::ranges::sort(m_strings, [](const auto &left, const auto &right) {
         return left.id < right.id;
     });
-}
-
-int StringModel::rowCount(const QModelIndex &parent) const
-{
-    if (parent.isValid())
-        return 0;
-    return m_strings.size();
+    setSourceRowCount(m_strings.size());
 }
 
 int StringModel::columnCount(const QModelIndex &parent) const
@@ -44,7 +38,7 @@ QVariant StringModel::data(const QModelIndex &index, int role) const
     Q_ASSERT(checkIndex(index, CheckIndexOption::IndexIsValid));
 
     if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
-        const auto &asset = m_strings.at(index.row());
+        const auto &asset = m_strings.at(sourceRow(index.row()));
         switch (index.column()) {
         case ID:
             return asset.id;
@@ -54,13 +48,18 @@ QVariant StringModel::data(const QModelIndex &index, int role) const
     }
 
     if (role == LineRole) {
-        const auto &asset = m_strings.at(index.row());
+        const auto &asset = m_strings.at(sourceRow(index.row()));
         return asset.line;
     }
 
     return {};
 }
 
+QString StringModel::filterKey(int sourceRow) const
+{
+    return m_strings.at(sourceRow).id;
+}
+
 QVariant StringModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     static QStringList headers = {tr("Id"), tr("Text")};
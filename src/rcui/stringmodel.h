@@ -10,14 +10,14 @@
 
 #pragma once
 
+#include "lazytablemodel.h"
 #include "rccore/data.h"
 
-#include <QAbstractTableModel>
 #include <QList>
 
 namespace RcUi {
 
-class StringModel : public QAbstractTableModel
+class StringModel : public LazyTableModel
 {
     Q_OBJECT
 
@@ -30,11 +30,13 @@ public:
 public:
     explicit StringModel(const RcCore::Data &data, QObject *parent = nullptr);
 
-    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
+protected:
+    QString filterKey(int sourceRow) const override;
+
 private:
     QList<RcCore::String> m_strings;
 };
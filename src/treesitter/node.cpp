@@ -9,14 +9,32 @@
 */
 
 #include "node.h"
+#include "utf8source.h"
 #include "utils/log.h"
 
+#include <QHash>
+#include <algorithm>
+#include <functional>
 #include <kdalgorithms.h>
+#include <mutex>
+#include <unordered_map>
 
 namespace treesitter {
 
-Node::Node(const TSNode &node)
+// Trees are parsed from UTF-16 text, unless a UTF-8 source is given
+static uint32_t toPosition(const Utf8Source *utf8Source, uint32_t byte)
+{
+    return utf8Source ? utf8Source->toPosition(byte) : byte / sizeof(QChar);
+}
+
+static uint32_t toByte(const Utf8Source *utf8Source, uint32_t position)
+{
+    return utf8Source ? utf8Source->toByte(position) : position * sizeof(QChar);
+}
+
+Node::Node(const TSNode &node, const Utf8Source *utf8Source)
     : m_node(node)
+    , m_utf8Source(utf8Source)
 {
 }
 
@@ -30,6 +48,16 @@ QString Node::type() const
     return QString(rawType());
 }
 
+TSSymbol Node::symbol() const
+{
+    return ts_node_symbol(m_node);
+}
+
+const TSLanguage *Node::language() const
+{
+    return ts_tree_language(m_node.tree);
+}
+
 uint32_t Node::namedChildCount() const
 {
     return ts_node_named_child_count(m_node);
@@ -37,7 +65,7 @@ uint32_t Node::namedChildCount() const
 
 Node Node::namedChild(uint32_t index) const
 {
-    return Node(ts_node_named_child(m_node, index));
+    return Node(ts_node_named_child(m_node, index), m_utf8Source);
 }
 
 QString Node::fieldNameForChild(const Node &child) const
@@ -87,23 +115,21 @@ QString Node::fieldNameForChild(const Node &child) const
     QString result;
     bool found = false;
 
-    TSTreeCursor cursor = ts_tree_cursor_new(m_node);
+    TreeCursor cursor(*this);
 
-    if (ts_tree_cursor_goto_first_child(&cursor)) {
+    if (cursor.gotoFirstChild()) {
         do {
-            if (Node(ts_tree_cursor_current_node(&cursor)) == child) {
+            if (cursor.currentNode() == child) {
                 found = true;
 
-                if (const auto *name = ts_tree_cursor_current_field_name(&cursor)) {
+                if (const auto *name = cursor.currentFieldName()) {
                     result = name;
                 }
                 break;
             }
-        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+        } while (cursor.gotoNextSibling());
     }
 
-    ts_tree_cursor_delete(&cursor);
-
     if (!found) {
         spdlog::warn("Node::fieldNameForChild - given node is not a child!");
     }
@@ -123,7 +149,7 @@ QList<Node> Node::children() const
     result.reserve(count);
 
     for (uint32_t i = 0; i < count; i++) {
-        result.emplace_back(Node(ts_node_child(m_node, i)));
+        result.emplace_back(Node(ts_node_child(m_node, i), m_utf8Source));
     }
 
     return result;
@@ -136,20 +162,35 @@ QList<Node> Node::namedChildren() const
     result.reserve(count);
 
     for (uint32_t i = 0; i < count; i++) {
-        result.emplace_back(Node(ts_node_named_child(m_node, i)));
+        result.emplace_back(Node(ts_node_named_child(m_node, i), m_utf8Source));
     }
 
     return result;
 }
 
+NodeChildren Node::childRange() const
+{
+    return NodeChildren(*this, false);
+}
+
+NodeChildren Node::namedChildRange() const
+{
+    return NodeChildren(*this, true);
+}
+
+Node Node::firstChildForPosition(uint32_t position) const
+{
+    return Node(ts_node_first_child_for_byte(m_node, toByte(m_utf8Source, position)), m_utf8Source);
+}
+
 uint32_t Node::startPosition() const
 {
-    return ts_node_start_byte(m_node) / sizeof(QChar);
+    return toPosition(m_utf8Source, ts_node_start_byte(m_node));
 }
 
 uint32_t Node::endPosition() const
 {
-    return ts_node_end_byte(m_node) / sizeof(QChar);
+    return toPosition(m_utf8Source, ts_node_end_byte(m_node));
 }
 
 Point Node::startPoint() const
@@ -195,42 +236,66 @@ QString Node::textIn(const QString &source) const
     return source.sliced(start, end - start);
 }
 
+QStringView Node::textViewIn(QStringView source) const
+{
+    const auto start = this->startPosition();
+    const auto end = this->endPosition();
+
+    return source.sliced(start, end - start);
+}
+
 QString Node::textExcept(const QString &source, const QList<QString> &nodeTypes) const
 {
-    auto text = textIn(source);
+    return textExcept(source, NodeTypes(language(), nodeTypes));
+}
 
+QString Node::textExcept(const QString &source, const NodeTypes &nodeTypes) const
+{
     auto children = allChildrenOfType(nodeTypes);
-    // make sure to sort the children back-to-front, so that removing them in order
-    // doesn't mess up the ranges of the remaining children.
+    if (children.isEmpty())
+        return textIn(source);
+
     kdalgorithms::sort(children, [](const auto &left, const auto &right) {
-        return left.startPosition() > right.startPosition();
+        return left.startPosition() < right.startPosition();
     });
 
+    // Only copy the parts of the text between the excluded children
+    QString text;
+    text.reserve(endPosition() - startPosition());
+    auto position = startPosition();
     for (const auto &child : std::as_const(children)) {
-        const auto start = child.startPosition();
-        const auto end = child.endPosition();
-        text.remove(start - this->startPosition(), end - start);
+        text.append(QStringView(source).sliced(position, child.startPosition() - position));
+        position = child.endPosition();
     }
+    text.append(QStringView(source).sliced(position, endPosition() - position));
 
     return text;
 }
 
-QList<Node> Node::allChildrenOfType(const QList<QString> &nodeTypes) const
+QList<Node> Node::allChildrenOfType(const NodeTypes &nodeTypes) const
 {
     auto result = QList<Node>();
 
-    const auto allChildren = children();
-    for (const auto &child : allChildren) {
-        // break the recursion at the first node that is of the given type
+    TreeCursor cursor(*this);
+    if (!cursor.gotoFirstChild())
+        return result;
+
+    while (true) {
+        // Don't go down at the first node that is of the given type
         // That way we don't get overlapping child nodes.
-        if (kdalgorithms::contains(nodeTypes, child.type())) {
+        const auto child = cursor.currentNode();
+        if (nodeTypes.contains(child)) {
             result.push_back(child);
-        } else {
-            result.append(child.allChildrenOfType(nodeTypes));
+        } else if (cursor.gotoFirstChild()) {
+            continue;
         }
-    }
 
-    return result;
+        while (!cursor.gotoNextSibling()) {
+            // Back to this node, everything has been visited
+            if (!cursor.gotoParent() || cursor.currentNode() == *this)
+                return result;
+        }
+    }
 }
 
 bool Node::operator==(const Node &other) const
@@ -238,14 +303,185 @@ bool Node::operator==(const Node &other) const
     return ts_node_eq(m_node, other.m_node);
 }
 
+bool Node::operator<(const Node &other) const
+{
+    const auto start = ts_node_start_byte(m_node);
+    const auto otherStart = ts_node_start_byte(other.m_node);
+    if (start != otherStart)
+        return start < otherStart;
+    const auto end = ts_node_end_byte(m_node);
+    const auto otherEnd = ts_node_end_byte(other.m_node);
+    if (end != otherEnd)
+        return end > otherEnd;
+    // Pointers of different trees can only be ordered with std::less
+    if (m_node.tree != other.m_node.tree)
+        return std::less<const TSTree *> {}(m_node.tree, other.m_node.tree);
+    return std::less<const void *> {}(m_node.id, other.m_node.id);
+}
+
 Node Node::descendantForRange(uint32_t left, uint32_t right) const
 {
-    return Node(ts_node_descendant_for_byte_range(m_node, left * sizeof(QChar), right * sizeof(QChar)));
+    return Node(ts_node_descendant_for_byte_range(m_node, toByte(m_utf8Source, left), toByte(m_utf8Source, right)),
+                m_utf8Source);
 }
 
 Node Node::parent() const
 {
-    return Node(ts_node_parent(m_node));
+    return Node(ts_node_parent(m_node), m_utf8Source);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// NodeTypes
+///////////////////////////////////////////////////////////////////////////////
+NodeTypes::NodeTypes(const TSLanguage *language, const QList<QString> &types)
+{
+    for (const auto &type : types) {
+        const auto &symbols = symbolsForName(language, type);
+        m_symbols.insert(m_symbols.end(), symbols.begin(), symbols.end());
+    }
+    std::ranges::sort(m_symbols);
+}
+
+bool NodeTypes::contains(TSSymbol symbol) const
+{
+    return std::ranges::binary_search(m_symbols, symbol);
+}
+
+const std::vector<TSSymbol> &NodeTypes::symbolsForName(const TSLanguage *language, const QString &name)
+{
+    using SymbolTable = QHash<QString, std::vector<TSSymbol>>;
+    static std::mutex mutex;
+    static std::unordered_map<const TSLanguage *, SymbolTable> tables;
+    static const std::vector<TSSymbol> noSymbols;
+
+    // Only a handful of languages, the tables are never removed so the references returned stay valid
+    std::lock_guard lock(mutex);
+    auto [it, inserted] = tables.try_emplace(language);
+    auto &table = it->second;
+    if (inserted) {
+        // The symbol count includes the aliases, which are the symbols of the aliased nodes
+        const auto count = ts_language_symbol_count(language);
+        for (uint32_t symbol = 0; symbol < count; ++symbol) {
+            const auto tsSymbol = static_cast<TSSymbol>(symbol);
+            table[QString(ts_language_symbol_name(language, tsSymbol))].push_back(tsSymbol);
+        }
+        // Error nodes use a builtin symbol, outside of the language symbols
+        table[QStringLiteral("ERROR")].push_back(static_cast<TSSymbol>(-1));
+    }
+    const auto symbols = table.constFind(name);
+    return symbols != table.cend() ? *symbols : noSymbols;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TreeCursor
+///////////////////////////////////////////////////////////////////////////////
+TreeCursor::TreeCursor(const Node &node)
+    : m_cursor(ts_tree_cursor_new(node.m_node))
+    , m_utf8Source(node.m_utf8Source)
+{
+}
+
+TreeCursor::TreeCursor(const TreeCursor &other)
+    : m_cursor(ts_tree_cursor_copy(&other.m_cursor))
+    , m_utf8Source(other.m_utf8Source)
+{
+}
+
+TreeCursor::TreeCursor(TreeCursor &&other) noexcept
+    : m_cursor(other.m_cursor)
+    , m_utf8Source(other.m_utf8Source)
+{
+    // An empty cursor owns nothing, and can be deleted
+    other.m_cursor = TSTreeCursor {};
+}
+
+TreeCursor &TreeCursor::operator=(const TreeCursor &other)
+{
+    TreeCursor copy(other);
+    swap(copy);
+    return *this;
+}
+
+TreeCursor &TreeCursor::operator=(TreeCursor &&other) noexcept
+{
+    swap(other);
+    return *this;
+}
+
+TreeCursor::~TreeCursor()
+{
+    ts_tree_cursor_delete(&m_cursor);
+}
+
+void TreeCursor::swap(TreeCursor &other) noexcept
+{
+    std::swap(m_cursor, other.m_cursor);
+    std::swap(m_utf8Source, other.m_utf8Source);
+}
+
+void TreeCursor::reset(const Node &node)
+{
+    ts_tree_cursor_reset(&m_cursor, node.m_node);
+    m_utf8Source = node.m_utf8Source;
+}
+
+Node TreeCursor::currentNode() const
+{
+    return Node(ts_tree_cursor_current_node(&m_cursor), m_utf8Source);
+}
+
+const char *TreeCursor::currentFieldName() const
+{
+    return ts_tree_cursor_current_field_name(&m_cursor);
+}
+
+bool TreeCursor::gotoFirstChild()
+{
+    return ts_tree_cursor_goto_first_child(&m_cursor);
+}
+
+bool TreeCursor::gotoNextSibling()
+{
+    return ts_tree_cursor_goto_next_sibling(&m_cursor);
+}
+
+bool TreeCursor::gotoParent()
+{
+    return ts_tree_cursor_goto_parent(&m_cursor);
+}
+
+bool TreeCursor::gotoFirstChildForPosition(uint32_t position)
+{
+    return ts_tree_cursor_goto_first_child_for_byte(&m_cursor, toByte(m_utf8Source, position)) != -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// NodeChildren
+///////////////////////////////////////////////////////////////////////////////
+NodeChildren::Iterator::Iterator(const Node &parent, bool namedOnly)
+    : m_cursor(parent)
+    , m_current(parent)
+    , m_namedOnly(namedOnly)
+    , m_atEnd(!m_cursor.gotoFirstChild())
+{
+    skipUnnamed();
+}
+
+NodeChildren::Iterator &NodeChildren::Iterator::operator++()
+{
+    m_atEnd = !m_cursor.gotoNextSibling();
+    skipUnnamed();
+    return *this;
+}
+
+void NodeChildren::Iterator::skipUnnamed()
+{
+    while (!m_atEnd) {
+        m_current = m_cursor.currentNode();
+        if (!m_namedOnly || m_current.isNamed())
+            return;
+        m_atEnd = !m_cursor.gotoNextSibling();
+    }
 }
 
 }
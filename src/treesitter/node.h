@@ -12,13 +12,21 @@
 
 #include <tree_sitter/api.h>
 
+#include <QHashFunctions>
 #include <QString>
+#include <QStringView>
 #include <QVector>
+#include <iterator>
+#include <vector>
 
 namespace treesitter {
 
 using Point = TSPoint;
 
+class NodeChildren;
+class NodeTypes;
+class Utf8Source;
+
 class Node
 {
 public:
@@ -30,6 +38,9 @@ public:
 
     QString type() const;
     const char *rawType() const;
+    // Type of the node as a symbol of its language: compare it with NodeTypes instead of comparing type() strings
+    TSSymbol symbol() const;
+    const TSLanguage *language() const;
 
     uint32_t namedChildCount() const;
     Node namedChild(uint32_t index) const;
@@ -40,6 +51,16 @@ public:
     uint32_t childCount() const;
     QVector<Node> children() const;
 
+    // Iterate over the children with a TreeCursor, without creating a list of nodes:
+    // for (const auto &child : node.childRange()) { ... }
+    NodeChildren childRange() const;
+    NodeChildren namedChildRange() const;
+
+    // Returns the first child that extends beyond the given position, or a null node if there's none.
+    // Like all positions in Node, the position is in characters, not bytes, whatever encoding the tree was parsed with.
+    // Points are not converted: their columns are in bytes of the parsed text.
+    Node firstChildForPosition(uint32_t position) const;
+
     uint32_t startPosition() const;
     uint32_t endPosition() const;
 
@@ -54,38 +75,150 @@ public:
     bool hasError() const;
 
     QString textIn(const QString &source) const;
+    // Same as textIn, but returns a view on the source instead of a copy
+    QStringView textViewIn(QStringView source) const;
     QString textExcept(const QString &source, const QVector<QString> &nodeTypes) const;
+    QString textExcept(const QString &source, const NodeTypes &nodeTypes) const;
 
     Node descendantForRange(uint32_t left, uint32_t right) const;
     Node parent() const;
 
+    // Two nodes are equal if they are the same node of the same tree
     bool operator==(const Node &other) const;
+    // Orders the nodes by their byte range: by start, then the longest first, so a node comes before its descendants.
+    // Nodes with the same range are ordered by tree and id, consistently with operator==.
+    bool operator<(const Node &other) const;
 
 private:
-    Node(const TSNode &node);
+    Node(const TSNode &node, const Utf8Source *utf8Source = nullptr);
 
-    QVector<Node> allChildrenOfType(const QVector<QString> &nodeTypes) const;
+    QVector<Node> allChildrenOfType(const NodeTypes &nodeTypes) const;
 
     // TODO: make private again
 public:
     TSNode m_node;
+    // Only set for trees parsed from UTF-8, owned by the tree
+    const Utf8Source *m_utf8Source = nullptr;
 
     friend class Tree;
+    friend class TreeCursor;
     friend class QueryCursor;
     friend class QueryMatch;
 };
 
+// Set of node types of a language, resolved once to their symbols: checking the type of a node is then an integer
+// comparison, instead of building a QString for each node.
+// A type name can have several symbols (e.g. a named node and an alias with the same name), all of them are matched.
+class NodeTypes
+{
+public:
+    NodeTypes() = default;
+    NodeTypes(const TSLanguage *language, const QVector<QString> &types);
+
+    bool contains(TSSymbol symbol) const;
+    bool contains(const Node &node) const { return contains(node.symbol()); }
+    bool isEmpty() const { return m_symbols.empty(); }
+
+    // Returns the symbols of the node type `name`, using a table of the language symbols built on the first call
+    static const std::vector<TSSymbol> &symbolsForName(const TSLanguage *language, const QString &name);
+
+private:
+    // Sorted, a handful of symbols at most
+    std::vector<TSSymbol> m_symbols;
+};
+
+// Wrapper around TSTreeCursor, to walk a tree efficiently.
+// The cursor can't go above the node it has been created with.
+class TreeCursor
+{
+public:
+    explicit TreeCursor(const Node &node);
+    TreeCursor(const TreeCursor &other);
+    TreeCursor(TreeCursor &&other) noexcept;
+
+    TreeCursor &operator=(const TreeCursor &other);
+    TreeCursor &operator=(TreeCursor &&other) noexcept;
+
+    ~TreeCursor();
+
+    void swap(TreeCursor &other) noexcept;
+
+    // Restarts the cursor at the given node
+    void reset(const Node &node);
+
+    Node currentNode() const;
+    // Returns the field name of the current node, or nullptr if it has none
+    const char *currentFieldName() const;
+
+    bool gotoFirstChild();
+    bool gotoNextSibling();
+    bool gotoParent();
+    // Moves to the first child that extends beyond the given position (in characters)
+    bool gotoFirstChildForPosition(uint32_t position);
+
+private:
+    TSTreeCursor m_cursor;
+    const Utf8Source *m_utf8Source;
+};
+
+// Range over the children of a node, see Node::childRange.
+class NodeChildren
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Node *;
+        using reference = const Node &;
+
+        const Node &operator*() const { return m_current; }
+        const Node *operator->() const { return &m_current; }
+        Iterator &operator++();
+        bool operator==(std::default_sentinel_t) const { return m_atEnd; }
+
+    private:
+        Iterator(const Node &parent, bool namedOnly);
+        // Skips unnamed nodes if needed
+        void skipUnnamed();
+
+        TreeCursor m_cursor;
+        Node m_current;
+        bool m_namedOnly;
+        bool m_atEnd;
+
+        friend class NodeChildren;
+    };
+
+    Iterator begin() const { return Iterator(m_parent, m_namedOnly); }
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    NodeChildren(const Node &parent, bool namedOnly)
+        : m_parent(parent)
+        , m_namedOnly(namedOnly)
+    {
+    }
+
+    Node m_parent;
+    bool m_namedOnly;
+
+    friend class Node;
+};
+
+// Hashes the tree and the id of the node, which is what operator== compares: nodes can be keys of a QHash, a QSet or
+// of the std unordered containers
+inline size_t qHash(const Node &node, size_t seed = 0) noexcept
+{
+    return qHashMulti(seed, node.m_node.tree, node.m_node.id);
+}
+
 }
 
 template <>
 struct std::hash<treesitter::Node>
 {
-    std::size_t operator()(const treesitter::Node &node) const noexcept
-    {
-        std::size_t result = 0;
-        for (unsigned int i : node.m_node.context) {
-            result ^= std::hash<uint32_t> {}(i);
-        }
-        return result ^ std::hash<const void *> {}(node.m_node.id) ^ std::hash<const TSTree *> {}(node.m_node.tree);
-    }
+    std::size_t operator()(const treesitter::Node &node) const noexcept { return treesitter::qHash(node); }
 };
@@ -11,16 +11,22 @@
 #include "parser.h"
 #include "tree.h"
 #include "treesitter/languages.h"
+#include "utf8source.h"
+#include "utils/cancellation.h"
+#include "utils/counters.h"
 
 #include <tree_sitter/api.h>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace treesitter {
 
-Parser::Parser(TSLanguage *language)
+Parser::Parser(const TSLanguage *language)
     : m_parser(ts_parser_new())
 {
     ts_parser_set_language(m_parser, language);
+    setCancellationFlag(nullptr);
 }
 
 Parser::Parser(Parser &&other) noexcept
@@ -55,9 +61,71 @@ std::optional<Tree> Parser::parseString(const QString &text, const Tree *old_tre
 
     // TreeSitter may return a nullptr. See: https://tree-sitter.docsforge.com/master/api/ts_parser_parse/
     // In this case, return an empty optional.
+    if (tree)
+        Utils::Counters::add(old_tree ? Utils::Counters::IncrementalParses : Utils::Counters::FullParses);
     return tree ? Tree(tree) : std::optional<Tree> {};
 }
 
+std::optional<Tree> Parser::parseUtf8(std::shared_ptr<const Utf8Source> source) const
+{
+    const auto &bytes = source->bytes();
+    auto tree = ts_parser_parse_string_encoding(m_parser, nullptr, bytes.constData(),
+                                                static_cast<uint32_t>(bytes.size()), TSInputEncodingUTF8);
+    if (tree)
+        Utils::Counters::add(Utils::Counters::FullParses);
+    return tree ? Tree(tree, std::move(source)) : std::optional<Tree> {};
+}
+
+void Parser::setTimeout(std::chrono::microseconds timeout)
+{
+    ts_parser_set_timeout_micros(m_parser, static_cast<uint64_t>(timeout.count()));
+}
+
+std::chrono::microseconds Parser::timeout() const
+{
+    return std::chrono::microseconds(ts_parser_timeout_micros(m_parser));
+}
+
+void Parser::setCancellationFlag(const std::atomic<size_t> *flag)
+{
+    // Tree-sitter reads the flag atomically, through a plain pointer
+    static_assert(sizeof(std::atomic<size_t>) == sizeof(size_t));
+    if (!flag)
+        flag = Utils::Cancellation::flag();
+    ts_parser_set_cancellation_flag(m_parser, reinterpret_cast<const size_t *>(flag));
+}
+
+void Parser::reset()
+{
+    ts_parser_reset(m_parser);
+}
+
+bool Parser::setIncludedRanges(const std::vector<Range> &ranges)
+{
+    std::vector<TSRange> tsRanges;
+    tsRanges.reserve(ranges.size());
+    for (const auto &range : ranges)
+        tsRanges.push_back({range.startPoint, range.endPoint, range.startByte, range.endByte});
+    if (ts_parser_set_included_ranges(m_parser, tsRanges.data(), static_cast<uint32_t>(tsRanges.size())))
+        return true;
+    // Tree-sitter keeps the previous ranges on failure, they may be the ones of another text
+    ts_parser_set_included_ranges(m_parser, nullptr, 0);
+    return false;
+}
+
+std::vector<Range> Parser::includedRanges() const
+{
+    uint32_t count = 0;
+    const TSRange *tsRanges = ts_parser_included_ranges(m_parser, &count);
+    std::vector<Range> ranges;
+    ranges.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const auto &range = tsRanges[i];
+        ranges.push_back({range.start_point, range.end_point, range.start_byte, range.end_byte});
+    }
+    return ranges;
+}
+
 const TSLanguage *Parser::language() const
 {
     return ts_parser_language(m_parser);
@@ -74,4 +142,48 @@ TSLanguage *Parser::getLanguage(Core::Document::Type type)
         Q_UNREACHABLE();
     }
 }
+
+static std::unordered_map<const TSLanguage *, std::vector<Parser>> &threadParsers()
+{
+    thread_local std::unordered_map<const TSLanguage *, std::vector<Parser>> parsers;
+    return parsers;
+}
+
+Parser ParserPool::acquire(const TSLanguage *language)
+{
+    auto &parsers = threadParsers()[language];
+    if (parsers.empty())
+        return Parser(language);
+
+    auto parser = std::move(parsers.back());
+    parsers.pop_back();
+    return parser;
+}
+
+void ParserPool::release(Parser &&parser)
+{
+    if (!parser.m_parser)
+        return;
+
+    auto &parsers = threadParsers()[parser.language()];
+    if (parsers.size() >= MaximumSize)
+        return;
+    // Drops any state left by the last parse, the parse stacks are kept allocated
+    parser.reset();
+    parser.setTimeout({});
+    parser.setCancellationFlag(nullptr);
+    parser.setIncludedRanges({});
+    parsers.push_back(std::move(parser));
+}
+
+PooledParser::PooledParser(const TSLanguage *language)
+    : m_parser(ParserPool::acquire(language))
+{
+}
+
+PooledParser::~PooledParser()
+{
+    ParserPool::release(std::move(m_parser));
+}
+
 }
@@ -11,7 +11,12 @@
 #pragma once
 
 #include "core/document.h"
+#include "node.h"
 #include <QString>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 struct TSParser;
 struct TSLanguage;
@@ -19,11 +24,21 @@ struct TSLanguage;
 namespace treesitter {
 
 class Tree;
+class Utf8Source;
+
+// Range of the text given to a parser, in bytes and points of the parsed text
+struct Range
+{
+    Point startPoint;
+    Point endPoint;
+    uint32_t startByte;
+    uint32_t endByte;
+};
 
 class Parser
 {
 public:
-    Parser(TSLanguage *language);
+    Parser(const TSLanguage *language);
 
     Parser(const Parser &) = delete;
     Parser(Parser &&) noexcept;
@@ -35,7 +50,27 @@ public:
 
     void swap(Parser &other) noexcept;
 
+    // Returns no tree on failure, or if the parse is stopped by the timeout or the cancellation flag.
+    // A stopped parse is resumed by the next call with the same text, unless the parser is reset before.
     std::optional<Tree> parseString(const QString &text, const Tree *old_tree = nullptr) const;
+    // Same as parseString, with half the input size for mostly ASCII text. The tree keeps the source alive, so node
+    // positions are still in characters of the original text.
+    std::optional<Tree> parseUtf8(std::shared_ptr<const Utf8Source> source) const;
+
+    // Stops parsing after the timeout, zero disables it
+    void setTimeout(std::chrono::microseconds timeout);
+    std::chrono::microseconds timeout() const;
+    // Stops parsing as soon as the flag is non-zero, the flag can be set from another thread.
+    // By default, and with nullptr, the parse stops when the script is aborted (see Utils::Cancellation).
+    void setCancellationFlag(const std::atomic<size_t> *flag);
+    // Drops the state of a stopped parse, so the next parse starts from scratch
+    void reset();
+
+    // Only parses these ranges of the text, the rest is skipped as if it didn't exist: the positions of the nodes are
+    // still the ones in the whole text. The ranges must be sorted and must not overlap, otherwise it returns false
+    // and the parser parses the whole text. No ranges is the whole text.
+    bool setIncludedRanges(const std::vector<Range> &ranges);
+    std::vector<Range> includedRanges() const;
 
     const TSLanguage *language() const;
 
@@ -43,6 +78,41 @@ public:
 
 private:
     TSParser *m_parser;
+
+    friend class ParserPool;
+};
+
+// Parsers kept for reuse, per thread and per language.
+// Creating a parser and setting its language allocates its parse stacks: reusing parsers avoids doing it again for
+// each document, transformation or file parsed.
+class ParserPool
+{
+public:
+    // Returns a parser from the pool of the current thread, or a new one if there's none for this language
+    static Parser acquire(const TSLanguage *language);
+    // Gives the parser back to the pool of the current thread
+    static void release(Parser &&parser);
+
+private:
+    // Parsers kept per language and thread, the other ones are deleted when released
+    static constexpr size_t MaximumSize = 4;
+};
+
+// Parser taken from the pool of the current thread, and given back when destroyed
+class PooledParser
+{
+public:
+    explicit PooledParser(const TSLanguage *language);
+    ~PooledParser();
+
+    PooledParser(const PooledParser &) = delete;
+    PooledParser &operator=(const PooledParser &) = delete;
+
+    Parser &operator*() { return m_parser; }
+    Parser *operator->() { return &m_parser; }
+
+private:
+    Parser m_parser;
 };
 
 } // namespace treesitter
@@ -22,59 +22,105 @@
 
 namespace treesitter {
 
-QString QString_identity(const QString &string)
+static bool equals(QStringView left, QStringView right)
 {
-    return string;
+    return left == right;
 }
 
-QString QString_no_whitespace(const QString &string)
+// Returns the text without any whitespace, the strings compared by equalsIgnoringWhitespace are equal once simplified
+static QString withoutWhitespace(QStringView text)
 {
-    auto simplified = string.simplified();
-    simplified.replace(" ", "");
-    return simplified;
+    QString result;
+    result.reserve(text.size());
+    for (const QChar c : text) {
+        if (!c.isSpace())
+            result.append(c);
+    }
+    return result;
+}
+
+// Compares the strings ignoring all whitespaces, without creating new strings
+static bool equalsIgnoringWhitespace(QStringView left, QStringView right)
+{
+    auto leftIt = left.cbegin();
+    auto rightIt = right.cbegin();
+    while (true) {
+        while (leftIt != left.cend() && leftIt->isSpace())
+            ++leftIt;
+        while (rightIt != right.cend() && rightIt->isSpace())
+            ++rightIt;
+        if (leftIt == left.cend() || rightIt == right.cend())
+            return leftIt == left.cend() && rightIt == right.cend();
+        if (*leftIt != *rightIt)
+            return false;
+        ++leftIt;
+        ++rightIt;
+    }
 }
 
-Predicates::Filters Predicates::filters()
+const Predicates::Filters &Predicates::filters()
 {
-    Predicates::Filters filters;
+    static const Predicates::Filters filters = []() {
+        Predicates::Filters filters;
 #define REGISTER_FILTER(NAME)                                                                                          \
-    filters.filterFunctions[#NAME "?"] = &Predicates::filter_##NAME;                                                   \
+    filters.filterFunctions[#NAME "?"] = [](const Predicates &predicates, const QueryMatch &match,                     \
+                                            const Query::Predicate &predicate) {                                       \
+        return predicates.filter_##NAME(match, predicate);                                                             \
+    };                                                                                                                 \
     filters.checkFunctions[#NAME "?"] = &Predicates::checkFilter_##NAME
 
-    REGISTER_FILTER(eq);
-    REGISTER_FILTER(eq_except);
-    REGISTER_FILTER(like);
-    REGISTER_FILTER(like_except);
-    REGISTER_FILTER(match);
-    REGISTER_FILTER(in_message_map);
-    REGISTER_FILTER(not_is);
+        REGISTER_FILTER(eq);
+        REGISTER_FILTER(eq_except);
+        REGISTER_FILTER(like);
+        REGISTER_FILTER(like_except);
+        REGISTER_FILTER(match);
+        REGISTER_FILTER(in_message_map);
+        REGISTER_FILTER(not_is);
+        REGISTER_FILTER(any_of);
+        REGISTER_FILTER(not_any_of);
+        REGISTER_FILTER(like_any_of);
+        REGISTER_FILTER(not_like_any_of);
 #undef REGISTER_FILTER
 
+        // Spelling used by the other tree-sitter tools
+        for (const auto &[alias, name] : {std::pair {"any-of?", "any_of?"}, std::pair {"not-any-of?", "not_any_of?"}}) {
+            filters.filterFunctions[alias] = filters.filterFunctions.at(name);
+            filters.checkFunctions[alias] = filters.checkFunctions.at(name);
+        }
+
+        return filters;
+    }();
     return filters;
 }
 
-Predicates::Commands Predicates::commands()
+const Predicates::Commands &Predicates::commands()
 {
-    Predicates::Commands commands;
+    static const Predicates::Commands commands = []() {
+        Predicates::Commands commands;
 
 #define REGISTER_COMMAND(NAME)                                                                                         \
-    commands.commandFunctions[#NAME "!"] = &Predicates::command_##NAME;                                                \
+    commands.commandFunctions[#NAME "!"] = [](const Predicates &predicates, QueryMatch &match,                         \
+                                              const Query::Predicate &predicate) {                                     \
+        predicates.command_##NAME(match, predicate);                                                                   \
+    };                                                                                                                 \
     commands.checkFunctions[#NAME "!"] = &Predicates::checkCommand_##NAME;
 
-    REGISTER_COMMAND(exclude)
+        REGISTER_COMMAND(exclude)
 #undef REGISTER_COMMAND
+        return commands;
+    }();
     return commands;
 }
 
 std::optional<QString> Predicates::checkPredicate(const Query::Predicate &predicate)
 {
-    const auto filters = Predicates::filters();
+    const auto &filters = Predicates::filters();
     auto it = filters.checkFunctions.find(predicate.name);
     if (it != filters.checkFunctions.cend()) {
         return it->second(predicate.arguments);
     }
 
-    const auto commands = Predicates::commands();
+    const auto &commands = Predicates::commands();
     it = commands.checkFunctions.find(predicate.name);
     if (it != commands.checkFunctions.cend()) {
         return it->second(predicate.arguments);
@@ -83,43 +129,95 @@ std::optional<QString> Predicates::checkPredicate(const Query::Predicate &predic
     return "Unknown predicate";
 }
 
-Predicates::Predicates(QString source)
-    : m_source(std::move(source))
+// Returns the node types given as string arguments of a predicate, skipping the first `skip` strings
+static QList<QString> typeArguments(const Query::Predicate &predicate, int skip = 0)
+{
+    QList<QString> types;
+    for (const auto &argument : predicate.arguments) {
+        if (const auto *type = std::get_if<QString>(&argument); type && skip-- <= 0)
+            types.push_back(*type);
+    }
+    return types;
+}
+
+void Predicates::compilePredicate(const TSLanguage *language, Query::Predicate &predicate)
+{
+    // So matches are filtered without looking up the predicate by name
+    const auto &filterFunctions = Predicates::filters().filterFunctions;
+    if (const auto it = filterFunctions.find(predicate.name); it != filterFunctions.cend())
+        predicate.filter = it->second;
+    const auto &commandFunctions = Predicates::commands().commandFunctions;
+    if (const auto it = commandFunctions.find(predicate.name); it != commandFunctions.cend())
+        predicate.command = it->second;
+
+    if (predicate.name == "match?") {
+        // checkFilter_match ensures the first argument is a valid regex
+        predicate.regularExpression = QRegularExpression(std::get<QString>(predicate.arguments.first()));
+        predicate.regularExpression.optimize();
+    }
+
+    // So node types are compared as symbols, without creating a string for each node
+    if (predicate.name == "exclude!") {
+        predicate.nodeTypes = NodeTypes(language, typeArguments(predicate));
+    } else if (predicate.name == "eq_except?" || predicate.name == "like_except?") {
+        // The first string is the expected text
+        predicate.nodeTypes = NodeTypes(language, typeArguments(predicate, 1));
+    } else if (predicate.name.contains("any_of?") || predicate.name.contains("any-of?")) {
+        // Looked up in a hash set for each match, instead of comparing with each string. The strings can't be
+        // parameters, they are only known when the query is executed.
+        const bool ignoreWhitespace = predicate.name.contains("like");
+        for (const auto &argument : predicate.arguments) {
+            if (const auto *string = std::get_if<QString>(&argument))
+                predicate.strings.insert(ignoreWhitespace ? withoutWhitespace(*string) : *string);
+        }
+    } else if (predicate.name == "not_is?") {
+        // The types of #not_is? can be parameters, resolved when filtering
+        const auto types = typeArguments(predicate);
+        const bool hasParameter = kdalgorithms::any_of(types, [](const QString &type) {
+            return type.size() > 1 && type.front() == '$';
+        });
+        if (!hasParameter)
+            predicate.nodeTypes = NodeTypes(language, types);
+    }
+}
+
+void PredicateCaches::insert(std::unique_ptr<PredicateCache> cache)
+{
+    m_caches.emplace_back(std::move(cache));
+}
+
+Predicates::Predicates(QString source, std::shared_ptr<PredicateCaches> caches, QueryParameters parameters)
+    : m_caches(caches ? std::move(caches) : std::make_shared<PredicateCaches>())
+    , m_source(std::move(source))
+    , m_parameters(std::move(parameters))
 {
 }
 
 void Predicates::executeCommands(QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
+    const auto &pattern = match.query()->patterns().at(match.patternIndex());
 
     for (const auto &predicate : pattern.predicates) {
-        const auto commands = Predicates::commands();
-        const auto it = commands.commandFunctions.find(predicate.name);
-        if (it != commands.commandFunctions.cend()) {
-            const auto commandPredicate = it->second;
-            (this->*(commandPredicate))(match, predicate.arguments);
-        }
+        if (predicate.command)
+            predicate.command(*this, match, predicate);
     }
 }
 
 bool Predicates::filterMatch(const QueryMatch &match) const
 {
-    const auto patterns = match.query()->patterns();
-    const auto &pattern = patterns.at(match.patternIndex());
+    return rejectingPredicate(match) == nullptr;
+}
+
+const Query::Predicate *Predicates::rejectingPredicate(const QueryMatch &match) const
+{
+    const auto &pattern = match.query()->patterns().at(match.patternIndex());
 
     for (const auto &predicate : pattern.predicates) {
-        const auto filters = Predicates::filters();
-        const auto it = filters.filterFunctions.find(predicate.name);
-        if (it != filters.filterFunctions.cend()) {
-            const auto filterPredicate = it->second;
-            if (!(this->*(filterPredicate))(match, predicate.arguments)) {
-                return false;
-            }
-        }
+        if (predicate.filter && !predicate.filter(*this, match, predicate))
+            return &predicate;
     }
 
-    return true;
+    return nullptr;
 }
 
 std::optional<QString> Predicates::checkCommand_exclude(const Predicates::PredicateArguments &arguments)
@@ -145,15 +243,10 @@ std::optional<QString> Predicates::checkCommand_exclude(const Predicates::Predic
     return {};
 }
 
-void Predicates::command_exclude(QueryMatch &match, const Predicates::PredicateArguments &arguments) const
+void Predicates::command_exclude(QueryMatch &match, const Query::Predicate &predicate) const
 {
-    auto to_string = [](const auto &variant) {
-        return std::get<QString>(variant);
-    };
-    auto is_string = [](const auto &variant) {
-        return std::holds_alternative<QString>(variant);
-    };
-    auto exclusions = kdalgorithms::filtered_transformed<std::set>(arguments, to_string, is_string);
+    const auto &arguments = predicate.arguments;
+    const auto &exclusions = *predicate.nodeTypes;
 
     auto to_capture_id = [](const auto &variant) {
         return std::get<treesitter::Query::Capture>(variant).id;
@@ -168,7 +261,7 @@ void Predicates::command_exclude(QueryMatch &match, const Predicates::PredicateA
             return true;
         }
 
-        return !exclusions.contains(capture.node.type());
+        return !exclusions.contains(capture.node);
     });
 
     match.setCaptures(std::move(new_captures));
@@ -182,33 +275,44 @@ std::optional<QString> Predicates::checkFilter_eq(const Predicates::PredicateArg
     return {};
 }
 bool Predicates::filter_eq_with(const QueryMatch &match, const QList<std::variant<Query::Capture, QString>> &arguments,
-                                const std::function<QString(const QString &)> &textTransform) const
+                                bool (*equal)(QStringView, QStringView)) const
 {
-    std::set<QString> texts;
+    // All texts are views on the source or on the predicate arguments, they are only compared to the first one
+    std::optional<QStringView> first;
+    auto isEqualToFirst = [&first, equal](QStringView text) {
+        if (!first) {
+            first = text;
+            return true;
+        }
+        return equal(*first, text);
+    };
 
     const auto matched = matchArguments(match, arguments);
     for (const auto &arg : matched) {
         if (const auto *capture = std::get_if<QueryMatch::Capture>(&arg)) {
-            texts.emplace(textTransform(capture->node.textIn(m_source)));
+            if (!isEqualToFirst(capture->node.textViewIn(m_source)))
+                return false;
         } else if (const auto *string = std::get_if<QString>(&arg)) {
-            texts.emplace(textTransform(*string));
+            if (!isEqualToFirst(*string))
+                return false;
         } else if (std::holds_alternative<MissingCapture>(arg)) {
             spdlog::warn("Predicates: #eq? - Unmatched capture!");
-            // Insert an empty string into the set if we find an unmatched capture.
+            // Compare with an empty string if we find an unmatched capture.
             // This likely means we have encountered a quantified capture that matched 0 times.
-            // By inserting an empty string, we can check that all other things are also "empty".
-            texts.emplace("");
+            // By using an empty string, we can check that all other things are also "empty".
+            if (!isEqualToFirst(QStringView()))
+                return false;
         } else {
             spdlog::warn("Predicates: #eq? - Impossible argument type!");
             return false;
         }
     }
-    return texts.size() == 1;
+    return true;
 }
 
-bool Predicates::filter_eq(const QueryMatch &match, const QList<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_eq(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_with(match, arguments, QString_identity);
+    return filter_eq_with(match, predicate.arguments, equals);
 }
 
 std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::PredicateArguments &arguments)
@@ -237,18 +341,16 @@ std::optional<QString> Predicates::checkFilter_eq_except(const Predicates::Predi
     return {};
 }
 
-bool Predicates::filter_like(const QueryMatch &match,
-                             const QList<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_like(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_with(match, arguments, QString_no_whitespace);
+    return filter_eq_with(match, predicate.arguments, equalsIgnoringWhitespace);
 }
-bool Predicates::filter_eq_except_with(const QueryMatch &match,
-                                       const QList<std::variant<Query::Capture, QString>> &arguments,
-                                       const std::function<QString(const QString &)> &textTransform) const
+bool Predicates::filter_eq_except_with(const QueryMatch &match, const Query::Predicate &predicate,
+                                       bool (*equal)(QStringView, QStringView)) const
 {
-    auto args = arguments;
+    auto args = predicate.arguments;
     if (const auto *rawExpected = std::get_if<QString>(&args.front())) {
-        auto expected = textTransform(*rawExpected);
+        const auto expected = resolveParameter(*rawExpected);
         args.pop_front();
         if (const auto *rawCapture = std::get_if<Query::Capture>(&args.front())) {
             // we need to copy the capture here, as otherwise it might get dropped
@@ -256,24 +358,18 @@ bool Predicates::filter_eq_except_with(const QueryMatch &match,
             auto capture = *rawCapture;
             args.pop_front();
 
-            auto types = QList<QString>();
-            for (const auto &arg : std::as_const(args)) {
-                if (const auto *type = std::get_if<QString>(&arg)) {
-                    types.push_back(*type);
-                }
-            }
-
+            const auto &types = *predicate.nodeTypes;
             const auto idCaptures = match.capturesWithId(capture.id);
             if (idCaptures.isEmpty()) {
                 spdlog::warn("Predicates: #eq_except? - No captures");
                 // Insert an empty string into the set if we find an unmatched capture.
                 // This likely means we have encountered a quantified capture that matched 0 times.
                 // So check whether the expected string is also empty
-                return expected.isEmpty();
+                return equal(expected, QStringView());
             }
 
             for (const auto &idCapture : idCaptures) {
-                if (expected != textTransform(idCapture.node.textExcept(m_source, types))) {
+                if (!equal(expected, idCapture.node.textExcept(m_source, types))) {
                     return false;
                 }
             }
@@ -289,18 +385,28 @@ bool Predicates::filter_eq_except_with(const QueryMatch &match,
     }
 }
 
-bool Predicates::filter_eq_except(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_eq_except(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_except_with(match, arguments, QString_identity);
+    return filter_eq_except_with(match, predicate, equals);
 }
 
-bool Predicates::filter_like_except(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_like_except(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    return filter_eq_except_with(match, arguments, QString_no_whitespace);
+    return filter_eq_except_with(match, predicate, equalsIgnoringWhitespace);
 }
 
-bool Predicates::filter_not_is(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_not_is(const QueryMatch &match, const Query::Predicate &predicate) const
 {
+    if (const auto &types = predicate.nodeTypes) {
+        return std::ranges::none_of(match.captures(), [&](const QueryMatch::Capture &capture) {
+            return kdalgorithms::any_of(predicate.arguments, [&](const auto &argument) {
+                const auto *captureArgument = std::get_if<Query::Capture>(&argument);
+                return captureArgument && captureArgument->id == capture.id;
+            }) && types->contains(capture.node);
+        });
+    }
+
+    const auto &arguments = predicate.arguments;
     const auto matched = matchArguments(match, arguments);
 
     auto captures = QList<QueryMatch::Capture>();
@@ -356,6 +462,88 @@ std::optional<QString> Predicates::checkFilter_match(const Predicates::Predicate
     return {};
 }
 
+std::optional<QString> Predicates::checkFilter_any_of(const Predicates::PredicateArguments &arguments)
+{
+    if (arguments.size() < 2) {
+        return "Too few arguments";
+    }
+    if (!kdalgorithms::any_of(arguments, [](const auto &arg) {
+            return std::holds_alternative<Query::Capture>(arg);
+        })) {
+        return "You need to provide at least one capture";
+    }
+    if (!kdalgorithms::any_of(arguments, [](const auto &arg) {
+            return std::holds_alternative<QString>(arg);
+        })) {
+        return "You need to provide at least one string to match against";
+    }
+    return {};
+}
+
+std::optional<QString> Predicates::checkFilter_not_any_of(const Predicates::PredicateArguments &arguments)
+{
+    return checkFilter_any_of(arguments);
+}
+
+std::optional<QString> Predicates::checkFilter_like_any_of(const Predicates::PredicateArguments &arguments)
+{
+    return checkFilter_any_of(arguments);
+}
+
+std::optional<QString> Predicates::checkFilter_not_like_any_of(const Predicates::PredicateArguments &arguments)
+{
+    return checkFilter_any_of(arguments);
+}
+
+bool Predicates::filter_any_of_with(const QueryMatch &match, const Query::Predicate &predicate, bool ignoreWhitespace,
+                                    bool expected) const
+{
+    auto isExpected = [&](QStringView text) {
+        const bool found =
+            ignoreWhitespace ? predicate.strings.contains(withoutWhitespace(text)) : predicate.strings.contains(text);
+        return found == expected;
+    };
+
+    const auto captures = match.captures();
+    for (const auto &argument : predicate.arguments) {
+        const auto *captureArgument = std::get_if<Query::Capture>(&argument);
+        if (!captureArgument)
+            continue;
+        bool matched = false;
+        for (const auto &capture : captures) {
+            if (capture.id != captureArgument->id)
+                continue;
+            matched = true;
+            if (!isExpected(capture.node.textViewIn(m_source)))
+                return false;
+        }
+        // Same as #eq?, a quantified capture that matched 0 times is an empty string
+        if (!matched && !isExpected(QStringView()))
+            return false;
+    }
+    return true;
+}
+
+bool Predicates::filter_any_of(const QueryMatch &match, const Query::Predicate &predicate) const
+{
+    return filter_any_of_with(match, predicate, false, true);
+}
+
+bool Predicates::filter_not_any_of(const QueryMatch &match, const Query::Predicate &predicate) const
+{
+    return filter_any_of_with(match, predicate, false, false);
+}
+
+bool Predicates::filter_like_any_of(const QueryMatch &match, const Query::Predicate &predicate) const
+{
+    return filter_any_of_with(match, predicate, true, true);
+}
+
+bool Predicates::filter_not_like_any_of(const QueryMatch &match, const Query::Predicate &predicate) const
+{
+    return filter_any_of_with(match, predicate, true, false);
+}
+
 std::optional<QString> Predicates::checkFilter_not_is(const Predicates::PredicateArguments &arguments)
 {
     if (arguments.size() < 2) {
@@ -380,40 +568,32 @@ std::optional<QString> Predicates::checkFilter_not_is(const Predicates::Predicat
     return std::nullopt;
 }
 
-bool Predicates::filter_match(const QueryMatch &match,
-                              const QList<std::variant<Query::Capture, QString>> &arguments) const
+bool Predicates::filter_match(const QueryMatch &match, const Query::Predicate &predicate) const
 {
-    const auto matched = matchArguments(match, arguments);
-
+    const auto &arguments = predicate.arguments;
     if (arguments.size() < 2) {
         return false;
     }
 
-    if (const auto regexString = std::get_if<QString>(&matched.first())) {
-        const QRegularExpression regex(*regexString);
-        if (!regex.isValid()) {
-            spdlog::warn("Predicates: #match? - Invalid regex");
-            return false;
-        }
+    const auto &regex = predicate.regularExpression;
+    if (!regex.isValid()) {
+        spdlog::warn("Predicates: #match? - Invalid regex");
+        return false;
+    }
 
-        for (const auto &argument : matched | std::views::drop(1)) {
-            if (const auto *capture = std::get_if<QueryMatch::Capture>(&argument)) {
-                auto source = capture->node.textIn(m_source);
-                if (!regex.match(source).hasMatch()) {
-                    return false;
-                }
-            } else if (std::holds_alternative<MissingCapture>(argument)) {
-                spdlog::warn("Predicates: #match? - Unmatched capture argument");
-                return false;
-            } else {
-                spdlog::warn("Predicates: #match? - Argument is not a capture");
+    const auto matched = matchArguments(match, arguments);
+    for (const auto &argument : matched | std::views::drop(1)) {
+        if (const auto *capture = std::get_if<QueryMatch::Capture>(&argument)) {
+            if (!regex.match(capture->node.textViewIn(m_source)).hasMatch()) {
                 return false;
             }
+        } else if (std::holds_alternative<MissingCapture>(argument)) {
+            spdlog::warn("Predicates: #match? - Unmatched capture argument");
+            return false;
+        } else {
+            spdlog::warn("Predicates: #match? - Argument is not a capture");
+            return false;
         }
-    } else {
-
-        spdlog::warn("Predicates: #match? - First argument is not a string");
-        return false;
     }
 
     return true;
@@ -421,28 +601,34 @@ bool Predicates::filter_match(const QueryMatch &match,
 
 void Predicates::insertCache(std::unique_ptr<PredicateCache> cache) const
 {
-    m_caches.emplace_back(std::move(cache));
+    m_caches->insert(std::move(cache));
 }
 
+// Only positions are kept, as the cache may outlive the tree it was computed from
 class MessageMapCache : public PredicateCache
 {
 public:
-    MessageMapCache(const Node &begin, const Node &end)
-        : m_begin(begin)
-        , m_end(end)
+    struct Range
+    {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    explicit MessageMapCache(std::optional<Range> range)
+        : m_range(range)
     {
     }
 
     ~MessageMapCache() override = default;
 
-    Node m_begin;
-    Node m_end;
+    // Range between the BEGIN_MESSAGE_MAP and END_MESSAGE_MAP, empty if there's no message map
+    const std::optional<Range> m_range;
 };
 
 void Predicates::findMessageMap() const
 {
     if (findCache<MessageMapCache>()) {
-        // Already found it!
+        // Already searched for it!
         return;
     }
 
@@ -470,18 +656,26 @@ void Predicates::findMessageMap() const
 )
     )EOF");
 
+    // The caches may be shared by all cursors on the tree, so always search from the root of the tree
+    auto root = *m_rootNode;
+    for (auto parent = root.parent(); !parent.isNull(); parent = parent.parent())
+        root = parent;
+
     QueryCursor cursor;
-    cursor.execute(query, *m_rootNode, std::make_unique<Predicates>(m_source));
+    cursor.execute(query, root, std::make_unique<Predicates>(m_source));
 
+    std::optional<MessageMapCache::Range> range;
     auto match = cursor.nextMatch();
     if (match.has_value()) {
         auto begin = match->capturesNamed("begin");
         auto end = match->capturesNamed("end");
 
         if (!begin.isEmpty() && !end.isEmpty()) {
-            insertCache(std::make_unique<MessageMapCache>(begin.first().node, end.first().node));
+            range = MessageMapCache::Range {.begin = begin.first().node.endPosition(),
+                                            .end = end.first().node.startPosition()};
         }
     }
+    insertCache(std::make_unique<MessageMapCache>(range));
 }
 
 std::optional<QString> Predicates::checkFilter_in_message_map(const Predicates::PredicateArguments &arguments)
@@ -499,17 +693,19 @@ std::optional<QString> Predicates::checkFilter_in_message_map(const Predicates::
     return {};
 }
 
-bool Predicates::filter_in_message_map(const QueryMatch &match, const PredicateArguments &arguments) const
+bool Predicates::filter_in_message_map(const QueryMatch &match, const Query::Predicate &predicate) const
 {
+    const auto &arguments = predicate.arguments;
     findMessageMap();
 
-    if (const auto *message_map = findCache<MessageMapCache>()) {
+    const auto *message_map = findCache<MessageMapCache>();
+    if (message_map && message_map->m_range) {
         const auto matched = matchArguments(match, arguments);
 
         for (const auto &argument : matched) {
             if (const auto capture = std::get_if<QueryMatch::Capture>(&argument)) {
-                if (!(message_map->m_begin.endPosition() <= capture->node.startPosition()
-                      && capture->node.endPosition() <= message_map->m_end.startPosition())) {
+                if (!(message_map->m_range->begin <= capture->node.startPosition()
+                      && capture->node.endPosition() <= message_map->m_range->end)) {
                     // We're outside of the message map
                     return false;
                 }
@@ -533,7 +729,7 @@ Predicates::matchArguments(const QueryMatch &match, const Predicates::PredicateA
 
     for (const auto &argument : arguments) {
         if (const auto string = std::get_if<QString>(&argument)) {
-            result.emplace_back(*string);
+            result.emplace_back(resolveParameter(*string));
         } else if (const auto captureArgument = std::get_if<Query::Capture>(&argument)) {
             const auto captures = match.capturesWithId(captureArgument->id);
 
@@ -549,6 +745,14 @@ Predicates::matchArguments(const QueryMatch &match, const Predicates::PredicateA
     return result;
 }
 
+const QString &Predicates::resolveParameter(const QString &string) const
+{
+    if (m_parameters.empty() || string.size() < 2 || string.front() != '$')
+        return string;
+    const auto it = m_parameters.find(string.mid(1));
+    return it != m_parameters.end() ? it->second : string;
+}
+
 void Predicates::setRootNode(const Node &node)
 {
     m_rootNode = node;
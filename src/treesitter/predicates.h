@@ -14,6 +14,7 @@
 #include "query.h"
 
 #include <QString>
+#include <memory>
 
 namespace treesitter {
 
@@ -26,6 +27,29 @@ public:
     virtual ~PredicateCache() = default;
 };
 
+// Caches of the data computed by the predicates for a syntax tree (e.g. the message map position).
+// They can be shared by all cursors running on the same tree, and must be dropped once the tree changes.
+// Not thread-safe: the caches are filled while the predicates are executed.
+class PredicateCaches
+{
+public:
+    template <class T>
+    T *find() const
+    {
+        for (auto &cache : m_caches) {
+            if (auto *result = dynamic_cast<T *>(cache.get())) {
+                return result;
+            }
+        }
+        return nullptr;
+    }
+
+    void insert(std::unique_ptr<PredicateCache> cache);
+
+private:
+    std::vector<std::unique_ptr<PredicateCache>> m_caches;
+};
+
 // At the moment, predicates are just member functions of the Predicates class.
 // However, in the future we may want to separate the Predicates class into two:
 // 1. A PredicateList class, containing a list of predicates, but no context for the predicates to execute
@@ -38,38 +62,42 @@ class Predicates
     using PredicateArguments = QVector<std::variant<Query::Capture, QString>>;
     struct Filters
     {
-        std::unordered_map<QString, bool (Predicates::*)(const QueryMatch &, const PredicateArguments &) const>
-            filterFunctions;
-
+        std::unordered_map<QString, decltype(Query::Predicate::filter)> filterFunctions;
         std::unordered_map<QString, std::optional<QString> (*)(const PredicateArguments &)> checkFunctions;
     };
 
     struct Commands
     {
         std::unordered_map<QString, std::optional<QString> (*)(const PredicateArguments &)> checkFunctions;
-        std::unordered_map<QString, void (Predicates::*)(QueryMatch &, const PredicateArguments &) const>
-            commandFunctions;
+        std::unordered_map<QString, decltype(Query::Predicate::command)> commandFunctions;
     };
 
-    static Filters filters();
-    static Commands commands();
+    // Both are only built once, the functions are stored in the predicates by compilePredicate
+    static const Filters &filters();
+    static const Commands &commands();
 
 public:
-    explicit Predicates(QString source);
+    // Without caches, the predicates use their own: they are computed again for each Predicates instance.
+    // Parameters (`"$name"` string arguments) are replaced by their values, unbound ones are kept as is.
+    explicit Predicates(QString source, std::shared_ptr<PredicateCaches> caches = {}, QueryParameters parameters = {});
 
     // Returns an error message if the predicate is not supported
     static std::optional<QString> checkPredicate(const Query::Predicate &predicate);
+    // Precomputes the data needed to filter matches with the predicate, called once the predicate is checked
+    static void compilePredicate(const TSLanguage *language, Query::Predicate &predicate);
 
     // Executes all command-predicates (e.g. exclude!) on the match.
     void executeCommands(QueryMatch &match) const;
 
     // Returns true if the match fulfills all query predicates.
     bool filterMatch(const QueryMatch &match) const;
+    // Returns the first predicate the match doesn't fulfill, or nullptr if it fulfills all of them.
+    const Query::Predicate *rejectingPredicate(const QueryMatch &match) const;
 
 private:
     // ################# Commands #########################
 #define PREDICATE_COMMAND(NAME)                                                                                        \
-    void command_##NAME(QueryMatch &match, const PredicateArguments &arguments) const;                                 \
+    void command_##NAME(QueryMatch &match, const Query::Predicate &predicate) const;                                   \
     static std::optional<QString> checkCommand_##NAME(const PredicateArguments &arguments);
 
     PREDICATE_COMMAND(exclude)
@@ -77,7 +105,7 @@ private:
 
     // ################## Filters #########################
 #define PREDICATE_FILTER(NAME)                                                                                         \
-    bool filter_##NAME(const QueryMatch &match, const PredicateArguments &arguments) const;                            \
+    bool filter_##NAME(const QueryMatch &match, const Query::Predicate &predicate) const;                              \
     static std::optional<QString> checkFilter_##NAME(const PredicateArguments &arguments)
 
     PREDICATE_FILTER(eq);
@@ -87,12 +115,19 @@ private:
     PREDICATE_FILTER(match);
     PREDICATE_FILTER(in_message_map);
     PREDICATE_FILTER(not_is);
+    PREDICATE_FILTER(any_of);
+    PREDICATE_FILTER(not_any_of);
+    PREDICATE_FILTER(like_any_of);
+    PREDICATE_FILTER(not_like_any_of);
 #undef PREDICATE_FILTER
 
     bool filter_eq_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
-                        const std::function<QString(const QString &)> &textTransform) const;
-    bool filter_eq_except_with(const QueryMatch &match, const QVector<std::variant<Query::Capture, QString>> &arguments,
-                               const std::function<QString(const QString &)> &textTransform) const;
+                        bool (*equal)(QStringView, QStringView)) const;
+    bool filter_eq_except_with(const QueryMatch &match, const Query::Predicate &predicate,
+                               bool (*equal)(QStringView, QStringView)) const;
+    // Checks that the text of each capture is (or isn't, if `expected` is false) one of the predicate strings
+    bool filter_any_of_with(const QueryMatch &match, const Query::Predicate &predicate, bool ignoreWhitespace,
+                            bool expected) const;
 
     // ################## Argument matching #########################
     // Marker type indicating a capture is missing
@@ -104,18 +139,16 @@ private:
     QVector<std::variant<QString, QueryMatch::Capture, MissingCapture>>
     matchArguments(const QueryMatch &match, const PredicateArguments &arguments) const;
 
+    // Returns the value of the parameter if `string` is a bound parameter, `string` otherwise
+    const QString &resolveParameter(const QString &string) const;
+
     // ################## Caches #########################
-    mutable std::vector<std::unique_ptr<PredicateCache>> m_caches;
+    const std::shared_ptr<PredicateCaches> m_caches;
 
     template <class T>
     T *findCache() const
     {
-        for (auto &cache : m_caches) {
-            if (auto *result = dynamic_cast<T *>(cache.get())) {
-                return result;
-            }
-        }
-        return nullptr;
+        return m_caches->find<T>();
     }
 
     void insertCache(std::unique_ptr<PredicateCache>) const;
@@ -127,6 +160,7 @@ private:
     void setRootNode(const Node &node);
 
     const QString m_source;
+    const QueryParameters m_parameters;
     std::optional<Node> m_rootNode;
 };
 
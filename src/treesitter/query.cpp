@@ -11,8 +11,14 @@
 #include "query.h"
 #include "node.h"
 #include "predicates.h"
+#include "tree.h"
+#include "utils/cancellation.h"
+#include "utils/counters.h"
+#include "utils/trace.h"
 
+#include <QElapsedTimer>
 #include <QStringList>
+#include <algorithm>
 #include <kdalgorithms.h>
 #include <tree_sitter/api.h>
 
@@ -36,23 +42,48 @@ Query::Query(const TSLanguage *language, const QString &query)
         };
     }
 
-    const auto patterns = this->patterns();
-    for (const auto &pattern : patterns) {
-        for (const auto &predicate : pattern.predicates) {
+    const auto captureCount = ts_query_capture_count(m_query);
+    m_captureNames.reserve(captureCount);
+    for (uint32_t index = 0; index < captureCount; ++index) {
+        uint32_t length;
+        const auto name = ts_query_capture_name_for_id(m_query, index, &length);
+        m_captureNames.push_back(QString::fromUtf8(name, length));
+        m_captureIndexes.insert(m_captureNames.back(), static_cast<int>(index));
+    }
+
+    const auto count = ts_query_pattern_count(m_query);
+    m_patterns.reserve(count);
+    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
+        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
+        auto predicates = predicatesForPattern(patternIndex);
+
+        m_patterns.emplace_back(Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte});
+    }
+
+    for (auto &pattern : m_patterns) {
+        for (auto &predicate : pattern.predicates) {
             auto error = Predicates::checkPredicate(predicate);
             if (error.has_value()) {
                 auto predicateString = QString("#%1").arg(predicate.name).toUtf8();
                 auto offset = m_utf8_text.indexOf(predicateString);
                 offset = offset >= 0 ? offset : 0;
 
+                // Make sure the TSQuery is not leaked, as the destructor won't be called
+                ts_query_delete(m_query);
+                m_query = nullptr;
                 throw Error {.utf8_offset = static_cast<uint32_t>(offset), .description = error.value()};
             }
+            Predicates::compilePredicate(language, predicate);
         }
     }
 }
 
 Query::Query(Query &&other) noexcept
-    : m_query(other.m_query)
+    : m_utf8_text(std::move(other.m_utf8_text))
+    , m_query(other.m_query)
+    , m_patterns(std::move(other.m_patterns))
+    , m_captureNames(std::move(other.m_captureNames))
+    , m_captureIndexes(std::move(other.m_captureIndexes))
 {
     other.m_query = nullptr;
 }
@@ -70,9 +101,18 @@ Query &Query::operator=(Query &&other) noexcept
     return *this;
 }
 
+QString Query::text() const
+{
+    return QString::fromUtf8(m_utf8_text);
+}
+
 void Query::swap(Query &other) noexcept
 {
+    std::swap(m_utf8_text, other.m_utf8_text);
     std::swap(m_query, other.m_query);
+    std::swap(m_patterns, other.m_patterns);
+    std::swap(m_captureNames, other.m_captureNames);
+    std::swap(m_captureIndexes, other.m_captureIndexes);
 }
 
 QList<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
@@ -110,41 +150,36 @@ QList<Query::Predicate> Query::predicatesForPattern(uint32_t index) const
     return predicates;
 }
 
-QList<Query::Pattern> Query::patterns() const
+const QList<Query::Pattern> &Query::patterns() const
 {
-    QList<Query::Pattern> result;
-
-    auto count = ts_query_pattern_count(m_query);
-    result.reserve(count);
-    for (uint32_t patternIndex = 0; patternIndex < count; ++patternIndex) {
-        auto start_byte = ts_query_start_byte_for_pattern(m_query, patternIndex);
-        auto predicates = predicatesForPattern(patternIndex);
-
-        result.emplace_back(Pattern {.predicates = std::move(predicates), .utf8_start_byte = start_byte});
-    }
-    return result;
+    return m_patterns;
 }
 
 QList<Query::Capture> Query::captures() const
 {
-    uint32_t length = ts_query_capture_count(m_query);
-
     QList<Query::Capture> results;
-    for (uint32_t i = 0; i < length; i++) {
+    for (uint32_t i = 0; i < static_cast<uint32_t>(m_captureNames.size()); i++) {
         results.emplace_back(captureAt(i));
     }
     return results;
 }
 Query::Capture Query::captureAt(uint32_t index) const
 {
-    uint32_t length;
-    auto name = ts_query_capture_name_for_id(m_query, index, &length);
+    return Capture {.name = m_captureNames.at(index), .id = index};
+}
 
-    return Capture {.name = QString(name), .id = index};
+const QStringList &Query::captureNames() const
+{
+    return m_captureNames;
+}
+
+int Query::captureIndex(const QString &name) const
+{
+    return m_captureIndexes.value(name, -1);
 }
 
 // ------------------------ QueryMatch --------------------
-QueryMatch::QueryMatch(const TSQueryMatch &match, std::shared_ptr<Query> query)
+QueryMatch::QueryMatch(const TSQueryMatch &match, std::shared_ptr<Query> query, const Utf8Source *utf8Source)
     : m_id(match.id)
     , m_pattern_index(match.pattern_index)
     , m_query(std::move(query))
@@ -157,7 +192,7 @@ QueryMatch::QueryMatch(const TSQueryMatch &match, std::shared_ptr<Query> query)
         auto &ts_capture = match.captures[i];
         Capture capture {
             .id = ts_capture.index,
-            .node = Node(ts_capture.node),
+            .node = Node(ts_capture.node, utf8Source),
         };
         m_captures.emplace_back(std::move(capture));
     }
@@ -180,12 +215,10 @@ std::shared_ptr<Query> QueryMatch::query() const
 
 QList<QueryMatch::Capture> QueryMatch::capturesNamed(const QString &name) const
 {
-    auto captures = this->captures();
-    QList<Capture> result;
-    std::ranges::copy_if(std::as_const(captures), std::back_inserter(result), [this, &name](const auto &capture) {
-        return m_query->captureAt(capture.id).name == name;
-    });
-    return result;
+    const int index = m_query->captureIndex(name);
+    if (index < 0)
+        return {};
+    return capturesWithId(static_cast<uint32_t>(index));
 }
 
 void QueryMatch::setCaptures(QList<Capture> &&captures)
@@ -213,6 +246,7 @@ QueryCursor::QueryCursor()
 
 QueryCursor::~QueryCursor()
 {
+    flushProfile();
     if (m_cursor) {
         ts_query_cursor_delete(m_cursor);
     }
@@ -220,10 +254,16 @@ QueryCursor::~QueryCursor()
 
 QueryCursor::QueryCursor(QueryCursor &&other) noexcept
     : m_query(std::move(other.m_query))
+    , m_progressCallback(std::move(other.m_progressCallback))
     , m_predicates(std::move(other.m_predicates))
+    , m_snapshot(std::move(other.m_snapshot))
     , m_cursor(std::move(other.m_cursor))
+    , m_utf8Source(other.m_utf8Source)
+    , m_profile(other.m_profile)
+    , m_profilerProfile(std::move(other.m_profilerProfile))
 {
     other.m_cursor = nullptr;
+    other.m_profile = nullptr;
 }
 
 QueryCursor &QueryCursor::operator=(QueryCursor &&other) noexcept
@@ -234,17 +274,53 @@ QueryCursor &QueryCursor::operator=(QueryCursor &&other) noexcept
 
 void QueryCursor::swap(QueryCursor &other) noexcept
 {
+    std::swap(m_query, other.m_query);
+    std::swap(m_progressCallback, other.m_progressCallback);
+    std::swap(m_predicates, other.m_predicates);
+    std::swap(m_snapshot, other.m_snapshot);
     std::swap(m_cursor, other.m_cursor);
+    std::swap(m_utf8Source, other.m_utf8Source);
+    std::swap(m_profile, other.m_profile);
+    std::swap(m_profilerProfile, other.m_profilerProfile);
 }
 
 void QueryCursor::execute(std::shared_ptr<Query> query, const Node &node, std::unique_ptr<Predicates> &&predicates)
 {
+    TRACE("QueryCursor::execute");
+    Utils::Counters::add(Utils::Counters::QueriesExecuted);
+    flushProfile();
     m_predicates = std::move(predicates);
     if (m_predicates) {
         m_predicates->setRootNode(node);
     }
     m_query = std::move(query);
+    m_utf8Source = node.m_utf8Source;
     ts_query_cursor_exec(m_cursor, m_query->m_query, node.m_node);
+
+    if (!m_profile && QueryProfiler::isEnabled())
+        m_profilerProfile = std::make_unique<QueryProfile>();
+    if (auto profile = m_profile ? m_profile : m_profilerProfile.get()) {
+        if (profile->queryText.isEmpty())
+            profile->queryText = m_query->text();
+        profile->patterns.resize(std::max(profile->patterns.size(), m_query->patterns().size()));
+        ++profile->executions;
+    }
+}
+
+void QueryCursor::execute(std::shared_ptr<Query> query, std::shared_ptr<const TreeSnapshot> snapshot)
+{
+    execute(std::move(query), snapshot->rootNode(), std::make_unique<Predicates>(snapshot->source()));
+    m_snapshot = std::move(snapshot);
+}
+
+void QueryCursor::setByteRange(uint32_t startByte, uint32_t endByte)
+{
+    ts_query_cursor_set_byte_range(m_cursor, startByte, endByte);
+}
+
+void QueryCursor::setPointRange(const Point &startPoint, const Point &endPoint)
+{
+    ts_query_cursor_set_point_range(m_cursor, startPoint, endPoint);
 }
 
 void QueryCursor::setProgressCallback(std::function<void()> callback)
@@ -252,12 +328,30 @@ void QueryCursor::setProgressCallback(std::function<void()> callback)
     m_progressCallback = std::move(callback);
 }
 
+void QueryCursor::setProfile(QueryProfile *profile)
+{
+    flushProfile();
+    m_profile = profile;
+}
+
+void QueryCursor::flushProfile()
+{
+    if (m_profilerProfile) {
+        QueryProfiler::instance().add(*m_profilerProfile);
+        m_profilerProfile.reset();
+    }
+}
+
 std::optional<QueryMatch> QueryCursor::nextMatch()
 {
+    if (auto profile = m_profile ? m_profile : m_profilerProfile.get())
+        return nextProfiledMatch(*profile);
+
     TSQueryMatch match;
 
-    while (ts_query_cursor_next_match(m_cursor, &match)) {
-        QueryMatch result(match, m_query);
+    while (!Utils::Cancellation::isCanceled() && ts_query_cursor_next_match(m_cursor, &match)) {
+        Utils::Counters::add(Utils::Counters::MatchesProduced);
+        QueryMatch result(match, m_query, m_utf8Source);
         if (m_predicates) {
             m_predicates->executeCommands(result);
             if (m_predicates->filterMatch(result)) {
@@ -266,16 +360,59 @@ std::optional<QueryMatch> QueryCursor::nextMatch()
         } else {
             return result;
         }
+        Utils::Counters::add(Utils::Counters::MatchesFiltered);
 
         if (m_progressCallback) {
             m_progressCallback();
         }
     }
+
+    return {};
+}
+
+// Same as nextMatch, but records the time spent and the reason matches are rejected
+std::optional<QueryMatch> QueryCursor::nextProfiledMatch(QueryProfile &profile)
+{
+    TSQueryMatch match;
+    QElapsedTimer timer;
+
+    while (!Utils::Cancellation::isCanceled()) {
+        timer.start();
+        const bool found = ts_query_cursor_next_match(m_cursor, &match);
+        profile.nextMatchTime += timer.nsecsElapsed();
+        if (!found)
+            break;
+
+        Utils::Counters::add(Utils::Counters::MatchesProduced);
+        QueryMatch result(match, m_query, m_utf8Source);
+        auto &statistics = profile.patterns[result.patternIndex()];
+        ++statistics.rawMatches;
+
+        const Query::Predicate *rejectingPredicate = nullptr;
+        if (m_predicates) {
+            timer.start();
+            m_predicates->executeCommands(result);
+            rejectingPredicate = m_predicates->rejectingPredicate(result);
+            profile.predicatesTime += timer.nsecsElapsed();
+        }
+        if (!rejectingPredicate) {
+            ++statistics.acceptedMatches;
+            return result;
+        }
+        ++statistics.rejections[rejectingPredicate->name];
+        Utils::Counters::add(Utils::Counters::MatchesFiltered);
+
+        if (m_progressCallback) {
+            m_progressCallback();
+        }
+    }
+
     return {};
 }
 
 QList<QueryMatch> QueryCursor::allRemainingMatches()
 {
+    TRACE("QueryCursor::allRemainingMatches");
     QList<QueryMatch> matches;
     for (auto match = nextMatch(); match.has_value(); match = nextMatch()) {
         matches.emplace_back(match.value());
@@ -283,4 +420,208 @@ QList<QueryMatch> QueryCursor::allRemainingMatches()
     return matches;
 }
 
+void QueryProfile::merge(const QueryProfile &other)
+{
+    if (queryText.isEmpty())
+        queryText = other.queryText;
+    patterns.resize(std::max(patterns.size(), other.patterns.size()));
+    for (qsizetype i = 0; i < other.patterns.size(); ++i) {
+        const auto &otherStatistics = other.patterns.at(i);
+        auto &statistics = patterns[i];
+        statistics.rawMatches += otherStatistics.rawMatches;
+        statistics.acceptedMatches += otherStatistics.acceptedMatches;
+        for (const auto &[name, count] : otherStatistics.rejections)
+            statistics.rejections[name] += count;
+    }
+    executions += other.executions;
+    nextMatchTime += other.nextMatchTime;
+    predicatesTime += other.predicatesTime;
+}
+
+QString QueryProfile::toString() const
+{
+    auto toMs = [](qint64 time) {
+        return QString::number(static_cast<double>(time) / 1'000'000, 'f', 2);
+    };
+
+    QString result = QString("%1 executions - %2ms matching - %3ms in predicates\n")
+                         .arg(executions)
+                         .arg(toMs(nextMatchTime), toMs(predicatesTime));
+    for (qsizetype i = 0; i < patterns.size(); ++i) {
+        const auto &statistics = patterns.at(i);
+        result += QString("  Pattern %1: %2 matches - %3 accepted")
+                      .arg(i)
+                      .arg(statistics.rawMatches)
+                      .arg(statistics.acceptedMatches);
+        for (const auto &[name, count] : statistics.rejections)
+            result += QString(" - %1 rejected by #%2").arg(count).arg(name);
+        result += '\n';
+    }
+    return result;
+}
+
+std::atomic<bool> QueryProfiler::m_enabled = false;
+
+QueryProfiler &QueryProfiler::instance()
+{
+    static QueryProfiler profiler;
+    return profiler;
+}
+
+bool QueryProfiler::isEnabled()
+{
+    return m_enabled;
+}
+
+void QueryProfiler::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+void QueryProfiler::add(const QueryProfile &profile)
+{
+    std::lock_guard lock(m_mutex);
+    m_profiles[profile.queryText].merge(profile);
+}
+
+std::vector<QueryProfile> QueryProfiler::profiles() const
+{
+    std::lock_guard lock(m_mutex);
+    std::vector<QueryProfile> result;
+    result.reserve(m_profiles.size());
+    for (const auto &[text, profile] : m_profiles)
+        result.push_back(profile);
+    return result;
+}
+
+void QueryProfiler::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_profiles.clear();
+}
+
+QString QueryProfiler::report() const
+{
+    auto profiles = this->profiles();
+    std::ranges::sort(profiles, std::greater {}, [](const QueryProfile &profile) {
+        return profile.nextMatchTime + profile.predicatesTime;
+    });
+
+    QString result = QString("Query profile - %1 queries\n").arg(profiles.size());
+    for (const auto &profile : profiles) {
+        // The query text is usually long, only keep its beginning as a title
+        auto title = profile.queryText.simplified();
+        if (title.size() > 80)
+            title = title.left(77) + "...";
+        result += QString("\n%1\n%2").arg(title, profile.toString());
+    }
+    return result;
+}
+
+QueryCache &QueryCache::instance()
+{
+    static QueryCache cache;
+    return cache;
+}
+
+std::shared_ptr<Query> QueryCache::get(const TSLanguage *language, const QString &query)
+{
+    std::lock_guard lock(m_mutex);
+
+    Key key {language, query};
+    if (auto it = m_index.find(key); it != m_index.end()) {
+        ++m_statistics.hits;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return it->second->second;
+    }
+
+    ++m_statistics.misses;
+    // May throw, in which case nothing is added to the cache
+    auto result = std::make_shared<Query>(language, query);
+    m_entries.emplace_front(key, result);
+    m_index.emplace(std::move(key), m_entries.begin());
+    trim();
+    return result;
+}
+
+QueryCache::Statistics QueryCache::statistics() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_statistics;
+}
+
+size_t QueryCache::size() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_entries.size();
+}
+
+void QueryCache::setMaximumSize(size_t size)
+{
+    std::lock_guard lock(m_mutex);
+    m_maximumSize = size;
+    trim();
+}
+
+void QueryCache::clear()
+{
+    std::lock_guard lock(m_mutex);
+    m_entries.clear();
+    m_index.clear();
+    m_statistics = {};
+}
+
+void QueryCache::trim()
+{
+    while (m_entries.size() > m_maximumSize) {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+}
+
+
+MultiQuery::MultiQuery(const TSLanguage *language, const QStringList &queries)
+    : m_queryCount(static_cast<int>(queries.size()))
+{
+    // Start of each query in the combined text, in bytes as the pattern positions
+    std::vector<uint32_t> starts;
+    QByteArray text;
+    for (const auto &query : queries) {
+        starts.push_back(static_cast<uint32_t>(text.size()));
+        text += query.toUtf8();
+        text += '\n';
+    }
+    auto queryAt = [&starts](uint32_t offset) {
+        return static_cast<int>(std::ranges::upper_bound(starts, offset) - starts.begin()) - 1;
+    };
+
+    try {
+        m_query = QueryCache::instance().get(language, QString::fromUtf8(text));
+    } catch (Query::Error &error) {
+        const int index = std::max(queryAt(error.utf8_offset), 0);
+        error.utf8_offset -= starts.empty() ? 0 : starts[index];
+        error.description = QString("%1 in query %2").arg(error.description).arg(index);
+        throw;
+    }
+
+    m_patternQueries.reserve(m_query->patterns().size());
+    for (const auto &pattern : m_query->patterns())
+        m_patternQueries.push_back(queryAt(pattern.utf8_start_byte));
+}
+
+const std::shared_ptr<Query> &MultiQuery::query() const
+{
+    return m_query;
+}
+
+int MultiQuery::queryCount() const
+{
+    return m_queryCount;
+}
+
+int MultiQuery::queryIndex(uint32_t patternIndex) const
+{
+    return m_patternQueries.value(patternIndex, -1);
+}
+
 }
@@ -13,9 +13,19 @@
 #include "node.h"
 
 #include <QByteArray>
+#include <QHash>
+#include <QRegularExpression>
 #include <QString>
+#include <QStringList>
 #include <QVector>
+#include <atomic>
 #include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <tree_sitter/api.h>
 
 struct TSLanguage;
@@ -26,6 +36,17 @@ namespace treesitter {
 
 class Node;
 class Predicates;
+class QueryMatch;
+class TreeSnapshot;
+class Utf8Source;
+
+// Hash of a string, so sets of QString can be looked up with a QStringView without creating a string
+struct StringViewHash
+{
+    using is_transparent = void;
+    size_t operator()(QStringView string) const noexcept { return qHash(string); }
+};
+using StringSet = std::unordered_set<QString, StringViewHash, std::equal_to<>>;
 
 class Query
 {
@@ -40,6 +61,17 @@ public:
     {
         QString name;
         QVector<std::variant<Capture, QString>> arguments;
+        // Compiled once when the query is constructed, only used by #match?
+        QRegularExpression regularExpression;
+        // Node types of the string arguments of #not_is?, #exclude! and #eq_except?, resolved once when the query is
+        // constructed. Not set if one of them is a parameter, its value is only known when the query is executed.
+        std::optional<NodeTypes> nodeTypes;
+        // String arguments of the #any_of? family, loaded once when the query is constructed. Without whitespaces for
+        // #like_any_of? and #not_like_any_of?.
+        StringSet strings;
+        // Resolved once when the query is constructed, only one of them is set
+        bool (*filter)(const Predicates &, const QueryMatch &, const Predicate &) = nullptr;
+        void (*command)(const Predicates &, QueryMatch &, const Predicate &) = nullptr;
     };
 
     struct Pattern
@@ -67,16 +99,25 @@ public:
 
     void swap(Query &other) noexcept;
 
-    QVector<Pattern> patterns() const;
+    const QVector<Pattern> &patterns() const;
+    QString text() const;
 
     QVector<Capture> captures() const;
     Capture captureAt(uint32_t index) const;
+    // Names of the captures by index, shared by all the matches of the query
+    const QStringList &captureNames() const;
+    // Returns the index of the capture named `name`, or -1 if the query has no such capture
+    int captureIndex(const QString &name) const;
 
 private:
     QVector<Predicate> predicatesForPattern(uint32_t index) const;
 
     QByteArray m_utf8_text;
     TSQuery *m_query;
+    // Patterns are used for each match by the predicates, so compute them only once
+    QVector<Pattern> m_patterns;
+    QStringList m_captureNames;
+    QHash<QString, int> m_captureIndexes;
 
     friend class QueryCursor;
 };
@@ -110,7 +151,7 @@ public:
     std::shared_ptr<Query> query() const;
 
 private:
-    QueryMatch(const TSQueryMatch &match, std::shared_ptr<Query> query);
+    QueryMatch(const TSQueryMatch &match, std::shared_ptr<Query> query, const Utf8Source *utf8Source);
 
     uint32_t m_id;
     uint16_t m_pattern_index;
@@ -121,6 +162,28 @@ private:
     friend class QueryCursor;
 };
 
+// Statistics of the matches found by a QueryCursor, only collected when profiling
+struct QueryProfile
+{
+    struct PatternStatistics
+    {
+        int rawMatches = 0;
+        int acceptedMatches = 0;
+        // Number of matches rejected by each predicate, the first failing predicate rejects the match
+        std::map<QString, int> rejections;
+    };
+
+    QString queryText;
+    QVector<PatternStatistics> patterns;
+    int executions = 0;
+    // Time spent in tree-sitter to find the matches, and in the predicates to filter them, in nanoseconds
+    qint64 nextMatchTime = 0;
+    qint64 predicatesTime = 0;
+
+    void merge(const QueryProfile &other);
+    QString toString() const;
+};
+
 // TODO: Should this also be a member-class of Query?
 class QueryCursor
 {
@@ -138,7 +201,16 @@ public:
     void swap(QueryCursor &other) noexcept;
 
     void execute(std::shared_ptr<Query> query, const Node &node, std::unique_ptr<Predicates> &&predicates);
+    // Runs the query on the whole snapshot, with the default predicates. The cursor keeps the snapshot alive.
+    void execute(std::shared_ptr<Query> query, std::shared_ptr<const TreeSnapshot> snapshot);
+
+    // Restrict the matches to the given range, either in bytes (the text is UTF-16) or rows/columns.
+    // Tree-sitter returns all the matches intersecting the range, not only the ones contained in it.
+    // The range is kept for the following calls to execute.
+    void setByteRange(uint32_t startByte, uint32_t endByte);
+    void setPointRange(const Point &startPoint, const Point &endPoint);
 
+    // Returns no match once the script is aborted (see Utils::Cancellation)
     std::optional<QueryMatch> nextMatch();
 
     // Get all remaining matches.
@@ -150,16 +222,118 @@ public:
     // It allows the UI to update and remain responsive while the query is running.
     void setProgressCallback(std::function<void()> callback);
 
+    // Collects statistics about the matches in the given profile, which must outlive the cursor executions.
+    // Without profile, statistics are collected in the QueryProfiler when it's enabled.
+    void setProfile(QueryProfile *profile);
+
 private:
+    std::optional<QueryMatch> nextProfiledMatch(QueryProfile &profile);
+    void flushProfile();
+
     // The query must be kept alive for as long as the cursor is alive.
     // Otherwise, no new matches can be returned and the Predicates can't be executed.
     std::shared_ptr<Query> m_query;
     std::function<void()> m_progressCallback;
 
     std::unique_ptr<Predicates> m_predicates;
+    std::shared_ptr<const TreeSnapshot> m_snapshot;
     TSQueryCursor *m_cursor;
+    // Source of the executed node, for trees parsed from UTF-8
+    const Utf8Source *m_utf8Source = nullptr;
+
+    QueryProfile *m_profile = nullptr;
+    // Only used when the QueryProfiler is enabled, and added to it once the cursor is done
+    std::unique_ptr<QueryProfile> m_profilerProfile;
 };
 
 using QueryList = QVector<std::shared_ptr<Query>>;
 
+// Values of the parameters of a query, by name without the `$` prefix. A parameter is a string argument of a
+// predicate starting with `$`, e.g. `(#eq? @name "$name")`: the query is compiled once, whatever the value is.
+using QueryParameters = std::unordered_map<QString, QString>;
+
+// Process-wide cache of compiled queries, as compiling a query is a non-trivial task.
+// Queries are kept by language and query text, the least recently used ones are removed first.
+class QueryCache
+{
+public:
+    struct Statistics
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    static QueryCache &instance();
+
+    // throws a Query::Error if the query is ill-formed, failed queries are not cached.
+    std::shared_ptr<Query> get(const TSLanguage *language, const QString &query);
+
+    Statistics statistics() const;
+    size_t size() const;
+    void setMaximumSize(size_t size);
+    void clear();
+
+private:
+    QueryCache() = default;
+    void trim();
+
+    using Key = std::pair<const TSLanguage *, QString>;
+    using Entry = std::pair<Key, std::shared_ptr<Query>>;
+
+    mutable std::mutex m_mutex;
+    // Most recently used first
+    std::list<Entry> m_entries;
+    std::map<Key, std::list<Entry>::iterator> m_index;
+    size_t m_maximumSize = 256;
+    Statistics m_statistics;
+};
+
+/**
+ * \brief Several queries compiled into one TSQuery, to run them in a single pass of a QueryCursor
+ *
+ * The query texts are concatenated, and each pattern of the combined query is mapped back to the query it comes from,
+ * so the matches can be dispatched by their pattern index. The combined query is shared through the QueryCache.
+ */
+class MultiQuery
+{
+public:
+    // throws a Query::Error if one of the queries is ill-formed, the offset is relative to the faulty query.
+    MultiQuery(const TSLanguage *language, const QStringList &queries);
+
+    const std::shared_ptr<Query> &query() const;
+    int queryCount() const;
+    // Index in `queries` of the query the pattern comes from
+    int queryIndex(uint32_t patternIndex) const;
+
+private:
+    std::shared_ptr<Query> m_query;
+    // Query index of each pattern of the combined query
+    QVector<int> m_patternQueries;
+    int m_queryCount = 0;
+};
+
+// Process-wide query profiles, merged by query text. It's disabled by default, as profiling slows down queries.
+class QueryProfiler
+{
+public:
+    static QueryProfiler &instance();
+
+    static bool isEnabled();
+    void setEnabled(bool enabled);
+
+    void add(const QueryProfile &profile);
+    std::vector<QueryProfile> profiles() const;
+    void clear();
+
+    // Human readable report of all profiles, the slowest queries first
+    QString report() const;
+
+private:
+    QueryProfiler() = default;
+
+    static std::atomic<bool> m_enabled;
+    mutable std::mutex m_mutex;
+    std::map<QString, QueryProfile> m_profiles;
+};
+
 }
@@ -11,8 +11,10 @@
 #include "transformation.h"
 #include "predicates.h"
 #include "tree.h"
+#include "utils/cancellation.h"
 
 #include <QObject>
+#include <algorithm>
 #include <utility>
 
 namespace treesitter {
@@ -26,69 +28,178 @@ Transformation::Transformation(QString source, Parser &&parser, std::shared_ptr<
 {
 }
 
+Transformation::~Transformation()
+{
+    ParserPool::release(std::move(m_parser));
+}
+
+static Point pointAfter(const Point &start, QStringView text)
+{
+    const auto lines = text.count(u'\n');
+    if (lines == 0) {
+        return Point {.row = start.row, .column = start.column + static_cast<uint32_t>(text.size() * sizeof(QChar))};
+    }
+
+    const auto lastLineLength = text.size() - text.lastIndexOf(u'\n') - 1;
+    return Point {.row = start.row + static_cast<uint32_t>(lines),
+                  .column = static_cast<uint32_t>(lastLineLength * sizeof(QChar))};
+}
+
+bool Transformation::isCanceled() const
+{
+    return (m_canceled && *m_canceled) || Utils::Cancellation::isCanceled();
+}
+
 QString Transformation::run()
 {
     auto resultText = m_source;
 
     m_replacements = 0;
+    m_changes.clear();
 
-    QueryCursor cursor;
-    bool shouldContinue;
-    do {
-        const auto tree = m_parser.parseString(resultText);
+    auto tree = m_parser.parseString(resultText);
+    for (int pass = 0;; ++pass) {
         if (!tree.has_value()) {
+            if (isCanceled())
+                throw Error {.description = QObject::tr("Transformation canceled")};
             throw Error {.description = "Unknown parser error!"};
         }
+        if (pass >= m_max_passes) {
+            throw Error {.description = QObject::tr("Maximum number of allowed transformations reached.\nPossibly "
+                                                    "your transformation is recursive?")};
+        }
+
+        QueryCursor cursor;
         cursor.execute(m_query, tree->rootNode(), std::make_unique<Predicates>(resultText));
 
-        shouldContinue = runOneTransformation(cursor, resultText);
-    } while (shouldContinue);
+        const auto replacements = collectReplacements(cursor, resultText);
+        if (replacements.empty())
+            break;
+
+        // Apply the replacements back to front, so the positions of the remaining ones stay valid.
+        // The tree is edited alongside, so it can be reparsed incrementally if needed.
+        for (auto it = replacements.crbegin(); it != replacements.crend(); ++it) {
+            TSInputEdit edit;
+            edit.start_byte = static_cast<uint32_t>(it->start * sizeof(QChar));
+            edit.old_end_byte = static_cast<uint32_t>(it->end * sizeof(QChar));
+            edit.new_end_byte = static_cast<uint32_t>((it->start + it->text.size()) * sizeof(QChar));
+            edit.start_point = it->startPoint;
+            edit.old_end_point = it->endPoint;
+            edit.new_end_point = pointAfter(it->startPoint, it->text);
+            tree->edit(edit);
+
+            resultText.replace(it->start, it->end - it->start, it->text);
+        }
+        m_replacements += static_cast<int>(replacements.size());
+        addChanges(replacements);
+
+        // Matches nested inside a replaced node were skipped, and the replacements may create new matches: passes go
+        // on until there's no @from match left in the new text.
+        tree = m_parser.parseString(resultText, &tree.value());
+    }
 
     return resultText;
 }
 
-bool Transformation::runOneTransformation(QueryCursor &cursor, QString &resultText)
+std::vector<Transformation::Replacement> Transformation::collectReplacements(QueryCursor &cursor, const QString &text)
 {
+    std::vector<Replacement> replacements;
     std::unordered_map<QString, QString> context;
 
     bool hasMatch = false;
     // We want to allow multiple patterns, where not every pattern
     // has a @from capture, but can provide additional context.
-    // Loop over them until we find a @from capture.
+    // Every match with a @from capture uses the context collected since the previous one.
     while (auto match = cursor.nextMatch()) {
+        if (isCanceled())
+            throw Error {.description = QObject::tr("Transformation canceled")};
         hasMatch = true;
         const auto captures = match->captures();
         for (const auto &capture : captures) {
             auto captureName = m_query->captureAt(capture.id).name;
-            context[captureName] = capture.node.textIn(resultText);
+            context[captureName] = capture.node.textIn(text);
         }
 
         const auto from = match->capturesNamed("from");
         if (!from.isEmpty()) {
-            const auto fromStart = from.first().node.startPosition();
-            const auto fromEnd = from.first().node.endPosition();
+            const auto &node = from.first().node;
 
             QString after = m_to;
             for (const auto &[name, value] : context) {
                 after.replace("@" + name, value);
             }
 
-            resultText.replace(fromStart, fromEnd - fromStart, after);
-            if (++m_replacements >= m_max_replacements) {
-                throw Error {.description = QObject::tr("Maximum number of allowed transformations reached.\nPossibly "
-                                                        "your transformation is recursive?")};
-            }
+            replacements.push_back(Replacement {.start = node.startPosition(),
+                                                .end = node.endPosition(),
+                                                .startPoint = node.startPoint(),
+                                                .endPoint = node.endPoint(),
+                                                .text = std::move(after)});
             context = std::unordered_map<QString, QString>();
-            return true;
+            if (m_progressCallback)
+                m_progressCallback(m_replacements + static_cast<int>(replacements.size()));
         }
     }
+    // The cursor stops on an abort, the matches found are not all the matches
+    if (isCanceled())
+        throw Error {.description = QObject::tr("Transformation canceled")};
 
-    if (hasMatch && m_replacements == 0) {
+    if (hasMatch && replacements.empty() && m_replacements == 0) {
         // We found at least one match, but no @from capture and didn't make any replacements before.
         throw Error {.description = QObject::tr("'@from' capture not found!")};
     }
 
-    return false;
+    // Keep the outermost of overlapping matches, the nested ones are handled in the next pass.
+    std::ranges::stable_sort(replacements, [](const Replacement &lhs, const Replacement &rhs) {
+        return lhs.start < rhs.start || (lhs.start == rhs.start && lhs.end > rhs.end);
+    });
+    std::vector<Replacement> result;
+    result.reserve(replacements.size());
+    for (auto &replacement : replacements) {
+        if (!result.empty() && replacement.start < result.back().end)
+            continue;
+        result.push_back(std::move(replacement));
+    }
+    return result;
+}
+
+void Transformation::addChanges(const std::vector<Replacement> &replacements)
+{
+    // Both the previous changes and the replacements are ordered by position in the text before this pass.
+    // Overlapping or adjacent ones are merged into a single change.
+    std::vector<Change> changes;
+    changes.reserve(m_changes.size() + replacements.size());
+    // Length difference between the text before this pass and the source, up to the current position
+    int delta = 0;
+    // Length difference between the text after this pass and the one before, up to the current position
+    int shift = 0;
+
+    auto change = m_changes.cbegin();
+    auto replacement = replacements.cbegin();
+    while (change != m_changes.cend() || replacement != replacements.cend()) {
+        const bool changeFirst = replacement == replacements.cend()
+            || (change != m_changes.cend() && change->resultStart < static_cast<int>(replacement->start));
+        const int start = changeFirst ? change->resultStart : static_cast<int>(replacement->start);
+        int end = start;
+        const int startDelta = delta;
+        const int startShift = shift;
+
+        while (true) {
+            if (change != m_changes.cend() && change->resultStart <= end) {
+                end = std::max(end, change->resultEnd);
+                delta += (change->resultEnd - change->resultStart) - (change->sourceEnd - change->sourceStart);
+                ++change;
+            } else if (replacement != replacements.cend() && static_cast<int>(replacement->start) <= end) {
+                end = std::max(end, static_cast<int>(replacement->end));
+                const auto length = static_cast<int>(replacement->end - replacement->start);
+                shift += static_cast<int>(replacement->text.size()) - length;
+                ++replacement;
+            } else {
+                break;
+            }
+        }
+        changes.push_back({start - startDelta, end - delta, start + startShift, end + shift});
+    }
+    m_changes = std::move(changes);
 }
 
 } // namespace treesitter
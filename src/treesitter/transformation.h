@@ -15,6 +15,10 @@
 
 #include <QString>
 
+#include <atomic>
+#include <functional>
+#include <vector>
+
 namespace treesitter {
 
 class Transformation
@@ -24,26 +28,64 @@ public:
     {
         QString description;
     };
+    // Range of text changed by the transformation, in the source and in the result
+    struct Change
+    {
+        int sourceStart;
+        int sourceEnd;
+        int resultStart;
+        int resultEnd;
+    };
 
+    // The parser is given back to the ParserPool once the transformation is destroyed
     Transformation(QString source, Parser &&parser, std::shared_ptr<Query> query, QString transformationTarget);
+    ~Transformation();
 
     // Throws a Transformation::Error on failure
     QString run();
 
     int replacementsMade() const { return m_replacements; }
+    // Changes made by the last run, ordered by position and not overlapping
+    const std::vector<Change> &changes() const { return m_changes; }
+
+    // The callback is called with the number of replacements found so far, from the thread running the
+    // transformation
+    void setProgressCallback(std::function<void(int)> callback) { m_progressCallback = std::move(callback); }
+    // The transformation stops with an Error once the flag is set, or the script is aborted (see Utils::Cancellation).
+    // The flag must outlive the transformation.
+    void setCancellationFlag(const std::atomic<bool> *flag) { m_canceled = flag; }
 
 private:
-    bool runOneTransformation(QueryCursor &cursor, QString &resultText);
+    struct Replacement
+    {
+        uint32_t start;
+        uint32_t end;
+        Point startPoint;
+        Point endPoint;
+        QString text;
+    };
+
+    // Collects the replacements of all non-overlapping @from matches, ordered by position.
+    // Matches inside another replacement are skipped, the next pass handles them.
+    std::vector<Replacement> collectReplacements(QueryCursor &cursor, const QString &text);
+    // Adds the replacements of one pass to the changes made by the previous passes
+    void addChanges(const std::vector<Replacement> &replacements);
+    bool isCanceled() const;
 
     QString m_source;
     Parser m_parser;
     std::shared_ptr<Query> m_query;
     QString m_to;
 
-    // After reaching max_replacements, stop the transformation.
+    // All non-overlapping matches are replaced in a single pass, nested matches and the matches created by the
+    // replacements need another pass. After reaching max_passes, stop the transformation.
     // This likely means the transformation is recursive and will never finish.
-    int m_max_replacements = 100;
+    int m_max_passes = 100;
     int m_replacements = 0;
+    std::vector<Change> m_changes;
+
+    std::function<void(int)> m_progressCallback;
+    const std::atomic<bool> *m_canceled = nullptr;
 };
 
 }
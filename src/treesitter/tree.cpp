@@ -9,19 +9,24 @@
 */
 
 #include "tree.h"
+#include "utf8source.h"
 
+#include <QChar>
+#include <cstdlib>
 #include <tree_sitter/api.h>
 #include <utility>
 
 namespace treesitter {
 
-Tree::Tree(TSTree *tree)
+Tree::Tree(TSTree *tree, std::shared_ptr<const Utf8Source> utf8Source)
     : m_tree(tree)
+    , m_utf8Source(std::move(utf8Source))
 {
 }
 
 Tree::Tree(Tree &&other) noexcept
     : m_tree(other.m_tree)
+    , m_utf8Source(std::move(other.m_utf8Source))
 {
     other.m_tree = nullptr;
 }
@@ -42,11 +47,78 @@ Tree &Tree::operator=(Tree &&other) noexcept
 void Tree::swap(Tree &other) noexcept
 {
     std::swap(m_tree, other.m_tree);
+    std::swap(m_utf8Source, other.m_utf8Source);
+}
+
+Tree Tree::copy() const
+{
+    return Tree(ts_tree_copy(m_tree), m_utf8Source);
 }
 
 Node Tree::rootNode() const
 {
-    return Node(ts_tree_root_node(m_tree));
+    return Node(ts_tree_root_node(m_tree), m_utf8Source.get());
+}
+
+void Tree::edit(const TSInputEdit &edit)
+{
+    ts_tree_edit(m_tree, &edit);
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> Tree::changedRanges(const Tree &newTree) const
+{
+    uint32_t count = 0;
+    TSRange *ranges = ts_tree_get_changed_ranges(m_tree, newTree.m_tree, &count);
+
+    std::vector<std::pair<uint32_t, uint32_t>> result;
+    result.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+        result.emplace_back(ranges[i].start_byte / sizeof(QChar), ranges[i].end_byte / sizeof(QChar));
+    // Allocated by tree-sitter, to be freed by the caller
+    free(ranges);
+    return result;
+}
+
+size_t Tree::nodeCount() const
+{
+    TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(m_tree));
+    size_t count = 1;
+    // Depth-first walk: down to the first child, else to the next sibling of the node or of one of its parents
+    while (true) {
+        if (ts_tree_cursor_goto_first_child(&cursor) || ts_tree_cursor_goto_next_sibling(&cursor)) {
+            ++count;
+            continue;
+        }
+        bool found = false;
+        while (!found && ts_tree_cursor_goto_parent(&cursor))
+            found = ts_tree_cursor_goto_next_sibling(&cursor);
+        if (!found)
+            break;
+        ++count;
+    }
+    ts_tree_cursor_delete(&cursor);
+    return count;
+}
+
+TreeSnapshot::TreeSnapshot(const Tree &tree, QString source)
+    : m_tree(tree.copy())
+    , m_source(std::move(source))
+{
+}
+
+Node TreeSnapshot::rootNode() const
+{
+    return m_tree.rootNode();
+}
+
+const QString &TreeSnapshot::source() const
+{
+    return m_source;
+}
+
+std::shared_ptr<const TreeSnapshot> TreeSnapshot::copy() const
+{
+    return std::make_shared<const TreeSnapshot>(m_tree, m_source);
 }
 
 }
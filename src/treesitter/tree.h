@@ -12,11 +12,17 @@
 
 #include "node.h"
 
+#include <QString>
+#include <memory>
+#include <utility>
+#include <vector>
+
 struct TSTree;
 
 namespace treesitter {
 
 class Parser;
+class Utf8Source;
 
 class Tree
 {
@@ -29,19 +35,53 @@ public:
 
     ~Tree();
 
+    // Returns a shallow copy of the tree, cheap to create. Trees are not thread-safe: each thread needs its own copy.
+    Tree copy() const;
+
     Node rootNode() const;
 
+    // Adjusts the tree to a change of the source text, so it can be passed as the old tree to
+    // Parser::parseString for an incremental reparse.
+    // The edit is in bytes of the UTF-16 text: trees parsed from UTF-8 are not meant to be edited.
+    // Note: Existing nodes of this tree are not updated and must not be used anymore afterwards.
+    void edit(const TSInputEdit &edit);
+
+    // Returns the ranges, in characters, whose syntactic structure differs between this edited tree and `newTree`,
+    // reparsed from it. Like edit, it's only meant for trees parsed from UTF-16.
+    std::vector<std::pair<uint32_t, uint32_t>> changedRanges(const Tree &newTree) const;
+
+    // Number of nodes of the tree, named or not. It visits the whole tree.
+    size_t nodeCount() const;
+
     void swap(Tree &other) noexcept;
 
 private:
-    Tree(TSTree *tree);
+    Tree(TSTree *tree, std::shared_ptr<const Utf8Source> utf8Source = {});
 
     TSTree *m_tree;
+    // Converts the byte offsets of the nodes into positions, for trees parsed from UTF-8
+    std::shared_ptr<const Utf8Source> m_utf8Source;
 
     friend class Parser;
+};
 
-    // TODO: Once update is implemented, store weak pointers to all
-    // TSNodes so that they may be updated as well.
+// Read-only copy of a syntax tree and of the text it was parsed from.
+// It's not affected by changes to the original tree, so it can be queried on another thread while the document is
+// edited. A snapshot must only be used by one thread at a time, take a new one for each thread.
+class TreeSnapshot
+{
+public:
+    TreeSnapshot(const Tree &tree, QString source);
+
+    Node rootNode() const;
+    const QString &source() const;
+
+    // New snapshot of the same tree and text, to use it on another thread
+    std::shared_ptr<const TreeSnapshot> copy() const;
+
+private:
+    const Tree m_tree;
+    const QString m_source;
 };
 
 }
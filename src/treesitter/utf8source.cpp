@@ -0,0 +1,70 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "utf8source.h"
+
+#include <algorithm>
+
+namespace treesitter {
+
+Utf8Source::Utf8Source(QStringView text)
+{
+    // The text is encoded here instead of using QString::toUtf8, so the offsets always match the bytes, even for
+    // invalid surrogates
+    m_bytes.reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        char32_t ch = text[i].unicode();
+        if (ch < 0x80) {
+            m_bytes.append(static_cast<char>(ch));
+            continue;
+        }
+
+        if (QChar::isHighSurrogate(ch) && i + 1 < text.size() && text[i + 1].isLowSurrogate()) {
+            ch = QChar::surrogateToUcs4(text[i].unicode(), text[i + 1].unicode());
+            ++i;
+        } else if (QChar::isSurrogate(ch)) {
+            ch = QChar::ReplacementCharacter;
+        }
+
+        if (ch < 0x800) {
+            m_bytes.append(static_cast<char>(0xc0 | (ch >> 6)));
+        } else if (ch < 0x10000) {
+            m_bytes.append(static_cast<char>(0xe0 | (ch >> 12)));
+            m_bytes.append(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        } else {
+            m_bytes.append(static_cast<char>(0xf0 | (ch >> 18)));
+            m_bytes.append(static_cast<char>(0x80 | ((ch >> 12) & 0x3f)));
+            m_bytes.append(static_cast<char>(0x80 | ((ch >> 6) & 0x3f)));
+        }
+        m_bytes.append(static_cast<char>(0x80 | (ch & 0x3f)));
+        m_offsets.push_back({.byte = static_cast<uint32_t>(m_bytes.size()), .position = static_cast<uint32_t>(i + 1)});
+    }
+}
+
+uint32_t Utf8Source::toPosition(uint32_t byte) const
+{
+    // Between two non-ASCII characters, one byte is one character
+    auto it = std::ranges::upper_bound(m_offsets, byte, {}, &Offset::byte);
+    if (it == m_offsets.begin())
+        return byte;
+    --it;
+    return it->position + (byte - it->byte);
+}
+
+uint32_t Utf8Source::toByte(uint32_t position) const
+{
+    auto it = std::ranges::upper_bound(m_offsets, position, {}, &Offset::position);
+    if (it == m_offsets.begin())
+        return position;
+    --it;
+    return it->byte + (position - it->position);
+}
+
+}
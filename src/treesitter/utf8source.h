@@ -0,0 +1,47 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+namespace treesitter {
+
+// UTF-8 copy of a text, to parse it with half the input size of UTF-16 when it's mostly ASCII.
+// It also maps the UTF-8 byte offsets found in the tree back to character positions in the original text.
+// Only the positions after non-ASCII characters are stored, so the map is empty for an ASCII text.
+class Utf8Source
+{
+public:
+    explicit Utf8Source(QStringView text);
+
+    const QByteArray &bytes() const { return m_bytes; }
+    bool isAscii() const { return m_offsets.empty(); }
+
+    // Converts a byte offset in the UTF-8 text to a character position in the original text, and back
+    uint32_t toPosition(uint32_t byte) const;
+    uint32_t toByte(uint32_t position) const;
+
+private:
+    struct Offset
+    {
+        uint32_t byte;
+        uint32_t position;
+    };
+
+    QByteArray m_bytes;
+    // Offsets right after each non-ASCII character, sorted by byte and position
+    std::vector<Offset> m_offsets;
+};
+
+}
@@ -0,0 +1,239 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "allocstats.h"
+
+#include <algorithm>
+
+#ifdef KNUT_ALLOC_STATS
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string_view>
+
+// Regions nested deeper are not recorded, so entering a region never allocates
+static constexpr int MaxDepth = 64;
+
+namespace {
+
+struct Frame
+{
+    const char *name;
+    qint64 allocations;
+    qint64 bytes;
+    qint64 childAllocations;
+    qint64 childBytes;
+};
+
+// Plain data only: it's used by operator new, even while the thread is starting or exiting
+struct ThreadState
+{
+    qint64 allocations;
+    qint64 bytes;
+    int depth;
+    // Set while recording a region, so the allocations of the report itself are not counted
+    bool recording;
+    std::array<Frame, MaxDepth> frames;
+};
+
+}
+
+static thread_local ThreadState threadState = {};
+static std::atomic<qint64> processAllocations = 0;
+static std::atomic<qint64> processBytes = 0;
+
+using RegionMap = std::map<std::string_view, Utils::AllocStats::Region, std::less<>>;
+
+static std::mutex &regionMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static RegionMap &regionMap()
+{
+    static RegionMap map;
+    return map;
+}
+
+static void countAllocation(std::size_t size)
+{
+    auto &state = threadState;
+    if (state.recording)
+        return;
+    ++state.allocations;
+    state.bytes += static_cast<qint64>(size);
+    processAllocations.fetch_add(1, std::memory_order_relaxed);
+    processBytes.fetch_add(static_cast<qint64>(size), std::memory_order_relaxed);
+}
+
+static void *allocate(std::size_t size)
+{
+    countAllocation(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new(std::size_t size)
+{
+    if (void *pointer = allocate(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    if (void *pointer = allocate(size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+namespace Utils {
+
+#ifdef KNUT_ALLOC_STATS
+void AllocStats::enter(const char *name)
+{
+    auto &state = threadState;
+    if (state.depth < MaxDepth)
+        state.frames[state.depth] = {name, state.allocations, state.bytes, 0, 0};
+    ++state.depth;
+}
+
+void AllocStats::leave()
+{
+    auto &state = threadState;
+    if (state.depth == 0)
+        return;
+    --state.depth;
+    if (state.depth >= MaxDepth)
+        return;
+
+    const auto &frame = state.frames[state.depth];
+    const Counts total {state.allocations - frame.allocations, state.bytes - frame.bytes};
+    const Counts self {total.allocations - frame.childAllocations, total.bytes - frame.childBytes};
+    if (state.depth > 0) {
+        auto &parent = state.frames[state.depth - 1];
+        parent.childAllocations += total.allocations;
+        parent.childBytes += total.bytes;
+    }
+
+    state.recording = true;
+    {
+        std::lock_guard lock(regionMutex());
+        auto &region = regionMap()[frame.name];
+        if (region.name.isEmpty())
+            region.name = QString::fromLatin1(frame.name);
+        ++region.calls;
+        region.total.allocations += total.allocations;
+        region.total.bytes += total.bytes;
+        region.self.allocations += self.allocations;
+        region.self.bytes += self.bytes;
+    }
+    state.recording = false;
+}
+
+AllocStats::Counts AllocStats::processCounts()
+{
+    return {processAllocations.load(std::memory_order_relaxed), processBytes.load(std::memory_order_relaxed)};
+}
+#endif
+
+std::vector<AllocStats::Region> AllocStats::regions()
+{
+    std::vector<Region> result;
+#ifdef KNUT_ALLOC_STATS
+    {
+        std::lock_guard lock(regionMutex());
+        for (const auto &[name, region] : regionMap())
+            result.push_back(region);
+    }
+#endif
+    std::ranges::sort(result, [](const Region &lhs, const Region &rhs) {
+        return lhs.total.allocations > rhs.total.allocations;
+    });
+    return result;
+}
+
+void AllocStats::reset()
+{
+#ifdef KNUT_ALLOC_STATS
+    std::lock_guard lock(regionMutex());
+    regionMap().clear();
+#endif
+}
+
+QString AllocStats::report()
+{
+    if (!isEnabled())
+        return "Allocation statistics are not available, build knut with -DKNUT_ALLOC_STATS=ON\n";
+
+    QString text = QString("%1 %2 %3 %4 %5 %6\n")
+                       .arg("Region", -40)
+                       .arg("Calls", 10)
+                       .arg("Allocations", 14)
+                       .arg("Bytes", 14)
+                       .arg("Self allocs", 14)
+                       .arg("Self bytes", 14);
+    for (const auto &region : regions()) {
+        text += QString("%1 %2 %3 %4 %5 %6\n")
+                    .arg(region.name, -40)
+                    .arg(region.calls, 10)
+                    .arg(region.total.allocations, 14)
+                    .arg(region.total.bytes, 14)
+                    .arg(region.self.allocations, 14)
+                    .arg(region.self.bytes, 14);
+    }
+    return text;
+}
+
+} // namespace Utils
@@ -0,0 +1,63 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+namespace Utils {
+
+/**
+ * \brief Number of allocations and allocated bytes of each traced region
+ *
+ * Only available when knut is built with the `KNUT_ALLOC_STATS` CMake option: the global operator new is then replaced
+ * to count the allocations, and each TRACE span is also an allocation region, whether KNUT_TRACE is set or not. An
+ * allocation is counted in the `total` of all the regions of the current thread, and in the `self` of the innermost
+ * one. Without the option, all the functions are empty and the global operator new is not replaced.
+ */
+class AllocStats
+{
+public:
+    struct Counts
+    {
+        qint64 allocations = 0;
+        qint64 bytes = 0;
+    };
+    struct Region
+    {
+        QString name;
+        qint64 calls = 0;
+        Counts total;
+        Counts self;
+    };
+
+#ifdef KNUT_ALLOC_STATS
+    static constexpr bool isEnabled() { return true; }
+    static void enter(const char *name);
+    static void leave();
+    // Allocations of the whole process, in or out of a region
+    static Counts processCounts();
+#else
+    static constexpr bool isEnabled() { return false; }
+    static void enter(const char *) { }
+    static void leave() { }
+    static Counts processCounts() { return {}; }
+#endif
+
+    // Regions of all threads merged by name, the ones with the most allocations first
+    static std::vector<Region> regions();
+    static void reset();
+    // Human readable report of the regions
+    static QString report();
+};
+
+} // namespace Utils
@@ -0,0 +1,71 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "cancellation.h"
+
+#include <QEventLoop>
+#include <QTimer>
+
+namespace Utils {
+
+// How often a blocked wait checks the cancellation, in milliseconds
+static constexpr int PollInterval = 10;
+
+static std::atomic<size_t> canceled = 0;
+
+static std::function<void()> &pollCallback()
+{
+    static std::function<void()> callback;
+    return callback;
+}
+
+void Cancellation::cancel()
+{
+    canceled.store(1, std::memory_order_relaxed);
+}
+
+void Cancellation::reset()
+{
+    canceled.store(0, std::memory_order_relaxed);
+}
+
+bool Cancellation::isCanceled()
+{
+    return canceled.load(std::memory_order_relaxed) != 0;
+}
+
+const std::atomic<size_t> *Cancellation::flag()
+{
+    return &canceled;
+}
+
+void Cancellation::setPollCallback(std::function<void()> callback)
+{
+    pollCallback() = std::move(callback);
+}
+
+void Cancellation::poll()
+{
+    if (pollCallback())
+        pollCallback()();
+}
+
+void Cancellation::quitOnCancel(QEventLoop &loop)
+{
+    auto timer = new QTimer(&loop);
+    QObject::connect(timer, &QTimer::timeout, &loop, [&loop]() {
+        poll();
+        if (isCanceled())
+            loop.quit();
+    });
+    timer->start(PollInterval);
+}
+
+} // namespace Utils
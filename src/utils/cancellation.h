@@ -0,0 +1,44 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+class QEventLoop;
+
+namespace Utils {
+
+/**
+ * \brief Cooperative cancellation of the long operations of the running script
+ *
+ * Aborting a script sets a flag checked by the long operations, on any thread: the query cursors stop producing
+ * matches, the parsers stop parsing (see treesitter::Parser::setCancellationFlag), the RC parser stops reading and
+ * the LSP requests stop waiting for their response. The flag stays set until the script is done.
+ */
+class Cancellation
+{
+public:
+    static void cancel();
+    static void reset();
+    static bool isCanceled();
+    // The flag as tree-sitter reads it, non-zero once canceled
+    static const std::atomic<size_t> *flag();
+
+    // Called regularly while blocked waiting, so the user can still abort the script meanwhile
+    static void setPollCallback(std::function<void()> callback);
+    static void poll();
+    // Quits the loop if the operation is canceled while it runs
+    static void quitOnCancel(QEventLoop &loop);
+};
+
+} // namespace Utils
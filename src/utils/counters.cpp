@@ -0,0 +1,32 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "counters.h"
+
+namespace Utils {
+
+const char *Counters::name(Counter counter)
+{
+    static constexpr std::array<const char *, CounterCount> names = {
+        "fullParses",      "incrementalParses", "queriesExecuted",     "matchesProduced",
+        "matchesFiltered", "rangeMarksAlive",   "documentsOpened",     "documentsPrefetched",
+        "bytesRead",       "bytesWritten",      "queryCacheHits",      "queryCacheMisses"};
+    return names[counter];
+}
+
+void Counters::reset()
+{
+    for (int i = 0; i < CounterCount; ++i) {
+        if (i != RangeMarksAlive)
+            m_values[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace Utils
@@ -0,0 +1,59 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+
+namespace Utils {
+
+/**
+ * \brief Process-wide cumulative counters of the work done by knut
+ *
+ * Always enabled: a counter is a relaxed atomic increment, cheap enough for the hot paths (parses, query matches...).
+ * They are read with `Project.stats()`, shown in the Runtime Statistics panel and printed by `knut --stats`.
+ */
+class Counters
+{
+public:
+    enum Counter {
+        FullParses,
+        IncrementalParses,
+        QueriesExecuted,
+        MatchesProduced,
+        MatchesFiltered,
+        RangeMarksAlive,
+        DocumentsOpened,
+        DocumentsPrefetched,
+        BytesRead,
+        BytesWritten,
+        QueryCacheHits,
+        QueryCacheMisses,
+        CounterCount,
+    };
+
+    static void add(Counter counter, qint64 value = 1)
+    {
+        m_values[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+    static qint64 value(Counter counter) { return m_values[counter].load(std::memory_order_relaxed); }
+    // Name of the counter in the stats, in camelCase
+    static const char *name(Counter counter);
+
+    // Resets all counters but the gauges (RangeMarksAlive), which would become negative
+    static void reset();
+
+private:
+    inline static std::array<std::atomic<qint64>, CounterCount> m_values = {};
+};
+
+} // namespace Utils
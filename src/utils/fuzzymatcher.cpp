@@ -0,0 +1,180 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "fuzzymatcher.h"
+
+#include <QStringList>
+#include <algorithm>
+#include <numeric>
+
+namespace Utils {
+
+static constexpr int MatchScore = 16;
+static constexpr int ConsecutiveBonus = 24;
+static constexpr int WordStartBonus = 20;
+static constexpr int TextStartBonus = 12;
+static constexpr int MaxGapPenalty = 8;
+// Added to the score of the matches in the file name, so they always come before the matches in the path only
+static constexpr int NameBonus = 1 << 16;
+
+static QString caseFolded(const QString &text)
+{
+    QString result = text;
+    for (auto &ch : result)
+        ch = ch.toCaseFolded();
+    return result;
+}
+
+// Each character sets one bit, a file can only match if it has all the bits of the pattern
+static quint64 characterMask(QStringView foldedText)
+{
+    quint64 mask = 0;
+    for (const auto ch : foldedText)
+        mask |= quint64(1) << (ch.unicode() % 64);
+    return mask;
+}
+
+static bool isWordStart(QStringView text, qsizetype position)
+{
+    if (position == 0)
+        return true;
+    const QChar previous = text.at(position - 1);
+    const QChar current = text.at(position);
+    if (!previous.isLetterOrNumber())
+        return current.isLetterOrNumber();
+    // camelCase or digits after letters
+    return (previous.isLower() && current.isUpper()) || (previous.isLetter() && current.isDigit());
+}
+
+FuzzyMatcher::FuzzyMatcher(int maxResults)
+    : m_maxResults(maxResults)
+{
+}
+
+void FuzzyMatcher::setFiles(const QStringList &names, const QStringList &paths)
+{
+    Q_ASSERT(names.size() == paths.size());
+
+    m_files.clear();
+    m_files.reserve(names.size());
+    for (qsizetype i = 0; i < names.size(); ++i) {
+        File file {names.at(i), paths.at(i), caseFolded(names.at(i)), caseFolded(paths.at(i))};
+        // The path contains the name, its mask is enough
+        file.mask = characterMask(file.foldedPath) | characterMask(file.foldedName);
+        m_files.push_back(std::move(file));
+    }
+
+    m_pattern.clear();
+    m_candidates.clear();
+    m_results.clear();
+}
+
+const std::vector<int> &FuzzyMatcher::match(const QString &pattern)
+{
+    QString folded = caseFolded(pattern);
+    folded.remove(u' ');
+
+    if (folded.isEmpty()) {
+        m_pattern.clear();
+        m_candidates.clear();
+        m_results.resize(std::min(static_cast<int>(m_files.size()), m_maxResults));
+        std::iota(m_results.begin(), m_results.end(), 0);
+        return m_results;
+    }
+
+    // A file matching the new pattern also matches the previous one, if the new pattern extends it
+    const bool narrow = !m_pattern.isEmpty() && folded.startsWith(m_pattern);
+    std::vector<int> candidates;
+    if (!narrow) {
+        candidates.resize(m_files.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+    } else {
+        candidates = std::move(m_candidates);
+    }
+
+    const quint64 mask = characterMask(folded);
+    std::vector<std::pair<int, int>> scores;
+    m_candidates.clear();
+    for (const int index : candidates) {
+        const auto &file = m_files[index];
+        if ((file.mask & mask) != mask)
+            continue;
+        const int fileScore = score(folded, file);
+        if (fileScore < 0)
+            continue;
+        m_candidates.push_back(index);
+        scores.emplace_back(fileScore, index);
+    }
+    m_pattern = folded;
+
+    // Best score first, then the shortest name, then the original order
+    auto byScore = [this](const auto &left, const auto &right) {
+        if (left.first != right.first)
+            return left.first > right.first;
+        const auto leftSize = m_files[left.second].name.size();
+        const auto rightSize = m_files[right.second].name.size();
+        if (leftSize != rightSize)
+            return leftSize < rightSize;
+        return left.second < right.second;
+    };
+    const auto count = std::min(static_cast<int>(scores.size()), m_maxResults);
+    std::partial_sort(scores.begin(), scores.begin() + count, scores.end(), byScore);
+
+    m_results.resize(count);
+    for (int i = 0; i < count; ++i)
+        m_results[i] = scores[i].second;
+    return m_results;
+}
+
+int FuzzyMatcher::score(QStringView pattern, const File &file) const
+{
+    const int nameScore = score(pattern, file.name, file.foldedName);
+    if (nameScore >= 0)
+        return nameScore + NameBonus;
+    return score(pattern, file.path, file.foldedPath);
+}
+
+int FuzzyMatcher::score(QStringView pattern, QStringView text, QStringView foldedText)
+{
+    if (pattern.isEmpty())
+        return 0;
+
+    // Each occurrence of the first character is tried as a start, the rest of the pattern is matched greedily
+    int best = -1;
+    for (qsizetype start = foldedText.indexOf(pattern.front()); start != -1;
+         start = foldedText.indexOf(pattern.front(), start + 1)) {
+        int result = 0;
+        qsizetype matched = 0;
+        qsizetype previous = -1;
+        for (qsizetype i = start; i < foldedText.size() && matched < pattern.size(); ++i) {
+            if (foldedText.at(i) != pattern.at(matched))
+                continue;
+            result += MatchScore;
+            if (previous != -1 && previous == i - 1)
+                result += ConsecutiveBonus;
+            else if (previous != -1)
+                result -= static_cast<int>(std::min<qsizetype>(i - previous - 1, MaxGapPenalty));
+            if (isWordStart(text, i))
+                result += WordStartBonus;
+            if (i == 0)
+                result += TextStartBonus;
+            previous = i;
+            ++matched;
+        }
+        // If the pattern can't be matched from here, it can't be matched from a later start either
+        if (matched < pattern.size())
+            break;
+        // The gaps penalties can't make a match worse than no match at all
+        best = std::max(best, std::max(result, 0));
+    }
+    return best;
+}
+
+} // namespace Utils
@@ -0,0 +1,66 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+#include <QStringView>
+#include <vector>
+
+namespace Utils {
+
+/**
+ * \brief Finds the best fuzzy matches of a pattern in a list of files
+ *
+ * A file matches if the pattern is a subsequence of its name or, failing that, of its path, ignoring the case. Matches
+ * are scored like most editors do: consecutive characters and characters starting a word score higher, gaps are
+ * penalized, and matches in the name always win over matches in the path.
+ *
+ * The case folded texts and a mask of their characters are computed once in setFiles, so most files are rejected
+ * without looking at their text. When the pattern is extended, only the files matching the previous pattern are
+ * searched again.
+ */
+class FuzzyMatcher
+{
+public:
+    explicit FuzzyMatcher(int maxResults = 100);
+
+    // Sets the files to search, `names` and `paths` must have the same size
+    void setFiles(const QStringList &names, const QStringList &paths);
+    int fileCount() const { return static_cast<int>(m_files.size()); }
+
+    // Returns the indexes of the best files matching `pattern`, best first, at most maxResults. All the files match an
+    // empty pattern, in their original order.
+    const std::vector<int> &match(const QString &pattern);
+
+    // Returns the score of the case folded `pattern` in `text`, -1 if it's not a subsequence of the text
+    static int score(QStringView pattern, QStringView text, QStringView foldedText);
+
+private:
+    struct File
+    {
+        QString name;
+        QString path;
+        QString foldedName;
+        QString foldedPath;
+        quint64 mask = 0;
+    };
+
+    int score(QStringView pattern, const File &file) const;
+
+    const int m_maxResults;
+    std::vector<File> m_files;
+    QString m_pattern;
+    // All the files matching m_pattern, used to narrow the search when the pattern is extended
+    std::vector<int> m_candidates;
+    std::vector<int> m_results;
+};
+
+} // namespace Utils
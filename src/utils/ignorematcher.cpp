@@ -0,0 +1,167 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "ignorematcher.h"
+
+#include <QFile>
+
+namespace Utils {
+
+// Converts a glob pattern to a regular expression, '*' and '?' don't match '/', "**" matches any number of directories
+static QString globToRegularExpression(QStringView pattern)
+{
+    QString result;
+    result.reserve(pattern.size() * 2);
+    for (qsizetype i = 0; i < pattern.size(); ++i) {
+        const QChar c = pattern[i];
+        if (c == u'*') {
+            const bool atStart = i == 0 || pattern[i - 1] == u'/';
+            if (i + 1 < pattern.size() && pattern[i + 1] == u'*' && atStart) {
+                if (i + 2 == pattern.size()) {
+                    // "dir/**" matches everything inside dir
+                    result += ".*";
+                    ++i;
+                    continue;
+                }
+                if (pattern[i + 2] == u'/') {
+                    // "**/" matches zero or more directories
+                    result += "(?:.*/)?";
+                    i += 2;
+                    continue;
+                }
+            }
+            result += "[^/]*";
+        } else if (c == u'?') {
+            result += "[^/]";
+        } else if (c == u'[') {
+            const auto end = pattern.indexOf(u']', i + 1);
+            if (end == -1) {
+                result += "\\[";
+                continue;
+            }
+            auto set = pattern.sliced(i + 1, end - i - 1).toString();
+            if (set.startsWith(u'!'))
+                set[0] = u'^';
+            set.replace("\\", "\\\\");
+            result += u'[' + set + u']';
+            i = end;
+        } else if (c == u'\\' && i + 1 < pattern.size()) {
+            result += QRegularExpression::escape(pattern.sliced(++i, 1));
+        } else {
+            result += QRegularExpression::escape(QStringView(&c, 1));
+        }
+    }
+    return QRegularExpression::anchoredPattern(result);
+}
+
+std::vector<IgnoreMatcher::Rule> IgnoreMatcher::compile(const QStringList &patterns)
+{
+    std::vector<Rule> rules;
+    for (const auto &line : patterns) {
+        QStringView pattern(line);
+        // Trailing spaces are ignored, unless escaped
+        while (pattern.endsWith(u' ') && !pattern.endsWith(u"\\ "))
+            pattern.chop(1);
+        if (pattern.isEmpty() || pattern.startsWith(u'#'))
+            continue;
+
+        Rule rule;
+        if (pattern.startsWith(u'!')) {
+            rule.negated = true;
+            pattern = pattern.sliced(1);
+        } else if (pattern.startsWith(u"\\!") || pattern.startsWith(u"\\#")) {
+            pattern = pattern.sliced(1);
+        }
+        if (pattern.endsWith(u'/')) {
+            rule.directoryOnly = true;
+            pattern.chop(1);
+        }
+        rule.anchored = pattern.contains(u'/');
+        if (pattern.startsWith(u'/'))
+            pattern = pattern.sliced(1);
+        if (pattern.isEmpty())
+            continue;
+
+        rule.pattern = pattern.toString();
+        if (pattern.contains(u'*') || pattern.contains(u'?') || pattern.contains(u'[') || pattern.contains(u'\\')) {
+            rule.regexp = QRegularExpression(globToRegularExpression(pattern));
+            rule.regexp.optimize();
+        }
+        rules.push_back(std::move(rule));
+    }
+    return rules;
+}
+
+bool IgnoreMatcher::setPatterns(const QString &directory, const QStringList &patterns)
+{
+    if (patterns.isEmpty())
+        return m_rules.erase(directory) > 0;
+
+    auto it = m_rules.find(directory);
+    if (it != m_rules.end() && it->second.patterns == patterns)
+        return false;
+    m_rules[directory] = {.patterns = patterns, .rules = compile(patterns)};
+    return true;
+}
+
+void IgnoreMatcher::removePatterns(const QString &directory)
+{
+    const QString prefix = directory + '/';
+    std::erase_if(m_rules, [&](const auto &entry) {
+        return entry.first == directory || directory.isEmpty() || entry.first.startsWith(prefix);
+    });
+}
+
+bool IgnoreMatcher::matches(const Rule &rule, QStringView path, QStringView name, bool isDirectory)
+{
+    if (rule.directoryOnly && !isDirectory)
+        return false;
+    const auto subject = rule.anchored ? path : name;
+    if (!rule.regexp.pattern().isEmpty())
+        return rule.regexp.match(subject).hasMatch();
+    return subject == rule.pattern;
+}
+
+bool IgnoreMatcher::isIgnored(QStringView path, bool isDirectory) const
+{
+    if (m_rules.empty())
+        return false;
+
+    const auto slash = path.lastIndexOf(u'/');
+    const auto name = path.sliced(slash + 1);
+    // From the closest directory to the root, the patterns of the closest ignore file win
+    auto directoryEnd = slash;
+    while (true) {
+        const auto directory = directoryEnd < 0 ? QStringView() : path.first(directoryEnd);
+        auto it = m_rules.find(directory.toString());
+        if (it != m_rules.end()) {
+            const auto relativePath = directoryEnd < 0 ? path : path.sliced(directoryEnd + 1);
+            const auto &rules = it->second.rules;
+            for (auto rule = rules.rbegin(); rule != rules.rend(); ++rule) {
+                if (matches(*rule, relativePath, name, isDirectory))
+                    return !rule->negated;
+            }
+        }
+        if (directoryEnd < 0)
+            break;
+        directoryEnd = directory.lastIndexOf(u'/');
+    }
+    return false;
+}
+
+QStringList IgnoreMatcher::readPatterns(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return {};
+    return QString::fromUtf8(file.readAll()).split(u'\n');
+}
+
+} // namespace Utils
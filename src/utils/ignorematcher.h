@@ -0,0 +1,71 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <unordered_map>
+#include <vector>
+
+namespace Utils {
+
+/**
+ * \brief Matches paths against the patterns of ignore files (`.gitignore` syntax)
+ *
+ * Patterns are set per directory, as read from the ignore files of this directory, and apply to the paths below it.
+ * As in git, the last matching pattern wins, and the patterns of a directory override the ones of its parents.
+ * Supported: `#` comments, `!` negations, a trailing `/` for directories, leading or inner `/` anchoring the pattern
+ * to its directory, and the `*`, `?`, `[...]` and `**` wildcards.
+ *
+ * Patterns are compiled once in setPatterns: the ones without wildcards (the most common: `build`, `.git`...) are
+ * compared as strings, the others are converted to a regular expression.
+ */
+class IgnoreMatcher
+{
+public:
+    // Sets the patterns of `directory`, relative to the root (empty for the root), replacing the previous ones.
+    // Returns true if they changed.
+    bool setPatterns(const QString &directory, const QStringList &patterns);
+    // Removes the patterns of `directory` and its subdirectories
+    void removePatterns(const QString &directory);
+
+    // Returns true if `path`, relative to the root and using '/' as separator, is ignored
+    bool isIgnored(QStringView path, bool isDirectory) const;
+
+    // Returns the lines of an ignore file, or nothing if it doesn't exist
+    static QStringList readPatterns(const QString &fileName);
+
+private:
+    struct Rule
+    {
+        QString pattern;
+        // Empty if the pattern has no wildcard, it's then compared to the path (or its name) as it is
+        QRegularExpression regexp;
+        bool negated = false;
+        bool directoryOnly = false;
+        // Anchored patterns are matched on the path relative to the directory, other patterns on the name only
+        bool anchored = false;
+    };
+    struct DirectoryRules
+    {
+        QStringList patterns;
+        std::vector<Rule> rules;
+    };
+
+    static std::vector<Rule> compile(const QStringList &patterns);
+    static bool matches(const Rule &rule, QStringView path, QStringView name, bool isDirectory);
+
+    std::unordered_map<QString, DirectoryRules> m_rules;
+};
+
+} // namespace Utils
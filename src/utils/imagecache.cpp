@@ -0,0 +1,131 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "imagecache.h"
+#include "taskscheduler.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImageReader>
+#include <algorithm>
+
+namespace Utils {
+
+// Enough for the strips of a large RC file and a few thousand icons
+constexpr qsizetype DefaultMaxSize = 128 * 1024 * 1024;
+
+ImageCache::ImageCache()
+    : m_images(DefaultMaxSize)
+{
+}
+
+ImageCache *ImageCache::instance()
+{
+    static ImageCache cache;
+    return &cache;
+}
+
+static QString imageKey(const QString &fileName)
+{
+    const QDateTime lastModified = QFileInfo(fileName).lastModified();
+    return fileName + '|' + QString::number(lastModified.toMSecsSinceEpoch());
+}
+
+static QString thumbnailKey(const QString &imageKey, const QRect &rect, const QSize &size)
+{
+    return QString("%1|%2,%3,%4,%5|%6x%7")
+        .arg(imageKey)
+        .arg(rect.x())
+        .arg(rect.y())
+        .arg(rect.width())
+        .arg(rect.height())
+        .arg(size.width())
+        .arg(size.height());
+}
+
+std::optional<QImage> ImageCache::find(const QString &key)
+{
+    QMutexLocker locker(&m_mutex);
+    if (const auto *image = m_images.object(key))
+        return *image;
+    return {};
+}
+
+void ImageCache::insert(const QString &key, const QImage &image)
+{
+    QMutexLocker locker(&m_mutex);
+    // A null image still takes an entry, so it's not decoded again
+    m_images.insert(key, new QImage(image), std::max<qsizetype>(image.sizeInBytes(), 1));
+}
+
+QImage ImageCache::image(const QString &fileName)
+{
+    const QString key = imageKey(fileName);
+    if (auto image = find(key))
+        return *image;
+
+    // Decoded outside of the lock, two threads may decode the same image at worst
+    const QImage image(fileName);
+    insert(key, image);
+    return image;
+}
+
+QImage ImageCache::thumbnail(const QString &fileName, const QRect &rect, const QSize &size)
+{
+    const QString key = thumbnailKey(imageKey(fileName), rect, size);
+    if (auto thumbnail = find(key))
+        return *thumbnail;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_pending.contains(key))
+            return {};
+        m_pending.insert(key);
+    }
+
+    TaskScheduler::start([this, fileName, rect, size, key]() {
+        QImage thumbnail;
+        if (rect.isNull()) {
+            // Formats like JPEG can decode at a smaller size directly, without the full image
+            QImageReader reader(fileName);
+            const QSize imageSize = reader.size();
+            if (imageSize.isValid() && (imageSize.width() > size.width() || imageSize.height() > size.height()))
+                reader.setScaledSize(imageSize.scaled(size, Qt::KeepAspectRatio));
+            thumbnail = reader.read();
+        } else {
+            // The strip is kept in the cache, for the other icons cut from it
+            thumbnail = image(fileName).copy(rect);
+        }
+        if (thumbnail.width() > size.width() || thumbnail.height() > size.height())
+            thumbnail = thumbnail.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+        insert(key, thumbnail);
+        {
+            QMutexLocker locker(&m_mutex);
+            m_pending.remove(key);
+        }
+        emit thumbnailReady(fileName);
+    });
+    return {};
+}
+
+void ImageCache::setMaxSize(qsizetype size)
+{
+    QMutexLocker locker(&m_mutex);
+    m_images.setMaxCost(size);
+}
+
+void ImageCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_images.clear();
+}
+
+} // namespace Utils
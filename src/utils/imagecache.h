@@ -0,0 +1,67 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <optional>
+
+namespace Utils {
+
+/**
+ * \brief Decoded images and their thumbnails, shared by the views and the RC asset conversions
+ *
+ * The images are keyed by their file name and last modification time, so a file changed on disk is decoded again. The
+ * cache is limited by the memory used by the images, the least recently used ones are dropped first.
+ *
+ * A toolbar strip is decoded once for all its icons: the thumbnails of the icons are cut from the decoded strip, which
+ * is also used when writing the icons with RcCore::writeAssetsToImage. Thumbnails are decoded in the background, so a
+ * view browsing thousands of icons only decodes the ones it shows, without blocking.
+ *
+ * All the methods can be called from any thread.
+ */
+class ImageCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ImageCache *instance();
+
+    // Returns the decoded image, decoding it on the calling thread if it's not in the cache
+    QImage image(const QString &fileName);
+    // Returns the `rect` part of the image (all of it if null), scaled down to fit in `size`. If it's not in the cache,
+    // it's decoded in the background and a null image is returned: thumbnailReady is emitted once it's there.
+    QImage thumbnail(const QString &fileName, const QRect &rect, const QSize &size);
+
+    // Maximum memory used by the images, in bytes
+    void setMaxSize(qsizetype size);
+    void clear();
+
+signals:
+    void thumbnailReady(const QString &fileName);
+
+private:
+    ImageCache();
+
+    // Returns the image in the cache, nullopt if it's not there: an image that can't be decoded is cached as null
+    std::optional<QImage> find(const QString &key);
+    void insert(const QString &key, const QImage &image);
+
+    QMutex m_mutex;
+    QCache<QString, QImage> m_images;
+    // Thumbnails being decoded
+    QSet<QString> m_pending;
+};
+
+} // namespace Utils
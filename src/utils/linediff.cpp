@@ -0,0 +1,279 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "linediff.h"
+
+#include <QHash>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+namespace Utils {
+
+namespace {
+
+// Myers diff of two lists of line ids, with the middle snake found in linear space (see "An O(ND) Difference
+// Algorithm and Its Variations", section 4b). The removed and added lines are flagged in m_removed and m_added.
+// With maxEdits, the diff stops as soon as the edit script can't be shorter than maxEdits lines.
+class MyersDiff
+{
+public:
+    MyersDiff(std::vector<int> a, std::vector<int> b, int maxEdits = 0)
+        : m_a(std::move(a))
+        , m_b(std::move(b))
+        , m_forward(m_a.size() + m_b.size() + 3)
+        , m_backward(m_a.size() + m_b.size() + 3)
+        , m_offset(static_cast<int>(m_b.size()) + 1)
+        , m_removed(m_a.size())
+        , m_added(m_b.size())
+        , m_maxEdits(maxEdits)
+    {
+        compare(0, static_cast<int>(m_a.size()), 0, static_cast<int>(m_b.size()));
+    }
+
+    const std::vector<char> &removed() const { return m_removed; }
+    const std::vector<char> &added() const { return m_added; }
+    bool isAborted() const { return m_aborted; }
+
+private:
+    void compare(int xoff, int xlim, int yoff, int ylim)
+    {
+        while (xoff < xlim && yoff < ylim && m_a[xoff] == m_b[yoff]) {
+            ++xoff;
+            ++yoff;
+        }
+        while (xoff < xlim && yoff < ylim && m_a[xlim - 1] == m_b[ylim - 1]) {
+            --xlim;
+            --ylim;
+        }
+
+        if (xoff == xlim) {
+            std::fill(m_added.begin() + yoff, m_added.begin() + ylim, 1);
+        } else if (yoff == ylim) {
+            std::fill(m_removed.begin() + xoff, m_removed.begin() + xlim, 1);
+        } else {
+            const auto [xmid, ymid] = middleSnake(xoff, xlim, yoff, ylim);
+            if (m_aborted)
+                return;
+            compare(xoff, xmid, yoff, ymid);
+            compare(xmid, xlim, ymid, ylim);
+        }
+    }
+
+    // Returns the point where the forward and backward searches meet, the diagonals are indexed by x - y
+    std::pair<int, int> middleSnake(int xoff, int xlim, int yoff, int ylim)
+    {
+        int *fd = m_forward.data() + m_offset;
+        int *bd = m_backward.data() + m_offset;
+        const int dmin = xoff - ylim;
+        const int dmax = xlim - yoff;
+        const int fmid = xoff - yoff;
+        const int bmid = xlim - ylim;
+        int fmin = fmid;
+        int fmax = fmid;
+        int bmin = bmid;
+        int bmax = bmid;
+        const bool odd = (fmid - bmid) & 1;
+
+        fd[fmid] = xoff;
+        bd[bmid] = xlim;
+        // Each step makes the edit script of this part at least two lines longer, and costs O(N)
+        for (int step = 1;; ++step) {
+            if (m_maxEdits > 0 && 2 * step > m_maxEdits) {
+                m_aborted = true;
+                return {xoff, yoff};
+            }
+            if (fmin > dmin)
+                fd[--fmin - 1] = -1;
+            else
+                ++fmin;
+            if (fmax < dmax)
+                fd[++fmax + 1] = -1;
+            else
+                --fmax;
+            for (int d = fmax; d >= fmin; d -= 2) {
+                const int low = fd[d - 1];
+                const int high = fd[d + 1];
+                int x = low < high ? high : low + 1;
+                int y = x - d;
+                while (x < xlim && y < ylim && m_a[x] == m_b[y]) {
+                    ++x;
+                    ++y;
+                }
+                fd[d] = x;
+                if (odd && bmin <= d && d <= bmax && bd[d] <= x)
+                    return {x, y};
+            }
+
+            if (bmin > dmin)
+                bd[--bmin - 1] = INT_MAX;
+            else
+                ++bmin;
+            if (bmax < dmax)
+                bd[++bmax + 1] = INT_MAX;
+            else
+                --bmax;
+            for (int d = bmax; d >= bmin; d -= 2) {
+                const int low = bd[d - 1];
+                const int high = bd[d + 1];
+                int x = low < high ? low : high - 1;
+                int y = x - d;
+                while (x > xoff && y > yoff && m_a[x - 1] == m_b[y - 1]) {
+                    --x;
+                    --y;
+                }
+                bd[d] = x;
+                if (!odd && fmin <= d && d <= fmax && x <= fd[d])
+                    return {x, y};
+            }
+        }
+    }
+
+    const std::vector<int> m_a;
+    const std::vector<int> m_b;
+    std::vector<int> m_forward;
+    std::vector<int> m_backward;
+    const int m_offset;
+    std::vector<char> m_removed;
+    std::vector<char> m_added;
+    const int m_maxEdits;
+    bool m_aborted = false;
+};
+
+struct ScriptLine
+{
+    DiffLine::Kind kind;
+    int oldIndex;
+    int newIndex;
+};
+
+} // namespace
+
+static std::optional<std::vector<DiffHunk>> computeDiff(const std::vector<QStringView> &oldLines,
+                                                        const std::vector<QStringView> &newLines, int context,
+                                                        int maxEdits)
+{
+    const int oldCount = static_cast<int>(oldLines.size());
+    const int newCount = static_cast<int>(newLines.size());
+
+    // The common lines at the start and the end are most of a file changed by a script, skip them before hashing
+    int prefix = 0;
+    while (prefix < oldCount && prefix < newCount && oldLines[prefix] == newLines[prefix])
+        ++prefix;
+    int suffix = 0;
+    while (suffix < oldCount - prefix && suffix < newCount - prefix
+           && oldLines[oldCount - suffix - 1] == newLines[newCount - suffix - 1])
+        ++suffix;
+    if (prefix == oldCount && prefix == newCount)
+        return std::vector<DiffHunk>();
+    if (maxEdits > 0 && std::abs(oldCount - newCount) > maxEdits)
+        return {};
+
+    // Equal lines get the same id, so the diff only compares integers
+    QHash<QStringView, int> ids;
+    auto toIds = [&](const std::vector<QStringView> &lines) {
+        std::vector<int> result;
+        result.reserve(lines.size() - prefix - suffix);
+        for (auto it = lines.begin() + prefix; it != lines.end() - suffix; ++it) {
+            auto id = ids.constFind(*it);
+            if (id == ids.cend())
+                id = ids.insert(*it, static_cast<int>(ids.size()));
+            result.push_back(id.value());
+        }
+        return result;
+    };
+    auto oldIds = toIds(oldLines);
+    auto newIds = toIds(newLines);
+    const MyersDiff diff(std::move(oldIds), std::move(newIds), maxEdits);
+    if (diff.isAborted())
+        return {};
+
+    // Edit script of the whole texts, each line with its position in the old and new lines
+    std::vector<ScriptLine> script;
+    int i = 0;
+    int j = 0;
+    while (i < oldCount || j < newCount) {
+        if (i >= prefix && i < oldCount - suffix && diff.removed()[i - prefix])
+            script.push_back({DiffLine::Removed, i++, j});
+        else if (j >= prefix && j < newCount - suffix && diff.added()[j - prefix])
+            script.push_back({DiffLine::Added, i, j++});
+        else
+            script.push_back({DiffLine::Context, i++, j++});
+    }
+
+    const int size = static_cast<int>(script.size());
+    auto nextChange = [&](int from) {
+        while (from < size && script[from].kind == DiffLine::Context)
+            ++from;
+        return from;
+    };
+
+    std::vector<DiffHunk> hunks;
+    int position = nextChange(prefix);
+    int previousEnd = 0;
+    while (position < size) {
+        const int start = std::max(position - context, previousEnd);
+        int end = position;
+        // Changes separated by less than two contexts are in the same hunk
+        for (;;) {
+            while (end < size && script[end].kind != DiffLine::Context)
+                ++end;
+            const int next = nextChange(end);
+            if (next >= size || next - end > 2 * context)
+                break;
+            end = next;
+        }
+        end = std::min(size, end + context);
+
+        DiffHunk hunk;
+        hunk.oldStart = script[start].oldIndex;
+        hunk.newStart = script[start].newIndex;
+        for (int k = start; k < end; ++k) {
+            const auto &line = script[k];
+            if (line.kind != DiffLine::Added)
+                ++hunk.oldCount;
+            if (line.kind != DiffLine::Removed)
+                ++hunk.newCount;
+            hunk.lines.push_back({line.kind, line.kind == DiffLine::Added ? line.newIndex : line.oldIndex});
+        }
+        hunks.push_back(std::move(hunk));
+        previousEnd = end;
+        position = nextChange(end);
+    }
+    return hunks;
+}
+
+std::vector<DiffHunk> diffLines(const std::vector<QStringView> &oldLines, const std::vector<QStringView> &newLines,
+                                int context)
+{
+    return *computeDiff(oldLines, newLines, context, 0);
+}
+
+std::optional<std::vector<DiffHunk>> boundedDiffLines(const std::vector<QStringView> &oldLines,
+                                                      const std::vector<QStringView> &newLines, int context,
+                                                      int maxEdits)
+{
+    return computeDiff(oldLines, newLines, context, maxEdits);
+}
+
+std::vector<QStringView> splitLines(QStringView text)
+{
+    std::vector<QStringView> lines;
+    qsizetype start = 0;
+    for (qsizetype index = text.indexOf(u'\n'); index != -1; index = text.indexOf(u'\n', start)) {
+        lines.push_back(text.sliced(start, index + 1 - start));
+        start = index + 1;
+    }
+    if (start < text.size())
+        lines.push_back(text.sliced(start));
+    return lines;
+}
+
+} // namespace Utils
@@ -0,0 +1,55 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QStringView>
+#include <optional>
+#include <vector>
+
+namespace Utils {
+
+struct DiffLine
+{
+    enum Kind : char { Context = ' ', Removed = '-', Added = '+' };
+    Kind kind = Context;
+    // Index of the line in the old lines for Context and Removed, in the new lines for Added
+    int index = 0;
+};
+
+// Hunk of a unified diff, the starts are 0-based
+struct DiffHunk
+{
+    int oldStart = 0;
+    int oldCount = 0;
+    int newStart = 0;
+    int newCount = 0;
+    std::vector<DiffLine> lines;
+};
+
+/**
+ * \brief Returns the hunks changing oldLines into newLines, with `context` unchanged lines around each change
+ *
+ * The lines are compared by their hashes first, and the shortest edit script is found with the linear space version of
+ * the Myers algorithm, after removing the common lines at the start and the end.
+ */
+std::vector<DiffHunk> diffLines(const std::vector<QStringView> &oldLines, const std::vector<QStringView> &newLines,
+                                int context = 3);
+// Same as diffLines, but returns nothing once the diff needs more than `maxEdits` removed and added lines: the diff is
+// O(N*D), with N lines and D lines changed, so it gets quadratic for texts with mostly different lines.
+std::optional<std::vector<DiffHunk>> boundedDiffLines(const std::vector<QStringView> &oldLines,
+                                                      const std::vector<QStringView> &newLines, int context,
+                                                      int maxEdits);
+
+// Splits the text in lines, each line keeps its '\n': the last one doesn't have it if the text doesn't end with a new
+// line, so it's different from the same line with a new line.
+std::vector<QStringView> splitLines(QStringView text);
+
+} // namespace Utils
@@ -0,0 +1,123 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "literalfinder.h"
+
+#include <algorithm>
+
+namespace Utils {
+
+// Under this size, scanning for the first character is faster than the shifts of the Horspool search
+static constexpr qsizetype ShortPatternSize = 4;
+
+static bool isWordCharacter(QChar ch)
+{
+    return ch.isLetterOrNumber() || ch == u'_';
+}
+
+// Same definition as `\b` in a regular expression
+static bool isWordBoundary(QStringView text, qsizetype position)
+{
+    const bool wordBefore = position > 0 && isWordCharacter(text.at(position - 1));
+    const bool wordAfter = position < text.size() && isWordCharacter(text.at(position));
+    return wordBefore != wordAfter;
+}
+
+LiteralFinder::LiteralFinder(QString pattern, Qt::CaseSensitivity cs, bool wholeWords)
+    : m_pattern(std::move(pattern))
+    , m_caseSensitivity(cs)
+    , m_wholeWords(wholeWords)
+{
+    if (m_caseSensitivity == Qt::CaseInsensitive) {
+        for (auto &ch : m_pattern)
+            ch = ch.toCaseFolded();
+    }
+
+    const auto size = m_pattern.size();
+    m_shifts.fill(std::max<qsizetype>(size, 1));
+    // Characters sharing the same low byte end up with the smallest shift, which is always safe
+    for (qsizetype i = 0; i < size - 1; ++i)
+        m_shifts[m_pattern.at(i).unicode() & 0xff] = size - 1 - i;
+}
+
+QChar LiteralFinder::charAt(QStringView text, qsizetype position) const
+{
+    const QChar ch = text.at(position);
+    return m_caseSensitivity == Qt::CaseSensitive ? ch : ch.toCaseFolded();
+}
+
+bool LiteralFinder::matchesAt(QStringView text, qsizetype position) const
+{
+    const auto size = m_pattern.size();
+    if (m_caseSensitivity == Qt::CaseSensitive) {
+        if (text.sliced(position, size) != m_pattern)
+            return false;
+    } else {
+        for (qsizetype i = 0; i < size; ++i) {
+            if (charAt(text, position + i) != m_pattern.at(i))
+                return false;
+        }
+    }
+    return !m_wholeWords || (isWordBoundary(text, position) && isWordBoundary(text, position + size));
+}
+
+qsizetype LiteralFinder::indexIn(QStringView text, qsizetype from) const
+{
+    const auto size = m_pattern.size();
+    const auto last = text.size() - size;
+    if (size == 0)
+        return -1;
+
+    qsizetype position = std::max<qsizetype>(from, 0);
+    if (m_caseSensitivity == Qt::CaseSensitive && size < ShortPatternSize) {
+        const QChar first = m_pattern.front();
+        while ((position = text.indexOf(first, position)) != -1 && position <= last) {
+            if (matchesAt(text, position))
+                return position;
+            ++position;
+        }
+        return -1;
+    }
+
+    const QChar lastChar = m_pattern.back();
+    while (position <= last) {
+        const QChar ch = charAt(text, position + size - 1);
+        if (ch == lastChar && matchesAt(text, position))
+            return position;
+        position += m_shifts[ch.unicode() & 0xff];
+    }
+    return -1;
+}
+
+qsizetype LiteralFinder::lastIndexIn(QStringView text, qsizetype from) const
+{
+    const auto size = m_pattern.size();
+    if (size == 0)
+        return -1;
+
+    for (auto position = std::min(from, text.size() - size); position >= 0; --position) {
+        if (matchesAt(text, position))
+            return position;
+    }
+    return -1;
+}
+
+QList<qsizetype> LiteralFinder::findAll(QStringView text) const
+{
+    QList<qsizetype> positions;
+    qsizetype position = 0;
+    while ((position = indexIn(text, position)) != -1) {
+        positions.push_back(position);
+        position += m_pattern.size();
+    }
+    return positions;
+}
+
+} // namespace Utils
@@ -0,0 +1,54 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringView>
+#include <array>
+
+namespace Utils {
+
+/**
+ * \brief Searches a literal string in a text
+ *
+ * The pattern is prepared once, and can then be searched in any number of texts. Short case-sensitive patterns are
+ * found by scanning for their first character with `QStringView::indexOf`, which is vectorized by Qt, other patterns
+ * use a Boyer-Moore-Horspool search.
+ *
+ * When searching for whole words, a match must start and end on a word boundary, like `\b` in a regular expression.
+ */
+class LiteralFinder
+{
+public:
+    explicit LiteralFinder(QString pattern, Qt::CaseSensitivity cs = Qt::CaseSensitive, bool wholeWords = false);
+
+    qsizetype size() const { return m_pattern.size(); }
+
+    // Returns the position of the first match starting at or after `from`, -1 if there are none
+    qsizetype indexIn(QStringView text, qsizetype from = 0) const;
+    // Returns the position of the last match starting at or before `from`, -1 if there are none
+    qsizetype lastIndexIn(QStringView text, qsizetype from) const;
+    // Returns the positions of all the matches in the text, without overlaps
+    QList<qsizetype> findAll(QStringView text) const;
+
+private:
+    QChar charAt(QStringView text, qsizetype position) const;
+    bool matchesAt(QStringView text, qsizetype position) const;
+
+    QString m_pattern;
+    Qt::CaseSensitivity m_caseSensitivity;
+    bool m_wholeWords;
+    // Horspool shifts, indexed by the low byte of the last character of the window
+    std::array<qsizetype, 256> m_shifts;
+};
+
+} // namespace Utils
@@ -12,6 +12,7 @@
 
 #include <QRect>
 #include <QVariant>
+#include <cstring>
 #include <sstream>
 
 namespace Utils {
@@ -153,6 +154,48 @@ QtUiWriter::Status QtUiWriter::addWidgetProperty(pugi::xml_node widget, const QS
     return Success;
 }
 
+static bool isSupportedProperty(const QVariant &value)
+{
+    switch (static_cast<QMetaType::Type>(value.typeId())) {
+    case QMetaType::QStringList:
+    case QMetaType::QRect:
+    case QMetaType::Bool:
+    case QMetaType::Int:
+    case QMetaType::QString:
+        return true;
+    default:
+        return false;
+    }
+}
+
+QtUiWriter::Status QtUiWriter::setWidgetProperties(pugi::xml_node widget, const QVariantMap &properties)
+{
+    for (const auto &value : properties) {
+        if (!isSupportedProperty(value))
+            return InvalidProperty;
+    }
+
+    // String lists are stored as <item> children, the other properties as <property> children
+    auto isReplaced = [&properties](pugi::xml_node property, bool isStringList) {
+        const auto it = properties.constFind(QString::fromLatin1(property.attribute("name").value()));
+        return it != properties.cend()
+            && (static_cast<QMetaType::Type>(it->typeId()) == QMetaType::QStringList) == isStringList;
+    };
+    auto child = widget.first_child();
+    while (child) {
+        const auto next = child.next_sibling();
+        if (strcmp(child.name(), "property") == 0 ? isReplaced(child, false)
+                                                   : strcmp(child.name(), "item") == 0
+                                                       && isReplaced(child.child("property"), true))
+            widget.remove_child(child);
+        child = next;
+    }
+
+    for (const auto &[name, value] : properties.asKeyValueRange())
+        addWidgetProperty(widget, name, value);
+    return Success;
+}
+
 QtUiWriter::Status QtUiWriter::setWidgetName(pugi::xml_node widget, const QString &name, bool isRoot)
 {
     widget.attribute("name").set_value(name.toLatin1().constData());
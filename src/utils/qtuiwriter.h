@@ -12,6 +12,7 @@
 
 #include <QHash>
 #include <QString>
+#include <QVariantMap>
 #include <pugixml.hpp>
 
 namespace Utils {
@@ -29,6 +30,9 @@ public:
 
     Status addWidgetProperty(pugi::xml_node widget, const QString &name, const QVariant &value,
                              const QHash<QString, QString> &attributes = {});
+    // Sets all the properties in a single pass over the widget children: the existing properties with the same names
+    // are removed, then the new ones are added. Nothing is changed if one of the values is not supported.
+    Status setWidgetProperties(pugi::xml_node widget, const QVariantMap &properties);
 
     Status setWidgetName(pugi::xml_node widget, const QString &name, bool isRoot = false);
     Status setWidgetClassName(pugi::xml_node widget, const QString &className);
@@ -10,33 +10,72 @@
 
 #include "string_helper.h"
 
-#include <QSet>
+#include <QCache>
+#include <QMutex>
 #include <QTextDocument>
+#include <algorithm>
+#include <utility>
 
 namespace Utils {
 
-static QString nextWordInString(const QString &str, QString::const_iterator &i, Case c)
+static bool isAscii(QStringView text)
 {
-    QString word;
+    return std::ranges::all_of(text, [](QChar c) {
+        return c.unicode() < 0x80;
+    });
+}
+
+static bool isAsciiUpper(char16_t c)
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+static bool isAsciiLower(char16_t c)
+{
+    return c >= 'a' && c <= 'z';
+}
+
+// Appends the text in lower or upper case: ASCII texts, most identifiers, are converted without any temporary string
+static void appendCase(QString &result, QStringView text, bool upper)
+{
+    if (!isAscii(text)) {
+        result += upper ? text.toString().toUpper() : text.toString().toLower();
+        return;
+    }
+    for (const QChar c : text) {
+        const char16_t u = c.unicode();
+        if (upper && isAsciiLower(u))
+            result += QChar(u - 'a' + 'A');
+        else if (!upper && isAsciiUpper(u))
+            result += QChar(u - 'A' + 'a');
+        else
+            result += c;
+    }
+}
 
-    auto isSeparator = [&i, c]() {
+// Returns the next word from the position i, and moves i after the word and its separator
+static QStringView nextWordInString(QStringView str, qsizetype &i, Case c)
+{
+    auto isSeparator = [&str, &i, c]() {
+        const QChar ch = str[i];
         if (c == Case::CamelCase || c == Case::PascalCase)
-            return i->isUpper();
+            return ch.isUpper();
         else if (c == Case::SnakeCase || c == Case::UpperCase)
-            return *i == '_';
+            return ch == '_';
         else if (c == Case::KebabCase)
-            return *i == '-';
-        return *i == ' ';
+            return ch == '-';
+        return ch == ' ';
     };
 
+    const qsizetype start = i;
     do {
-        word += *i;
-        i++;
-    } while (!isSeparator() && i != str.end());
+        ++i;
+    } while (i < str.size() && !isSeparator());
+    const QStringView word = str.sliced(start, i - start);
 
-    if (i != str.end()
+    if (i < str.size()
         && (c == Case::SnakeCase || c == Case::KebabCase || c == Case::UpperCase || c == Case::TitleCase))
-        i++;
+        ++i;
 
     return word;
 }
@@ -46,62 +85,73 @@ QString convertCase(const QString &str, Case from, Case to)
     if (from == to)
         return str;
 
-    static const QSet<QString> titleCaseExceptions = {"a",  "an", "the", "at", "by",  "by", "for",
-                                                      "in", "of", "on",  "to", "and", "as", "or"};
+    static constexpr QLatin1String titleCaseExceptions[] = {
+        QLatin1String("a"),  QLatin1String("an"),  QLatin1String("the"), QLatin1String("at"),  QLatin1String("by"),
+        QLatin1String("for"), QLatin1String("in"), QLatin1String("of"),  QLatin1String("on"),  QLatin1String("to"),
+        QLatin1String("and"), QLatin1String("as"), QLatin1String("or")};
 
     QString result;
+    // Room for the separators of a few words
+    result.reserve(str.size() + 8);
 
-    auto i = str.cbegin();
-    while (i < str.cend()) {
-        QString w = nextWordInString(str, i, from);
+    qsizetype i = 0;
+    while (i < str.size()) {
+        const QStringView w = nextWordInString(str, i, from);
         const bool firstWord = result.isEmpty();
 
+        if (!firstWord) {
+            if (to == Case::SnakeCase || to == Case::UpperCase)
+                result += '_';
+            else if (to == Case::KebabCase)
+                result += '-';
+            else if (to == Case::TitleCase)
+                result += ' ';
+        }
+        const qsizetype wordStart = result.size();
+        appendCase(result, w, to == Case::UpperCase);
+
+        bool capitalize = false;
         switch (to) {
         case Case::CamelCase:
-            w = w.toLower();
-            if (!firstWord)
-                w[0] = w.front().toUpper();
-            result += w;
+            capitalize = !firstWord;
             break;
         case Case::PascalCase:
-            w = w.toLower();
-            w[0] = w.front().toUpper();
-            result += w;
+            capitalize = true;
             break;
-        case Case::SnakeCase:
-            if (!firstWord)
-                result += '_';
-            result += w.toLower();
+        case Case::TitleCase:
+            capitalize = firstWord
+                || std::ranges::find(titleCaseExceptions, QStringView(result).sliced(wordStart))
+                    == std::end(titleCaseExceptions);
             break;
+        case Case::SnakeCase:
         case Case::KebabCase:
-            if (!firstWord)
-                result += '-';
-            result += w.toLower();
-            break;
         case Case::UpperCase:
-            if (!firstWord)
-                result += '_';
-            result += w.toUpper();
             break;
-        case Case::TitleCase:
-            if (!firstWord)
-                result += ' ';
-            w = w.toLower();
-            if (firstWord || !titleCaseExceptions.contains(w))
-                w[0] = w.front().toUpper();
-            result += w;
         }
+        if (capitalize)
+            result[wordStart] = result.at(wordStart).toUpper();
     }
 
     return result;
 }
 
+QStringList convertCase(const QStringList &strings, Case from, Case to)
+{
+    QStringList result;
+    result.reserve(strings.size());
+    for (const auto &str : strings)
+        result.push_back(convertCase(str, from, to));
+    return result;
+}
+
 namespace Internal {
     // This function is copied from from Qt Creator.
-    QString matchCaseReplacement(const QString &originalText, const QString &replaceText)
+    static void appendMatchCaseReplacement(QString &result, QStringView originalText, QStringView replaceText)
     {
-        if (originalText.isEmpty() || replaceText.isEmpty())
-            return replaceText;
+        if (originalText.isEmpty() || replaceText.isEmpty()) {
+            result += replaceText;
+            return;
+        }
 
         // Now proceed with actual case matching
         bool firstIsUpperCase = originalText.at(0).isUpper();
@@ -119,48 +169,61 @@ namespace Internal {
                 break;
         }
 
+        const qsizetype start = result.size();
         if (restIsLowerCase) {
-            QString res = replaceText.toLower();
+            appendCase(result, replaceText, false);
             if (firstIsUpperCase)
-                res.replace(0, 1, res.at(0).toUpper());
-            return res;
+                result[start] = result.at(start).toUpper();
         } else if (restIsUpperCase) {
-            QString res = replaceText.toUpper();
+            appendCase(result, replaceText, true);
             if (firstIsLowerCase)
-                res.replace(0, 1, res.at(0).toLower());
-            return res;
+                result[start] = result.at(start).toLower();
         } else {
-            return replaceText; // mixed
+            result += replaceText; // mixed
         }
     }
 }
 
+static bool equalsIgnoringCase(QChar lhs, QChar rhs)
+{
+    if (lhs.unicode() < 0x80 && rhs.unicode() < 0x80) {
+        const char16_t l = isAsciiUpper(lhs.unicode()) ? lhs.unicode() - 'A' + 'a' : lhs.unicode();
+        const char16_t r = isAsciiUpper(rhs.unicode()) ? rhs.unicode() - 'A' + 'a' : rhs.unicode();
+        return l == r;
+    }
+    return lhs.toLower() == rhs.toLower();
+}
+
 // This function is copied from Qt Creator.
-QString matchCaseReplacement(const QString &originalText, const QString &replaceText)
+QString matchCaseReplacement(QStringView originalText, QStringView replaceText)
 {
     if (originalText.isEmpty())
-        return replaceText;
+        return replaceText.toString();
 
     // Find common prefix & suffix: these will be unaffected
-    const int replaceTextLen = replaceText.length();
-    const int originalTextLen = originalText.length();
+    const qsizetype replaceTextLen = replaceText.length();
+    const qsizetype originalTextLen = originalText.length();
 
-    int prefixLen = 0;
+    qsizetype prefixLen = 0;
     for (; prefixLen < replaceTextLen && prefixLen < originalTextLen; ++prefixLen)
-        if (replaceText.at(prefixLen).toLower() != originalText.at(prefixLen).toLower())
+        if (!equalsIgnoringCase(replaceText.at(prefixLen), originalText.at(prefixLen)))
             break;
 
-    int suffixLen = 0;
+    qsizetype suffixLen = 0;
     for (; suffixLen < replaceTextLen - prefixLen && suffixLen < originalTextLen - prefixLen; ++suffixLen)
-        if (replaceText.at(replaceTextLen - 1 - suffixLen).toLower()
-            != originalText.at(originalTextLen - 1 - suffixLen).toLower())
+        if (!equalsIgnoringCase(replaceText.at(replaceTextLen - 1 - suffixLen),
+                                originalText.at(originalTextLen - 1 - suffixLen)))
             break;
 
     // keep prefix and suffix, and do actual replacement on the 'middle' of the string
-    return originalText.left(prefixLen)
-        + Internal::matchCaseReplacement(originalText.mid(prefixLen, originalTextLen - prefixLen - suffixLen),
-                                         replaceText.mid(prefixLen, replaceTextLen - prefixLen - suffixLen))
-        + originalText.right(suffixLen);
+    QString result;
+    result.reserve(replaceTextLen);
+    result += originalText.first(prefixLen);
+    Internal::appendMatchCaseReplacement(result,
+                                         originalText.sliced(prefixLen, originalTextLen - prefixLen - suffixLen),
+                                         replaceText.sliced(prefixLen, replaceTextLen - prefixLen - suffixLen));
+    result += originalText.last(suffixLen);
+    return result;
 }
 
 // This function is copied from Qt creator.
@@ -223,7 +286,31 @@ QRegularExpression createRegularExpression(const QString &txt, int flags, bool i
     if (txt.contains('\n'))
         options |= QRegularExpression::MultilineOption;
 
-    return QRegularExpression(isRegExp ? txt : QRegularExpression::escape(txt), options);
+    return cachedRegularExpression(isRegExp ? txt : QRegularExpression::escape(txt), options);
+}
+
+QRegularExpression cachedRegularExpression(const QString &pattern, QRegularExpression::PatternOptions options)
+{
+    // Scripts use the same few patterns on many documents, there's no need to keep many of them
+    constexpr int MaxExpressions = 256;
+    using Key = std::pair<QString, int>;
+    static QMutex mutex;
+    static QCache<Key, QRegularExpression> cache(MaxExpressions);
+
+    const Key key {pattern, options.toInt()};
+    {
+        QMutexLocker locker(&mutex);
+        if (const auto *expression = cache.object(key))
+            return *expression;
+    }
+
+    // Compiled outside of the lock, the copies share the compiled (and JIT-compiled) pattern
+    auto expression = new QRegularExpression(pattern, options);
+    expression->optimize();
+    const auto result = *expression;
+    QMutexLocker locker(&mutex);
+    cache.insert(key, expression);
+    return result;
 }
 
 } // namespace Migration
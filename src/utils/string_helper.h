@@ -12,6 +12,7 @@
 
 #include <QRegularExpression>
 #include <QString>
+#include <QStringList>
 
 namespace Utils {
 
@@ -24,8 +25,13 @@ enum class Case {
     TitleCase,
 };
 QString convertCase(const QString &str, Case from, Case to);
+QStringList convertCase(const QStringList &strings, Case from, Case to);
 
-QString matchCaseReplacement(const QString &originalText, const QString &replaceText);
+QString matchCaseReplacement(QStringView originalText, QStringView replaceText);
+inline QString matchCaseReplacement(const QString &originalText, const QString &replaceText)
+{
+    return matchCaseReplacement(QStringView(originalText), QStringView(replaceText));
+}
 QString expandRegExpReplacement(const QString &replaceText, const QStringList &capturedTexts);
 
 /**
@@ -34,4 +40,13 @@ QString expandRegExpReplacement(const QString &replaceText, const QStringList &c
  */
 QRegularExpression createRegularExpression(const QString &txt, int flags, bool isRegExp = true);
 
+/**
+ * @brief cachedRegularExpression
+ * Returns the regular expression for the pattern and options, compiled and optimized only once. The expressions are
+ * kept in a bounded cache shared by the whole process, and can be used from any thread.
+ */
+QRegularExpression cachedRegularExpression(const QString &pattern,
+                                           QRegularExpression::PatternOptions options =
+                                               QRegularExpression::NoPatternOption);
+
 } // namespace Core
@@ -0,0 +1,117 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "taskscheduler.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <vector>
+
+namespace Utils {
+
+void TaskScheduler::setThreadCount(int count)
+{
+    auto pool = QThreadPool::globalInstance();
+    pool->setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+    // Idle threads are kept, with their parsers, instead of being started again for the next tasks
+    pool->setExpiryTimeout(-1);
+}
+
+int TaskScheduler::threadCount()
+{
+    return QThreadPool::globalInstance()->maxThreadCount();
+}
+
+class TaskGroup::Task : public QRunnable
+{
+public:
+    Task(std::shared_ptr<State> state, std::function<void()> function)
+        : m_state(std::move(state))
+        , m_function(std::move(function))
+    {
+    }
+
+    void run() override
+    {
+        {
+            std::lock_guard lock(m_state->mutex);
+            m_state->queued.erase(this);
+        }
+        if (!m_state->cancelled.load(std::memory_order_relaxed))
+            m_function();
+        // Released before notifying, the group may be gone right after
+        m_function = {};
+        std::lock_guard lock(m_state->mutex);
+        if (--m_state->pending == 0)
+            m_state->finished.notify_all();
+    }
+
+private:
+    std::shared_ptr<State> m_state;
+    std::function<void()> m_function;
+};
+
+TaskGroup::TaskGroup(TaskScheduler::Priority priority)
+    : m_priority(priority)
+    , m_state(std::make_shared<State>())
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskGroup::start(std::function<void()> task)
+{
+    auto runnable = new Task(m_state, std::move(task));
+    {
+        std::lock_guard lock(m_state->mutex);
+        ++m_state->pending;
+        m_state->queued.insert(runnable);
+    }
+    QThreadPool::globalInstance()->start(runnable, m_priority);
+}
+
+void TaskGroup::wait()
+{
+    // A task still in the queue is taken back and run here. Only the queue of the thread pool is searched for the
+    // pointers, so a task started by a worker in the meantime is never used.
+    std::vector<QRunnable *> queued;
+    {
+        std::lock_guard lock(m_state->mutex);
+        queued.assign(m_state->queued.begin(), m_state->queued.end());
+        m_state->queued.clear();
+    }
+    auto pool = QThreadPool::globalInstance();
+    for (auto task : queued) {
+        if (pool->tryTake(task)) {
+            task->run();
+            delete task;
+        }
+    }
+
+    std::unique_lock lock(m_state->mutex);
+    m_state->finished.wait(lock, [this]() {
+        return m_state->pending == 0;
+    });
+}
+
+void TaskGroup::cancel()
+{
+    m_state->cancelled.store(true, std::memory_order_relaxed);
+}
+
+bool TaskGroup::isCancelled() const
+{
+    return m_state->cancelled.load(std::memory_order_relaxed);
+}
+
+} // namespace Utils
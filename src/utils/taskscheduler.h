@@ -0,0 +1,92 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QThreadPool>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+namespace Utils {
+
+/**
+ * \brief Runs the work of all the knut subsystems on one set of worker threads
+ *
+ * All the tasks share the global QThreadPool, instead of each feature creating its own threads: the threads, and the
+ * tree-sitter parsers kept for each of them (see treesitter::ParserPool), are reused from one call to the next. Tasks
+ * waiting for a thread are run by priority, so the GUI work goes before the script work, which goes before the
+ * background indexing. The number of threads comes from the `/thread_count` setting, or the `-j` option.
+ */
+class TaskScheduler
+{
+public:
+    enum Priority {
+        Background = 0,
+        Script = 1,
+        Interactive = 2,
+    };
+
+    // Sets the number of worker threads, 0 or less uses the number of cores
+    static void setThreadCount(int count);
+    static int threadCount();
+
+    // Runs the task on a worker thread, without waiting for it
+    template <typename Task>
+    static void start(Task &&task, Priority priority = Background)
+    {
+        QThreadPool::globalInstance()->start(std::forward<Task>(task), priority);
+    }
+};
+
+/**
+ * \brief Tasks started together, and waited for together
+ *
+ * Waiting runs the tasks not started yet on the calling thread, instead of blocking it: the caller takes part in the
+ * work, and a task can itself start and wait for other tasks without exhausting the worker threads.
+ *
+ * Cancellation is cooperative: the tasks not started yet are skipped, the running ones can check isCancelled().
+ */
+class TaskGroup
+{
+public:
+    explicit TaskGroup(TaskScheduler::Priority priority = TaskScheduler::Script);
+    // Waits for all the tasks
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void start(std::function<void()> task);
+    void wait();
+
+    void cancel();
+    bool isCancelled() const;
+
+private:
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable finished;
+        int pending = 0;
+        // Tasks not run yet, only used to take them back from the queue of the thread pool
+        std::unordered_set<QRunnable *> queued;
+        std::atomic<bool> cancelled = false;
+    };
+    class Task;
+
+    const TaskScheduler::Priority m_priority;
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace Utils
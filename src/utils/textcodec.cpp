@@ -0,0 +1,138 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "textcodec.h"
+#include "log.h"
+
+#include <QStringDecoder>
+#include <QStringEncoder>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace Utils {
+
+// Characters 0x80 to 0x9f of Windows-1252, the other ones are the same as Latin-1. The 5 undefined characters are
+// mapped to the C1 control characters, like Windows does.
+static constexpr std::array<char16_t, 32> Windows1252 = {
+    0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021, 0x02c6, 0x2030, 0x0160,
+    0x2039, 0x0152, 0x008d, 0x017d, 0x008f, 0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022,
+    0x2013, 0x2014, 0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178};
+
+// Qt only knows Windows-1252 when built with ICU, it's common enough in legacy sources to be handled here
+static bool isWindows1252(const QString &encoding)
+{
+    return encoding.compare("windows-1252", Qt::CaseInsensitive) == 0
+        || encoding.compare("cp1252", Qt::CaseInsensitive) == 0;
+}
+
+static QString decodeWindows1252(QByteArrayView data)
+{
+    QString text(data.size(), Qt::Uninitialized);
+    auto *out = text.data();
+    for (const auto byte : data) {
+        const auto ch = static_cast<unsigned char>(byte);
+        *out++ = (ch >= 0x80 && ch < 0xa0) ? QChar(Windows1252[ch - 0x80]) : QChar(ch);
+    }
+    return text;
+}
+
+static void appendWindows1252(QByteArray &buffer, QStringView text)
+{
+    for (const auto ch : text) {
+        const auto unicode = ch.unicode();
+        if (unicode < 0x80 || (unicode >= 0xa0 && unicode < 0x100)) {
+            buffer.append(static_cast<char>(unicode));
+            continue;
+        }
+        const auto it = std::find(Windows1252.cbegin(), Windows1252.cend(), unicode);
+        buffer.append(it == Windows1252.cend() ? '?' : static_cast<char>(0x80 + (it - Windows1252.cbegin())));
+    }
+}
+
+bool isAscii(QByteArrayView data)
+{
+    // 8 bytes at a time, the loop is simple enough to be vectorized by the compiler
+    constexpr quint64 HighBits = 0x8080808080808080ULL;
+    const char *it = data.data();
+    const char *end = it + data.size();
+    quint64 bits = 0;
+    for (; end - it >= 8; it += 8) {
+        quint64 word;
+        std::memcpy(&word, it, 8);
+        bits |= word;
+    }
+    for (; it != end; ++it)
+        bits |= static_cast<unsigned char>(*it);
+    return (bits & HighBits) == 0;
+}
+
+DecodedText decodeText(QByteArrayView data, const QString &fallbackEncoding)
+{
+    DecodedText result;
+    if (data.startsWith("\xef\xbb\xbf")) {
+        result.utf8Bom = true;
+        data = data.sliced(3);
+    }
+
+    // Only the first line is read, whatever the size of the file
+    if (const auto newLine = static_cast<const char *>(std::memchr(data.data(), '\n', data.size()))) {
+        result.hasNewLine = true;
+        result.crlf = newLine != data.data() && *(newLine - 1) == '\r';
+    }
+
+    if (isAscii(data)) {
+        result.text = QString::fromLatin1(data);
+        return result;
+    }
+
+    // Same as QTextStream, a UTF-16 or UTF-32 BOM takes precedence
+    if (!result.utf8Bom) {
+        if (const auto bomEncoding = QStringConverter::encodingForData(data);
+            bomEncoding && *bomEncoding != QStringConverter::Utf8) {
+            QStringDecoder decoder(*bomEncoding);
+            result.text = decoder.decode(data);
+            return result;
+        }
+    }
+
+    QStringDecoder decoder(QStringDecoder::Utf8, QStringDecoder::Flag::Stateless);
+    result.text = decoder.decode(data);
+    if (!decoder.hasError() || fallbackEncoding.isEmpty() || result.utf8Bom)
+        return result;
+
+    if (isWindows1252(fallbackEncoding)) {
+        result.text = decodeWindows1252(data);
+        result.encoding = fallbackEncoding;
+        return result;
+    }
+    QStringDecoder fallbackDecoder(fallbackEncoding.toLatin1().constData());
+    if (!fallbackDecoder.isValid()) {
+        spdlog::warn("decodeText - unknown fallback encoding {}, the text is decoded as UTF-8", fallbackEncoding);
+        return result;
+    }
+    result.text = fallbackDecoder.decode(data);
+    result.encoding = fallbackEncoding;
+    return result;
+}
+
+void appendEncodedText(QByteArray &buffer, QStringView text, const QString &encoding)
+{
+    if (encoding.isEmpty()) {
+        buffer.append(text.toUtf8());
+    } else if (isWindows1252(encoding)) {
+        appendWindows1252(buffer, text);
+    } else {
+        QStringEncoder encoder(encoding.toLatin1().constData(), QStringEncoder::Flag::Stateless);
+        buffer.append(QByteArray(encoder.encode(text)));
+    }
+}
+
+} // namespace Utils
@@ -0,0 +1,47 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+
+namespace Utils {
+
+/**
+ * \brief Text of a file, decoded with its format
+ *
+ * Files are decoded as UTF-8, unless they are not valid UTF-8 and a fallback encoding is given: the encoding is then
+ * kept to write the text back the same way. Pure ASCII files, the most common ones, are checked 8 bytes at a time and
+ * widened directly, without going through the UTF-8 decoder.
+ */
+struct DecodedText
+{
+    QString text;
+    // Encoding of the file when it's not UTF-8, to be given back to encodeText
+    QString encoding;
+    bool utf8Bom = false;
+    // Line ending of the first line, false if the text has no line
+    bool hasNewLine = false;
+    bool crlf = false;
+};
+
+DecodedText decodeText(QByteArrayView data, const QString &fallbackEncoding = {});
+
+// Returns true if the data only has ASCII characters
+bool isAscii(QByteArrayView data);
+
+// Appends the text encoded with the encoding of a DecodedText (UTF-8 if it's empty) to the buffer. The characters that
+// can't be encoded are replaced with '?'.
+void appendEncodedText(QByteArray &buffer, QStringView text, const QString &encoding = {});
+
+} // namespace Utils
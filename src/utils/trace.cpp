@@ -0,0 +1,111 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QThread>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+
+namespace Utils {
+
+Trace::Trace()
+    : m_start(std::chrono::steady_clock::now())
+{
+}
+
+// The trace is written when the process exits, after all the spans are done
+Trace::~Trace()
+{
+    if (!m_enabled)
+        return;
+    const QString fileName = qEnvironmentVariable("KNUT_TRACE");
+    // spdlog may already be destroyed at this point
+    if (!save(fileName))
+        std::fprintf(stderr, "Trace - can't write the trace to %s\n", qPrintable(fileName));
+}
+
+Trace &Trace::instance()
+{
+    static Trace trace;
+    return trace;
+}
+
+qint64 Trace::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void Trace::add(const char *name, QString detail, qint64 start, qint64 end)
+{
+    // Threads are numbered in the order of their first span
+    thread_local int threadId = -1;
+
+    std::lock_guard lock(m_mutex);
+    if (threadId == -1) {
+        threadId = static_cast<int>(m_threadNames.size());
+        const auto thread = QThread::currentThread();
+        QString threadName = thread->objectName();
+        if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+            threadName = "Main thread";
+        else if (threadName.isEmpty())
+            threadName = QString("Thread %1").arg(threadId);
+        m_threadNames.push_back(threadName);
+    }
+    if (m_events.size() < MaxEvents)
+        m_events.push_back({name, std::move(detail), threadId, start, end - start});
+}
+
+std::string Trace::report() const
+{
+    std::lock_guard lock(m_mutex);
+
+    auto toMicroseconds = [](qint64 nanoseconds) {
+        return nanoseconds / 1000.0;
+    };
+
+    auto traceEvents = nlohmann::json::array();
+    for (size_t i = 0; i < m_threadNames.size(); ++i) {
+        traceEvents.push_back({{"name", "thread_name"},
+                               {"ph", "M"},
+                               {"pid", 1},
+                               {"tid", i},
+                               {"args", {{"name", m_threadNames[i].toStdString()}}}});
+    }
+    for (const auto &event : m_events) {
+        nlohmann::json traceEvent = {{"name", event.name},
+                                     {"ph", "X"},
+                                     {"ts", toMicroseconds(event.start)},
+                                     {"dur", toMicroseconds(event.duration)},
+                                     {"pid", 1},
+                                     {"tid", event.threadId}};
+        if (!event.detail.isEmpty())
+            traceEvent["args"] = {{"detail", event.detail.toStdString()}};
+        traceEvents.push_back(std::move(traceEvent));
+    }
+
+    const nlohmann::json json = {{"traceEvents", std::move(traceEvents)},
+                                 {"displayTimeUnit", "ms"},
+                                 {"truncated", m_events.size() == MaxEvents}};
+    return json.dump();
+}
+
+bool Trace::save(const QString &fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    file.write(QByteArray::fromStdString(report()));
+    return true;
+}
+
+} // namespace Utils
@@ -0,0 +1,110 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include "allocstats.h"
+
+#include <QString>
+#include <QtGlobal>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Traces the current scope, with an optional detail (a file name, a method...) shown with the span.
+ * Does nothing unless the KNUT_TRACE environment variable is set, see Utils::Trace: the detail is not even evaluated.
+ * The scope is also an allocation region in a KNUT_ALLOC_STATS build, see Utils::AllocStats.
+ */
+#define TRACE(name, ...)                                                                                               \
+    Utils::TraceScope TRACE_SCOPE_NAME(__LINE__)(name, [&]() {                                                         \
+        return QString(__VA_ARGS__);                                                                                   \
+    })
+// The line is expanded before being pasted, a scope can then hold several spans
+#define TRACE_SCOPE_NAME(line) TRACE_SCOPE_NAME_IMPL(line)
+#define TRACE_SCOPE_NAME_IMPL(line) traceScope_##line
+
+namespace Utils {
+
+/**
+ * \brief Timeline of the work done by knut, in the trace event format
+ *
+ * Enabled by setting the `KNUT_TRACE` environment variable to the file to write: the spans created with the TRACE
+ * macro are recorded, from all threads, and written to the file on exit. It can be opened in Perfetto or
+ * chrome://tracing. When disabled, a span only checks a boolean.
+ */
+class Trace
+{
+public:
+    static bool isEnabled() { return m_enabled; }
+    static Trace &instance();
+
+    // Time since the trace started, in nanoseconds
+    qint64 now() const;
+    void add(const char *name, QString detail, qint64 start, qint64 end);
+
+    // Trace events as json, with the name of each thread
+    std::string report() const;
+    bool save(const QString &fileName) const;
+
+private:
+    Trace();
+    ~Trace();
+
+    struct Event
+    {
+        const char *name;
+        QString detail;
+        int threadId;
+        qint64 start;
+        qint64 duration;
+    };
+    // Events are dropped past this limit, so a long run doesn't use all the memory
+    static constexpr size_t MaxEvents = 1'000'000;
+
+    inline static const bool m_enabled = qEnvironmentVariableIsSet("KNUT_TRACE");
+
+    const std::chrono::steady_clock::time_point m_start;
+    mutable std::mutex m_mutex;
+    std::vector<Event> m_events;
+    std::vector<QString> m_threadNames;
+};
+
+class TraceScope
+{
+public:
+    template <typename DetailFunction>
+    TraceScope(const char *name, DetailFunction detail)
+    {
+        AllocStats::enter(name);
+        if (!Trace::isEnabled())
+            return;
+        m_name = name;
+        m_detail = detail();
+        m_start = Trace::instance().now();
+    }
+    ~TraceScope()
+    {
+        if (m_name)
+            Trace::instance().add(m_name, std::move(m_detail), m_start, Trace::instance().now());
+        AllocStats::leave();
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *m_name = nullptr;
+    QString m_detail;
+    qint64 m_start = 0;
+};
+
+} // namespace Utils
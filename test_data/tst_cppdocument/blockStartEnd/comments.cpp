@@ -0,0 +1,8 @@
+void foo(int value)
+{
+    // Closing brace in a comment: }
+    const char *text = "{ ( [";
+    if (value) {
+        bar(text);
+    }
+}
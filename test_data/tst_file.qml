@@ -0,0 +1,53 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+import QtQuick
+import Script
+import Script.Test
+
+TestCase {
+    name: "File"
+
+    // The promises are resolved from the event loop
+    function waitFor(promise) {
+        var result
+        var done = false
+        promise.then(value => { result = value; done = true })
+        for (var i = 0; i < 100 && !done; ++i)
+            Utils.sleep(10)
+        verify(done)
+        return result
+    }
+
+    function test_readAllAsync() {
+        var fileName = Dir.currentScriptPath + "/tst_file.qml"
+        compare(waitFor(File.readAllAsync(fileName)), File.readAll(fileName))
+        compare(waitFor(File.readAllAsync(fileName + ".missing")), "")
+    }
+
+    function test_readMany() {
+        var fileNames = [Dir.currentScriptPath + "/tst_file.qml", Dir.currentScriptPath + "/tst_dir.qml",
+                         Dir.currentScriptPath + "/missing.qml"]
+        var contents = waitFor(File.readMany(fileNames))
+        compare(contents.length, 3)
+        compare(contents[0], File.readAll(fileNames[0]))
+        compare(contents[1], File.readAll(fileNames[1]))
+        compare(contents[2], "")
+        compare(waitFor(File.readMany([])).length, 0)
+    }
+
+    function test_copyAsync() {
+        var fileName = Utils.mktemp("tst_file")
+        File.remove(fileName)
+        compare(waitFor(File.copyAsync(Dir.currentScriptPath + "/tst_file.qml", fileName)), true)
+        compare(File.readAll(fileName), File.readAll(Dir.currentScriptPath + "/tst_file.qml"))
+        File.remove(fileName)
+    }
+}
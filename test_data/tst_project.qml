@@ -37,4 +37,14 @@ TestCase {
         compare(rcdoc.type, Document.Rc)
     }
 
+    function test_fileHash() {
+        Project.root = Dir.currentScriptPath + "/projects/mfc-tutorial"
+
+        var hash = Project.fileHash("TutorialDlg.cpp")
+        compare(hash.length, 40)
+        compare(Project.fileHash(Project.root + "/TutorialDlg.cpp"), hash)
+        verify(Project.fileHash("TutorialDlg.h") !== hash)
+        compare(Project.fileHash("missing.cpp"), "")
+    }
+
 }
@@ -15,6 +15,11 @@ import Script.Test
 TestCase {
     name: "Utils"
 
+    Timer {
+        id: timer
+        interval: 10
+    }
+
     function test_global() {
         Utils.setGlobal("foo", "bar")
         compare(Utils.getGlobal("foo"), "bar");
@@ -71,6 +76,45 @@ TestCase {
         verify(keywords.includes("delete"))
     }
 
+    function test_parallelMap() {
+        var fileNames = [Dir.currentScriptPath + "/tst_utils.qml", Dir.currentScriptPath + "/tst_dir.qml",
+                         Dir.currentScriptPath + "/tst_fileinfo.qml"]
+        var results = Utils.parallelMap(fileNames, Dir.currentScriptPath + "/tst_utils_map.mjs", {prefix: "file:"})
+        compare(results.length, 3)
+        for (var i = 0; i < fileNames.length; ++i) {
+            compare(results[i].name, "file:" + fileNames[i].substring(fileNames[i].lastIndexOf("/") + 1))
+            compare(results[i].lines, File.readAll(fileNames[i]).split("\n").length)
+        }
+
+        // The result is null if the function throws
+        results = Utils.parallelMap([Dir.currentScriptPath + "/tst_utils.qml"],
+                                    Dir.currentScriptPath + "/tst_utils_map.mjs", {fail: true})
+        compare(results[0], null)
+    }
+
+    function test_cache() {
+        // There's no cache when testing, the function is always called
+        var calls = 0
+        var compute = () => { ++calls; return {answer: 42} }
+        compare(Utils.cache("answer", "hash", compute).answer, 42)
+        compare(Utils.cache("answer", "hash", compute).answer, 42)
+        compare(calls, 2)
+    }
+
+    function test_waitFor() {
+        timer.start()
+        verify(Utils.waitFor(timer.triggered, 1000))
+        verify(!Utils.waitFor(timer.triggered, 20))
+
+        var done = false
+        Utils.delay(10).then(() => done = true)
+        verify(!done)
+        timer.start()
+        verify(Utils.waitFor(timer.triggered, 1000))
+        Utils.sleep(20)
+        verify(done)
+    }
+
     function test_cppPrimitiveTypes() {
         var primitiveTypes = Utils.cppPrimitiveTypes()
         verify(primitiveTypes.length > 0)
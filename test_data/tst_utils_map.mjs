@@ -0,0 +1,16 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+// Used by tst_utils.qml to test Utils.parallelMap
+export function map(fileName, text, args) {
+    if (args.fail)
+        throw new Error("map failed on " + fileName)
+    return {name: args.prefix + fileName.substring(fileName.lastIndexOf("/") + 1), lines: text.split("\n").length}
+}
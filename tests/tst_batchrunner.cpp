@@ -0,0 +1,71 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/batchrunner.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+#include <algorithm>
+#include <limits>
+
+class TestBatchRunner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void shardFiles()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QStringList files;
+        for (int i = 0; i < 20; ++i) {
+            const auto fileName = dir.filePath(QString("file%1.cpp").arg(i));
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(QByteArray((i % 5 + 1) * 100, 'x'));
+            files.push_back(fileName);
+        }
+
+        constexpr int Count = 3;
+        QStringList allFiles;
+        qint64 minSize = std::numeric_limits<qint64>::max();
+        qint64 maxSize = 0;
+        for (int index = 0; index < Count; ++index) {
+            const auto shard = Core::BatchRunner::shardFiles(files, index, Count);
+            // The shards are the same for each call, with the files in the same order
+            QCOMPARE(Core::BatchRunner::shardFiles(files, index, Count), shard);
+            QVERIFY(std::ranges::is_sorted(shard, {}, [&](const QString &file) {
+                return files.indexOf(file);
+            }));
+
+            qint64 size = 0;
+            for (const auto &file : shard)
+                size += QFileInfo(file).size();
+            minSize = std::min(minSize, size);
+            maxSize = std::max(maxSize, size);
+            allFiles += shard;
+        }
+
+        // Each file is in one shard, and the shards are balanced by size
+        allFiles.sort();
+        QStringList sortedFiles = files;
+        sortedFiles.sort();
+        QCOMPARE(allFiles, sortedFiles);
+        QVERIFY(maxSize - minSize <= 500);
+
+        QCOMPARE(Core::BatchRunner::shardFiles(files, 0, 1), files);
+        QVERIFY(Core::BatchRunner::shardFiles({}, 0, 2).isEmpty());
+    }
+};
+
+QTEST_APPLESS_MAIN(TestBatchRunner)
+#include "tst_batchrunner.moc"
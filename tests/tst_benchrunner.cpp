@@ -0,0 +1,67 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/benchrunner.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+#include <numeric>
+
+using Core::BenchRunner;
+
+class TestBenchRunner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void statistics()
+    {
+        auto statistics = BenchRunner::statistics({5, 1, 4, 2, 3});
+        QCOMPARE(statistics.min, qint64(1));
+        QCOMPARE(statistics.median, qint64(3));
+        QCOMPARE(statistics.p95, qint64(5));
+
+        // The median of an even number of runs is the mean of the two middle ones
+        statistics = BenchRunner::statistics({40, 10, 30, 20});
+        QCOMPARE(statistics.min, qint64(10));
+        QCOMPARE(statistics.median, qint64(25));
+        QCOMPARE(statistics.p95, qint64(40));
+
+        std::vector<qint64> values(100);
+        std::iota(values.begin(), values.end(), 1);
+        QCOMPARE(BenchRunner::statistics(values).p95, qint64(95));
+
+        QCOMPARE(BenchRunner::statistics({}).median, qint64(0));
+    }
+
+    void baseline()
+    {
+        BenchRunner::Result result {{90, 100, 120}, {40, 50, 60}, {50, 50, 60}};
+
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("baseline.json");
+        QVERIFY(BenchRunner::saveResult(result, fileName));
+        const auto baseline = BenchRunner::loadResult(fileName);
+        QVERIFY(baseline.has_value());
+        QCOMPARE(baseline->scriptTime.median, qint64(100));
+        QCOMPARE(baseline->apiTime.p95, qint64(60));
+        QCOMPARE(baseline->engineTime.min, qint64(50));
+        QVERIFY(!BenchRunner::loadResult(dir.filePath("missing.json")).has_value());
+
+        QVERIFY(!BenchRunner::isRegression(result, *baseline));
+        result.scriptTime.median = 109;
+        QVERIFY(!BenchRunner::isRegression(result, *baseline));
+        result.scriptTime.median = 111;
+        QVERIFY(BenchRunner::isRegression(result, *baseline));
+    }
+};
+
+QTEST_MAIN(TestBenchRunner)
+#include "tst_benchrunner.moc"
@@ -0,0 +1,99 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lsp/broker.h"
+#include "lsp/messagebuffer.h"
+
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QStandardPaths>
+#include <QTest>
+#include <memory>
+#include <string>
+
+// `cat` acts as the LSP server: every message sent to it comes back, so the notifications sent by a connection are
+// forwarded to all the connections.
+#define CHECK_CAT                                                                                                      \
+    if (QStandardPaths::findExecutable("cat").isEmpty())                                                               \
+        QSKIP("cat is necessary for this test");
+
+class TestBroker : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct Connection
+    {
+        std::unique_ptr<QLocalSocket> socket = std::make_unique<QLocalSocket>();
+        Lsp::MessageBuffer buffer;
+    };
+
+    static QString serverName()
+    {
+        return QString("knut-tst-broker-%1").arg(QCoreApplication::applicationPid());
+    }
+
+    static std::string nextMessage(Connection &connection)
+    {
+        std::string message;
+        QTest::qWaitFor([&]() {
+            connection.buffer.readFrom(connection.socket.get());
+            if (auto content = connection.buffer.getNextMessage()) {
+                message = *content;
+                return true;
+            }
+            return false;
+        });
+        return message;
+    }
+
+private slots:
+    void shutdown()
+    {
+        CHECK_CAT;
+
+        Lsp::Broker broker(serverName(), "cat", {}, 60);
+        QVERIFY(broker.start());
+
+        Connection connection;
+        connection.socket->connectToServer(serverName());
+        QVERIFY(connection.socket->waitForConnected());
+
+        // Answered by the broker, the server keeps running for the next knut process
+        Lsp::writeMessage(connection.socket.get(), R"({"jsonrpc":"2.0","id":"a","method":"shutdown"})");
+        QCOMPARE(nextMessage(connection), R"({"jsonrpc":"2.0","id":"a","result":null})");
+    }
+
+    void forwardNotifications()
+    {
+        CHECK_CAT;
+
+        Lsp::Broker broker(serverName(), "cat", {}, 60);
+        QVERIFY(broker.start());
+
+        Connection first;
+        Connection second;
+        for (auto connection : {&first, &second}) {
+            connection->socket->connectToServer(serverName());
+            QVERIFY(connection->socket->waitForConnected());
+            // Once answered, the broker knows about the connection
+            Lsp::writeMessage(connection->socket.get(), R"({"jsonrpc":"2.0","id":1,"method":"shutdown"})");
+            QCOMPARE(nextMessage(*connection), R"({"jsonrpc":"2.0","id":1,"result":null})");
+        }
+
+        const std::string notification = R"({"jsonrpc":"2.0","method":"custom/notify","params":{"value":1}})";
+        Lsp::writeMessage(first.socket.get(), notification);
+        QCOMPARE(nextMessage(first), notification);
+        QCOMPARE(nextMessage(second), notification);
+    }
+};
+
+QTEST_MAIN(TestBroker)
+#include "tst_broker.moc"
@@ -12,9 +12,12 @@
 #include "lsp/client.h"
 #include "lsp/requests.h"
 
+#include <QElapsedTimer>
 #include <QFile>
 #include <QTest>
 #include <QTextStream>
+#include <algorithm>
+#include <memory>
 
 class TestClient : public QObject
 {
@@ -33,6 +36,46 @@ private slots:
         QCOMPARE(client.state(), Lsp::Client::Shutdown);
     }
 
+    void shutdownAsync()
+    {
+        CHECK_CLANGD;
+
+        auto client = std::make_unique<Lsp::Client>("cpp", "clangd", QStringList {"--log=verbose", "--pretty"});
+        QVERIFY(client->initialize(Test::testDataPath()));
+
+        // Neither the shutdown nor the deletion of the client wait for the server
+        QElapsedTimer timer;
+        timer.start();
+        client->shutdownAsync();
+        QCOMPARE(client->state(), Lsp::Client::Shutdown);
+        client.reset();
+        QVERIFY(timer.elapsed() < 100);
+    }
+
+    void initializeAsync()
+    {
+        CHECK_CLANGD;
+
+        Lsp::Client client("cpp", "clangd", {"--log=verbose", "--pretty"});
+
+        client.initializeAsync(Test::testDataPath() + "/tst_client");
+        QCOMPARE(client.state(), Lsp::Client::Initializing);
+
+        // A request sent while initializing waits for the server to be ready
+        Lsp::DocumentSymbolParams params;
+        params.textDocument.uri = Lsp::Client::toUri(Test::testDataPath() + "/tst_client/myobject.cpp");
+        auto result = client.documentSymbol(std::move(params));
+        QCOMPARE(client.state(), Lsp::Client::Initialized);
+        QVERIFY(result.has_value());
+        QVERIFY(client.shutdown());
+
+        // A server that can't start doesn't block
+        Lsp::Client invalidClient("cpp", "knut_invalid_lsp_server", {});
+        invalidClient.initializeAsync();
+        QVERIFY(!invalidClient.waitForInitialized());
+        QCOMPARE(invalidClient.state(), Lsp::Client::Error);
+    }
+
     void openClose()
     {
         CHECK_CLANGD;
@@ -87,6 +130,225 @@ private slots:
 
         client.shutdown();
     }
+
+    void cachedResponses()
+    {
+        CHECK_CLANGD;
+
+        Lsp::Client client("cpp", "clangd", {"--log=verbose", "--pretty"});
+        client.initialize(Test::testDataPath() + "/tst_client");
+
+        const auto uri = Lsp::Client::toUri(Test::testDataPath() + "/tst_client/myobject.cpp");
+        Lsp::DidOpenTextDocumentParams openParams;
+        openParams.textDocument.uri = uri;
+        openParams.textDocument.version = 1;
+        openParams.textDocument.text = "void foo() {}\n";
+        openParams.textDocument.languageId = "cpp";
+        client.didOpen(std::move(openParams));
+
+        auto symbolCount = [&]() {
+            Lsp::DocumentSymbolParams params;
+            params.textDocument.uri = uri;
+            auto result = client.documentSymbol(std::move(params));
+            return std::get<std::vector<Lsp::DocumentSymbol>>(result.value()).size();
+        };
+        QCOMPARE(symbolCount(), size_t(1));
+        // Same version, the cached response is used
+        QCOMPARE(symbolCount(), size_t(1));
+
+        // The cache is invalidated by a change
+        Lsp::DidChangeTextDocumentParams changeParams;
+        changeParams.textDocument.uri = uri;
+        changeParams.textDocument.version = 2;
+        changeParams.contentChanges.push_back(
+            Lsp::TextDocumentContentChangeEventFull {"void foo() {}\nvoid bar() {}\n"});
+        client.didChange(std::move(changeParams));
+        QCOMPARE(symbolCount(), size_t(2));
+
+        // A response to a request sent before a change is not cached
+        Lsp::DocumentSymbolParams asyncParams;
+        asyncParams.textDocument.uri = uri;
+        auto future = client.documentSymbolAsync(std::move(asyncParams));
+        changeParams = {};
+        changeParams.textDocument.uri = uri;
+        changeParams.textDocument.version = 3;
+        changeParams.contentChanges = {
+            Lsp::TextDocumentContentChangeEventFull {"void foo() {}\nvoid bar() {}\nvoid baz() {}\n"}};
+        client.didChange(std::move(changeParams));
+        QTRY_VERIFY(future.isFinished());
+        QCOMPARE(symbolCount(), size_t(3));
+
+        client.shutdown();
+    }
+
+    void maxOpenDocuments()
+    {
+        CHECK_CLANGD;
+
+        Lsp::Client client("cpp", "clangd", {"--log=verbose", "--pretty"});
+        client.setMaxOpenDocuments(1);
+        client.initialize(Test::testDataPath() + "/tst_client");
+
+        auto openParams = [](const std::string &uri, const std::string &text) {
+            Lsp::DidOpenTextDocumentParams params;
+            params.textDocument.uri = uri;
+            params.textDocument.version = 1;
+            params.textDocument.text = text;
+            params.textDocument.languageId = "cpp";
+            return params;
+        };
+        const auto firstUri = Lsp::Client::toUri(Test::testDataPath() + "/tst_client/first.cpp");
+        const auto secondUri = Lsp::Client::toUri(Test::testDataPath() + "/tst_client/second.cpp");
+        int reopenCount = 0;
+        auto reopen = [&]() -> std::optional<Lsp::DidOpenTextDocumentParams> {
+            ++reopenCount;
+            return openParams(firstUri, "void foo() {}\nvoid bar() {}\n");
+        };
+        client.didOpen(openParams(firstUri, "void foo() {}\nvoid bar() {}\n"), reopen);
+        // The first document is closed on the server
+        client.didOpen(openParams(secondUri, "void foo() {}\n"));
+        QCOMPARE(reopenCount, 0);
+
+        // ...and opened again when needed
+        Lsp::DocumentSymbolParams params;
+        params.textDocument.uri = firstUri;
+        auto result = client.documentSymbol(std::move(params));
+        QCOMPARE(reopenCount, 1);
+        QCOMPARE(std::get<std::vector<Lsp::DocumentSymbol>>(result.value()).size(), size_t(2));
+
+        client.shutdown();
+    }
+
+    void shardedReferences()
+    {
+        CHECK_CLANGD;
+
+        Lsp::Client client("cpp", "clangd", {"--log=verbose", "--pretty"});
+        client.initialize(Test::testDataPath() + "/tst_client");
+        Lsp::Client shard("cpp", "clangd", {"--log=verbose", "--pretty"});
+        shard.initialize(Test::testDataPath() + "/tst_client");
+
+        QFile file(Test::testDataPath() + "/tst_client/myobject.cpp");
+        QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+        const auto uri = Lsp::Client::toUri(Test::testDataPath() + "/tst_client/myobject.cpp");
+        Lsp::DidOpenTextDocumentParams openParams;
+        openParams.textDocument.uri = uri;
+        openParams.textDocument.version = 1;
+        openParams.textDocument.text = file.readAll().toStdString();
+        openParams.textDocument.languageId = "cpp";
+        client.didOpen(std::move(openParams));
+
+        // m_message in the constructor
+        auto referenceCount = [&]() {
+            Lsp::ReferenceParams params;
+            params.textDocument.uri = uri;
+            params.position = {6, 6};
+            params.context.includeDeclaration = true;
+            auto result = client.references(std::move(params));
+            return std::get<std::vector<Lsp::Location>>(result.value()).size();
+        };
+        const auto count = referenceCount();
+        QVERIFY(count >= 2);
+
+        // Both servers find the same locations, they are only returned once
+        client.setShards({&client, &shard});
+        QCOMPARE(referenceCount(), count);
+
+        shard.shutdown();
+        client.shutdown();
+    }
+
+    void indexReady()
+    {
+        CHECK_CLANGD;
+
+        Lsp::Client client("cpp", "clangd", {"--log=verbose", "--pretty"});
+        QVERIFY(!client.isIndexReady());
+        client.initializeAsync(Test::testDataPath() + "/tst_client");
+        QVERIFY(!client.isIndexReady());
+
+        // Waiting for the index waits for the initialization first
+        QVERIFY(client.waitForIndexReady(10000));
+        QCOMPARE(client.state(), Lsp::Client::Initialized);
+
+        QFile file(Test::testDataPath() + "/tst_client/myobject.cpp");
+        QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+        const auto uri = Lsp::Client::toUri(Test::testDataPath() + "/tst_client/myobject.cpp");
+        Lsp::DidOpenTextDocumentParams openParams;
+        openParams.textDocument.uri = uri;
+        openParams.textDocument.version = 1;
+        openParams.textDocument.text = file.readAll().toStdString();
+        openParams.textDocument.languageId = "cpp";
+        client.didOpen(std::move(openParams));
+
+        // Without a compilation database, clangd has no background index to wait for
+        client.setIndexTimeout(10000);
+        Lsp::ReferenceParams params;
+        params.textDocument.uri = uri;
+        params.position = {6, 6};
+        params.context.includeDeclaration = true;
+        QVERIFY(client.references(std::move(params)).has_value());
+        QVERIFY(client.isIndexReady());
+
+        client.shutdown();
+        QVERIFY(!client.isIndexReady());
+    }
+
+    void workspaceSymbol()
+    {
+        CHECK_CLANGD;
+
+        Lsp::Client client("cpp", "clangd", {"--log=verbose", "--pretty"});
+        client.initialize(Test::testDataPath() + "/tst_client");
+
+        QFile file(Test::testDataPath() + "/tst_client/myobject.cpp");
+        QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+        const auto uri = Lsp::Client::toUri(Test::testDataPath() + "/tst_client/myobject.cpp");
+        Lsp::DidOpenTextDocumentParams openParams;
+        openParams.textDocument.uri = uri;
+        openParams.textDocument.version = 1;
+        openParams.textDocument.text = file.readAll().toStdString();
+        openParams.textDocument.languageId = "cpp";
+        client.didOpen(std::move(openParams));
+        // The symbols of the opened documents are indexed once parsed
+        Lsp::DocumentSymbolParams symbolParams;
+        symbolParams.textDocument.uri = uri;
+        QVERIFY(client.documentSymbol(std::move(symbolParams)).has_value());
+
+        std::vector<Lsp::SymbolInformation> symbols;
+        bool done = false;
+        auto addSymbols = [&](std::vector<Lsp::SymbolInformation> part, bool isDone) {
+            symbols.insert(symbols.end(), part.begin(), part.end());
+            done = isDone;
+        };
+        QVERIFY(client.workspaceSymbol("MyObj", addSymbols) != 0);
+        QTRY_VERIFY(done);
+        QVERIFY(std::ranges::any_of(symbols, [](const auto &symbol) {
+            return symbol.name == "MyObject";
+        }));
+
+        // The complete results are cached, and used for the longer queries
+        symbols.clear();
+        done = false;
+        QCOMPARE(client.workspaceSymbol("MyObj", addSymbols), 0);
+        QVERIFY(done);
+        QVERIFY(!symbols.empty());
+        const auto cached = client.cachedWorkspaceSymbols("MyObject");
+        QVERIFY(!cached.empty());
+        QVERIFY(std::ranges::all_of(cached, [](const auto &symbol) {
+            return QString::fromStdString(symbol.name).contains("MyObject", Qt::CaseInsensitive);
+        }));
+        QVERIFY(client.cachedWorkspaceSymbols("Other").empty());
+
+        // A cancelled request doesn't call its callback anymore
+        done = false;
+        const int id = client.workspaceSymbol("say", addSymbols);
+        client.cancelWorkspaceSymbol(id);
+        QTest::qWait(200);
+        QVERIFY(!done);
+
+        client.shutdown();
+    }
 };
 
 QTEST_MAIN(TestClient)
@@ -10,16 +10,31 @@
 
 #include "common/test_utils.h"
 #include "core/codedocument.h"
+#include "core/cppdocument.h"
 #include "core/knutcore.h"
 #include "core/lsp_utils.h"
 #include "core/project.h"
+#include "core/queryiterator.h"
 #include "core/querymatch.h"
+#include "core/queryresultcache.h"
+#include "core/settings.h"
+#include "treesitter/parser.h"
+#include "utils/counters.h"
 
 #include <QAction>
+#include <QDataStream>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
 #include <QPlainTextEdit>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
+#include <QUrl>
+#include <algorithm>
+#include <cstring>
 #include <kdalgorithms.h>
 
 class TestCodeDocument : public QObject
@@ -104,6 +119,25 @@ private slots:
         verifySymbol(headerDocument, headerSymbols.at(10), "MyObject::m_enum", Core::Symbol::Kind::Field, "m_enum");
     }
 
+    void lspSymbols()
+    {
+        CHECK_CLANGD_VERSION;
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        // The tree-sitter symbols are returned at once, the LSP ones are requested in the background
+        auto headerDocument = qobject_cast<Core::CodeDocument *>(project->open("myobject.h"));
+        QSignalSpy symbolsChanged(headerDocument, &Core::CodeDocument::symbolsChanged);
+        QCOMPARE(headerDocument->symbols().size(), 11);
+        QVERIFY(symbolsChanged.wait());
+
+        // All the symbols found by clangd are already known
+        QCOMPARE(headerDocument->symbols().size(), 11);
+        QCOMPARE(symbolsChanged.count(), 1);
+    }
+
     void symbolUnderCursor_data()
     {
         QTest::addColumn<QString>("fileName");
@@ -210,6 +244,79 @@ private slots:
         verifySymbol(headerDocument, symbol, "MyObject::m_message", Core::Symbol::Kind::Field, "m_message");
     }
 
+    void findSymbolIndex()
+    {
+        QTemporaryDir dir;
+        QFile file(dir.filePath("index.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("class Alpha {\n    void run();\n    int m_Run;\n};\nvoid Alpha::run() {}\nvoid Beta_run() {}\n");
+        file.close();
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        auto document = qobject_cast<Core::CodeDocument *>(project->open(dir.filePath("index.cpp")));
+        QVERIFY(document);
+
+        // The first symbol in the document wins, the declaration comes before the definition
+        auto symbol = document->findSymbol("run");
+        QVERIFY(symbol);
+        QCOMPARE(symbol->name(), "Alpha::run");
+        QCOMPARE(symbol->range().start, document->symbols().at(1)->range().start);
+        QCOMPARE(document->findSymbol("_RUN")->name(), "Alpha::m_Run");
+        QCOMPARE(document->findSymbol("_RUN", Core::TextDocument::FindCaseSensitively), nullptr);
+        QCOMPARE(document->findSymbol("_Run", Core::TextDocument::FindCaseSensitively)->name(), "Alpha::m_Run");
+        QCOMPARE(document->findSymbol("e_run", Core::TextDocument::FindCaseSensitively)->name(), "Beta_run");
+        QCOMPARE(document->findSymbol("alpha::RUN", Core::TextDocument::FindWholeWords)->name(), "Alpha::run");
+        QCOMPARE(document->findSymbol("run", Core::TextDocument::FindWholeWords), nullptr);
+        QCOMPARE(document->findSymbol("^Beta", Core::TextDocument::FindRegexp)->name(), "Beta_run");
+        QCOMPARE(document->findSymbol("Gamma"), nullptr);
+
+        // The index follows the changes of the document
+        document->gotoEndOfDocument();
+        document->insert("void Gamma() {}\n");
+        QCOMPARE(document->findSymbol("gamma", Core::TextDocument::FindWholeWords)->name(), "Gamma");
+    }
+
+    void symbolContaining()
+    {
+        QTemporaryDir dir;
+        QFile file(dir.filePath("ranges.cpp"));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("class Alpha {\n    void run() {}\n    int m_count;\n};\nvoid beta() {}\n");
+        file.close();
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        auto document = qobject_cast<Core::CodeDocument *>(project->open(dir.filePath("ranges.cpp")));
+        QVERIFY(document);
+
+        auto name = [](const Core::Symbol *symbol) {
+            return symbol ? symbol->name() : QString();
+        };
+        const int runPosition = document->text().indexOf("{}");
+        QCOMPARE(name(document->symbolContaining(runPosition)), "Alpha::run");
+        QCOMPARE(name(document->symbolContaining(runPosition, [](const Core::Symbol &symbol) {
+                     return symbol.kind() == Core::Symbol::Kind::Class;
+                 })),
+                 "Alpha");
+        QCOMPARE(name(document->symbolContaining(document->text().indexOf("beta"))), "beta");
+        QCOMPARE(document->symbolContaining(-1), nullptr);
+
+        document->setPosition(document->text().indexOf("m_count") + 2);
+        QCOMPARE(name(document->symbolUnderCursor()), "Alpha::m_count");
+        document->setPosition(document->text().indexOf("int"));
+        QCOMPARE(name(document->symbolUnderCursor()), QString());
+
+        // Without reparse, the symbols after a change are moved, the changed ones are only found once extracted
+        document->setPosition(0);
+        document->insert("void gamma() {}\n");
+        QCOMPARE(name(document->symbolContaining(document->text().indexOf("beta"), {}, false)), "beta");
+        QCOMPARE(document->symbolContaining(document->text().indexOf("gamma"), {}, false), nullptr);
+        QCOMPARE(name(document->symbolContaining(document->text().indexOf("gamma"))), "gamma");
+    }
+
     void followSymbol()
     {
         CHECK_CLANGD_VERSION;
@@ -434,6 +541,723 @@ private slots:
                       )EOF");
 
         QCOMPARE(matches.size(), 2);
+
+        // Only matches entirely in the range are returned, even if the query partially overlaps it
+        codedocument->gotoLine(8);
+        const auto start = codedocument->position();
+        codedocument->gotoLine(14);
+        range = codedocument->createRangeMark(start, codedocument->position());
+
+        matches = codedocument->queryInRange(range, "(function_definition) @function");
+        QCOMPARE(matches.size(), 0);
+        matches = codedocument->queryInRange(range, "(call_expression) @call");
+        QCOMPARE(matches.size(), 3);
+        QCOMPARE(matches.at(2).get("call").text(), "freeFunction(1, 1)");
+
+        // The pattern is checked, not only its captures: the function contains the range, so it's not a match
+        const QString declarator = "main(int argc, char *argv[])";
+        const auto declaratorStart = codedocument->text().indexOf(declarator);
+        range = codedocument->createRangeMark(declaratorStart, declaratorStart + declarator.size());
+        matches = codedocument->queryInRange(range, "(function_definition declarator: (_) @name)");
+        QCOMPARE(matches.size(), 0);
+        matches = codedocument->queryInRange(range, "(function_declarator declarator: (_) @name) @declarator");
+        QCOMPARE(matches.size(), 1);
+        QCOMPARE(matches.first().get("name").text(), "main");
+    }
+
+    void transaction()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        const QString query = "(function_definition declarator: (_) @declarator) @function";
+        const auto count = codedocument->query(query).size();
+
+        // The syntax tree is updated once with all the changes
+        codedocument->beginTransaction();
+        codedocument->insertAtPosition("void added1() {}\n", 0);
+        codedocument->gotoEndOfDocument();
+        codedocument->insert("\nvoid added2() {}\n");
+        codedocument->insertAtPosition("void added3() {}\n", 0);
+        codedocument->commit();
+        QCOMPARE(codedocument->query(query).size(), count + 3);
+
+        // Queries done during a transaction see the changes done so far
+        codedocument->beginTransaction();
+        codedocument->insertAtPosition("void added4() {}\n", 0);
+        QCOMPARE(codedocument->query(query).size(), count + 4);
+        codedocument->deleteRegion(0, 17);
+        codedocument->commit();
+        QCOMPARE(codedocument->query(query).size(), count + 3);
+
+        Test::LogCounter counter;
+        codedocument->commit();
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void queryIterator()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        // The iterator returns the same matches as query, one at a time
+        const QString query = "(function_definition declarator: (_) @declarator) @function";
+        const auto matches = codedocument->query(query);
+        QVERIFY(matches.size() > 1);
+
+        std::unique_ptr<Core::QueryIterator> iterator(codedocument->queryIterator(query));
+        QVERIFY(iterator->isValid());
+        for (const auto &match : matches) {
+            QVERIFY(iterator->hasNext());
+            // hasNext doesn't consume the match
+            QVERIFY(iterator->hasNext());
+            QCOMPARE(iterator->next().get("declarator").text(), match.get("declarator").text());
+        }
+        QVERIFY(!iterator->hasNext());
+        QVERIFY(iterator->next().isEmpty());
+        QVERIFY(iterator->isValid());
+
+        // Changing the document invalidates the iterator, but not the matches already returned
+        iterator.reset(codedocument->queryIterator(query));
+        const auto first = iterator->next();
+        const auto declarator = first.get("declarator").text();
+        codedocument->insertAtPosition("// Comment\n", 0);
+        QVERIFY(!iterator->isValid());
+        QVERIFY(!iterator->hasNext());
+        {
+            Test::LogCounter counter;
+            QVERIFY(iterator->next().isEmpty());
+            QCOMPARE(counter.count(), 1);
+        }
+        QCOMPARE(first.get("declarator").text(), declarator);
+        codedocument->undo();
+
+        // Invalid queries return an iterator without matches
+        Test::LogCounter counter;
+        iterator.reset(codedocument->queryIterator("invalid query"));
+        QVERIFY(!iterator->hasNext());
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void queryMany()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+
+        // Same matches as running each query on its own
+        const QString functions = "(function_definition declarator: (_) @declarator) @function";
+        const QString calls = "(call_expression function: (_) @function)";
+        const auto result = codedocument->queryMany({{"functions", functions}, {"calls", calls}});
+        QCOMPARE(result.size(), 2);
+        for (const auto &[name, query] : {std::pair {"functions", functions}, std::pair {"calls", calls}}) {
+            const auto expected = codedocument->query(query);
+            const auto matches = result.value(name).toList();
+            QCOMPARE(matches.size(), expected.size());
+            for (int i = 0; i < matches.size(); ++i)
+                QCOMPARE(matches.at(i).value<Core::QueryMatch>().captures().size(), expected.at(i).captures().size());
+        }
+
+        // An invalid query fails all of them
+        Test::LogCounter counter;
+        const auto invalid = codedocument->queryMany({{"functions", functions}, {"invalid", "invalid query"}});
+        QVERIFY(invalid.value("functions").toList().isEmpty());
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void queryAll()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        const QString query = "(function_definition declarator: (_) @declarator) @function";
+        const auto matches = project->queryAll({"cpp"}, query);
+        QVERIFY(!matches.isEmpty());
+
+        // The result should be the same as running the query on each document
+        int index = 0;
+        for (const auto &fileName : project->allFilesWithExtension("cpp", Core::Project::FullPath)) {
+            auto document = qobject_cast<Core::CodeDocument *>(project->get(fileName));
+            QVERIFY(document);
+            const auto documentMatches = document->query(query);
+            for (const auto &documentMatch : documentMatches) {
+                QVERIFY(index < matches.size());
+                const auto &match = matches.at(index++);
+                QCOMPARE(match.fileName(), fileName);
+                const auto capture = match.get("declarator");
+                QCOMPARE(capture.text, documentMatch.get("declarator").text());
+                QCOMPARE(capture.range.start, documentMatch.get("declarator").start());
+                QCOMPARE(capture.range.end, documentMatch.get("declarator").end());
+            }
+        }
+        QCOMPARE(index, matches.size());
+
+        Test::LogCounter counter;
+        QVERIFY(project->queryAll({"cpp"}, "invalid query").isEmpty());
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void transformAll()
+    {
+        QTemporaryDir dir;
+        auto writeFile = [&dir](const QString &fileName, const QByteArray &data) {
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        auto readFile = [&dir](const QString &fileName) {
+            QFile file(dir.filePath(fileName));
+            return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+        };
+        writeFile("crlf.cpp", "int foo() { return 1; }\r\nvoid bar() { foo(); }\r\n");
+        writeFile("lf.cpp", "void baz() { foo(); }\n");
+        writeFile("unchanged.cpp", "int value = 1;\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        const QString query = "(call_expression function: (identifier) @name (#eq? @name \"foo\")) @from";
+        const auto result = project->transformAll({"cpp"}, query, "qux()");
+        QCOMPARE(result.size(), 2);
+        QCOMPARE(result.value(dir.filePath("crlf.cpp")).toInt(), 1);
+        QCOMPARE(result.value(dir.filePath("lf.cpp")).toInt(), 1);
+
+        // Line endings are kept, and only the changed files are written
+        QCOMPARE(readFile("crlf.cpp"), QByteArray("int foo() { return 1; }\r\nvoid bar() { qux(); }\r\n"));
+        QCOMPARE(readFile("lf.cpp"), QByteArray("void baz() { qux(); }\n"));
+        QCOMPARE(readFile("unchanged.cpp"), QByteArray("int value = 1;\n"));
+
+        // Opened documents are changed in memory
+        auto document = qobject_cast<Core::CodeDocument *>(project->get(dir.filePath("lf.cpp")));
+        QVERIFY(document);
+        const auto documentResult = project->transformAll(
+            {"cpp"}, "(call_expression function: (identifier) @name (#eq? @name \"qux\")) @from", "quux()");
+        QCOMPARE(documentResult.value(dir.filePath("lf.cpp")).toInt(), 1);
+        QCOMPARE(document->text(), "void baz() { quux(); }\n");
+        QCOMPARE(readFile("lf.cpp"), QByteArray("void baz() { qux(); }\n"));
+
+        Test::LogCounter counter;
+        QVERIFY(project->transformAll({"cpp"}, "invalid query", "").isEmpty());
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void lazyTextLocations()
+    {
+        QTemporaryDir dir;
+        auto writeFile = [&dir](const QString &fileName, const QByteArray &data) {
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        writeFile("crlf.cpp", "int foo();\r\nvoid bar() { foo(); }\r\n");
+        writeFile("opened.cpp", "void baz() {\n    foo();\n}\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        auto opened = qobject_cast<Core::CodeDocument *>(project->get(dir.filePath("opened.cpp")));
+        QVERIFY(opened);
+
+        auto toUri = [&dir](const QString &fileName) {
+            return QUrl::fromLocalFile(dir.filePath(fileName)).toEncoded().toStdString();
+        };
+        auto location = [](std::string uri, unsigned line, unsigned character, unsigned length) {
+            return Lsp::Location {.uri = std::move(uri),
+                                  .range = {.start = {.line = line, .character = character},
+                                            .end = {.line = line, .character = character + length}}};
+        };
+        const std::vector<Lsp::Location> locations {location(toUri("crlf.cpp"), 0, 4, 3),
+                                                    location(toUri("crlf.cpp"), 1, 13, 3),
+                                                    location(toUri("opened.cpp"), 1, 4, 3),
+                                                    // Past the end of the line
+                                                    location(toUri("crlf.cpp"), 0, 8, 10),
+                                                    location(toUri("missing.cpp"), 0, 0, 3)};
+
+        const auto documentCount = project->documents().size();
+        const auto textLocations = Core::Utils::lspToTextLocationList(locations);
+        QCOMPARE(textLocations.size(), 4);
+        QCOMPARE(textLocations[0].range, Core::TextRange({4, 7}));
+        QCOMPARE(textLocations[1].range, Core::TextRange({24, 27}));
+        QCOMPARE(textLocations[2].range, Core::TextRange({17, 20}));
+        QCOMPARE(textLocations[3].range, Core::TextRange({8, 10}));
+        QCOMPARE(textLocations[2].document.get(), opened);
+        // No document is opened until one is accessed
+        QCOMPARE(project->documents().size(), documentCount);
+        QCOMPARE(textLocations[0].fileName(), dir.filePath("crlf.cpp"));
+
+        auto document = textLocations[1].codeDocument();
+        QVERIFY(document);
+        QCOMPARE(project->documents().size(), documentCount + 1);
+        document->selectRange(textLocations[1].range);
+        QCOMPARE(document->selectedText(), "foo");
+    }
+
+    void prefetch()
+    {
+        QTemporaryDir dir;
+        auto writeFile = [&dir](const QString &fileName, const QByteArray &data) {
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        writeFile("crlf.cpp", "int foo() { return 1; }\r\nvoid bar() { foo(); }\r\n");
+        writeFile("main.cpp", "int main() { return 0; }\n");
+        writeFile("notes.txt", "Some notes\n");
+        writeFile("changed.cpp", "int value = 1;\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        const auto before = Utils::Counters::value(Utils::Counters::DocumentsPrefetched);
+        project->prefetch({"crlf.cpp", "main.cpp", "notes.txt", "changed.cpp"});
+
+        // The document is the same as when loaded from the file, with its syntax tree already parsed
+        auto crlf = qobject_cast<Core::CodeDocument *>(project->get("crlf.cpp"));
+        QVERIFY(crlf);
+        QCOMPARE(Utils::Counters::value(Utils::Counters::DocumentsPrefetched), before + 1);
+        QCOMPARE(crlf->text(), "int foo() { return 1; }\nvoid bar() { foo(); }\n");
+        QCOMPARE(crlf->lineEnding(), Core::TextDocument::CRLFLineEnding);
+        const auto fullParses = Utils::Counters::value(Utils::Counters::FullParses);
+        QCOMPARE(crlf->query("(function_definition) @function").size(), 2);
+        QCOMPARE(Utils::Counters::value(Utils::Counters::FullParses), fullParses);
+
+        // A file changed since it was read is loaded again (it may also be read after the change), the size changes
+        // too so it doesn't depend on the file time resolution
+        writeFile("changed.cpp", "int value = 42;\n");
+        const auto documents = project->openAll({"main.cpp", "notes.txt", "changed.cpp"});
+        QCOMPARE(documents.size(), 3);
+        QCOMPARE(documents.at(0)->fileName(), dir.filePath("main.cpp"));
+        QCOMPARE(qobject_cast<Core::TextDocument *>(documents.at(1))->text(), "Some notes\n");
+        QCOMPARE(qobject_cast<Core::TextDocument *>(documents.at(2))->text(), "int value = 42;\n");
+        QVERIFY(Utils::Counters::value(Utils::Counters::DocumentsPrefetched) >= before + 3);
+
+        // A file queued again after closeAll is prefetched, even if it was still being read when dropped
+        project->closeAll();
+        project->prefetch({"main.cpp"});
+        project->closeAll();
+        project->prefetch({"main.cpp"});
+        const auto prefetched = Utils::Counters::value(Utils::Counters::DocumentsPrefetched);
+        QVERIFY(project->get("main.cpp"));
+        QCOMPARE(Utils::Counters::value(Utils::Counters::DocumentsPrefetched), prefetched + 1);
+    }
+
+    void ignoredFiles()
+    {
+        QTemporaryDir dir;
+        auto writeFile = [&dir](const QString &fileName, const QByteArray &data) {
+            QDir().mkpath(QFileInfo(dir.filePath(fileName)).absolutePath());
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        writeFile("main.cpp", "int main() { return 0; }\n");
+        writeFile("build/generated.cpp", "int value = 1;\n");
+        writeFile(".gitignore", "build/\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        QCOMPARE(project->allFiles(), QStringList({".gitignore", "main.cpp"}));
+
+        // The listing is kept until the index changes
+        const QStringList files = project->indexedFiles();
+        QVERIFY(project->indexedFiles().isSharedWith(files));
+
+        // Editing the ignore file in place doesn't change its directory, the file itself is watched
+        writeFile(".gitignore", "*.txt\n");
+        QTRY_COMPARE(project->allFiles(), QStringList({".gitignore", "build/generated.cpp", "main.cpp"}));
+        QVERIFY(!project->indexedFiles().isSharedWith(files));
+    }
+
+    void includeIndex()
+    {
+        QTemporaryDir dir;
+        auto writeFile = [&dir](const QString &fileName, const QByteArray &data) {
+            QDir().mkpath(QFileInfo(dir.filePath(fileName)).absolutePath());
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        writeFile("stdafx.h", "#pragma once\n#include <vector>\n");
+        writeFile("core/object.h", "#include \"stdafx.h\"\nclass Object {};\n");
+        writeFile("core/object.cpp", "#include \"object.h\"\n#include \"../stdafx.h\"\n");
+        writeFile("gui/widget.cpp", "#include <core/object.h>\n// #include \"unused.h\"\n");
+        writeFile("gui/unused.h", "");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        QCOMPARE(project->includes("core/object.cpp"), QStringList({"core/object.h", "stdafx.h"}));
+        // Includes not in the project are ignored, as well as the ones in comments
+        QVERIFY(project->includes("stdafx.h").isEmpty());
+        QCOMPARE(project->includes("gui/widget.cpp"), QStringList({"core/object.h"}));
+
+        QCOMPARE(project->includers("stdafx.h"), QStringList({"core/object.cpp", "core/object.h"}));
+        QCOMPARE(project->includers("stdafx.h", true),
+                 QStringList({"core/object.cpp", "core/object.h", "gui/widget.cpp"}));
+        QCOMPARE(project->includers(dir.filePath("core/object.h"), false, Core::Project::FullPath),
+                 QStringList({dir.filePath("core/object.cpp"), dir.filePath("gui/widget.cpp")}));
+
+        // The index is updated when a document is changed
+        auto document = qobject_cast<Core::CppDocument *>(project->get("gui/widget.cpp"));
+        QVERIFY(document);
+        document->setText("#include \"unused.h\"\n#include \"new.h\"\n");
+        QVERIFY(document->save());
+        QCOMPARE(project->includes("gui/widget.cpp"), QStringList({"gui/unused.h"}));
+        QCOMPARE(project->includers("stdafx.h", true), QStringList({"core/object.cpp", "core/object.h"}));
+    }
+
+    void queryResultCache()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        auto codedocument = qobject_cast<Core::CodeDocument *>(Core::Project::instance()->get("main.cpp"));
+        const QString query = "(function_definition declarator: (_) @declarator) @function";
+        const auto tsQuery = treesitter::QueryCache::instance().get(
+            treesitter::Parser::getLanguage(Core::Document::Type::Cpp), query);
+        const auto matches = codedocument->query(query);
+        QVERIFY(!matches.isEmpty());
+
+        // The key changes with the text, the language and the query
+        const auto text = codedocument->plainText();
+        const auto key = Core::QueryResultCache::key(text, Core::Document::Type::Cpp, query);
+        QCOMPARE(Core::QueryResultCache::key(text, Core::Document::Type::Cpp, query), key);
+        QVERIFY(Core::QueryResultCache::key(text + " ", Core::Document::Type::Cpp, query) != key);
+        QVERIFY(Core::QueryResultCache::key(text, Core::Document::Type::Qml, query) != key);
+        QVERIFY(Core::QueryResultCache::key(text, Core::Document::Type::Cpp, query + " ") != key);
+
+        QTemporaryDir cacheDir;
+        const Core::QueryResultCache cache(cacheDir.path());
+        QVERIFY(!cache.load(key).has_value());
+
+        const auto captures = tsQuery->captures();
+        Core::QueryResultCache::MatchList cachedMatches;
+        for (const auto &match : matches) {
+            Core::QueryResultCache::Match cachedMatch;
+            for (const auto &capture : match.captures()) {
+                const auto it = std::ranges::find(captures, capture.name, &treesitter::Query::Capture::name);
+                QVERIFY(it != captures.end());
+                cachedMatch.push_back({.id = it->id, .start = capture.range.start(), .end = capture.range.end()});
+            }
+            cachedMatches.push_back(cachedMatch);
+        }
+        cache.save(key, cachedMatches);
+
+        // The matches read back are the same as the ones found by the query
+        const auto loaded = cache.load(key);
+        QVERIFY(loaded.has_value());
+        QCOMPARE(loaded->size(), static_cast<size_t>(matches.size()));
+        for (int i = 0; i < matches.size(); ++i) {
+            const Core::QueryMatch match(*codedocument, tsQuery, loaded->at(i));
+            QCOMPARE(match.get("function").start(), matches.at(i).get("function").start());
+            QCOMPARE(match.get("declarator").text(), matches.at(i).get("declarator").text());
+        }
+
+        // A corrupted match count is rejected, without allocating the matches
+        QDirIterator it(cacheDir.path(), QDir::Files, QDirIterator::Subdirectories);
+        QVERIFY(it.hasNext());
+        const auto cacheFileName = it.next();
+        QVERIFY(!cacheFileName.endsWith(".qrc"));
+        QFile cacheFile(cacheFileName);
+        QVERIFY(cacheFile.open(QIODevice::ReadWrite));
+        // Magic, version and key (its size and 40 hexadecimal digits), then the count
+        QVERIFY(cacheFile.seek(4 + 4 + 4 + 40));
+        QDataStream stream(&cacheFile);
+        stream << quint32(0x7fffffff);
+        cacheFile.resize(cacheFile.pos());
+        cacheFile.close();
+        {
+            Test::LogCounter counter(spdlog::level::warn);
+            QVERIFY(!cache.load(key).has_value());
+            QCOMPARE(counter.count(), 1);
+        }
+
+        // Without a cache directory, nothing is stored
+        const Core::QueryResultCache disabled {QString()};
+        QVERIFY(!disabled.isEnabled());
+        disabled.save(key, cachedMatches);
+        QVERIFY(!disabled.load(key).has_value());
+    }
+
+    void incrementalParsing()
+    {
+        Core::KnutCore core;
+
+        // Don't use a document from the project here, it would be saved on close.
+        Core::CppDocument document;
+        auto codedocument = &document;
+        QFile file(Test::testDataPath() + "/projects/cpp-project/main.cpp");
+        QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+        codedocument->setText(QString::fromUtf8(file.readAll()));
+
+        const auto functionQuery = QString(R"EOF(
+                (function_definition
+                  declarator: (function_declarator
+                    declarator: (identifier) @name))
+                      )EOF");
+
+        const auto functionCount = codedocument->query(functionQuery).size();
+
+        // Add a function at the end, and one at the start (spanning multiple lines)
+        codedocument->gotoEndOfDocument();
+        codedocument->insert("\nvoid addedAtEnd() {}\n");
+        codedocument->gotoStartOfDocument();
+        codedocument->insert("void addedAtStart()\n{\n}\n");
+
+        auto matches = codedocument->query(functionQuery);
+        QCOMPARE(matches.size(), functionCount + 2);
+        QCOMPARE(matches.first().get("name").text(), "addedAtStart");
+        QCOMPARE(matches.last().get("name").text(), "addedAtEnd");
+
+        // Rename a function, the tree needs to pick up the edit in the middle of an identifier
+        QVERIFY(codedocument->replaceOne("addedAtStart", "renamedFunction"));
+        matches = codedocument->query(functionQuery);
+        QCOMPARE(matches.size(), functionCount + 2);
+        QCOMPARE(matches.first().get("name").text(), "renamedFunction");
+
+        // Removing the function again
+        codedocument->deleteRegion(0, QString("void renamedFunction()\n{\n}\n").size());
+        QCOMPARE(codedocument->query(functionQuery).size(), functionCount + 1);
+
+        // Replacing the whole text falls back to a full parse
+        codedocument->setText("void onlyFunction() {}\n");
+        matches = codedocument->query(functionQuery);
+        QCOMPARE(matches.size(), 1);
+        QCOMPARE(matches.first().get("name").text(), "onlyFunction");
+    }
+
+    void lazyCaptures()
+    {
+        Core::KnutCore core;
+
+        Core::CppDocument document;
+        document.setText("void foo() {}\nvoid bar() {}\n");
+
+        const auto matches = document.query("(function_declarator declarator: (identifier) @name)");
+        QCOMPARE(matches.size(), 2);
+
+        // The captures are created after the edit, they must still be at the right place
+        document.gotoStartOfDocument();
+        document.insert("int i;\n");
+        QCOMPARE(matches.first().get("name").text(), "foo");
+        QCOMPARE(matches.last().get("name").text(), "bar");
+
+        // Copies of a match share their captures
+        const auto copy = matches.first();
+        document.replaceOne("foo", "renamed");
+        QCOMPARE(copy.get("name").text(), "renamed");
+        QCOMPARE(matches.first().captures().size(), 1);
+    }
+
+    void incrementalSymbols()
+    {
+        Core::KnutCore core;
+
+        // Don't use a document from the project here, it would be saved on close.
+        Core::CppDocument document;
+        QFile file(Test::testDataPath() + "/projects/cpp-project/myobject.h");
+        QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+        document.setText(QString::fromUtf8(file.readAll()));
+
+        auto symbolsToString = [](Core::CodeDocument &codeDocument) {
+            QStringList result;
+            for (const auto *symbol : codeDocument.symbols())
+                result.push_back(QString("%1 %2 %3 %4")
+                                     .arg(symbol->name())
+                                     .arg(symbol->kind())
+                                     .arg(symbol->range().toString(), symbol->selectionRange().toString()));
+            return result;
+        };
+        QCOMPARE(symbolsToString(document).size(), 11);
+
+        // Symbols after the edits must be the same as the symbols of a fresh parse
+        auto verifySymbols = [&]() {
+            Core::CppDocument fresh;
+            fresh.setText(document.text());
+            QCOMPARE(symbolsToString(document), symbolsToString(fresh));
+        };
+
+        // Add a function before the class, the class symbols are moved
+        document.gotoStartOfDocument();
+        document.insert("void addedAtStart();\n");
+        verifySymbols();
+
+        // Add a member inside the class
+        QVERIFY(document.find("std::string m_message;"));
+        document.gotoEndOfLine();
+        document.insert("\n    int m_added;");
+        verifySymbols();
+
+        // Close the class early, its last members become free declarations
+        QVERIFY(document.find("std::string m_message;"));
+        document.gotoStartOfLine();
+        document.insert("};\n");
+        verifySymbols();
+    }
+
+    void lazySymbols()
+    {
+        Core::KnutCore core;
+
+        Core::CppDocument document;
+        document.setText("class Foo {\n    void bar();\n};\nvoid Foo::bar() {}\n");
+
+        // The same Symbol is returned as long as the symbol is valid
+        auto symbol = document.findSymbol("Foo::bar", Core::TextDocument::FindWholeWords);
+        QVERIFY(symbol);
+        QCOMPARE(symbol->kind(), Core::Symbol::Method);
+        QCOMPARE(document.symbols().at(1), symbol);
+        QCOMPARE(document.findSymbol("Foo::bar", Core::TextDocument::FindWholeWords), symbol);
+
+        // Symbols with the same name share their name
+        const auto symbols = document.symbols();
+        QCOMPARE(symbols.size(), 3);
+        QCOMPARE(symbols.at(2)->name(), "Foo::bar");
+        QVERIFY(symbols.at(1)->name().isSharedWith(symbols.at(2)->name()));
+
+        // Symbols already created are moved by the edits
+        const auto range = symbols.at(2)->range();
+        document.gotoStartOfDocument();
+        document.insert("int i;\n");
+        document.symbols();
+        QCOMPARE(symbols.at(2)->range().start, range.start + 7);
+        QCOMPARE(document.symbols().at(2), symbols.at(2));
+    }
+
+    void memoryUsage()
+    {
+        Core::KnutCore core;
+
+        Core::CppDocument document;
+        const QString text = "class Foo {\n    void bar();\n};\nvoid Foo::bar() {}\n";
+        document.setText(text);
+        QCOMPARE(document.symbols().size(), 3);
+
+        auto usage = document.memoryUsage().toMap();
+        QVERIFY(usage["QTextDocument"].toLongLong() >= text.size() * 2);
+        QVERIFY(usage["syntax tree"].toLongLong() > 0);
+        QVERIFY(usage["symbols"].toLongLong() > 0);
+        qint64 total = 0;
+        for (auto it = usage.cbegin(); it != usage.cend(); ++it) {
+            if (it.key() != "total")
+                total += it.value().toLongLong();
+        }
+        QCOMPARE(usage["total"].toLongLong(), total);
+
+        // Marks are counted while they are alive
+        const auto marksSize = usage["marks"].toLongLong();
+        {
+            const auto mark = document.createMark(10);
+            QVERIFY(document.memoryUsage().toMap()["marks"].toLongLong() > marksSize);
+        }
+    }
+
+    void queryRanges()
+    {
+        Core::KnutCore core;
+
+        Core::CppDocument document;
+        document.setText("void foo() {\n    bar(1);\n    baz(bar(2));\n}\n");
+        auto ranges = [&document](const QString &query, const QString &captureName) {
+            const auto data = document.queryRanges(query, captureName);
+            std::vector<qint32> result(data.size() / sizeof(qint32));
+            std::memcpy(result.data(), data.constData(), data.size());
+            return result;
+        };
+
+        const auto text = document.text();
+        const auto calls = ranges("(call_expression function: (_) @function) @call", "function");
+        QCOMPARE(calls.size(), 6);
+        QCOMPARE(text.sliced(calls[0], calls[1] - calls[0]), "bar");
+        QCOMPARE(text.sliced(calls[2], calls[3] - calls[2]), "baz");
+        QCOMPARE(text.sliced(calls[4], calls[5] - calls[4]), "bar");
+
+        Test::LogCounter counter(spdlog::level::warn);
+        QVERIFY(ranges("(call_expression) @call", "function").empty());
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void rangeParsing()
+    {
+        Core::KnutCore core;
+        Core::Settings::instance()->setValue(Core::Settings::RangeParseThreshold, 1);
+
+        // Generated tables around the function to query
+        QString text;
+        for (int i = 0; i < 1000; ++i)
+            text += QString("int table%1[] = {%1, %1};\n").arg(i);
+        text += "void foo()\n{\n    bar(1);\n    bar(2);\n}\nint last = baz(3);\n";
+        Core::CppDocument document;
+        document.setText(text);
+
+        const int start = text.indexOf("bar(1)");
+        const auto matches = document.queryInRange(document.createRangeMark(start, text.indexOf("}", start)),
+                                                   "(call_expression) @call");
+        QCOMPARE(matches.size(), 2);
+        QCOMPARE(matches.first().get("call").text(), "bar(1)");
+        auto usage = document.memoryUsage().toMap();
+        QCOMPARE(usage["syntax tree"].toLongLong(), 0);
+        QVERIFY(usage["range syntax tree"].toLongLong() > 0);
+
+        // The whole document is parsed when needed, the tree of the range is dropped then
+        QCOMPARE(document.query("(call_expression) @call").size(), 3);
+        usage = document.memoryUsage().toMap();
+        QVERIFY(usage["syntax tree"].toLongLong() > 0);
+        QVERIFY(!usage.contains("range syntax tree"));
+
+        Core::Settings::instance()->setValue(Core::Settings::RangeParseThreshold, 0);
+    }
+
+    void stats()
+    {
+        Test::FileTester header(Test::testDataPath() + "/tst_codedocument/ast/header.h");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/tst_codedocument/ast/");
+
+        const auto before = project->stats();
+        auto delta = [&](const char *name) {
+            return project->stats().value(name).toLongLong() - before.value(name).toLongLong();
+        };
+
+        auto document = qobject_cast<Core::CodeDocument *>(project->get(header.fileName()));
+        QVERIFY(document);
+        QCOMPARE(delta("documentsOpened"), qint64(1));
+        QCOMPARE(project->stats().value("documentsOpen").toInt(), 1);
+        QCOMPARE(delta("bytesRead"), QFileInfo(header.fileName()).size());
+
+        QCOMPARE(document->query("(class_specifier) @class").size(), 1);
+        QCOMPARE(delta("fullParses"), qint64(1));
+        QCOMPARE(delta("queriesExecuted"), qint64(1));
+        QCOMPARE(delta("matchesProduced"), qint64(1));
+
+        // An edit only triggers an incremental parse
+        document->insertAtPosition("// comment\n", 0);
+        QVERIFY(document->query(R"((class_specifier name: (_) @name (#eq? @name "Bar")))").isEmpty());
+        QCOMPARE(delta("fullParses"), qint64(1));
+        QCOMPARE(delta("incrementalParses"), qint64(1));
+        QCOMPARE(delta("matchesFiltered"), qint64(1));
+
+        {
+            const auto mark = document->createRangeMark(0, 2);
+            QCOMPARE(delta("rangeMarksAlive"), qint64(1));
+        }
+        QCOMPARE(delta("rangeMarksAlive"), qint64(0));
     }
 
     void ast()
@@ -468,17 +1292,40 @@ private slots:
         QCOMPARE(children[0].startPos(), 38);
         QCOMPARE(children[0].endPos(), 42);
 
+        // The key is the same for the same node, whichever way it's found
+        QVERIFY(!foo.key().isEmpty());
+        QCOMPARE(children[0].parentNode().key(), foo.key());
+        QVERIFY(children[0].key() != foo.key());
+        const auto fooKey = foo.key();
+
         QVERIFY(foo.isValid());
 
-        // Change text before node, position etc should adopt
+        // Nodes don't create any RangeMark, only mark() does
+        const auto counter = [] {
+            return Utils::Counters::value(Utils::Counters::RangeMarksAlive);
+        };
+        const auto marksBefore = counter();
+        const auto fooMark = foo.mark();
+        QCOMPARE(counter(), marksBefore + 1);
+
+        // Change text before node: the node is invalid, the mark follows the change
         document->gotoLine(1);
         document->insert("#include <test.h>\n\n");
 
-        QVERIFY(foo.isValid());
+        QVERIFY(!foo.isValid());
+        QVERIFY(!foo.parentNode().isValid());
+        QCOMPARE(foo.type(), "function_definition");
+        QCOMPARE(fooMark.start(), 57);
+        QCOMPARE(fooMark.end(), 111);
 
+        document->gotoLine(8, 9);
+        foo = document->astNodeAt(document->position());
+        QVERIFY(foo.isValid());
         QCOMPARE(foo.type(), "function_definition");
         QCOMPARE(foo.startPos(), 57);
         QCOMPARE(foo.endPos(), 111);
+        // Another revision of the tree
+        QVERIFY(foo.key() != fooKey);
 
         {
             auto parent = foo.parentNode();
@@ -486,15 +1333,39 @@ private slots:
             QCOMPARE(parent.type(), "field_declaration_list");
         }
 
-        // Change text after node, position etc shouldn't change
+        // Change text after node, the mark shouldn't change
         document->gotoEndOfDocument();
         document->insert("void bar();\n");
 
-        QVERIFY(foo.isValid());
+        QVERIFY(!foo.isValid());
+        QCOMPARE(fooMark.start(), 57);
+        QCOMPARE(fooMark.end(), 111);
+    }
 
-        QCOMPARE(foo.type(), "function_definition");
-        QCOMPARE(foo.startPos(), 57);
-        QCOMPARE(foo.endPos(), 111);
+    void syntaxChanged()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/cpp-project");
+
+        const auto document = qobject_cast<Core::CodeDocument *>(project->open("main.cpp"));
+        QVERIFY(document->syntaxSnapshot());
+
+        QSignalSpy syntaxChanged(document, &Core::CodeDocument::syntaxChanged);
+        document->gotoEndOfDocument();
+        const int position = document->position();
+        document->insert("void bar();\n");
+        // Only known once the document is parsed again
+        QCOMPARE(syntaxChanged.count(), 0);
+        QVERIFY(document->syntaxSnapshot());
+        QCOMPARE(syntaxChanged.count(), 1);
+
+        const auto ranges = syntaxChanged.first().first().value<QList<Core::TextRange>>();
+        QVERIFY(!ranges.isEmpty());
+        auto containsInsertion = [position](const Core::TextRange &range) {
+            return range.start <= position + 1 && range.end >= position + 10;
+        };
+        QVERIFY(std::ranges::any_of(ranges, containsInsertion));
     }
 };
 
@@ -130,6 +130,20 @@ private slots:
             QCOMPARE(document->gotoBlockStart(), 311);
             QCOMPARE(document->gotoBlockEnd(), 390);
         });
+
+        // Brackets in comments and strings are not part of any block
+        Test::testCppDocument("tst_cppdocument/blockStartEnd", "comments.cpp", [](auto *document) {
+            document->setPosition(30);
+            QCOMPARE(document->gotoBlockStart(), 20);
+            QCOMPARE(document->gotoBlockEnd(), 134);
+
+            document->setPosition(91);
+            QCOMPARE(document->gotoBlockStart(), 20);
+
+            document->setPosition(121);
+            QCOMPARE(document->gotoBlockStart(), 119);
+            QCOMPARE(document->gotoBlockEnd(), 125);
+        });
     }
 
     void commentSelection_data()
@@ -10,10 +10,14 @@
 
 #include "common/test_cpputils.h"
 #include "common/test_utils.h"
+#include "core/builtinqueries.h"
 #include "core/cppdocument.h"
 #include "core/knutcore.h"
 #include "core/project.h"
+#include "treesitter/parser.h"
+#include "treesitter/query.h"
 
+#include <QTemporaryDir>
 #include <kdalgorithms.h>
 
 class TestCppDocumentTreeSitter : public QObject
@@ -51,15 +55,24 @@ private slots:
             QCOMPARE(validator.function, "DDV_MaxChars");
             QCOMPARE(validator.member, "m_EchoText");
             QCOMPARE(validator.arguments, QStringList({"3"}));
+
+            QCOMPARE(ddx.getForId("IDC_V_SLIDER_BAR"), ddx.entries.at(3));
+            QCOMPARE(ddx.getForMember("m_TimerCtrlSliders"), ddx.entries.last());
+            QCOMPARE(ddx.getForId("IDC_UNKNOWN"), Core::DataExchangeEntry());
+            QCOMPARE(ddx.getValidators("m_EchoText"), ddx.validators);
+            QVERIFY(ddx.getValidators("m_VSliderBar").isEmpty());
         });
     }
 
 private:
-    void tryInsertingBar(const QString &fileName)
+    void tryInsertingBar(const QString &fileName, bool batch = false)
     {
         Test::FileTester fileTester(fileName);
         auto file = qobject_cast<Core::CppDocument *>(Core::Project::instance()->open(fileTester.fileName()));
-        file->insertInclude("<bar.h>", false);
+        if (batch)
+            QVERIFY(file->insertIncludes({"<bar.h>", R"("constants.h")", "<bar.h>"}, false));
+        else
+            file->insertInclude("<bar.h>", false);
         file->save();
         QVERIFY(fileTester.compare());
     }
@@ -103,6 +116,56 @@ private slots:
         tryInsertingBar(Test::testDataPath() + "/tst_cppdocument/insertRemoveInclude/include.h");
         tryInsertingBar(Test::testDataPath() + "/tst_cppdocument/insertRemoveInclude/pragma.h");
         tryInsertingBar(Test::testDataPath() + "/tst_cppdocument/insertRemoveInclude/guards.h");
+        tryInsertingBar(Test::testDataPath() + "/tst_cppdocument/insertRemoveInclude/include.h", true);
+    }
+
+    void symbolIndex()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        const QString root = Test::testDataPath() + "/projects/mfc-tutorial";
+        project->setRoot(root);
+
+        const auto classes = project->findSymbols("CTutorialDlg");
+        auto classIt = std::ranges::find_if(classes, [](const Core::IndexedSymbol &symbol) {
+            return symbol.kind == Core::Symbol::Kind::Class;
+        });
+        QVERIFY(classIt != classes.end());
+        QCOMPARE(classIt->fileName, root + "/TutorialDlg.h");
+        QCOMPARE(classIt->bases, QStringList({"CDialog"}));
+        QVERIFY(classIt->isDefinition);
+
+        // Declaration in the header, definition in the source
+        const auto methods = project->findSymbols("CTutorialDlg::OnInitDialog");
+        QCOMPARE(methods.size(), 2);
+        QCOMPARE(methods.at(0).fileName, root + "/TutorialDlg.cpp");
+        QVERIFY(methods.at(0).isDefinition);
+        QCOMPARE(methods.at(1).fileName, root + "/TutorialDlg.h");
+        QVERIFY(!methods.at(1).isDefinition);
+        QCOMPARE(methods.at(1).kind, Core::Symbol::Kind::Method);
+        QCOMPARE(methods.at(1).scope, "CTutorialDlg");
+
+        const auto macros = project->findSymbols("IDC_ECHO_AREA");
+        QCOMPARE(macros.size(), 1);
+        QCOMPARE(macros.first().kind, Core::Symbol::Kind::Constant);
+        QCOMPARE(macros.first().fileName, root + "/Resource.h");
+
+        const auto dialogs = project->findDerivedClasses("CDialog");
+        QCOMPARE(dialogs.size(), 1);
+        QCOMPARE(dialogs.first().name, "CTutorialDlg");
+        QVERIFY(project->findDerivedClasses("CTutorialDlg").isEmpty());
+
+        // The index can be saved and loaded back
+        QTemporaryDir dir;
+        Core::SymbolIndex index;
+        QVERIFY(index.update({root + "/TutorialApp.h", root + "/TutorialDlg.h"}));
+        QVERIFY(!index.update({root + "/TutorialApp.h", root + "/TutorialDlg.h"}));
+        QVERIFY(index.save(dir.filePath("symbols.index")));
+        Core::SymbolIndex loadedIndex;
+        QVERIFY(loadedIndex.load(dir.filePath("symbols.index")));
+        QCOMPARE(loadedIndex.fileCount(), 2);
+        QCOMPARE(loadedIndex.derivedClasses("CWinApp").size(), 1);
+        QCOMPARE(loadedIndex.derivedClasses("CWinApp").first().name, "CTutorialApp");
     }
 
     void addMember()
@@ -162,6 +225,12 @@ private:
             QCOMPARE(actualEntry.name, expectedEntry.first);
             QCOMPARE(kdalgorithms::transformed(actualEntry.parameters, toString), expectedEntry.second);
         }
+
+        QCOMPARE(messageMap.get("ON_BN_CLICKED"), messageMap.entries.at(7));
+        QCOMPARE(messageMap.getAll("ON_BN_CLICKED"), messageMap.entries.mid(7));
+        QCOMPARE(messageMap.getAllForId("IDC_TIMER_CONTROL_SLIDERS"), messageMap.entries.mid(8));
+        QVERIFY(!messageMap.get("ON_WM_CLOSE").isValid());
+        QVERIFY(messageMap.getAllForId("OnBnClickedBtnAdd").isEmpty());
     }
 
 private slots:
@@ -178,6 +247,100 @@ private slots:
         existingMessageMap(cppdocument);
     }
 
+    void builtinQueries()
+    {
+        const auto errors = Core::BuiltinQueries::compile();
+        QVERIFY2(errors.isEmpty(), qPrintable(errors.join('\n')));
+
+        // The queries are compiled as their users get them, so they are all in the cache
+        auto &cache = treesitter::QueryCache::instance();
+        const auto misses = cache.statistics().misses;
+        for (const auto &entry : Core::BuiltinQueries::all()) {
+            if (entry.queries.size() == 1)
+                cache.get(treesitter::Parser::getLanguage(entry.type), entry.queries.first());
+        }
+        QCOMPARE(cache.statistics().misses, misses);
+
+        // Including the message map of a given class
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/mfc-tutorial");
+        auto cppdocument = qobject_cast<Core::CppDocument *>(project->get("TutorialDlg.cpp"));
+        QVERIFY(cppdocument);
+        const auto documentMisses = cache.statistics().misses;
+        QVERIFY(cppdocument->mfcExtractMessageMap("CTutorialDlg").isValid());
+        QVERIFY(!cppdocument->mfcExtractMessageMap("NonExistentClass").isValid());
+        QVERIFY(cppdocument->mfcExtractMessageMap().isValid());
+        QCOMPARE(cache.statistics().misses, documentMisses);
+    }
+
+    void mfcExtractAll()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        const QString root = Test::testDataPath() + "/projects/mfc-tutorial";
+        project->setRoot(root);
+
+        const auto result = project->mfcExtractAll({"cpp"});
+        QCOMPARE(result.keys(), QStringList({"CTutorialApp", "CTutorialDlg"}));
+        const auto data = result.value("CTutorialDlg").toMap();
+        QCOMPARE(data.value("fileName").toString(), root + "/TutorialDlg.cpp");
+
+        // Same data as the CppDocument API
+        auto cppdocument = qobject_cast<Core::CppDocument *>(project->get("TutorialDlg.cpp"));
+        const auto messageMap = cppdocument->mfcExtractMessageMap("CTutorialDlg");
+        const auto messageMapData = data.value("messageMap").toMap();
+        QCOMPARE(messageMapData.value("superClass").toString(), messageMap.superClass);
+        QCOMPARE(messageMapData.value("range").toMap().value("start").toInt(), messageMap.range.start());
+        const auto entries = messageMapData.value("entries").toList();
+        QCOMPARE(entries.size(), messageMap.entries.size());
+        for (int i = 0; i < entries.size(); ++i) {
+            const auto entry = entries.at(i).toMap();
+            QCOMPARE(entry.value("name").toString(), messageMap.entries.at(i).name);
+            QCOMPARE(entry.value("parameters").toStringList(),
+                     kdalgorithms::transformed(messageMap.entries.at(i).parameters, &Core::RangeMark::text));
+        }
+
+        const auto ddx = cppdocument->mfcExtractDDX("CTutorialDlg");
+        const auto ddxData = data.value("dataExchange").toMap();
+        const auto ddxEntries = ddxData.value("entries").toList();
+        QCOMPARE(ddxEntries.size(), ddx.entries.size());
+        for (int i = 0; i < ddxEntries.size(); ++i) {
+            const auto entry = ddxEntries.at(i).toMap();
+            QCOMPARE(entry.value("function").toString(), ddx.entries.at(i).function);
+            QCOMPARE(entry.value("idc").toString(), ddx.entries.at(i).idc);
+            QCOMPARE(entry.value("member").toString(), ddx.entries.at(i).member);
+        }
+        const auto validators = ddxData.value("validators").toList();
+        QCOMPARE(validators.size(), ddx.validators.size());
+        QCOMPARE(validators.first().toMap().value("arguments").toStringList(), ddx.validators.first().arguments);
+
+        // No DDX for the application
+        QVERIFY(!result.value("CTutorialApp").toMap().contains("dataExchange"));
+    }
+
+    void inMessageMapPredicate()
+    {
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(Test::testDataPath() + "/projects/mfc-tutorial");
+
+        auto cppdocument = qobject_cast<Core::CppDocument *>(Core::Project::instance()->get("TutorialDlg.cpp"));
+        const QString query = "(call_expression function: (identifier) @name (#in_message_map? @name))";
+
+        // The message map is only searched once per syntax tree, and again after a change
+        const auto matches = cppdocument->query(query);
+        QVERIFY(!matches.isEmpty());
+        QCOMPARE(cppdocument->query(query).size(), matches.size());
+
+        Test::LogCounter counter;
+        cppdocument->insertAtPosition("// ", cppdocument->text().indexOf("BEGIN_MESSAGE_MAP"));
+        QVERIFY(cppdocument->query(query).isEmpty());
+        QVERIFY(counter.count() > 0);
+        cppdocument->undo();
+        QCOMPARE(cppdocument->query(query).size(), matches.size());
+    }
+
     void mfcExtractMessageMapWithNamespace()
     {
         Core::KnutCore core;
@@ -340,6 +503,45 @@ private slots:
         // TODO: test parameters
     }
 
+    void queryMemoization()
+    {
+        Test::testCppDocument("tst_cppdocument/query", "myclass.h", [](Core::CppDocument *document) {
+            const auto member = document->queryMember("MyClass", "m_double");
+            QCOMPARE(member.get("member").text(), "double m_double = 1.1;");
+            const auto sameMember = document->queryMember("MyClass", "m_double");
+            QCOMPARE(sameMember.get("member").start(), member.get("member").start());
+            QCOMPARE(document->queryMethodDeclaration("MyClass", "foo").size(), 1);
+            QCOMPARE(document->queryMethodDeclaration("MyClass", "foo").size(), 1);
+
+            // Any edit invalidates the memoized results
+            QVERIFY(!document->queryMember("MyClass", "m_added").get("member").isValid());
+            document->insertAtPosition("int m_added;\n    ", member.get("member").start());
+            QCOMPARE(document->queryMember("MyClass", "m_added").get("member").text(), "int m_added;");
+            QCOMPARE(document->queryMember("MyClass", "m_double").get("member").text(), "double m_double = 1.1;");
+        });
+    }
+
+    void toggleSections()
+    {
+        Test::FileTester file(Test::testDataPath() + "/tst_cppdocument/toggleSection/section.cpp");
+        Core::KnutCore core;
+        Core::Project::instance()->setRoot(Test::testDataPath() + "/tst_cppdocument/toggleSection");
+        auto cppFile = qobject_cast<Core::CppDocument *>(Core::Project::instance()->open(file.fileName()));
+        const auto original = cppFile->text();
+
+        // Section::foo is already commented out
+        cppFile->toggleSections({"Section::bar", "computeText"});
+        QCOMPARE(cppFile->text().count("#ifdef KDAB_TEMPORARILY_REMOVED"), 3);
+        QVERIFY(cppFile->text().contains(R"(qDebug("computeText is commented out");)"));
+        QVERIFY(cppFile->text().contains("    return -1;\n#endif // KDAB_TEMPORARILY_REMOVED"));
+
+        // Toggling again restores the functions, and the changes are undone at once
+        cppFile->toggleSections({"Section::bar", "computeText"});
+        QCOMPARE(cppFile->text(), original);
+        cppFile->undo();
+        QCOMPARE(cppFile->text().count("#ifdef KDAB_TEMPORARILY_REMOVED"), 3);
+    }
+
     void changeBaseClass()
     {
         Core::KnutCore core;
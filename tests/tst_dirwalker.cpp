@@ -0,0 +1,99 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/dirwalker.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestDirWalker : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &fileName, const QByteArray &data = {})
+    {
+        QVERIFY(QDir().mkpath(QFileInfo(fileName).path()));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(data);
+    }
+
+    // Paths relative to the root, sorted, with a '/' at the end of the directories
+    static QStringList walk(const QString &root, const Core::DirWalker::Options &options)
+    {
+        Core::DirWalker walker(root, options);
+        QStringList paths;
+        while (walker.hasNext()) {
+            const auto entry = walker.next();
+            const auto path = QDir(root).relativeFilePath(entry.value("path").toString());
+            paths.append(entry.value("isDir").toBool() ? path + '/' : path);
+        }
+        paths.sort();
+        return paths;
+    }
+
+private slots:
+    void walk()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.filePath("main.cpp"), "int main() {}\n");
+        writeFile(dir.filePath("readme.md"));
+        writeFile(dir.filePath("src/a.cpp"));
+        writeFile(dir.filePath("src/a.h"));
+        writeFile(dir.filePath("src/deep/b.cpp"));
+        writeFile(dir.filePath("build/c.cpp"));
+
+        QCOMPARE(walk(dir.path(), {}),
+                 QStringList({"build/", "build/c.cpp", "main.cpp", "readme.md", "src/", "src/a.cpp", "src/a.h",
+                              "src/deep/", "src/deep/b.cpp"}));
+        QCOMPARE(walk(dir.path(), {.nameFilters = {"*.cpp"}, .exclude = {"build", "deep"}}),
+                 QStringList({"main.cpp", "src/", "src/a.cpp"}));
+        QCOMPARE(walk(dir.path(), {.maxDepth = 0}), QStringList({"build/", "main.cpp", "readme.md", "src/"}));
+        QVERIFY(walk(dir.filePath("missing"), {}).isEmpty());
+
+        // The options of a script
+        const auto options = Core::DirWalker::optionsFromMap({{"nameFilters", QVariantList {"*.h"}}, {"maxDepth", 1}});
+        QCOMPARE(options.nameFilters, QStringList({"*.h"}));
+        QVERIFY(options.exclude.isEmpty());
+        QCOMPARE(options.maxDepth, 1);
+
+        Core::DirWalker walker(dir.path(), {.nameFilters = {"main.cpp"}, .exclude = {"build", "src"}});
+        QVERIFY(walker.hasNext());
+        const auto entry = walker.next();
+        QCOMPARE(entry.value("name").toString(), "main.cpp");
+        QCOMPARE(entry.value("depth").toInt(), 0);
+        QCOMPARE(entry.value("size").toLongLong(), 14);
+        QVERIFY(entry.value("lastModified").toDateTime().isValid());
+        // Nothing after the end
+        QVERIFY(!walker.hasNext());
+        QVERIFY(walker.next().isEmpty());
+    }
+
+    void readAhead()
+    {
+        // More entries than read ahead at once, the walk starts again when the script catches up
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        for (int i = 0; i < 2000; ++i)
+            writeFile(dir.filePath(QString("%1/file%2.txt").arg(i % 3).arg(i)));
+        QCOMPARE(walk(dir.path(), {.nameFilters = {"*.txt"}}).size(), 2003);
+
+        // A walker destroyed before the end stops its worker thread
+        Core::DirWalker walker(dir.path(), {});
+        QVERIFY(walker.hasNext());
+    }
+};
+
+QTEST_GUILESS_MAIN(TestDirWalker)
+#include "tst_dirwalker.moc"
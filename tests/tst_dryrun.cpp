@@ -0,0 +1,136 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/dryrun.h"
+#include "core/knutcore.h"
+#include "core/project.h"
+#include "utils/linediff.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestDryRun : public QObject
+{
+    Q_OBJECT
+
+private:
+    static int editCount(const QString &oldText, const QString &newText, int context = 3)
+    {
+        const auto hunks = Utils::diffLines(Utils::splitLines(oldText), Utils::splitLines(newText), context);
+        int count = 0;
+        for (const auto &hunk : hunks) {
+            for (const auto &line : hunk.lines)
+                count += line.kind != Utils::DiffLine::Context;
+        }
+        return count;
+    }
+
+    static void writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(data);
+    }
+
+private slots:
+    void diffLines()
+    {
+        QCOMPARE(editCount("a\nb\nc\n", "a\nb\nc\n"), 0);
+        QCOMPARE(editCount("a\nb\nc\n", "a\nc\n"), 1);
+        QCOMPARE(editCount("a\nb\nc\n", "c\nb\na\n"), 4);
+        QCOMPARE(editCount("", "a\n"), 1);
+        // The missing new line at the end is a change of the last line
+        QCOMPARE(editCount("a\nb\n", "a\nb"), 2);
+
+        // Changes separated by more than two contexts are in different hunks
+        const QString text = "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n";
+        QString changed = text;
+        changed.replace("2\n", "two\n").replace("9\n", "nine\n");
+        auto hunks = Utils::diffLines(Utils::splitLines(text), Utils::splitLines(changed), 3);
+        QCOMPARE(hunks.size(), 1);
+        hunks = Utils::diffLines(Utils::splitLines(text), Utils::splitLines(changed), 1);
+        QCOMPARE(hunks.size(), 2);
+        QCOMPARE(hunks[1].oldStart, 7);
+        QCOMPARE(hunks[1].oldCount, 3);
+        QCOMPARE(hunks[1].newCount, 3);
+    }
+
+    void patch()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.filePath("a.txt"), "one\r\ntwo\r\nthree\r\n");
+        writeFile(dir.filePath("c.txt"), "same\n");
+
+        Core::DryRun::addChange(dir.filePath("c.txt"), "same\n", {}, false);
+        Core::DryRun::addChange(dir.filePath("b.txt"), "new", {}, false);
+        Core::DryRun::addChange(dir.filePath("a.txt"), "one\nfirst\n", {}, true);
+        // Only the last save of a file is kept
+        Core::DryRun::addChange(dir.filePath("a.txt"), "one\n2\nthree\n", {}, true);
+
+        QCOMPARE(Core::DryRun::patch(dir.path()),
+                 QByteArray("diff --git a/a.txt b/a.txt\n"
+                            "--- a/a.txt\n"
+                            "+++ b/a.txt\n"
+                            "@@ -1,3 +1,3 @@\n"
+                            " one\r\n"
+                            "-two\r\n"
+                            "+2\r\n"
+                            " three\r\n"
+                            "diff --git a/b.txt b/b.txt\n"
+                            "new file mode 100644\n"
+                            "--- /dev/null\n"
+                            "+++ b/b.txt\n"
+                            "@@ -0,0 +1 @@\n"
+                            "+new\n"
+                            "\\ No newline at end of file\n"));
+
+        // Nothing was written
+        QVERIFY(!QFile::exists(dir.filePath("b.txt")));
+        Core::DryRun::clear();
+        QCOMPARE(Core::DryRun::patch(dir.path()), QByteArray());
+    }
+
+    void replaceAllInFiles()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QByteArray original = "int foo = 1;\r\nint bar;\r\n";
+        writeFile(dir.filePath("a.cpp"), original);
+        writeFile(dir.filePath("b.cpp"), "int bar;\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        Core::DryRun::setEnabled(true);
+        const auto result = project->replaceAllInFiles({"cpp"}, "foo", "baz");
+        Core::DryRun::setEnabled(false);
+        QCOMPARE(result.size(), 1);
+        QCOMPARE(result.value(dir.filePath("a.cpp")).toInt(), 1);
+
+        // The files changed on the workers are not written, their changes are in the patch
+        QFile file(dir.filePath("a.cpp"));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), original);
+        QCOMPARE(Core::DryRun::patch(dir.path()),
+                 QByteArray("diff --git a/a.cpp b/a.cpp\n"
+                            "--- a/a.cpp\n"
+                            "+++ b/a.cpp\n"
+                            "@@ -1,2 +1,2 @@\n"
+                            "-int foo = 1;\r\n"
+                            "+int baz = 1;\r\n"
+                            " int bar;\r\n"));
+        Core::DryRun::clear();
+    }
+};
+
+QTEST_MAIN(TestDryRun)
+#include "tst_dryrun.moc"
@@ -0,0 +1,114 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/knutcore.h"
+#include "core/logger.h"
+
+#include <QTest>
+
+static QString openFile(const QString &fileName)
+{
+    LOG("Project::open", fileName);
+    LOG_RETURN("document", fileName);
+}
+
+static void insert(const QString &text)
+{
+    LOG_AND_MERGE("TextDocument::insert", text);
+}
+
+static void select(const QString &text)
+{
+    LOG("Project::select", LOG_ARG("document", text));
+}
+
+class TestHistoryModel : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QString text(const Core::HistoryModel &model, int row, int column)
+    {
+        return model.data(model.index(row, column)).toString();
+    }
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void merge()
+    {
+        Core::KnutCore core;
+        Core::HistoryModel model;
+
+        insert("foo");
+        insert("\n");
+        insert("bar");
+        QCOMPARE(model.rowCount(), 1);
+        QCOMPARE(text(model, 0, Core::HistoryModel::NameCol), "TextDocument::insert");
+        QCOMPARE(text(model, 0, Core::HistoryModel::ParamCol), R"("foo\nbar")");
+
+        openFile("main.cpp");
+        insert("baz");
+        QCOMPARE(model.rowCount(), 3);
+        QCOMPARE(text(model, 1, Core::HistoryModel::ParamCol), R"("main.cpp" => document)");
+        QCOMPARE(text(model, 2, Core::HistoryModel::ParamCol), R"("baz")");
+    }
+
+    void maximumSize()
+    {
+        Core::KnutCore core;
+        Core::HistoryModel model;
+        model.setMaximumSize(2);
+
+        insert("foo");
+        openFile("main.cpp");
+        select("main.cpp");
+        QCOMPARE(model.rowCount(), 2);
+        QCOMPARE(text(model, 0, Core::HistoryModel::NameCol), "Project::open");
+        QCOMPARE(text(model, 1, Core::HistoryModel::ParamCol), R"(document: "main.cpp")");
+
+        // The return value is used by the next call
+        const QString script = model.createScript(0, 1);
+        QVERIFY(script.contains(R"(var document = Project.open("main.cpp"))"));
+        QVERIFY(script.contains("Project.select(document)"));
+
+        model.setMaximumSize(1);
+        QCOMPARE(model.rowCount(), 1);
+        QCOMPARE(text(model, 0, Core::HistoryModel::NameCol), "Project::select");
+
+        model.clear();
+        QCOMPARE(model.rowCount(), 0);
+    }
+
+    void journal()
+    {
+        Core::KnutCore core;
+        Core::HistoryModel model;
+        model.setMaximumSize(100);
+
+        // Enough text for the removed entries to be dropped from the journal
+        const QString longText(1000, 'a');
+        for (int i = 0; i < 3000; ++i) {
+            openFile(QString::number(i) + longText);
+            select(QString::number(i) + longText);
+        }
+        QCOMPARE(model.rowCount(), 100);
+        QVERIFY(model.memorySize() < 100 * longText.size());
+        QCOMPARE(text(model, 0, Core::HistoryModel::ParamCol), QString(R"("2950%1" => document)").arg(longText));
+        QCOMPARE(text(model, 99, Core::HistoryModel::ParamCol), QString(R"(document: "2999%1")").arg(longText));
+
+        const QString script = model.createScript(98, 99);
+        QVERIFY(script.contains(QString(R"(var document = Project.open("2999%1"))").arg(longText)));
+        QVERIFY(script.contains("Project.select(document)"));
+    }
+};
+
+QTEST_MAIN(TestHistoryModel)
+#include "tst_historymodel.moc"
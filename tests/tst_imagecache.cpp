@@ -0,0 +1,60 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "utils/imagecache.h"
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestImageCache : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void thumbnail()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        // A strip of two icons, red then blue
+        QImage strip(32, 16, QImage::Format_RGB32);
+        strip.fill(Qt::red);
+        for (int y = 0; y < 16; ++y) {
+            for (int x = 16; x < 32; ++x)
+                strip.setPixel(x, y, qRgb(0, 0, 255));
+        }
+        const QString fileName = dir.filePath("strip.png");
+        QVERIFY(strip.save(fileName));
+
+        auto *cache = Utils::ImageCache::instance();
+        QSignalSpy readySpy(cache, &Utils::ImageCache::thumbnailReady);
+        const QRect blueIcon(16, 0, 16, 16);
+        QVERIFY(cache->thumbnail(fileName, blueIcon, {8, 8}).isNull());
+        QVERIFY(readySpy.wait());
+        QCOMPARE(readySpy.first().first().toString(), fileName);
+
+        const QImage thumbnail = cache->thumbnail(fileName, blueIcon, {8, 8});
+        QCOMPARE(thumbnail.size(), QSize(8, 8));
+        QCOMPARE(thumbnail.pixel(4, 4), qRgb(0, 0, 255));
+        // The strip was decoded for the icon, and is kept for the others
+        QCOMPARE(cache->image(fileName).size(), QSize(32, 16));
+
+        // A missing file is not decoded again
+        const QString missing = dir.filePath("missing.png");
+        QVERIFY(cache->thumbnail(missing, {}, {8, 8}).isNull());
+        QVERIFY(readySpy.wait());
+        readySpy.clear();
+        QVERIFY(cache->thumbnail(missing, {}, {8, 8}).isNull());
+        QVERIFY(!readySpy.wait(100));
+    }
+};
+
+QTEST_GUILESS_MAIN(TestImageCache)
+#include "tst_imagecache.moc"
@@ -0,0 +1,107 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/jsondocument.h"
+
+#include <QTest>
+
+class TestJsonDocument : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void get()
+    {
+        Core::JsonDocument document;
+        document.setText(R"({
+    "name": "knut",
+    "version": 2,
+    "a/b~": [true, null, {"key": "\"value\"\n"}]
+})");
+        QCOMPARE(document.get("/name").toString(), "knut");
+        QCOMPARE(document.get("/version").toInt(), 2);
+        QVERIFY(document.get("/a~1b~0/0").toBool());
+        QCOMPARE(document.get("/a~1b~0/2/key").toString(), "\"value\"\n");
+        QCOMPARE(document.get("/a~1b~0").toList().size(), 3);
+        QCOMPARE(document.get("").toMap().value("name").toString(), "knut");
+        QVERIFY(!document.get("/missing").isValid());
+        QVERIFY(!document.get("/a~1b~0/3").isValid());
+
+        document.setText(R"({"name": "knut",})");
+        QVERIFY(!document.get("/name").isValid());
+    }
+
+    void set()
+    {
+        Core::JsonDocument document;
+        document.setText(R"({
+    "name": "knut",
+    "list": [1, 2],
+    "empty": {}
+})");
+        const int revision = document.textRevision();
+        QVERIFY(document.set("/name", "knut"));
+        // Setting the same value doesn't change the document
+        QCOMPARE(document.textRevision(), revision);
+
+        QVERIFY(document.set("/name", "Knut"));
+        QVERIFY(document.set("/list/-", 3));
+        QVERIFY(document.set("/list/3", QVariantMap {{"a", 1}}));
+        QVERIFY(document.set("/empty/key", QVariantList {"x"}));
+        QVERIFY(document.set("/version", 2));
+        QCOMPARE(document.text(), R"({
+    "name": "Knut",
+    "list": [1, 2, 3, {"a":1}],
+    "empty": {"key": ["x"]},
+    "version": 2
+})");
+        QCOMPARE(document.get("/list/3/a").toInt(), 1);
+
+        QVERIFY(!document.set("/list/7", 1));
+        QVERIFY(!document.set("/missing/key", 1));
+        QVERIFY(!document.set("/name/key", 1));
+    }
+
+    void setMany()
+    {
+        // Each set moves the values after it in the index, they must still be found at their new position
+        QString text = "{\n";
+        QString expected = "{\n";
+        for (int i = 0; i < 50; ++i) {
+            const QString separator = i < 49 ? ",\n" : "\n";
+            text += QString("    \"key%1\": \"%1\"").arg(i) + separator;
+            expected += QString("    \"key%1\": \"value %1\"").arg(i) + separator;
+        }
+        text += "}";
+        expected.chop(1);
+        expected += ",\n    \"list\": [0, 1]\n}";
+
+        Core::JsonDocument document;
+        document.setText(text);
+        for (int i = 49; i >= 0; i -= 2)
+            QVERIFY(document.set(QString("/key%1").arg(i), QString("value %1").arg(i)));
+        for (int i = 0; i < 50; i += 2)
+            QVERIFY(document.set(QString("/key%1").arg(i), QString("value %1").arg(i)));
+        QVERIFY(document.set("/list", QVariantList()));
+        QVERIFY(document.set("/list/-", 0));
+        QVERIFY(document.set("/list/1", 1));
+        QCOMPARE(document.text(), expected);
+
+        for (int i = 0; i < 50; ++i)
+            QCOMPARE(document.get(QString("/key%1").arg(i)).toString(), QString("value %1").arg(i));
+        QCOMPARE(document.get("/list/1").toInt(), 1);
+        QCOMPARE(document.get("").toMap().size(), 51);
+    }
+};
+
+QTEST_MAIN(TestJsonDocument)
+#include "tst_jsondocument.moc"
@@ -0,0 +1,146 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lsp/requestmessage_json.h"
+#include "lsp/requestmessage_reader.h"
+#include "lsp/requests.h"
+#include "lsp/types_json.h"
+#include "lsp/types_reader.h"
+
+#include <QTest>
+#include <string_view>
+
+using json = nlohmann::json;
+
+class TestJsonReader : public QObject
+{
+    Q_OBJECT
+
+private:
+    // The response read from the text must be the same as the one deserialized from a json DOM
+    template <typename Response>
+    void verifyResponse(std::string_view text)
+    {
+        Response response;
+        Lsp::JsonReader reader(text);
+        QVERIFY(read(reader, response));
+        QVERIFY(reader.atEnd());
+
+        const auto expected = json::parse(text.begin(), text.end()).get<Response>();
+        QCOMPARE(json(response).dump(), json(expected).dump());
+    }
+
+private slots:
+    void documentSymbol()
+    {
+        using Response = Lsp::TextDocumentDocumentSymbolRequest::Response;
+        constexpr std::string_view text = R"json({"id": 3, "jsonrpc": "2.0", "result": [
+            {"children": [
+                {"detail": "void (int)", "kind": 6, "name": "setValue", "unknown": {"a": [1, null]},
+                 "range": {"end": {"character": 24, "line": 4}, "start": {"character": 4, "line": 4}},
+                 "selectionRange": {"end": {"character": 17, "line": 4}, "start": {"character": 9, "line": 4}}}],
+             "kind": 5, "name": "Caf\u00e9 \"Bar\"", "tags": [1],
+             "range": {"end": {"character": 1, "line": 6}, "start": {"character": 0, "line": 2}},
+             "selectionRange": {"end": {"character": 9, "line": 2}, "start": {"character": 6, "line": 2}}}]})json";
+        verifyResponse<Response>(text);
+
+        Response response;
+        Lsp::JsonReader reader(text);
+        QVERIFY(read(reader, response));
+        QVERIFY(response.isValid());
+        const auto &symbols = std::get<std::vector<Lsp::DocumentSymbol>>(*response.result);
+        QCOMPARE(symbols.size(), size_t(1));
+        QVERIFY(symbols.front().name == "Caf\xc3\xa9 \"Bar\"");
+        QVERIFY(symbols.front().kind == Lsp::SymbolKind::Class);
+        QCOMPARE(symbols.front().children->front().range.end.character, 24u);
+    }
+
+    void symbolInformation()
+    {
+        using Response = Lsp::TextDocumentDocumentSymbolRequest::Response;
+        constexpr std::string_view text = R"({"jsonrpc": "2.0", "id": "7", "result": [
+            {"name": "foo", "kind": 12, "containerName": "ns",
+             "location": {"uri": "file:///foo.cpp",
+                          "range": {"start": {"line": 1, "character": 0}, "end": {"line": 3, "character": 1}}}}]})";
+        verifyResponse<Response>(text);
+
+        Response response;
+        Lsp::JsonReader reader(text);
+        QVERIFY(read(reader, response));
+        QVERIFY(std::holds_alternative<std::vector<Lsp::SymbolInformation>>(*response.result));
+        QVERIFY(std::get<std::string>(response.id) == "7");
+    }
+
+    void references()
+    {
+        using Response = Lsp::TextDocumentReferencesRequest::Response;
+        verifyResponse<Response>(R"({"jsonrpc": "2.0", "id": 1, "result": [
+            {"uri": "file:///a.cpp",
+             "range": {"start": {"line": 1, "character": 2}, "end": {"line": 1, "character": 5}}},
+            {"uri": "file:///b.cpp",
+             "range": {"start": {"line": 10, "character": 0}, "end": {"line": 10, "character": 3}}}]})");
+        verifyResponse<Response>(R"({"jsonrpc": "2.0", "id": 2, "result": null})");
+        verifyResponse<Response>(R"({"jsonrpc": "2.0", "id": 3, "error": {"code": -32601, "message": "Not found"}})");
+    }
+
+    void invalidResponse()
+    {
+        using Response = Lsp::TextDocumentReferencesRequest::Response;
+        for (const std::string_view text : {R"({"jsonrpc": "2.0", "id": 1, "result": [{"uri": "file:///a.cpp"}]})",
+                                            R"({"jsonrpc": "2.0", "result": []})", R"({"jsonrpc": "2.0", "id": 1,)"}) {
+            Response response;
+            Lsp::JsonReader reader(text);
+            QVERIFY(!read(reader, response));
+        }
+    }
+
+    void messageHeader()
+    {
+        constexpr std::string_view text =
+            R"({"result": {"big": [1, 2, 3]}, "error": {"code": 1, "message": "failed"}, "id": 12, "jsonrpc": "2.0"})";
+        Lsp::MessageHeader header;
+        Lsp::JsonReader reader(text);
+        QVERIFY(read(reader, header));
+        QCOMPARE(std::get<int>(*header.id), 12);
+        QVERIFY(!header.hasMethod);
+        QVERIFY(header.errorMessage == "failed");
+    }
+
+    void skippedNotification()
+    {
+        const auto skip = [](std::string_view method) {
+            return method == "textDocument/publishDiagnostics";
+        };
+
+        // The params after the method of a notification are not read, even if they are invalid
+        constexpr std::string_view notification =
+            R"({"jsonrpc": "2.0", "method": "textDocument/publishDiagnostics", "params": {"diagnostics": [1, 2,)";
+        Lsp::MessageHeader header;
+        Lsp::JsonReader reader(notification);
+        QVERIFY(read(reader, header, skip));
+        QVERIFY(header.stopped);
+        QVERIFY(header.hasMethod);
+        QVERIFY(!header.id);
+        QVERIFY(header.method == "textDocument/publishDiagnostics");
+
+        // A request with that method is read completely
+        constexpr std::string_view request =
+            R"({"id": 3, "method": "textDocument/publishDiagnostics", "params": {"diagnostics": []}})";
+        Lsp::MessageHeader requestHeader;
+        Lsp::JsonReader requestReader(request);
+        QVERIFY(read(requestReader, requestHeader, skip));
+        QVERIFY(!requestHeader.stopped);
+        QVERIFY(requestReader.atEnd());
+        QCOMPARE(std::get<int>(*requestHeader.id), 3);
+    }
+};
+
+QTEST_MAIN(TestJsonReader)
+#include "tst_jsonreader.moc"
@@ -15,7 +15,9 @@
 #include <QProcess>
 #include <QQmlEngine>
 #include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
+#include <nlohmann/json.hpp>
 
 #define KNUT_TEST(name)                                                                                                \
     void tst_##name()                                                                                                  \
@@ -73,11 +75,45 @@ private:
 private slots:
     KNUT_TEST(settings)
     KNUT_TEST(dir)
+    KNUT_TEST(file)
     KNUT_TEST(fileinfo)
     KNUT_TEST(utils)
     KNUT_TEST(rcdocument)
     KNUT_TEST(project)
 
+    void ndjsonOutput()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QFile script(dir.filePath("records.js"));
+        QVERIFY(script.open(QIODevice::WriteOnly));
+        script.write("function main() {\n"
+                     "    Utils.emitRecord({file: \"main.cpp\", line: 12})\n"
+                     "    Utils.emitRecord(\"two\\nlines\")\n"
+                     "    Utils.emitRecord([1, null])\n"
+                     "    Utils.emitRecord(undefined)\n"
+                     "}\n");
+        script.close();
+
+        // Only the records are on the standard output, one json value per line
+        QProcess knut;
+        knut.setProcessChannelMode(QProcess::SeparateChannels);
+        knut.start(KNUT_BINARY_PATH, {"--run", script.fileName(), "--output", "ndjson"});
+        QVERIFY(knut.waitForFinished());
+        QCOMPARE(knut.exitCode(), 0);
+        const auto lines = knut.readAllStandardOutput().split('\n');
+        QCOMPARE(lines.size(), qsizetype(5));
+        QVERIFY(lines.last().isEmpty());
+
+        const auto parse = [](const QByteArray &line) {
+            return nlohmann::json::parse(line.constData(), line.constData() + line.size(), nullptr, false);
+        };
+        QCOMPARE(parse(lines.at(0)).dump(), R"({"file":"main.cpp","line":12})");
+        QCOMPARE(parse(lines.at(1)).dump(), R"("two\nlines")");
+        QCOMPARE(parse(lines.at(2)).dump(), "[1,null]");
+        QCOMPARE(parse(lines.at(3)).dump(), "null");
+    }
+
     KNUT_EXAMPLE(ex_gui_interactive)
     KNUT_EXAMPLE(ex_gui_progressbar)
     KNUT_EXAMPLE(ex_script_dialog)
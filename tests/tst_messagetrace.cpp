@@ -0,0 +1,90 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lsp/messagetrace.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+#include <cstring>
+
+using Lsp::MessageTrace;
+
+class TestMessageTrace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void records()
+    {
+        MessageTrace trace(3);
+        QVERIFY(trace.records().empty());
+
+        trace.add(MessageTrace::Type::SendRequest, "textDocument/hover", 120);
+        trace.add(MessageTrace::Type::ReceiveResponse, "textDocument/hover", 4000, std::chrono::milliseconds(2));
+        auto records = trace.records();
+        QCOMPARE(records.size(), size_t(2));
+        QCOMPARE(QString(records[0].method), "textDocument/hover");
+        QCOMPARE(records[0].size, 120u);
+        QCOMPARE(records[0].latency, 0u);
+        QVERIFY(records[1].type == MessageTrace::Type::ReceiveResponse);
+        QCOMPARE(records[1].latency, 2000u);
+        QVERIFY(records[0].timestamp <= records[1].timestamp);
+
+        // Once full, the oldest records are replaced
+        trace.add(MessageTrace::Type::SendNotification, "textDocument/didChange", 10);
+        trace.add(MessageTrace::Type::SendNotification, std::string(100, 'x'), 20);
+        records = trace.records();
+        QCOMPARE(records.size(), size_t(3));
+        QCOMPARE(records[0].size, 4000u);
+        QCOMPARE(QString(records[1].method), "textDocument/didChange");
+        // The method is truncated
+        QCOMPARE(QString(records[2].method), QString(46, 'x'));
+    }
+
+    void save()
+    {
+        MessageTrace trace(2);
+        trace.add(MessageTrace::Type::SendRequest, "initialize", 1);
+        trace.add(MessageTrace::Type::ReceiveResponse, "initialize", 2);
+        trace.add(MessageTrace::Type::SendNotification, "initialized", 3);
+
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("trace.bin");
+        QVERIFY(trace.save(fileName));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QByteArray data = file.readAll();
+        QCOMPARE(data.size(), 12 + 2 * qsizetype(sizeof(MessageTrace::Record)));
+        QCOMPARE(data.first(8), QByteArray("KNUTLSPT"));
+        QCOMPARE(qFromLittleEndian<uint32_t>(data.constData() + 8), 2u);
+
+        MessageTrace::Record last;
+        std::memcpy(&last, data.constData() + 12 + sizeof(MessageTrace::Record), sizeof(last));
+        QCOMPARE(QString(last.method), "initialized");
+        QCOMPARE(last.size, 3u);
+
+        const auto records = MessageTrace::load(fileName);
+        QVERIFY(records.has_value());
+        QCOMPARE(records->size(), size_t(2));
+        QCOMPARE(QString(records->front().method), "initialize");
+        QVERIFY(records->front().type == MessageTrace::Type::ReceiveResponse);
+        QCOMPARE(records->back().size, 3u);
+
+        // Truncated file
+        QVERIFY(QFile::resize(fileName, data.size() - 1));
+        QVERIFY(!MessageTrace::load(fileName).has_value());
+    }
+};
+
+QTEST_MAIN(TestMessageTrace)
+#include "tst_messagetrace.moc"
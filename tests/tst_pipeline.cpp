@@ -0,0 +1,111 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/test_utils.h"
+#include "core/knutcore.h"
+#include "core/pipeline.h"
+#include "core/project.h"
+#include "core/textdocument.h"
+
+#include <QFile>
+#include <QJSEngine>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestPipeline : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QTemporaryDir &dir, const QString &fileName, const QByteArray &data)
+    {
+        QFile file(dir.filePath(fileName));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(data);
+    }
+
+    static QByteArray readFile(const QTemporaryDir &dir, const QString &fileName)
+    {
+        QFile file(dir.filePath(fileName));
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void query()
+    {
+        QTemporaryDir dir;
+        writeFile(dir, "a.cpp", "void a() { foo(); foo(); }\n");
+        writeFile(dir, "b.cpp", "void b() { bar(); }\n");
+        writeFile(dir, "notes.txt", "foo();\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        std::unique_ptr<Core::Pipeline> pipeline(project->pipeline({"a.cpp", "b.cpp", "notes.txt"}));
+        const auto results =
+            pipeline->query("(call_expression function: (identifier) @name (#eq? @name \"foo\")) @call")->run();
+        // The text file can't be parsed, and is dropped
+        QCOMPARE(results.size(), 2);
+        const auto first = results.at(0).toMap();
+        QCOMPARE(first.value("fileName").toString(), dir.filePath("a.cpp"));
+        QCOMPARE(first.value("matches").toList().size(), 2);
+        const auto second = results.at(1).toMap();
+        QCOMPARE(second.value("fileName").toString(), dir.filePath("b.cpp"));
+        QCOMPARE(second.value("matches").toList().size(), 0);
+
+        // A pipeline only runs once
+        Test::LogCounter counter;
+        QVERIFY(pipeline->run().isEmpty());
+        QCOMPARE(counter.count(), 1);
+    }
+
+    void mapApplySave()
+    {
+        QTemporaryDir dir;
+        writeFile(dir, "crlf.cpp", "int foo() { return 1; }\r\nvoid bar() { foo(); }\r\n");
+        writeFile(dir, "lf.cpp", "int baz() { return foo(); }\n");
+        writeFile(dir, "unchanged.cpp", "void value();\n");
+        writeFile(dir, "opened.cpp", "int opened();\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        auto document = qobject_cast<Core::TextDocument *>(project->get(dir.filePath("opened.cpp")));
+        QVERIFY(document);
+
+        QJSEngine engine;
+        auto pipeline = project->pipeline({"crlf.cpp", "lf.cpp", "unchanged.cpp", "opened.cpp"}, {{"window", 1}});
+        // The engine owns the pipeline, and calls the map functions
+        engine.newQObject(pipeline);
+        const auto skipUnchanged = engine.evaluate("(item => item.text.startsWith('int'))");
+        const auto edits = engine.evaluate("(item => [{start: 0, end: 3, text: 'long'}])");
+        const auto result = pipeline->parse()->map(skipUnchanged)->map(edits)->apply()->save();
+
+        QCOMPARE(result.size(), 3);
+        QCOMPARE(result.value(dir.filePath("crlf.cpp")).toInt(), 1);
+        QCOMPARE(result.value(dir.filePath("lf.cpp")).toInt(), 1);
+        QCOMPARE(result.value(dir.filePath("opened.cpp")).toInt(), 1);
+
+        // Line endings are kept, and only the changed files are written
+        QCOMPARE(readFile(dir, "crlf.cpp"), QByteArray("long foo() { return 1; }\r\nvoid bar() { foo(); }\r\n"));
+        QCOMPARE(readFile(dir, "lf.cpp"), QByteArray("long baz() { return foo(); }\n"));
+        QCOMPARE(readFile(dir, "unchanged.cpp"), QByteArray("void value();\n"));
+
+        // Opened documents are changed in memory
+        QCOMPARE(document->text(), "long opened();\n");
+        QCOMPARE(readFile(dir, "opened.cpp"), QByteArray("int opened();\n"));
+    }
+};
+
+QTEST_MAIN(TestPipeline)
+#include "tst_pipeline.moc"
@@ -0,0 +1,113 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/file.h"
+#include "core/knutcore.h"
+#include "core/project.h"
+#include "core/qdirvaluetype.h"
+#include "core/settings.h"
+#include "core/textdocument.h"
+
+#include <QFile>
+#include <QJSEngine>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestProject : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(data);
+    }
+
+    static QByteArray readFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return {};
+        return file.readAll();
+    }
+
+private slots:
+    void maxOpenDocuments()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        for (const auto &name : {"a", "b", "c", "d", "e"})
+            writeFile(dir.filePath(QString("%1.txt").arg(name)), QByteArray(name) + '\n');
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        Core::Settings::instance()->setValue(Core::Settings::MaxOpenDocuments, 2);
+
+        auto a = qobject_cast<Core::TextDocument *>(project->get("a.txt"));
+        QVERIFY(a);
+        a->setText("changed\n");
+        project->get("b.txt");
+        project->get("c.txt");
+
+        // The least recently used document is saved when closed, and loaded again by get
+        QCOMPARE(project->documents().size(), 2);
+        QCOMPARE(readFile(dir.filePath("a.txt")), "changed\n");
+        a = qobject_cast<Core::TextDocument *>(project->get("a.txt"));
+        QVERIFY(a);
+        QCOMPARE(a->text(), "changed\n");
+        QCOMPARE(project->documents().size(), 2);
+
+        // A document still referenced by a script is kept, until it's garbage collected
+        auto c = project->get("c.txt");
+        QJSEngine engine;
+        engine.globalObject().setProperty("held", engine.newQObject(c));
+        project->get("d.txt");
+        QVERIFY(project->documents().contains(c));
+        QVERIFY(!project->documents().contains(a));
+
+        engine.globalObject().deleteProperty("held");
+        engine.collectGarbage();
+        project->get("e.txt");
+        QVERIFY(!project->documents().contains(c));
+        QCOMPARE(project->documents().size(), 2);
+
+        Core::Settings::instance()->setValue(Core::Settings::MaxOpenDocuments, 0);
+    }
+
+    void indexScriptChanges()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.filePath("a.txt"), "a\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        QCOMPARE(project->allFiles(), QStringList({"a.txt"}));
+
+        // The event loop doesn't run, the index is updated by the calls themselves
+        QVERIFY(Core::File::copy(dir.filePath("a.txt"), dir.filePath("b.txt")));
+        QVERIFY(Core::QDirValueType(dir.path()).mkpath("sub/dir"));
+        QVERIFY(Core::File::touch(dir.filePath("sub/dir/c.txt")));
+        auto document = project->get("a.txt");
+        QVERIFY(document->saveAs(dir.filePath("sub/d.txt")));
+        QCOMPARE(project->allFiles(), QStringList({"a.txt", "b.txt", "sub/d.txt", "sub/dir/c.txt"}));
+
+        QVERIFY(Core::File::rename(dir.filePath("b.txt"), dir.filePath("sub/b.txt")));
+        QVERIFY(Core::QDirValueType(dir.filePath("sub/dir")).removeRecursively());
+        QCOMPARE(project->allFilesWithExtension("txt"), QStringList({"a.txt", "sub/b.txt", "sub/d.txt"}));
+    }
+};
+
+QTEST_MAIN(TestProject)
+#include "tst_project.moc"
@@ -0,0 +1,65 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "common/test_utils.h"
+#include "core/cppdocument.h"
+#include "core/knutcore.h"
+#include "core/project.h"
+#include "projectgenerator.h"
+
+#include <QDirIterator>
+#include <QTemporaryDir>
+#include <QTest>
+
+class TestProjectGen : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void generateProject()
+    {
+        const ProjectGen::ProjectOptions options {
+            .modules = 2, .dialogs = 3, .controls = 4, .strings = 5, .uiFiles = 1};
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(ProjectGen::generateProject(dir.path(), options));
+
+        int count = 0;
+        QDirIterator it(dir.path(), QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            ++count;
+        }
+        QCOMPARE(count, ProjectGen::fileCount(options));
+        QCOMPARE(ProjectGen::fileCount({.modules = 100, .dialogs = 48, .uiFiles = 1}), 10000);
+
+        // The content only depends on the options
+        QTemporaryDir otherDir;
+        QVERIFY(otherDir.isValid());
+        QVERIFY(ProjectGen::generateProject(otherDir.path(), options));
+        QVERIFY(Test::compareDirectories(dir.path(), otherDir.path()));
+
+        // The classes are read by knut as MFC dialogs
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        const auto className = ProjectGen::generatedClassName(1, 2);
+        auto document = qobject_cast<Core::CppDocument *>(project->get(QString("module1/%1.cpp").arg(className)));
+        QVERIFY(document);
+        const auto messageMap = document->mfcExtractMessageMap(className);
+        QVERIFY(messageMap.isValid());
+        QCOMPARE(messageMap.superClass, "CDialog");
+    }
+};
+
+QTEST_MAIN(TestProjectGen)
+#include "tst_projectgen.moc"
@@ -0,0 +1,74 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/knutcore.h"
+#include "core/qmldocument.h"
+#include "core/rangemark.h"
+
+#include <QTest>
+
+class TestQmlDocument : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Q_INIT_RESOURCE(core); }
+
+    void index()
+    {
+        Core::KnutCore core;
+        Core::QmlDocument document;
+        document.setText(R"(import QtQuick
+import QtQuick.Controls
+
+Item {
+    id: root
+    property int count
+    property string title: "Hello"
+    width: 100
+    anchors.fill: parent
+
+    Button {
+        id: okButton
+        text: qsTr("Ok")
+        onClicked: root.count++
+        Component.onCompleted: console.log("ready")
+    }
+    contentItem: Rectangle {
+        id: background;
+        color: "red"
+    }
+    function reset() { count = 0 }
+}
+)");
+        QCOMPARE(document.ids(), QStringList({"root", "okButton", "background"}));
+        QCOMPARE(document.objectType(""), "Item");
+        QCOMPARE(document.objectType("okButton"), "Button");
+        QVERIFY(document.objectById("background").text().startsWith("Rectangle {"));
+
+        QCOMPARE(document.properties("root"), QStringList({"count", "title"}));
+        QCOMPARE(document.bindings("root"), QStringList({"id", "width", "anchors.fill", "contentItem"}));
+        QCOMPARE(document.handlers("okButton"), QStringList({"onClicked", "Component.onCompleted"}));
+        QCOMPARE(document.member("okButton", "text").text(), "text: qsTr(\"Ok\")");
+        QCOMPARE(document.memberValue("root", "title").text(), "\"Hello\"");
+        QVERIFY(!document.memberValue("root", "count").isValid());
+        QVERIFY(!document.member("root", "reset").isValid());
+        QVERIFY(!document.objectById("missing").isValid());
+
+        // The index follows the changes of the document
+        document.memberValue("okButton", "text").replace("qsTr(\"Cancel\")");
+        document.member("background", "id").replace("id: frame");
+        QCOMPARE(document.memberValue("okButton", "text").text(), "qsTr(\"Cancel\")");
+        QCOMPARE(document.ids(), QStringList({"root", "okButton", "frame"}));
+    }
+};
+
+QTEST_MAIN(TestQmlDocument)
+#include "tst_qmldocument.moc"
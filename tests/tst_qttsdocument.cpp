@@ -11,6 +11,9 @@
 #include "common/test_utils.h"
 #include "core/qttsdocument.h"
 
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
 
 class TestQtTsDocument : public QObject
@@ -126,6 +129,40 @@ private slots:
         }
     }
 
+    void addMessages()
+    {
+        Core::QtTsDocument document;
+        document.load(Test::testDataPath() + QStringLiteral("/tst_qttsdocument/language_translation.ts"));
+        const auto count = document.messages().count();
+
+        QVariantList messages;
+        for (int i = 0; i < 100; ++i) {
+            messages.push_back(QVariantMap {{"context", i % 2 ? "foo" : "context_new"},
+                                            {"fileName", "new_loc"},
+                                            {"source", QString("original %1").arg(i)},
+                                            {"translation", QString("translated %1").arg(i)}});
+        }
+        QSignalSpy spy(&document, &Core::QtTsDocument::messagesChanged);
+        document.addMessages(messages);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(document.messages().count(), count + 100);
+
+        const auto message = document.messages().at(count + 99);
+        QCOMPARE(message->context(), "foo");
+        QCOMPARE(message->source(), "original 99");
+        QCOMPARE(message->translation(), "translated 99");
+
+        // Messages of the same context are added to the same node
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("messages.ts");
+        QVERIFY(document.saveAs(fileName));
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QString text = file.readAll();
+        QCOMPARE(text.count("<name>foo</name>"), 1);
+        QCOMPARE(text.count("<name>context_new</name>"), 1);
+    }
+
     void changeTranslation()
     {
         Core::QtTsDocument document;
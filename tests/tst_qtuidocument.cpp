@@ -12,6 +12,8 @@
 #include "core/qtuidocument.h"
 #include "core/utils.h"
 
+#include <QPushButton>
+#include <QSignalSpy>
 #include <QTest>
 
 class TestQtUiDocument : public QObject
@@ -42,6 +44,21 @@ private slots:
         QCOMPARE(widget, nullptr);
     }
 
+    void renameWidget()
+    {
+        Core::QtUiDocument document;
+        document.load(Test::testDataPath() + QStringLiteral("/tst_qtuidocument/IDD_ABCCOMPILE.ui"));
+
+        auto widget = document.findWidget("IDC_RADIO_YUP");
+        QVERIFY(widget);
+        widget->setName("radioYup");
+        QCOMPARE(document.findWidget("radioYup"), widget);
+        QCOMPARE(document.findWidget("IDC_RADIO_YUP"), nullptr);
+
+        auto newWidget = document.addWidget("QPushButton", "IDC_RADIO_YUP", document.widgets().first());
+        QCOMPARE(document.findWidget("IDC_RADIO_YUP"), newWidget);
+    }
+
     void save()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_qtuidocument/IDD_LIGHTING.ui");
@@ -145,6 +162,44 @@ private slots:
             QVERIFY(widget->getProperty("idString").isNull());
         }
     }
+
+    void setProperties()
+    {
+        Core::QtUiDocument document;
+        document.load(Test::testDataPath() + QStringLiteral("/tst_qtuidocument/TutorialDlg.ui"));
+
+        auto widget = document.findWidget("btn_add");
+        widget->setProperties({{"text", "Add"}, {"default", false}, {"geometry", QRect(1, 2, 3, 4)}});
+        QVERIFY(document.hasChanged());
+        QCOMPARE(widget->getProperty("text").toString(), "Add");
+        QCOMPARE(widget->getProperty("default").toBool(), false);
+        QCOMPARE(widget->getProperty("geometry").toRect(), QRect(1, 2, 3, 4));
+        QCOMPARE(widget->getProperty("idString").toString(), "ID_BTN_ADD");
+
+        // Nothing is changed if one of the values is not supported
+        widget->setProperties({{"text", "Remove"}, {"value", 1.5}});
+        QCOMPARE(widget->getProperty("text").toString(), "Add");
+        QVERIFY(widget->getProperty("value").isNull());
+    }
+
+    void createPreview()
+    {
+        Core::QtUiDocument document;
+        document.load(Test::testDataPath() + QStringLiteral("/tst_qtuidocument/TutorialDlg.ui"));
+        QSignalSpy uiChangedSpy(&document, &Core::QtUiDocument::uiChanged);
+
+        // The preview is created from the document in memory, with the changes not saved
+        document.findWidget("btn_add")->setProperties({{"text", "Add"}});
+        QCOMPARE(uiChangedSpy.count(), 1);
+
+        QString errorString;
+        std::unique_ptr<QWidget> preview(document.createPreview(errorString));
+        QVERIFY(preview);
+        QVERIFY(errorString.isEmpty());
+        auto button = preview->findChild<QPushButton *>("btn_add");
+        QVERIFY(button);
+        QCOMPARE(button->text(), "Add");
+    }
 };
 
 QTEST_MAIN(TestQtUiDocument)
@@ -89,6 +89,30 @@ private slots:
         QCOMPARE(lexer.next()->toString(), token);
     }
 
+    void testKeywords()
+    {
+        const auto keywords = Lexer::keywords();
+        QCOMPARE(keywords.size(), 84);
+        for (const auto &keyword : keywords) {
+            Stream stream(keyword);
+            Lexer lexer(stream);
+            QCOMPARE(lexer.next()->type, Token::Keyword);
+        }
+
+        for (const auto &word : {"BEGINX", "begin", "BEGI", "IDC_BEGIN", "ÉTAT"}) {
+            Stream stream(QString::fromUtf8(word));
+            Lexer lexer(stream);
+            const auto token = lexer.next();
+            QCOMPARE(token->type, Token::Word);
+            QCOMPARE(token->toString(), QString::fromUtf8(word));
+        }
+
+        // A keyword with several names is printed with the first one
+        Stream stream("MFT_SEPARATOR");
+        Lexer lexer(stream);
+        QCOMPARE(lexer.next()->prettyPrint(), "SEPARATOR");
+    }
+
     void testControl()
     {
         Stream stream("    COMBOBOX         \"Text\",CLASS, -1, 05, 1, 234,STYLE_1 |"
@@ -11,6 +11,8 @@
 #include "common/test_utils.h"
 #include "rccore/rcfile.h"
 
+#include <QDir>
+#include <QTemporaryDir>
 #include <QTest>
 
 using namespace RcCore;
@@ -188,6 +190,182 @@ private slots:
         QCOMPARE(context.text, "Context1");
         QCOMPARE(context.categories.size(), 1);
     }
+
+    void testCache()
+    {
+        QTemporaryDir cacheDir;
+        const QString fileName = Test::testDataPath() + "/rcfiles/dialog/dialog.rc";
+
+        const RcFile rcFile = parse(fileName);
+        const RcFile firstFile = parseCached(fileName, cacheDir.path());
+        QCOMPARE(QDir(cacheDir.path()).entryList(QDir::Files).size(), 1);
+
+        const RcFile cachedFile = parseCached(fileName, cacheDir.path());
+        for (const auto &file : {firstFile, cachedFile}) {
+            QCOMPARE(file.isValid, true);
+            QCOMPARE(file.content, rcFile.content);
+            QCOMPARE(file.includes.size(), rcFile.includes.size());
+            QCOMPARE(file.resourceMap, rcFile.resourceMap);
+            QCOMPARE(file.data.keys(), rcFile.data.keys());
+            const auto data = file.data.value(en_US);
+            QCOMPARE(data.strings.value("IDS_ABOUTBOX"), rcFile.data.value(en_US).strings.value("IDS_ABOUTBOX"));
+            QCOMPARE(data.dialogs.size(), rcFile.data.value(en_US).dialogs.size());
+            QCOMPARE(data.dialogDataList.first().values, rcFile.data.value(en_US).dialogDataList.first().values);
+        }
+
+        // Changing the file invalidates the cache
+        QTemporaryDir fileDir;
+        const QString copyName = fileDir.filePath("dialog.rc");
+        QVERIFY(QFile::copy(fileName, copyName));
+        QCOMPARE(parseCached(copyName, cacheDir.path()).content, rcFile.content);
+        {
+            QFile file(copyName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(QString(rcFile.content + "// Changed\n").toUtf8());
+        }
+        QVERIFY(parseCached(copyName, cacheDir.path()).content.endsWith("// Changed\n"));
+    }
+
+    void testLanguages()
+    {
+        // Each language is parsed on its own, the result must be the same as parsing the file in one go
+        QTemporaryDir dir;
+        {
+            QFile file(dir.filePath("resource.h"));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("#define IDS_HELLO 100\n#define IDS_WORLD 101\n");
+        }
+        {
+            QFile file(dir.filePath("languages.rc"));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("LANGUAGE LANG_ENGLISH, SUBLANG_ENGLISH_US\n"
+                       "STRINGTABLE\nBEGIN\n    100 \"Hello\"\nEND\n"
+                       "#include \"resource.h\"\n"
+                       "STRINGTABLE\nBEGIN\n    101 \"World\"\nEND\n"
+                       "LANGUAGE LANG_FRENCH, SUBLANG_FRENCH\n"
+                       "STRINGTABLE\nBEGIN\n    100 \"Bonjour\"\nEND\n"
+                       "LANGUAGE LANG_ENGLISH, SUBLANG_ENGLISH_US\n"
+                       "STRINGTABLE\nBEGIN\n    102 \"Again\"\nEND\n");
+        }
+
+        const RcFile rcFile = parse(dir.filePath("languages.rc"));
+        QVERIFY(rcFile.isValid);
+        QCOMPARE(rcFile.data.size(), 2);
+
+        const auto english = rcFile.data.value(en_US);
+        QCOMPARE(english.strings.size(), 3);
+        QCOMPARE(english.strings.value("100").text, "Hello");
+        QCOMPARE(english.strings.value("IDS_WORLD").text, "World");
+        QCOMPARE(english.strings.value("IDS_WORLD").line, 9);
+        QCOMPARE(english.strings.value("102").text, "Again");
+
+        const auto french = rcFile.data.value(fr_FR);
+        QCOMPARE(french.strings.size(), 1);
+        QCOMPARE(french.strings.value("IDS_HELLO").text, "Bonjour");
+        QCOMPARE(french.strings.value("IDS_HELLO").line, 14);
+    }
+
+    void testResourceFile()
+    {
+        QTemporaryDir dir;
+        auto writeFile = [&dir](const QString &fileName, const QByteArray &content) {
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(content);
+        };
+        writeFile("resource.h", "// Comment\r\n#define IDS_HELLO 100\r\n#define\tIDS_WORLD\t101\r\n"
+                                "#define IDS_INVALID 10x\r\n#ifdef APSTUDIO_INVOKED\r\n#endif\r\n");
+        writeFile("resource.rc", "#include \"resource.h\"\n");
+
+        RcFile rcFile = parse(dir.filePath("resource.rc"));
+        QCOMPARE(rcFile.resourceMap.size(), 2);
+        QCOMPARE(rcFile.resourceMap.value(100), "IDS_HELLO");
+        QCOMPARE(rcFile.resourceMap.value(101), "IDS_WORLD");
+
+        // The header is loaded again once it changes
+        writeFile("resource.h", "#define IDS_GOODBYE 102\n");
+        rcFile = parse(dir.filePath("resource.rc"));
+        QCOMPARE(rcFile.resourceMap.size(), 1);
+        QCOMPARE(rcFile.resourceMap.value(102), "IDS_GOODBYE");
+    }
+
+    void testMergeLanguages()
+    {
+        auto createData = [](const QString &language, const QStringList &ids) {
+            Data data;
+            data.language = language;
+            for (const auto &id : ids) {
+                Data::Dialog dialog;
+                dialog.id = id;
+                dialog.caption = language;
+                data.dialogs.append(dialog);
+                data.strings[id] = {id, language, -1};
+            }
+            return data;
+        };
+
+        RcFile rcFile;
+        rcFile.data[en_US] = createData(en_US, {"IDD_ABOUTBOX", "IDD_ENGLISH"});
+        rcFile.data[fr_FR] = createData(fr_FR, {"IDD_ABOUTBOX", "IDD_FRENCH"});
+        rcFile.data["LANG_GERMAN;SUBLANG_GERMAN"] = createData("LANG_GERMAN;SUBLANG_GERMAN", {"IDD_GERMAN"});
+        rcFile.mergeLanguages({fr_FR, en_US}, en_US);
+
+        // The items already in the resulting language are kept, the other ones are added if their id is new
+        QCOMPARE(rcFile.data.size(), 2);
+        const auto data = rcFile.data.value(en_US);
+        QCOMPARE(data.language, en_US);
+        QCOMPARE(data.dialogs.size(), 3);
+        QCOMPARE(data.dialogs.at(0).id, "IDD_ABOUTBOX");
+        QCOMPARE(data.dialogs.at(0).caption, en_US);
+        QCOMPARE(data.dialogs.at(1).id, "IDD_ENGLISH");
+        QCOMPARE(data.dialogs.at(2).id, "IDD_FRENCH");
+        QCOMPARE(data.strings.size(), 3);
+        QCOMPARE(data.strings.value("IDD_ABOUTBOX").text, en_US);
+        QCOMPARE(data.strings.value("IDD_FRENCH").text, fr_FR);
+        QCOMPARE(data.dialog("IDD_FRENCH"), &data.dialogs.at(2));
+        QVERIFY(rcFile.data.contains("LANG_GERMAN;SUBLANG_GERMAN"));
+    }
+
+    void testIndexes()
+    {
+        RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/dialog/dialog.rc");
+        const auto data = rcFile.data.value(en_US);
+
+        const auto dialog = data.dialog("IDD_DIALOG_DIALOG");
+        QVERIFY(dialog);
+        QCOMPARE(dialog->id, "IDD_DIALOG_DIALOG");
+        QVERIFY(dialog->control("IDCANCEL"));
+        QCOMPARE(dialog->control("IDCANCEL")->text, "Cancel");
+        QVERIFY(!dialog->control("IDC_DOES_NOT_EXIST"));
+        QVERIFY(!data.dialog("IDD_DOES_NOT_EXIST"));
+
+        // Lookups are still correct after changing a list, even without rebuilding the indexes
+        auto copy = data;
+        QCOMPARE(copy.dialogs.takeFirst().id, "IDD_ABOUTBOX");
+        QVERIFY(!copy.dialog("IDD_ABOUTBOX"));
+        QCOMPARE(copy.dialog("IDD_DIALOG_DIALOG"), &std::as_const(copy.dialogs).first());
+    }
+
+    void testStringPool()
+    {
+        QTemporaryDir cacheDir;
+        const QString fileName = Test::testDataPath() + "/rcfiles/dialog/dialog.rc";
+        parseCached(fileName, cacheDir.path());
+
+        // The same strings share their data, whether parsed or read from the cache
+        for (const auto &rcFile : {parse(fileName), parseCached(fileName, cacheDir.path())}) {
+            const auto data = rcFile.data.value(en_US);
+            const auto about = data.dialog("IDD_ABOUTBOX");
+            const auto dialog = data.dialog("IDD_DIALOG_DIALOG");
+            QVERIFY(about && dialog);
+
+            auto styleData = [](const Data::Dialog *dialog, const QString &style) {
+                return dialog->styles.at(dialog->styles.indexOf(style)).constData();
+            };
+            QCOMPARE(styleData(about, "WS_POPUP"), styleData(dialog, "WS_POPUP"));
+            QCOMPARE(about->control("IDOK")->id.constData(), dialog->control("IDOK")->id.constData());
+        }
+    }
 };
 
 QTEST_APPLESS_MAIN(TestRcParser)
@@ -12,8 +12,11 @@
 #include "rccore/rcfile.h"
 
 #include <QBuffer>
+#include <QDir>
 #include <QFile>
+#include <QImage>
 #include <QSet>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QUiLoader>
 
@@ -124,6 +127,29 @@ private slots:
         }
     }
 
+    void testWriteDialogs()
+    {
+        RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/cryEdit/CryEdit.rc");
+        auto data = rcFile.data.value("LANG_ENGLISH;SUBLANG_ENGLISH_US");
+
+        QTemporaryDir dir;
+        const QString outputDir = dir.filePath("ui");
+        QVERIFY(writeDialogsToUi(data, outputDir, RcCore::Widget::AllFlags).isEmpty());
+        QSet<QString> dialogIds;
+        for (const auto &dialog : std::as_const(data.dialogs))
+            dialogIds.insert(dialog.id);
+        QCOMPARE(QDir(outputDir).entryList({"*.ui"}).size(), dialogIds.size());
+
+        // Same output as writing the dialogs one by one
+        for (const auto &id : {QStringLiteral("IDD_LIGHTING"), QStringLiteral("IDD_CHARPANEL_ANIMATION")}) {
+            QFile file(QDir(outputDir).filePath(id + ".ui"));
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QFile expected(Test::testDataPath() + QStringLiteral("/tst_rcwriter/%1.ui").arg(id));
+            QVERIFY(expected.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), expected.readAll());
+        }
+    }
+
     void testConvertAction()
     {
         RcFile rcFile = parse(Test::testDataPath() + "/rcfiles/2048Game/2048Game.rc");
@@ -158,6 +184,105 @@ private slots:
         QCOMPARE(action.shortcuts.size(), 1);
         QCOMPARE(action.shortcuts.first().event, "Shift+F6");
     }
+
+    void testWriteImage()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        // Gray, magenta and red on the first row, blue for the bottom-left pixel
+        QImage bmp(3, 2, QImage::Format_RGB32);
+        bmp.fill(Qt::red);
+        bmp.setPixel(0, 0, qRgb(192, 192, 192));
+        bmp.setPixel(1, 0, qRgb(255, 0, 255));
+        bmp.setPixel(0, 1, qRgb(0, 0, 255));
+        QVERIFY(bmp.save(dir.filePath("toolbar.bmp")));
+
+        Asset asset;
+        asset.exist = true;
+        asset.originalFileName = dir.filePath("toolbar.bmp");
+        asset.fileName = dir.filePath("toolbar.png");
+
+        QVERIFY(writeAssetsToImage({asset}, Asset::Gray | Asset::Magenta).isEmpty());
+        QImage png(asset.fileName);
+        QCOMPARE(png.pixel(0, 0), qRgba(0, 0, 0, 0));
+        QCOMPARE(png.pixel(1, 0), qRgba(0, 0, 0, 0));
+        QCOMPARE(png.pixel(2, 0), qRgb(255, 0, 0));
+        QCOMPARE(png.pixel(0, 1), qRgb(0, 0, 255));
+
+        writeAssetsToImage({asset}, Asset::BottomLeftPixel);
+        png.load(asset.fileName);
+        QCOMPARE(png.pixel(0, 0), qRgb(192, 192, 192));
+        QCOMPARE(png.pixel(0, 1), qRgba(0, 0, 0, 0));
+        QCOMPARE(png.pixel(2, 1), qRgb(255, 0, 0));
+
+        // Icons split from the same strip, the errors are reported for each asset
+        QList<Asset> icons;
+        for (int i = 0; i < 3; ++i) {
+            Asset icon = asset;
+            icon.fileName = dir.filePath(QString("icon_%1.png").arg(i));
+            icon.iconRect = QRect(i, 0, 1, 2);
+            icons.push_back(icon);
+        }
+        Asset missing = asset;
+        missing.originalFileName = dir.filePath("missing.bmp");
+        icons.push_back(missing);
+        const auto errors = writeAssetsToImage(icons, Asset::Gray);
+        QCOMPARE(errors.size(), 1);
+        QVERIFY(errors.first().contains("missing.bmp"));
+        for (int i = 0; i < 3; ++i) {
+            png.load(dir.filePath(QString("icon_%1.png").arg(i)));
+            QCOMPARE(png.size(), QSize(1, 2));
+            QCOMPARE(png.pixel(0, 0), i == 0 ? qRgba(0, 0, 0, 0) : bmp.pixel(i, 0));
+        }
+    }
+
+    void testWriteImageUnchanged()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QImage bmp(2, 2, QImage::Format_RGB32);
+        bmp.fill(qRgb(192, 192, 192));
+        QVERIFY(bmp.save(dir.filePath("toolbar.bmp")));
+
+        Asset asset;
+        asset.exist = true;
+        asset.originalFileName = dir.filePath("toolbar.bmp");
+        asset.fileName = dir.filePath("toolbar.png");
+        QVERIFY(writeAssetsToImage({asset}, Asset::Gray).isEmpty());
+        QVERIFY(QFile::exists(dir.filePath(".knut_assets")));
+
+        // Nothing changed, the image is not written again
+        auto markWritten = [&]() {
+            QFile file(asset.fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("not written");
+        };
+        auto isWritten = [&]() {
+            return !QImage(asset.fileName).isNull();
+        };
+        markWritten();
+        QVERIFY(writeAssetsToImage({asset}, Asset::Gray).isEmpty());
+        QVERIFY(!isWritten());
+
+        // Different conversion
+        QVERIFY(writeAssetsToImage({asset}, Asset::Magenta).isEmpty());
+        QVERIFY(isWritten());
+
+        // Different source, with a different size as the modification time may be the same
+        markWritten();
+        QImage newBmp(3, 2, QImage::Format_RGB32);
+        newBmp.fill(qRgb(255, 0, 255));
+        QVERIFY(newBmp.save(dir.filePath("toolbar.bmp")));
+        QVERIFY(writeAssetsToImage({asset}, Asset::Magenta).isEmpty());
+        QVERIFY(isWritten());
+
+        // Missing image
+        QVERIFY(QFile::remove(asset.fileName));
+        QVERIFY(writeAssetsToImage({asset}, Asset::Magenta).isEmpty());
+        QVERIFY(isWritten());
+    }
 };
 
 QTEST_MAIN(TestRcwriter)
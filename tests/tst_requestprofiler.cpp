@@ -0,0 +1,68 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "lsp/requestprofiler.h"
+
+#include <QTest>
+
+using namespace std::chrono_literals;
+
+class TestRequestProfiler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init() { Lsp::RequestProfiler::instance().clear(); }
+
+    void statistics()
+    {
+        auto &profiler = Lsp::RequestProfiler::instance();
+        for (int i = 0; i < 100; ++i)
+            profiler.requestSent("textDocument/hover", 100);
+        profiler.requestShared("textDocument/hover");
+        QCOMPARE(profiler.inFlight(), 100);
+
+        // 90 fast responses, and 10 slow ones
+        for (int i = 0; i < 90; ++i)
+            profiler.responseReceived("textDocument/hover", 1000, 1ms);
+        for (int i = 0; i < 9; ++i)
+            profiler.responseReceived("textDocument/hover", 1000, 100ms);
+        profiler.requestCancelled("textDocument/hover");
+        profiler.requestSent("textDocument/documentSymbol", 50);
+
+        const auto statistics = profiler.statistics();
+        QCOMPARE(statistics.size(), size_t(2));
+        QCOMPARE(profiler.inFlight(), 1);
+
+        const auto &hover = statistics.at(1);
+        QCOMPARE(hover.method, "textDocument/hover");
+        QCOMPARE(hover.count, 100);
+        QCOMPARE(hover.shared, 1);
+        QCOMPARE(hover.cancelled, 1);
+        QCOMPARE(hover.maxInFlight, 100);
+        QCOMPARE(hover.inFlight, 0);
+        QCOMPARE(hover.requestBytes, uint64_t(10000));
+        QCOMPARE(hover.responseBytes, uint64_t(99000));
+
+        // Percentiles are known within 20%
+        auto verifyLatency = [&](double percentile, std::chrono::microseconds expected) {
+            const auto latency = hover.latency(percentile);
+            QVERIFY(latency >= expected && latency <= expected * 6 / 5);
+        };
+        verifyLatency(0.5, 1ms);
+        verifyLatency(0.95, 100ms);
+        verifyLatency(0.99, 100ms);
+
+        QVERIFY(profiler.report().startsWith("LSP requests - 2 methods\n\ntextDocument/hover\n"));
+    }
+};
+
+QTEST_MAIN(TestRequestProfiler)
+#include "tst_requestprofiler.moc"
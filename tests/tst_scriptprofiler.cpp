@@ -0,0 +1,75 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/logger.h"
+#include "core/scriptprofiler.h"
+
+#include <QTest>
+#include <QThread>
+#include <nlohmann/json.hpp>
+
+static void select()
+{
+    LOG("TextDocument::select");
+    QThread::msleep(2);
+}
+
+static void replaceAll()
+{
+    LOG("TextDocument::replaceAll", QString("foo"));
+    for (int i = 0; i < 3; ++i)
+        select();
+}
+
+class TestScriptProfiler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void report()
+    {
+        auto &profiler = Core::ScriptProfiler::instance();
+        QVERIFY(!Core::ScriptProfiler::isEnabled());
+        select();
+
+        profiler.start();
+        QVERIFY(Core::ScriptProfiler::isEnabled());
+        replaceAll();
+        select();
+
+        const auto json = nlohmann::json::parse(profiler.report());
+        QCOMPARE(json["traceEvents"].size(), 5u);
+
+        // Nested calls are profiled, and their time is not counted in the self time of the caller
+        QCOMPARE(json["apis"].size(), 2u);
+        auto api = [&json](const std::string &name) {
+            for (const auto &api : json["apis"]) {
+                if (api["name"] == name)
+                    return api;
+            }
+            return nlohmann::json();
+        };
+        QCOMPARE(api("TextDocument::select")["count"].get<int>(), 4);
+        const auto replaceAllApi = api("TextDocument::replaceAll");
+        QCOMPARE(replaceAllApi["count"].get<int>(), 1);
+        QVERIFY(replaceAllApi["totalTime"].get<double>() >= 6000);
+        QVERIFY(replaceAllApi["selfTime"].get<double>() < 6000);
+
+        // Only the outermost calls are counted in the API time: replaceAll and the last select
+        QVERIFY(profiler.apiTime() >= 8'000'000);
+        QVERIFY(json["apiTime"].get<double>()
+                < replaceAllApi["totalTime"].get<double>() + api("TextDocument::select")["totalTime"].get<double>());
+        // There is no script running, so no script line
+        QVERIFY(json["lines"].empty());
+    }
+};
+
+QTEST_MAIN(TestScriptProfiler)
+#include "tst_scriptprofiler.moc"
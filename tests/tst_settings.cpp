@@ -114,6 +114,28 @@ private slots:
 
         QVERIFY(file.compare());
     }
+
+    void snapshot()
+    {
+        SettingsFixture settings;
+
+        const auto *defaultSnapshot = &settings.snapshot();
+        QCOMPARE(defaultSnapshot->lspServers.front().program, "clangd");
+        QVERIFY(defaultSnapshot->mimeTypes.at("cpp") == Core::Document::Type::Cpp);
+
+        settings.loadProjectSettings(Test::testDataPath() + "/tst_settings");
+        const auto *projectSnapshot = &settings.snapshot();
+        QCOMPARE(projectSnapshot->lspServers.front().program, "notclangd");
+        QVERIFY(projectSnapshot != defaultSnapshot);
+        // The previous snapshot is still valid
+        QCOMPARE(defaultSnapshot->lspServers.front().program, "clangd");
+
+        // A new snapshot is only published when its values change
+        settings.setValue("/foo", "baz");
+        QCOMPARE(&settings.snapshot(), projectSnapshot);
+        settings.setValue(Core::Settings::ParseTimeout, 100);
+        QCOMPARE(settings.snapshot().parseTimeout, 100);
+    }
 };
 
 QTEST_MAIN(TestSettings)
@@ -8,9 +8,13 @@
   Contact KDAB at <info@kdab.com> for commercial licensing options.
 */
 
+#include "utils/fuzzymatcher.h"
+#include "utils/ignorematcher.h"
+#include "utils/literalfinder.h"
 #include "utils/string_helper.h"
 
 #include <QTest>
+#include <QTextDocument>
 
 using namespace Utils;
 
@@ -134,6 +138,140 @@ private slots:
         QCOMPARE(matchCaseReplacement("pReFiXTeStPaDSuFfIx", "prefixfoobarsuffix"),
                  QString("pReFiXfoobarSuFfIx")); // mixed case, use replacement as specified
     }
+
+    void test_convertCaseMany()
+    {
+        const QStringList strings {"toSnakeCase", "x", "", "éléphantRose", "straßeName"};
+        const QStringList expected {"to_snake_case", "x", "", "éléphant_rose", "straße_name"};
+        QCOMPARE(convertCase(strings, Utils::Case::CamelCase, Utils::Case::SnakeCase), expected);
+        QCOMPARE(convertCase(expected, Utils::Case::SnakeCase, Utils::Case::UpperCase),
+                 QStringList({"TO_SNAKE_CASE", "X", "", "ÉLÉPHANT_ROSE", "STRASSE_NAME"}));
+        QCOMPARE(convertCase(expected, Utils::Case::SnakeCase, Utils::Case::PascalCase),
+                 QStringList({"ToSnakeCase", "X", "", "ÉléphantRose", "StraßeName"}));
+        QVERIFY(convertCase(QStringList(), Utils::Case::SnakeCase, Utils::Case::PascalCase).isEmpty());
+
+        // Non-ASCII replacements go through the full case mapping
+        QCOMPARE(matchCaseReplacement("STREET", "straße"), QString("STRASSE"));
+        QCOMPARE(matchCaseReplacement("Street", "élan"), QString("Élan"));
+    }
+
+    void test_literalFinder()
+    {
+        const QString text = "foo Foo foobar afoo FOO_foo foo";
+
+        // Short pattern, first character scan
+        Utils::LiteralFinder finder("foo");
+        QCOMPARE(finder.indexIn(text), 0);
+        QCOMPARE(finder.indexIn(text, 1), 8);
+        QCOMPARE(finder.lastIndexIn(text, 27), 24);
+        QCOMPARE(finder.lastIndexIn(text, 23), 16);
+        QCOMPARE(finder.findAll(text), QList<qsizetype>({0, 8, 16, 24, 28}));
+        QCOMPARE(finder.indexIn(text, 29), -1);
+        QCOMPARE(finder.lastIndexIn(text, -1), -1);
+
+        // Horspool search
+        QCOMPARE(Utils::LiteralFinder("foobar").findAll(text), QList<qsizetype>({8}));
+        QCOMPARE(Utils::LiteralFinder("oo F").findAll(text), QList<qsizetype>({1, 17}));
+        QCOMPARE(Utils::LiteralFinder("aaaa").findAll(QStringLiteral("aaaaaaaaa")), QList<qsizetype>({0, 4}));
+        QCOMPARE(Utils::LiteralFinder("foo foo").indexIn(text), 24);
+        QCOMPARE(Utils::LiteralFinder("foo  foo").indexIn(text), -1);
+
+        // Case insensitive
+        Utils::LiteralFinder insensitiveFinder("FoO", Qt::CaseInsensitive);
+        QCOMPARE(insensitiveFinder.findAll(text), QList<qsizetype>({0, 4, 8, 16, 20, 24, 28}));
+        QCOMPARE(Utils::LiteralFinder("FOOBAR", Qt::CaseInsensitive).findAll(text), QList<qsizetype>({8}));
+
+        // Whole words, with the same boundaries as \b in a regexp
+        QCOMPARE(Utils::LiteralFinder("foo", Qt::CaseSensitive, true).findAll(text), QList<qsizetype>({0, 28}));
+        QCOMPARE(Utils::LiteralFinder("foo", Qt::CaseInsensitive, true).findAll(text), QList<qsizetype>({0, 4, 28}));
+        QCOMPARE(Utils::LiteralFinder("FOO_foo", Qt::CaseSensitive, true).findAll(text), QList<qsizetype>({20}));
+        QCOMPARE(Utils::LiteralFinder(" foo", Qt::CaseSensitive, true).findAll(text), QList<qsizetype>({27}));
+
+        QCOMPARE(Utils::LiteralFinder("").indexIn(text), -1);
+    }
+
+    void test_cachedRegularExpression()
+    {
+        const auto expression = cachedRegularExpression("fo+", QRegularExpression::CaseInsensitiveOption);
+        QVERIFY(expression.isValid());
+        QVERIFY(expression.match("FOO").hasMatch());
+        // The same pattern and options share the compiled expression
+        QCOMPARE(cachedRegularExpression("fo+", QRegularExpression::CaseInsensitiveOption), expression);
+        QVERIFY(!cachedRegularExpression("fo+").match("FOO").hasMatch());
+
+        QVERIFY(!cachedRegularExpression("fo[").isValid());
+        QVERIFY(createRegularExpression("a.b", QTextDocument::FindCaseSensitively, false).match("a.b").hasMatch());
+        QVERIFY(!createRegularExpression("a.b", QTextDocument::FindCaseSensitively, false).match("axb").hasMatch());
+    }
+
+    void test_fuzzyMatcher()
+    {
+        QVERIFY(FuzzyMatcher::score(u"pal", u"palette.cpp", u"palette.cpp") > 0);
+        QCOMPARE(FuzzyMatcher::score(u"plx", u"palette.cpp", u"palette.cpp"), -1);
+        // Consecutive characters and word starts score higher
+        QVERIFY(FuzzyMatcher::score(u"doc", u"document.h", u"document.h")
+                > FuzzyMatcher::score(u"doc", u"dialogcontrol.h", u"dialogcontrol.h"));
+        QVERIFY(FuzzyMatcher::score(u"td", u"TextDocument.h", u"textdocument.h")
+                > FuzzyMatcher::score(u"td", u"itemdata.h", u"itemdata.h"));
+
+        const QStringList names = {"codedocument.cpp", "document.cpp", "palette.cpp", "textdocument.cpp", "project.h"};
+        const QStringList paths = {"src/core/codedocument.cpp", "src/core/document.cpp", "src/gui/palette.cpp",
+                                   "src/core/textdocument.cpp", "src/core/project.h"};
+        FuzzyMatcher matcher(3);
+        matcher.setFiles(names, paths);
+        QCOMPARE(matcher.match("").size(), size_t(3));
+
+        // Best match first, the number of results is limited
+        auto results = matcher.match("doc");
+        QCOMPARE(results.size(), size_t(3));
+        QCOMPARE(results.front(), 1);
+        // Extending the pattern narrows the previous results
+        results = matcher.match("docum.c");
+        QCOMPARE(results.size(), size_t(3));
+        results = matcher.match("TEXTD");
+        QCOMPARE(results, std::vector<int> {3});
+        // Matches in the path come after the matches in the name
+        results = matcher.match("guipal");
+        QCOMPARE(results, std::vector<int> {2});
+        // On the same score, the shortest name wins
+        results = matcher.match("p");
+        QCOMPARE(results.front(), 4);
+        QVERIFY(matcher.match("xyz").empty());
+    }
+
+    void test_ignoreMatcher()
+    {
+        IgnoreMatcher matcher;
+        QVERIFY(!matcher.isIgnored(u"main.cpp", false));
+
+        QVERIFY(matcher.setPatterns({}, {"# Comment", "", ".git", "build*/", "*.o", "/generated", "docs/**/*.png"}));
+        QVERIFY(!matcher.setPatterns({}, {"# Comment", "", ".git", "build*/", "*.o", "/generated", "docs/**/*.png"}));
+        QVERIFY(matcher.isIgnored(u".git", true));
+        QVERIFY(matcher.isIgnored(u"src/.git", false));
+        QVERIFY(matcher.isIgnored(u"build-debug", true));
+        // Only directories match a pattern ending with '/'
+        QVERIFY(!matcher.isIgnored(u"build.txt", false));
+        QVERIFY(matcher.isIgnored(u"src/main.o", false));
+        QVERIFY(!matcher.isIgnored(u"src/main.cpp", false));
+        // Anchored patterns only match from their directory
+        QVERIFY(matcher.isIgnored(u"generated", true));
+        QVERIFY(!matcher.isIgnored(u"src/generated", true));
+        QVERIFY(matcher.isIgnored(u"docs/image.png", false));
+        QVERIFY(matcher.isIgnored(u"docs/api/images/image.png", false));
+        QVERIFY(!matcher.isIgnored(u"image.png", false));
+
+        // Patterns of a subdirectory override the ones of its parents, the last matching one wins
+        QVERIFY(matcher.setPatterns("src", {"*.txt", "!keep.o", "!notes.txt"}));
+        QVERIFY(!matcher.isIgnored(u"src/keep.o", false));
+        QVERIFY(matcher.isIgnored(u"src/other.o", false));
+        QVERIFY(!matcher.isIgnored(u"src/notes.txt", false));
+        QVERIFY(matcher.isIgnored(u"src/lib/readme.txt", false));
+        QVERIFY(!matcher.isIgnored(u"readme.txt", false));
+
+        matcher.removePatterns("src");
+        QVERIFY(matcher.isIgnored(u"src/keep.o", false));
+        QVERIFY(!matcher.isIgnored(u"src/lib/readme.txt", false));
+    }
 };
 
 QTEST_APPLESS_MAIN(TestStringUtils)
@@ -0,0 +1,93 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "utils/taskscheduler.h"
+
+#include <QTest>
+#include <QThread>
+#include <atomic>
+
+class TestTaskScheduler : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() { Utils::TaskScheduler::setThreadCount(2); }
+
+    void taskGroup()
+    {
+        std::atomic<int> count = 0;
+        Utils::TaskGroup tasks;
+        for (int i = 0; i < 100; ++i) {
+            tasks.start([&count]() {
+                ++count;
+            });
+        }
+        tasks.wait();
+        QCOMPARE(count.load(), 100);
+
+        // The group can be used again once done
+        tasks.start([&count]() {
+            ++count;
+        });
+        tasks.wait();
+        QCOMPARE(count.load(), 101);
+    }
+
+    void nestedGroups()
+    {
+        // More groups waiting than worker threads: the tasks not started are run by the waiting threads
+        std::atomic<int> count = 0;
+        Utils::TaskGroup outer;
+        for (int i = 0; i < 8; ++i) {
+            outer.start([&count]() {
+                Utils::TaskGroup inner(Utils::TaskScheduler::Background);
+                for (int j = 0; j < 10; ++j) {
+                    inner.start([&count]() {
+                        ++count;
+                    });
+                }
+                inner.wait();
+            });
+        }
+        outer.wait();
+        QCOMPARE(count.load(), 80);
+    }
+
+    void cancel()
+    {
+        // Keep the workers busy, so the next tasks are still queued when the group is canceled
+        std::atomic<bool> release = false;
+        Utils::TaskGroup blockers(Utils::TaskScheduler::Interactive);
+        for (int i = 0; i < Utils::TaskScheduler::threadCount(); ++i) {
+            blockers.start([&release]() {
+                while (!release)
+                    QThread::msleep(1);
+            });
+        }
+
+        std::atomic<int> count = 0;
+        Utils::TaskGroup tasks;
+        for (int i = 0; i < 10; ++i) {
+            tasks.start([&count]() {
+                ++count;
+            });
+        }
+        tasks.cancel();
+        QVERIFY(tasks.isCancelled());
+        release = true;
+        tasks.wait();
+        blockers.wait();
+        QCOMPARE(count.load(), 0);
+    }
+};
+
+QTEST_APPLESS_MAIN(TestTaskScheduler)
+#include "tst_taskscheduler.moc"
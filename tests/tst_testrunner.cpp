@@ -0,0 +1,89 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/testrunner.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QXmlStreamReader>
+
+class TestTestRunner : public QObject
+{
+    Q_OBJECT
+
+private:
+    static void writeFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+
+private slots:
+    void findTests()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(QDir(dir.path()).mkpath("sub/tst_b"));
+        writeFile(dir.filePath("tst_a.qml"));
+        writeFile(dir.filePath("helper.qml"));
+        writeFile(dir.filePath("sub/tst_b.qml"));
+        writeFile(dir.filePath("sub/tst_b/tst_c.js"));
+
+        const auto tests = Core::TestRunner::findTests(dir.path());
+        QCOMPARE(tests, QStringList({dir.filePath("sub/tst_b.qml"), dir.filePath("tst_a.qml")}));
+        QCOMPARE(Core::TestRunner::testProject(tests.first()), dir.filePath("sub/tst_b"));
+        QVERIFY(Core::TestRunner::testProject(tests.last()).isEmpty());
+    }
+
+    void writeJUnitReport()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const std::vector<Core::TestRunner::Result> results {{dir.filePath("tst_a.qml"), 0, 1500, "ok"},
+                                                             {dir.filePath("sub/tst_b.qml"), 2, 250, "<failed>"}};
+        const QString fileName = dir.filePath("report.xml");
+        QVERIFY(Core::TestRunner::writeJUnitReport(fileName, dir.path(), results));
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QXmlStreamReader reader(&file);
+        QStringList names;
+        QStringList times;
+        int failures = 0;
+        QString output;
+        while (!reader.atEnd()) {
+            if (reader.readNext() != QXmlStreamReader::StartElement)
+                continue;
+            if (reader.name() == u"testsuite") {
+                QCOMPARE(reader.attributes().value("tests"), u"2");
+                QCOMPARE(reader.attributes().value("failures"), u"1");
+                QCOMPARE(reader.attributes().value("time"), u"1.750");
+            } else if (reader.name() == u"testcase") {
+                names.push_back(reader.attributes().value("name").toString());
+                times.push_back(reader.attributes().value("time").toString());
+            } else if (reader.name() == u"failure") {
+                ++failures;
+                QCOMPARE(reader.attributes().value("message"), u"exit code 2");
+            } else if (reader.name() == u"system-out") {
+                output = reader.readElementText();
+            }
+        }
+        QVERIFY(!reader.hasError());
+        QCOMPARE(names, QStringList({"tst_a.qml", "sub/tst_b.qml"}));
+        QCOMPARE(times, QStringList({"1.500", "0.250"}));
+        QCOMPARE(failures, 1);
+        QCOMPARE(output, "<failed>");
+    }
+};
+
+QTEST_APPLESS_MAIN(TestTestRunner)
+#include "tst_testrunner.moc"
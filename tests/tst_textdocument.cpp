@@ -11,12 +11,17 @@
 #include "common/test_utils.h"
 #include "core/knutcore.h"
 #include "core/mark.h"
+#include "core/project.h"
 #include "core/rangemark.h"
+#include "core/settings.h"
 #include "core/textdocument.h"
+#include "core/textdocument_p.h"
 #include "core/utils.h"
 
 #include <QDir>
 #include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
 #include <QTest>
 #include <QTextStream>
 
@@ -63,6 +68,24 @@ private slots:
         QCOMPARE(document.text(), LoremIpsumText);
     }
 
+    void lazyLoad()
+    {
+        Core::TextDocument document;
+        document.load(Test::testDataPath() + "/tst_textdocument/loremipsum_crlf_utf8bom.txt");
+
+        // Same text before and after it's set in the QTextDocument
+        const auto text = document.text();
+        QCOMPARE(text, LoremIpsumText);
+        QCOMPARE(document.lineAtPosition(static_cast<int>(text.size())), static_cast<int>(text.count('\n')) + 1);
+        QCOMPARE(document.textDocument()->toPlainText(), text);
+        QVERIFY(!document.hasChanged());
+
+        document.gotoEndOfDocument();
+        document.insert("end");
+        QCOMPARE(document.text(), text + "end");
+        QVERIFY(document.hasChanged());
+    }
+
     void detectAndSaveCodec_data()
     {
         QTest::addColumn<QString>("file");
@@ -104,6 +127,45 @@ private slots:
         QFile::remove(tempFile);
     }
 
+    void fallbackEncoding()
+    {
+        Core::KnutCore core;
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("cp1252.cpp");
+        auto writeFile = [&fileName](const QByteArray &data) {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        auto readFile = [&fileName]() {
+            QFile file(fileName);
+            return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+        };
+        // "// Café – 10€" in Windows-1252, which is not valid UTF-8
+        const QByteArray data("// Caf\xe9 \x96 10\x80\r\nint a;\r\n");
+        writeFile(data);
+
+        // Without a fallback encoding, the file is decoded as UTF-8
+        {
+            Core::TextDocument document;
+            document.load(fileName);
+            QVERIFY(document.text().startsWith("// Caf\ufffd"));
+        }
+
+        Core::Settings::instance()->setValue(Core::Settings::FallbackEncoding, QString("windows-1252"));
+        Core::TextDocument document;
+        document.load(fileName);
+        QCOMPARE(document.text(), QString::fromUtf8("// Café – 10€\nint a;\n"));
+        QCOMPARE(document.lineEnding(), Core::TextDocument::CRLFLineEnding);
+
+        // The file is saved with the same encoding
+        document.gotoEndOfDocument();
+        document.insert("// \u00fc\n");
+        document.save();
+        QCOMPARE(readFile(), data + "// \xfc\r\n");
+        Core::Settings::instance()->setValue(Core::Settings::FallbackEncoding, QString());
+    }
+
     void save()
     {
         Core::TextDocument document;
@@ -135,6 +197,39 @@ private slots:
         QFile::remove(saveAsFileName);
     }
 
+    void saveAllDocuments()
+    {
+        QTemporaryDir dir;
+        const QStringList fileNames = {dir.filePath("crlf.txt"), dir.filePath("lf.txt")};
+        const QList<QByteArray> contents = {"\xef\xbb\xbf\xc3\xa9t\xc3\xa9\r\nfoo\r\n", "hiver\nfoo\n"};
+        for (int i = 0; i < fileNames.size(); ++i) {
+            QFile file(fileNames.at(i));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(contents.at(i));
+        }
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        QList<Core::TextDocument *> documents;
+        for (const auto &fileName : fileNames) {
+            auto document = qobject_cast<Core::TextDocument *>(project->get(fileName));
+            QVERIFY(document);
+            document->gotoEndOfDocument();
+            document->insert("bar\n");
+            documents.push_back(document);
+        }
+
+        project->saveAllDocuments();
+        const QList<QByteArray> expected = {"\xef\xbb\xbf\xc3\xa9t\xc3\xa9\r\nfoo\r\nbar\r\n", "hiver\nfoo\nbar\n"};
+        for (int i = 0; i < fileNames.size(); ++i) {
+            QVERIFY(!documents.at(i)->hasChanged());
+            QFile file(fileNames.at(i));
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(file.readAll(), expected.at(i));
+        }
+    }
+
     void navigation()
     {
         Core::TextDocument document;
@@ -240,6 +335,135 @@ private slots:
         }
     }
 
+    void plainText()
+    {
+        Core::TextDocument document;
+        document.setText("Hello World!");
+        const int revision = document.textRevision();
+
+        // The text is shared until the next change
+        const auto text = document.plainText();
+        QCOMPARE(text, "Hello World!");
+        QCOMPARE(document.plainText().constData(), text.constData());
+        QCOMPARE(document.text().constData(), text.constData());
+
+        document.gotoEndOfDocument();
+        document.insert(" Bye!");
+        QCOMPARE(document.textRevision(), revision + 1);
+        QCOMPARE(document.plainText(), "Hello World! Bye!");
+        QCOMPARE(text, "Hello World!");
+    }
+
+    void lineIndex()
+    {
+        Core::TextDocument document;
+        document.setText("first\nsecond\n\nfourth");
+        QCOMPARE(document.lineAtPosition(0), 1);
+        QCOMPARE(document.lineAtPosition(8), 2);
+        QCOMPARE(document.columnAtPosition(8), 3);
+        QCOMPARE(document.lineAtPosition(13), 3);
+        QCOMPARE(document.lineAtPosition(document.text().size()), 4);
+        QCOMPARE(document.lineAtPosition(100), -1);
+        QCOMPARE(document.positionAt(4, 1), 14);
+        QCOMPARE(document.positionAt(5, 1), -1);
+
+        // The lines are kept up to date with the changes
+        const auto mark = document.createMark(14);
+        document.insertAtPosition("new\nlines\n", 6);
+        QCOMPARE(document.lineAtPosition(6), 2);
+        QCOMPARE(document.lineAtPosition(10), 3);
+        QCOMPARE(document.positionAt(4, 1), 16);
+        QCOMPARE(mark.line(), 6);
+        QCOMPARE(mark.column(), 1);
+
+        document.deleteRegion(0, 16);
+        QCOMPARE(document.positionAt(2, 1), 7);
+        QCOMPARE(document.lineAtPosition(8), 3);
+        QCOMPARE(mark.line(), 3);
+    }
+
+    void undoJournal()
+    {
+        Core::TextDocument document;
+        document.enableUndoJournal(3, 1000);
+        document.setText("foo bar\nbaz");
+        document.replace(0, 3, "one");
+        document.beginTransaction();
+        document.replace(4, 7, "two");
+        document.replace(8, 11, "three\nfour");
+        document.commit();
+        QCOMPARE(document.text(), "one two\nthree\nfour");
+
+        // The transaction is undone at once
+        document.undo();
+        QCOMPARE(document.text(), "one bar\nbaz");
+        document.redo();
+        QCOMPARE(document.text(), "one two\nthree\nfour");
+        document.undo(2);
+        QCOMPARE(document.text(), "foo bar\nbaz");
+        document.undo();
+        QCOMPARE(document.text(), "foo bar\nbaz");
+        document.redo(2);
+        QCOMPARE(document.text(), "one two\nthree\nfour");
+
+        // The oldest steps are dropped
+        document.replace(0, 3, "1");
+        document.replace(0, 1, "2");
+        document.replace(0, 1, "3");
+        document.undo(5);
+        QCOMPARE(document.text(), "one two\nthree\nfour");
+
+        // A new change drops the undone steps
+        document.replace(0, 3, "new");
+        document.redo();
+        QCOMPARE(document.text(), "new two\nthree\nfour");
+    }
+
+    void checkDocumentsOnDisk()
+    {
+        QTemporaryDir dir;
+        const QString fileName = dir.filePath("reload.txt");
+        const QString otherFileName = dir.filePath("conflict.txt");
+        // Each write sets its own modification time, seconds apart, so it changes even on coarse file systems
+        auto writeFile = [](const QString &fileName, const QByteArray &data, int secondsAhead) {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+            file.setFileTime(QDateTime::currentDateTime().addSecs(secondsAhead), QFileDevice::FileModificationTime);
+        };
+        writeFile(fileName, "a\nb\nc\nd\n", 10);
+        writeFile(otherFileName, "a\n", 10);
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+        auto document = qobject_cast<Core::TextDocument *>(project->get(fileName));
+        auto otherDocument = qobject_cast<Core::TextDocument *>(project->get(otherFileName));
+        QVERIFY(document && otherDocument);
+        document->gotoLine(3, 2);
+        const auto mark = document->createMark();
+        otherDocument->insert("b\n");
+
+        writeFile(fileName, "first\na\nb\nc\nd\n", 20);
+        writeFile(otherFileName, "c\n", 20);
+        QSignalSpy reloaded(document, &Core::Document::fileUpdated);
+        QSignalSpy conflicts(project, &Core::Project::documentsChangedOnDisk);
+        project->checkDocumentsOnDisk();
+        QVERIFY(reloaded.wait());
+
+        // Only the new line is inserted, the mark and the cursor are still on the same text
+        QCOMPARE(document->text(), "first\na\nb\nc\nd\n");
+        QVERIFY(!document->hasChanged());
+        QCOMPARE(mark.line(), 4);
+        QCOMPARE(mark.column(), 2);
+        QCOMPARE(document->line(), 4);
+
+        // A document with unsaved changes is not reloaded
+        QCOMPARE(conflicts.count(), 1);
+        QCOMPARE(conflicts.first().first().value<QList<Core::Document *>>(), QList<Core::Document *> {otherDocument});
+        QCOMPARE(otherDocument->text(), "b\na\n");
+    }
+
     void mark()
     {
         Core::TextDocument document;
@@ -326,6 +550,41 @@ private slots:
         QCOMPARE(other.textExcept(mark), "\nQuisque convallis ipsum ac odio aliquet tincidunt.");
     }
 
+    void manyMarks()
+    {
+        Core::TextDocument document;
+        document.setText(QString(100, 'a'));
+
+        // Create the marks out of order, and remove some of them before editing
+        QList<Core::Mark> marks;
+        QList<Core::RangeMark> rangeMarks;
+        for (int i = 99; i >= 0; --i) {
+            marks.push_back(document.createMark(i));
+            rangeMarks.push_back(document.createRangeMark(i / 2, i));
+        }
+        marks.erase(marks.begin(), marks.begin() + 60);
+        rangeMarks.erase(rangeMarks.begin(), rangeMarks.begin() + 60);
+
+        // Marks are now at position 39 to 0, range marks are [19, 39] to [0, 0]
+        document.setPosition(20);
+        document.insert("bb");
+        for (int i = 0; i < marks.size(); ++i) {
+            const int position = 39 - i;
+            QCOMPARE(marks.at(i).position(), position < 20 ? position : position + 2);
+            QCOMPARE(rangeMarks.at(i).start(), position / 2);
+            QCOMPARE(rangeMarks.at(i).end(), position < 20 ? position : position + 2);
+        }
+
+        // Marks outliving their document are invalid
+        auto *otherDocument = new Core::TextDocument;
+        otherDocument->setText("text");
+        auto mark = otherDocument->createMark(2);
+        auto rangeMark = otherDocument->createRangeMark(1, 3);
+        delete otherDocument;
+        QVERIFY(!mark.isValid());
+        QVERIFY(!rangeMark.isValid());
+    }
+
     void updateMark()
     {
         int mark = 10;
@@ -371,6 +630,27 @@ private slots:
         }
     }
 
+    void reindentRange()
+    {
+        Core::KnutCore core;
+        Core::TextDocument document;
+        const QString text = "void f()\n{\nfoo();\n\n\t  bar();\n}\n";
+        document.setText(text);
+        const auto body = document.createRangeMark(text.indexOf("foo"), text.indexOf("bar();") + 6);
+
+        // All the lines are changed in one edit, the blank line is left as is
+        QCOMPARE(document.reindentRange(body, 1), 2);
+        QCOMPARE(document.text(), "void f()\n{\n    foo();\n\n        bar();\n}\n");
+        QCOMPARE(document.reindentRange(body, 1), 2);
+        QCOMPARE(document.reindentRange(body, -3), 2);
+        QCOMPARE(document.text(), "void f()\n{\nfoo();\n\nbar();\n}\n");
+        QCOMPARE(document.reindentRange(body, 0), 0);
+
+        document.undo();
+        document.undo();
+        QCOMPARE(document.text(), "void f()\n{\n    foo();\n\n        bar();\n}\n");
+    }
+
     void findReplace()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/findReplace/findreplace.txt");
@@ -413,6 +693,160 @@ private slots:
         }
     }
 
+    void replaceAllInOnePass()
+    {
+        Core::TextDocument document;
+        document.setText("foo bar Foo baz FOO");
+        const auto barMark = document.createMark(4);
+        const auto bazRange = document.createRangeMark(12, 15);
+
+        QCOMPARE(document.replaceAll("foo", "quux", Core::TextDocument::PreserveCase), 3);
+        QCOMPARE(document.text(), "quux bar Quux baz QUUX");
+        QCOMPARE(barMark.position(), 5);
+        QCOMPARE(bazRange.text(), "baz");
+
+        // All the occurrences are replaced in one edit
+        document.undo();
+        QCOMPARE(document.text(), "foo bar Foo baz FOO");
+    }
+
+    void forEachMatch()
+    {
+        auto matches = [](const QString &text, const QString &pattern, int options) {
+            QList<std::pair<qsizetype, qsizetype>> result;
+            Core::forEachMatch(text, pattern, options, [&](qsizetype start, qsizetype end, auto) {
+                result.append({start, end});
+            });
+            return result;
+        };
+        using Matches = QList<std::pair<qsizetype, qsizetype>>;
+
+        const QString text = "foo Foo\nfoobar foo";
+        QCOMPARE(matches(text, "foo", Core::TextDocument::NoFindFlags), Matches({{0, 3}, {4, 7}, {8, 11}, {15, 18}}));
+        QCOMPARE(matches(text, "foo", Core::TextDocument::FindCaseSensitively | Core::TextDocument::FindWholeWords),
+                 Matches({{0, 3}, {15, 18}}));
+        // A regexp is matched line by line
+        QCOMPARE(matches(text, "o+$", Core::TextDocument::FindRegexp), Matches({{5, 7}, {16, 18}}));
+        QCOMPARE(matches(text, "foo\nfoo", Core::TextDocument::NoFindFlags), Matches());
+    }
+
+    void replaceRanges()
+    {
+        Core::TextDocument document;
+        document.setText("foo bar Foo baz FOO");
+        const auto foo = document.createRangeMark(0, 3);
+        const auto bar = document.createRangeMark(4, 7);
+        const auto baz = document.createRangeMark(12, 15);
+        const auto end = document.createRangeMark(19, 19);
+        const auto fooBar = document.createRangeMark(0, 7);
+
+        // The ranges can be in any order
+        QVERIFY(document.replaceRanges({baz, foo, end}, {"quux", "f", "!"}));
+        QCOMPARE(document.text(), "f bar Foo quux FOO!");
+        QCOMPARE(bar.text(), "bar");
+        QCOMPARE(fooBar.text(), "f bar");
+
+        // All the ranges are replaced in one edit
+        document.undo();
+        QCOMPARE(document.text(), "foo bar Foo baz FOO");
+
+        // Nothing is changed on errors
+        Test::LogCounter counter;
+        QVERIFY(!document.replaceRanges({foo, fooBar}, {"a", "b"}));
+        QVERIFY(!document.replaceRanges({foo, bar}, {"a"}));
+        QCOMPARE(counter.count(), 2);
+        QCOMPARE(document.text(), "foo bar Foo baz FOO");
+    }
+
+    void setTextDiff()
+    {
+        Core::TextDocument document;
+        document.setText("first\nsecond line\nthird\n");
+        const auto third = document.createMark(18);
+        const auto second = document.createRangeMark(6, 17);
+
+        // Only the differences are replaced, the marks stay on the same text
+        document.setText("first\nsecond changed line\nthird\nfourth\n");
+        QCOMPARE(document.text(), "first\nsecond changed line\nthird\nfourth\n");
+        QCOMPARE(third.position(), 26);
+        QCOMPARE(second.text(), "second changed line");
+
+        // Setting the same text doesn't change anything, the new text is one undo step
+        document.setText(document.text());
+        document.undo();
+        QCOMPARE(document.text(), "first\nsecond line\nthird\n");
+        QCOMPARE(third.position(), 18);
+    }
+
+    void setTextMostlyDifferent()
+    {
+        QString oldText = "header\n";
+        QString newText = "header\n";
+        for (int i = 0; i < 2000; ++i) {
+            oldText += QString("old line %1\n").arg(i);
+            newText += QString("new line %1\n").arg(i);
+        }
+        oldText += "footer\n";
+        newText += "footer\n";
+
+        // Too many lines changed for a line diff: one replacement, without the start and end that are the same
+        const auto replacements = Core::diffReplacements(oldText, newText);
+        QCOMPARE(replacements.size(), size_t {1});
+        QCOMPARE(replacements.front().start, 7);
+        QCOMPARE(replacements.front().end, static_cast<int>(oldText.size()) - 18);
+        QCOMPARE(replacements.front().text, newText.sliced(7, newText.size() - 25));
+
+        Core::TextDocument document;
+        document.setText(oldText);
+        const auto footer = document.createMark(oldText.size() - 7);
+        document.setText(newText);
+        QCOMPARE(document.text(), newText);
+        QCOMPARE(footer.position(), static_cast<int>(newText.size()) - 7);
+    }
+
+    void replaceAllInFiles()
+    {
+        QTemporaryDir dir;
+        auto writeFile = [&dir](const QString &fileName, const QByteArray &data) {
+            QFile file(dir.filePath(fileName));
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(data);
+        };
+        auto readFile = [&dir](const QString &fileName) {
+            QFile file(dir.filePath(fileName));
+            return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+        };
+        writeFile("crlf.cpp", "\xef\xbb\xbfint foo;\r\nfoo = 1;\r\n");
+        writeFile("lf.h", "foobar\nfoo\n");
+        writeFile("other.txt", "foo\n");
+        writeFile("unchanged.cpp", "bar\n");
+
+        Core::KnutCore core;
+        auto project = Core::Project::instance();
+        project->setRoot(dir.path());
+
+        const auto result =
+            project->replaceAllInFiles({"cpp", "h"}, "foo", "bar", Core::TextDocument::FindWholeWords);
+        QCOMPARE(result.size(), 2);
+        QCOMPARE(result.value(dir.filePath("crlf.cpp")).toInt(), 2);
+        QCOMPARE(result.value(dir.filePath("lf.h")).toInt(), 1);
+
+        // Line endings and BOM are kept
+        QCOMPARE(readFile("crlf.cpp"), QByteArray("\xef\xbb\xbfint bar;\r\nbar = 1;\r\n"));
+        QCOMPARE(readFile("lf.h"), QByteArray("foobar\nbar\n"));
+        QCOMPARE(readFile("other.txt"), QByteArray("foo\n"));
+        QCOMPARE(readFile("unchanged.cpp"), QByteArray("bar\n"));
+
+        // Opened documents are changed in memory
+        auto document = qobject_cast<Core::TextDocument *>(project->get(dir.filePath("lf.h")));
+        QVERIFY(document);
+        const auto regexpResult =
+            project->replaceAllInFiles({"h"}, "^(\\w+)bar$", "\\1baz", Core::TextDocument::FindRegexp);
+        QCOMPARE(regexpResult.value(dir.filePath("lf.h")).toInt(), 1);
+        QCOMPARE(document->text(), "foobaz\nbar\n");
+        QCOMPARE(readFile("lf.h"), QByteArray("foobar\nbar\n"));
+    }
+
     void findReplaceRegexForwards()
     {
         Test::FileTester file(Test::testDataPath() + "/tst_textdocument/findRegex/findregex.txt");
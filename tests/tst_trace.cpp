@@ -0,0 +1,103 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "utils/trace.h"
+
+#include <QTest>
+#include <QThread>
+#include <nlohmann/json.hpp>
+
+// The allocations are done by Qt, so the compiler can't remove them
+static void innerRegion()
+{
+    TRACE("inner");
+    const QByteArray data(100, 'x');
+    QCOMPARE(data.size(), 100);
+}
+
+static void outerRegion()
+{
+    TRACE("outer");
+    const QByteArray data(10, 'x');
+    innerRegion();
+    innerRegion();
+}
+
+class TestTrace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void disabled()
+    {
+        // The trace is only enabled by the environment variable, and the detail is not evaluated otherwise
+        QVERIFY(!Utils::Trace::isEnabled());
+        int evaluated = 0;
+        {
+            TRACE("disabled", QString::number(++evaluated));
+        }
+        QCOMPARE(evaluated, 0);
+    }
+
+    void report()
+    {
+        auto &trace = Utils::Trace::instance();
+        const auto start = trace.now();
+        trace.add("Document::load", "main.cpp", start, start + 2000);
+        auto thread = QThread::create([&trace]() {
+            trace.add("QueryCursor::execute", {}, trace.now(), trace.now() + 1000);
+        });
+        thread->setObjectName("Query thread");
+        thread->start();
+        QVERIFY(thread->wait());
+        delete thread;
+
+        const auto json = nlohmann::json::parse(trace.report());
+        const auto &events = json["traceEvents"];
+        QCOMPARE(events.size(), size_t(4));
+
+        // Each thread is named once, before the spans
+        QVERIFY(events[0]["ph"] == "M");
+        QVERIFY(events[0]["args"]["name"] == "Main thread");
+        QVERIFY(events[1]["args"]["name"] == "Query thread");
+        QVERIFY(events[2]["name"] == "Document::load");
+        QVERIFY(events[2]["ph"] == "X");
+        QCOMPARE(events[2]["dur"].get<double>(), 2.0);
+        QVERIFY(events[2]["args"]["detail"] == "main.cpp");
+        QCOMPARE(events[3]["tid"].get<int>(), 1);
+        QVERIFY(!events[3].contains("args"));
+        QVERIFY(!json["truncated"].get<bool>());
+    }
+
+    void allocStats()
+    {
+        Utils::AllocStats::reset();
+        outerRegion();
+        const auto regions = Utils::AllocStats::regions();
+        if (!Utils::AllocStats::isEnabled()) {
+            QVERIFY(regions.empty());
+            return;
+        }
+
+        QCOMPARE(regions.size(), size_t(2));
+        const auto &outer = regions[0];
+        const auto &inner = regions[1];
+        QCOMPARE(outer.name, "outer");
+        QCOMPARE(outer.calls, qint64(1));
+        QCOMPARE(inner.calls, qint64(2));
+        QVERIFY(inner.total.bytes >= 200);
+        // The allocations of the inner regions are part of the total of the outer one, not of its self
+        QCOMPARE(outer.total.allocations, outer.self.allocations + inner.total.allocations);
+        QVERIFY(outer.self.allocations >= 1);
+    }
+};
+
+QTEST_MAIN(TestTrace)
+#include "tst_trace.moc"
@@ -15,8 +15,13 @@
 #include "treesitter/query.h"
 #include "treesitter/transformation.h"
 #include "treesitter/tree.h"
+#include "treesitter/utf8source.h"
+#include "utils/cancellation.h"
 
+#include <QSet>
 #include <QTest>
+#include <algorithm>
+#include <future>
 
 class TestTreeSitter : public QObject
 {
@@ -54,6 +59,271 @@ private slots:
         QCOMPARE(root.namedChildren().size(), 9);
     }
 
+    void parserPool()
+    {
+        const auto source = readTestFile("/tst_treesitter/main.cpp");
+        for (int i = 0; i < 2; ++i) {
+            // The second parser comes from the pool, after the first one is released
+            treesitter::PooledParser parser(tree_sitter_cpp());
+            QCOMPARE(parser->language(), tree_sitter_cpp());
+            auto tree = parser->parseString(source);
+            QVERIFY(tree.has_value());
+            QCOMPARE(tree->rootNode().namedChildren().size(), 9);
+        }
+
+        // Parsers are pooled per language
+        auto parser = treesitter::ParserPool::acquire(tree_sitter_qmljs());
+        QCOMPARE(parser.language(), tree_sitter_qmljs());
+        treesitter::ParserPool::release(std::move(parser));
+    }
+
+    void includedRanges()
+    {
+        const QString source = "int a;\nvoid f() {}\nint b;\n";
+        const auto start = static_cast<uint32_t>(source.indexOf("void"));
+        const auto end = static_cast<uint32_t>(source.indexOf("int b"));
+        treesitter::PooledParser parser(tree_sitter_cpp());
+        QVERIFY(parser->setIncludedRanges({{.startPoint = {1, 0},
+                                            .endPoint = {2, 0},
+                                            .startByte = start * sizeof(QChar),
+                                            .endByte = end * sizeof(QChar)}}));
+        QCOMPARE(parser->includedRanges().size(), 1);
+
+        // Only the function is parsed, at its position in the whole text
+        auto tree = parser->parseString(source);
+        QVERIFY(tree.has_value());
+        const auto children = tree->rootNode().namedChildren();
+        QCOMPARE(children.size(), 1);
+        QCOMPARE(children.first().type(), "function_definition");
+        QCOMPARE(children.first().startPosition(), start);
+
+        // Overlapping ranges are refused, the whole text is parsed again
+        QVERIFY(!parser->setIncludedRanges({{.startByte = 8, .endByte = 4}}));
+        tree = parser->parseString(source);
+        QVERIFY(tree.has_value());
+        QCOMPARE(tree->rootNode().namedChildren().size(), 3);
+    }
+
+    void parserCancellation()
+    {
+        const auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+
+        std::atomic<size_t> cancel = 1;
+        parser.setCancellationFlag(&cancel);
+        QVERIFY(!parser.parseString(source).has_value());
+
+        // The parse continues where it stopped once the flag is cleared
+        cancel = 0;
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        QCOMPARE(tree->rootNode().namedChildren().size(), 9);
+
+        parser.setTimeout(std::chrono::microseconds(1000));
+        QCOMPARE(parser.timeout(), std::chrono::microseconds(1000));
+        parser.setCancellationFlag(nullptr);
+        parser.reset();
+        QVERIFY(parser.parseString(source).has_value());
+    }
+
+    void scriptCancellation()
+    {
+        const auto source = readTestFile("/tst_treesitter/main.cpp");
+        treesitter::Parser parser(tree_sitter_cpp());
+        const auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), "(function_definition) @function");
+
+        // Aborting the script stops the parses and the queries
+        Utils::Cancellation::cancel();
+        parser.reset();
+        QVERIFY(!parser.parseString(source).has_value());
+        treesitter::QueryCursor cursor;
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QVERIFY(!cursor.nextMatch().has_value());
+
+        Utils::Cancellation::reset();
+        QVERIFY(parser.parseString(source).has_value());
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QVERIFY(cursor.nextMatch().has_value());
+    }
+
+    void utf8Source()
+    {
+        // Non-ASCII characters of 2, 3 and 4 bytes in UTF-8, the last one is a surrogate pair in UTF-16
+        const QString source =
+            QString::fromUtf8("// é\nconst char *a = \"日本\";\nconst char *b = \"\U0001F600\";\nint c;\n");
+        treesitter::Parser parser(tree_sitter_cpp());
+        const auto utf16Tree = parser.parseString(source);
+        const auto utf8Tree = parser.parseUtf8(std::make_shared<treesitter::Utf8Source>(source));
+        QVERIFY(utf16Tree.has_value());
+        QVERIFY(utf8Tree.has_value());
+
+        // Same nodes at the same positions, whatever the encoding
+        QList<treesitter::Node> utf16Nodes {utf16Tree->rootNode()};
+        QList<treesitter::Node> utf8Nodes {utf8Tree->rootNode()};
+        while (!utf16Nodes.isEmpty()) {
+            const auto utf16Node = utf16Nodes.takeFirst();
+            const auto utf8Node = utf8Nodes.takeFirst();
+            QCOMPARE(utf8Node.type(), utf16Node.type());
+            QCOMPARE(utf8Node.startPosition(), utf16Node.startPosition());
+            QCOMPARE(utf8Node.endPosition(), utf16Node.endPosition());
+            utf16Nodes.append(utf16Node.children());
+            utf8Nodes.append(utf8Node.children());
+        }
+        QVERIFY(utf8Nodes.isEmpty());
+
+        const auto declaration = utf8Tree->rootNode().namedChildren().last();
+        QCOMPARE(declaration.textIn(source), "int c;");
+        QVERIFY(utf8Tree->rootNode().descendantForRange(declaration.startPosition(), declaration.endPosition())
+                == declaration);
+
+        treesitter::Utf8Source ascii(QString("int c;"));
+        QVERIFY(ascii.isAscii());
+        QCOMPARE(ascii.bytes(), QByteArray("int c;"));
+    }
+
+    void treeCursor()
+    {
+        auto source = readTestFile("/tst_treesitter/main.cpp");
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+        auto root = tree->rootNode();
+
+        QVector<treesitter::Node> children;
+        for (const auto &child : root.childRange())
+            children.append(child);
+        QCOMPARE(children, root.children());
+
+        QVector<treesitter::Node> namedChildren;
+        for (const auto &child : root.namedChildRange())
+            namedChildren.append(child);
+        QCOMPARE(namedChildren, root.namedChildren());
+
+        treesitter::TreeCursor cursor(root);
+        QVERIFY(!cursor.gotoParent());
+        QVERIFY(cursor.gotoFirstChild());
+        QCOMPARE(cursor.currentNode(), root.children().first());
+        QVERIFY(cursor.gotoParent());
+        QCOMPARE(cursor.currentNode(), root);
+
+        const auto last = root.children().last();
+        QVERIFY(cursor.gotoFirstChildForPosition(last.startPosition()));
+        QCOMPARE(cursor.currentNode(), last);
+        QCOMPARE(root.firstChildForPosition(last.startPosition()), last);
+        QVERIFY(root.firstChildForPosition(root.endPosition()).isNull());
+    }
+
+    void nodeTypes()
+    {
+        // field_identifier is an alias of identifier, ERROR a builtin symbol
+        const QString source = "struct S { int m_value; };\nint main() { return S().m_value + ); }\n// comment\n";
+        const QStringList types = {"identifier", "field_identifier", "comment", "ERROR", "(", "return"};
+        const treesitter::NodeTypes nodeTypes(tree_sitter_cpp(), types);
+        QVERIFY(!nodeTypes.isEmpty());
+        QVERIFY(treesitter::NodeTypes(tree_sitter_cpp(), {"not_a_node_type"}).isEmpty());
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        // Same result as comparing the types as strings, for all the nodes of the tree
+        int found = 0;
+        treesitter::TreeCursor cursor(tree->rootNode());
+        while (true) {
+            const auto node = cursor.currentNode();
+            QCOMPARE(nodeTypes.contains(node), types.contains(node.type()));
+            found += nodeTypes.contains(node) ? 1 : 0;
+            if (cursor.gotoFirstChild())
+                continue;
+            while (!cursor.gotoNextSibling()) {
+                if (!cursor.gotoParent())
+                    break;
+            }
+            if (cursor.currentNode() == tree->rootNode())
+                break;
+        }
+        QVERIFY(found > 5);
+
+        const auto structNode = tree->rootNode().namedChild(0);
+        QCOMPARE(structNode.type(), "struct_specifier");
+        const treesitter::NodeTypes fieldList(tree_sitter_cpp(), {"field_declaration_list"});
+        QCOMPARE(structNode.textExcept(source, fieldList), "struct S ");
+        QCOMPARE(structNode.textExcept(source, QStringList {"field_declaration_list"}), "struct S ");
+    }
+
+    void nodeHash()
+    {
+        const QString source = "void f() { g(); g(); }\n";
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        // The same node found twice is only once in a set, and comes before its descendants
+        const auto root = tree->rootNode();
+        const auto function = root.namedChild(0);
+        const auto body = function.namedChild(2);
+        QCOMPARE(body.type(), "compound_statement");
+        QSet<treesitter::Node> nodes {function, body, body.namedChild(0), body.namedChild(1)};
+        nodes.insert(root.descendantForRange(11, 15).parent());
+        nodes.insert(body.parent());
+        QCOMPARE(nodes.size(), 4);
+        QCOMPARE(qHash(body.parent()), qHash(function));
+        QCOMPARE(std::hash<treesitter::Node> {}(body.parent()), std::hash<treesitter::Node> {}(function));
+
+        auto sorted = nodes.values();
+        std::sort(sorted.begin(), sorted.end());
+        QCOMPARE(sorted, QList<treesitter::Node>({function, body, body.namedChild(0), body.namedChild(1)}));
+
+        // With the same start, the longest node comes first
+        const auto call = body.namedChild(0).namedChild(0);
+        QCOMPARE(call.type(), "call_expression");
+        QVERIFY(call < call.namedChild(0));
+        QVERIFY(!(call.namedChild(0) < call));
+        QVERIFY(!(call < call));
+    }
+
+    void treeSnapshot()
+    {
+        QString source = "int a;\nint b;\n";
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto snapshot = std::make_shared<const treesitter::TreeSnapshot>(*tree, source);
+
+        // Edit and reparse the original tree, the snapshot still matches the original text
+        source.replace(0, 6, "float c, d;");
+        constexpr uint32_t charSize = sizeof(QChar);
+        TSInputEdit edit {.start_byte = 0,
+                          .old_end_byte = 6 * charSize,
+                          .new_end_byte = 11 * charSize,
+                          .start_point = {0, 0},
+                          .old_end_point = {0, 6 * charSize},
+                          .new_end_point = {0, 11 * charSize}};
+        tree->edit(edit);
+        tree = parser.parseString(source, &tree.value());
+        QVERIFY(tree.has_value());
+
+        // Each thread uses its own copy of the snapshot
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), "(identifier) @name");
+        auto names = std::async(std::launch::async, [query, snapshot = snapshot->copy()]() {
+                         treesitter::QueryCursor cursor;
+                         cursor.execute(query, snapshot);
+                         QStringList result;
+                         while (auto match = cursor.nextMatch())
+                             result.push_back(match->captures().first().node.textIn(snapshot->source()));
+                         return result;
+                     }).get();
+        QCOMPARE(names, QStringList({"a", "b"}));
+
+        treesitter::QueryCursor cursor;
+        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        QCOMPARE(cursor.allRemainingMatches().size(), 3);
+    }
+
 #define VERIFY_PREDICATE_ERROR(queryString)                                                                            \
     QVERIFY_THROWS_EXCEPTION(Error, treesitter::Query(tree_sitter_cpp(), queryString))
 
@@ -96,6 +366,9 @@ private slots:
         QCOMPARE(captures.at(0).name, "arg");
         QCOMPARE(captures.at(1).name, "field");
         QCOMPARE(captures.at(2).name, "from");
+        QCOMPARE(query->captureNames(), QStringList({"arg", "field", "from"}));
+        QCOMPARE(query->captureIndex("field"), 1);
+        QCOMPARE(query->captureIndex("unknown"), -1);
 
         auto patterns = query->patterns();
         QCOMPARE(patterns.size(), 1);
@@ -119,6 +392,8 @@ private slots:
         auto match = cursor.nextMatch();
         QVERIFY(match.has_value());
         QVERIFY(match->patternIndex() == 0);
+        QCOMPARE(match->capturesNamed("field").size(), 1);
+        QVERIFY(match->capturesNamed("unknown").isEmpty());
 
         // Assure there is no second match
         auto nextMatch = cursor.nextMatch();
@@ -149,6 +424,122 @@ private slots:
         QVERIFY(!cursor.nextMatch().has_value());
     }
 
+    void queryCache()
+    {
+        auto &cache = treesitter::QueryCache::instance();
+        cache.clear();
+        cache.setMaximumSize(2);
+
+        auto query = cache.get(tree_sitter_cpp(), "(field_expression) @from");
+        QVERIFY(query);
+        QCOMPARE(cache.get(tree_sitter_cpp(), "(field_expression) @from"), query);
+        QCOMPARE(cache.statistics().hits, size_t {1});
+        QCOMPARE(cache.statistics().misses, size_t {1});
+
+        // Queries are cached per language
+        QVERIFY(cache.get(tree_sitter_qmljs(), "(comment) @comment"));
+        QCOMPARE(cache.size(), size_t {2});
+
+        // Errors are not cached
+        QVERIFY_THROWS_EXCEPTION(treesitter::Query::Error, cache.get(tree_sitter_cpp(), "(field_expr)"));
+        QCOMPARE(cache.size(), size_t {2});
+
+        // The least recently used query is removed first
+        cache.get(tree_sitter_cpp(), "(field_expression) @from");
+        cache.get(tree_sitter_cpp(), "(comment) @comment");
+        QCOMPARE(cache.size(), size_t {2});
+        QCOMPARE(cache.get(tree_sitter_cpp(), "(field_expression) @from"), query);
+
+        cache.clear();
+        cache.setMaximumSize(256);
+    }
+
+    void multiQuery()
+    {
+        const QString source = "struct A { int x; };\nenum E { One, Two };\nstruct B {};\n";
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        // The second query has two patterns, the third one uses a predicate
+        const treesitter::MultiQuery multiQuery(
+            tree_sitter_cpp(),
+            {"(struct_specifier name: (_) @name)", "(enumerator name: (_) @name)\n(enum_specifier name: (_) @name)",
+             R"((field_identifier) @name (#eq? @name "y"))"});
+        QCOMPARE(multiQuery.queryCount(), 3);
+        QCOMPARE(multiQuery.query()->patterns().size(), 4);
+
+        QList<QStringList> names(multiQuery.queryCount());
+        treesitter::QueryCursor cursor;
+        cursor.execute(multiQuery.query(), tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        while (auto match = cursor.nextMatch()) {
+            const int index = multiQuery.queryIndex(match->patternIndex());
+            QVERIFY(index >= 0);
+            names[index].push_back(match->captures().first().node.textIn(source));
+        }
+        QCOMPARE(names[0], QStringList({"A", "B"}));
+        names[1].sort();
+        QCOMPARE(names[1], QStringList({"E", "One", "Two"}));
+        QVERIFY(names[2].isEmpty());
+
+        // Errors are reported relative to the faulty query
+        try {
+            treesitter::MultiQuery(tree_sitter_cpp(), {"(comment) @comment", "(field_expr)"});
+            QFAIL("The query should not compile");
+        } catch (const treesitter::Query::Error &error) {
+            QCOMPARE(error.utf8_offset, 1u);
+            QVERIFY(error.description.endsWith("in query 1"));
+        }
+    }
+
+    void queryProfile()
+    {
+        const QString source = "void f() {\n    a.x;\n    b.y;\n    c.x;\n}\n";
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto tree = parser.parseString(source);
+        QVERIFY(tree.has_value());
+
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+        (field_expression field: (_) @field (#eq? @field "x"))
+        (function_definition)
+                )EOF");
+
+        treesitter::QueryProfile profile;
+        {
+            treesitter::QueryCursor cursor;
+            cursor.setProfile(&profile);
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            QCOMPARE(cursor.allRemainingMatches().size(), 3);
+        }
+        QCOMPARE(profile.executions, 1);
+        QCOMPARE(profile.patterns.size(), 2);
+        QCOMPARE(profile.patterns.at(0).rawMatches, 3);
+        QCOMPARE(profile.patterns.at(0).acceptedMatches, 2);
+        QCOMPARE(profile.patterns.at(0).rejections.at("eq?"), 1);
+        QCOMPARE(profile.patterns.at(1).rawMatches, 1);
+        QCOMPARE(profile.patterns.at(1).acceptedMatches, 1);
+        QVERIFY(profile.patterns.at(1).rejections.empty());
+
+        // The profiler merges the profiles of all cursors running the same query
+        auto &profiler = treesitter::QueryProfiler::instance();
+        profiler.clear();
+        profiler.setEnabled(true);
+        for (int i = 0; i < 2; ++i) {
+            treesitter::QueryCursor cursor;
+            cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+            cursor.allRemainingMatches();
+        }
+        profiler.setEnabled(false);
+
+        const auto profiles = profiler.profiles();
+        QCOMPARE(profiles.size(), size_t {1});
+        QCOMPARE(profiles.front().queryText, query->text());
+        QCOMPARE(profiles.front().executions, 2);
+        QCOMPARE(profiles.front().patterns.at(0).rejections.at("eq?"), 2);
+        QVERIFY(profiler.report().contains("Pattern 0: 6 matches - 4 accepted - 2 rejected by #eq?"));
+        profiler.clear();
+    }
+
     void transformMemberAccess()
     {
         auto source = readTestFile("/tst_treesitter/main.cpp");
@@ -171,6 +562,75 @@ private slots:
         QCOMPARE(result, readTestFile("/tst_treesitter/main-arrow.cpp"));
     }
 
+    void transformManyMatches()
+    {
+        QString source = "void f() {\n";
+        for (int i = 0; i < 500; ++i)
+            source += QString("    s%1.member.value = 0;\n").arg(i);
+        source += "}\n";
+
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+        (field_expression
+            argument: (_) @arg
+            "."
+            field: (_) @field
+            ) @from
+                )EOF");
+
+        treesitter::Transformation transformation(source, std::move(parser), std::move(query), "@arg->@field");
+
+        int progress = 0;
+        transformation.setProgressCallback([&progress](int replacements) {
+            progress = replacements;
+        });
+
+        // Every statement contains a nested match, so it takes two passes and a last one finding nothing, way below the
+        // pass limit.
+        const auto result = transformation.run();
+        QCOMPARE(transformation.replacementsMade(), 1000);
+        QCOMPARE(progress, 1000);
+        QVERIFY(!result.contains('.'));
+        QVERIFY(result.contains("s499->member->value = 0;"));
+
+        // The nested replacements are merged with the outer ones, and the changes rebuild the result from the source
+        const auto &changes = transformation.changes();
+        QCOMPARE(changes.size(), size_t {500});
+        QString rebuilt;
+        int position = 0;
+        for (const auto &change : changes) {
+            rebuilt += source.mid(position, change.sourceStart - position);
+            QCOMPARE(rebuilt.size(), change.resultStart);
+            rebuilt += result.mid(change.resultStart, change.resultEnd - change.resultStart);
+            position = change.sourceEnd;
+        }
+        rebuilt += source.mid(position);
+        QCOMPARE(rebuilt, result);
+
+        std::atomic<bool> canceled = true;
+        transformation.setCancellationFlag(&canceled);
+        QVERIFY_THROWS_EXCEPTION(treesitter::Transformation::Error, transformation.run());
+    }
+
+    void transformNewMatches()
+    {
+        const QString source = "void f() { a.b.c = 0; }\n";
+
+        // Only a.b matches at first, its replacement makes a_b.c match
+        treesitter::Parser parser(tree_sitter_cpp());
+        auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), R"EOF(
+        (field_expression
+            argument: (identifier) @arg
+            field: (field_identifier) @field
+            ) @from
+                )EOF");
+
+        treesitter::Transformation transformation(source, std::move(parser), std::move(query), "@arg_@field");
+        QCOMPARE(transformation.run(), "void f() { a_b_c = 0; }\n");
+        QCOMPARE(transformation.replacementsMade(), 2);
+        QCOMPARE(transformation.changes().size(), size_t {1});
+    }
+
     void transformationErrors()
     {
         auto source = readTestFile("/tst_treesitter/main.cpp");
@@ -249,7 +709,8 @@ private slots:
     }
 
     // make sure we keep the tree alive, as otherwise the nodes will be dangling references
-    std::tuple<QString, treesitter::Tree, treesitter::QueryCursor> runQuery(const QString &queryString)
+    std::tuple<QString, treesitter::Tree, treesitter::QueryCursor> runQuery(const QString &queryString,
+                                                                           treesitter::QueryParameters parameters = {})
     {
         auto source = readTestFile("/tst_treesitter/main.cpp");
         treesitter::Parser parser(tree_sitter_cpp());
@@ -257,7 +718,8 @@ private slots:
         auto query = std::make_shared<treesitter::Query>(tree_sitter_cpp(), queryString);
 
         treesitter::QueryCursor cursor;
-        cursor.execute(query, tree->rootNode(), std::make_unique<treesitter::Predicates>(source));
+        cursor.execute(query, tree->rootNode(),
+                       std::make_unique<treesitter::Predicates>(source, nullptr, std::move(parameters)));
 
         return std::make_tuple(source, std::move(*tree), std::move(cursor));
     }
@@ -384,6 +846,40 @@ private slots:
         QVERIFY(!cursor.nextMatch().has_value());
     }
 
+    void query_parameters()
+    {
+        const QString queryString = R"EOF(
+            (function_definition
+                (function_declarator
+                    declarator: (_) @name
+                    (#eq? @name "$name")
+                    ))
+        )EOF";
+
+        for (const QString name : {"main", "myOtherFreeFunction"}) {
+            auto [source, tree, cursor] = runQuery(queryString, {{"name", name}});
+            auto match = cursor.nextMatch();
+            QVERIFY(match.has_value());
+            QCOMPARE(match->capturesNamed("name").first().node.textIn(source), name);
+            QVERIFY(!cursor.nextMatch().has_value());
+        }
+
+        // Unbound parameters are compared as is
+        auto [source, tree, cursor] = runQuery(queryString);
+        QVERIFY(!cursor.nextMatch().has_value());
+
+        // The parameter is also bound in the expected string of #eq_except?
+        const QString exceptQueryString = R"EOF(
+            (
+                (parameter_declaration) @param
+                (#eq_except? "$type" @param "identifier"))
+        )EOF";
+        auto [exceptSource, exceptTree, exceptCursor] = runQuery(exceptQueryString, {{"type", "const std::string &"}});
+        auto match = exceptCursor.nextMatch();
+        QVERIFY(match.has_value());
+        QCOMPARE(match->capturesNamed("param").first().node.textIn(exceptSource), "const std::string &e_123");
+    }
+
     void like_predicate_errors()
     {
         using Error = treesitter::Query::Error;
@@ -521,6 +1017,42 @@ private slots:
         auto matches = cursor.allRemainingMatches();
         QCOMPARE(matches.size(), 1); // Only one function that returns a string, and not an int.
     }
+
+    void any_of_predicate_errors()
+    {
+        using Error = treesitter::Query::Error;
+        // Too few arguments
+        VERIFY_PREDICATE_ERROR("(#any_of?)");
+        VERIFY_PREDICATE_ERROR("((identifier) @ident (#any_of? @ident))");
+
+        // No capture
+        VERIFY_PREDICATE_ERROR("(#any_of? \"a\" \"b\")");
+    }
+
+    void any_of_predicate()
+    {
+        auto functionNames = [](const QString &predicate) {
+            auto [source, tree, cursor] = runQuery(QString(R"EOF(
+                (function_definition
+                    (function_declarator
+                        declarator: (_) @name
+                        %1))
+            )EOF")
+                                                       .arg(predicate));
+            QStringList names;
+            for (const auto &match : cursor.allRemainingMatches())
+                names.append(match.capturesNamed("name").first().node.textIn(source));
+            return names;
+        };
+
+        QCOMPARE(functionNames(R"((#any_of? @name "main" "myFreeFunction" "unknown"))"),
+                 QStringList({"main", "myFreeFunction"}));
+        QCOMPARE(functionNames(R"((#any-of? @name "main"))"), QStringList({"main"}));
+        QVERIFY(!functionNames(R"((#not_any_of? @name "main" "myFreeFunction"))").contains("main"));
+        QVERIFY(functionNames(R"((#not-any-of? @name "main"))").contains("myFreeFunction"));
+        QCOMPARE(functionNames(R"((#like_any_of? @name " my Free Function "))"), QStringList({"myFreeFunction"}));
+        QVERIFY(!functionNames(R"((#not_like_any_of? @name "my FreeFunction"))").contains("myFreeFunction"));
+    }
 };
 
 QTEST_MAIN(TestTreeSitter)
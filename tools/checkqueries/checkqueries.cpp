@@ -0,0 +1,24 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "core/builtinqueries.h"
+
+#include <iostream>
+
+// Compiles all the builtin queries against their grammar, run after each build: the exit code is 1 if one is invalid
+int main()
+{
+    const auto errors = Core::BuiltinQueries::compile();
+    for (const auto &error : errors)
+        std::cerr << "knut-check-queries: invalid builtin query " << error.toStdString() << "\n";
+    if (errors.isEmpty())
+        std::cout << Core::BuiltinQueries::all().size() << " builtin queries checked\n";
+    return errors.isEmpty() ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "projectgenerator.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <cstdio>
+#include <cstdlib>
+
+// Generates a synthetic MFC project, used to test knut on projects larger than the samples of test_data
+// projectgen --modules 100 --dialogs 48 --ui-files 1 <dir> writes a 10,000 files project
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates a synthetic MFC project of a configurable size.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("dir", "Directory of the generated project.");
+
+    const ProjectGen::ProjectOptions defaults;
+    parser.addOptions({
+        {"modules", "Number of modules, each one with its own RC file.", "count", QString::number(defaults.modules)},
+        {"dialogs", "Number of dialogs per module, each one with a class.", "count", QString::number(defaults.dialogs)},
+        {"controls", "Number of controls per dialog.", "count", QString::number(defaults.controls)},
+        {"strings", "Number of strings per module.", "count", QString::number(defaults.strings)},
+        {"ui-files", "Number of Qt Designer files per module.", "count", QString::number(defaults.uiFiles)},
+    });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    auto value = [&parser](const QString &name) {
+        bool ok = false;
+        const int value = parser.value(name).toInt(&ok);
+        if (!ok || value < 0) {
+            std::fprintf(stderr, "Invalid --%s value: %s\n", qPrintable(name), qPrintable(parser.value(name)));
+            std::exit(1);
+        }
+        return value;
+    };
+    const ProjectGen::ProjectOptions options {.modules = value("modules"),
+                                              .dialogs = value("dialogs"),
+                                              .controls = value("controls"),
+                                              .strings = value("strings"),
+                                              .uiFiles = value("ui-files")};
+
+    const auto dir = parser.positionalArguments().first();
+    if (!ProjectGen::generateProject(dir, options)) {
+        std::fprintf(stderr, "Can't write the project in %s\n", qPrintable(QDir::toNativeSeparators(dir)));
+        return 1;
+    }
+    std::printf("%d files written in %s\n", ProjectGen::fileCount(options), qPrintable(QDir::toNativeSeparators(dir)));
+    return 0;
+}
@@ -0,0 +1,354 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#include "projectgenerator.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+namespace ProjectGen {
+
+// Kinds of the controls of a dialog, the n-th control has the n-th kind modulo the number of kinds
+enum class ControlKind { Label, Edit, Button, CheckBox, ComboBox, Count };
+
+static ControlKind controlKind(int control)
+{
+    return static_cast<ControlKind>(control % static_cast<int>(ControlKind::Count));
+}
+
+static QString moduleName(int module)
+{
+    return QString("module%1").arg(module);
+}
+
+static QString dialogId(int dialog)
+{
+    return QString("IDD_DIALOG%1").arg(dialog);
+}
+
+static QString controlId(int dialog, int control)
+{
+    return QString("IDC_CONTROL%1_%2").arg(dialog).arg(control);
+}
+
+static QString stringId(int string)
+{
+    return QString("IDS_STRING%1").arg(string);
+}
+
+static QString memberName(int control)
+{
+    switch (controlKind(control)) {
+    case ControlKind::Edit:
+        return QString("m_edit%1").arg(control);
+    case ControlKind::CheckBox:
+        return QString("m_check%1").arg(control);
+    case ControlKind::ComboBox:
+        return QString("m_combo%1").arg(control);
+    default:
+        return {};
+    }
+}
+
+static QString handlerName(int control)
+{
+    switch (controlKind(control)) {
+    case ControlKind::Edit:
+        return QString("OnChangeEdit%1").arg(control);
+    case ControlKind::Button:
+        return QString("OnButton%1").arg(control);
+    case ControlKind::ComboBox:
+        return QString("OnSelChangeCombo%1").arg(control);
+    default:
+        return {};
+    }
+}
+
+static bool writeFile(const QString &fileName, const QString &content)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+    file.write(content.toUtf8());
+    return true;
+}
+
+QString generatedClassName(int module, int dialog)
+{
+    return QString("CModule%1Dialog%2").arg(module).arg(dialog);
+}
+
+int fileCount(const ProjectOptions &options)
+{
+    // resource.h, stdafx.h and the RC file, then the classes and the ui files
+    return options.modules * (3 + 2 * options.dialogs + options.uiFiles);
+}
+
+static QString resourceHeader(const ProjectOptions &options)
+{
+    QString text = "// Generated resource ids\n//\n";
+    int id = 1000;
+    auto define = [&](const QString &name) {
+        text += QString("#define %1 %2\n").arg(name).arg(id++);
+    };
+    for (int dialog = 0; dialog < options.dialogs; ++dialog) {
+        define(dialogId(dialog));
+        for (int control = 0; control < options.controls; ++control)
+            define(controlId(dialog, control));
+    }
+    for (int string = 0; string < options.strings; ++string)
+        define(stringId(string));
+    return text;
+}
+
+// One control of each kind, laid out on 2 columns
+static QString controlLine(int dialog, int control)
+{
+    const int x = 7 + (control % 2) * 150;
+    const int y = 7 + (control / 2) * 18;
+    const auto id = controlId(dialog, control);
+    switch (controlKind(control)) {
+    case ControlKind::Label:
+        return QString("    LTEXT           \"Label %1\",%2,%3,%4,60,8\n").arg(control).arg(id).arg(x).arg(y);
+    case ControlKind::Edit:
+        return QString("    EDITTEXT        %1,%2,%3,100,14,ES_AUTOHSCROLL\n").arg(id).arg(x).arg(y);
+    case ControlKind::Button:
+        return QString("    PUSHBUTTON      \"Button %1\",%2,%3,%4,50,14\n").arg(control).arg(id).arg(x).arg(y);
+    case ControlKind::CheckBox:
+        return QString("    CONTROL         \"Check %1\",%2,\"Button\",BS_AUTOCHECKBOX | WS_TABSTOP,%3,%4,80,10\n")
+            .arg(control)
+            .arg(id)
+            .arg(x)
+            .arg(y);
+    default:
+        return QString("    COMBOBOX        %1,%2,%3,100,30,CBS_DROPDOWN | WS_VSCROLL | WS_TABSTOP\n")
+            .arg(id)
+            .arg(x)
+            .arg(y);
+    }
+}
+
+static QString rcFile(int module, const ProjectOptions &options)
+{
+    QString text;
+    QTextStream stream(&text);
+    stream << "#include \"resource.h\"\n\nLANGUAGE LANG_ENGLISH, SUBLANG_ENGLISH_US\n\n";
+    for (int dialog = 0; dialog < options.dialogs; ++dialog) {
+        const int height = 30 + ((options.controls + 1) / 2) * 18;
+        stream << dialogId(dialog) << " DIALOGEX 0, 0, 320, " << height << "\n"
+               << "STYLE DS_SETFONT | DS_MODALFRAME | DS_FIXEDSYS | WS_POPUP | WS_CAPTION | WS_SYSMENU\n"
+               << "CAPTION \"Module " << module << " - Dialog " << dialog << "\"\n"
+               << "FONT 8, \"MS Shell Dlg\", 400, 0, 0x1\nBEGIN\n";
+        for (int control = 0; control < options.controls; ++control)
+            stream << controlLine(dialog, control);
+        stream << "    DEFPUSHBUTTON   \"OK\",IDOK,263," << height - 21 << ",50,14\nEND\n\n";
+    }
+    stream << "STRINGTABLE\nBEGIN\n";
+    for (int string = 0; string < options.strings; ++string)
+        stream << "    " << stringId(string) << " \"Module " << module << " string " << string << "\"\n";
+    stream << "END\n";
+    stream.flush();
+    return text;
+}
+
+static QString classHeader(int module, int dialog, const ProjectOptions &options)
+{
+    const auto className = generatedClassName(module, dialog);
+    QString text;
+    QTextStream stream(&text);
+    stream << "#pragma once\n\n#include \"resource.h\"\n\n"
+           << "class " << className << " : public CDialog\n{\n"
+           << "    DECLARE_DYNAMIC(" << className << ")\n\n"
+           << "public:\n"
+           << "    " << className << "(CWnd *pParent = nullptr);\n"
+           << "    virtual ~" << className << "();\n\n"
+           << "    enum { IDD = " << dialogId(dialog) << " };\n\n"
+           << "protected:\n"
+           << "    virtual void DoDataExchange(CDataExchange *pDX);\n"
+           << "    virtual BOOL OnInitDialog();\n\n";
+    for (int control = 0; control < options.controls; ++control) {
+        if (const auto handler = handlerName(control); !handler.isEmpty())
+            stream << "    afx_msg void " << handler << "();\n";
+    }
+    stream << "    DECLARE_MESSAGE_MAP()\n\nprivate:\n";
+    for (int control = 0; control < options.controls; ++control) {
+        switch (controlKind(control)) {
+        case ControlKind::Edit:
+            stream << "    CString " << memberName(control) << ";\n";
+            break;
+        case ControlKind::CheckBox:
+            stream << "    BOOL " << memberName(control) << ";\n";
+            break;
+        case ControlKind::ComboBox:
+            stream << "    int " << memberName(control) << ";\n";
+            break;
+        default:
+            break;
+        }
+    }
+    stream << "};\n";
+    stream.flush();
+    return text;
+}
+
+// The buttons of a dialog open the previous dialog of the module, so the classes reference each other
+static QString classSource(int module, int dialog, const ProjectOptions &options)
+{
+    const auto className = generatedClassName(module, dialog);
+    QString text;
+    QTextStream stream(&text);
+    stream << "#include \"stdafx.h\"\n#include \"" << className << ".h\"\n";
+    if (dialog > 0)
+        stream << "#include \"" << generatedClassName(module, dialog - 1) << ".h\"\n";
+    stream << "\nIMPLEMENT_DYNAMIC(" << className << ", CDialog)\n\n";
+
+    stream << className << "::" << className << "(CWnd *pParent /*=nullptr*/)\n"
+           << "    : CDialog(" << className << "::IDD, pParent)\n";
+    for (int control = 0; control < options.controls; ++control) {
+        switch (controlKind(control)) {
+        case ControlKind::Edit:
+            stream << "    , " << memberName(control) << "(_T(\"\"))\n";
+            break;
+        case ControlKind::CheckBox:
+            stream << "    , " << memberName(control) << "(FALSE)\n";
+            break;
+        case ControlKind::ComboBox:
+            stream << "    , " << memberName(control) << "(0)\n";
+            break;
+        default:
+            break;
+        }
+    }
+    stream << "{\n}\n\n" << className << "::~" << className << "()\n{\n}\n\n";
+
+    stream << "void " << className << "::DoDataExchange(CDataExchange *pDX)\n{\n"
+           << "    CDialog::DoDataExchange(pDX);\n";
+    for (int control = 0; control < options.controls; ++control) {
+        const auto id = controlId(dialog, control);
+        switch (controlKind(control)) {
+        case ControlKind::Edit:
+            stream << "    DDX_Text(pDX, " << id << ", " << memberName(control) << ");\n"
+                   << "    DDV_MaxChars(pDX, " << memberName(control) << ", " << 10 + control << ");\n";
+            break;
+        case ControlKind::CheckBox:
+            stream << "    DDX_Check(pDX, " << id << ", " << memberName(control) << ");\n";
+            break;
+        case ControlKind::ComboBox:
+            stream << "    DDX_CBIndex(pDX, " << id << ", " << memberName(control) << ");\n";
+            break;
+        default:
+            break;
+        }
+    }
+    stream << "}\n\n";
+
+    stream << "BEGIN_MESSAGE_MAP(" << className << ", CDialog)\n";
+    for (int control = 0; control < options.controls; ++control) {
+        const auto id = controlId(dialog, control);
+        const auto handler = className + "::" + handlerName(control);
+        switch (controlKind(control)) {
+        case ControlKind::Edit:
+            stream << "    ON_EN_CHANGE(" << id << ", &" << handler << ")\n";
+            break;
+        case ControlKind::Button:
+            stream << "    ON_BN_CLICKED(" << id << ", &" << handler << ")\n";
+            break;
+        case ControlKind::ComboBox:
+            stream << "    ON_CBN_SELCHANGE(" << id << ", &" << handler << ")\n";
+            break;
+        default:
+            break;
+        }
+    }
+    stream << "END_MESSAGE_MAP()\n\n";
+
+    stream << "BOOL " << className << "::OnInitDialog()\n{\n"
+           << "    CDialog::OnInitDialog();\n\n"
+           << "    CString title;\n"
+           << "    title.LoadString(" << stringId(options.strings > 0 ? dialog % options.strings : 0) << ");\n"
+           << "    SetWindowText(title);\n"
+           << "    return TRUE;\n}\n";
+
+    for (int control = 0; control < options.controls; ++control) {
+        const auto handler = handlerName(control);
+        if (handler.isEmpty())
+            continue;
+        stream << "\nvoid " << className << "::" << handler << "()\n{\n";
+        switch (controlKind(control)) {
+        case ControlKind::Button:
+            if (dialog > 0) {
+                stream << "    " << generatedClassName(module, dialog - 1) << " dialog(this);\n"
+                       << "    dialog.DoModal();\n";
+            } else {
+                stream << "    AfxMessageBox(_T(\"Button " << control << "\"));\n";
+            }
+            break;
+        default:
+            stream << "    UpdateData(TRUE);\n";
+            break;
+        }
+        stream << "}\n";
+    }
+    stream.flush();
+    return text;
+}
+
+static QString uiFile(int module, int form, const ProjectOptions &options)
+{
+    const auto name = QString("Module%1Form%2").arg(module).arg(form);
+    QString text;
+    QTextStream stream(&text);
+    stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<ui version=\"4.0\">\n"
+           << " <class>" << name << "</class>\n"
+           << " <widget class=\"QWidget\" name=\"" << name << "\">\n"
+           << "  <property name=\"windowTitle\">\n   <string>" << name << "</string>\n  </property>\n"
+           << "  <layout class=\"QFormLayout\" name=\"formLayout\">\n";
+    for (int control = 0; control < options.controls; ++control) {
+        stream << "   <item row=\"" << control << "\" column=\"0\">\n"
+               << "    <widget class=\"QLabel\" name=\"label" << control << "\">\n"
+               << "     <property name=\"text\">\n      <string>Field " << control << "</string>\n     </property>\n"
+               << "    </widget>\n   </item>\n"
+               << "   <item row=\"" << control << "\" column=\"1\">\n"
+               << "    <widget class=\"QLineEdit\" name=\"lineEdit" << control << "\"/>\n   </item>\n";
+    }
+    stream << "  </layout>\n </widget>\n <resources/>\n <connections/>\n</ui>\n";
+    stream.flush();
+    return text;
+}
+
+bool generateProject(const QString &dir, const ProjectOptions &options)
+{
+    for (int module = 0; module < options.modules; ++module) {
+        const auto path = QDir(dir).filePath(moduleName(module));
+        if (!QDir().mkpath(path))
+            return false;
+
+        if (!writeFile(path + "/resource.h", resourceHeader(options))
+            || !writeFile(path + "/stdafx.h", "#pragma once\n\n#include <afxwin.h>\n#include <afxext.h>\n")
+            || !writeFile(QString("%1/%2.rc").arg(path, moduleName(module)), rcFile(module, options)))
+            return false;
+
+        for (int dialog = 0; dialog < options.dialogs; ++dialog) {
+            const auto fileName = QString("%1/%2").arg(path, generatedClassName(module, dialog));
+            if (!writeFile(fileName + ".h", classHeader(module, dialog, options))
+                || !writeFile(fileName + ".cpp", classSource(module, dialog, options)))
+                return false;
+        }
+
+        for (int form = 0; form < options.uiFiles; ++form) {
+            if (!writeFile(QString("%1/form%2.ui").arg(path).arg(form), uiFile(module, form, options)))
+                return false;
+        }
+    }
+    return true;
+}
+
+} // namespace ProjectGen
@@ -0,0 +1,44 @@
+/*
+  This file is part of Knut.
+
+  SPDX-FileCopyrightText: 2024 Klarälvdalens Datakonsult AB, a KDAB Group company <info@kdab.com>
+
+  SPDX-License-Identifier: GPL-3.0-only
+
+  Contact KDAB at <info@kdab.com> for commercial licensing options.
+*/
+
+#pragma once
+
+#include <QString>
+
+namespace ProjectGen {
+
+/**
+ * @brief Sizes of a generated MFC project
+ * The project has `modules` directories, each one with its own `resource.h` and `.rc` file. Each dialog of the RC
+ * file has a `CDialog` class, with a message map and a DDX, in its own header and source files.
+ */
+struct ProjectOptions
+{
+    int modules = 10;
+    int dialogs = 10;
+    int controls = 10;
+    int strings = 20;
+    int uiFiles = 2;
+};
+
+// Number of files written by generateProject for the options
+int fileCount(const ProjectOptions &options);
+
+/**
+ * @brief Generates an MFC-style project in `dir`
+ * Returns false if a file can't be written. The content only depends on the options, so two projects generated with
+ * the same options are identical.
+ */
+bool generateProject(const QString &dir, const ProjectOptions &options);
+
+// Name of the class of the n-th dialog of the m-th module, its files are `<className>.h` and `<className>.cpp`
+QString generatedClassName(int module, int dialog);
+
+} // namespace ProjectGen
@@ -541,6 +541,20 @@ void MetaSpecWriter::saveRequests()
     stream << QString(RequestHeader).arg(text);
 }
 
+static constexpr char CodeReaderHeader[] = R"(// File generated by spec2cpp tool
+// DO NOT MAKE ANY CHANGES HERE
+
+#pragma once
+
+#include "jsonreader.h"
+#include "types.h"
+#include "types_json.h"
+
+namespace Lsp {
+%1
+}
+)";
+
 void MetaSpecWriter::saveCode()
 {
     cleanCode();
@@ -570,6 +584,14 @@ void MetaSpecWriter::saveCode()
         QTextStream stream(&file);
         stream << QString(CodeJsonHeader).arg(text);
     }
+    {
+        QFile file(LSP_SOURCE_PATH "/types_reader.h");
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return;
+
+        QTextStream stream(&file);
+        stream << QString(CodeReaderHeader).arg(writeReaders());
+    }
 }
 
 QString MetaSpecWriter::writeEnums()
@@ -812,6 +834,168 @@ QString MetaSpecWriter::writeJsonInterface(const MetaData::InterfacePtr &interfa
     return result;
 }
 
+// Requests with large responses, deserialized straight from the message text instead of going through a json DOM.
+// The types used by other responses are read in a DOM, and deserialized with their from_json function.
+static const QStringList ReaderRequests = {"textDocument/references", "textDocument/documentSymbol"};
+
+// %1 type name
+static constexpr char ReaderDeclarationImpl[] = R"(inline bool read(JsonReader &reader, %1 &value);
+)";
+
+// %1 enum name
+static constexpr char ReaderEnumImpl[] = R"(
+inline bool read(JsonReader &reader, %1 &value)
+{
+    return readEnum(reader, value);
+}
+)";
+
+// %1 interface name
+// %2 properties: lines like if (key == "name") return ...
+// %3 mask of the required properties
+static constexpr char ReaderInterfaceImpl[] = R"(
+inline bool read(JsonReader &reader, %1 &value)
+{
+    int found = 0;
+    const bool ok = reader.readObject([&](std::string_view key) {
+%2        return reader.skipValue();
+    });
+    return ok && found == %3;
+}
+)";
+
+// %1 property name
+// %2 property flag
+static constexpr char ReaderPropertyImpl[] = R"(        if (key == "%1")
+            return readField(reader, value.%1, found, %2);
+)";
+
+// %1 property name
+static constexpr char ReaderOptionalPropertyImpl[] = R"(        if (key == "%1")
+            return read(reader, value.%1);
+)";
+
+QString MetaSpecWriter::writeReaders()
+{
+    std::vector<MetaData::InterfacePtr> interfaces;
+    QStringList enumerations;
+    for (const auto &request : m_data.requests) {
+        if (ReaderRequests.contains(request.name))
+            collectReaderTypes(request.result, interfaces, enumerations);
+    }
+
+    // Declare everything first, the readers may depend on each other
+    QString result = "\n";
+    for (const auto &enumeration : std::as_const(enumerations))
+        result += QString(ReaderDeclarationImpl).arg(enumeration);
+    for (const auto &interface : interfaces)
+        result += QString(ReaderDeclarationImpl).arg(interface->name);
+
+    for (const auto &enumeration : std::as_const(enumerations))
+        result += QString(ReaderEnumImpl).arg(enumeration);
+    for (const auto &interface : interfaces)
+        result += writeReaderInterface(interface);
+    return result;
+}
+
+// Properties of the interface, including the ones of the interfaces it extends
+std::vector<MetaData::TypePtr> MetaSpecWriter::readerProperties(const MetaData::InterfacePtr &interface) const
+{
+    std::vector<MetaData::TypePtr> properties;
+    for (const auto &item : interface->items) {
+        if (!item->is_interface())
+            properties.push_back(item);
+    }
+    for (const auto &extend : interface->extends) {
+        const auto it = std::ranges::find_if(m_data.interfaces, [&extend](const auto &value) {
+            return value->name == extend->value;
+        });
+        if (it != m_data.interfaces.cend()) {
+            const auto extendProperties = readerProperties(*it);
+            properties.insert(properties.end(), extendProperties.begin(), extendProperties.end());
+        }
+    }
+    return properties;
+}
+
+// Collects the interfaces and the integer enumerations used by type, which needs a generated reader
+void MetaSpecWriter::collectReaderTypes(const MetaData::TypePtr &type, std::vector<MetaData::InterfacePtr> &interfaces,
+                                        QStringList &enumerations)
+{
+    // Same exceptions as the json serialization, they have a custom from_json function
+    static std::unordered_set<QString> exceptions = {"SelectionRange", "FormattingOptions", "ChangeAnnotationsType"};
+
+    if (!type)
+        return;
+
+    if (type->kind == MetaData::TypeKind::Reference) {
+        const auto &name = type->value;
+        const auto isCollected = std::ranges::any_of(interfaces, [&name](const auto &interface) {
+            return interface->name == name;
+        });
+        if (isCollected || exceptions.contains(name) || enumerations.contains(name))
+            return;
+
+        const auto enumeration = std::ranges::find_if(m_data.enumerations, [&name](const auto &value) {
+            return value.name == name;
+        });
+        if (enumeration != m_data.enumerations.cend()) {
+            // String enumerations are read with their from_json function
+            if (enumeration->type != MetaData::Enumeration::String)
+                enumerations.push_back(name);
+            return;
+        }
+
+        const auto interface = std::ranges::find_if(m_data.interfaces, [&name](const auto &value) {
+            return value->name == name;
+        });
+        if (interface != m_data.interfaces.cend()) {
+            interfaces.push_back(*interface);
+            for (const auto &property : readerProperties(*interface))
+                collectReaderTypes(property, interfaces, enumerations);
+            return;
+        }
+
+        // Type aliases
+        const auto alias = std::ranges::find_if(m_data.types, [&name](const auto &value) {
+            return value->name == name;
+        });
+        if (alias != m_data.types.cend()) {
+            for (const auto &item : (*alias)->items)
+                collectReaderTypes(item, interfaces, enumerations);
+        }
+        return;
+    }
+
+    for (const auto &item : type->items)
+        collectReaderTypes(item, interfaces, enumerations);
+}
+
+QString MetaSpecWriter::writeReaderInterface(const MetaData::InterfacePtr &interface)
+{
+    QString content;
+    int flag = 0x1;
+    int required = 0;
+    for (const auto &property : readerProperties(interface)) {
+        QString name = property->name;
+        const bool isOptional = name.contains('?');
+        name.remove('?');
+
+        // String literals are static members, they are not deserialized
+        if (property->kind == MetaData::TypeKind::StringLiteral && !isOptional)
+            continue;
+
+        if (isOptional) {
+            content += QString(ReaderOptionalPropertyImpl).arg(name);
+        } else {
+            content += QString(ReaderPropertyImpl).arg(name, QString("0x%1").arg(flag, 0, 16));
+            required |= flag;
+            flag <<= 1;
+        }
+    }
+    return QString(ReaderInterfaceImpl).arg(interface->name, content, QString("0x%1").arg(required, 0, 16));
+}
+
 void MetaSpecWriter::cleanCode()
 {
     auto &enumerations = m_data.enumerations;
@@ -57,6 +57,11 @@ private:
     QString writeChildInterface(const MetaData::TypePtr &type, QStringList parent);
     QString writeMainInterface(const MetaData::InterfacePtr &interface);
     QString writeJsonInterface(const MetaData::InterfacePtr &interface, QStringList parent = {});
+    QString writeReaders();
+    QString writeReaderInterface(const MetaData::InterfacePtr &interface);
+    std::vector<MetaData::TypePtr> readerProperties(const MetaData::InterfacePtr &interface) const;
+    void collectReaderTypes(const MetaData::TypePtr &type, std::vector<MetaData::InterfacePtr> &interfaces,
+                            QStringList &enumerations);
 
 private:
     MetaData m_data;